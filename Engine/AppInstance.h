@@ -222,6 +222,14 @@ public:
     {
     }
 
+    virtual void loadProjectGui(bool /*isAutosave*/, boost::archive::binary_iarchive & /*archive*/) const
+    {
+    }
+
+    virtual void saveProjectGui(boost::archive::binary_oarchive & /*archive*/)
+    {
+    }
+
     virtual void setupViewersForViews(const std::vector<std::string>& /*viewNames*/)
     {
     }
@@ -45,6 +45,7 @@
 #endif
 #endif
 
+#include <algorithm> // std::max
 #include <clocale>
 #include <csignal>
 #include <cstddef>
@@ -115,7 +116,7 @@
 #include "Engine/JoinViewsNode.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/Log.h"
-#include "Engine/MemoryInfo.h" // getSystemTotalRAM, printAsRAM
+#include "Engine/MemoryInfo.h" // getSystemTotalRAM, printAsRAM, getCurrentRSS
 #include "Engine/Node.h"
 #include "Engine/OfxImageEffectInstance.h"
 #include "Engine/OfxEffectInstance.h"
@@ -129,6 +130,8 @@
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoSmear.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/TaskScheduler.h"
+#include "Engine/TrackerFrameAccessor.h"
 #include "Engine/TrackerNode.h"
 #include "Engine/ThreadPool.h"
 #include "Engine/ViewIdx.h"
@@ -501,6 +504,7 @@ AppManager::loadFromArgs(const CLArgs& cl)
     }
 
     _imp->idealThreadCount = QThread::idealThreadCount();
+    _imp->taskScheduler.reset( new TaskScheduler( std::max(0, _imp->idealThreadCount - 1) ) );
 
 
     QThreadPool::globalInstance()->setExpiryTimeout(-1); //< make threads never exit on their own
@@ -589,6 +593,7 @@ AppManager::~AppManager()
 
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
+    _imp->taskScheduler.reset();
 
     ///Kill caches now because decreaseNCacheFilesOpened can be called
     _imp->_nodeCache->waitForDeleterThread();
@@ -896,6 +901,30 @@ AppManager::loadInternal(const CLArgs& cl)
         }
     }
 
+    setAdaptiveParallelRendersEnabled( cl.isAdaptiveParallelRendersEnabled() );
+
+    // The resources options override the settings for this process only: apply them before the caches are created
+    if ( cl.hasResourcesOptions() ) {
+        _imp->_settings->setSaveSettings(false);
+        if (cl.getNumberOfRenderThreads() != -1) {
+            _imp->_settings->setNumberOfThreads( cl.getNumberOfRenderThreads() );
+        }
+        if (cl.getNumberOfParallelRenders() != -1) {
+            _imp->_settings->setNumberOfParallelRenders( cl.getNumberOfParallelRenders() );
+        }
+        if (cl.getRAMCachePercent() != -1) {
+            _imp->_settings->setRamMaximumPercent( cl.getRAMCachePercent() );
+        }
+        if (cl.getDiskCacheSizeGiB() != -1) {
+            _imp->_settings->setMaximumViewerDiskCacheSizeGiB( cl.getDiskCacheSizeGiB() );
+            _imp->_settings->setMaximumDiskCacheNodeSizeGiB( cl.getDiskCacheSizeGiB() );
+        }
+        if ( !cl.getDiskCachePath().isEmpty() ) {
+            _imp->_settings->setDiskCachePath( cl.getDiskCachePath().toStdString() );
+        }
+        setMaximumMemoryUsage( cl.getMaximumMemoryUsage() );
+    }
+
     ///basically show a splashScreen load fonts etc...
     return initGui(cl);
 } // loadInternal
@@ -1382,6 +1411,16 @@ AppManager::clearNodeCache()
     _imp->_nodeCache->clear();
 }
 
+void
+AppManager::clearTrackerFrameCaches()
+{
+    QMutexLocker k(&_imp->trackerFrameCachesMutex);
+
+    for (std::list<TrackerFrameCache*>::iterator it = _imp->trackerFrameCaches.begin(); it != _imp->trackerFrameCaches.end(); ++it) {
+        (*it)->clear();
+    }
+}
+
 void
 AppManager::clearPluginsLoadedCache()
 {
@@ -1403,6 +1442,7 @@ AppManager::clearAllCaches()
 
     clearDiskCache();
     clearNodeCache();
+    clearTrackerFrameCaches();
 
 
     ///for each app instance clear all its nodes cache
@@ -1489,6 +1529,10 @@ AppManager::writeToOutputPipe(const QString & longMessage,
 void
 AppManager::setApplicationsCachesMaximumMemoryPercent(double p)
 {
+    if (!_imp->_nodeCache) {
+        // The caches are not created yet: they read the settings when they are
+        return;
+    }
     size_t maxCacheRAM = p * getSystemTotalRAM_conditionnally();
 
     _imp->_nodeCache->setMaximumCacheSize(maxCacheRAM);
@@ -1498,13 +1542,17 @@ AppManager::setApplicationsCachesMaximumMemoryPercent(double p)
 void
 AppManager::setApplicationsCachesMaximumViewerDiskSpace(unsigned long long size)
 {
-    _imp->_viewerCache->setMaximumCacheSize(size);
+    if (_imp->_viewerCache) {
+        _imp->_viewerCache->setMaximumCacheSize(size);
+    }
 }
 
 void
 AppManager::setApplicationsCachesMaximumDiskSpace(unsigned long long size)
 {
-    _imp->_diskCache->setMaximumCacheSize(size);
+    if (_imp->_diskCache) {
+        _imp->_diskCache->setMaximumCacheSize(size);
+    }
 }
 
 void
@@ -2499,32 +2547,36 @@ AppManager::setNumberOfThreads(int threadsNb)
 
 bool
 AppManager::getImage(const ImageKey & key,
-                     std::list<ImagePtr>* returnValue) const
+                     std::list<ImagePtr>* returnValue,
+                     bool* lockContended) const
 {
-    return _imp->_nodeCache->get(key, returnValue);
+    return _imp->_nodeCache->get(key, returnValue, lockContended);
 }
 
 bool
 AppManager::getImageOrCreate(const ImageKey & key,
                              const ImageParamsPtr& params,
-                             ImagePtr* returnValue) const
+                             ImagePtr* returnValue,
+                             bool* lockContended) const
 {
-    return _imp->_nodeCache->getOrCreate(key, params, 0, returnValue);
+    return _imp->_nodeCache->getOrCreate(key, params, 0, returnValue, lockContended);
 }
 
 bool
 AppManager::getImage_diskCache(const ImageKey & key,
-                               std::list<ImagePtr>* returnValue) const
+                               std::list<ImagePtr>* returnValue,
+                               bool* lockContended) const
 {
-    return _imp->_diskCache->get(key, returnValue);
+    return _imp->_diskCache->get(key, returnValue, lockContended);
 }
 
 bool
 AppManager::getImageOrCreate_diskCache(const ImageKey & key,
                                        const ImageParamsPtr& params,
-                                       ImagePtr* returnValue) const
+                                       ImagePtr* returnValue,
+                                       bool* lockContended) const
 {
-    return _imp->_diskCache->getOrCreate(key, params, 0, returnValue);
+    return _imp->_diskCache->getOrCreate(key, params, 0, returnValue, lockContended);
 }
 
 bool
@@ -2554,12 +2606,24 @@ AppManager::isAggressiveCachingEnabled() const
     return _imp->_settings->isAggressiveCachingEnabled();
 }
 
+int
+AppManager::getImageCacheBucketIndex(U64 hash) const
+{
+    return Cache<Image>::getBucketIndex(hash);
+}
+
 U64
 AppManager::getCachesTotalMemorySize() const
 {
     return  _imp->_nodeCache->getMemoryCacheSize();
 }
 
+U64
+AppManager::getCachesMaximumMemorySize() const
+{
+    return  _imp->_nodeCache->getMaximumMemorySize();
+}
+
 U64
 AppManager::getCachesTotalDiskSize() const
 {
@@ -2874,15 +2938,75 @@ AppManager::checkCacheFreeMemoryIsGoodEnough()
     while (totalFreeRAM <= systemRAMToKeepFree) {
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << "Total system free RAM is below the threshold:" << printAsRAM(totalFreeRAM)
-        << ", clearing least recently used NodeCache image...";
+        << ", clearing least recently used NodeCache or tracker image...";
 #endif
-        if ( !_imp->_nodeCache->evictLRUInMemoryEntry() ) {
+        if ( !_imp->evictLRUInMemoryEntry() ) {
             break;
         }
 
 
         totalFreeRAM = getAmountFreePhysicalRAM();
     }
+
+    // Enforce the --max-memory limit. getCurrentRSS() returns 0 if the resident memory cannot be determined.
+    U64 maxMemoryUsage = _imp->maxMemoryUsage;
+    if (maxMemoryUsage) {
+        U64 rss = getCurrentRSS();
+        while (rss > maxMemoryUsage) {
+#ifdef NATRON_DEBUG_CACHE
+            qDebug() << "Process resident memory is above the limit:" << printAsRAM(rss)
+                     << ", clearing least recently used NodeCache or tracker image...";
+#endif
+            if ( !_imp->evictLRUInMemoryEntry() ) {
+                break;
+            }
+            rss = getCurrentRSS();
+        }
+    }
+}
+
+void
+AppManager::setMaximumMemoryUsage(U64 maxBytes)
+{
+    _imp->maxMemoryUsage = maxBytes;
+}
+
+U64
+AppManager::getMaximumMemoryUsage() const
+{
+    return _imp->maxMemoryUsage;
+}
+
+void
+AppManager::registerTrackerFrameCache(TrackerFrameCache* cache)
+{
+    QMutexLocker k(&_imp->trackerFrameCachesMutex);
+
+    _imp->trackerFrameCaches.push_back(cache);
+}
+
+void
+AppManager::unregisterTrackerFrameCache(TrackerFrameCache* cache)
+{
+    QMutexLocker k(&_imp->trackerFrameCachesMutex);
+    std::list<TrackerFrameCache*>::iterator found = std::find(_imp->trackerFrameCaches.begin(), _imp->trackerFrameCaches.end(), cache);
+
+    if ( found != _imp->trackerFrameCaches.end() ) {
+        _imp->trackerFrameCaches.erase(found);
+    }
+}
+
+std::size_t
+AppManager::getTrackerFrameCachesMemoryUsage() const
+{
+    QMutexLocker k(&_imp->trackerFrameCachesMutex);
+    std::size_t memory = 0;
+
+    for (std::list<TrackerFrameCache*>::const_iterator it = _imp->trackerFrameCaches.begin(); it != _imp->trackerFrameCaches.end(); ++it) {
+        memory += (*it)->getMemoryUsage();
+    }
+
+    return memory;
 }
 
 void
@@ -2910,9 +3034,24 @@ AppManager::getOCIOConfigPath() const
 void
 AppManager::setNThreadsToRender(int nThreads)
 {
-    QMutexLocker l(&_imp->nThreadsMutex);
+    {
+        QMutexLocker l(&_imp->nThreadsMutex);
 
-    _imp->nThreadsToRender = nThreads;
+        _imp->nThreadsToRender = nThreads;
+    }
+
+    if (_imp->taskScheduler) {
+        // -1 means no multi-threading, 0 means the ideal thread count
+        int nWorkers;
+        if (nThreads == -1) {
+            nWorkers = 0;
+        } else if (nThreads == 0) {
+            nWorkers = _imp->idealThreadCount - 1;
+        } else {
+            nWorkers = nThreads - 1;
+        }
+        _imp->taskScheduler->setWorkersCount(nWorkers);
+    }
 }
 
 void
@@ -2949,6 +3088,22 @@ AppManager::getUseThreadPool() const
     return _imp->useThreadPool;
 }
 
+void
+AppManager::setAdaptiveParallelRendersEnabled(bool enabled)
+{
+    QMutexLocker l(&_imp->nThreadsMutex);
+
+    _imp->adaptiveParallelRenders = enabled;
+}
+
+bool
+AppManager::isAdaptiveParallelRendersEnabled() const
+{
+    QMutexLocker l(&_imp->nThreadsMutex);
+
+    return _imp->adaptiveParallelRenders;
+}
+
 void
 AppManager::fetchAndAddNRunningThreads(int nThreads)
 {
@@ -2961,6 +3116,12 @@ AppManager::getNRunningThreads() const
     return (int)_imp->runningThreadsCount;
 }
 
+TaskScheduler*
+AppManager::getTaskScheduler() const
+{
+    return _imp->taskScheduler.get();
+}
+
 void
 AppManager::setThreadAsActionCaller(OfxImageEffectInstance* instance,
                                     bool actionCaller)
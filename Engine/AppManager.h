@@ -195,19 +195,21 @@ public:
 
     /**
      * @brief Attempts to load an image from cache, returns true if it could find a matching image, false otherwise.
+     * @param lockContended If non NULL, set to true if the lookup had to wait for another thread accessing the same cache bucket.
      **/
-    bool getImage(const ImageKey & key, std::list<ImagePtr>* returnValue) const;
+    bool getImage(const ImageKey & key, std::list<ImagePtr>* returnValue, bool* lockContended = 0) const;
 
     /**
      * @brief Same as getImage, but if it couldn't find a matching image in the cache, it will create one with the given parameters.
+     * @param lockContended If non NULL, set to true if the lookup or the creation had to wait for another thread accessing the same cache bucket.
      **/
     bool getImageOrCreate(const ImageKey & key, const ImageParamsPtr& params,
-                          ImagePtr* returnValue) const;
+                          ImagePtr* returnValue, bool* lockContended = 0) const;
 
-    bool getImage_diskCache(const ImageKey & key, std::list<ImagePtr>* returnValue) const;
+    bool getImage_diskCache(const ImageKey & key, std::list<ImagePtr>* returnValue, bool* lockContended = 0) const;
 
     bool getImageOrCreate_diskCache(const ImageKey & key, const ImageParamsPtr& params,
-                                    ImagePtr* returnValue) const;
+                                    ImagePtr* returnValue, bool* lockContended = 0) const;
 
     bool getTexture(const FrameKey & key,
                     std::list<FrameEntryPtr>* returnValue) const;
@@ -217,7 +219,13 @@ public:
                             FrameEntryPtr* returnValue) const;
 
 
+    /**
+     * @brief Returns the index of the bucket of the image caches in which an image with the given hash is stored
+     **/
+    int getImageCacheBucketIndex(U64 hash) const;
+
     U64 getCachesTotalMemorySize() const;
+    U64 getCachesMaximumMemorySize() const;
     U64 getCachesTotalDiskSize() const;
     CacheSignalEmitterPtr getOrActivateViewerCacheSignalEmitter() const;
 
@@ -351,6 +359,25 @@ public:
      **/
     void checkCacheFreeMemoryIsGoodEnough();
 
+    /**
+     * @brief Set with the --max-memory command-line option: checkCacheFreeMemoryIsGoodEnough() then also evicts
+     * images from the RAM cache while the resident memory of the process is above maxBytes. 0 means unlimited.
+     **/
+    void setMaximumMemoryUsage(U64 maxBytes);
+    U64 getMaximumMemoryUsage() const;
+
+    /**
+     * @brief Called by the TrackerFrameCache constructor and destructor, so that the images of the trackers are
+     * cleared with the other caches and evicted by checkCacheFreeMemoryIsGoodEnough().
+     **/
+    void registerTrackerFrameCache(TrackerFrameCache* cache);
+    void unregisterTrackerFrameCache(TrackerFrameCache* cache);
+
+    /**
+     * @brief Returns the memory held by the frame caches of all the trackers.
+     **/
+    std::size_t getTrackerFrameCachesMemoryUsage() const;
+
     void onCheckerboardSettingsChanged() { Q_EMIT checkerboardSettingsChanged(); }
 
     void onOCIOConfigPathChanged(const std::string& path);
@@ -380,6 +407,13 @@ public:
     void setNThreadsPerEffect(int nThreadsPerEffect);
     void setUseThreadPool(bool useThreadPool);
 
+    /**
+     * @brief When enabled (with the --adaptive-renders command-line option), the number of frames rendered concurrently
+     * by a render is chosen at runtime by a RenderThreadsController instead of the Number of parallel renders setting.
+     **/
+    void setAdaptiveParallelRendersEnabled(bool enabled);
+    bool isAdaptiveParallelRendersEnabled() const;
+
     void getNThreadsSettings(int* nThreadsToRender, int* nThreadsPerEffect) const;
     bool getUseThreadPool() const;
 
@@ -395,6 +429,12 @@ public:
      **/
     int getNRunningThreads() const;
 
+    /**
+     * @brief Returns the work-stealing scheduler executing the tiles of the renders and the
+     * tasks of the multi-thread suite. Its number of workers follows the Number of render threads setting.
+     **/
+    TaskScheduler* getTaskScheduler() const;
+
     void setThreadAsActionCaller(OfxImageEffectInstance* instance, bool actionCaller);
 
     /**
@@ -610,6 +650,8 @@ public Q_SLOTS:
 
     void clearNodeCache();
 
+    void clearTrackerFrameCaches();
+
     void clearExceedingEntriesFromNodeCache();
 
     void clearPluginsLoadedCache();
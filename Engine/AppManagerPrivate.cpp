@@ -59,6 +59,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Global/StrUtils.h"
 #include "Global/FStreamsSupport.h"
 
+#include "Engine/CacheIndexFile.h"
 #include "Engine/CacheSerialization.h"
 #include "Engine/CLArgs.h"
 #include "Engine/ExistenceCheckThread.h"
@@ -71,6 +72,8 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/RectDSerialization.h"
 #include "Engine/RectISerialization.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/TaskScheduler.h"
+#include "Engine/TrackerFrameAccessor.h"
 
 
 // Don't forget to update glad.h and glad.c aswell when updating theses
@@ -109,12 +112,17 @@ AppManagerPrivate::AppManagerPrivate()
     , maxCacheFiles(0)
     , currentCacheFilesCount(0)
     , currentCacheFilesCountMutex()
+    , maxMemoryUsage(0)
+    , trackerFrameCachesMutex()
+    , trackerFrameCaches()
     , idealThreadCount(0)
     , nThreadsToRender(0)
     , nThreadsPerEffect(0)
     , useThreadPool(true)
+    , adaptiveParallelRenders(false)
     , nThreadsMutex()
     , runningThreadsCount()
+    , taskScheduler()
     , lastProjectLoadedCreatedDuringRC2Or3(false)
     , commandLineArgsUtf8()
     , nArgs(0)
@@ -314,25 +322,10 @@ void
 saveCache(Cache<T>* cache)
 {
     std::string cacheRestoreFilePath = cache->getRestoreFilePath();
-    FStreamsSupport::ofstream ofile;
-    FStreamsSupport::open(&ofile, cacheRestoreFilePath);
+    std::string error;
 
-    if (!ofile) {
-        std::cerr << "Failed to save cache to " << cacheRestoreFilePath.c_str() << std::endl;
-
-        return;
-    }
-
-
-    typename Cache<T>::CacheTOC toc;
-    cache->save(&toc);
-    unsigned int version = cache->cacheVersion();
-    try {
-        boost::archive::binary_oarchive oArchive(ofile);
-        oArchive << version;
-        oArchive << toc;
-    } catch (const std::exception & e) {
-        qDebug() << "Failed to serialize the cache table of contents:" << e.what();
+    if ( !cache->save(cacheRestoreFilePath, &error) ) {
+        std::cerr << "Failed to save cache to " << cacheRestoreFilePath.c_str() << ": " << error << std::endl;
     }
 }
 
@@ -352,37 +345,18 @@ restoreCache(AppManagerPrivate* p,
 {
     if ( p->checkForCacheDiskStructure( cache->getCachePath(), cache->isTileCache() ) ) {
         std::string settingsFilePath = cache->getRestoreFilePath();
-        FStreamsSupport::ifstream ifile;
-        FStreamsSupport::open(&ifile, settingsFilePath);
-        if (!ifile) {
-            std::cerr << "Failure to open cache restore file at: " << settingsFilePath << std::endl;
+        boost::shared_ptr<CacheIndexFile> index = boost::make_shared<CacheIndexFile>();
+        std::string error;
 
-            return;
-        }
-        typename Cache<T>::CacheTOC tableOfContents;
-        unsigned int cacheVersion = 0x1; //< default to 1 before NATRON_CACHE_VERSION was introduced
-        try {
-            boost::archive::binary_iarchive iArchive(ifile);
-            if (cache->cacheVersion() >= NATRON_CACHE_VERSION) {
-                iArchive >> cacheVersion;
-            }
-            //Only load caches with same version, otherwise wipe it!
-            if ( cacheVersion == cache->cacheVersion() ) {
-                iArchive >> tableOfContents;
-            } else {
-                p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
-            }
-        } catch (const std::exception & e) {
-            qDebug() << "Exception when reading disk cache TOC:" << e.what();
+        //Only load caches with same version, otherwise wipe it!
+        if ( !index->open(settingsFilePath, cache->cacheVersion(), &error) ) {
+            qDebug() << "Failed to open the cache restore file" << settingsFilePath.c_str() << ":" << error.c_str();
             p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
 
             return;
         }
 
-        QFile restoreFile( QString::fromUtf8( settingsFilePath.c_str() ) );
-        restoreFile.remove();
-
-        cache->restore(tableOfContents);
+        cache->restore(index);
     }
 }
 
@@ -577,6 +551,41 @@ AppManagerPrivate::setMaxCacheFiles()
     maxCacheFiles = hardMax * 0.9;
 }
 
+bool
+AppManagerPrivate::evictLRUInMemoryEntry()
+{
+    // Evict from the cache holding the most memory, so that the images of the trackers do not stay in memory
+    // while the node cache is emptied
+    if ( _nodeCache && (appPTR->getTrackerFrameCachesMemoryUsage() <= _nodeCache->getMemoryCacheSize()) ) {
+        if ( _nodeCache->evictLRUInMemoryEntry() ) {
+            return true;
+        }
+    }
+    if ( evictLRUTrackerFrame() ) {
+        return true;
+    }
+
+    return _nodeCache && _nodeCache->evictLRUInMemoryEntry();
+}
+
+bool
+AppManagerPrivate::evictLRUTrackerFrame()
+{
+    QMutexLocker k(&trackerFrameCachesMutex);
+    TrackerFrameCache* biggestCache = 0;
+    std::size_t biggestMemory = 0;
+
+    for (std::list<TrackerFrameCache*>::const_iterator it = trackerFrameCaches.begin(); it != trackerFrameCaches.end(); ++it) {
+        std::size_t memory = (*it)->getMemoryUsage();
+        if (memory > biggestMemory) {
+            biggestCache = *it;
+            biggestMemory = memory;
+        }
+    }
+
+    return biggestCache && biggestCache->evictLRUEntry();
+}
+
 #ifdef DEBUG
 // logs every gl call to the console
 static void
@@ -113,11 +113,15 @@ public:
     size_t currentCacheFilesCount; //< the number of cache files currently opened in the application
     mutable QMutex currentCacheFilesCountMutex; //< protects currentCacheFilesCount
     std::string currentOCIOConfigPath; //< the currentOCIO config path
+    U64 maxMemoryUsage; //< the maximum resident memory of the process in bytes (0 if unlimited), only set while loading
+    mutable QMutex trackerFrameCachesMutex; //< protects trackerFrameCaches
+    std::list<TrackerFrameCache*> trackerFrameCaches; //< the frame caches of the trackers, registered by their constructor
     int idealThreadCount; // return value of QThread::idealThreadCount() cached here
     int nThreadsToRender; // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
     int nThreadsPerEffect;  // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
     bool useThreadPool; // whether the multi-thread suite should use the global thread pool (of QtConcurrent) or not
-    mutable QMutex nThreadsMutex; // protects nThreadsToRender & nThreadsPerEffect & useThreadPool
+    bool adaptiveParallelRenders; // whether the number of parallel renders is adjusted at runtime
+    mutable QMutex nThreadsMutex; // protects nThreadsToRender & nThreadsPerEffect & useThreadPool & adaptiveParallelRenders
 
     //The idea here is to keep track of the number of threads launched by Natron (except the ones of the global thread pool of QtConcurrent)
     //So that we can properly have an estimation of how much the cores of the CPU are used.
@@ -132,6 +136,10 @@ public:
     // Another method could be to analyse all cores running, but this is way more expensive and would impair performances.
     QAtomicInt runningThreadsCount;
 
+    // Executes the tiles of the renders and the multi-thread suite tasks. Created in loadFromArgs,
+    // with one worker less than the number of render threads: the thread calling TaskScheduler::run() executes tasks too.
+    boost::scoped_ptr<TaskScheduler> taskScheduler;
+
     //To by-pass a bug introduced in RC2 / RC3 with the serialization of bezier curves
     bool lastProjectLoadedCreatedDuringRC2Or3;
 
@@ -223,6 +231,18 @@ public:
      **/
     void setMaxCacheFiles();
 
+    /**
+     * @brief Removes the least recently used image of the cache holding the most memory among the node cache and
+     * the frame caches of the trackers. Returns false if they are all empty.
+     **/
+    bool evictLRUInMemoryEntry();
+
+    /**
+     * @brief Removes the least recently used image of the tracker frame cache holding the most memory.
+     * Returns false if they are all empty.
+     **/
+    bool evictLRUTrackerFrame();
+
     Plugin* findPluginById(const QString& oldId, int major, int minor) const;
 
     void declareSettingsToPython();
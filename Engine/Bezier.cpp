@@ -87,6 +87,9 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 // http://www.davidrevoy.com/article182/calibrating-wacom-stylus-pressure-on-krita
 #define ROTO_PRESSURE_LEVELS 512
 
+// The maximum number of shapes cached by Bezier::getShapeAtTime()
+#define BEZIER_SHAPES_CACHE_SIZE 64
+
 #ifndef M_PI
 #define M_PI        3.14159265358979323846264338327950288   /* pi             */
 #endif
@@ -2910,6 +2913,169 @@ Bezier::getBoundingBox(double time) const
     return bbox;
 } // Bezier::getBoundingBox
 
+void
+Bezier::computeShapeAtTime(double time,
+                           unsigned int mipmapLevel,
+                           BezierShape* shape) const
+{
+    double featherDist = getFeatherDistance(time);
+
+    ///Adjust the feather distance so it takes the mipmap level into account
+    if (mipmapLevel != 0) {
+        featherDist /= (1 << mipmapLevel);
+    }
+
+    /*
+     * We descretize the feather control points to obtain a polygon so that the feather distance will be of the same thickness around all the shape.
+     * If we were to extend only the end points, the resulting bezier interpolation would create a feather with different thickness around the shape,
+     * yielding an unwanted behaviour for the end user.
+     */
+    std::list<std::list<ParametricPoint> > featherPolygon;
+    std::list<std::list<ParametricPoint> > bezierPolygon;
+    RectD featherPolyBBox;
+
+    featherPolyBBox.setupInfinity();
+
+    evaluateFeatherPointsAtTime_DeCasteljau(false, time, mipmapLevel,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                                            50,
+#else
+                                            1,
+#endif
+                                            true, &featherPolygon, &featherPolyBBox);
+    evaluateAtTime_DeCasteljau(false, time, mipmapLevel,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                               50,
+#else
+                               1,
+#endif
+                               &bezierPolygon, NULL);
+
+    for (std::list<std::list<ParametricPoint> >::const_iterator it = bezierPolygon.begin(); it != bezierPolygon.end(); ++it) {
+        for (std::list<ParametricPoint>::const_iterator it2 = it->begin(); it2 != it->end(); ++it2) {
+            Point p = {it2->x, it2->y};
+            shape->polygon.push_back(p);
+        }
+    }
+
+    // Extend the feather polygon by the feather distance along its normals
+    std::vector<Point> featherContour;
+    for (std::list<std::list<ParametricPoint> >::const_iterator it = featherPolygon.begin(); it != featherPolygon.end(); ++it) {
+        for (std::list<ParametricPoint>::const_iterator it2 = it->begin(); it2 != it->end(); ++it2) {
+            Point p = {it2->x, it2->y};
+            featherContour.push_back(p);
+        }
+    }
+    if ( shape->polygon.empty() || featherContour.empty() ) {
+        return;
+    }
+
+    bool clockWise = isFeatherPolygonClockwiseOriented(false, time);
+    double signedFeatherDist = clockWise ? std::abs(featherDist) : -std::abs(featherDist);
+    std::vector<Point> extendedContour( featherContour.size() );
+    for (std::size_t i = 0; i < featherContour.size(); ++i) {
+        const Point & prev = featherContour[(i + featherContour.size() - 1) % featherContour.size()];
+        const Point & next = featherContour[(i + 1) % featherContour.size()];
+        double norm = std::sqrt( (next.x - prev.x) * (next.x - prev.x) + (next.y - prev.y) * (next.y - prev.y) );
+        double dx = (norm != 0) ? -( (next.y - prev.y) / norm ) : 0;
+        double dy = (norm != 0) ? ( (next.x - prev.x) / norm ) : 0;
+        extendedContour[i].x = featherContour[i].x + dx * signedFeatherDist;
+        extendedContour[i].y = featherContour[i].y + dy * signedFeatherDist;
+    }
+
+    /*
+     * The feather goes from the bezier polygon to the extended feather polygon. Both polygons have the same number of
+     * segments but not necessarily the same number of points per segment: in each segment, the points of both
+     * polygons are matched by increasing parameter, so that a point of one polygon may be matched to several
+     * consecutive points of the other one.
+     */
+    std::size_t bezierIndex = 0;
+    std::size_t featherIndex = 0;
+    std::list<std::list<ParametricPoint> >::const_iterator fIt = featherPolygon.begin();
+    for (std::list<std::list<ParametricPoint> >::const_iterator bIt = bezierPolygon.begin(); bIt != bezierPolygon.end() && fIt != featherPolygon.end(); ++bIt, ++fIt) {
+        if ( bIt->empty() || fIt->empty() ) {
+            bezierIndex += bIt->size();
+            featherIndex += fIt->size();
+            continue;
+        }
+        std::list<ParametricPoint>::const_iterator b = bIt->begin();
+        std::list<ParametricPoint>::const_iterator f = fIt->begin();
+        for (;;) {
+            shape->featherInner.push_back( shape->polygon[bezierIndex] );
+            shape->featherOuter.push_back(extendedContour[featherIndex]);
+
+            std::list<ParametricPoint>::const_iterator bNext = b;
+            ++bNext;
+            std::list<ParametricPoint>::const_iterator fNext = f;
+            ++fNext;
+            bool advanceBezier = bNext != bIt->end();
+            bool advanceFeather = fNext != fIt->end();
+            if (!advanceBezier && !advanceFeather) {
+                break;
+            }
+            if (advanceBezier && advanceFeather) {
+                // advance the polygon whose next point comes first
+                if (bNext->t < fNext->t) {
+                    advanceFeather = false;
+                } else if (fNext->t < bNext->t) {
+                    advanceBezier = false;
+                }
+            }
+            if (advanceBezier) {
+                b = bNext;
+                ++bezierIndex;
+            }
+            if (advanceFeather) {
+                f = fNext;
+                ++featherIndex;
+            }
+        }
+        ++bezierIndex;
+        ++featherIndex;
+    }
+} // Bezier::computeShapeAtTime
+
+BezierShapePtr
+Bezier::getShapeAtTime(double time,
+                       unsigned int mipmapLevel) const
+{
+    // The shapes are valid as long as neither the bezier nor its context are modified
+    U64 itemAge = getAge();
+    U64 contextAge = getContext()->getAge();
+    std::pair<double, unsigned int> key(time, mipmapLevel);
+    {
+        QMutexLocker k(&_imp->shapesMutex);
+        if ( (_imp->shapesItemAge != itemAge) || (_imp->shapesContextAge != contextAge) ) {
+            _imp->shapes.clear();
+            _imp->shapesItemAge = itemAge;
+            _imp->shapesContextAge = contextAge;
+        }
+        std::map<std::pair<double, unsigned int>, BezierShapePtr>::const_iterator found = _imp->shapes.find(key);
+        if ( found != _imp->shapes.end() ) {
+            return found->second;
+        }
+    }
+
+    // Compute the shape without holding the lock: concurrent renders of the same shape may compute it twice
+    boost::shared_ptr<BezierShape> shape = boost::make_shared<BezierShape>();
+    computeShapeAtTime(time, mipmapLevel, shape.get());
+
+    QMutexLocker k(&_imp->shapesMutex);
+    if ( (_imp->shapesItemAge == itemAge) && (_imp->shapesContextAge == contextAge) ) {
+        if (_imp->shapes.size() >= BEZIER_SHAPES_CACHE_SIZE) {
+            // Keep the shapes of the times closest to this one, e.g. while playing back
+            if ( std::abs(_imp->shapes.begin()->first.first - time) > std::abs(_imp->shapes.rbegin()->first.first - time) ) {
+                _imp->shapes.erase( _imp->shapes.begin() );
+            } else {
+                _imp->shapes.erase( --_imp->shapes.end() );
+            }
+        }
+        _imp->shapes[key] = shape;
+    }
+
+    return shape;
+} // Bezier::getShapeAtTime
+
 const std::list<BezierCPPtr> &
 Bezier::getControlPoints() const
 {
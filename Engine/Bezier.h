@@ -30,6 +30,7 @@
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/scoped_ptr.hpp>
@@ -71,6 +72,20 @@ struct ParametricPoint
     double x,y,t;
 };
 
+/**
+ * @brief The polygons of a closed bezier as it is rasterized, in pixel coordinates, see Bezier::getShapeAtTime()
+ **/
+struct BezierShape
+{
+    std::vector<Point> polygon;
+
+    // The feather is made of the quads joining the points of featherInner, on the polygon, to the points of featherOuter
+    std::vector<Point> featherInner;
+    std::vector<Point> featherOuter;
+};
+
+typedef boost::shared_ptr<const BezierShape> BezierShapePtr;
+
 struct BezierPrivate;
 class Bezier
     : public RotoDrawableItem
@@ -467,6 +482,14 @@ private:
 
 public:
 
+    /**
+     * @brief Returns the polygons of the closed bezier rasterized at the given time and mipmap level.
+     * They are computed from the points evaluated by evaluateAtTime_DeCasteljau and evaluateFeatherPointsAtTime_DeCasteljau
+     * and cached until the bezier or its RotoContext is modified, so that they are computed once for all the tiles
+     * and render threads.
+     **/
+    BezierShapePtr getShapeAtTime(double time, unsigned int mipmapLevel) const;
+
     /**
      * @brief Returns the bounding box of the bezier. The last value computed by evaluateAtTime_DeCasteljau will be returned,
      * otherwise if it has never been called, evaluateAtTime_DeCasteljau will be called to compute the bounding box.
@@ -610,6 +633,8 @@ private:
 
     void copyInternalPointsToGuiPoints();
 
+    void computeShapeAtTime(double time, unsigned int mipmapLevel, BezierShape* shape) const;
+
 public:
 
 
@@ -66,6 +66,13 @@ public:
     std::list<std::pair<int, std::pair<int, int> > > frameRanges;
     bool rangeSet;
     bool enableRenderStats;
+    bool adaptiveParallelRenders;
+    int renderThreads;
+    int parallelRenders;
+    int ramCachePercent;
+    int diskCacheSizeGiB;
+    QString diskCachePath;
+    U64 maxMemoryUsage;
     bool isEmpty;
     mutable QString imageFilename;
     QString breakpadPipeFilePath;
@@ -93,6 +100,13 @@ public:
         , frameRanges()
         , rangeSet(false)
         , enableRenderStats(false)
+        , adaptiveParallelRenders(false)
+        , renderThreads(-1)
+        , parallelRenders(-1)
+        , ramCachePercent(-1)
+        , diskCacheSizeGiB(-1)
+        , diskCachePath()
+        , maxMemoryUsage(0)
         , isEmpty(true)
         , imageFilename()
         , breakpadPipeFilePath()
@@ -107,6 +121,8 @@ public:
     void parse();
 
     QStringList::iterator hasToken(const QString& longName, const QString& shortName);
+    bool takeOptionValue(const QString& longName, QString* value);
+    bool takeIntegerOption(const QString& longName, int minimum, int maximum, int* value);
     QStringList::iterator hasOutputToken(QString& indexStr);
     QStringList::iterator findFileNameWithExtension(const QString& extension);
 };
@@ -229,6 +245,13 @@ CLArgs::operator=(const CLArgs& other)
     _imp->frameRanges = other._imp->frameRanges;
     _imp->rangeSet = other._imp->rangeSet;
     _imp->enableRenderStats = other._imp->enableRenderStats;
+    _imp->adaptiveParallelRenders = other._imp->adaptiveParallelRenders;
+    _imp->renderThreads = other._imp->renderThreads;
+    _imp->parallelRenders = other._imp->parallelRenders;
+    _imp->ramCachePercent = other._imp->ramCachePercent;
+    _imp->diskCacheSizeGiB = other._imp->diskCacheSizeGiB;
+    _imp->diskCachePath = other._imp->diskCachePath;
+    _imp->maxMemoryUsage = other._imp->maxMemoryUsage;
     _imp->isEmpty = other._imp->isEmpty;
     _imp->imageFilename = other._imp->imageFilename;
     _imp->exportDocsPath = other._imp->exportDocsPath;
@@ -338,7 +361,31 @@ CLArgs::printUsage(const std::string& programName)
         "     breakdown contains informations about each nodes, render times etc...\n"
         "     This option is useful for debugging purposes or to control that a render\n"
         "     is working correctly.\n"
-        "     **Please note** that it does not work when writing video files."
+        "     **Please note** that it does not work when writing video files.\n"
+        "  --adaptive-renders\n"
+        "     Adjust the number of frames rendered in parallel during the render,\n"
+        "     from the measured frame render times, CPU usage and image cache usage,\n"
+        "     instead of using the \"Number of parallel renders\" setting.\n"
+        "     With --render-stats, the decisions are written in the statistics files.\n"
+        "  --threads <n>\n"
+        "     Number of render threads (0 = guess), instead of the \"Number of render\n"
+        "     threads\" setting.\n"
+        "  --parallel-renders <n>\n"
+        "     Number of frames rendered in parallel (0 = guess), instead of the\n"
+        "     \"Number of parallel renders\" setting.\n"
+        "  --ram-cache <percent>\n"
+        "     Maximum amount of RAM used by the image cache, in % of the total RAM.\n"
+        "  --disk-cache <GiB>\n"
+        "     Maximum size of the playback and DiskCache node caches on disk, in GiB.\n"
+        "  --cache-path <directory>\n"
+        "     Location of the caches on disk, instead of the \"Disk cache path\"\n"
+        "     setting.\n"
+        "  --max-memory <size>\n"
+        "     Keep the resident memory of the process below size, given in bytes or\n"
+        "     with a K, M, G or T suffix (e.g. 8G), by evicting images from the RAM\n"
+        "     cache before allocating new ones.\n"
+        "    These options apply to this process only: the settings are not saved.\n"
+        "\n"
         "Sample uses:\n"
         "  %1 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1 -b -w MyWriter /Users/Me/MyNatronProjects/MyProject.ntp\n"
@@ -517,6 +564,55 @@ CLArgs::areRenderStatsEnabled() const
     return _imp->enableRenderStats;
 }
 
+bool
+CLArgs::isAdaptiveParallelRendersEnabled() const
+{
+    return _imp->adaptiveParallelRenders;
+}
+
+int
+CLArgs::getNumberOfRenderThreads() const
+{
+    return _imp->renderThreads;
+}
+
+int
+CLArgs::getNumberOfParallelRenders() const
+{
+    return _imp->parallelRenders;
+}
+
+int
+CLArgs::getRAMCachePercent() const
+{
+    return _imp->ramCachePercent;
+}
+
+int
+CLArgs::getDiskCacheSizeGiB() const
+{
+    return _imp->diskCacheSizeGiB;
+}
+
+const QString&
+CLArgs::getDiskCachePath() const
+{
+    return _imp->diskCachePath;
+}
+
+U64
+CLArgs::getMaximumMemoryUsage() const
+{
+    return _imp->maxMemoryUsage;
+}
+
+bool
+CLArgs::hasResourcesOptions() const
+{
+    return _imp->renderThreads != -1 || _imp->parallelRenders != -1 || _imp->ramCachePercent != -1 ||
+           _imp->diskCacheSizeGiB != -1 || !_imp->diskCachePath.isEmpty() || _imp->maxMemoryUsage != 0;
+}
+
 bool
 CLArgs::isPythonScript() const
 {
@@ -600,6 +696,102 @@ CLArgsPrivate::hasToken(const QString& longName,
     return args.end();
 }
 
+/**
+ * @brief If --longName is given, removes it and its value from args, and returns true.
+ * If the value is missing, sets error and returns false.
+ **/
+bool
+CLArgsPrivate::takeOptionValue(const QString& longName,
+                               QString* value)
+{
+    QStringList::iterator it = hasToken( longName, QString() );
+
+    if ( it == args.end() ) {
+        return false;
+    }
+    QStringList::iterator next = it;
+    ++next;
+    if ( next == args.end() ) {
+        std::cout << tr("You must specify a value when using the --%1 option").arg(longName).toStdString() << std::endl;
+        error = 1;
+        args.erase(it);
+
+        return false;
+    }
+    *value = *next;
+    ++next;
+    args.erase(it, next);
+
+    return true;
+}
+
+/**
+ * @brief Same as takeOptionValue for an integer value which must be in [minimum, maximum].
+ **/
+bool
+CLArgsPrivate::takeIntegerOption(const QString& longName,
+                                 int minimum,
+                                 int maximum,
+                                 int* value)
+{
+    QString str;
+
+    if ( !takeOptionValue(longName, &str) ) {
+        return false;
+    }
+    bool ok;
+    int v = str.toInt(&ok);
+    if ( !ok || (v < minimum) || (v > maximum) ) {
+        std::cout << tr("The value of the --%1 option must be an integer between %2 and %3").arg(longName).arg(minimum).arg(maximum).toStdString() << std::endl;
+        error = 1;
+
+        return false;
+    }
+    *value = v;
+
+    return true;
+}
+
+/**
+ * @brief Parses a memory size in bytes, optionally followed by a K, M, G or T suffix (powers of 1024).
+ * Returns 0 if str is not a valid size.
+ **/
+static U64
+parseMemorySize(const QString& str)
+{
+    QString number = str.trimmed();
+    U64 unit = 1;
+
+    if ( !number.isEmpty() ) {
+        switch ( number[number.size() - 1].toUpper().toLatin1() ) {
+        case 'K':
+            unit = 1024ULL;
+            break;
+        case 'M':
+            unit = 1024ULL * 1024ULL;
+            break;
+        case 'G':
+            unit = 1024ULL * 1024ULL * 1024ULL;
+            break;
+        case 'T':
+            unit = 1024ULL * 1024ULL * 1024ULL * 1024ULL;
+            break;
+        default:
+            break;
+        }
+        if (unit != 1) {
+            number.chop(1);
+        }
+    }
+    bool ok;
+    double value = number.toDouble(&ok);
+    if ( !ok || (value <= 0.) ) {
+        return 0;
+    }
+
+    return (U64)(value * unit);
+}
+
 QStringList::iterator
 CLArgsPrivate::hasOutputToken(QString& indexStr)
 {
@@ -798,6 +990,53 @@ CLArgsPrivate::parse()
         }
     }
 
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("adaptive-renders"), QString() );
+        if ( it != args.end() ) {
+            adaptiveParallelRenders = true;
+            args.erase(it);
+        }
+    }
+
+    // The resources options must be parsed before the frame ranges, which their values could be taken for
+    if ( !takeIntegerOption(QString::fromUtf8("threads"), 0, 1024, &renderThreads) && error ) {
+        return;
+    }
+    if ( !takeIntegerOption(QString::fromUtf8("parallel-renders"), 0, 1024, &parallelRenders) && error ) {
+        return;
+    }
+    if ( !takeIntegerOption(QString::fromUtf8("ram-cache"), 0, 100, &ramCachePercent) && error ) {
+        return;
+    }
+    if ( !takeIntegerOption(QString::fromUtf8("disk-cache"), 0, 100, &diskCacheSizeGiB) && error ) {
+        return;
+    }
+    {
+        QString path;
+        if ( takeOptionValue(QString::fromUtf8("cache-path"), &path) ) {
+#ifdef __NATRON_UNIX__
+            path = AppManager::qt_tildeExpansion(path);
+#endif
+            diskCachePath = path;
+        } else if (error) {
+            return;
+        }
+    }
+    {
+        QString size;
+        if ( takeOptionValue(QString::fromUtf8("max-memory"), &size) ) {
+            maxMemoryUsage = parseMemorySize(size);
+            if (maxMemoryUsage == 0) {
+                std::cout << tr("Invalid --max-memory size: %1").arg(size).toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+        } else if (error) {
+            return;
+        }
+    }
+
     {
         QStringList::iterator it = hasToken( QString::fromUtf8(NATRON_BREAKPAD_PROCESS_PID), QString() );
         if ( it != args.end() ) {
@@ -135,6 +135,25 @@ public:
 
     bool areRenderStatsEnabled() const;
 
+    bool isAdaptiveParallelRendersEnabled() const;
+
+    /*
+     * @brief The resources options override the corresponding settings for this process, without saving them.
+     * The numbers are -1 and the path is empty when the option was not given.
+     */
+    int getNumberOfRenderThreads() const;
+    int getNumberOfParallelRenders() const;
+    int getRAMCachePercent() const;
+    int getDiskCacheSizeGiB() const;
+    const QString& getDiskCachePath() const;
+
+    /*
+     * @brief The maximum resident memory of the process given with --max-memory in bytes, or 0 if unlimited.
+     */
+    U64 getMaximumMemoryUsage() const;
+
+    bool hasResourcesOptions() const;
+
     const QString& getBreakpadProcessExecutableFilePath() const;
 
     qint64 getBreakpadProcessPID() const;
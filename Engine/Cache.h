@@ -41,6 +41,7 @@
 #include "Global/StrUtils.h"
 
 GCC_DIAG_OFF(deprecated)
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
@@ -56,6 +57,7 @@ GCC_DIAG_ON(deprecated)
 
 #include "Engine/AppManager.h" //for access to settings
 #include "Engine/CacheEntry.h"
+#include "Engine/CacheIndexFile.h"
 #include "Engine/ImageLocker.h"
 #include "Engine/LRUHashTable.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM
@@ -69,6 +71,12 @@ GCC_DIAG_ON(deprecated)
 
 #define NATRON_TILE_CACHE_FILE_SIZE_BYTES 2000000000
 
+// The cache is split in 2^NATRON_CACHE_BUCKETS_N_BITS buckets, selected from the hash of the entry key.
+// Each bucket has its own locks and LRU containers so that threads looking up different entries do not
+// wait on each other. Set to 0 to get back a single-lock cache.
+#define NATRON_CACHE_BUCKETS_N_BITS 4
+#define NATRON_CACHE_BUCKETS_COUNT (1 << NATRON_CACHE_BUCKETS_N_BITS)
+
 ///When defined, number of opened files, memory size and disk size of the cache are printed whenever there's activity.
 //#define NATRON_DEBUG_CACHE
 
@@ -322,6 +330,36 @@ private:
 };
 
 
+/**
+ * @brief Same as QMutexLocker but reports whether the mutex was already taken by another thread
+ * when trying to lock it.
+ **/
+class CacheBucketLocker
+{
+    QMutex* _mutex;
+
+public:
+
+    CacheBucketLocker(QMutex* mutex,
+                      bool* contended = 0)
+        : _mutex(mutex)
+    {
+        if ( _mutex->tryLock() ) {
+            return;
+        }
+        if (contended) {
+            *contended = true;
+        }
+        _mutex->lock();
+    }
+
+    ~CacheBucketLocker()
+    {
+        _mutex->unlock();
+    }
+};
+
+
 class CacheSignalEmitter
     : public QObject
 {
@@ -392,10 +430,7 @@ public:
     typedef typename EntryType::param_t param_t;
     typedef boost::shared_ptr<param_t> ParamsTypePtr;
     typedef boost::shared_ptr<EntryType> EntryTypePtr;
-
-    struct SerializedEntry;
-
-    typedef std::list<SerializedEntry> CacheTOC;
+    typedef boost::shared_ptr<CacheIndexFile> CacheIndexFilePtr;
 
 public:
 
@@ -462,6 +497,29 @@ public:
 
 private:
 
+    struct CacheBucket
+    {
+        mutable QMutex lock; //protects memoryCache & diskCache
+        mutable QMutex getLock;  //prevents get() and getOrCreate() to be called simultaneously for entries of this bucket
+
+        /*These 2 are mutable because we need to modify the LRU list even
+             when we call get() and we want this function to be const.*/
+        mutable CacheContainer memoryCache;
+        mutable CacheContainer diskCache;
+
+        // Sorted indices of the records of the restored index file that belong to this bucket
+        // and that were not turned into entries yet, see createRestoredEntries()
+        std::vector<std::size_t> restoredRecords;
+
+        CacheBucket()
+            : lock()
+            , getLock()
+            , memoryCache()
+            , diskCache()
+            , restoredRecords()
+        {
+        }
+    };
 
     std::size_t _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
     std::size_t _maximumCacheSize;     // maximum size allowed for the cache
@@ -472,14 +530,12 @@ private:
     mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
     mutable std::size_t _diskCacheSize;
     mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
-    mutable QMutex _lock; //protects _memoryCache & _diskCache
-    mutable QMutex _getLock;  //prevents get() and getOrCreate() to be called simultaneously
 
+    // Entries are dispatched in buckets according to their hash, see getBucketIndex()
+    mutable CacheBucket _buckets[NATRON_CACHE_BUCKETS_COUNT];
 
-    /*These 2 are mutable because we need to modify the LRU list even
-         when we call get() and we want this function to be const.*/
-    mutable CacheContainer _memoryCache;
-    mutable CacheContainer _diskCache;
+    // The bucket from which the next LRU entry will be evicted. Buckets are evicted in turn.
+    mutable QAtomicInt _nextBucketToEvict;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -506,9 +562,19 @@ private:
     // Used when the cache is tiled
     std::set<TileCacheFilePtr> _cacheFiles;
 
-    // When set these are used for fast search of a free tile
-    TileCacheFileWPtr _nextAvailableCacheFile;
-    int _nextAvailableCacheFileIndex;
+    // Subset of _cacheFiles that have at least one free tile
+    std::set<TileCacheFilePtr> _cacheFilesWithFreeTiles;
+
+    // Tiles used by records of the restored index file, reserved until the entry is created. Protected by _tileCacheMutex
+    std::set<std::pair<std::string, std::size_t> > _restoredTiles;
+
+    // The index file the disk portion was restored from. It is set by restore() before the cache is used
+    // and is then only read.
+    CacheIndexFilePtr _restoredIndex;
+
+    // Creates the entry of a record of _restoredIndex. This is set by restore() since the deserialization
+    // is only available in CacheSerialization.h
+    EntryType* (*_restoredEntryCreator)(const CacheIndexFile & index, std::size_t recordIndex, const Cache* cache);
 public:
 
 
@@ -523,10 +589,8 @@ public:
         , _memoryCacheSize(0)
         , _diskCacheSize(0)
         , _sizeLock()
-        , _lock()
-        , _getLock()
-        , _memoryCache()
-        , _diskCache()
+        , _buckets()
+        , _nextBucketToEvict(0)
         , _cacheName(cacheName)
         , _version(version)
         , _signalEmitter()
@@ -540,19 +604,22 @@ public:
         , _tileByteSize(0)
         , _clearingCache(false)
         , _cacheFiles()
-        , _nextAvailableCacheFile()
-        , _nextAvailableCacheFileIndex(-1)
+        , _cacheFilesWithFreeTiles()
+        , _restoredTiles()
+        , _restoredIndex()
+        , _restoredEntryCreator(0)
     {
         _signalEmitter = boost::make_shared<CacheSignalEmitter>();
     }
 
     virtual ~Cache()
     {
-        QMutexLocker locker(&_lock);
-
         _tearingDown = true;
-        _memoryCache.clear();
-        _diskCache.clear();
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            QMutexLocker locker(&_buckets[i].lock);
+            _buckets[i].memoryCache.clear();
+            _buckets[i].diskCache.clear();
+        }
     }
 
     virtual bool isTileCache() const OVERRIDE FINAL
@@ -594,21 +661,43 @@ public:
      * this class can be used to cache other parameters along with the value_type.
      * @param [out] returnValue The returnValue, contains the cache entry if the return value
      * of the function is true, otherwise the pointer is left untouched.
+     * @param [out] lockContended If non NULL, set to true if another thread was holding the lock of the bucket
+     * of this entry when this function was called.
      * @returns True if the cache successfully found an entry matching the params.
      * False otherwise.
      **/
     bool get(const typename EntryType::key_type & key,
-             std::list<EntryTypePtr>* returnValue) const
+             std::list<EntryTypePtr>* returnValue,
+             bool* lockContended = 0) const
     {
-        ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
+        CacheBucket& bucket = _buckets[getBucketIndex( key.getHash() )];
+        bool ret;
+        bool reOpened = false;
+        {
+            ///Be atomic, so it cannot be created by another thread in the meantime
+            CacheBucketLocker getlocker(&bucket.getLock, lockContended);
 
-        ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
+            ///lock the bucket before reading it.
+            CacheBucketLocker locker(&bucket.lock, lockContended);
 
-        return getInternal(key, returnValue);
+            ret = getInternal(bucket, key, returnValue, &reOpened);
+        }
+        if (reOpened) {
+            // An entry was brought back in RAM, make sure we do not exceed the RAM limit
+            evictInMemoryEntriesExceedingLimit();
+        }
+
+        return ret;
     } // get
 
+    /**
+     * @brief Returns the index of the bucket in which entries with the given hash are stored
+     **/
+    static int getBucketIndex(hash_type hash)
+    {
+        return (int)( hash % NATRON_CACHE_BUCKETS_COUNT );
+    }
+
 private:
 
 
@@ -626,8 +715,21 @@ private:
 
                 // The dataOffset should be a multiple of the tile size
                 assert(_tileByteSize * index == dataOffset);
-                assert(!(*it)->usedTiles[index]);
-                (*it)->usedTiles[index] = true;
+                if ( (*it)->usedTiles.isUsed(index) ) {
+                    // The tile was reserved by restore() for the entry being created
+                    std::set<std::pair<std::string, std::size_t> >::iterator foundRestored = _restoredTiles.find( std::make_pair(filepath, dataOffset) );
+                    assert( foundRestored != _restoredTiles.end() );
+                    if ( foundRestored == _restoredTiles.end() ) {
+                        throw std::logic_error("getTileCacheFile() but the tile is already used!");
+                    }
+                    _restoredTiles.erase(foundRestored);
+
+                    return *it;
+                }
+                (*it)->usedTiles.setUsed(index);
+                if ( (*it)->usedTiles.isFull() ) {
+                    _cacheFilesWithFreeTiles.erase(*it);
+                }
                 return *it;
             }
         }
@@ -637,15 +739,18 @@ private:
             TileCacheFilePtr ret = boost::make_shared<TileCacheFile>();
             ret->file = boost::make_shared<MemoryFile>(filepath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail);
             std::size_t nTilesPerFile = std::floor( ( (double)NATRON_TILE_CACHE_FILE_SIZE_BYTES ) / _tileByteSize );
-            ret->usedTiles.resize(nTilesPerFile, false);
+            ret->usedTiles.resize(nTilesPerFile);
             int index = dataOffset / _tileByteSize;
 
             // The dataOffset should be a multiple of the tile size
             assert(_tileByteSize * index == dataOffset);
             assert(index >= 0 && index < (int)ret->usedTiles.size());
-            assert(!ret->usedTiles[index]);
-            ret->usedTiles[index] = true;
+            assert(!ret->usedTiles.isUsed(index));
+            ret->usedTiles.setUsed(index);
             _cacheFiles.insert(ret);
+            if ( !ret->usedTiles.isFull() ) {
+                _cacheFilesWithFreeTiles.insert(ret);
+            }
             return ret;
 
         }
@@ -669,39 +774,17 @@ private:
         if (!_isTiled) {
             throw std::logic_error("allocTile() but cache is not tiled!");
         }
-        // First, search for a file with available space.
+        // First, take a file with available space.
         // If not found create one
         TileCacheFilePtr foundAvailableFile;
         int foundTileIndex = -1;
-        {
-            foundAvailableFile = _nextAvailableCacheFile.lock();
-            if (_nextAvailableCacheFileIndex != -1 && foundAvailableFile) {
-                foundTileIndex = _nextAvailableCacheFileIndex;
-                *dataOffset = foundTileIndex * _tileByteSize;
-                _nextAvailableCacheFileIndex = -1;
-                _nextAvailableCacheFile.reset();
-            } else {
-                foundTileIndex = -1;
-                foundAvailableFile.reset();
-            }
-        }
-        if (foundTileIndex == -1) {
-            for (std::set<TileCacheFilePtr>::iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
-                for (std::size_t i = 0; i < (*it)->usedTiles.size(); ++i) {
-                    if (!(*it)->usedTiles[i])  {
-                        foundTileIndex = i;
-                        *dataOffset = i * _tileByteSize;
-                        break;
-                    }
-                }
-                if (foundTileIndex != -1) {
-                    foundAvailableFile = *it;
-                    break;
-                }
-            }
+        if ( !_cacheFilesWithFreeTiles.empty() ) {
+            foundAvailableFile = *_cacheFilesWithFreeTiles.begin();
+            foundTileIndex = foundAvailableFile->usedTiles.allocate();
+            assert(foundTileIndex != -1);
         }
 
-        if (!foundAvailableFile) {
+        if (foundTileIndex == -1) {
             // Create a file if all space is taken
             foundAvailableFile = boost::make_shared<TileCacheFile>();
             int nCacheFiles = (int)_cacheFiles.size();
@@ -713,16 +796,19 @@ private:
             std::size_t nTilesPerFile = std::floor(((double)NATRON_TILE_CACHE_FILE_SIZE_BYTES) / _tileByteSize);
             std::size_t cacheFileSize = nTilesPerFile * _tileByteSize;
             foundAvailableFile->file->resize(cacheFileSize);
-            foundAvailableFile->usedTiles.resize(nTilesPerFile, false);
-            *dataOffset = 0;
-            foundTileIndex = 0;
+            foundAvailableFile->usedTiles.resize(nTilesPerFile);
+            foundTileIndex = foundAvailableFile->usedTiles.allocate();
+            assert(foundTileIndex == 0);
             _cacheFiles.insert(foundAvailableFile);
-            _nextAvailableCacheFile = foundAvailableFile;
-            _nextAvailableCacheFileIndex = 1;
+            _cacheFilesWithFreeTiles.insert(foundAvailableFile);
         }
 
-        // Notify the memory file that this portion of the file is valid
-        foundAvailableFile->usedTiles[foundTileIndex] = true;
+        if ( foundAvailableFile->usedTiles.isFull() ) {
+            _cacheFilesWithFreeTiles.erase(foundAvailableFile);
+        }
+
+        *dataOffset = foundTileIndex * _tileByteSize;
+
         return foundAvailableFile;
     }
 
@@ -747,34 +833,79 @@ private:
         // The dataOffset should be a multiple of the tile size
         assert(_tileByteSize * index == dataOffset);
         assert(index >= 0 && index < (int)(*foundTileFile)->usedTiles.size());
-        assert((*foundTileFile)->usedTiles[index]);
-        (*foundTileFile)->usedTiles[index] = false;
+        assert((*foundTileFile)->usedTiles.isUsed(index));
+        (*foundTileFile)->usedTiles.setFree(index);
+        _cacheFilesWithFreeTiles.insert(*foundTileFile);
 
         // If the file does not have any tile associated, remove it
-        // A use_count of 2 means that the tile file is only referenced by the cache itself and the entry calling
-        // the freeTile() function, hence once its freed, no tile should be using it anymore
-        if ((*foundTileFile).use_count() <= 2) {
+        // A use_count of 3 means that the tile file is only referenced by the cache itself (_cacheFiles and _cacheFilesWithFreeTiles)
+        // and the entry calling the freeTile() function, hence once its freed, no tile should be using it anymore
+        if ((*foundTileFile).use_count() <= 3) {
             // Do not remove the file except if we are clearing the cache
             if (_clearingCache) {
                 (*foundTileFile)->file->remove();
+                _cacheFilesWithFreeTiles.erase(*foundTileFile);
                 _cacheFiles.erase(foundTileFile);
             } else {
                 // Invalidate this portion of the cache
                 (*foundTileFile)->file->flush(MemoryFile::eFlushTypeInvalidate, (*foundTileFile)->file->data() + dataOffset, _tileByteSize);
             }
-        } else {
-            _nextAvailableCacheFile = *foundTileFile;
-            _nextAvailableCacheFileIndex = index;
         }
     }
 
+    /**
+     * @brief Marks used the tile of a record of the restored index file so that it is not allocated to another entry
+     * before the entry of the record is created. Returns false if the tile cache file does not exist.
+     * This function may throw exceptions in case of failure.
+     **/
+    bool reserveRestoredTile(const std::string& filepath, std::size_t dataOffset)
+    {
+        if ( !getTileCacheFile(filepath, dataOffset) ) {
+            return false;
+        }
+        QMutexLocker k(&_tileCacheMutex);
+        _restoredTiles.insert( std::make_pair(filepath, dataOffset) );
+
+        return true;
+    }
+
+    /**
+     * @brief Frees a tile reserved by reserveRestoredTile() whose entry will never be created.
+     **/
+    void releaseRestoredTile(const std::string& filepath, std::size_t dataOffset)
+    {
+        QMutexLocker k(&_tileCacheMutex);
+
+        if ( !_restoredTiles.erase( std::make_pair(filepath, dataOffset) ) ) {
+            return;
+        }
+        for (std::set<TileCacheFilePtr>::iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+            if ((*it)->file->path() == filepath) {
+                int index = dataOffset / _tileByteSize;
+                (*it)->usedTiles.setFree(index);
+                _cacheFilesWithFreeTiles.insert(*it);
+
+                // Same as freeTile(): only remove the file if we are clearing the cache
+                if ( _clearingCache && (*it)->usedTiles.isEmpty() ) {
+                    (*it)->file->remove();
+                    _cacheFilesWithFreeTiles.erase(*it);
+                    _cacheFiles.erase(it);
+                }
 
-    void createInternal(const typename EntryType::key_type & key,
+                return;
+            }
+        }
+    }
+
+
+    void createInternal(CacheBucket& bucket,
+                        const typename EntryType::key_type & key,
                         const ParamsTypePtr & params,
                         ImageLockerHelper<EntryType>* entryLocker,
-                        EntryTypePtr* returnValue) const
+                        EntryTypePtr* returnValue,
+                        bool* lockContended) const
     {
-        //_lock must not be taken here
+        //No bucket lock must be taken here, only the getLock of the bucket
 
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
@@ -800,14 +931,13 @@ private:
             maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
         }
         {
-            QMutexLocker locker(&_lock);
             std::list<EntryTypePtr> entriesToBeDeleted;
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             ///While the current cache size can't fit the new entry, erase the last recently used entries.
             ///Also if the total free RAM is under the limit of the system free RAM to keep free, erase LRU entries.
             while (occupationPercentage > NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyBucket(deleted) ) {
                     break;
                 }
 
@@ -842,7 +972,6 @@ private:
         }
         if (_isTiled) {
 
-            QMutexLocker locker(&_lock);
             // For tiled caches, we insert directly into the disk cache, so make sure there is room for it
             std::list<EntryTypePtr> entriesToBeDeleted;
             U64 diskCacheSize, maximumDiskCacheSize;
@@ -854,10 +983,12 @@ private:
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
+                std::size_t discardedRestoredSize = 0;
+                if ( !tryEvictDiskEntryFromAnyBucket(deleted, &discardedRestoredSize) ) {
                     break;
                 }
 
+                diskCacheSize = discardedRestoredSize > diskCacheSize ? 0 : diskCacheSize - discardedRestoredSize;
                 for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
                     diskCacheSize -= (*it)->size();
                     entriesToBeDeleted.push_back(*it);
@@ -875,7 +1006,7 @@ private:
 
         }
         {
-            QMutexLocker locker(&_lock);
+            CacheBucketLocker locker(&bucket.lock, lockContended);
 
             try {
                 returnValue->reset( new EntryType(key, params, this ) );
@@ -894,7 +1025,7 @@ private:
                 if (entryLocker) {
                     entryLocker->lock(*returnValue);
                 }
-                sealEntry(*returnValue, _isTiled ? false : true);
+                sealEntry(bucket, *returnValue, _isTiled ? false : true);
             }
         }
     } // createInternal
@@ -904,13 +1035,14 @@ public:
     void swapOrInsert(const EntryTypePtr& entryToBeEvicted,
                       const EntryTypePtr& newEntry)
     {
-        QMutexLocker locker(&_lock);
-
         const typename EntryType::key_type& key = entryToBeEvicted->getKey();
         typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
+        CacheBucket& bucket = _buckets[getBucketIndex(hash)];
+        CacheBucketLocker locker(&bucket.lock);
+
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache(hash);
-        if ( memoryCached != _memoryCache.end() ) {
+        CacheIterator memoryCached = bucket.memoryCache(hash);
+        if ( memoryCached != bucket.memoryCache.end() ) {
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( ( (*it)->getKey() == key ) && ( (*it)->getParams() == entryToBeEvicted->getParams() ) ) {
@@ -922,8 +1054,8 @@ public:
             ret.push_back(newEntry);
         } else {
             ///Look in disk cache
-            CacheIterator diskCached = _diskCache(hash);
-            if ( diskCached != _diskCache.end() ) {
+            CacheIterator diskCached = bucket.diskCache(hash);
+            if ( diskCached != bucket.diskCache.end() ) {
                 ///Remove the old entry
                 std::list<EntryTypePtr> & ret = getValueFromIterator(diskCached);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
@@ -934,7 +1066,7 @@ public:
                 }
             }
             ///Insert in mem cache
-            _memoryCache.insert(hash, newEntry);
+            bucket.memoryCache.insert(hash, newEntry);
         }
     }
 
@@ -962,40 +1094,55 @@ public:
      * on RAM instead.
      *
      * Either way the returnValue parameter can never be NULL.
+     *
+     * @param [out] lockContended If non NULL, set to true if another thread was holding the lock of the bucket
+     * of this entry when this function was called.
+     *
      * @returns True if the cache successfully found an entry matching the key.
      * False otherwise.
      **/
     bool getOrCreate(const typename EntryType::key_type & key,
                      const ParamsTypePtr & params,
                      ImageLockerHelper<EntryType>* locker,
-                     EntryTypePtr* returnValue) const
+                     EntryTypePtr* returnValue,
+                     bool* lockContended = 0) const
     {
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
 
+        CacheBucket& bucket = _buckets[getBucketIndex( key.getHash() )];
+        bool reOpened = false;
+        bool found = false;
         {
             ///Be atomic, so it cannot be created by another thread in the meantime
-            QMutexLocker getlocker(&_getLock);
+            CacheBucketLocker getlocker(&bucket.getLock, lockContended);
             std::list<EntryTypePtr> entries;
             bool didGetSucceed;
             {
-                QMutexLocker locker(&_lock);
-                didGetSucceed = getInternal(key, &entries);
+                CacheBucketLocker locker(&bucket.lock, lockContended);
+                didGetSucceed = getInternal(bucket, key, &entries, &reOpened);
             }
             if (didGetSucceed) {
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
                     if (*(*it)->getParams() == *params) {
                         *returnValue = *it;
-
-                        return true;
+                        found = true;
+                        break;
                     }
                 }
             }
 
-            createInternal(key, params, locker, returnValue);
-
-            return false;
+            if (!found) {
+                createInternal(bucket, key, params, locker, returnValue, lockContended);
+            }
         } // getlocker
+
+        if (reOpened) {
+            // An entry was brought back in RAM, make sure we do not exceed the RAM limit
+            evictInMemoryEntriesExceedingLimit();
+        }
+
+        return found;
     }
 
     /**
@@ -1014,13 +1161,16 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->removeAnyBackingFile();
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            CacheBucketLocker locker(&bucket.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = bucket.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
+                    evictedFromMemory.second->removeAnyBackingFile();
+                }
+                evictedFromMemory = bucket.memoryCache.evict();
             }
-            evictedFromMemory = _memoryCache.evict();
         }
 
         if (_signalEmitter) {
@@ -1044,19 +1194,26 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            CacheBucketLocker locker(&bucket.lock);
 
-        /// An entry which has a use_count greater than 1 is not removable:
-        /// The backing file must not be removed because it might be read/written to
-        /// at the same time. The best we can do is just let it here in the cache.
-        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        while (evictedFromDisk.second) {
-            if (!_isTiled) {
-                evictedFromDisk.second->removeAnyBackingFile();
+            while ( !bucket.restoredRecords.empty() ) {
+                discardLastRestoredRecord(bucket);
+            }
+
+            /// An entry which has a use_count greater than 1 is not removable:
+            /// The backing file must not be removed because it might be read/written to
+            /// at the same time. The best we can do is just let it here in the cache.
+            std::pair<hash_type, EntryTypePtr> evictedFromDisk = bucket.diskCache.evict();
+            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+            //we'll let the user of these entries purge the extra entries left in the cache later on
+            while (evictedFromDisk.second) {
+                if (!_isTiled) {
+                    evictedFromDisk.second->removeAnyBackingFile();
+                }
+                evictedFromDisk = bucket.diskCache.evict();
             }
-            evictedFromDisk = _diskCache.evict();
         }
 
 
@@ -1073,52 +1230,37 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            // Move back the entry on disk if it can be store on disk
-            // For tiled caches, the tile is sharing the same file with other entries
-            // so we cannot close it, just remove the entry
-            if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
-
-                U64 diskCacheSize, maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    {
-                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                        //we'll let the user of these entries purge the extra entries left in the cache later on
-                        if (!evictedFromDisk.second) {
-                            break;
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            bool movedToDisk = false;
+            {
+                CacheBucketLocker locker(&bucket.lock);
+                std::pair<hash_type, EntryTypePtr> evictedFromMemory = bucket.memoryCache.evict();
+                while (evictedFromMemory.second) {
+                    // Move back the entry on disk if it can be store on disk
+                    // For tiled caches, the tile is sharing the same file with other entries
+                    // so we cannot close it, just remove the entry
+                    if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
+                        evictedFromMemory.second->deallocate();
+                        /*insert it back into the disk portion */
+                        CacheIterator existingDiskCacheEntry = bucket.diskCache( evictedFromMemory.second->getHashKey() );
+                        /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+                        if ( existingDiskCacheEntry == bucket.diskCache.end() ) {
+                            bucket.diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
                         }
-                        ///Erase the file from the disk if we reach the limit.
-                        evictedFromDisk.second->removeAnyBackingFile();
+                        movedToDisk = true;
                     }
-                    {
-                        QMutexLocker k(&_sizeLock);
-                        diskCacheSize = _diskCacheSize;
-                        maximumCacheSize = _maximumCacheSize;
-                    }
-                }
 
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                    evictedFromMemory = bucket.memoryCache.evict();
                 }
             }
-
-            evictedFromMemory = _memoryCache.evict();
+            if (movedToDisk) {
+                // The disk portion may now exceed its limit: evict from all buckets, not just this one
+                evictDiskEntriesExceedingLimit(entriesToBeDeleted);
+            }
         }
+        entriesToBeDeleted.clear();
 
         _signalEmitter->blockSignals(false);
         if (emitSignals) {
@@ -1133,7 +1275,6 @@ public:
         std::list<EntryTypePtr> entriesToBeDeleted;
 
         {
-            QMutexLocker locker(&_lock);
             U64 memoryCacheSize, maximumInMemorySize;
             {
                 QMutexLocker k(&_sizeLock);
@@ -1143,7 +1284,7 @@ public:
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             while (occupationPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyBucket(deleted) ) {
                     break;
                 }
 
@@ -1165,10 +1306,12 @@ public:
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
+                std::size_t discardedRestoredSize = 0;
+                if ( !tryEvictDiskEntryFromAnyBucket(deleted, &discardedRestoredSize) ) {
                     break;
                 }
 
+                diskCacheSize = discardedRestoredSize > diskCacheSize ? 0 : diskCacheSize - discardedRestoredSize;
                 for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
                     diskCacheSize -= (*it)->size();
                     entriesToBeDeleted.push_back(*it);
@@ -1187,15 +1330,18 @@ public:
      **/
     void getCopy(std::list<EntryTypePtr>* copy) const
     {
-        QMutexLocker locker(&_lock);
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            CacheBucketLocker locker(&bucket.lock);
 
-        for (CacheIterator it = _memoryCache.begin(); it != _memoryCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
-        }
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
+            for (CacheIterator it = bucket.memoryCache.begin(); it != bucket.memoryCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = bucket.diskCache.begin(); it != bucket.diskCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
         }
     }
 
@@ -1209,13 +1355,8 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
-        bool ret;
-        {
-            QMutexLocker locker(&_lock);
-            ret = tryEvictInMemoryEntry(entriesToBeDeleted);
-        }
 
-        return ret;
+        return tryEvictInMemoryEntryFromAnyBucket(entriesToBeDeleted);
     }
 
     /**
@@ -1225,10 +1366,9 @@ public:
      **/
     bool evictLRUDiskEntry() const
     {
-
-        QMutexLocker locker(&_lock);
         std::list<EntryTypePtr> entriesToBeDeleted;
-        return tryEvictDiskEntry(entriesToBeDeleted);
+
+        return tryEvictDiskEntryFromAnyBucket(entriesToBeDeleted, 0);
     }
 
     /**
@@ -1468,9 +1608,10 @@ public:
         std::list<EntryTypePtr> toRemove;
 
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( entry->getHashKey() );
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheBucket& bucket = _buckets[getBucketIndex( entry->getHashKey() )];
+            CacheBucketLocker l(&bucket.lock);
+            CacheIterator existingEntry = bucket.memoryCache( entry->getHashKey() );
+            if ( existingEntry != bucket.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( (*it)->getKey() == entry->getKey() ) {
@@ -1480,11 +1621,11 @@ public:
                     }
                 }
                 if ( ret.empty() ) {
-                    _memoryCache.erase(existingEntry);
+                    bucket.memoryCache.erase(existingEntry);
                 }
             } else {
-                existingEntry = _diskCache( entry->getHashKey() );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = bucket.diskCache( entry->getHashKey() );
+                if ( existingEntry != bucket.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         if ( (*it)->getKey() == entry->getKey() ) {
@@ -1494,11 +1635,11 @@ public:
                         }
                     }
                     if ( ret.empty() ) {
-                        _diskCache.erase(existingEntry);
+                        bucket.diskCache.erase(existingEntry);
                     }
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // CacheBucketLocker l(&bucket.lock);
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
 
@@ -1512,25 +1653,26 @@ public:
     {
         std::list<EntryTypePtr> toRemove;
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( hash);
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheBucket& bucket = _buckets[getBucketIndex(hash)];
+            CacheBucketLocker l(&bucket.lock);
+            CacheIterator existingEntry = bucket.memoryCache( hash);
+            if ( existingEntry != bucket.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     toRemove.push_back(*it);
                 }
-                _memoryCache.erase(existingEntry);
+                bucket.memoryCache.erase(existingEntry);
             } else {
-                existingEntry = _diskCache( hash );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = bucket.diskCache( hash );
+                if ( existingEntry != bucket.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         toRemove.push_back(*it);
                     }
-                    _diskCache.erase(existingEntry);
+                    bucket.diskCache.erase(existingEntry);
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // CacheBucketLocker l(&bucket.lock);
 
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
@@ -1541,13 +1683,25 @@ public:
         }
     }
 
-    /*Saves cache to disk as a settings file.
-     */
-    void save(CacheTOC* tableOfContents);
+    /**
+     * @brief Saves the table of contents of the disk portion of the cache to an index file, see CacheIndexFile.
+     * Returns false and sets error on failure.
+     **/
+    bool save(const std::string & indexFilePath, std::string* error);
+
+
+    /**
+     * @brief Restores the disk portion of the cache from an index file. The entries are not created here:
+     * the index is used directly for look-ups and the entries are created the first time they are requested.
+     * This must be called before the cache is used.
+     **/
+    void restore(const CacheIndexFilePtr & index);
+
+private:
 
+    static EntryType* createRestoredEntry(const CacheIndexFile & index, std::size_t recordIndex, const Cache* cache);
 
-    /*Restores the cache from disk.*/
-    void restore(const CacheTOC & tableOfContents);
+public:
 
 
     void removeAllEntriesWithDifferentNodeHashForHolderPublic(const CacheEntryHolder* holder,
@@ -1574,32 +1728,41 @@ public:
         *diskOccupied = 0;
 
         std::string holderID = holder->getCacheID();
-        QMutexLocker locker(&_lock);
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            CacheBucketLocker locker(&bucket.lock);
 
-        for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (CacheIterator memIt = bucket.memoryCache.begin(); memIt != bucket.memoryCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *ramOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *ramOccupied += (*it)->size();
+                        }
                     }
                 }
             }
-        }
 
-        for (CacheIterator memIt = _diskCache.begin(); memIt != _diskCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (CacheIterator memIt = bucket.diskCache.begin(); memIt != bucket.diskCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *diskOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *diskOccupied += (*it)->size();
+                        }
                     }
                 }
             }
+
+            for (std::size_t j = 0; j < bucket.restoredRecords.size(); ++j) {
+                if ( _restoredIndex->hasHolderID(bucket.restoredRecords[j], holderID) ) {
+                    *diskOccupied += _restoredIndex->getRecord(bucket.restoredRecords[j]).dataSize;
+                }
+            }
         }
     }
 
@@ -1610,11 +1773,13 @@ private:
                                                                        bool removeAll) OVERRIDE FINAL
     {
         std::list<EntryTypePtr> toDelete;
-        CacheContainer newMemCache, newDiskCache;
-        {
-            QMutexLocker locker(&_lock);
 
-            for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[i];
+            CacheContainer newMemCache, newDiskCache;
+            CacheBucketLocker locker(&bucket.lock);
+
+            for (CacheIterator memIt = bucket.memoryCache.begin(); memIt != bucket.memoryCache.end(); ++memIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1631,7 +1796,7 @@ private:
                 }
             }
 
-            for (CacheIterator dIt = _diskCache.begin(); dIt != _diskCache.end(); ++dIt) {
+            for (CacheIterator dIt = bucket.diskCache.begin(); dIt != bucket.diskCache.end(); ++dIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(dIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1648,9 +1813,21 @@ private:
                 }
             }
 
-            _memoryCache = newMemCache;
-            _diskCache = newDiskCache;
-        } // QMutexLocker locker(&_lock);
+            bucket.memoryCache = newMemCache;
+            bucket.diskCache = newDiskCache;
+
+            std::vector<std::size_t> remainingRestoredRecords;
+            for (std::size_t j = 0; j < bucket.restoredRecords.size(); ++j) {
+                std::size_t recordIndex = bucket.restoredRecords[j];
+                if ( ( ( _restoredIndex->getRecord(recordIndex).treeVersion != nodeHash ) || removeAll ) &&
+                     _restoredIndex->hasHolderID(recordIndex, holderID) ) {
+                    discardRestoredRecord(recordIndex);
+                } else {
+                    remainingRestoredRecords.push_back(recordIndex);
+                }
+            }
+            bucket.restoredRecords.swap(remainingRestoredRecords);
+        } // for each bucket
 
         if ( !toDelete.empty() ) {
             _deleterThread.appendToQueue(toDelete);
@@ -1661,16 +1838,27 @@ private:
         }
     } // removeAllEntriesWithDifferentNodeHashForHolderPrivate
 
-    bool getInternal(const typename EntryType::key_type & key,
-                     std::list<EntryTypePtr>* returnValue) const
+    /**
+     * @brief Look-up the given bucket for entries matching the key.
+     * @param [out] reOpened Set to true if an entry was moved from the disk portion back to RAM. The caller
+     * should then call evictInMemoryEntriesExceedingLimit() once the bucket lock is released.
+     **/
+    bool getInternal(CacheBucket& bucket,
+                     const typename EntryType::key_type & key,
+                     std::list<EntryTypePtr>* returnValue,
+                     bool* reOpened) const
     {
         ///Private should be locked
-        assert( !_lock.tryLock() );
+        assert( !bucket.lock.tryLock() );
+
+        if ( !bucket.restoredRecords.empty() ) {
+            createRestoredEntries( bucket, key.getHash() );
+        }
 
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache( key.getHash() );
+        CacheIterator memoryCached = bucket.memoryCache( key.getHash() );
 
-        if ( memoryCached != _memoryCache.end() ) {
+        if ( memoryCached != bucket.memoryCache.end() ) {
             ///we found something with a matching hash key. There may be several entries linked to
             ///this key, we need to find one with matching params
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
@@ -1689,9 +1877,9 @@ private:
             return returnValue->size() > 0;
         } else {
             ///fallback on the disk cache internal container
-            CacheIterator diskCached = _diskCache( key.getHash() );
+            CacheIterator diskCached = bucket.diskCache( key.getHash() );
 
-            if ( diskCached == _diskCache.end() ) {
+            if ( diskCached == bucket.diskCache.end() ) {
                 /*the entry was neither in memory or disk, just allocate a new one*/
                 return false;
             } else {
@@ -1723,29 +1911,11 @@ private:
                             }
 
                             //put it back into the RAM
-                            _memoryCache.insert( (*it)->getHashKey(), *it );
-
+                            bucket.memoryCache.insert( (*it)->getHashKey(), *it );
 
-                            U64 memoryCacheSize, maximumInMemorySize;
-                            {
-                                QMutexLocker k(&_sizeLock);
-                                memoryCacheSize = _memoryCacheSize;
-                                maximumInMemorySize = _maximumInMemorySize;
-                            }
-                            std::list<EntryTypePtr> entriesToBeDeleted;
-
-                            //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
-                            while (memoryCacheSize > maximumInMemorySize) {
-                                if ( !tryEvictInMemoryEntry(entriesToBeDeleted) ) {
-                                    break;
-                                }
-
-                                {
-                                    QMutexLocker k(&_sizeLock);
-                                    memoryCacheSize = _memoryCacheSize;
-                                    maximumInMemorySize = _maximumInMemorySize;
-                                }
-                            }
+                            //extra entries will be cleared by the caller once the bucket is unlocked
+                            //so it doesn't exceed the RAM limit.
+                            *reOpened = true;
                         }
                         
                         returnValue->push_back(*it);
@@ -1760,7 +1930,7 @@ private:
                             ret.erase(it);
 
                             ///Remove it from the disk cache
-                            _diskCache.erase(diskCached);
+                            bucket.diskCache.erase(diskCached);
                         }
 
                         return true;
@@ -1774,28 +1944,153 @@ private:
         }
     } // getInternal
 
+    /**
+     * @brief Creates the entries of the records of the restored index file with the given hash and inserts them
+     * in the disk portion of the bucket.
+     **/
+    void createRestoredEntries(CacheBucket& bucket,
+                               hash_type hash) const
+    {
+        assert( !bucket.lock.tryLock() );
+
+        std::size_t first, last;
+        _restoredIndex->findRecords(hash, &first, &last);
+        for (std::size_t i = first; i < last; ++i) {
+            std::vector<std::size_t>::iterator found = std::lower_bound(bucket.restoredRecords.begin(), bucket.restoredRecords.end(), i);
+            if ( ( found == bucket.restoredRecords.end() ) || (*found != i) ) {
+                // Already created or discarded
+                continue;
+            }
+            bucket.restoredRecords.erase(found);
+
+            EntryTypePtr entry;
+            try {
+                entry.reset( _restoredEntryCreator(*_restoredIndex, i, this) );
+            } catch (const std::exception & e) {
+                qDebug() << "Error while restoring cache entry:" << e.what();
+            }
+            if (!entry) {
+                discardRestoredRecord(i);
+                continue;
+            }
+
+            const CacheIndexFile::Record & record = _restoredIndex->getRecord(i);
+            try {
+                ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
+                entry->restoreMetadataFromFile(record.dataSize, _restoredIndex->getFilePath(i), record.dataOffsetInFile);
+            } catch (const std::exception & e) {
+                qDebug() << "Error while restoring cache entry:" << e.what();
+                if ( !entry->isAllocated() ) {
+                    // Release the reserved tile or remove the data file
+                    discardRestoredRecord(i);
+                }
+                // Otherwise the entry got the tile: it frees it and removes its size from the disk portion when destroyed
+
+                continue;
+            }
+            {
+                // restoreMetadataFromFile() accounted for the size of the entry again
+                QMutexLocker k(&_sizeLock);
+                _diskCacheSize = record.dataSize > _diskCacheSize ? 0 : _diskCacheSize - record.dataSize;
+            }
+            sealEntry(bucket, entry, false /*inMemory*/);
+        }
+    }
+
+    /**
+     * @brief Removes the data of a record of the restored index file whose entry will never be created.
+     * Returns the size of the data.
+     **/
+    std::size_t discardRestoredRecord(std::size_t recordIndex) const
+    {
+        const CacheIndexFile::Record & record = _restoredIndex->getRecord(recordIndex);
+        std::string filePath = _restoredIndex->getFilePath(recordIndex);
+
+        if (_isTiled) {
+            const_cast<Cache*>(this)->releaseRestoredTile(filePath, record.dataOffsetInFile);
+        } else {
+            int ret_code = std::remove( filePath.c_str() );
+            Q_UNUSED(ret_code);
+        }
+        {
+            QMutexLocker k(&_sizeLock);
+            _diskCacheSize = record.dataSize > _diskCacheSize ? 0 : _diskCacheSize - record.dataSize;
+        }
+
+        return record.dataSize;
+    }
+
+    std::size_t discardLastRestoredRecord(CacheBucket& bucket) const
+    {
+        assert( !bucket.lock.tryLock() );
+        assert( !bucket.restoredRecords.empty() );
+        std::size_t recordIndex = bucket.restoredRecords.back();
+        bucket.restoredRecords.pop_back();
+
+        return discardRestoredRecord(recordIndex);
+    }
+
+    /**
+     * @brief Evicts LRU entries from the in-memory portion until it fits within the maximum in-memory size.
+     * No bucket lock must be taken when calling this.
+     **/
+    void evictInMemoryEntriesExceedingLimit() const
+    {
+        U64 memoryCacheSize, maximumInMemorySize;
+        {
+            QMutexLocker k(&_sizeLock);
+            memoryCacheSize = _memoryCacheSize;
+            maximumInMemorySize = _maximumInMemorySize;
+        }
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        while (memoryCacheSize > maximumInMemorySize) {
+            std::list<EntryTypePtr> deleted;
+            if ( !tryEvictInMemoryEntryFromAnyBucket(deleted) ) {
+                break;
+            }
+
+            for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                entriesToBeDeleted.push_back(*it);
+            }
+            {
+                QMutexLocker k(&_sizeLock);
+                memoryCacheSize = _memoryCacheSize;
+                maximumInMemorySize = _maximumInMemorySize;
+            }
+            // Entries that are not yet destroyed are still accounted for in _memoryCacheSize
+            for (typename std::list<EntryTypePtr>::iterator it = entriesToBeDeleted.begin(); it != entriesToBeDeleted.end(); ++it) {
+                std::size_t entrySize = (*it)->size();
+                memoryCacheSize = entrySize > memoryCacheSize ? 0 : memoryCacheSize - entrySize;
+            }
+        }
+        if ( !entriesToBeDeleted.empty() ) {
+            _deleterThread.appendToQueue(entriesToBeDeleted);
+        }
+    }
+
     /** @brief Inserts into the cache an entry that was previously allocated by the createInternal()
      * function. This is called directly by createInternal() if the allocation was successful
      **/
-    void sealEntry(const EntryTypePtr & entry,
+    void sealEntry(CacheBucket& bucket,
+                   const EntryTypePtr & entry,
                    bool inMemory) const
     {
-        assert( !_lock.tryLock() );   // must be locked
+        assert( !bucket.lock.tryLock() );   // must be locked
         typename EntryType::hash_type hash = entry->getHashKey();
 
         if (inMemory) {
             /*if the entry doesn't exist on the memory cache,make a new list and insert it*/
-            CacheIterator existingEntry = _memoryCache(hash);
-            if ( existingEntry == _memoryCache.end() ) {
-                _memoryCache.insert(hash, entry);
+            CacheIterator existingEntry = bucket.memoryCache(hash);
+            if ( existingEntry == bucket.memoryCache.end() ) {
+                bucket.memoryCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
             }
         } else {
-            CacheIterator existingEntry = _diskCache(hash);
-            if ( existingEntry == _diskCache.end() ) {
-                _diskCache.insert(hash, entry);
+            CacheIterator existingEntry = bucket.diskCache(hash);
+            if ( existingEntry == bucket.diskCache.end() ) {
+                bucket.diskCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
@@ -1803,10 +2098,90 @@ private:
         }
     }
 
-    bool tryEvictInMemoryEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    /**
+     * @brief Evicts the LRU entry of the in-memory portion of the next bucket that has an evictable entry.
+     * Buckets are visited in turn so that eviction is spread evenly across buckets.
+     * No bucket lock must be taken when calling this.
+     **/
+    bool tryEvictInMemoryEntryFromAnyBucket(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        unsigned int startIndex = (unsigned int)_nextBucketToEvict.fetchAndAddRelaxed(1);
+
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[(startIndex + i) % NATRON_CACHE_BUCKETS_COUNT];
+            bool movedToDisk = false;
+            {
+                CacheBucketLocker locker(&bucket.lock);
+                if ( !tryEvictInMemoryEntry(bucket, entriesToBeDeleted, &movedToDisk) ) {
+                    continue;
+                }
+            }
+            if (movedToDisk) {
+                // The disk portion may now exceed its limit: evict from all buckets, not just this one
+                evictDiskEntriesExceedingLimit(entriesToBeDeleted);
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Evicts LRU entries from the disk portion until it fits within the maximum disk size.
+     * Entries are evicted from any bucket against the size of the whole disk portion: a bucket receiving
+     * most of the entries does not evict its own entries while the cache as a whole is under budget.
+     * This is only used for caches that are not tiled, whose evicted entries remove their file right away.
+     * No bucket lock must be taken when calling this.
+     **/
+    void evictDiskEntriesExceedingLimit(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        for (;;) {
+            {
+                // Evicted entries and discarded records of the restored index file are removed from _diskCacheSize
+                // as soon as they are evicted
+                QMutexLocker k(&_sizeLock);
+                std::size_t maximumDiskCacheSize = _maximumCacheSize > _maximumInMemorySize ? _maximumCacheSize - _maximumInMemorySize : 0;
+                if (_diskCacheSize <= maximumDiskCacheSize) {
+                    return;
+                }
+            }
+            std::size_t discardedRestoredSize = 0;
+            if ( !tryEvictDiskEntryFromAnyBucket(entriesToBeDeleted, &discardedRestoredSize) ) {
+                //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+                //we'll let the user of these entries purge the extra entries left in the cache later on
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Same as tryEvictInMemoryEntryFromAnyBucket() but for the disk portion.
+     * If discardedRestoredSize is not NULL, records of the restored index file may be discarded instead of
+     * an entry, in which case their size is added to discardedRestoredSize.
+     **/
+    bool tryEvictDiskEntryFromAnyBucket(std::list<EntryTypePtr> & entriesToBeDeleted,
+                                        std::size_t* discardedRestoredSize) const
+    {
+        unsigned int startIndex = (unsigned int)_nextBucketToEvict.fetchAndAddRelaxed(1);
+
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            CacheBucket& bucket = _buckets[(startIndex + i) % NATRON_CACHE_BUCKETS_COUNT];
+            CacheBucketLocker locker(&bucket.lock);
+            if ( tryEvictDiskEntry(bucket, entriesToBeDeleted, discardedRestoredSize) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool tryEvictInMemoryEntry(CacheBucket& bucket,
+                               std::list<EntryTypePtr> & entriesToBeDeleted,
+                               bool* movedToDisk) const
     {
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _memoryCache.evict();
+        assert( !bucket.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = bucket.memoryCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
@@ -1825,59 +2200,36 @@ private:
             ///This is EXPENSIVE! it calls msync
             evicted.second->deallocate();
 
-            /*insert it back into the disk portion */
-
-            U64 diskCacheSize, maximumCacheSize, maximumInMemorySize;
-            {
-                QMutexLocker k(&_sizeLock);
-                diskCacheSize = _diskCacheSize;
-                maximumInMemorySize = _maximumInMemorySize;
-                maximumCacheSize = _maximumCacheSize;
-            }
-
-            /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-            while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
-                std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                //we'll let the user of these entries purge the extra entries left in the cache later on
-                if (!evictedFromDisk.second) {
-                    break;
-                }
-
-                ///Erase the file from the disk if we reach the limit.
-                evictedFromDisk.second->removeAnyBackingFile();
-
-                entriesToBeDeleted.push_back(evictedFromDisk.second);
-
-                {
-                    QMutexLocker k(&_sizeLock);
-                    maximumInMemorySize = _maximumInMemorySize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
-                //The entry is not yet deleted for real since it's done in a separate thread when this function
-                ///size() will return 0 at this point, we have to recompute it
-                std::size_t fsize = evictedFromDisk.second->getElementsCountFromParams();
-                diskCacheSize -= fsize;
-            }
-
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
+            /*insert it back into the disk portion. The caller evicts the disk portion of all buckets
+             if it exceeds the maximum size allowed, see evictDiskEntriesExceedingLimit()*/
+            CacheIterator existingDiskCacheEntry = bucket.diskCache(evicted.first);
             /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first, evicted.second);
+            if ( existingDiskCacheEntry == bucket.diskCache.end() ) {
+                bucket.diskCache.insert(evicted.first, evicted.second);
             } else {   /*append to the existing list*/
                 getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
             }
+            // Entries of a tiled cache do not own their file, they are only accounted for on disk by the tile
+            *movedToDisk = !_isTiled;
         } // if (!evicted.second->isStoredOnDisk())
 
         return true;
     } // tryEvictEntry
 
-    bool tryEvictDiskEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    bool tryEvictDiskEntry(CacheBucket& bucket,
+                           std::list<EntryTypePtr> & entriesToBeDeleted,
+                           std::size_t* discardedRestoredSize) const
     {
 
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _diskCache.evict();
+        assert( !bucket.lock.tryLock() );
+
+        // Records of the restored index file were not requested since the application started: they are the least recently used
+        if ( discardedRestoredSize && !bucket.restoredRecords.empty() ) {
+            *discardedRestoredSize += discardLastRestoredRecord(bucket);
+
+            return true;
+        }
+        std::pair<hash_type, EntryTypePtr> evicted = bucket.diskCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
@@ -63,6 +63,7 @@
 #include "Engine/MemoryFile.h"
 #include "Engine/NonKeyParams.h"
 #include "Engine/Texture.h"
+#include "Engine/TileBitmap.h"
 #include "Engine/EngineFwd.h"
 #include "Global/GlobalDefines.h"
 #include "Global/StrUtils.h"
@@ -145,13 +146,13 @@ public:
 };
 
 // This is a cache file with a fixed size that is a multiple of the tileByteSize.
-// A bitset represents the allocated tiles in the file.
-// A value of true means that a tile is used by a cache entry.
+// A hierarchical bitmap represents the allocated tiles in the file so that
+// a free tile can be found without scanning the whole file.
 class TileCacheFile
 {
 public:
     MemoryFilePtr file;
-    std::vector<bool> usedTiles;
+    TileBitmap usedTiles;
 };
 
 typedef TileCacheFilePtr TileCacheFilePtr;
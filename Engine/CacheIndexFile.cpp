@@ -0,0 +1,358 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheIndexFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/static_assert.hpp>
+#endif
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/Hash64.h"
+#include "Engine/MemoryFile.h"
+
+#define CACHE_INDEX_FILE_MAGIC "NatronCI"
+#define CACHE_INDEX_FILE_MAGIC_SIZE 8
+#define CACHE_INDEX_FILE_VERSION 1
+
+// Suffix of the index file while it is mapped
+#define CACHE_INDEX_FILE_LOADED_SUFFIX ".loaded"
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+struct CacheIndexFileHeader
+{
+    char magic[CACHE_INDEX_FILE_MAGIC_SIZE];
+    U32 formatVersion;
+    U32 cacheVersion;
+    U64 recordsCount;
+    U64 payloadSize;
+    U64 checksum; //< CRC-64 of the records and the payload
+};
+
+// The records must stay aligned in the mapped file
+BOOST_STATIC_ASSERT(sizeof(CacheIndexFileHeader) % 8 == 0);
+BOOST_STATIC_ASSERT(sizeof(CacheIndexFile::Record) == 56);
+
+bool
+compareRecordsHash(const CacheIndexFile::Record & a,
+                   const CacheIndexFile::Record & b)
+{
+    return a.hash < b.hash;
+}
+
+void
+removeFile(const std::string & filePath)
+{
+    QFile::remove( QString::fromUtf8( filePath.c_str() ) );
+}
+
+bool
+renameFile(const std::string & from,
+           const std::string & to)
+{
+    QString toPath = QString::fromUtf8( to.c_str() );
+
+    // QFile::rename() does not overwrite the destination
+    QFile::remove(toPath);
+
+    return QFile::rename(QString::fromUtf8( from.c_str() ), toPath);
+}
+} // anon namespace
+
+CacheIndexFile::CacheIndexFile()
+    : _file()
+    , _mappedFilePath()
+    , _records(0)
+    , _recordsCount(0)
+    , _payload(0)
+{
+}
+
+CacheIndexFile::~CacheIndexFile()
+{
+    if (_file) {
+        _file->remove();
+    }
+}
+
+bool
+CacheIndexFile::open(const std::string & filePath,
+                     unsigned int cacheVersion,
+                     std::string* error)
+{
+    assert(!_file);
+    _mappedFilePath = filePath + CACHE_INDEX_FILE_LOADED_SUFFIX;
+    if ( !renameFile(filePath, _mappedFilePath) ) {
+        *error = "Could not rename " + filePath;
+
+        return false;
+    }
+
+    try {
+        _file.reset( new MemoryFile(_mappedFilePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail) );
+    } catch (const std::exception & e) {
+        *error = e.what();
+        _file.reset();
+        removeFile(_mappedFilePath);
+
+        return false;
+    }
+
+    const char* data = _file->data();
+    std::size_t fileSize = _file->size();
+    const CacheIndexFileHeader* header = reinterpret_cast<const CacheIndexFileHeader*>(data);
+    bool ok = false;
+    if ( !data || (fileSize < sizeof(CacheIndexFileHeader)) ||
+         ( std::memcmp(header->magic, CACHE_INDEX_FILE_MAGIC, CACHE_INDEX_FILE_MAGIC_SIZE) != 0 ) ) {
+        *error = "Not a cache index file";
+    } else if ( (header->formatVersion != CACHE_INDEX_FILE_VERSION) || (header->cacheVersion != cacheVersion) ) {
+        *error = "The cache index file was written by another version";
+    } else if ( ( header->recordsCount > (fileSize - sizeof(CacheIndexFileHeader) ) / sizeof(Record) ) ||
+                ( header->payloadSize != fileSize - sizeof(CacheIndexFileHeader) - header->recordsCount * sizeof(Record) ) ) {
+        *error = "The cache index file is truncated";
+    } else {
+        const unsigned char* contents = reinterpret_cast<const unsigned char*>(data + sizeof(CacheIndexFileHeader));
+        if ( Hash64::updateCrc64( 0, contents, fileSize - sizeof(CacheIndexFileHeader) ) != header->checksum ) {
+            *error = "The cache index file is corrupted";
+        } else {
+            ok = true;
+            _records = reinterpret_cast<const Record*>(contents);
+            _recordsCount = (std::size_t)header->recordsCount;
+            _payload = data + sizeof(CacheIndexFileHeader) + _recordsCount * sizeof(Record);
+
+            // Check what the look-ups rely on, the checksum does not protect against a bogus writer
+            for (std::size_t i = 0; i < _recordsCount && ok; ++i) {
+                const Record & r = _records[i];
+                U64 recordPayloadSize = (U64)r.filePathSize + r.holderIDSize + r.serializationSize;
+                if ( ( (i > 0) && (r.hash < _records[i - 1].hash) ) ||
+                     ( r.payloadOffset > header->payloadSize ) || ( recordPayloadSize > header->payloadSize - r.payloadOffset ) ) {
+                    *error = "The cache index file has invalid records";
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    if (!ok) {
+        _records = 0;
+        _recordsCount = 0;
+        _payload = 0;
+        _file->remove();
+        _file.reset();
+    }
+
+    return ok;
+} // CacheIndexFile::open
+
+const std::string &
+CacheIndexFile::getMappedFilePath() const
+{
+    return _mappedFilePath;
+}
+
+std::size_t
+CacheIndexFile::getRecordsCount() const
+{
+    return _recordsCount;
+}
+
+const CacheIndexFile::Record &
+CacheIndexFile::getRecord(std::size_t index) const
+{
+    assert(index < _recordsCount);
+
+    return _records[index];
+}
+
+void
+CacheIndexFile::findRecords(U64 hash,
+                            std::size_t* first,
+                            std::size_t* last) const
+{
+    Record value;
+
+    value.hash = hash;
+    std::pair<const Record*, const Record*> range = std::equal_range(_records, _records + _recordsCount, value, compareRecordsHash);
+    *first = range.first - _records;
+    *last = range.second - _records;
+}
+
+const char*
+CacheIndexFile::getPayload(std::size_t index) const
+{
+    assert(index < _recordsCount);
+
+    return _payload + _records[index].payloadOffset;
+}
+
+std::string
+CacheIndexFile::getFilePath(std::size_t index) const
+{
+    return std::string(getPayload(index), _records[index].filePathSize);
+}
+
+std::string
+CacheIndexFile::getHolderID(std::size_t index) const
+{
+    return std::string(getPayload(index) + _records[index].filePathSize, _records[index].holderIDSize);
+}
+
+bool
+CacheIndexFile::hasHolderID(std::size_t index,
+                            const std::string & holderID) const
+{
+    const Record & r = _records[index];
+
+    return ( r.holderIDSize == holderID.size() ) &&
+           ( std::memcmp(getPayload(index) + r.filePathSize, holderID.data(), r.holderIDSize) == 0 );
+}
+
+const char*
+CacheIndexFile::getSerialization(std::size_t index,
+                                 std::size_t* size) const
+{
+    const Record & r = _records[index];
+
+    *size = r.serializationSize;
+
+    return getPayload(index) + r.filePathSize + r.holderIDSize;
+}
+
+CacheIndexFileWriter::CacheIndexFileWriter()
+    : _records()
+    , _payload()
+{
+}
+
+CacheIndexFileWriter::~CacheIndexFileWriter()
+{
+}
+
+void
+CacheIndexFileWriter::addRecord(U64 hash,
+                                U64 treeVersion,
+                                U64 dataSize,
+                                U64 dataOffsetInFile,
+                                const std::string & filePath,
+                                const std::string & holderID,
+                                const char* serialization,
+                                std::size_t serializationSize)
+{
+    CacheIndexFile::Record r;
+
+    r.hash = hash;
+    r.treeVersion = treeVersion;
+    r.dataSize = dataSize;
+    r.dataOffsetInFile = dataOffsetInFile;
+    r.payloadOffset = _payload.size();
+    r.filePathSize = (U32)filePath.size();
+    r.holderIDSize = (U32)holderID.size();
+    r.serializationSize = (U32)serializationSize;
+    r.reserved = 0;
+    _payload.append(filePath);
+    _payload.append(holderID);
+    _payload.append(serialization, serializationSize);
+    _records.push_back(r);
+}
+
+void
+CacheIndexFileWriter::addRecord(const CacheIndexFile & index,
+                                std::size_t recordIndex)
+{
+    const CacheIndexFile::Record & r = index.getRecord(recordIndex);
+    std::size_t serializationSize;
+    const char* serialization = index.getSerialization(recordIndex, &serializationSize);
+
+    addRecord( r.hash, r.treeVersion, r.dataSize, r.dataOffsetInFile, index.getFilePath(recordIndex), index.getHolderID(recordIndex),
+               serialization, serializationSize );
+}
+
+bool
+CacheIndexFileWriter::write(const std::string & filePath,
+                            unsigned int cacheVersion,
+                            std::string* error) const
+{
+    std::vector<CacheIndexFile::Record> records(_records);
+
+    std::stable_sort(records.begin(), records.end(), compareRecordsHash);
+
+    CacheIndexFileHeader header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy(header.magic, CACHE_INDEX_FILE_MAGIC, CACHE_INDEX_FILE_MAGIC_SIZE);
+    header.formatVersion = CACHE_INDEX_FILE_VERSION;
+    header.cacheVersion = cacheVersion;
+    header.recordsCount = records.size();
+    header.payloadSize = _payload.size();
+    header.checksum = 0;
+    if ( !records.empty() ) {
+        header.checksum = Hash64::updateCrc64( header.checksum, reinterpret_cast<const unsigned char*>(&records[0]), records.size() * sizeof(CacheIndexFile::Record) );
+    }
+    header.checksum = Hash64::updateCrc64( header.checksum, reinterpret_cast<const unsigned char*>( _payload.data() ), _payload.size() );
+
+    std::string tmpFilePath = filePath + ".tmp";
+    {
+        FStreamsSupport::ofstream ofile;
+        FStreamsSupport::open(&ofile, tmpFilePath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!ofile) {
+            *error = "Could not open " + tmpFilePath;
+
+            return false;
+        }
+        ofile.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+        if ( !records.empty() ) {
+            ofile.write( reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(CacheIndexFile::Record) );
+        }
+        ofile.write( _payload.data(), _payload.size() );
+        ofile.flush();
+        if (!ofile) {
+            *error = "Could not write " + tmpFilePath;
+            ofile.close();
+            removeFile(tmpFilePath);
+
+            return false;
+        }
+    }
+
+    if ( !renameFile(tmpFilePath, filePath) ) {
+        *error = "Could not rename " + tmpFilePath;
+        removeFile(tmpFilePath);
+
+        return false;
+    }
+
+    return true;
+} // CacheIndexFileWriter::write
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,170 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHEINDEXFILE_H
+#define NATRON_ENGINE_CACHEINDEXFILE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The table of contents of a disk cache, saved when the application quits and memory-mapped
+ * when it starts again so that the restored cache entries can be looked-up directly in the file:
+ * entries are only deserialized when they are first requested.
+ *
+ * The file is made of a header, followed by fixed-size records sorted by hash, followed by a payload
+ * holding for each record its backing file path, the ID of its holder and the serialization of its key
+ * and params. The header stores the format and cache versions and a CRC-64 of the records and payload.
+ * Integers are stored in the native byte order: the file is only meant to be read on the machine
+ * that wrote it.
+ **/
+class CacheIndexFile
+{
+public:
+
+    struct Record
+    {
+        U64 hash;
+        U64 treeVersion;
+        U64 dataSize; //< the data size in bytes of the entry
+        U64 dataOffsetInFile;
+        U64 payloadOffset; //< offset of the file path in the payload, followed by the holder ID and the serialization
+        U32 filePathSize;
+        U32 holderIDSize;
+        U32 serializationSize;
+        U32 reserved;
+    };
+
+    CacheIndexFile();
+
+    /**
+     * @brief Unmaps and removes the file that was opened.
+     **/
+    ~CacheIndexFile();
+
+    /**
+     * @brief Maps the index file at the given path. The file is renamed beforehand so that it is not
+     * restored twice if the application crashes, and it is removed when this object is destroyed.
+     * Returns false and sets error if the file could not be mapped, was written for another cache version
+     * or is corrupted, in which case it is removed.
+     **/
+    bool open(const std::string & filePath, unsigned int cacheVersion, std::string* error);
+
+    /**
+     * @brief Returns the path of the mapped file, which is different from the path passed to open().
+     **/
+    const std::string & getMappedFilePath() const;
+
+    std::size_t getRecordsCount() const;
+
+    const Record & getRecord(std::size_t index) const;
+
+    /**
+     * @brief Returns in [first, last) the indices of the records with the given hash.
+     **/
+    void findRecords(U64 hash, std::size_t* first, std::size_t* last) const;
+
+    std::string getFilePath(std::size_t index) const;
+
+    std::string getHolderID(std::size_t index) const;
+
+    /**
+     * @brief Same as getHolderID(index) == holderID, without copying the holder ID of the record.
+     **/
+    bool hasHolderID(std::size_t index, const std::string & holderID) const;
+
+    /**
+     * @brief Returns a pointer to the serialization of the key and params of the record, in the mapped file.
+     **/
+    const char* getSerialization(std::size_t index, std::size_t* size) const;
+
+private:
+
+    const char* getPayload(std::size_t index) const;
+
+    boost::scoped_ptr<MemoryFile> _file;
+    std::string _mappedFilePath;
+    const Record* _records;
+    std::size_t _recordsCount;
+    const char* _payload;
+};
+
+/**
+ * @brief Builds a CacheIndexFile: records can be added in any order and are sorted by hash when written.
+ **/
+class CacheIndexFileWriter
+{
+public:
+
+    CacheIndexFileWriter();
+
+    ~CacheIndexFileWriter();
+
+    void addRecord(U64 hash,
+                   U64 treeVersion,
+                   U64 dataSize,
+                   U64 dataOffsetInFile,
+                   const std::string & filePath,
+                   const std::string & holderID,
+                   const char* serialization,
+                   std::size_t serializationSize);
+
+    /**
+     * @brief Copies the record at the given index of another index file.
+     **/
+    void addRecord(const CacheIndexFile & index, std::size_t recordIndex);
+
+    std::size_t getRecordsCount() const
+    {
+        return _records.size();
+    }
+
+    /**
+     * @brief Writes the index file. The file is written next to the given path and then renamed so that
+     * an incomplete file is never read. Returns false and sets error on failure.
+     **/
+    bool write(const std::string & filePath, unsigned int cacheVersion, std::string* error) const;
+
+private:
+
+    std::vector<CacheIndexFile::Record> _records;
+    std::string _payload;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHEINDEXFILE_H
@@ -51,10 +51,6 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/FrameParamsSerialization.h"
 #include "Engine/EngineFwd.h"
 
-// Note: these classes are used for cache serialization and do not have to maintain backward compatibility
-#define SERIALIZED_ENTRY_INTRODUCES_SIZE 2
-#define SERIALIZED_ENTRY_VERSION SERIALIZED_ENTRY_INTRODUCES_SIZE
-
 //Beyond that percentage of occupation, the cache will start evicting LRU entries
 #define NATRON_CACHE_LIMIT_PERCENT 0.9
 
@@ -63,99 +59,165 @@ GCC_DIAG_ON(unused-parameter)
 
 NATRON_NAMESPACE_ENTER
 
-/*Saves cache to disk as a settings file.
+/*Saves the table of contents of the disk portion of the cache.
  */
 template<typename EntryType>
-void
-Cache<EntryType>::save(CacheTOC* tableOfContents)
+bool
+Cache<EntryType>::save(const std::string & indexFilePath,
+                       std::string* error)
 {
     clearInMemoryPortion(false);
-    {
-        QMutexLocker l(&_lock);     // must be locked
 
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
+    CacheIndexFileWriter writer;
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        CacheBucket& bucket = _buckets[i];
+        QMutexLocker l(&bucket.lock);     // must be locked
+
+        for (CacheIterator it = bucket.diskCache.begin(); it != bucket.diskCache.end(); ++it) {
             std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
             for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
                 if ( (*it2)->isStoredOnDisk() ) {
-                    SerializedEntry serialization;
-                    serialization.hash = (*it2)->getHashKey();
-                    serialization.params = (*it2)->getParams();
-                    serialization.key = (*it2)->getKey();
-                    serialization.size = (*it2)->dataSize();
-                    serialization.filePath = (*it2)->getFilePath();
-                    serialization.dataOffsetInFile = (*it2)->getOffsetInFile();
+                    const typename EntryType::key_type & key = (*it2)->getKey();
+                    ParamsTypePtr params = (*it2)->getParams();
+                    std::ostringstream ss;
+                    try {
+                        boost::archive::binary_oarchive oArchive(ss, boost::archive::no_header);
+                        oArchive << key;
+                        oArchive << params;
+                    } catch (const std::exception & e) {
+                        qDebug() << "Failed to serialize cache entry:" << e.what();
+                        continue;
+                    }
+                    std::string serialization = ss.str();
 
                     (*it2)->syncBackingFile();
-                    
-                    tableOfContents->push_back(serialization);
+
+                    writer.addRecord( (*it2)->getHashKey(), key.getTreeVersion(), (*it2)->dataSize(), (*it2)->getOffsetInFile(),
+                                      (*it2)->getFilePath(), key.getCacheHolderID(), serialization.data(), serialization.size() );
 #ifdef DEBUG
-                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash(serialization.filePath, serialization.hash) ) {
+                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash( (*it2)->getFilePath(), (*it2)->getHashKey() ) ) {
                         qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
                     }
 #endif
                 }
             }
         }
+
+        // Records that were restored but never requested are copied as they are
+        for (std::size_t j = 0; j < bucket.restoredRecords.size(); ++j) {
+            writer.addRecord(*_restoredIndex, bucket.restoredRecords[j]);
+        }
     }
+
+    return writer.write(indexFilePath, _version, error);
+}
+
+/*Creates the entry of a record of the restored index file, see restore()*/
+template<typename EntryType>
+EntryType*
+Cache<EntryType>::createRestoredEntry(const CacheIndexFile & index,
+                                      std::size_t recordIndex,
+                                      const Cache<EntryType>* cache)
+{
+    std::size_t serializationSize;
+    const char* serialization = index.getSerialization(recordIndex, &serializationSize);
+    std::istringstream ss( std::string(serialization, serializationSize) );
+    typename EntryType::key_type key;
+    ParamsTypePtr params;
+    {
+        boost::archive::binary_iarchive iArchive(ss, boost::archive::no_header);
+        iArchive >> key;
+        iArchive >> params;
+    }
+    if (!params) {
+        throw std::runtime_error("Cache entry without parameters");
+    }
+    if ( index.getRecord(recordIndex).hash != key.getHash() ) {
+        /*
+         * If this warning is printed this means that the value computed by key.getHash()
+         * is different than the value stored prior to serialiazing this entry. In other words there're
+         * 2 possibilities:
+         * 1) The key has changed since it has been added to the cache: maybe you forgot to serialize some
+         * members of the key or you didn't save them correctly.
+         * 2) The hash key computation is unreliable and is depending upon changing or non-deterministic
+         * parameters which is wrong.
+         */
+        qDebug() << "WARNING: serialized hash key different than the restored one";
+    }
+
+    return new EntryType(key, params, cache);
 }
 
 /*Restores the cache from disk.*/
 template<typename EntryType>
 void
-Cache<EntryType>::restore(const CacheTOC & tableOfContents)
+Cache<EntryType>::restore(const CacheIndexFilePtr & index)
 {
-    ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
-    ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
-    std::list<EntryTypePtr> entriesToBeDeleted;
-
-    std::set<QString> usedFilePaths;
-    for (typename CacheTOC::const_iterator it =
-             tableOfContents.begin(); it != tableOfContents.end(); ++it) {
-        if ( it->hash != it->key.getHash() ) {
-            /*
-             * If this warning is printed this means that the value computed by it->key()
-             * is different than the value stored prior to serialiazing this entry. In other words there're
-             * 2 possibilities:
-             * 1) The key has changed since it has been added to the cache: maybe you forgot to serialize some
-             * members of the key or you didn't save them correctly.
-             * 2) The hash key computation is unreliable and is depending upon changing or non-deterministic
-             * parameters which is wrong.
-             */
-            qDebug() << "WARNING: serialized hash key different than the restored one";
-        }
+    assert(!_restoredIndex);
+    _restoredIndex = index;
+    _restoredEntryCreator = &Cache<EntryType>::createRestoredEntry;
 
-#ifdef DEBUG
-        if ( !_isTiled && !checkFileNameMatchesHash(it->filePath, it->hash) ) {
-            qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-        }
-#endif
+    const bool isTiled = isTileCache();
+    const std::size_t tileByteSize = getTileSizeBytes();
+    std::size_t nTilesPerFile = isTiled ? (std::size_t)std::floor( ( (double)NATRON_TILE_CACHE_FILE_SIZE_BYTES ) / tileByteSize ) : 0;
 
-        EntryType* value = NULL;
+    // Only the indices of the records are stored in the buckets: the entries are created when first requested,
+    // see createRestoredEntries(). The file path of a record is only needed here to reserve its tile.
+    std::vector<std::size_t> bucketsRecords[NATRON_CACHE_BUCKETS_COUNT];
+    std::size_t restoredSize = 0;
+    std::size_t nRecords = index->getRecordsCount();
+    for (std::size_t i = 0; i < nRecords; ++i) {
+        const CacheIndexFile::Record & record = index->getRecord(i);
 
-        try {
-            value = new EntryType(it->key, it->params, this);
-            if (it->size != getTileSizeBytes()) {
-                delete value;
+        if (isTiled) {
+            // All entries of a tiled cache have the size of a tile
+            if ( (record.dataSize != tileByteSize) || (record.dataOffsetInFile % tileByteSize != 0) ||
+                 (record.dataOffsetInFile / tileByteSize >= nTilesPerFile) ) {
+                continue;
+            }
+            try {
+                if ( !reserveRestoredTile(index->getFilePath(i), record.dataOffsetInFile) ) {
+                    continue;
+                }
+            } catch (const std::exception & e) {
+                qDebug() << e.what();
                 continue;
             }
-            ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
-            value->restoreMetadataFromFile(it->size, it->filePath, it->dataOffsetInFile);
-        } catch (const std::exception & e) {
-            qDebug() << e.what();
-            delete value;
-            continue;
         }
-        const std::string& filePath = value->getFilePath();
-        usedFilePaths.insert(QString::fromUtf8(filePath.c_str()));
-        {
-            QMutexLocker locker(&_lock);
-            sealEntry(EntryTypePtr(value), false /*inMemory*/);
+#ifdef DEBUG
+        else if ( !checkFileNameMatchesHash(index->getFilePath(i), record.hash) ) {
+            qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
         }
+#endif
+
+        restoredSize += record.dataSize;
+        // Records are sorted by hash, hence the indices of each bucket are sorted too
+        bucketsRecords[getBucketIndex(record.hash)].push_back(i);
+    }
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        CacheBucket& bucket = _buckets[i];
+        QMutexLocker locker(&bucket.lock);
+        assert( bucket.restoredRecords.empty() );
+        bucket.restoredRecords.swap(bucketsRecords[i]);
+    }
+    {
+        QMutexLocker k(&_sizeLock);
+        _diskCacheSize += restoredSize;
     }
 
     // Remove from the cache all files that are not referenced by the table of contents
     QString cachePath = getCachePath();
-    if (isTileCache()) {
+    if (isTiled) {
+        // The tile files of the restored records were opened by reserveRestoredTile()
+        std::set<QString> usedFilePaths;
+        usedFilePaths.insert( QString::fromUtf8( index->getMappedFilePath().c_str() ) );
+        {
+            QMutexLocker k(&_tileCacheMutex);
+            for (std::set<TileCacheFilePtr>::const_iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+                usedFilePaths.insert( QString::fromUtf8( (*it)->file->path().c_str() ) );
+            }
+        }
+
         QDir cacheFolder(cachePath);
         QString absolutePath = cacheFolder.absolutePath();
         QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
@@ -168,61 +230,41 @@ Cache<EntryType>::restore(const CacheTOC & tableOfContents)
             }
         }
     } else {
+        // The name of an entry file is its hash in hexadecimal, the 2 first digits being the name of its sub-folder,
+        // optionally followed by an index: look-up the records of that hash instead of listing the files of all records
         for (U32 i = 0x00; i <= 0xF; ++i) {
             for (U32 j = 0x00; j <= 0xF; ++j) {
-                char str[3] = { '0', '0', 0 };
-                str[0] += i;
-                str[1] += j;
+                std::ostringstream oss;
+                oss << std::hex << i;
+                oss << std::hex << j;
+                QString folderName = QString::fromUtf8( oss.str().c_str() );
 
-                QDir cacheFolder(cachePath + QLatin1Char('/') + QString::fromUtf8(str));
-                QString absolutePath = cacheFolder.absolutePath();
-                QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
+                QDir cacheFolder(cachePath + QLatin1Char('/') + folderName);
+                QStringList etr = cacheFolder.entryList(QDir::Files);
                 for (QStringList::iterator it = etr.begin(); it!=etr.end(); ++it) {
-                    QString entryFilePath = absolutePath + QLatin1Char('/') + *it;
-
-                    std::set<QString>::iterator foundUsed = usedFilePaths.find(entryFilePath);
-                    if (foundUsed == usedFilePaths.end()) {
+                    QString hashStr = folderName + it->section(QLatin1Char('.'), 0, 0).section(QLatin1Char('_'), 0, 0);
+                    bool ok;
+                    U64 hash = hashStr.toULongLong(&ok, 16);
+                    bool used = false;
+                    if (ok) {
+                        // Compare the end of the paths of the records, in case the cache path is not written the same way
+                        std::string fileSuffix = '/' + folderName.toStdString() + '/' + it->toStdString();
+                        std::size_t first, last;
+                        index->findRecords(hash, &first, &last);
+                        for (std::size_t k = first; k < last && !used; ++k) {
+                            std::string filePath = index->getFilePath(k);
+                            used = ( filePath.size() >= fileSuffix.size() ) &&
+                                   ( filePath.compare(filePath.size() - fileSuffix.size(), fileSuffix.size(), fileSuffix) == 0 );
+                        }
+                    }
+                    if (!used) {
                         cacheFolder.remove(*it);
                     }
                 }
             }
         }
-
-    }
-}
-
-template<typename EntryType>
-struct Cache<EntryType>::SerializedEntry
-{
-    hash_type hash;
-    typename EntryType::key_type key;
-    ParamsTypePtr params;
-    std::size_t size; //< the data size in bytes
-    std::string filePath; //< we need to serialize it as several entries can have the same hash, hence we index them
-    std::size_t dataOffsetInFile;
-
-    SerializedEntry()
-        : hash(0)
-          , key()
-          , params()
-          , size(0)
-          , filePath()
-          , dataOffsetInFile(0)
-    {
-    }
-
-    template<class Archive>
-    void serialize(Archive & ar,
-                   const unsigned int /*version*/)
-    {
-        ar & ::boost::serialization::make_nvp("Hash", hash);
-        ar & ::boost::serialization::make_nvp("Key", key);
-        ar & ::boost::serialization::make_nvp("Params", params);
-        ar & ::boost::serialization::make_nvp("Size", size);
-        ar & ::boost::serialization::make_nvp("Filename", filePath);
-        ar & ::boost::serialization::make_nvp("Offset", dataOffsetInFile);
     }
-};
+} // restore
 
 NATRON_NAMESPACE_EXIT
 
@@ -32,6 +32,7 @@
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/math/special_functions/fpclassify.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#include <boost/make_shared.hpp>
 #endif
 #include "Engine/AppManager.h"
 
@@ -289,8 +290,11 @@ Curve::Curve(KnobI *owner,
 }
 
 Curve::Curve(const Curve & other)
-    : _imp( new CurvePrivate(*other._imp) )
+    : _imp(new CurvePrivate)
 {
+    QMutexLocker l(&other._imp->_lock);
+
+    *_imp = *other._imp;
 }
 
 Curve::~Curve()
@@ -304,6 +308,7 @@ Curve::setPeriodic(bool periodic)
     QMutexLocker k(&_imp->_lock);
     _imp->isPeriodic = periodic;
     _imp->keyFrames.clear();
+    _imp->segmentsValid = false;
 }
 
 bool
@@ -324,6 +329,7 @@ Curve::clearKeyFrames()
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    _imp->segmentsValid = false;
 }
 
 bool
@@ -342,6 +348,7 @@ Curve::clone(const Curve & other)
 
     _imp->keyFrames.clear();
     std::transform( otherKeys.begin(), otherKeys.end(), std::inserter( _imp->keyFrames, _imp->keyFrames.begin() ), KeyFrameCloner() );
+    _imp->segmentsValid = false;
     onCurveChanged();
 }
 
@@ -368,12 +375,30 @@ Curve::cloneAndCheckIfChanged(const Curve& other)
     if (hasChanged) {
         _imp->keyFrames.clear();
         std::transform( otherKeys.begin(), otherKeys.end(), std::inserter( _imp->keyFrames, _imp->keyFrames.begin() ), KeyFrameCloner() );
+        _imp->segmentsValid = false;
         onCurveChanged();
     }
 
     return hasChanged;
 }
 
+CurvePtr
+Curve::makeDetachedCopy() const
+{
+    QMutexLocker l(&_imp->_lock);
+    CurvePtr copy = boost::make_shared<Curve>(*this);
+    YRange range = getCurveYRange_internal();
+
+    copy->_imp->owner = NULL;
+    copy->_imp->dimensionInOwner = -1;
+    copy->_imp->yMin = range.min;
+    copy->_imp->yMax = range.max;
+    // build the segments now, since the copy is evaluated without locking it
+    copy->updateSegments();
+
+    return copy;
+}
+
 void
 Curve::clone(const Curve & other,
              SequenceTime offset,
@@ -386,6 +411,7 @@ Curve::clone(const Curve & other,
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    _imp->segmentsValid = false;
     for (KeyFrameSet::iterator it = otherKeys.begin(); it != otherKeys.end(); ++it) {
         double time = it->getTime();
         if ( copyRange && ( (time < range->min) || (time > range->max) ) ) {
@@ -446,6 +472,7 @@ std::pair<KeyFrameSet::iterator, bool> Curve::addKeyFrameNoUpdate(const KeyFrame
     // PRIVATE - should not lock
     if (!_imp->isParametric) { //< if keyframes are clamped to integers
         std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(cp);
+        _imp->segmentsValid = false;
         // keyframe at this time exists, erase and insert again
         bool addedKey = true;
         if (!newKey.second) {
@@ -467,6 +494,7 @@ std::pair<KeyFrameSet::iterator, bool> Curve::addKeyFrameNoUpdate(const KeyFrame
             }
         }
         std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(cp);
+        _imp->segmentsValid = false;
         newKey.second = addedKey;
 
         return newKey;
@@ -533,6 +561,7 @@ Curve::removeKeyFrame(KeyFrameSet::const_iterator it)
     }
 
     _imp->keyFrames.erase(it);
+    _imp->segmentsValid = false;
 
     if (mustRefreshPrev) {
         refreshDerivatives( eCurveChangedReasonDerivativesChanged, find( prevKey.getTime() ) );
@@ -582,6 +611,7 @@ Curve::removeKeyFramesBeforeTime(double time,
         newSet.insert(*it);
     }
     _imp->keyFrames = newSet;
+    _imp->segmentsValid = false;
     if ( !_imp->keyFrames.empty() ) {
         refreshDerivatives( Curve::eCurveChangedReasonKeyframeChanged, _imp->keyFrames.begin() );
     }
@@ -603,6 +633,7 @@ Curve::removeKeyFramesAfterTime(double time,
         newSet.insert(*it);
     }
     _imp->keyFrames = newSet;
+    _imp->segmentsValid = false;
     if ( !_imp->keyFrames.empty() ) {
         KeyFrameSet::iterator last = _imp->keyFrames.end();
         --last;
@@ -783,42 +814,22 @@ Curve::getKeyFrameWithTime(double time,
     return true;
 }
 
-/// compute interpolation parameters from keyframes and an iterator
-/// to the next keyframe (the first with time > t)
+/// compute the interpolation parameters of the segment before the keyframe itup (the first with time > t),
+/// or after the last keyframe if itup is the end
 static void
-interParams(const KeyFrameSet &keyFrames,
-            bool isPeriodic,
-            double xMin,
-            double xMax,
-            double *t,
-            KeyFrameSet::const_iterator itup,
-            double *tcur,
-            double *vcur,
-            double *vcurDerivRight,
-            KeyframeTypeEnum *interp,
-            double *tnext,
-            double *vnext,
-            double *vnextDerivLeft,
-            KeyframeTypeEnum *interpNext)
+segmentParams(const KeyFrameSet &keyFrames,
+              bool isPeriodic,
+              double period,
+              KeyFrameSet::const_iterator itup,
+              double *tcur,
+              double *vcur,
+              double *vcurDerivRight,
+              KeyframeTypeEnum *interp,
+              double *tnext,
+              double *vnext,
+              double *vnextDerivLeft,
+              KeyframeTypeEnum *interpNext)
 {
-
-    assert(keyFrames.size() >= 1);
-    assert( itup == keyFrames.end() || *t < itup->getTime() );
-    double period = xMax - xMin;
-    if (isPeriodic) {
-        // if the curve is periodic, bring back t in the curve keyframes range
-        double minKeyFrameX = keyFrames.begin()->getTime() + xMin;
-        assert(xMin < xMax);
-        if (*t < minKeyFrameX || *t > minKeyFrameX + period) {
-            // This will bring t either in minTime <= t <= maxTime or t in the range minTime - (maxTime - minTime) < t < minTime
-            *t = std::fmod(*t - minKeyFrameX, period ) + minKeyFrameX;
-            if (*t < minKeyFrameX) {
-                *t += period;
-            }
-            assert(*t >= minKeyFrameX && *t <= minKeyFrameX + period);
-        }
-        itup = keyFrames.upper_bound(KeyFrame(*t, 0.));
-    }
     if ( itup == keyFrames.begin() ) {
         // We are in the case where all keys have a greater time
         // If periodic, we are in between xMin and the first keyframe
@@ -876,7 +887,6 @@ interParams(const KeyFrameSet &keyFrames,
         // get the last keyframe with time <= t
         KeyFrameSet::const_iterator itcur = itup;
         --itcur;
-        assert(itcur->getTime() <= *t);
         *tcur = itcur->getTime();
         *vcur = itcur->getValue();
         *vcurDerivRight = itcur->getRightDerivative();
@@ -888,12 +898,170 @@ interParams(const KeyFrameSet &keyFrames,
     }
 }
 
+/// compute interpolation parameters from keyframes and an iterator
+/// to the next keyframe (the first with time > t)
+static void
+interParams(const KeyFrameSet &keyFrames,
+            bool isPeriodic,
+            double xMin,
+            double xMax,
+            double *t,
+            KeyFrameSet::const_iterator itup,
+            double *tcur,
+            double *vcur,
+            double *vcurDerivRight,
+            KeyframeTypeEnum *interp,
+            double *tnext,
+            double *vnext,
+            double *vnextDerivLeft,
+            KeyframeTypeEnum *interpNext)
+{
+
+    assert(keyFrames.size() >= 1);
+    assert( itup == keyFrames.end() || *t < itup->getTime() );
+    double period = xMax - xMin;
+    if (isPeriodic) {
+        // if the curve is periodic, bring back t in the curve keyframes range
+        double minKeyFrameX = keyFrames.begin()->getTime() + xMin;
+        assert(xMin < xMax);
+        if (*t < minKeyFrameX || *t > minKeyFrameX + period) {
+            // This will bring t either in minTime <= t <= maxTime or t in the range minTime - (maxTime - minTime) < t < minTime
+            *t = std::fmod(*t - minKeyFrameX, period ) + minKeyFrameX;
+            if (*t < minKeyFrameX) {
+                *t += period;
+            }
+            assert(*t >= minKeyFrameX && *t <= minKeyFrameX + period);
+        }
+        itup = keyFrames.upper_bound(KeyFrame(*t, 0.));
+    }
+    segmentParams(keyFrames, isPeriodic, period, itup, tcur, vcur, vcurDerivRight, interp, tnext, vnext, vnextDerivLeft, interpNext);
+}
+
+void
+Curve::updateSegments() const
+{
+    // PRIVATE - should not lock
+    if (_imp->segmentsValid) {
+        return;
+    }
+    const KeyFrameSet& keyFrames = _imp->keyFrames;
+    std::vector<double>& keyTimes = _imp->keyTimes;
+    std::vector<CurvePrivate::Segment>& segments = _imp->segments;
+
+    keyTimes.clear();
+    segments.clear();
+    if ( !keyFrames.empty() ) {
+        keyTimes.reserve( keyFrames.size() );
+        segments.resize(keyFrames.size() + 1);
+        double period = _imp->xMax - _imp->xMin;
+        KeyFrameSet::const_iterator itup = keyFrames.begin();
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            CurvePrivate::Segment& seg = segments[i];
+            double vcurDerivRight, vnextDerivLeft, vcur, vnext;
+            KeyframeTypeEnum interp, interpNext;
+            segmentParams(keyFrames, _imp->isPeriodic, period, itup,
+                          &seg.tcur, &vcur, &vcurDerivRight, &interp,
+                          &seg.tnext, &vnext, &vnextDerivLeft, &interpNext);
+            Interpolation::cubicCoeffs(&seg.tcur, vcur, vcurDerivRight, vnextDerivLeft, &seg.tnext, vnext, interp, interpNext, seg.c);
+            if ( itup != keyFrames.end() ) {
+                keyTimes.push_back( itup->getTime() );
+                ++itup;
+            }
+        }
+    }
+    _imp->lastSegment = 0;
+    _imp->segmentsValid = true;
+}
+
+double
+Curve::interpolateSegments(double* t,
+                           int* hint) const
+{
+    // PRIVATE - should not lock
+    assert(_imp->segmentsValid);
+    const std::vector<double>& keyTimes = _imp->keyTimes;
+    assert( !keyTimes.empty() );
+
+    if (_imp->isPeriodic) {
+        // same as interParams(): bring back t in the curve keyframes range
+        double period = _imp->xMax - _imp->xMin;
+        double minKeyFrameX = keyTimes.front() + _imp->xMin;
+        assert(_imp->xMin < _imp->xMax);
+        if (*t < minKeyFrameX || *t > minKeyFrameX + period) {
+            *t = std::fmod(*t - minKeyFrameX, period ) + minKeyFrameX;
+            if (*t < minKeyFrameX) {
+                *t += period;
+            }
+        }
+    }
+
+    // the segment i holds the times with i keyframes at or before them: try the hint and the next segment,
+    // which is what successive evaluations at increasing times need, before searching
+    const int n = (int)keyTimes.size();
+    int i = *hint;
+    if ( (i < 0) || (i > n) || ( (i > 0) && (*t < keyTimes[i - 1]) ) ) {
+        i = (int)( std::upper_bound(keyTimes.begin(), keyTimes.end(), *t) - keyTimes.begin() );
+    } else if ( (i < n) && (*t >= keyTimes[i]) ) {
+        ++i;
+        if ( (i < n) && (*t >= keyTimes[i]) ) {
+            i = (int)( std::upper_bound(keyTimes.begin() + i, keyTimes.end(), *t) - keyTimes.begin() );
+        }
+    }
+    *hint = i;
+
+    const CurvePrivate::Segment& seg = _imp->segments[i];
+
+    return Interpolation::evaluateCubic(seg.c, seg.tcur, seg.tnext, *t);
+}
+
 double
 Curve::getValueAt(double t,
                   bool doClamp) const
 {
     QMutexLocker l(&_imp->_lock);
 
+    updateSegments();
+
+    return getValueAtInternal(t, doClamp, &_imp->lastSegment);
+}
+
+void
+Curve::getValuesAt(const std::vector<double>& times,
+                   bool doClamp,
+                   std::vector<double>* values) const
+{
+    QMutexLocker l(&_imp->_lock);
+
+    updateSegments();
+    values->resize( times.size() );
+    int hint = 0;
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        (*values)[i] = getValueAtInternal(times[i], doClamp, &hint);
+    }
+}
+
+double
+Curve::getValueAtUnlocked(double t,
+                          bool doClamp) const
+{
+#ifdef NATRON_CURVE_USE_CACHE
+    // the results cache is written by the evaluation
+    return getValueAt(t, doClamp);
+#else
+    assert(!_imp->owner);
+    assert(_imp->segmentsValid);
+    int hint = 0;
+
+    return getValueAtInternal(t, doClamp, &hint);
+#endif
+}
+
+double
+Curve::getValueAtInternal(double t,
+                          bool doClamp,
+                          int* hint) const
+{
+    // PRIVATE - should not lock
     if ( _imp->keyFrames.empty() ) {
         //throw std::runtime_error("Curve has no control points!");
 
@@ -915,39 +1083,7 @@ Curve::getValueAt(double t,
 #endif
     {
         // even when there is only one keyframe, there may be tangents!
-        //if (_imp->keyFrames.size() == 1) {
-        //    //if there's only 1 keyframe, don't bother interpolating
-        //    return (*_imp->keyFrames.begin()).getValue();
-        //}
-        double tcur, tnext;
-        double vcurDerivRight, vnextDerivLeft, vcur, vnext;
-        KeyframeTypeEnum interp, interpNext;
-        KeyFrame k(t, 0.);
-        // find the first keyframe with time greater than t
-        KeyFrameSet::const_iterator itup;
-        itup = _imp->keyFrames.upper_bound(k);
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
-                    &t,
-                    itup,
-                    &tcur,
-                    &vcur,
-                    &vcurDerivRight,
-                    &interp,
-                    &tnext,
-                    &vnext,
-                    &vnextDerivLeft,
-                    &interpNext);
-
-        v = Interpolation::interpolate(tcur, vcur,
-                                       vcurDerivRight,
-                                       vnextDerivLeft,
-                                       tnext, vnext,
-                                       t,
-                                       interp,
-                                       interpNext);
+        v = interpolateSegments(&t, hint);
 #ifdef NATRON_CURVE_USE_CACHE
         _imp->resultCache[t] = v;
 #endif
@@ -972,7 +1108,7 @@ Curve::getValueAt(double t,
 
         return v;
     }
-} // getValueAt
+} // getValueAtInternal
 
 double
 Curve::getDerivativeAt(double t) const
@@ -1188,6 +1324,13 @@ Curve::YRange Curve::getCurveYRange() const
 {
     QMutexLocker l(&_imp->_lock);
 
+    return getCurveYRange_internal();
+}
+
+Curve::YRange
+Curve::getCurveYRange_internal() const
+{
+    // PRIVATE - should not lock
     if ( !mustClamp() ) {
         return YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
     }
@@ -1224,7 +1367,7 @@ Curve::clampValueToCurveYRange(double v) const
 {
     // PRIVATE - should not lock
     ////clamp to min/max if the owner of the curve is a Double or Int knob.
-    YRange minmax = getCurveYRange();
+    YRange minmax = getCurveYRange_internal();
 
     if (v > minmax.max) {
         return minmax.max;
@@ -1252,6 +1395,7 @@ Curve::setXRange(double a,
 
     _imp->xMin = a;
     _imp->xMax = b;
+    _imp->segmentsValid = false;
 }
 
 std::pair<double, double> Curve::getXRange() const
@@ -1289,6 +1433,7 @@ Curve::setKeyFrameValueAndTimeNoUpdate(double value,
     newKey.setTime(time);
     newKey.setValue(value);
     _imp->keyFrames.erase(k);
+    _imp->segmentsValid = false;
 
     return addKeyFrameNoUpdate(newKey).first;
 }
@@ -1652,6 +1797,7 @@ Curve::refreshDerivatives(Curve::CurveChangedReasonEnum reason,
     newKey.setRightDerivative(vcurDerivRight);
 
     std::pair<KeyFrameSet::iterator, bool> newKeyIt = _imp->keyFrames.insert(newKey);
+    _imp->segmentsValid = false;
 
     // keyframe at this time exists, erase and insert again
     if (!newKeyIt.second) {
@@ -1833,6 +1979,7 @@ Curve::onCurveChanged()
     if (_imp->owner) {
         _imp->owner->clearExpressionsResults(_imp->dimensionInOwner);
     }
+    _imp->segmentsValid = false;
 #ifdef NATRON_CURVE_USE_CACHE
     _imp->resultCache.clear();
 #endif
@@ -1843,6 +1990,7 @@ Curve::setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives)
 {
     if (!refreshDerivatives) {
         _imp->keyFrames = keys;
+        _imp->segmentsValid = false;
     } else {
         _imp->keyFrames.clear();
 
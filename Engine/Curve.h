@@ -183,6 +183,13 @@ public:
 
     bool cloneAndCheckIfChanged(const Curve& other);
 
+    /**
+     * @brief Returns a copy of this curve that is detached from its owner: the y range of the owner
+     * is copied in the curve so that the copy is clamped the same way.
+     * The copy is meant to be read-only, so that getValueAtUnlocked() may be called on it from any thread.
+     **/
+    CurvePtr makeDetachedCopy() const WARN_UNUSED_RETURN;
+
     /**
      * @brief Same as the other version clone except that keyframes will be offset by the given offset
      * and only the keyframes lying in the given range will be copied.
@@ -253,6 +260,18 @@ public:
      */
     double getValueAt(double t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Same as getValueAt() but does not lock the curve: this may only be called on a curve
+     * that is not modified anymore, such as the copies returned by makeDetachedCopy().
+     **/
+    double getValueAtUnlocked(double t, bool clamp = true) const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Same as getValueAt() for each of the given times, which locks the curve only once.
+     * This is faster when the times are increasing, e.g. to draw the curve.
+     **/
+    void getValuesAt(const std::vector<double>& times, bool clamp, std::vector<double>* values) const;
+
     double getDerivativeAt(double t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(double t1, double t2) const WARN_UNUSED_RETURN;
@@ -368,6 +387,15 @@ private:
 
     void removeKeyFrame(KeyFrameSet::const_iterator it);
 
+    double getValueAtInternal(double t, bool clamp, int* hint) const WARN_UNUSED_RETURN;
+
+    /// rebuild the segments used for the evaluation if the keyframes changed
+    void updateSegments() const;
+
+    /// evaluate the segments at t, which is brought back in the period of a periodic curve.
+    /// hint is the segment to look at first and is set to the segment of t.
+    double interpolateSegments(double* t, int* hint) const WARN_UNUSED_RETURN;
+
     double clampValueToCurveYRange(double v) const WARN_UNUSED_RETURN;
 
     void setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives);
@@ -31,6 +31,8 @@
 #include <boost/shared_ptr.hpp>
 #endif
 
+#include <vector>
+
 #include <QtCore/QMutex>
 
 #include "Engine/Variant.h"
@@ -55,8 +57,26 @@ struct CurvePrivate
         // and times
     };
 
+    /**
+     * @brief The cubic interpolating the curve between two keyframes, or before the first / after the last keyframe
+     **/
+    struct Segment
+    {
+        // the times of the cubic, as adjusted by Interpolation::cubicCoeffs()
+        double tcur, tnext;
+        double c[4];
+    };
+
     KeyFrameSet keyFrames;
 
+    // Flat copy of the keyframes used to evaluate the curve: the times of the keyframes and the cubic of each segment,
+    // segments[i] being used for the times with i keyframes at or before them.
+    // They are rebuilt by Curve::updateSegments() when segmentsValid was reset by a change of the keyframes.
+    mutable std::vector<double> keyTimes;
+    mutable std::vector<Segment> segments;
+    mutable bool segmentsValid;
+    mutable int lastSegment; //< the segment of the last evaluation, to start the next look-up from there
+
 #ifdef NATRON_CURVE_USE_CACHE
     std::map<double, double> resultCache; //< a cache for interpolations
 #endif
@@ -72,6 +92,10 @@ struct CurvePrivate
 
     CurvePrivate()
         : keyFrames()
+        , keyTimes()
+        , segments()
+        , segmentsValid(false)
+        , lastSegment(0)
 #ifdef NATRON_CURVE_USE_CACHE
         , resultCache()
 #endif
@@ -89,7 +113,9 @@ struct CurvePrivate
     }
 
     CurvePrivate(const CurvePrivate & other)
-        : _lock(QMutex::Recursive)
+        : segmentsValid(false)
+        , lastSegment(0)
+        , _lock(QMutex::Recursive)
     {
         *this = other;
     }
@@ -97,6 +123,7 @@ struct CurvePrivate
     void operator=(const CurvePrivate & other)
     {
         keyFrames = other.keyFrames;
+        segmentsValid = false;
         owner = other.owner;
         dimensionInOwner = other.dimensionInOwner;
         isParametric = other.isParametric;
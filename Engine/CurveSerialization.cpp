@@ -35,4 +35,8 @@ template void Curve::serialize<boost::archive::xml_iarchive>(boost::archive::xml
                                                              const unsigned int file_version);
 template void Curve::serialize<boost::archive::xml_oarchive>(boost::archive::xml_oarchive & ar,
                                                              const unsigned int file_version);
+template void Curve::serialize<boost::archive::binary_iarchive>(boost::archive::binary_iarchive & ar,
+                                                                const unsigned int file_version);
+template void Curve::serialize<boost::archive::binary_oarchive>(boost::archive::binary_oarchive & ar,
+                                                                const unsigned int file_version);
 NATRON_NAMESPACE_EXIT
@@ -60,6 +60,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/ImageParams.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/KnobsSnapshot.h"
 #include "Engine/Log.h"
 #include "Engine/MemoryInfo.h" // printAsRAM
 #include "Engine/Node.h"
@@ -326,9 +327,46 @@ EffectInstance::setParallelRenderArgsTLS(double time,
     args->tilesSupported = getNode()->getCurrentSupportTiles();
     args->stats = stats;
     args->openGLContext = glContext;
+    if (!isAnalysis) {
+        args->knobsSnapshot = getKnobsSnapshot();
+    }
+    args->convertedInputImages = boost::make_shared<ConvertedInputImages>();
     argsList.push_back(args);
 }
 
+KnobsSnapshotPtr
+EffectInstance::getKnobsSnapshot()
+{
+    U64 age;
+    {
+        QMutexLocker k(&_imp->knobsSnapshotMutex);
+        if (_imp->knobsSnapshot) {
+            return _imp->knobsSnapshot;
+        }
+        age = _imp->knobsSnapshotAge;
+    }
+
+    // Capture the knobs without holding the lock: the knobs may invalidate the snapshot while it is captured
+    KnobsSnapshotPtr snapshot = boost::make_shared<KnobsSnapshot>();
+    snapshot->captureKnobs( getKnobs_mt_safe() );
+
+    QMutexLocker k(&_imp->knobsSnapshotMutex);
+    if (_imp->knobsSnapshotAge == age) {
+        _imp->knobsSnapshot = snapshot;
+    }
+
+    return snapshot;
+}
+
+void
+EffectInstance::invalidateKnobsSnapshot()
+{
+    QMutexLocker k(&_imp->knobsSnapshotMutex);
+
+    ++_imp->knobsSnapshotAge;
+    _imp->knobsSnapshot.reset();
+}
+
 bool
 EffectInstance::getThreadLocalRotoPaintTreeNodes(NodesList* nodes) const
 {
@@ -376,6 +414,13 @@ EffectInstance::invalidateParallelRenderArgsTLS()
     for (NodesList::iterator it = back->rotoPaintNodes.begin(); it != back->rotoPaintNodes.end(); ++it) {
         (*it)->getEffectInstance()->invalidateParallelRenderArgsTLS();
     }
+    if ( back->stats && back->stats->isInDepthProfilingEnabled() && back->knobsSnapshot ) {
+        int snapshotReads, lockedReads;
+        back->knobsSnapshot->takeReadsCount(&snapshotReads, &lockedReads);
+        if ( (snapshotReads > 0) || (lockedReads > 0) ) {
+            back->stats->addKnobsReadsForNode(getNode(), snapshotReads, lockedReads);
+        }
+    }
     tls->frameArgs.pop_back();
 }
 
@@ -844,6 +889,7 @@ EffectInstance::getImage(int inputNb,
     EffectInstance::InputImagesMap inputImagesThreadLocal;
     OSGLContextPtr glContext;
     AbortableRenderInfoPtr renderInfo;
+    ParallelRenderArgsPtr frameArgs;
     if ( !tls || ( !tls->currentRenderArgs.validArgs && tls->frameArgs.empty() ) ) {
         /*
            This is either a huge bug or an unknown thread that called clipGetImage from the OpenFX plug-in.
@@ -870,6 +916,7 @@ EffectInstance::getImage(int inputNb,
 
         if ( !tls->frameArgs.empty() ) {
             const ParallelRenderArgsPtr& frameRenderArgs = tls->frameArgs.back();
+            frameArgs = frameRenderArgs;
             nodeHash = frameRenderArgs->nodeHash;
             duringPaintStroke = frameRenderArgs->isDuringPaintStrokeCreation;
             isAnalysisPass = frameRenderArgs->isAnalysis;
@@ -1054,7 +1101,7 @@ EffectInstance::getImage(int inputNb,
         }
 
         if (mapToClipPrefs) {
-            inputImg = convertPlanesFormatsIfNeeded(getApp(), inputImg, pixelRoI, clipPrefComps, depth, node->usesAlpha0ToConvertFromRGBToRGBA(), eImagePremultiplicationPremultiplied, channelForMask);
+            inputImg = convertInputImageFormatIfNeeded(frameArgs, inputImg, pixelRoI, clipPrefComps, depth, eImagePremultiplicationPremultiplied, channelForMask);
         }
 
         return inputImg;
@@ -1150,7 +1197,7 @@ EffectInstance::getImage(int inputNb,
 
 
     if (mapToClipPrefs) {
-        inputImg = convertPlanesFormatsIfNeeded(getApp(), inputImg, pixelRoI, clipPrefComps, depth, node->usesAlpha0ToConvertFromRGBToRGBA(), outputPremult, channelForMask);
+        inputImg = convertInputImageFormatIfNeeded(frameArgs, inputImg, pixelRoI, clipPrefComps, depth, outputPremult, channelForMask);
     }
 
 #ifdef DEBUG
@@ -1176,6 +1223,50 @@ EffectInstance::getImage(int inputNb,
     return inputImg;
 } // getImage
 
+ImagePtr
+EffectInstance::convertInputImageFormatIfNeeded(const ParallelRenderArgsPtr& frameArgs,
+                                                const ImagePtr& inputImage,
+                                                const RectI& roi,
+                                                const ImagePlaneDesc& targetComponents,
+                                                ImageBitDepthEnum targetDepth,
+                                                ImagePremultiplicationEnum outputPremult,
+                                                int channelForAlpha)
+{
+    if ( !inputImage || (inputImage->getStorageMode() == eStorageModeGLTex) ||
+         ( ( targetComponents.getNumComponents() == inputImage->getComponents().getNumComponents() ) && (targetDepth == inputImage->getBitDepth()) ) ) {
+        return inputImage;
+    }
+
+    NodePtr node = getNode();
+    RenderStatsPtr stats = frameArgs ? frameArgs->stats : RenderStatsPtr();
+    bool doProfiling = stats && stats->isInDepthProfilingEnabled();
+
+    // Another render thread of this frame may already have converted the pixels we need
+    ConvertedInputImagesPtr convertedImages = frameArgs ? frameArgs->convertedInputImages : ConvertedInputImagesPtr();
+    if (convertedImages) {
+        ImagePtr converted = convertedImages->findConvertedImage(inputImage, targetComponents, targetDepth, outputPremult, channelForAlpha, roi);
+        if (converted) {
+            if (doProfiling) {
+                stats->addInputImageConversionForNode(node, 0, true);
+            }
+
+            return converted;
+        }
+    }
+
+    // Only convert the RoI: the plug-in does not read the pixels of the input outside of it
+    ImagePtr converted = convertPlanesFormatsIfNeeded(getApp(), inputImage, roi, targetComponents, targetDepth, node->usesAlpha0ToConvertFromRGBToRGBA(), outputPremult, channelForAlpha, true);
+    if (convertedImages) {
+        convertedImages->addConvertedImage(inputImage, converted, outputPremult, channelForAlpha);
+    }
+    if (doProfiling) {
+        U64 nbBytes = converted->getBounds().area() * converted->getComponentsCount() * getSizeOfForBitDepth(targetDepth);
+        stats->addInputImageConversionForNode(node, nbBytes, false);
+    }
+
+    return converted;
+}
+
 void
 EffectInstance::calcDefaultRegionOfDefinition(U64 /*hash*/,
                                               double /*time*/,
@@ -1470,11 +1561,27 @@ EffectInstance::NotifyInputNRenderingStarted_RAII::~NotifyInputNRenderingStarted
     }
 }
 
+/**
+ * @brief Records in the render statistics of the current thread that creating the image in the cache had to wait
+ * for another thread holding the lock of its cache bucket, like the look-ups of getImageFromCacheAndConvertIfNeeded()
+ **/
+static void
+addCacheLockContentionToStats(const EffectInstance* effect,
+                              const ImageKey & key)
+{
+    ParallelRenderArgsPtr frameArgs = effect->getParallelRenderArgsTLS();
+
+    if ( frameArgs && frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled() ) {
+        frameArgs->stats->addCacheLockContentionForNode( effect->getNode(), appPTR->getImageCacheBucketIndex( key.getHash() ) );
+    }
+}
+
 static void
 getOrCreateFromCacheInternal(const ImageKey & key,
                              const ImageParamsPtr & params,
                              bool useCache,
-                             ImagePtr* image)
+                             ImagePtr* image,
+                             bool* lockContended = 0)
 {
     if (!useCache) {
         *image = boost::make_shared<Image>(key, params);
@@ -1482,9 +1589,9 @@ getOrCreateFromCacheInternal(const ImageKey & key,
         assert(params->getStorageInfo().mode != eStorageModeGLTex);
 
         if (params->getStorageInfo().mode == eStorageModeRAM) {
-            appPTR->getImageOrCreate(key, params, image);
+            appPTR->getImageOrCreate(key, params, image, lockContended);
         } else if (params->getStorageInfo().mode == eStorageModeDisk) {
-            appPTR->getImageOrCreate_diskCache(key, params, image);
+            appPTR->getImageOrCreate_diskCache(key, params, image, lockContended);
         }
 
         if (!*image) {
@@ -1656,11 +1763,15 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool /*useCache*/,
     }
 
     if (!isCached) {
+        bool lockContended = false;
         // For textures, we lookup for a RAM image, if found we convert it to a texture
         if ( (storage == eStorageModeRAM) || (storage == eStorageModeGLTex) ) {
-            isCached = appPTR->getImage(key, &cachedImages);
+            isCached = appPTR->getImage(key, &cachedImages, &lockContended);
         } else if (storage == eStorageModeDisk) {
-            isCached = appPTR->getImage_diskCache(key, &cachedImages);
+            isCached = appPTR->getImage_diskCache(key, &cachedImages, &lockContended);
+        }
+        if (lockContended && stats && stats->isInDepthProfilingEnabled()) {
+            stats->addCacheLockContentionForNode( getNode(), appPTR->getImageCacheBucketIndex( key.getHash() ) );
         }
     }
 
@@ -1995,6 +2106,8 @@ EffectInstance::allocateImagePlane(const ImageKey & key,
                                    ImagePtr* fullScaleImage,
                                    ImagePtr* downscaleImage)
 {
+    bool lockContended = false;
+
     //If we're rendering full scale and with input images at full scale, don't cache the downscale image since it is cheap to
     //recreate, instead cache the full-scale image
     if (renderFullScaleThenDownscale) {
@@ -2013,7 +2126,10 @@ EffectInstance::allocateImagePlane(const ImageKey & key,
         //The upscaled image will be rendered with input images at full def, it is then the best possibly rendered image so cache it!
 
         fullScaleImage->reset();
-        getOrCreateFromCacheInternal(key, upscaledImageParams, createInCache, fullScaleImage);
+        getOrCreateFromCacheInternal(key, upscaledImageParams, createInCache, fullScaleImage, &lockContended);
+        if (lockContended) {
+            addCacheLockContentionToStats(this, key);
+        }
 
         if (!*fullScaleImage) {
             return false;
@@ -2037,7 +2153,10 @@ EffectInstance::allocateImagePlane(const ImageKey & key,
         ///When calling allocateMemory() on the image, the cache already has the lock since it added it
         ///so taking this lock now ensures the image will be allocated completetly
 
-        getOrCreateFromCacheInternal(key, cachedImgParams, createInCache, downscaleImage);
+        getOrCreateFromCacheInternal(key, cachedImgParams, createInCache, downscaleImage, &lockContended);
+        if (lockContended) {
+            addCacheLockContentionToStats(this, key);
+        }
         if (!*downscaleImage) {
             return false;
         }
@@ -2177,11 +2296,36 @@ EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementa
                                                                         args.planes);
 
     //Exit of the host frame threading thread
-    appPTR->getAppTLS()->cleanupTLSForThread();
+    if (callingThread != curThread) {
+        appPTR->getAppTLS()->cleanupTLSForThread();
+    }
 
     return ret;
 }
 
+EffectInstance::Implementation::TiledRenderingTasks::TiledRenderingTasks(Implementation* imp,
+                                                                         TiledRenderingFunctorArgs & args,
+                                                                         const std::list<RectToRender> & rects,
+                                                                         QThread* callingThread)
+    : ParallelTasks()
+    , _imp(imp)
+    , _args(args)
+    , _rects()
+    , _callingThread(callingThread)
+    , _results(rects.size(), EffectInstance::eRenderingFunctorRetOK)
+{
+    _rects.reserve( rects.size() );
+    for (std::list<RectToRender>::const_iterator it = rects.begin(); it != rects.end(); ++it) {
+        _rects.push_back(&*it);
+    }
+}
+
+void
+EffectInstance::Implementation::TiledRenderingTasks::runTask(int taskIndex)
+{
+    _results[taskIndex] = _imp->tiledRenderingFunctor(_args, *_rects[taskIndex], _callingThread);
+}
+
 EffectInstance::RenderingFunctorRetEnum
 EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectToRender,
                                                       const bool renderFullScaleThenDownscale,
@@ -686,6 +686,14 @@ public:
 
     ParallelRenderArgsPtr getParallelRenderArgsTLS() const;
 
+    /**
+     * @brief Returns the snapshot of the knobs given to the renders. A new snapshot is taken if a knob changed
+     * since the last one.
+     **/
+    KnobsSnapshotPtr getKnobsSnapshot();
+
+    virtual void invalidateKnobsSnapshot() OVERRIDE FINAL;
+
     //Implem in ParallelRenderArgs.cpp
     static StatusEnum getInputsRoIsFunctor(bool useTransforms,
                                            double time,
@@ -2186,7 +2194,20 @@ private:
                                                                  ImageBitDepthEnum targetDepth,
                                                                  bool useAlpha0ForRGBToRGBAConversion,
                                                                  ImagePremultiplicationEnum outputPremult,
-                                                                 int channelForAlpha);
+                                                                 int channelForAlpha,
+                                                                 bool convertRoIOnly);
+
+    /**
+     * @brief Converts an input image fetched by getImage() to the clip preferences. Only the pixels of roi
+     * are converted, in an image covering roi, and the conversion is shared with the other render threads of the frame.
+     **/
+    ImagePtr convertInputImageFormatIfNeeded(const ParallelRenderArgsPtr& frameArgs,
+                                             const ImagePtr& inputImage,
+                                             const RectI& roi,
+                                             const ImagePlaneDesc& targetComponents,
+                                             ImageBitDepthEnum targetDepth,
+                                             ImagePremultiplicationEnum outputPremult,
+                                             int channelForAlpha);
 
 
     /**
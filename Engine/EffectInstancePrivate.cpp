@@ -405,6 +405,9 @@ EffectInstance::Implementation::Implementation(EffectInstance* publicInterface)
     , renderClonesMutex()
     , renderClonesPool()
     , mustSyncPrivateData(false)
+    , knobsSnapshotMutex()
+    , knobsSnapshot()
+    , knobsSnapshotAge(0)
 {
     tlsData = boost::make_shared<TLSHolder<EffectTLSData> >();
     actionsCache = boost::make_shared<ActionsCache>(appPTR->getHardwareIdealThreadCount() * 2);
@@ -434,6 +437,9 @@ EffectInstance::Implementation::Implementation(const Implementation& other)
 , isDoingInstanceSafeRender(false)
 , renderClonesMutex()
 , renderClonesPool()
+, knobsSnapshotMutex()
+, knobsSnapshot()
+, knobsSnapshotAge(0)
 {
 
 }
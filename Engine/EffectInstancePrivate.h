@@ -40,6 +40,7 @@
 #include "Global/GlobalDefines.h"
 
 #include "Engine/Image.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/NodeMetadata.h"
 #include "Engine/OSGLContext.h"
@@ -238,6 +239,11 @@ public:
     bool mustSyncPrivateData; //!< true if the effect's knobs were changed but instanceChanged could not be called (e.g. when loading a PyPlug), so that syncPrivateData should be called in getPreferredMetadata_public before calling getPreferredMetadata
     mutable QMutex mustSyncPrivateDataMutex; //!< protects mustSyncPrivateData
 
+    // The snapshot of the knobs given to the renders, taken again after any knob change
+    mutable QMutex knobsSnapshotMutex; //!< protects knobsSnapshot and knobsSnapshotAge
+    KnobsSnapshotPtr knobsSnapshot;
+    U64 knobsSnapshotAge; //!< incremented when the snapshot is invalidated
+
 public:
     void runChangedParamCallback(KnobI* k, bool userEdited, const std::string & callback);
 
@@ -339,6 +345,37 @@ public:
     RenderingFunctorRetEnum tiledRenderingFunctor(TiledRenderingFunctorArgs & args,  const RectToRender & specificData,
                                                   QThread* callingThread);
 
+    /**
+     * @brief The rectangles of a render in eRenderSafetyFullySafeFrame, executed in parallel by the TaskScheduler
+     **/
+    class TiledRenderingTasks
+        : public ParallelTasks
+    {
+public:
+
+        TiledRenderingTasks(Implementation* imp,
+                            TiledRenderingFunctorArgs & args,
+                            const std::list<RectToRender> & rects,
+                            QThread* callingThread);
+
+        virtual ~TiledRenderingTasks() {}
+
+        virtual void runTask(int taskIndex) OVERRIDE FINAL;
+
+        const std::vector<RenderingFunctorRetEnum>& getResults() const
+        {
+            return _results;
+        }
+
+private:
+
+        Implementation* _imp;
+        TiledRenderingFunctorArgs & _args;
+        std::vector<const RectToRender*> _rects;
+        QThread* _callingThread;
+        std::vector<RenderingFunctorRetEnum> _results;
+    };
+
     RenderingFunctorRetEnum tiledRenderingFunctor(const RectToRender & rectToRender,
                                                   const bool renderFullScaleThenDownscale,
                                                   const bool isSequentialRender,
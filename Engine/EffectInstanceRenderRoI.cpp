@@ -73,6 +73,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Timer.h"
 #include "Engine/Transform.h"
 #include "Engine/ThreadPool.h"
@@ -171,7 +172,8 @@ EffectInstance::convertPlanesFormatsIfNeeded(const AppInstancePtr& app,
                                              ImageBitDepthEnum targetDepth,
                                              bool useAlpha0ForRGBToRGBAConversion,
                                              ImagePremultiplicationEnum outputPremult,
-                                             int channelForAlpha)
+                                             int channelForAlpha,
+                                             bool convertRoIOnly)
 {
     // Do not do any conversion for OpenGL textures, OpenGL is managing it for us.
     if (inputImage->getStorageMode() == eStorageModeGLTex) {
@@ -187,6 +189,10 @@ EffectInstance::convertPlanesFormatsIfNeeded(const AppInstancePtr& app,
          **/
         Image::ReadAccess acc = inputImage->getReadRights();
         RectI bounds = inputImage->getBounds();
+        if (convertRoIOnly) {
+            // The pixels outside of the RoI are not converted anyway: do not allocate them
+            roi.intersect(inputImage->getBounds(), &bounds);
+        }
 #if 0 //def BOOST_NO_CXX11_VARIADIC_TEMPLATES
        ImagePtr tmp( new Image(targetComponents,
                                 inputImage->getRoD(),
@@ -699,7 +705,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                                 premult = eImagePremultiplicationOpaque;
                             }
 
-                            ImagePtr tmp = convertPlanesFormatsIfNeeded(app, it->second, args.roi, *compIt, inputArgs->bitdepth, useAlpha0ForRGBToRGBAConversion, premult, -1);
+                            ImagePtr tmp = convertPlanesFormatsIfNeeded(app, it->second, args.roi, *compIt, inputArgs->bitdepth, useAlpha0ForRGBToRGBAConversion, premult, -1, false);
                             assert(tmp);
                             convertedPlanes[it->first] = tmp;
                         }
@@ -1788,7 +1794,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
         assert(comp);
         ///The image might need to be converted to fit the original requested format
         if (comp) {
-            it->second.downscaleImage = convertPlanesFormatsIfNeeded(getApp(), it->second.downscaleImage, originalRoI, *comp, args.bitdepth, useAlpha0ForRGBToRGBAConversion, planesToRender->outputPremult, -1);
+            it->second.downscaleImage = convertPlanesFormatsIfNeeded(getApp(), it->second.downscaleImage, originalRoI, *comp, args.bitdepth, useAlpha0ForRGBToRGBAConversion, planesToRender->outputPremult, -1, false);
             assert(it->second.downscaleImage->getComponents() == *comp && it->second.downscaleImage->getBitDepth() == args.bitdepth);
 
             StorageModeEnum imageStorage = it->second.downscaleImage->getStorageMode();
@@ -1995,14 +2001,17 @@ EffectInstance::renderRoIInternal(EffectInstance* self,
 #else
 
 
-            QFuture<RenderingFunctorRetEnum> ret = QtConcurrent::mapped( planesToRender->rectsToRender,
-                                                                         boost::bind(&EffectInstance::Implementation::tiledRenderingFunctor,
-                                                                                     self->_imp.get(),
-                                                                                     *tiledArgs,
-                                                                                     _1,
-                                                                                     currentThread) );
-            ret.waitForFinished();
-            QFuture<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
+            // The current thread renders tiles too: if it is a worker of the scheduler, the tiles of the
+            // effects upstream that are rendered from this one are executed by the same workers.
+            Implementation::TiledRenderingTasks tasks(self->_imp.get(), *tiledArgs, planesToRender->rectsToRender, currentThread);
+            const bool doTimings = frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled();
+            std::vector<TaskTiming> timings;
+            appPTR->getTaskScheduler()->run( &tasks, (int)planesToRender->rectsToRender.size(), doTimings ? &timings : 0 );
+            if (doTimings) {
+                frameArgs->stats->addTileTasksInfosForNode(self->getNode(), timings);
+            }
+            const std::vector<EffectInstance::RenderingFunctorRetEnum>& ret = tasks.getResults();
+            std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #endif
             for (it2 = ret.begin(); it2 != ret.end(); ++it2) {
@@ -29,7 +29,7 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
 # Do not uncomment the following: pyside requires QtGui, because PySide/QtCore/pyside_qtcore_python.h includes qtextdocument.h
 #QT -= gui
 
-CONFIG += libmv-flags openmvg-flags glad-flags libtess-flags
+CONFIG += libmv-flags openmvg-flags glad-flags
 
 include(../global.pri)
 
@@ -76,6 +76,7 @@ SOURCES += \
     BlockingBackgroundRender.cpp \
     CLArgs.cpp \
     Cache.cpp \
+    CacheIndexFile.cpp \
     CoonsRegularization.cpp \
     CreateNodeArgs.cpp \
     Curve.cpp \
@@ -104,17 +105,21 @@ SOURCES += \
     HostOverlaySupport.cpp \
     Image.cpp \
     ImageConvert.cpp \
+    ImageConvertKernels.cpp \
     ImageCopyChannels.cpp \
     ImageKey.cpp \
     ImageMaskMix.cpp \
     ImageParamsSerialization.cpp \
     ImagePlaneDesc.cpp \
+    InstructionSet.cpp \
     Interpolation.cpp \
     JoinViewsNode.cpp \
     Knob.cpp \
+    KnobExpression.cpp \
     KnobFactory.cpp \
     KnobFile.cpp \
     KnobSerialization.cpp \
+    KnobsSnapshot.cpp \
     KnobTypes.cpp \
     LibraryBinary.cpp \
     Log.cpp \
@@ -122,6 +127,7 @@ SOURCES += \
     Markdown.cpp \
     MemoryFile.cpp \
     MemoryInfo.cpp \
+    MipMapKernels.cpp \
     NoOpBase.cpp \
     Node.cpp \
     NodeDocumentation.cpp \
@@ -170,12 +176,14 @@ SOURCES += \
     RectD.cpp \
     RectI.cpp \
     RenderStats.cpp \
+    RenderThreadsController.cpp \
     RotoContext.cpp \
     RotoDrawableItem.cpp \
     RotoItem.cpp \
     RotoLayer.cpp \
     RotoPaint.cpp \
     RotoPaintInteract.cpp \
+    RotoShapeRasterizer.cpp \
     RotoSmear.cpp \
     RotoStrokeItem.cpp \
     RotoUndoCommand.cpp \
@@ -185,21 +193,25 @@ SOURCES += \
     StandardPaths.cpp \
     StringAnimationManager.cpp \
     TLSHolder.cpp \
+    TaskScheduler.cpp \
     Texture.cpp \
     TextureRect.cpp \
     ThreadPool.cpp \
+    TileBitmap.cpp \
     TimeLine.cpp \
     Timer.cpp \
     TrackMarker.cpp \
     TrackerContext.cpp \
     TrackerContextPrivate.cpp \
     TrackerFrameAccessor.cpp \
+    TrackerKernels.cpp \
     TrackerNode.cpp \
     TrackerNodeInteract.cpp \
     TrackerUndoCommand.cpp \
     Transform.cpp \
     Utils.cpp \
     ViewerInstance.cpp \
+    ViewerTextureKernels.cpp \
     WriteNode.cpp \
     ../Global/glad_source.c \
     ../Global/FStreamsSupport.cpp \
@@ -274,6 +286,7 @@ HEADERS += \
     Cache.h \
     CacheEntry.h \
     CacheEntryHolder.h \
+    CacheIndexFile.h \
     CacheSerialization.h \
     ChoiceOption.h \
     CoonsRegularization.h \
@@ -310,21 +323,25 @@ HEADERS += \
     HistogramCPU.h \
     HostOverlaySupport.h \
     Image.h \
+    ImageConvertKernels.h \
     ImageKey.h \
     ImageLocker.h \
     ImageParams.h \
     ImageParamsSerialization.h \
     ImagePlaneDesc.h \
     ImageSerialization.h \
+    InstructionSet.h \
     Interpolation.h \
     JoinViewsNode.h \
     KeyHelper.h \
     Knob.h \
+    KnobExpression.h \
     KnobFactory.h \
     KnobFile.h \
     KnobGuiI.h \
     KnobImpl.h \
     KnobSerialization.h \
+    KnobsSnapshot.h \
     KnobTypes.h \
     LRUHashTable.h \
     LibraryBinary.h \
@@ -335,6 +352,7 @@ HEADERS += \
     MemoryFile.h \
     MemoryInfo.h \
     MergingEnum.h \
+    MipMapKernels.h \
     NoOpBase.h \
     Node.h \
     NodeGraphI.h \
@@ -388,6 +406,7 @@ HEADERS += \
     RectI.h \
     RectISerialization.h \
     RenderStats.h \
+    RenderThreadsController.h \
     RotoContext.h \
     RotoContextPrivate.h \
     RotoContextSerialization.h \
@@ -399,6 +418,7 @@ HEADERS += \
     RotoLayerSerialization.h \
     RotoPaint.h \
     RotoPaintInteract.h \
+    RotoShapeRasterizer.h \
     RotoPoint.h \
     RotoSmear.h \
     RotoStrokeItem.h \
@@ -412,10 +432,12 @@ HEADERS += \
     StringAnimationManager.h \
     TLSHolder.h \
     TLSHolderImpl.h \
+    TaskScheduler.h \
     Texture.h \
     TextureRect.h \
     TextureRectSerialization.h \
     ThreadPool.h \
+    TileBitmap.h \
     ThreadStorage.h \
     TimeLine.h \
     TimeLineKeyFrames.h \
@@ -424,6 +446,7 @@ HEADERS += \
     TrackerContext.h \
     TrackerContextPrivate.h \
     TrackerFrameAccessor.h \
+    TrackerKernels.h \
     TrackerNode.h \
     TrackerNodeInteract.h \
     TrackerSerialization.h \
@@ -437,6 +460,7 @@ HEADERS += \
     ViewIdx.h \
     ViewerInstance.h \
     ViewerInstancePrivate.h \
+    ViewerTextureKernels.h \
     WriteNode.h \
     fstream_mingw.h \
     ../Global/Enums.h \
@@ -37,6 +37,8 @@ namespace boost {
 template<class T> class weak_ptr;
 template<class T> class shared_ptr;
 namespace archive {
+class binary_iarchive;
+class binary_oarchive;
 class xml_iarchive;
 class xml_oarchive;
 }
@@ -132,6 +134,7 @@ class CLArgs;
 class CacheEntryHolder;
 class CacheSignalEmitter;
 class ChoiceExtraData;
+class ConvertedInputImages;
 class CreateNodeArgs;
 class Curve;
 class Dimension;
@@ -170,6 +173,7 @@ class KnobButton;
 class KnobChoice;
 class KnobColor;
 class KnobDouble;
+class KnobExpression;
 class KnobFactory;
 class KnobFile;
 class KnobGroup;
@@ -190,6 +194,7 @@ class KnobSignalSlotHandler;
 class KnobString;
 class KnobTLSData;
 class KnobTable;
+class KnobsSnapshot;
 class LibraryBinary;
 class LogEntry;
 class MemoryFile;
@@ -244,11 +249,13 @@ class RotoLayerSerialization;
 class RotoPaint;
 class RotoPaintInteract;
 class RotoPoint;
+class RotoShapeRasterizer;
 class RotoStrokeItem;
 class RotoStrokeItemSerialization;
 class Settings;
 class StringAnimationManager;
 class TLSHolderBase;
+class TaskScheduler;
 class Texture;
 class TextureRect;
 class TileCacheFile;
@@ -261,6 +268,7 @@ class TrackSerialization;
 class TrackerContext;
 class TrackerContextSerialization;
 class TrackerFrameAccessor;
+class TrackerFrameCache;
 class TrackerNode;
 class TrackerNodeInteract;
 class UndoCommand;
@@ -330,6 +338,7 @@ typedef boost::shared_ptr<BezierCP> BezierCPPtr;
 typedef boost::shared_ptr<BezierSerialization> BezierSerializationPtr;
 typedef boost::shared_ptr<BufferableObject> BufferableObjectPtr;
 typedef boost::shared_ptr<CacheSignalEmitter> CacheSignalEmitterPtr;
+typedef boost::shared_ptr<ConvertedInputImages> ConvertedInputImagesPtr;
 typedef boost::shared_ptr<Curve> CurvePtr;
 typedef boost::shared_ptr<EffectInstance> EffectInstancePtr;
 typedef boost::shared_ptr<ExistenceCheckerThread> ExistenceCheckerThreadPtr;
@@ -356,6 +365,7 @@ typedef boost::shared_ptr<KnobButton> KnobButtonPtr;
 typedef boost::shared_ptr<KnobChoice> KnobChoicePtr;
 typedef boost::shared_ptr<KnobColor> KnobColorPtr;
 typedef boost::shared_ptr<KnobDouble> KnobDoublePtr;
+typedef boost::shared_ptr<KnobExpression> KnobExpressionPtr;
 typedef boost::shared_ptr<KnobFactory> KnobFactoryPtr;
 typedef boost::shared_ptr<KnobFile> KnobFilePtr;
 typedef boost::shared_ptr<KnobGroup> KnobGroupPtr;
@@ -373,6 +383,7 @@ typedef boost::shared_ptr<KnobSeparator> KnobSeparatorPtr;
 typedef boost::shared_ptr<KnobSerialization> KnobSerializationPtr;
 typedef boost::shared_ptr<KnobSerializationBase> KnobSerializationBasePtr;
 typedef boost::shared_ptr<KnobSerializationBase> KnobsSerializationBasePtr;
+typedef boost::shared_ptr<KnobsSnapshot> KnobsSnapshotPtr;
 typedef boost::shared_ptr<KnobSignalSlotHandler> KnobSignalSlotHandlerPtr;
 typedef boost::shared_ptr<KnobString> KnobStringPtr;
 typedef boost::shared_ptr<KnobTLSData> KnobTLSDataPtr;
@@ -423,6 +434,7 @@ typedef boost::shared_ptr<TrackMarker> TrackMarkerPtr;
 typedef boost::shared_ptr<TrackMarkerAndOptions> TrackMarkerAndOptionsPtr;
 typedef boost::shared_ptr<TrackerContext> TrackerContextPtr;
 typedef boost::shared_ptr<TrackerFrameAccessor> TrackerFrameAccessorPtr;
+typedef boost::shared_ptr<TrackerFrameCache> TrackerFrameCachePtr;
 typedef boost::shared_ptr<TrackerNode> TrackerNodePtr;
 typedef boost::shared_ptr<TrackerNodeInteract> TrackerNodeInteractPtr;
 typedef boost::shared_ptr<UndoCommand> UndoCommandPtr;
@@ -24,7 +24,6 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
 #include <cassert>
 #include <stdexcept>
 
@@ -35,25 +34,113 @@
 
 #include "Engine/Node.h"
 
+#define NATRON_CRC64_POLYNOMIAL 0x42F0E1EBA9EA3693ULL
+
 NATRON_NAMESPACE_ENTER
 
+namespace {
+/*
+ * Tables for the slice-by-8 CRC-64 (MSB first, no reflection, no final xor).
+ * table[0] is the classic byte-wise table, table[k][b] is the checksum of byte b
+ * followed by k zero bytes, so that 8 bytes can be folded in with 8 independent lookups.
+ */
+struct Crc64Tables
+{
+    U64 table[8][256];
+
+    Crc64Tables()
+    {
+        for (int b = 0; b < 256; ++b) {
+            U64 crc = (U64)b << 56;
+            for (int i = 0; i < 8; ++i) {
+                crc = (crc & 0x8000000000000000ULL) ? (crc << 1) ^ NATRON_CRC64_POLYNOMIAL : (crc << 1);
+            }
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int b = 0; b < 256; ++b) {
+                U64 prev = table[k - 1][b];
+                table[k][b] = (prev << 8) ^ table[0][prev >> 56];
+            }
+        }
+    }
+};
+
+const Crc64Tables crc64Tables;
+
+// Folds 8 bytes into crc
+inline U64
+crc64Update8(U64 crc,
+             const unsigned char* p)
+{
+    // The first byte must end up in the most significant byte, whatever the endianness of the host
+    crc ^= ( (U64)p[0] << 56 ) | ( (U64)p[1] << 48 ) | ( (U64)p[2] << 40 ) | ( (U64)p[3] << 32 ) |
+           ( (U64)p[4] << 24 ) | ( (U64)p[5] << 16 ) | ( (U64)p[6] << 8 ) | (U64)p[7];
+
+    const U64 (*t)[256] = crc64Tables.table;
+
+    return t[7][crc >> 56] ^ t[6][(crc >> 48) & 0xFF] ^ t[5][(crc >> 40) & 0xFF] ^ t[4][(crc >> 32) & 0xFF] ^
+           t[3][(crc >> 24) & 0xFF] ^ t[2][(crc >> 16) & 0xFF] ^ t[1][(crc >> 8) & 0xFF] ^ t[0][crc & 0xFF];
+}
+} // anon namespace
+
+U64
+Hash64::updateCrc64(U64 crc,
+                    const unsigned char* data,
+                    std::size_t size)
+{
+#ifdef NATRON_HASH64_USE_BOOST_CRC
+    boost::crc_optimal<64, NATRON_CRC64_POLYNOMIAL, 0, 0, false, false> crc_64(crc);
+    crc_64.process_bytes(data, size);
+
+    return crc_64.checksum();
+#else
+    const unsigned char* end = data + size;
+    for (; data + 8 <= end; data += 8) {
+        crc = crc64Update8(crc, data);
+    }
+    for (; data < end; ++data) {
+        crc = (crc << 8) ^ crc64Tables.table[0][(crc >> 56) ^ *data];
+    }
+
+    return crc;
+#endif
+}
+
+void
+Hash64::appendU64(U64 value)
+{
+#ifdef NATRON_HASH64_USE_BOOST_CRC
+    crc = updateCrc64( crc, reinterpret_cast<const unsigned char*>(&value), sizeof(value) );
+#else
+    crc = crc64Update8( crc, reinterpret_cast<const unsigned char*>(&value) );
+#endif
+    ++nValues;
+}
+
+void
+Hash64::appendValues(const U64* values,
+                     std::size_t count)
+{
+    crc = updateCrc64( crc, reinterpret_cast<const unsigned char*>(values), count * sizeof(U64) );
+    nValues += count;
+}
+
 void
 Hash64::computeHash()
 {
-    if ( node_values.empty() ) {
+    if (nValues == 0) {
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    hash = crc;
 }
 
 void
 Hash64::reset()
 {
-    node_values.clear();
+    crc = 0;
+    nValues = 0;
     hash = 0;
 }
 
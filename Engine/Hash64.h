@@ -28,6 +28,7 @@
 #include "Global/Macros.h"
 
 #include <vector>
+#include <cstddef>
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/static_assert.hpp>
 #endif
@@ -43,17 +44,27 @@ NATRON_NAMESPACE_ENTER
     - the hash values for the  tree upstream
  */
 
+// When defined, the checksum is computed byte by byte with boost::crc instead of the slice-by-8 implementation.
+// Both give the same hash values.
+//#define NATRON_HASH64_USE_BOOST_CRC
+
+/**
+ * @brief A 64-bit CRC (ECMA-182 polynomial) of a sequence of 64-bit values.
+ * Values are folded into the checksum as they are appended, 8 bytes at a time,
+ * so that no intermediate buffer is needed.
+ **/
 class Hash64
 {
 public:
     Hash64()
+        : hash(0)
+        , crc(0)
+        , nValues(0)
     {
-        hash = 0;
     }
 
     ~Hash64()
     {
-        node_values.clear();
     }
 
     U64 value() const
@@ -86,9 +97,14 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
+        appendU64( toU64(value) );
     }
 
+    /**
+     * @brief Appends count values at once, this is faster than calling append() for each value.
+     **/
+    void appendValues(const U64* values, std::size_t count);
+
     bool operator== (const Hash64 & h) const
     {
         return this->hash == h.value();
@@ -99,7 +115,15 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
         return this->hash != h.value();
     }
 
+    /**
+     * @brief Updates the CRC-64 crc with the given bytes. This is the same as boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false>
+     **/
+    static U64 updateCrc64(U64 crc, const unsigned char* data, std::size_t size);
+
 private:
+
+    void appendU64(U64 value);
+
     template<typename T>
     struct alias_cast_t
     {
@@ -116,7 +140,10 @@ private:
     };
 
     U64 hash;
-    std::vector<U64> node_values;
+
+    // The checksum of the values appended since the last reset()
+    U64 crc;
+    std::size_t nValues;
 };
 
 void Hash64_appendQString(Hash64* hash, const QString & str);
@@ -26,6 +26,7 @@
 
 #include <algorithm> // min, max
 #include <cassert>
+#include <climits> // INT_MIN
 #include <cstring> // for std::memcpy, std::memset
 #include <stdexcept>
 
@@ -42,179 +43,406 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/GPUContextPool.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/GLShader.h"
+#include "Engine/MipMapKernels.h"
+#include "Engine/TaskScheduler.h"
 
 NATRON_NAMESPACE_ENTER
 
-#define BM_GET(i, j) (&_map[( i - _bounds.bottom() ) * _bounds.width() + ( j - _bounds.left() )])
-
 #define PIXEL_UNAVAILABLE 2
 
-template <int trimap>
-RectI
-minimalNonMarkedBbox_internal(const RectI& roi,
-                              const RectI& _bounds,
-                              const std::vector<char>& _map,
-                              bool* isBeingRenderedElsewhere)
+#define BM_BLOCK_SHIFT 5
+#define BM_BLOCK_SIZE (1 << BM_BLOCK_SHIFT)
+#define BM_BLOCK_MASK (BM_BLOCK_SIZE - 1)
+
+// State of a block whose pixels differ
+#define BM_BLOCK_MIXED 3
+
+// Sets of pixel states used for the queries
+#define BM_VALUES_0 (1 << 0)
+#define BM_VALUES_1 (1 << 1)
+#define BM_VALUES_2 (1 << PIXEL_UNAVAILABLE)
+#define BM_VALUES_MARKED (BM_VALUES_1 | BM_VALUES_2)
+
+// The pixels that are left to render: with the trimap the pixels being rendered elsewhere are not
+#define BM_VALUES_NON_MARKED(trimap) ( (trimap) ? BM_VALUES_0 : (BM_VALUES_0 | BM_VALUES_2) )
+
+// The low bit of each pixel of a block row
+#define BM_LOW_BITS 0x5555555555555555ULL
+
+namespace {
+// A block row with all its pixels set to value
+inline U64
+bmRowPattern(char value)
 {
-    RectI bbox;
+    return (U64)value * BM_LOW_BITS;
+}
 
-    assert( _bounds.contains(roi) );
-    bbox = roi;
+// The bits of the columns [c1,c2) of a block row
+inline U64
+bmRowColumnsMask(int c1,
+                 int c2)
+{
+    U64 mask = (c2 - c1 == BM_BLOCK_SIZE) ? ~0ULL : ( (1ULL << ( 2 * (c2 - c1) ) ) - 1 );
 
-    //find bottom
-    for (int i = bbox.bottom(); i < bbox.top(); ++i) {
-        const char* buf = BM_GET( i, bbox.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
+    return mask << (2 * c1);
+}
+
+// The bits of the columns [c1,c2) of a pixel mask
+inline U32
+bmColumnsMask(int c1,
+              int c2)
+{
+    U32 mask = (c2 - c1 == BM_BLOCK_SIZE) ? 0xFFFFFFFFU : ( (1U << (c2 - c1) ) - 1 );
+
+    return mask << c1;
+}
+
+// Gathers the low bit of each pixel of a block row in a pixel mask
+inline U32
+bmCompactLowBits(U64 x)
+{
+    x &= BM_LOW_BITS;
+    x = ( x | (x >> 1) ) & 0x3333333333333333ULL;
+    x = ( x | (x >> 2) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | (x >> 4) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | (x >> 8) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | (x >> 16) ) & 0x00000000FFFFFFFFULL;
+
+    return (U32)x;
+}
+
+// The index of the lowest set bit of a non 0 mask
+inline int
+bmLowestBit(U32 mask)
+{
+    assert(mask);
+    int ret = 0;
+    while ( !(mask & 1) ) {
+        mask >>= 1;
+        ++ret;
+    }
+
+    return ret;
+}
+} // anon namespace
+
+void
+Bitmap::initialize(const RectI & bounds)
+{
+    _bounds = bounds;
+    if ( _bounds.isNull() ) {
+        _blocksPerRow = 0;
+        _blocksPerColumn = 0;
+    } else {
+        _blocksPerRow = ( _bounds.width() + BM_BLOCK_MASK ) >> BM_BLOCK_SHIFT;
+        _blocksPerColumn = ( _bounds.height() + BM_BLOCK_MASK ) >> BM_BLOCK_SHIFT;
+    }
+    std::size_t nBlocks = (std::size_t)_blocksPerRow * _blocksPerColumn;
+    _blockStates.assign(nBlocks, 0);
+    _blockSlots.assign(nBlocks, -1);
+    _blockRows.clear();
+    _freeSlots.clear();
+}
+
+void
+Bitmap::setTo1()
+{
+    std::fill(_blockStates.begin(), _blockStates.end(), 1);
+    std::fill(_blockSlots.begin(), _blockSlots.end(), -1);
+    _blockRows.clear();
+    _freeSlots.clear();
+}
+
+std::size_t
+Bitmap::getMaximumMemorySize() const
+{
+    return _blockStates.size() * ( sizeof(unsigned char) + sizeof(int) + BM_BLOCK_SIZE * sizeof(U64) );
+}
+
+U32
+Bitmap::getBlockRowPixels(int block,
+                          int r,
+                          int values) const
+{
+    unsigned char state = _blockStates[block];
+
+    if (state != BM_BLOCK_MIXED) {
+        return ( (values >> state) & 1 ) ? 0xFFFFFFFFU : 0;
+    }
+    U64 row = _blockRows[_blockSlots[block] * BM_BLOCK_SIZE + r];
+    U64 pixels = 0;
+    for (char v = 0; v <= PIXEL_UNAVAILABLE; ++v) {
+        if ( (values >> v) & 1 ) {
+            // both bits of a pixel are set in equal if its state is v
+            U64 equal = ~( row ^ bmRowPattern(v) );
+            pixels |= equal & (equal >> 1);
+        }
+    }
+
+    return bmCompactLowBits(pixels);
+}
+
+bool
+Bitmap::rowMatches(int y,
+                   int x1,
+                   int x2,
+                   int values,
+                   bool all) const
+{
+    int by = (y - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int r = (y - _bounds.y1) & BM_BLOCK_MASK;
+    int bx1 = (x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int bx = bx1; bx < bx2; ++bx) {
+        int c1 = (bx == bx1) ? ( (x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+        int c2 = (bx == bx2 - 1) ? ( ( (x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        U32 columns = bmColumnsMask(c1, c2);
+        U32 pixels = getBlockRowPixels(by * _blocksPerRow + bx, r, values) & columns;
+        if ( all ? (pixels != columns) : (pixels != 0) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int
+Bitmap::countMatchingRows(const RectI& rect,
+                          int values,
+                          bool fromBottom,
+                          bool all) const
+{
+    if ( rect.isNull() ) {
+        return 0;
+    }
+    int bx1 = (rect.x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (rect.x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+    int by1 = (rect.y1 - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int by2 = ( (rect.y2 - 1 - _bounds.y1) >> BM_BLOCK_SHIFT ) + 1;
+    int count = 0;
+
+    for (int i = 0; i < by2 - by1; ++i) {
+        int by = fromBottom ? (by1 + i) : (by2 - 1 - i);
+        int y1 = std::max( rect.y1, _bounds.y1 + (by << BM_BLOCK_SHIFT) );
+        int y2 = std::min( rect.y2, _bounds.y1 + ( (by + 1) << BM_BLOCK_SHIFT ) );
+
+        // when all the blocks are uniform, all the rows of this row of blocks match or none does
+        bool uniform = true;
+        for (int bx = bx1; bx < bx2; ++bx) {
+            if (_blockStates[by * _blocksPerRow + bx] == BM_BLOCK_MIXED) {
+                uniform = false;
                 break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                ++bbox.y1;
-            } else {
-                ++bbox.y1;
             }
-        } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
+        }
+        if (uniform) {
+            if ( !rowMatches(y1, rect.x1, rect.x2, values, all) ) {
+                return count;
             }
-            if (!buf) {
-                break;
-            } else {
-                ++bbox.y1;
+            count += y2 - y1;
+            continue;
+        }
+        for (int j = 0; j < y2 - y1; ++j) {
+            int y = fromBottom ? (y1 + j) : (y2 - 1 - j);
+            if ( !rowMatches(y, rect.x1, rect.x2, values, all) ) {
+                return count;
             }
+            ++count;
         }
     }
 
-    //find top (will do zero iteration if the bbox is already empty)
-    for (int i = bbox.top() - 1; i >= bbox.bottom(); --i) {
-        const char* buf = BM_GET( i, bbox.left() );
+    return count;
+}
 
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
+int
+Bitmap::countMatchingColumns(const RectI& rect,
+                             int values,
+                             bool fromLeft,
+                             bool all) const
+{
+    if ( rect.isNull() ) {
+        return 0;
+    }
+    int bx1 = (rect.x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (rect.x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+    int by1 = (rect.y1 - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int by2 = ( (rect.y2 - 1 - _bounds.y1) >> BM_BLOCK_SHIFT ) + 1;
+    int count = 0;
+
+    for (int i = 0; i < bx2 - bx1; ++i) {
+        int bx = fromLeft ? (bx1 + i) : (bx2 - 1 - i);
+        int c1 = (bx == bx1) ? ( (rect.x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+        int c2 = (bx == bx2 - 1) ? ( ( (rect.x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        U32 columns = bmColumnsMask(c1, c2);
+
+        // the columns of this column of blocks that match on all the rows
+        U32 matching = columns;
+        for (int by = by1; by < by2 && matching; ++by) {
+            int block = by * _blocksPerRow + bx;
+            int r1 = (by == by1) ? ( (rect.y1 - _bounds.y1) & BM_BLOCK_MASK ) : 0;
+            int r2 = (by == by2 - 1) ? ( ( (rect.y2 - 1 - _bounds.y1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+            if (_blockStates[block] != BM_BLOCK_MIXED) {
+                r2 = r1 + 1;
             }
-            if (!buf) {
-                break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                --bbox.y2;
-            } else {
-                --bbox.y2;
+            for (int r = r1; r < r2 && matching; ++r) {
+                U32 pixels = getBlockRowPixels(block, r, values);
+                matching &= all ? pixels : ~pixels;
             }
-        } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
+        }
+        if (matching == columns) {
+            count += c2 - c1;
+            continue;
+        }
+        if (fromLeft) {
+            for (int c = c1; c < c2 && ( (matching >> c) & 1 ); ++c) {
+                ++count;
             }
-            if (!buf) {
-                break;
-            } else {
-                --bbox.y2;
+        } else {
+            for (int c = c2 - 1; c >= c1 && ( (matching >> c) & 1 ); --c) {
+                ++count;
             }
         }
-    }
 
-    // avoid making bbox.width() iterations for nothing
-    if ( bbox.isNull() ) {
-        return bbox;
+        return count;
     }
 
-    //find left
-    for (int j = bbox.left(); j < bbox.right(); ++j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
+    return count;
+} // Bitmap::countMatchingColumns
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
+bool
+Bitmap::containsValues(const RectI& rect,
+                       int values) const
+{
+    if ( rect.isNull() ) {
+        return false;
+    }
+    int bx1 = (rect.x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (rect.x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+    int by1 = (rect.y1 - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int by2 = ( (rect.y2 - 1 - _bounds.y1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int by = by1; by < by2; ++by) {
+        int r1 = (by == by1) ? ( (rect.y1 - _bounds.y1) & BM_BLOCK_MASK ) : 0;
+        int r2 = (by == by2 - 1) ? ( ( (rect.y2 - 1 - _bounds.y1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        for (int bx = bx1; bx < bx2; ++bx) {
+            int block = by * _blocksPerRow + bx;
+            unsigned char state = _blockStates[block];
+            if (state != BM_BLOCK_MIXED) {
+                if ( (values >> state) & 1 ) {
+                    return true;
                 }
+                continue;
             }
-        }
-        if (pix) {
-            ++bbox.x1;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
+            int c1 = (bx == bx1) ? ( (rect.x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+            int c2 = (bx == bx2 - 1) ? ( ( (rect.x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+            U32 columns = bmColumnsMask(c1, c2);
+            for (int r = r1; r < r2; ++r) {
+                if (getBlockRowPixels(block, r, values) & columns) {
+                    return true;
+                }
             }
-        } else {
-            break;
         }
     }
 
-    //find right
-    for (int j = bbox.right() - 1; j >= bbox.left(); --j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
+    return false;
+}
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
-                }
+char
+Bitmap::getFirstMarkedPixelInRow(int y,
+                                 int x1,
+                                 int x2) const
+{
+    int by = (y - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int r = (y - _bounds.y1) & BM_BLOCK_MASK;
+    int bx1 = (x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int bx = bx1; bx < bx2; ++bx) {
+        int c1 = (bx == bx1) ? ( (x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+        int c2 = (bx == bx2 - 1) ? ( ( (x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        U32 marked = getBlockRowPixels(by * _blocksPerRow + bx, r, BM_VALUES_MARKED) & bmColumnsMask(c1, c2);
+        if (marked) {
+            return getPixel(_bounds.x1 + (bx << BM_BLOCK_SHIFT) + bmLowestBit(marked), y);
+        }
+    }
+
+    return 0;
+}
+
+char
+Bitmap::getFirstMarkedPixelInColumn(int x,
+                                    int y1,
+                                    int y2) const
+{
+    int bx = (x - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int c = (x - _bounds.x1) & BM_BLOCK_MASK;
+    int by1 = (y1 - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int by2 = ( (y2 - 1 - _bounds.y1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int by = by1; by < by2; ++by) {
+        int block = by * _blocksPerRow + bx;
+        unsigned char state = _blockStates[block];
+        if (state != BM_BLOCK_MIXED) {
+            if (state) {
+                return (char)state;
             }
+            continue;
         }
-        if (pix) {
-            --bbox.x2;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
+        int r1 = (by == by1) ? ( (y1 - _bounds.y1) & BM_BLOCK_MASK ) : 0;
+        int r2 = (by == by2 - 1) ? ( ( (y2 - 1 - _bounds.y1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        const U64* rows = &_blockRows[_blockSlots[block] * BM_BLOCK_SIZE];
+        for (int r = r1; r < r2; ++r) {
+            char value = (char)( (rows[r] >> (2 * c) ) & 3 );
+            if (value) {
+                return value;
             }
+        }
+    }
+
+    return 0;
+}
+
+template <int trimap>
+RectI
+Bitmap::minimalNonMarkedBbox_internal(const RectI& roi,
+                                      bool* isBeingRenderedElsewhere) const
+{
+    const int nonMarked = BM_VALUES_NON_MARKED(trimap);
+    RectI bbox;
+
+    assert( _bounds.contains(roi) );
+    bbox = roi;
+
+    //find bottom and top: remove the rows without any pixel left to render
+    bbox.y1 += countMatchingRows(bbox, nonMarked, true, false);
+    bbox.y2 -= countMatchingRows(bbox, nonMarked, false, false);
+
+    //find left and right (will do nothing if the bbox is already empty)
+    if ( !bbox.isNull() ) {
+        bbox.x1 += countMatchingColumns(bbox, nonMarked, true, false);
+        bbox.x2 -= countMatchingColumns(bbox, nonMarked, false, false);
+    }
+
+    // flag if a removed row or column has pixels being rendered
+    if (trimap && !*isBeingRenderedElsewhere) {
+        if ( bbox.isNull() ) {
+            *isBeingRenderedElsewhere = containsValues(roi, BM_VALUES_2);
         } else {
-            break;
+            *isBeingRenderedElsewhere = containsValues(RectI(roi.x1, roi.y1, roi.x2, bbox.y1), BM_VALUES_2) ||
+                                        containsValues(RectI(roi.x1, bbox.y2, roi.x2, roi.y2), BM_VALUES_2) ||
+                                        containsValues(RectI(roi.x1, bbox.y1, bbox.x1, bbox.y2), BM_VALUES_2) ||
+                                        containsValues(RectI(bbox.x2, bbox.y1, roi.x2, bbox.y2), BM_VALUES_2);
         }
     }
 
     return bbox;
 } // minimalNonMarkedBbox_internal
 
-
 template <int trimap>
 void
-minimalNonMarkedRects_internal(const RectI & roi,
-                               const RectI& _bounds,
-                               const std::vector<char>& _map,
-                               std::list<RectI>& ret,
-                               bool* isBeingRenderedElsewhere)
+Bitmap::minimalNonMarkedRects_internal(const RectI & roi,
+                                       std::list<RectI>& ret,
+                                       bool* isBeingRenderedElsewhere) const
 {
     assert(ret.empty());
     ///Any out of bounds portion is pushed to the rectangles to render
@@ -250,7 +478,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
         return;
     }
 
-    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, _bounds, _map, isBeingRenderedElsewhere);
+    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, isBeingRenderedElsewhere);
     assert( (trimap && isBeingRenderedElsewhere) || (!trimap && !isBeingRenderedElsewhere) );
 
     //#define NATRON_BITMAP_DISABLE_OPTIMIZATION
@@ -283,45 +511,20 @@ minimalNonMarkedRects_internal(const RectI & roi,
     // CXXXXXXXXXXDDD
     // CXXXXXXXXXXDDD
     // AAAAAAAAAAAAAA
+    //
+    // With the trimap, a row or column stops a rectangle as soon as it meets a pixel
+    // that is rendered or being rendered, and it is flagged if the first one is being rendered.
+    const int nonMarked = BM_VALUES_NON_MARKED(trimap);
 
     // First, find if there's an "A" rectangle, and push it to the result
     //find bottom
     RectI bboxX = bboxM;
     RectI bboxA = bboxX;
     bboxA.set_top( bboxX.bottom() );
-    for (int i = bboxX.bottom(); i < bboxX.top(); ++i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                break;
-            }
-        }
+    bboxX.y1 += countMatchingRows(bboxX, nonMarked, true, true);
+    bboxA.y2 = bboxX.y1;
+    if ( trimap && (bboxX.y1 < bboxX.y2) && (getFirstMarkedPixelInRow(bboxX.y1, bboxX.x1, bboxX.x2) == PIXEL_UNAVAILABLE) ) {
+        *isBeingRenderedElsewhere = true;
     }
     if ( !bboxA.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxA);
@@ -331,40 +534,10 @@ minimalNonMarkedRects_internal(const RectI & roi,
     //find top
     RectI bboxB = bboxX;
     bboxB.set_bottom( bboxX.top() );
-    for (int i = bboxX.top() - 1; i >= bboxX.bottom(); --i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                break;
-            }
-        }
+    bboxX.y2 -= countMatchingRows(bboxX, nonMarked, false, true);
+    bboxB.y1 = bboxX.y2;
+    if ( trimap && (bboxX.y1 < bboxX.y2) && (getFirstMarkedPixelInRow(bboxX.y2 - 1, bboxX.x1, bboxX.x2) == PIXEL_UNAVAILABLE) ) {
+        *isBeingRenderedElsewhere = true;
     }
     if ( !bboxB.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxB);
@@ -374,29 +547,10 @@ minimalNonMarkedRects_internal(const RectI & roi,
     RectI bboxC = bboxX;
     bboxC.set_right( bboxX.left() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.left(); j < bboxX.right(); ++j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                ++bboxX.x1;
-                bboxC.x2 = bboxX.x1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
+        bboxX.x1 += countMatchingColumns(bboxX, nonMarked, true, true);
+        bboxC.x2 = bboxX.x1;
+        if ( trimap && (bboxX.x1 < bboxX.x2) && (getFirstMarkedPixelInColumn(bboxX.x1, bboxX.y1, bboxX.y2) == PIXEL_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true;
         }
     }
     if ( !bboxC.isNull() ) { // empty boxes should not be pushed
@@ -407,29 +561,10 @@ minimalNonMarkedRects_internal(const RectI & roi,
     RectI bboxD = bboxX;
     bboxD.set_left( bboxX.right() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.right() - 1; j >= bboxX.left(); --j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                --bboxX.x2;
-                bboxD.x1 = bboxX.x2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
+        bboxX.x2 -= countMatchingColumns(bboxX, nonMarked, false, true);
+        bboxD.x1 = bboxX.x2;
+        if ( trimap && (bboxX.x1 < bboxX.x2) && (getFirstMarkedPixelInColumn(bboxX.x2 - 1, bboxX.y1, bboxX.y2) == PIXEL_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true;
         }
     }
     if ( !bboxD.isNull() ) { // empty boxes should not be pushed
@@ -457,7 +592,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
     assert( bboxD.bottom() == bboxX.bottom() );
 
     // get the bounding box of what's left (the X rectangle in the drawing above)
-    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, _bounds, _map, isBeingRenderedElsewhere);
+    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, isBeingRenderedElsewhere);
 
     if ( !bboxX.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxX);
@@ -475,9 +610,9 @@ Bitmap::minimalNonMarkedBbox(const RectI & roi) const
             return RectI();
         }
 
-        return minimalNonMarkedBbox_internal<0>(realRoi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(realRoi, NULL);
     } else {
-        return minimalNonMarkedBbox_internal<0>(roi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(roi, NULL);
     }
 }
 
@@ -490,9 +625,9 @@ Bitmap::minimalNonMarkedRects(const RectI & roi,
         if ( !roi.intersect(_dirtyZone, &realRoi) ) {
             return;
         }
-        minimalNonMarkedRects_internal<0>(realRoi, _bounds, _map, ret, NULL);
+        minimalNonMarkedRects_internal<0>(realRoi, ret, NULL);
     } else {
-        minimalNonMarkedRects_internal<0>(roi, _bounds, _map, ret, NULL);
+        minimalNonMarkedRects_internal<0>(roi, ret, NULL);
     }
 }
 
@@ -509,9 +644,9 @@ Bitmap::minimalNonMarkedBbox_trimap(const RectI & roi,
             return RectI();
         }
 
-        return minimalNonMarkedBbox_internal<1>(realRoi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(realRoi, isBeingRenderedElsewhere);
     } else {
-        return minimalNonMarkedBbox_internal<1>(roi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(roi, isBeingRenderedElsewhere);
     }
 }
 
@@ -527,30 +662,116 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,
 
             return;
         }
-        minimalNonMarkedRects_internal<1>(realRoi, _bounds, _map, ret, isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(realRoi, ret, isBeingRenderedElsewhere);
     } else {
-        minimalNonMarkedRects_internal<1>(roi, _bounds, _map, ret, isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(roi, ret, isBeingRenderedElsewhere);
     }
 }
 
 #endif
 
 void
-Bitmap::markFor(const RectI & roi, char value)
+Bitmap::setBlockMixed(int block)
+{
+    unsigned char state = _blockStates[block];
+
+    if (state == BM_BLOCK_MIXED) {
+        return;
+    }
+    int slot;
+    if ( !_freeSlots.empty() ) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        slot = (int)(_blockRows.size() / BM_BLOCK_SIZE);
+        _blockRows.resize(_blockRows.size() + BM_BLOCK_SIZE);
+    }
+    std::fill( _blockRows.begin() + slot * BM_BLOCK_SIZE, _blockRows.begin() + (slot + 1) * BM_BLOCK_SIZE, bmRowPattern( (char)state ) );
+    _blockSlots[block] = slot;
+    _blockStates[block] = BM_BLOCK_MIXED;
+}
+
+void
+Bitmap::setBlockUniform(int block,
+                        char value)
+{
+    if (_blockStates[block] == BM_BLOCK_MIXED) {
+        _freeSlots.push_back(_blockSlots[block]);
+        _blockSlots[block] = -1;
+    }
+    _blockStates[block] = (unsigned char)value;
+}
+
+void
+Bitmap::compressBlock(int block,
+                      int bx,
+                      int by)
+{
+    assert(_blockStates[block] == BM_BLOCK_MIXED);
+    // only the pixels inside the bounds matter
+    int nCols = std::min(BM_BLOCK_SIZE, _bounds.width() - (bx << BM_BLOCK_SHIFT) );
+    int nRows = std::min(BM_BLOCK_SIZE, _bounds.height() - (by << BM_BLOCK_SHIFT) );
+    U64 columns = bmRowColumnsMask(0, nCols);
+    const U64* rows = &_blockRows[_blockSlots[block] * BM_BLOCK_SIZE];
+    char value = (char)(rows[0] & 3);
+    U64 pattern = bmRowPattern(value);
+
+    for (int r = 0; r < nRows; ++r) {
+        if ( (rows[r] ^ pattern) & columns ) {
+            return;
+        }
+    }
+    setBlockUniform(block, value);
+}
+
+void
+Bitmap::markFor(const RectI & roi,
+                char value)
 {
     int x1 = std::max(roi.x1, _bounds.x1);
     int y1 = std::max(roi.y1, _bounds.y1);
     int x2 = std::min(roi.x2, _bounds.x2);
     int y2 = std::min(roi.y2, _bounds.y2);
 
-    char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
-
-    for (int i = y1; i < y2; ++i, buf += w) {
-        std::memset( buf, value, roiw);
+    if ( (x1 >= x2) || (y1 >= y2) ) {
+        return;
     }
-}
+    int bx1 = (x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+    int by1 = (y1 - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int by2 = ( (y2 - 1 - _bounds.y1) >> BM_BLOCK_SHIFT ) + 1;
+    U64 pattern = bmRowPattern(value);
+
+    for (int by = by1; by < by2; ++by) {
+        int blockY1 = _bounds.y1 + (by << BM_BLOCK_SHIFT);
+        int blockY2 = std::min(blockY1 + BM_BLOCK_SIZE, _bounds.y2);
+        int r1 = std::max(y1, blockY1) - blockY1;
+        int r2 = std::min(y2, blockY2) - blockY1;
+        for (int bx = bx1; bx < bx2; ++bx) {
+            int block = by * _blocksPerRow + bx;
+            int blockX1 = _bounds.x1 + (bx << BM_BLOCK_SHIFT);
+            int blockX2 = std::min(blockX1 + BM_BLOCK_SIZE, _bounds.x2);
+            int c1 = std::max(x1, blockX1) - blockX1;
+            int c2 = std::min(x2, blockX2) - blockX1;
+
+            if ( (r1 == 0) && (r2 == blockY2 - blockY1) && (c1 == 0) && (c2 == blockX2 - blockX1) ) {
+                // the whole block is covered
+                setBlockUniform(block, value);
+                continue;
+            }
+            if (_blockStates[block] == (unsigned char)value) {
+                continue;
+            }
+            setBlockMixed(block);
+            U64 columns = bmRowColumnsMask(c1, c2);
+            U64* rows = &_blockRows[_blockSlots[block] * BM_BLOCK_SIZE];
+            for (int r = r1; r < r2; ++r) {
+                rows[r] = (rows[r] & ~columns) | (pattern & columns);
+            }
+            compressBlock(block, bx, by);
+        }
+    }
+} // Bitmap::markFor
 
 bool
 Bitmap::isNonMarked(const RectI & roi) const
@@ -560,18 +781,11 @@ Bitmap::isNonMarked(const RectI & roi) const
     int x2 = std::min(roi.x2, _bounds.x2);
     int y2 = std::min(roi.y2, _bounds.y2);
 
-    const char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
-
-    for (int i = y1; i < y2; ++i, buf += w) {
-        for (int j = 0; j < roiw; ++j) {
-            if (buf[j]) {
-                return false;
-            }
-        }
+    if ( (x1 >= x2) || (y1 >= y2) ) {
+        return true;
     }
-    return true;
+
+    return !containsValues(RectI(x1, y1, x2, y2), BM_VALUES_MARKED);
 }
 
 #if NATRON_ENABLE_TRIMAP
@@ -586,34 +800,103 @@ Bitmap::markForRendering(const RectI & roi)
 void
 Bitmap::swap(Bitmap& other)
 {
-    _map.swap(other._map);
-    _bounds = other._bounds;
+    std::swap(_bounds, other._bounds);
+    std::swap(_blocksPerRow, other._blocksPerRow);
+    std::swap(_blocksPerColumn, other._blocksPerColumn);
+    _blockStates.swap(other._blockStates);
+    _blockSlots.swap(other._blockSlots);
+    _blockRows.swap(other._blockRows);
+    _freeSlots.swap(other._freeSlots);
     _dirtyZone.clear(); //merge(other._dirtyZone);
     _dirtyZoneSet = false;
 }
 
-const char*
-Bitmap::getBitmapAt(int x,
-                    int y) const
+char
+Bitmap::getPixel(int x,
+                 int y) const
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    assert( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) );
+    int block = ( (y - _bounds.y1) >> BM_BLOCK_SHIFT ) * _blocksPerRow + ( (x - _bounds.x1) >> BM_BLOCK_SHIFT );
+    unsigned char state = _blockStates[block];
+
+    if (state != BM_BLOCK_MIXED) {
+        return (char)state;
     }
+    U64 row = _blockRows[_blockSlots[block] * BM_BLOCK_SIZE + ( (y - _bounds.y1) & BM_BLOCK_MASK )];
+
+    return (char)( ( row >> ( 2 * ( (x - _bounds.x1) & BM_BLOCK_MASK ) ) ) & 3 );
 }
 
-char*
-Bitmap::getBitmapAt(int x,
-                    int y)
+void
+Bitmap::getRow(int x1,
+               int x2,
+               int y,
+               char* values) const
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    assert(x1 >= _bounds.x1 && x2 <= _bounds.x2 && y >= _bounds.y1 && y < _bounds.y2);
+    if (x1 >= x2) {
+        return;
+    }
+    int by = (y - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int r = (y - _bounds.y1) & BM_BLOCK_MASK;
+    int bx1 = (x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int bx = bx1; bx < bx2; ++bx) {
+        int block = by * _blocksPerRow + bx;
+        int c1 = (bx == bx1) ? ( (x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+        int c2 = (bx == bx2 - 1) ? ( ( (x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        unsigned char state = _blockStates[block];
+        if (state != BM_BLOCK_MIXED) {
+            std::memset(values, state, c2 - c1);
+        } else {
+            U64 row = _blockRows[_blockSlots[block] * BM_BLOCK_SIZE + r];
+            for (int c = c1; c < c2; ++c) {
+                values[c - c1] = (char)( ( row >> (2 * c) ) & 3 );
+            }
+        }
+        values += c2 - c1;
     }
 }
 
+void
+Bitmap::setRow(int x1,
+               int x2,
+               int y,
+               const char* values)
+{
+    assert(x1 >= _bounds.x1 && x2 <= _bounds.x2 && y >= _bounds.y1 && y < _bounds.y2);
+    if (x1 >= x2) {
+        return;
+    }
+    int by = (y - _bounds.y1) >> BM_BLOCK_SHIFT;
+    int r = (y - _bounds.y1) & BM_BLOCK_MASK;
+    int bx1 = (x1 - _bounds.x1) >> BM_BLOCK_SHIFT;
+    int bx2 = ( (x2 - 1 - _bounds.x1) >> BM_BLOCK_SHIFT ) + 1;
+
+    for (int bx = bx1; bx < bx2; ++bx) {
+        int block = by * _blocksPerRow + bx;
+        int c1 = (bx == bx1) ? ( (x1 - _bounds.x1) & BM_BLOCK_MASK ) : 0;
+        int c2 = (bx == bx2 - 1) ? ( ( (x2 - 1 - _bounds.x1) & BM_BLOCK_MASK ) + 1 ) : BM_BLOCK_SIZE;
+        U64 row = 0;
+        bool sameAsBlock = true;
+        for (int c = c1; c < c2; ++c) {
+            assert(values[c - c1] >= 0 && values[c - c1] <= PIXEL_UNAVAILABLE);
+            row |= (U64)values[c - c1] << (2 * c);
+            sameAsBlock &= ( (unsigned char)values[c - c1] == _blockStates[block] );
+        }
+        values += c2 - c1;
+        if (sameAsBlock) {
+            continue;
+        }
+        setBlockMixed(block);
+        U64 columns = bmRowColumnsMask(c1, c2);
+        U64& blockRow = _blockRows[_blockSlots[block] * BM_BLOCK_SIZE + r];
+        blockRow = (blockRow & ~columns) | row;
+        compressBlock(block, bx, by);
+    }
+} // Bitmap::setRow
+
 #ifdef DEBUG
 void
 Image::printUnrenderedPixels(const RectI& roi) const
@@ -622,9 +905,6 @@ Image::printUnrenderedPixels(const RectI& roi) const
         return;
     }
     QReadLocker k(&_entryLock);
-    const char* bm = _bitmap.getBitmapAt(roi.x1, roi.y1);
-    int roiw = roi.x2 - roi.x1;
-    int boundsW = _bitmap.getBounds().width();
     RectD bboxUnrendered;
     bboxUnrendered.setupInfinity();
     RectD bboxUnavailable;
@@ -633,10 +913,10 @@ Image::printUnrenderedPixels(const RectI& roi) const
     bool hasUnrendered = false;
     bool hasUnavailable = false;
 
-    for ( int y = roi.y1; y < roi.y2; ++y,
-          bm += (boundsW - roiw) ) {
-        for (int x = roi.x1; x < roi.x2; ++x, ++bm) {
-            if (*bm == 0) {
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            char bm = _bitmap.getPixel(x, y);
+            if (bm == 0) {
                 if (x < bboxUnrendered.x1) {
                     bboxUnrendered.x1 = x;
                 }
@@ -650,7 +930,7 @@ Image::printUnrenderedPixels(const RectI& roi) const
                     bboxUnrendered.y2 = y;
                 }
                 hasUnrendered = true;
-            } else if (*bm == PIXEL_UNAVAILABLE) {
+            } else if (bm == PIXEL_UNAVAILABLE) {
                 if (x < bboxUnavailable.x1) {
                     bboxUnavailable.x1 = x;
                 }
@@ -905,6 +1185,139 @@ Image::makeParams(const RectD & rod,    // the image rod in canonical coordinate
 #endif
 }
 
+namespace {
+// Below this number of pixels per band, processRectInBands() processes the rectangle in the calling thread
+#define NATRON_IMAGE_MIN_PIXELS_PER_BAND 65536
+
+// The bands of a rectangle processed by Image::processRectInBands(), executed in parallel by the TaskScheduler
+class ImageRectBands
+    : public ParallelTasks
+{
+public:
+    ImageRectBands(const RectI & rect,
+                   int nBands,
+                   const ImageRectProcessor & processor)
+        : ParallelTasks()
+        , _rect(rect)
+        , _nBands(nBands)
+        , _processor(processor)
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        const int height = _rect.height();
+        RectI band( _rect.x1, _rect.y1 + (int)( (U64)height * taskIndex / _nBands ),
+                    _rect.x2, _rect.y1 + (int)( (U64)height * (taskIndex + 1) / _nBands ) );
+
+        _processor.process(band);
+    }
+
+private:
+    RectI _rect;
+    int _nBands;
+    const ImageRectProcessor & _processor;
+};
+
+// Copies the pixels of a rectangle between images with the same pixel size
+class PasteRectProcessor
+    : public ImageRectProcessor
+{
+public:
+    PasteRectProcessor(const unsigned char* srcPixels,
+                       const RectI & srcBounds,
+                       unsigned char* dstPixels,
+                       const RectI & dstBounds,
+                       std::size_t pixelSize)
+        : ImageRectProcessor()
+        , _srcPixels(srcPixels)
+        , _srcBounds(srcBounds)
+        , _dstPixels(dstPixels)
+        , _dstBounds(dstBounds)
+        , _pixelSize(pixelSize)
+    {
+    }
+
+    virtual void process(const RectI & rect) const OVERRIDE FINAL
+    {
+        const std::size_t srcRowSize = _srcBounds.width() * _pixelSize;
+        const std::size_t dstRowSize = _dstBounds.width() * _pixelSize;
+        const unsigned char* src = _srcPixels + (rect.y1 - _srcBounds.y1) * srcRowSize + (rect.x1 - _srcBounds.x1) * _pixelSize;
+        unsigned char* dst = _dstPixels + (rect.y1 - _dstBounds.y1) * dstRowSize + (rect.x1 - _dstBounds.x1) * _pixelSize;
+
+        for (int y = rect.y1; y < rect.y2; ++y, src += srcRowSize, dst += dstRowSize) {
+            std::memcpy(dst, src, rect.width() * _pixelSize);
+        }
+    }
+
+private:
+    const unsigned char* _srcPixels; // the pixel at the bottom-left corner of srcBounds
+    RectI _srcBounds;
+    unsigned char* _dstPixels; // the pixel at the bottom-left corner of dstBounds
+    RectI _dstBounds;
+    std::size_t _pixelSize;
+};
+
+// Fills a rectangle with a color: the first row of the rectangle is filled, the others are copies of it
+template <typename PIX, int nComps>
+class FillRectProcessor
+    : public ImageRectProcessor
+{
+public:
+    FillRectProcessor(PIX* pixels,
+                      const RectI & bounds,
+                      const float fillValue[4])
+        : ImageRectProcessor()
+        , _pixels(pixels)
+        , _bounds(bounds)
+    {
+        std::copy(fillValue, fillValue + 4, _fillValue);
+    }
+
+    virtual void process(const RectI & rect) const OVERRIDE FINAL
+    {
+        const std::size_t rowElements = (std::size_t)_bounds.width() * nComps;
+        PIX* firstRow = _pixels + (rect.y1 - _bounds.y1) * rowElements + (rect.x1 - _bounds.x1) * nComps;
+        PIX* dst = firstRow;
+
+        for (int x = rect.x1; x < rect.x2; ++x, dst += nComps) {
+            for (int k = 0; k < nComps; ++k) {
+                dst[k] = _fillValue[k];
+            }
+        }
+        dst = firstRow + rowElements;
+        for (int y = rect.y1 + 1; y < rect.y2; ++y, dst += rowElements) {
+            std::memcpy( dst, firstRow, rect.width() * nComps * sizeof(PIX) );
+        }
+    }
+
+private:
+    PIX* _pixels; // the pixel at the bottom-left corner of bounds
+    RectI _bounds;
+    float _fillValue[4];
+};
+} // anon namespace
+
+void
+Image::processRectInBands(const RectI & rect,
+                          const ImageRectProcessor & processor)
+{
+    if ( rect.isNull() ) {
+        return;
+    }
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : 0;
+    int nBands = scheduler ? scheduler->getWorkersCount() + 1 : 1;
+    nBands = (int)std::min<U64>( nBands, rect.area() / NATRON_IMAGE_MIN_PIXELS_PER_BAND );
+    nBands = std::min( nBands, rect.height() );
+    if (nBands <= 1) {
+        processor.process(rect);
+
+        return;
+    }
+    ImageRectBands bands(rect, nBands, processor);
+    scheduler->run(&bands, nBands);
+}
+
 // code proofread and fixed by @devernay on 8/8/2014
 template<typename PIX>
 void
@@ -951,19 +1364,12 @@ Image::pasteFromForDepth(const Image & srcImg,
     }
     // now we're safe: both images contain the area in roi
 
-    int srcRowElements = _nbComponents * srcBounds.width();
-    int dstRowElements = _nbComponents * bounds.width();
-    const PIX* src = (const PIX*)srcImg.pixelAt(roi.x1, roi.y1);
-    PIX* dst = (PIX*)pixelAt(roi.x1, roi.y1);
+    const unsigned char* src = srcImg.pixelAt(srcBounds.x1, srcBounds.y1);
+    unsigned char* dst = pixelAt(bounds.x1, bounds.y1);
 
     assert(src && dst);
 
-    for (int y = roi.y1; y < roi.y2;
-         ++y,
-         src += srcRowElements,
-         dst += dstRowElements) {
-        std::memcpy(dst, src, roi.width() * sizeof(PIX) * _nbComponents);
-    }
+    processRectInBands( roi, PasteRectProcessor(src, srcBounds, dst, bounds, sizeof(PIX) * _nbComponents) );
 } // Image::pasteFromForDepth
 
 void
@@ -1050,9 +1456,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = wacc.bitmapAt(aRect.x1, aRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(aRect);
             }
         }
         if ( !cRect.isNull() ) {
@@ -1062,9 +1466,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = (char*)wacc.bitmapAt(cRect.x1, cRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(cRect);
             }
         }
         if ( !bRect.isNull() ) {
@@ -1074,13 +1476,11 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t rowsize = mw * pixelSize;
             int bw = bRect.width();
             std::size_t rectRowSize = bw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(bRect.x1, bRect.y1) : 0;
             for (int y = bRect.y1; y < bRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, bw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(bRect);
             }
         }
         if ( !dRect.isNull() ) {
@@ -1090,13 +1490,11 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t rowsize = mw * pixelSize;
             int dw = dRect.width();
             std::size_t rectRowSize = dw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(dRect.x1, dRect.y1) : 0;
             for (int y = dRect.y1; y < dRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, dw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(dRect);
             }
         }
     } // fillWithBlackAndTransparent
@@ -1419,21 +1817,14 @@ Image::fillForDepthForComponents(const RectI & roi_,
         return;
     }
 
-    int rowElems = (int)getComponentsCount() * _bounds.width();
+    assert( (int)getComponentsCount() == nComps );
     const float fillValue[4] = {
         nComps == 1 ? a * maxValue : r * maxValue, g * maxValue, b * maxValue, a * maxValue
     };
 
 
     // now we're safe: the image contains the area in roi
-    PIX* dst = (PIX*)pixelAt(roi.x1, roi.y1);
-    for ( int i = 0; i < roi.height(); ++i, dst += (rowElems - roi.width() * nComps) ) {
-        for (int j = 0; j < roi.width(); ++j, dst += nComps) {
-            for (int k = 0; k < nComps; ++k) {
-                dst[k] = fillValue[k];
-            }
-        }
-    }
+    processRectInBands( roi, FillRectProcessor<PIX, nComps>( (PIX*)pixelAt(_bounds.x1, _bounds.y1), _bounds, fillValue ) );
 }
 
 // code proofread and fixed by @devernay on 8/8/2014
@@ -1807,264 +2198,268 @@ Image::getRowElements() const
     return getComponentsCount() * _bounds.width();
 }
 
-// code proofread and fixed by @devernay on 4/12/2014
-template <typename PIX, int maxValue>
-void
-Image::halveRoIForDepth(const RectI & roi,
-                        bool copyBitMap,
-                        Image* output) const
-{
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
-            (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
-            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+namespace {
+// Below this number of source pixels per task, the mipmap is computed in the calling thread
+#define NATRON_MIPMAP_MIN_PIXELS_PER_TASK 65536
 
-    ///handle case where there is only 1 column/row
-    if ( (roi.width() == 1) || (roi.height() == 1) ) {
-        assert( !(roi.width() == 1 && roi.height() == 1) ); /// can't be 1x1
-        halve1DImage(roi, output);
+/*
+ * Computes the rows of a mipmap level directly from the rows of this image, without intermediate
+ * images: each intermediate level only keeps its last two rows, which are computed when the next
+ * level needs them. The source rows are thus read once, and the intermediate rows stay in the CPU cache.
+ *
+ * The RoI of each level is the smallest enclosing RoI of the previous one. A pixel is the average
+ * of the pixels of the previous level it covers that are inside its RoI, so that the edges of the RoI
+ * are defined even if they are not aligned on the level. A pixel is marked as rendered in the bitmap
+ * only if the 4 pixels it covers are rendered: a pixel at an edge is only an approximation.
+ */
+template <typename PIX>
+class MipMapRowsBuilder
+{
+public:
+
+    /**
+     * @brief srcPixels is the pixel (roi.x1, roi.y1) of the source image and srcBitmap its bitmap,
+     * or NULL if the bitmap is not built.
+     **/
+    MipMapRowsBuilder(const PIX* srcPixels,
+                      std::size_t srcRowElements,
+                      const Bitmap* srcBitmap,
+                      int nComps,
+                      const RectI & roi,
+                      unsigned int level)
+        : _srcPixels(srcPixels)
+        , _srcRowElements(srcRowElements)
+        , _srcBitmap(srcBitmap)
+        , _nComps(nComps)
+        , _levels(level + 1)
+    {
+        assert(level > 0);
+        for (unsigned int i = 0; i <= level; ++i) {
+            Level & l = _levels[i];
+            l.roi = (i == 0) ? roi : _levels[i - 1].roi.downscalePowerOfTwoSmallestEnclosing(1);
+            l.rows[0] = l.rows[1] = INT_MIN;
+            if (i == level) {
+                // the rows of the last level are written by the caller
+                continue;
+            }
+            if (i > 0) {
+                l.pixels.resize(2 * l.roi.width() * nComps);
+            }
+            if (srcBitmap) {
+                l.bitmap.resize( 2 * l.roi.width() );
+            }
+        }
+    }
 
-        return;
+    /**
+     * @brief Computes the pixels [roi.x1, roi.x2) of the row y of the last level, where roi is
+     * the RoI of the last level, and their bitmap if the bitmap is built.
+     * The rows must be computed in increasing order.
+     **/
+    void computeRow(int y,
+                    PIX* dst,
+                    char* dstBitmap)
+    {
+        computeRow(_levels.size() - 1, y, dst, dstBitmap);
     }
 
-    /// Take the lock for both bitmaps since we're about to read/write from them!
-    QWriteLocker k1(&output->_entryLock);
-    QReadLocker k2(&_entryLock);
+private:
 
-    ///The source rectangle, intersected to this image region of definition in pixels
-    const RectI &srcBounds = _bounds;
-    const RectI &dstBounds = output->_bounds;
-    const RectI &srcBmBounds = _bitmap.getBounds();
-    const RectI &dstBmBounds = output->_bitmap.getBounds();
-    assert( !copyBitMap || usesBitMap() );
-    assert( !usesBitMap() || (srcBmBounds == srcBounds && dstBmBounds == dstBounds) );
-
-    // the srcRoD of the output should be enclosed in half the roi.
-    // It does not have to be exactly half of the input.
-    //    assert(dstRoD.x1*2 >= roi.x1 &&
-    //           dstRoD.x2*2 <= roi.x2 &&
-    //           dstRoD.y1*2 >= roi.y1 &&
-    //           dstRoD.y2*2 <= roi.y2 &&
-    //           dstRoD.width()*2 <= roi.width() &&
-    //           dstRoD.height()*2 <= roi.height());
-    assert( getComponents() == output->getComponents() );
-
-    RectI dstRoI;
-    RectI srcRoI = roi;
-    srcRoI.intersect(srcBounds, &srcRoI); // intersect srcRoI with the region of definition
-
-    dstRoI.x1 = (srcRoI.x1 + 1) / 2; // equivalent to ceil(srcRoI.x1/2.0)
-    dstRoI.y1 = (srcRoI.y1 + 1) / 2; // equivalent to ceil(srcRoI.y1/2.0)
-    dstRoI.x2 = srcRoI.x2 / 2; // equivalent to floor(srcRoI.x2/2.0)
-    dstRoI.y2 = srcRoI.y2 / 2; // equivalent to floor(srcRoI.y2/2.0)
-
-
-    const PIX* const srcPixels      = (const PIX*)pixelAt(srcBounds.x1,   srcBounds.y1);
-    const char* const srcBmPixels   = _bitmap.getBitmapAt(srcBmBounds.x1, srcBmBounds.y1);
-    PIX* const dstPixels          = (PIX*)output->pixelAt(dstBounds.x1,   dstBounds.y1);
-    char* const dstBmPixels = output->_bitmap.getBitmapAt(dstBmBounds.x1, dstBmBounds.y1);
-    int srcRowSize = srcBounds.width() * _nbComponents;
-    int dstRowSize = dstBounds.width() * _nbComponents;
-
-    // offset pointers so that srcData and dstData correspond to pixel (0,0)
-    const PIX* const srcData = srcPixels - (srcBounds.x1 * _nbComponents + srcRowSize * srcBounds.y1);
-    PIX* const dstData       = dstPixels - (dstBounds.x1 * _nbComponents + dstRowSize * dstBounds.y1);
-    const int srcBmRowSize = srcBmBounds.width();
-    const int dstBmRowSize = dstBmBounds.width();
-    const char* const srcBmData = srcBmPixels - (srcBmBounds.x1 + srcBmRowSize * srcBmBounds.y1);
-    char* const dstBmData       = dstBmPixels - (dstBmBounds.x1 + dstBmRowSize * dstBmBounds.y1);
-
-    for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
-        const PIX* const srcLineStart    = srcData + y * 2 * srcRowSize;
-        PIX* const dstLineStart          = dstData + y     * dstRowSize;
-        const char* const srcBmLineStart = srcBmData + y * 2 * srcBmRowSize;
-        char* const dstBmLineStart       = dstBmData + y     * dstBmRowSize;
-
-        // The current dst row, at y, covers the src rows y*2 (thisRow) and y*2+1 (nextRow).
-        // Check that if are within srcBounds.
-        int srcy = y * 2;
-        bool pickThisRow = srcBounds.y1 <= (srcy + 0) && (srcy + 0) < srcBounds.y2;
-        bool pickNextRow = srcBounds.y1 <= (srcy + 1) && (srcy + 1) < srcBounds.y2;
-        int sumH = (int)pickNextRow + (int)pickThisRow;
-        assert(sumH == 1 || sumH == 2);
-
-        for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
-            const PIX* const srcPixStart    = srcLineStart   + x * 2 * _nbComponents;
-            const char* const srcBmPixStart = srcBmLineStart + x * 2;
-            PIX* const dstPixStart          = dstLineStart   + x * _nbComponents;
-            char* const dstBmPixStart       = dstBmLineStart + x;
-
-            // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
-            // Check that if are within srcBounds.
-            int srcx = x * 2;
-            bool pickThisCol = srcBounds.x1 <= (srcx + 0) && (srcx + 0) < srcBounds.x2;
-            bool pickNextCol = srcBounds.x1 <= (srcx + 1) && (srcx + 1) < srcBounds.x2;
-            int sumW = (int)pickThisCol + (int)pickNextCol;
-            assert(sumW == 1 || sumW == 2);
-            const int sum = sumW * sumH;
-            assert(0 < sum && sum <= 4);
+    struct Level
+    {
+        RectI roi;
+        std::vector<PIX> pixels; // the rows of roi with an even y, then with an odd y
+        std::vector<char> bitmap;
+        int rows[2]; // the y of the rows in pixels and bitmap
+    };
 
-            if (sum == 0) { // never happens
-                for (int k = 0; k < _nbComponents; ++k) {
-                    dstPixStart[k] = 0;
+    void getRow(unsigned int level,
+                int y,
+                const PIX** pixels,
+                const char** bitmap)
+    {
+        Level & l = _levels[level];
+        const int slot = y & 1;
+        const int width = l.roi.width();
+
+        if (l.rows[slot] != y) {
+            if (level > 0) {
+                computeRow(level, y, &l.pixels[slot * width * _nComps], _srcBitmap ? &l.bitmap[slot * width] : 0);
+            } else if (_srcBitmap) {
+                char* bm = &l.bitmap[slot * width];
+                _srcBitmap->getRow(l.roi.x1, l.roi.x2, y, bm);
+                for (int x = 0; x < width; ++x) {
+                    /*
+                       The only correct solution is to convert pixels being rendered to 0 otherwise the caller
+                       would have to wait for the original fullscale image render to be finished and then re-downscale again.
+                     */
+                    bm[x] = (bm[x] == 1) ? 1 : 0;
                 }
-                if (copyBitMap) {
-                    dstBmPixStart[0] = 0;
+            }
+            l.rows[slot] = y;
+        }
+        if (level > 0) {
+            *pixels = &l.pixels[slot * width * _nComps];
+        } else {
+            *pixels = _srcPixels + (std::size_t)(y - l.roi.y1) * _srcRowElements;
+        }
+        *bitmap = _srcBitmap ? &l.bitmap[slot * width] : 0;
+    }
+
+    // Computes the pixels of the row y of the level from the rows 2y and 2y+1 of the previous level
+    void computeRow(unsigned int level,
+                    int y,
+                    PIX* dst,
+                    char* dstBitmap)
+    {
+        const RectI & srcRoI = _levels[level - 1].roi;
+        const RectI & dstRoI = _levels[level].roi;
+        const int srcy = y * 2;
+        const PIX* thisRow = 0;
+        const PIX* nextRow = 0;
+        const char* thisBmRow = 0;
+        const char* nextBmRow = 0;
+
+        if ( (srcRoI.y1 <= srcy) && (srcy < srcRoI.y2) ) {
+            getRow(level - 1, srcy, &thisRow, &thisBmRow);
+        }
+        if ( (srcRoI.y1 <= srcy + 1) && (srcy + 1 < srcRoI.y2) ) {
+            getRow(level - 1, srcy + 1, &nextRow, &nextBmRow);
+        }
+        assert(thisRow || nextRow);
+
+        // The pixels in [x1,x2) cover 2 columns of srcRoI. If both rows are in srcRoI, they are computed by the
+        // vectorized kernel and the remaining pixels at the edges of dstRoI are computed below.
+        int x1 = (srcRoI.x1 + 1) >> 1; // ceil(srcRoI.x1/2.0)
+        int x2 = srcRoI.x2 >> 1; // floor(srcRoI.x2/2.0)
+        if ( thisRow && nextRow && (x1 < x2) ) {
+            MipMapKernels::halveRows(thisRow + (2 * x1 - srcRoI.x1) * _nComps, nextRow + (2 * x1 - srcRoI.x1) * _nComps,
+                                     _nComps, x2 - x1, dst + (x1 - dstRoI.x1) * _nComps);
+        } else {
+            x1 = x2 = dstRoI.x2;
+        }
+        halveEdgePixels(srcRoI, dstRoI, dstRoI.x1, x1, thisRow, nextRow, dst);
+        halveEdgePixels(srcRoI, dstRoI, x2, dstRoI.x2, thisRow, nextRow, dst);
+
+        if (dstBitmap) {
+            for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
+                const int srcx = x * 2;
+                char value = 0;
+                if ( thisBmRow && nextBmRow && (srcRoI.x1 <= srcx) && (srcx + 1 < srcRoI.x2) ) {
+                    ///a b
+                    ///c d
+                    const int i = srcx - srcRoI.x1;
+                    value = thisBmRow[i] & thisBmRow[i + 1] & nextBmRow[i] & nextBmRow[i + 1];
                 }
-                continue;
+                dstBitmap[x - dstRoI.x1] = value;
             }
+        }
+    }
 
-            for (int k = 0; k < _nbComponents; ++k) {
-                ///a b
-                ///c d
-
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixStart + k) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixStart + k + _nbComponents) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize) : 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + _nbComponents)  : 0;
-
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                dstPixStart[k] = (a + b + c + d) / sum;
-            }
+    // Computes the pixels in [x1,x2) of the row from the pixels of the previous level that are in srcRoI
+    void halveEdgePixels(const RectI & srcRoI,
+                         const RectI & dstRoI,
+                         int x1,
+                         int x2,
+                         const PIX* thisRow,
+                         const PIX* nextRow,
+                         PIX* dst) const
+    {
+        const int sumH = (int)(thisRow != 0) + (int)(nextRow != 0);
+
+        for (int x = x1; x < x2; ++x) {
+            // The current dst col covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
+            // Check that they are within srcRoI.
+            const int srcx = x * 2;
+            const bool pickThisCol = srcRoI.x1 <= (srcx + 0) && (srcx + 0) < srcRoI.x2;
+            const bool pickNextCol = srcRoI.x1 <= (srcx + 1) && (srcx + 1) < srcRoI.x2;
+            const int sumW = (int)pickThisCol + (int)pickNextCol;
+            const int sum = sumW * sumH;
+            assert(0 < sum && sum <= 4);
+            const int thisOffset = (srcx - srcRoI.x1) * _nComps;
+            const int nextOffset = thisOffset + _nComps;
+            PIX* dstPix = dst + (x - dstRoI.x1) * _nComps;
 
-            if (copyBitMap) {
+            for (int k = 0; k < _nComps; ++k) {
                 ///a b
                 ///c d
-
-                char a = (pickThisCol && pickThisRow) ? *(srcBmPixStart) : 0;
-                char b = (pickNextCol && pickThisRow) ? *(srcBmPixStart + 1) : 0;
-                char c = (pickThisCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize) : 0;
-                char d = (pickNextCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize  + 1)  : 0;
-#if NATRON_ENABLE_TRIMAP
-                /*
-                   The only correct solution is to convert pixels being rendered to 0 otherwise the caller
-                   would have to wait for the original fullscale image render to be finished and then re-downscale again.
-                 */
-                if (a == PIXEL_UNAVAILABLE) {
-                    a = 0;
-                }
-                if (b == PIXEL_UNAVAILABLE) {
-                    b = 0;
-                }
-                if (c == PIXEL_UNAVAILABLE) {
-                    c = 0;
-                }
-                if (d == PIXEL_UNAVAILABLE) {
-                    d = 0;
-                }
-#endif
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                assert(a + b + c + d <= sum); // bitmaps are 0 or 1
-                // the following is an integer division, the result can be 0 or 1
-                dstBmPixStart[0] = (a + b + c + d) / sum;
-                assert(dstBmPixStart[0] == 0 || dstBmPixStart[0] == 1);
+                const PIX a = (pickThisCol && thisRow) ? thisRow[thisOffset + k] : 0;
+                const PIX b = (pickNextCol && thisRow) ? thisRow[nextOffset + k] : 0;
+                const PIX c = (pickThisCol && nextRow) ? nextRow[thisOffset + k] : 0;
+                const PIX d = (pickNextCol && nextRow) ? nextRow[nextOffset + k] : 0;
+                dstPix[k] = PIX( (a + b + c + d) / sum );
             }
         }
     }
-} // halveRoIForDepth
 
-// code proofread and fixed by @devernay on 8/8/2014
-void
-Image::halveRoI(const RectI & roi,
-                bool copyBitMap,
-                Image* output) const
-{
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        halveRoIForDepth<unsigned char, 255>(roi, copyBitMap,  output);
-        break;
-    case eImageBitDepthShort:
-        halveRoIForDepth<unsigned short, 65535>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthFloat:
-        halveRoIForDepth<float, 1>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthNone:
-        break;
-    }
-}
-
-// code proofread and fixed by @devernay on 8/8/2014
-template <typename PIX, int maxValue>
-void
-Image::halve1DImageForDepth(const RectI & roi,
-                            Image* output) const
-{
-    int width = roi.width();
-    int height = roi.height();
-
-    assert(width == 1 || height == 1); /// must be 1D
-    assert( output->getComponents() == getComponents() );
-
-    /// Take the lock for both bitmaps since we're about to read/write from them!
-    QWriteLocker k1(&output->_entryLock);
-    QReadLocker k2(&_entryLock);
-    const RectI & srcBounds = _bounds;
-    const RectI & dstBounds = output->_bounds;
-//    assert(dstBounds.x1 * 2 == roi.x1 &&
-//           dstBounds.y1 * 2 == roi.y1 &&
-//           (
-//               dstBounds.x2 * 2 == roi.x2 || // we halve in only 1 dimension
-//               dstBounds.y2 * 2 == roi.y2)
-//           );
-    int halfWidth = width / 2;
-    int halfHeight = height / 2;
-    if (height == 1) { //1 row
-        assert(width != 1); /// widthxheight can't be 1x1
-
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int x = 0; x < halfWidth; ++x) {
-            for (int k = 0; k < _nbComponents; ++k) {
-                *dst++ = PIX( (float)( *src + *(src + _nbComponents) ) / 2. );
-                ++src;
-            }
-            src += _nbComponents;
-        }
-    } else if (width == 1) {
-        int rowSize = srcBounds.width() * _nbComponents;
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int y = 0; y < halfHeight; ++y) {
-            for (int k = 0; k < _nbComponents; ++k) {
-                *dst++ = PIX( (float)( *src + (*src + rowSize) ) / 2. );
-                ++src;
-            }
-            src += rowSize;
+    const PIX* _srcPixels;
+    std::size_t _srcRowElements;
+    const Bitmap* _srcBitmap;
+    int _nComps;
+    std::vector<Level> _levels;
+};
+
+// Computes bands of rows of a mipmap level, executed in parallel by the TaskScheduler.
+// The bitmap rows are stored in dstBitmap, because the bitmap of the output image cannot be written concurrently.
+template <typename PIX>
+class MipMapBandTasks
+    : public ParallelTasks
+{
+public:
+    MipMapBandTasks(const PIX* srcPixels,
+                    std::size_t srcRowElements,
+                    const Bitmap* srcBitmap,
+                    int nComps,
+                    const RectI & roi,
+                    unsigned int level,
+                    PIX* dstPixels,
+                    std::size_t dstRowElements,
+                    char* dstBitmap,
+                    int nTasks)
+        : ParallelTasks()
+        , _srcPixels(srcPixels)
+        , _srcRowElements(srcRowElements)
+        , _srcBitmap(srcBitmap)
+        , _nComps(nComps)
+        , _roi(roi)
+        , _level(level)
+        , _dstRoI( roi.downscalePowerOfTwoSmallestEnclosing(level) )
+        , _dstPixels(dstPixels)
+        , _dstRowElements(dstRowElements)
+        , _dstBitmap(dstBitmap)
+        , _nTasks(nTasks)
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        const int height = _dstRoI.height();
+        const int y1 = _dstRoI.y1 + (int)( (U64)height * taskIndex / _nTasks );
+        const int y2 = _dstRoI.y1 + (int)( (U64)height * (taskIndex + 1) / _nTasks );
+        MipMapRowsBuilder<PIX> builder(_srcPixels, _srcRowElements, _srcBitmap, _nComps, _roi, _level);
+
+        for (int y = y1; y < y2; ++y) {
+            builder.computeRow(y,
+                               _dstPixels + (std::size_t)(y - _dstRoI.y1) * _dstRowElements,
+                               _dstBitmap ? _dstBitmap + (std::size_t)(y - _dstRoI.y1) * _dstRoI.width() : 0);
         }
     }
-}
 
-// code proofread and fixed by @devernay on 8/8/2014
-void
-Image::halve1DImage(const RectI & roi,
-                    Image* output) const
-{
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        halve1DImageForDepth<unsigned char, 255>(roi, output);
-        break;
-    case eImageBitDepthShort:
-        halve1DImageForDepth<unsigned short, 65535>(roi, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthFloat:
-        halve1DImageForDepth<float, 1>(roi, output);
-        break;
-    case eImageBitDepthNone:
-        break;
-    }
-}
+private:
+    const PIX* _srcPixels;
+    std::size_t _srcRowElements;
+    const Bitmap* _srcBitmap;
+    int _nComps;
+    RectI _roi;
+    unsigned int _level;
+    RectI _dstRoI;
+    PIX* _dstPixels;
+    std::size_t _dstRowElements;
+    char* _dstBitmap;
+    int _nTasks;
+};
+} // anon namespace
 
-// code proofread and fixed by @devernay on 8/8/2014
 void
 Image::downscaleMipMap(const RectD& dstRod,
                        const RectI & roi,
@@ -2074,34 +2469,22 @@ Image::downscaleMipMap(const RectD& dstRod,
                        Image* output) const
 {
     assert(getStorageMode() != eStorageModeGLTex);
+    Q_UNUSED(dstRod);
 
     ///You should not call this function with a level equal to 0.
     assert(toLevel >  fromLevel);
 
     assert(_bounds.x1 <= roi.x1 && roi.x2 <= _bounds.x2 &&
            _bounds.y1 <= roi.y1 && roi.y2 <= _bounds.y2);
-    double par = getPixelAspectRatio();
-//    RectD roiCanonical;
-//    roi.toCanonical(fromLevel, par , dstRod, &roiCanonical);
-//    RectI dstRoI;
-//    roiCanonical.toPixelEnclosing(toLevel, par , &dstRoI);
     unsigned int downscaleLvls = toLevel - fromLevel;
 
-    assert( !copyBitMap || _bitmap.getBitmap() );
-
-    RectI dstRoI  = roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls);
-    ImagePtr tmpImg = boost::make_shared<Image>( getComponents(), dstRod, dstRoI, toLevel, par, getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-    buildMipMapLevel( dstRod, roi, downscaleLvls, copyBitMap, tmpImg.get() );
+    assert( !copyBitMap || usesBitMap() );
 
     // check that the downscaled mipmap is inside the output image (it may not be equal to it)
-    assert(dstRoI.x1 >= output->_bounds.x1);
-    assert(dstRoI.x2 <= output->_bounds.x2);
-    assert(dstRoI.y1 >= output->_bounds.y1);
-    assert(dstRoI.y2 <= output->_bounds.y2);
+    assert( output->_bounds.contains( roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls) ) );
 
-    ///Now copy the result of tmpImg into the output image
-    output->pasteFrom(*tmpImg, dstRoI, copyBitMap);
+    ///The mipmap is computed directly into the output image
+    buildMipMapLevel(roi, downscaleLvls, copyBitMap, output);
 }
 
 bool
@@ -2242,10 +2625,52 @@ Image::upscaleMipMap(const RectI & roi,
     }
 }
 
-// code proofread and fixed by @devernay on 8/8/2014
+template <typename PIX>
+void
+Image::buildMipMapLevelForDepth(const RectI & roi,
+                                unsigned int level,
+                                bool copyBitMap,
+                                Image* output) const
+{
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
+            (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
+            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( !copyBitMap || usesBitMap() );
+
+    const RectI dstRoI = roi.downscalePowerOfTwoSmallestEnclosing(level);
+    const PIX* srcPixels = (const PIX*)pixelAt(roi.x1, roi.y1);
+    PIX* dstPixels = (PIX*)output->pixelAt(dstRoI.x1, dstRoI.y1);
+    assert(srcPixels && dstPixels);
+
+    // The bitmap rows of all the tasks, set in the output bitmap once they are done
+    std::vector<char> dstBitmap;
+    if (copyBitMap) {
+        dstBitmap.resize( dstRoI.area() );
+    }
+
+    // Split the rows of the last level in bands if the source is large enough
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : 0;
+    int nTasks = scheduler ? scheduler->getWorkersCount() + 1 : 1;
+    nTasks = (int)std::min<U64>( nTasks, roi.area() / NATRON_MIPMAP_MIN_PIXELS_PER_TASK );
+    nTasks = std::max( 1, std::min( nTasks, dstRoI.height() ) );
+
+    MipMapBandTasks<PIX> tasks(srcPixels, getRowElements(), copyBitMap ? &_bitmap : 0, _nbComponents, roi, level,
+                               dstPixels, output->getRowElements(), copyBitMap ? &dstBitmap[0] : 0, nTasks);
+    if (nTasks == 1) {
+        tasks.runTask(0);
+    } else {
+        scheduler->run(&tasks, nTasks);
+    }
+
+    if (copyBitMap) {
+        for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
+            output->_bitmap.setRow( dstRoI.x1, dstRoI.x2, y, &dstBitmap[(std::size_t)(y - dstRoI.y1) * dstRoI.width()] );
+        }
+    }
+} // buildMipMapLevelForDepth
+
 void
-Image::buildMipMapLevel(const RectD& dstRoD,
-                        const RectI & roi,
+Image::buildMipMapLevel(const RectI & roi,
                         unsigned int level,
                         bool copyBitMap,
                         Image* output) const
@@ -2257,6 +2682,7 @@ Image::buildMipMapLevel(const RectD& dstRoD,
     assert( output->getBounds().contains(lastLevelRoI) );
 
     assert( output->getComponents() == getComponents() );
+    assert( output->getBitDepth() == getBitDepth() );
 
     if (level == 0) {
         ///Just copy the roi and return
@@ -2265,42 +2691,29 @@ Image::buildMipMapLevel(const RectD& dstRoD,
         return;
     }
 
-    const Image* srcImg = this;
-    Image* dstImg = NULL;
-    bool mustFreeSrc = false;
-    RectI previousRoI = roi;
-    ///Build all the mipmap levels until we reach the one we are interested in
-    for (unsigned int i = 1; i <= level; ++i) {
-        ///Halve the smallest enclosing po2 rect as we need to render a minimum of the renderWindow
-        RectI halvedRoI = previousRoI.downscalePowerOfTwoSmallestEnclosing(1);
-
-        ///Allocate an image with half the size of the source image
-        dstImg = new Image( getComponents(), dstRoD, halvedRoI, getMipMapLevel() + i, getPixelAspectRatio(), getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-        ///Half the source image into dstImg.
-        ///We pass the closestPo2 roi which might not be the entire size of the source image
-        ///If the source image'sroi was originally a po2.
-        srcImg->halveRoI(previousRoI, copyBitMap, dstImg);
-
-        ///Clean-up, we should use shared_ptrs for safety
-        if (mustFreeSrc) {
-            delete srcImg;
-        }
-
-        ///Switch for next pass
-        previousRoI = halvedRoI;
-        srcImg = dstImg;
-        mustFreeSrc = true;
+    if ( roi.isNull() ) {
+        return;
     }
 
-    assert(srcImg->getBounds() == lastLevelRoI);
-
-    ///Finally copy the last mipmap level into output.
-    output->pasteFrom( *srcImg, srcImg->getBounds(), copyBitMap);
+    /// Take the lock for both bitmaps since we're about to read/write from them!
+    QWriteLocker k1(&output->_entryLock);
+    QReadLocker k2(&_entryLock);
 
-    ///Clean-up, we should use shared_ptrs for safety
-    if (mustFreeSrc) {
-        delete srcImg;
+    switch ( getBitDepth() ) {
+    case eImageBitDepthByte:
+        buildMipMapLevelForDepth<unsigned char>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthShort:
+        buildMipMapLevelForDepth<unsigned short>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthHalf:
+        assert(false);
+        break;
+    case eImageBitDepthFloat:
+        buildMipMapLevelForDepth<float>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthNone:
+        break;
     }
 } // buildMipMapLevel
 
@@ -2338,15 +2751,12 @@ Bitmap::copyRowPortion(int x1,
                        int y,
                        const Bitmap& other)
 {
-    const char* srcBitmap = other.getBitmapAt(x1, y);
-    char* dstBitmap = getBitmapAt(x1, y);
-    const char* end = dstBitmap + (x2 - x1);
-
-    while (dstBitmap < end) {
-        *dstBitmap = /**srcBitmap == PIXEL_UNAVAILABLE ? 0 : */ *srcBitmap;
-        ++dstBitmap;
-        ++srcBitmap;
+    if (x1 >= x2) {
+        return;
     }
+    std::vector<char> row(x2 - x1);
+    other.getRow(x1, x2, y, &row[0]);
+    setRow(x1, x2, y, &row[0]);
 }
 
 void
@@ -2363,22 +2773,13 @@ Bitmap::copyBitmapPortion(const RectI& roi,
     assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
     assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
 
-    int srcRowSize = other._bounds.width();
-    int dstRowSize = _bounds.width();
-    const char* srcBitmap = other.getBitmapAt(roi.x1, roi.y1);
-    char* dstBitmap = getBitmapAt(roi.x1, roi.y1);
-
-    for (int y = roi.y1; y < roi.y2; ++y,
-         srcBitmap += srcRowSize,
-         dstBitmap += dstRowSize) {
-        const char* srcCur = srcBitmap;
-        const char* srcEnd = srcBitmap + roi.width();
-        char* dstCur = dstBitmap;
-        while (srcCur < srcEnd) {
-            *dstCur = /**srcCur == PIXEL_UNAVAILABLE ? 0 : */ *srcCur;
-            ++srcCur;
-            ++dstCur;
-        }
+    if ( roi.isNull() ) {
+        return;
+    }
+    std::vector<char> row( roi.width() );
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        other.getRow(roi.x1, roi.x2, y, &row[0]);
+        setRow(roi.x1, roi.x2, y, &row[0]);
     }
 }
 
@@ -63,12 +63,26 @@ public:
     }
 };
 
+/**
+ * @brief The render state of each pixel of an image: 0 if not rendered, 1 if rendered and
+ * 2 if being rendered by another thread (only with NATRON_ENABLE_TRIMAP).
+ * The pixels are grouped in blocks of 32x32 pixels starting at the bottom-left corner of the bounds.
+ * A block whose pixels all have the same state only stores that state, the other blocks store
+ * 2 bits per pixel. Since renders mark large rectangles, most blocks are uniform: the memory used
+ * is a small fraction of one byte per pixel and the minimal rectangles are computed per block
+ * rather than per pixel.
+ **/
 class Bitmap
 {
 public:
     Bitmap(const RectI & bounds)
-        : _bounds(bounds)
-        , _map( bounds.area() )
+        : _bounds()
+        , _blocksPerRow(0)
+        , _blocksPerColumn(0)
+        , _blockStates()
+        , _blockSlots()
+        , _blockRows()
+        , _freeSlots()
         , _dirtyZone()
         , _dirtyZoneSet(false)
     {
@@ -76,39 +90,41 @@ public:
         // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
         // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
         //assert(!rod.isNull());
-        std::fill(_map.begin(), _map.end(), 0);
+        initialize(bounds);
     }
 
     Bitmap()
         : _bounds()
-        , _map()
+        , _blocksPerRow(0)
+        , _blocksPerColumn(0)
+        , _blockStates()
+        , _blockSlots()
+        , _blockRows()
+        , _freeSlots()
         , _dirtyZone()
         , _dirtyZoneSet(false)
     {
     }
 
-    void initialize(const RectI & bounds)
-    {
-        _bounds = bounds;
-        _map.resize( _bounds.area() );
-
-        std::fill(_map.begin(), _map.end(), 0);
-    }
+    void initialize(const RectI & bounds);
 
     ~Bitmap()
     {
     }
 
-    void setTo1()
-    {
-        std::fill(_map.begin(), _map.end(), 1);
-    }
+    void setTo1();
 
     const RectI & getBounds() const
     {
         return _bounds;
     }
 
+    /**
+     * @brief Returns the memory used by the bitmap if all its blocks stored their pixels.
+     * This is what the cache accounts for: the size of an entry must not change while it is in the cache.
+     **/
+    std::size_t getMaximumMemorySize() const;
+
 #if NATRON_ENABLE_TRIMAP
     void minimalNonMarkedRects_trimap(const RectI & roi, std::list<RectI>& ret, bool* isBeingRenderedElsewhere) const;
     RectI minimalNonMarkedBbox_trimap(const RectI & roi, bool* isBeingRenderedElsewhere) const;
@@ -132,18 +148,14 @@ public:
 
     void swap(Bitmap& other);
 
-    const char* getBitmap() const
-    {
-        return &_map.front();
-    }
+    ///Returns the state of the pixel (x,y), which must be inside the bounds
+    char getPixel(int x, int y) const;
 
-    char* getBitmap()
-    {
-        return &_map.front();
-    }
+    ///Copies the states of the pixels [x1,x2) of the row y to values, which must hold x2 - x1 chars
+    void getRow(int x1, int x2, int y, char* values) const;
 
-    const char* getBitmapAt(int x, int y) const;
-    char* getBitmapAt(int x, int y);
+    ///Sets the states of the pixels [x1,x2) of the row y from values
+    void setRow(int x1, int x2, int y, const char* values);
 
     void copyRowPortion(int x1, int x2, int y, const Bitmap& other);
 
@@ -158,9 +170,62 @@ public:
 private:
     void markFor(const RectI & roi, char value);
 
+    template <int trimap>
+    RectI minimalNonMarkedBbox_internal(const RectI& roi, bool* isBeingRenderedElsewhere) const;
+
+    template <int trimap>
+    void minimalNonMarkedRects_internal(const RectI& roi, std::list<RectI>& ret, bool* isBeingRenderedElsewhere) const;
+
+    /*
+     * In the following functions, values is a set of pixel states: the bit v is set if the state v is in the set.
+     */
+
+    ///Returns the mask of the pixels of the row r of the block whose state is in values, bit c being the column c
+    U32 getBlockRowPixels(int block, int r, int values) const;
+
+    ///Returns true if all the pixels of the row y in [x1,x2) are in values if all is true, or none of them if all is false
+    bool rowMatches(int y, int x1, int x2, int values, bool all) const;
+
+    ///Returns the number of consecutive rows of rect, starting from the bottom or the top, that match like rowMatches
+    int countMatchingRows(const RectI& rect, int values, bool fromBottom, bool all) const;
+
+    ///Returns the number of consecutive columns of rect, starting from the left or the right, that match like rowMatches
+    int countMatchingColumns(const RectI& rect, int values, bool fromLeft, bool all) const;
+
+    ///Returns true if a pixel of rect is in values
+    bool containsValues(const RectI& rect, int values) const;
+
+    ///Returns the state of the first non 0 pixel of the row y in [x1,x2) from the left, or 0
+    char getFirstMarkedPixelInRow(int y, int x1, int x2) const;
+
+    ///Returns the state of the first non 0 pixel of the column x in [y1,y2) from the bottom, or 0
+    char getFirstMarkedPixelInColumn(int x, int y1, int y2) const;
+
+    ///Makes the block store its pixels, if it is uniform
+    void setBlockMixed(int block);
+
+    ///Makes the block uniform with the given state, releasing its pixels
+    void setBlockUniform(int block, char value);
+
+    ///Makes the block uniform if all its pixels inside the bounds have the same state
+    void compressBlock(int block, int bx, int by);
+
 private:
     RectI _bounds;
-    std::vector<char> _map;
+    int _blocksPerRow;
+    int _blocksPerColumn;
+
+    // For each block, the state of all its pixels, or 3 if they differ
+    std::vector<unsigned char> _blockStates;
+
+    // For each block that stores its pixels, the slot of its rows in _blockRows, -1 otherwise
+    std::vector<int> _blockSlots;
+
+    // 32 rows per slot, each row holding 2 bits per pixel: the pixel of column c uses the bits 2c and 2c+1
+    std::vector<U64> _blockRows;
+
+    // Slots of _blockRows no longer used by a block
+    std::vector<int> _freeSlots;
 
     /**
      * This represents the zone that has potentially something to render. In minimalNonMarkedRects
@@ -172,6 +237,21 @@ private:
     bool _dirtyZoneSet;
 };
 
+/**
+ * @brief An operation on the pixels of a rectangle of an image, that can be executed concurrently
+ * on separate bands of the rectangle by Image::processRectInBands().
+ **/
+class ImageRectProcessor
+{
+public:
+
+    ImageRectProcessor() {}
+
+    virtual ~ImageRectProcessor() {}
+
+    virtual void process(const RectI & rect) const = 0;
+};
+
 class Image
     : public CacheEntryHelper<unsigned char, ImageKey, ImageParams>, public BufferableObject
 {
@@ -302,7 +382,7 @@ public:
         std::size_t dt = dataSize();
         bool got = _entryLock.tryLockForRead();
 
-        dt += _bitmap.getBounds().area();
+        dt += _bitmap.getMaximumMemorySize();
         if (got) {
             _entryLock.unlock();
         }
@@ -409,14 +489,6 @@ public:
 
             return img->pixelAt(x, y);
         }
-
-        const char* bitmapAt(int x,
-                             int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef boost::shared_ptr<ReadAccess> ReadAccessPtr;
@@ -461,14 +533,6 @@ public:
         {
             return img->pixelAt(x, y);
         }
-
-        char* bitmapAt(int x,
-                       int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef boost::shared_ptr<WriteAccess> WriteAccessPtr;
@@ -495,18 +559,6 @@ private:
      * of an image.
      **/
 
-    const char* getBitmapAt(int x,
-                            int y) const
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
-    char* getBitmapAt(int x,
-                      int y)
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
     /**
      * @brief Access pixels. The pointer must be cast to the appropriate type afterwards.
      **/
@@ -749,11 +801,18 @@ public:
      **/
     void pasteFrom( const Image & src, const RectI & srcRoi, bool copyBitmap = true, const OSGLContextPtr& glContext = OSGLContextPtr() );
 
+    /**
+     * @brief Calls processor.process() on horizontal bands of rect, executed in parallel by the TaskScheduler
+     * if rect is large enough, or on the whole rect in the calling thread otherwise.
+     * The bitmaps must not be modified by process(): Bitmap is not thread-safe.
+     **/
+    static void processRectInBands(const RectI & rect, const ImageRectProcessor & processor);
+
     /**
      * @brief Downscales a portion of this image into output.
-     * This function will adjust roi to the largest enclosed rectangle for the
-     * given mipmap level,
-     * and then computes the mipmap of the given level of that rectangle.
+     * The mipmap of the given level of the smallest enclosing rectangle of roi is computed
+     * directly into output, which must contain it. The rows are split among the threads
+     * of the TaskScheduler.
      **/
     void downscaleMipMap(const RectD& rod,
                          const RectI & roi,
@@ -830,6 +889,19 @@ private:
                                bool requiresUnpremult,
                                Image* dstImg) const;
 
+    /**
+     * @brief Converts the pixels of renderWindow, without the bitmap. Called by ConvertToFormatProcessor.
+     **/
+    void convertToFormatForRect(const RectI & renderWindow,
+                                ViewerColorSpaceEnum srcColorSpace,
+                                ViewerColorSpaceEnum dstColorSpace,
+                                int channelForAlpha,
+                                bool useAlpha0,
+                                bool requiresUnpremult,
+                                Image* dstImg) const;
+
+    class ConvertToFormatProcessor;
+
     template <typename PIX, bool doPremult>
     void premultInternal(const RectI& roi);
     template <bool doPremult>
@@ -979,36 +1051,21 @@ private:
                                          bool originalPremult,
                                          bool ignorePremult);
 
-
-    /**
-     * @brief Given the output buffer,the region of interest and the mip map level, this
-     * function computes the mip map of this image in the given roi.
-     * If roi is NOT a power of 2, then it will be rounded to the closest power of 2.
-     **/
-    void buildMipMapLevel(const RectD& dstRoD, const RectI & roiCanonical, unsigned int level, bool copyBitMap,
-                          Image* output) const;
+    class CopyUnProcessedChannelsProcessor;
 
 
     /**
-     * @brief Halve the given roi of this image into output.
-     * If the RoI bounds are odd, the largest enclosing RoI with even bounds will be considered.
+     * @brief Computes in output the mip map of the given level of this image in the given roi, in a single
+     * pass over the rows of the roi.
+     * If roi is NOT a power of 2, the mip map of the smallest enclosing power of 2 is computed, and its
+     * pixels at the edges are the average of the pixels of roi they cover.
      **/
-    void halveRoI(const RectI & roi, bool copyBitMap,
-                  Image* output) const;
-
-
-    template <typename PIX, int maxValue>
-    void halveRoIForDepth(const RectI & roi,
-                          bool copyBitMap,
+    void buildMipMapLevel(const RectI & roi, unsigned int level, bool copyBitMap,
                           Image* output) const;
 
-    /**
-     * @brief Same as halveRoI but for 1D only (either width == 1 or height == 1)
-     **/
-    void halve1DImage(const RectI & roi, Image* output) const;
-
-    template <typename PIX, int maxValue>
-    void halve1DImageForDepth(const RectI & roi, Image* output) const;
+    template <typename PIX>
+    void buildMipMapLevelForDepth(const RectI & roi, unsigned int level, bool copyBitMap,
+                                  Image* output) const;
 
     template <typename PIX, int maxValue>
     void upscaleMipMapForDepth(const RectI & roi, unsigned int fromLevel, unsigned int toLevel, Image* output) const;
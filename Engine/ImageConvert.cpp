@@ -37,6 +37,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include <QtCore/QDebug>
 
 #include "Engine/AppManager.h"
+#include "Engine/ImageConvertKernels.h"
 #include "Engine/Lut.h"
 
 NATRON_NAMESPACE_ENTER
@@ -162,6 +163,19 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
     if ( intersection.isNull() ) {
         return;
     }
+    if (!srcLut && !dstLut) {
+        ///Without colorspace conversion, this is a plain bit depth conversion: there is no error diffusion
+        const int rowElements = intersection.width() * nComp;
+        for (int y = intersection.y1; y < intersection.y2; ++y) {
+            ImageConvertKernels::convertDepth( (const SRCPIX*)srcImg.pixelAt(intersection.x1, y), rowElements,
+                                               (DSTPIX*)dstImg.pixelAt(intersection.x1, y) );
+            if (copyBitmap) {
+                dstImg.copyBitmapRowPortion(intersection.x1, intersection.x2, y, srcImg);
+            }
+        }
+
+        return;
+    }
     for (int y = 0; y < intersection.height(); ++y) {
         // coverity[dont_call]
         int start = rand() % intersection.width();
@@ -668,21 +682,53 @@ Image::convertToFormatInternalForDepth(const RectI & renderWindow,
     } // switch
 } // Image::convertToFormatInternalForDepth
 
-void
-Image::convertToFormatCommon(const RectI & renderWindow,
+///Converts the pixels of bands of the render window
+class Image::ConvertToFormatProcessor
+    : public ImageRectProcessor
+{
+public:
+    ConvertToFormatProcessor(const Image* srcImg,
                              ViewerColorSpaceEnum srcColorSpace,
                              ViewerColorSpaceEnum dstColorSpace,
                              int channelForAlpha,
                              bool useAlpha0,
-                             bool copyBitmap,
                              bool requiresUnpremult,
-                             Image* dstImg) const
-{
-    QWriteLocker k(&dstImg->_entryLock);
-    QReadLocker k2(&_entryLock);
+                             Image* dstImg)
+        : ImageRectProcessor()
+        , _srcImg(srcImg)
+        , _srcColorSpace(srcColorSpace)
+        , _dstColorSpace(dstColorSpace)
+        , _channelForAlpha(channelForAlpha)
+        , _useAlpha0(useAlpha0)
+        , _requiresUnpremult(requiresUnpremult)
+        , _dstImg(dstImg)
+    {
+    }
 
-    assert( _bounds.contains(renderWindow) &&  dstImg->_bounds.contains(renderWindow) );
+    virtual void process(const RectI & rect) const OVERRIDE FINAL
+    {
+        _srcImg->convertToFormatForRect(rect, _srcColorSpace, _dstColorSpace, _channelForAlpha, _useAlpha0, _requiresUnpremult, _dstImg);
+    }
+
+private:
+    const Image* _srcImg;
+    ViewerColorSpaceEnum _srcColorSpace;
+    ViewerColorSpaceEnum _dstColorSpace;
+    int _channelForAlpha;
+    bool _useAlpha0;
+    bool _requiresUnpremult;
+    Image* _dstImg;
+};
 
+void
+Image::convertToFormatForRect(const RectI & renderWindow,
+                              ViewerColorSpaceEnum srcColorSpace,
+                              ViewerColorSpaceEnum dstColorSpace,
+                              int channelForAlpha,
+                              bool useAlpha0,
+                              bool requiresUnpremult,
+                              Image* dstImg) const
+{
     if ( dstImg->getComponents().getNumComponents() == getComponents().getNumComponents() ) {
         switch ( dstImg->getBitDepth() ) {
         case eImageBitDepthByte: {
@@ -691,19 +737,19 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 ///Same as a copy
                 convertToFormatInternal_sameComps<unsigned char, unsigned char, 255, 255>(renderWindow, *this, *dstImg,
                                                                                           srcColorSpace,
-                                                                                          dstColorSpace, copyBitmap);
+                                                                                          dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthShort:
                 convertToFormatInternal_sameComps<unsigned short, unsigned char, 65535, 255>(renderWindow, *this, *dstImg,
                                                                                              srcColorSpace,
-                                                                                             dstColorSpace, copyBitmap);
+                                                                                             dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthHalf:
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternal_sameComps<float, unsigned char, 1, 255>(renderWindow, *this, *dstImg,
                                                                                 srcColorSpace,
-                                                                                dstColorSpace, copyBitmap);
+                                                                                dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthNone:
                 break;
@@ -716,20 +762,20 @@ Image::convertToFormatCommon(const RectI & renderWindow,
             case eImageBitDepthByte:
                 convertToFormatInternal_sameComps<unsigned char, unsigned short, 255, 65535>(renderWindow, *this, *dstImg,
                                                                                              srcColorSpace,
-                                                                                             dstColorSpace, copyBitmap);
+                                                                                             dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthShort:
                 ///Same as a copy
                 convertToFormatInternal_sameComps<unsigned short, unsigned short, 65535, 65535>(renderWindow, *this, *dstImg,
                                                                                                 srcColorSpace,
-                                                                                                dstColorSpace, copyBitmap);
+                                                                                                dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthHalf:
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternal_sameComps<float, unsigned short, 1, 65535>(renderWindow, *this, *dstImg,
                                                                                    srcColorSpace,
-                                                                                   dstColorSpace, copyBitmap);
+                                                                                   dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthNone:
                 break;
@@ -745,12 +791,12 @@ Image::convertToFormatCommon(const RectI & renderWindow,
             case eImageBitDepthByte:
                 convertToFormatInternal_sameComps<unsigned char, float, 255, 1>(renderWindow, *this, *dstImg,
                                                                                 srcColorSpace,
-                                                                                dstColorSpace, copyBitmap);
+                                                                                dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthShort:
                 convertToFormatInternal_sameComps<unsigned short, float, 65535, 1>(renderWindow, *this, *dstImg,
                                                                                    srcColorSpace,
-                                                                                   dstColorSpace, copyBitmap);
+                                                                                   dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthHalf:
                 break;
@@ -758,7 +804,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 ///Same as a copy
                 convertToFormatInternal_sameComps<float, float, 1, 1>(renderWindow, *this, *dstImg,
                                                                       srcColorSpace,
-                                                                      dstColorSpace, copyBitmap);
+                                                                      dstColorSpace, /*copyBitmap=*/ false);
                 break;
             case eImageBitDepthNone:
                 break;
@@ -779,7 +825,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                         dstColorSpace,
                                                                                         channelForAlpha,
                                                                                         useAlpha0,
-                                                                                        copyBitmap, requiresUnpremult);
+                                                                                        /*copyBitmap=*/ false, requiresUnpremult);
                 break;
             case eImageBitDepthShort:
                 convertToFormatInternalForDepth<unsigned short, unsigned char, 65535, 255>(renderWindow, *this, *dstImg,
@@ -787,7 +833,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                            dstColorSpace,
                                                                                            channelForAlpha,
                                                                                            useAlpha0,
-                                                                                           copyBitmap, requiresUnpremult);
+                                                                                           /*copyBitmap=*/ false, requiresUnpremult);
                 break;
             case eImageBitDepthHalf:
                 break;
@@ -797,7 +843,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                               dstColorSpace,
                                                                               channelForAlpha,
                                                                               useAlpha0,
-                                                                              copyBitmap, requiresUnpremult);
+                                                                              /*copyBitmap=*/ false, requiresUnpremult);
 
                 break;
             case eImageBitDepthNone:
@@ -813,7 +859,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                            dstColorSpace,
                                                                                            channelForAlpha,
                                                                                            useAlpha0,
-                                                                                           copyBitmap, requiresUnpremult);
+                                                                                           /*copyBitmap=*/ false, requiresUnpremult);
 
                 break;
             case eImageBitDepthShort:
@@ -822,7 +868,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                               dstColorSpace,
                                                                                               channelForAlpha,
                                                                                               useAlpha0,
-                                                                                              copyBitmap, requiresUnpremult);
+                                                                                              /*copyBitmap=*/ false, requiresUnpremult);
 
                 break;
             case eImageBitDepthHalf:
@@ -833,7 +879,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                  dstColorSpace,
                                                                                  channelForAlpha,
                                                                                  useAlpha0,
-                                                                                 copyBitmap, requiresUnpremult);
+                                                                                 /*copyBitmap=*/ false, requiresUnpremult);
                 break;
             case eImageBitDepthNone:
                 break;
@@ -850,7 +896,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                               dstColorSpace,
                                                                               channelForAlpha,
                                                                               useAlpha0,
-                                                                              copyBitmap, requiresUnpremult);
+                                                                              /*copyBitmap=*/ false, requiresUnpremult);
                 break;
             case eImageBitDepthShort:
                 convertToFormatInternalForDepth<unsigned short, float, 65535, 1>(renderWindow, *this, *dstImg,
@@ -858,7 +904,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                  dstColorSpace,
                                                                                  channelForAlpha,
                                                                                  useAlpha0,
-                                                                                 copyBitmap, requiresUnpremult);
+                                                                                 /*copyBitmap=*/ false, requiresUnpremult);
 
                 break;
             case eImageBitDepthHalf:
@@ -869,7 +915,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                     dstColorSpace,
                                                                     channelForAlpha,
                                                                     useAlpha0,
-                                                                    copyBitmap, requiresUnpremult);
+                                                                    /*copyBitmap=*/ false, requiresUnpremult);
                 break;
             case eImageBitDepthNone:
                 break;
@@ -881,6 +927,28 @@ Image::convertToFormatCommon(const RectI & renderWindow,
             break;
         } // switch
     }
+} // Image::convertToFormatForRect
+
+void
+Image::convertToFormatCommon(const RectI & renderWindow,
+                             ViewerColorSpaceEnum srcColorSpace,
+                             ViewerColorSpaceEnum dstColorSpace,
+                             int channelForAlpha,
+                             bool useAlpha0,
+                             bool copyBitmap,
+                             bool requiresUnpremult,
+                             Image* dstImg) const
+{
+    QWriteLocker k(&dstImg->_entryLock);
+    QReadLocker k2(&_entryLock);
+
+    assert( _bounds.contains(renderWindow) &&  dstImg->_bounds.contains(renderWindow) );
+
+    ///The bitmap is not thread-safe: copy it before converting the pixels in parallel
+    if (copyBitmap) {
+        dstImg->copyBitmapPortion(renderWindow, *this);
+    }
+    processRectInBands( renderWindow, ConvertToFormatProcessor(this, srcColorSpace, dstColorSpace, channelForAlpha, useAlpha0, requiresUnpremult, dstImg) );
 } // Image::convertToFormatCommon
 
 void
@@ -0,0 +1,478 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageConvertKernels.h"
+
+#include <cstring> // for std::memcpy
+
+#include "Engine/Lut.h"
+
+#ifdef NATRON_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace ImageConvertKernels {
+namespace {
+///////////////////////////////////////////////////////////////////////////////
+// Scalar versions: these are the reference, they do exactly what Image::convertPixelDepth does
+
+inline float
+floatFromFloat(float pix)
+{
+    // Color::floatToInt does not define the conversion of NaN
+    return (pix != pix) ? 0.f : pix;
+}
+
+void
+convertDepth_scalar(const unsigned char* src,
+                    int count,
+                    unsigned short* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = Color::charToUint16(src[i]);
+    }
+}
+
+void
+convertDepth_scalar(const unsigned char* src,
+                    int count,
+                    float* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = Color::intToFloat<256>(src[i]);
+    }
+}
+
+void
+convertDepth_scalar(const unsigned short* src,
+                    int count,
+                    unsigned char* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = Color::uint16ToChar(src[i]);
+    }
+}
+
+void
+convertDepth_scalar(const unsigned short* src,
+                    int count,
+                    float* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = Color::intToFloat<65536>(src[i]);
+    }
+}
+
+void
+convertDepth_scalar(const float* src,
+                    int count,
+                    unsigned char* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = (unsigned char)Color::floatToInt<256>( floatFromFloat(src[i]) );
+    }
+}
+
+void
+convertDepth_scalar(const float* src,
+                    int count,
+                    unsigned short* dst)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = (unsigned short)Color::floatToInt<65536>( floatFromFloat(src[i]) );
+    }
+}
+
+#ifdef NATRON_KERNELS_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.1 versions
+
+// Color::floatToInt: clamp to [0,1], then truncate v * maxValue + 0.5. max() returns 0 for NaN.
+NATRON_TARGET_SSE41
+inline __m128i
+floatToInt_sse41(__m128 v,
+                 __m128 maxValue)
+{
+    v = _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps(1.f) );
+
+    return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps(v, maxValue), _mm_set1_ps(0.5f) ) );
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const unsigned char* src,
+                   int count,
+                   unsigned short* dst)
+{
+    const __m128i k257 = _mm_set1_epi16(257);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_cvtepu8_epi16( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_mullo_epi16(v, k257) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const unsigned char* src,
+                   int count,
+                   float* dst)
+{
+    const __m128 maxValue = _mm_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        int values;
+        std::memcpy(&values, src + i, sizeof(int));
+        __m128 v = _mm_cvtepi32_ps( _mm_cvtepu8_epi32( _mm_cvtsi32_si128(values) ) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(v, maxValue) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const unsigned short* src,
+                   int count,
+                   unsigned char* dst)
+{
+    // ((v + 128) - ((v + 128) >> 8)) >> 8 in 32-bit lanes
+    const __m128i k128 = _mm_set1_epi32(128);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i lo = _mm_add_epi32( _mm_cvtepu16_epi32(v), k128 );
+        __m128i hi = _mm_add_epi32( _mm_cvtepu16_epi32( _mm_srli_si128(v, 8) ), k128 );
+        lo = _mm_srli_epi32( _mm_sub_epi32( lo, _mm_srli_epi32(lo, 8) ), 8 );
+        hi = _mm_srli_epi32( _mm_sub_epi32( hi, _mm_srli_epi32(hi, 8) ), 8 );
+        __m128i bytes = _mm_packus_epi16( _mm_packus_epi32(lo, hi), _mm_setzero_si128() );
+        _mm_storel_epi64( (__m128i*)(dst + i), bytes );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const unsigned short* src,
+                   int count,
+                   float* dst)
+{
+    const __m128 maxValue = _mm_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps(v), maxValue) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const float* src,
+                   int count,
+                   unsigned char* dst)
+{
+    const __m128 maxValue = _mm_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v0 = floatToInt_sse41(_mm_loadu_ps(src + i), maxValue);
+        __m128i v1 = floatToInt_sse41(_mm_loadu_ps(src + i + 4), maxValue);
+        __m128i v2 = floatToInt_sse41(_mm_loadu_ps(src + i + 8), maxValue);
+        __m128i v3 = floatToInt_sse41(_mm_loadu_ps(src + i + 12), maxValue);
+        __m128i bytes = _mm_packus_epi16( _mm_packus_epi32(v0, v1), _mm_packus_epi32(v2, v3) );
+        _mm_storeu_si128( (__m128i*)(dst + i), bytes );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_SSE41
+void
+convertDepth_sse41(const float* src,
+                   int count,
+                   unsigned short* dst)
+{
+    const __m128 maxValue = _mm_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v0 = floatToInt_sse41(_mm_loadu_ps(src + i), maxValue);
+        __m128i v1 = floatToInt_sse41(_mm_loadu_ps(src + i + 4), maxValue);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi32(v0, v1) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 versions, for the conversions from and to float only: the integer conversions are limited
+// by the memory bandwidth with SSE4.1 already
+
+NATRON_TARGET_AVX2
+inline __m256i
+floatToInt_avx2(__m256 v,
+                __m256 maxValue)
+{
+    v = _mm256_min_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps(1.f) );
+
+    return _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps(v, maxValue), _mm256_set1_ps(0.5f) ) );
+}
+
+NATRON_TARGET_AVX2
+void
+convertDepth_avx2(const unsigned char* src,
+                  int count,
+                  float* dst)
+{
+    const __m256 maxValue = _mm256_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), maxValue) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_AVX2
+void
+convertDepth_avx2(const unsigned short* src,
+                  int count,
+                  float* dst)
+{
+    const __m256 maxValue = _mm256_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), maxValue) );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_AVX2
+void
+convertDepth_avx2(const float* src,
+                  int count,
+                  unsigned char* dst)
+{
+    const __m256 maxValue = _mm256_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i v0 = floatToInt_avx2(_mm256_loadu_ps(src + i), maxValue);
+        __m256i v1 = floatToInt_avx2(_mm256_loadu_ps(src + i + 8), maxValue);
+        // the packs work in 128-bit lanes: 0-3 8-11 4-7 12-15, reordered by the permutation
+        __m256i words = _mm256_permute4x64_epi64( _mm256_packus_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0) );
+        __m128i bytes = _mm_packus_epi16( _mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1) );
+        _mm_storeu_si128( (__m128i*)(dst + i), bytes );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+NATRON_TARGET_AVX2
+void
+convertDepth_avx2(const float* src,
+                  int count,
+                  unsigned short* dst)
+{
+    const __m256 maxValue = _mm256_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i v0 = floatToInt_avx2(_mm256_loadu_ps(src + i), maxValue);
+        __m256i v1 = floatToInt_avx2(_mm256_loadu_ps(src + i + 8), maxValue);
+        // the pack works in 128-bit lanes: 0-3 8-11 4-7 12-15, reordered by the permutation
+        __m256i words = _mm256_permute4x64_epi64( _mm256_packus_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0) );
+        _mm256_storeu_si256( (__m256i*)(dst + i), words );
+    }
+    convertDepth_scalar(src + i, count - i, dst + i);
+}
+
+#endif // NATRON_KERNELS_X86
+
+template <typename PIX>
+void
+copyValues(const PIX* src,
+           int count,
+           PIX* dst)
+{
+    if (count > 0) {
+        std::memcpy( dst, src, count * sizeof(PIX) );
+    }
+}
+} // anon namespace
+
+void
+convertDepth(const unsigned char* src,
+             int count,
+             unsigned char* dst)
+{
+    copyValues(src, count, dst);
+}
+
+void
+convertDepth(const unsigned char* src,
+             int count,
+             unsigned short* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const unsigned char* src,
+             int count,
+             float* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertDepth_avx2(src, count, dst);
+        break;
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const unsigned short* src,
+             int count,
+             unsigned char* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const unsigned short* src,
+             int count,
+             unsigned short* dst)
+{
+    copyValues(src, count, dst);
+}
+
+void
+convertDepth(const unsigned short* src,
+             int count,
+             float* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertDepth_avx2(src, count, dst);
+        break;
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const float* src,
+             int count,
+             unsigned char* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertDepth_avx2(src, count, dst);
+        break;
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const float* src,
+             int count,
+             unsigned short* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertDepth_avx2(src, count, dst);
+        break;
+    case eInstructionSetSSE41:
+        convertDepth_sse41(src, count, dst);
+        break;
+#endif
+    default:
+        convertDepth_scalar(src, count, dst);
+        break;
+    }
+}
+
+void
+convertDepth(const float* src,
+             int count,
+             float* dst)
+{
+    copyValues(src, count, dst);
+}
+} // namespace ImageConvertKernels
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,71 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+
+#ifndef NATRON_ENGINE_IMAGECONVERTKERNELS_H
+#define NATRON_ENGINE_IMAGECONVERTKERNELS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+#include "Engine/InstructionSet.h"
+
+NATRON_NAMESPACE_ENTER
+
+/*
+ * Scan-line kernels used by Image::convertToFormat to convert the bit depth of pixels without
+ * colorspace conversion. Each kernel has a scalar implementation and vector implementations
+ * selected at runtime with getInstructionSet(), which give bit-exact identical results.
+ *
+ * The conversions are those of Image::convertPixelDepth: floats are clamped to [0,1] and rounded
+ * to the nearest integer, 8-bit values are expanded to 16 bits by repeating them, and 16-bit values
+ * are rounded to 8 bits as in ImageMagick.
+ * A NaN is converted to 0.
+ */
+namespace ImageConvertKernels {
+/**
+ * @brief Converts count values from src to dst, which must not overlap.
+ **/
+void convertDepth(const unsigned char* src, int count, unsigned char* dst);
+
+void convertDepth(const unsigned char* src, int count, unsigned short* dst);
+
+void convertDepth(const unsigned char* src, int count, float* dst);
+
+void convertDepth(const unsigned short* src, int count, unsigned char* dst);
+
+void convertDepth(const unsigned short* src, int count, unsigned short* dst);
+
+void convertDepth(const unsigned short* src, int count, float* dst);
+
+void convertDepth(const float* src, int count, unsigned char* dst);
+
+void convertDepth(const float* src, int count, unsigned short* dst);
+
+void convertDepth(const float* src, int count, float* dst);
+} // namespace ImageConvertKernels
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_IMAGECONVERTKERNELS_H
@@ -587,6 +587,53 @@ Image::canCallCopyUnProcessedChannels(const std::bitset<4> processChannels) cons
     return true;
 }
 
+///Copies the unprocessed channels of bands of the roi
+class Image::CopyUnProcessedChannelsProcessor
+    : public ImageRectProcessor
+{
+public:
+    CopyUnProcessedChannelsProcessor(Image* image,
+                                     bool premult,
+                                     std::bitset<4> processChannels,
+                                     const ImagePtr& originalImage,
+                                     bool originalPremult,
+                                     bool ignorePremult)
+        : ImageRectProcessor()
+        , _image(image)
+        , _premult(premult)
+        , _processChannels(processChannels)
+        , _originalImage(originalImage)
+        , _originalPremult(originalPremult)
+        , _ignorePremult(ignorePremult)
+    {
+    }
+
+    virtual void process(const RectI & rect) const OVERRIDE FINAL
+    {
+        switch ( _image->getBitDepth() ) {
+        case eImageBitDepthByte:
+            _image->copyUnProcessedChannelsForDepth<unsigned char, 255>(_premult, rect, _processChannels, _originalImage, _originalPremult, _ignorePremult);
+            break;
+        case eImageBitDepthShort:
+            _image->copyUnProcessedChannelsForDepth<unsigned short, 65535>(_premult, rect, _processChannels, _originalImage, _originalPremult, _ignorePremult);
+            break;
+        case eImageBitDepthFloat:
+            _image->copyUnProcessedChannelsForDepth<float, 1>(_premult, rect, _processChannels, _originalImage, _originalPremult, _ignorePremult);
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    Image* _image;
+    bool _premult;
+    std::bitset<4> _processChannels;
+    ImagePtr _originalImage;
+    bool _originalPremult;
+    bool _ignorePremult;
+};
+
 void
 Image::copyUnProcessedChannels(const RectI& roi,
                                const ImagePremultiplicationEnum outputPremult,
@@ -682,19 +729,13 @@ Image::copyUnProcessedChannels(const RectI& roi,
 
     bool premult = (outputPremult == eImagePremultiplicationPremultiplied);
     bool originalPremult = (originalImagePremult == eImagePremultiplicationPremultiplied);
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        copyUnProcessedChannelsForDepth<unsigned char, 255>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
-        break;
-    case eImageBitDepthShort:
-        copyUnProcessedChannelsForDepth<unsigned short, 65535>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
-        break;
-    case eImageBitDepthFloat:
-        copyUnProcessedChannelsForDepth<float, 1>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
-        break;
-    default:
-
-        return;
+    CopyUnProcessedChannelsProcessor processor(this, premult, processChannels, originalImage, originalPremult, ignorePremult);
+    if (originalImage.get() == this) {
+        // The pixels of the original image are read with a ReadAccess, which would wait in other threads
+        // for the write lock held by this thread
+        processor.process(roi);
+    } else {
+        processRectInBands(roi, processor);
     }
 } // copyUnProcessedChannels
 
@@ -0,0 +1,102 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "InstructionSet.h"
+
+#include <algorithm>
+
+#if defined(NATRON_KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+InstructionSetEnum
+detectInstructionSet()
+{
+#if defined(NATRON_KERNELS_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int nIds = info[0];
+    if (nIds < 1) {
+        return eInstructionSetScalar;
+    }
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (nIds >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    // the OS must save the YMM registers
+    if ( avx && avx2 && osxsave && ( (_xgetbv(0) & 6) == 6 ) ) {
+        return eInstructionSetAVX2;
+    }
+    if (sse41) {
+        return eInstructionSetSSE41;
+    }
+#else
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return eInstructionSetAVX2;
+    }
+    if ( __builtin_cpu_supports("sse4.1") ) {
+        return eInstructionSetSSE41;
+    }
+#endif
+#endif // NATRON_KERNELS_X86
+
+    return eInstructionSetScalar;
+}
+
+const InstructionSetEnum supportedInstructionSet = detectInstructionSet();
+InstructionSetEnum currentInstructionSet = supportedInstructionSet;
+} // anon namespace
+
+InstructionSetEnum
+getSupportedInstructionSet()
+{
+    return supportedInstructionSet;
+}
+
+InstructionSetEnum
+getInstructionSet()
+{
+    return currentInstructionSet;
+}
+
+InstructionSetEnum
+setInstructionSet(InstructionSetEnum instructionSet)
+{
+    currentInstructionSet = std::min(instructionSet, supportedInstructionSet);
+
+    return currentInstructionSet;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,80 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_INSTRUCTIONSET_H
+#define NATRON_ENGINE_INSTRUCTIONSET_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+
+// The SSE4.1 and AVX2 kernels are compiled with function attributes, so that the rest of the
+// files (and the scalar fallbacks) do not require these instruction sets.
+// Note: the kernels must not be compiled with FMA contraction (e.g. -mfma -ffp-contract=fast),
+// otherwise the scalar and vector versions may round differently.
+#if ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) )
+#define NATRON_KERNELS_X86
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#elif defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#define NATRON_KERNELS_X86
+#define NATRON_TARGET_SSE41
+#define NATRON_TARGET_AVX2
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+/*
+ * Vector instruction sets used by the scan-line kernels (ViewerTextureKernels, Lut).
+ * The best instruction set supported by the CPU is detected once, and the kernels
+ * dispatch at runtime on the current one.
+ */
+enum InstructionSetEnum
+{
+    eInstructionSetScalar = 0,
+    eInstructionSetSSE41,
+    eInstructionSetAVX2
+};
+
+/**
+ * @brief Returns the best instruction set supported by the CPU
+ **/
+InstructionSetEnum getSupportedInstructionSet();
+
+/**
+ * @brief Returns the instruction set used by the kernels
+ **/
+InstructionSetEnum getInstructionSet();
+
+/**
+ * @brief Force the instruction set used by the kernels (for tests and benchmarks). It cannot
+ * be better than the one supported by the CPU.
+ * @returns The instruction set actually used.
+ **/
+InstructionSetEnum setInstructionSet(InstructionSetEnum instructionSet);
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_INSTRUCTIONSET_H
@@ -427,22 +427,43 @@ Interpolation::interpolate(double tcur,
                            double currentTime,
                            KeyframeTypeEnum interp,
                            KeyframeTypeEnum interpNext)
+{
+    // commented-out: the following assert is not true for periodic curves and passing the flag to interpolate would only be required in NDEBUG
+    //assert( ( (interp == eKeyframeTypeNone) || (tcur <= currentTime) ) && ( (currentTime < tnext) || (interpNext == eKeyframeTypeNone) ) );
+    double c[4];
+
+    cubicCoeffs(&tcur, vcur, vcurDerivRight, vnextDerivLeft, &tnext, vnext, interp, interpNext, c);
+
+    // cubicDerive: divide the result by (tnext-tcur)
+
+    // cubicIntegrate: multiply the result by (tnext-tcur)
+    return evaluateCubic(c, tcur, tnext, currentTime);
+}
+
+void
+Interpolation::cubicCoeffs(double* tcur,
+                           const double vcur,              //start control point
+                           const double vcurDerivRight, //being the derivative dv/dt at tcur
+                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                           double* tnext,
+                           const double vnext,               //end control point
+                           KeyframeTypeEnum interp,
+                           KeyframeTypeEnum interpNext,
+                           double c[4])
 {
     double P0 = vcur;
     double P3 = vnext;
     // Hermite coefficients P0' and P3' are the derivatives with respect to x \in [0,1]
-    double P0pr = vcurDerivRight * (tnext - tcur); // normalize for x \in [0,1]
-    double P3pl = vnextDerivLeft * (tnext - tcur); // normalize for x \in [0,1]
+    double P0pr = vcurDerivRight * (*tnext - *tcur); // normalize for x \in [0,1]
+    double P3pl = vnextDerivLeft * (*tnext - *tcur); // normalize for x \in [0,1]
 
     // if the following is true, this makes the special case for eKeyframeTypeConstant at tnext useless, and we can always use a cubic - the strict "currentTime < tnext" is the key
-    // commented-out: the following assert is not true for periodic curves and passing the flag to interpolate would only be required in NDEBUG
-    //assert( ( (interp == eKeyframeTypeNone) || (tcur <= currentTime) ) && ( (currentTime < tnext) || (interpNext == eKeyframeTypeNone) ) );
     // after the last / before the first keyframe, derivatives are wrt currentTime (i.e. non-normalized)
     if (interp == eKeyframeTypeNone) {
         // virtual previous frame at t-1
         P0 = P3 - P3pl;
         P0pr = P3pl;
-        tcur = tnext - 1.;
+        *tcur = *tnext - 1.;
     } else if (interp == eKeyframeTypeConstant) {
         P0pr = 0.;
         P3pl = 0.;
@@ -452,18 +473,20 @@ Interpolation::interpolate(double tcur,
         // virtual next frame at t+1
         P3pl = P0pr;
         P3 = P0 + P0pr;
-        tnext = tcur + 1;
+        *tnext = *tcur + 1;
     }
-    double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c[0], &c[1], &c[2], &c[3]);
+}
 
+double
+Interpolation::evaluateCubic(const double c[4],
+                             double tcur,
+                             double tnext,
+                             double currentTime)
+{
     const double t = (currentTime - tcur) / (tnext - tcur);
-    double ret = cubicEval(c0, c1, c2, c3, t);
 
-    // cubicDerive: divide the result by (tnext-tcur)
-
-    // cubicIntegrate: multiply the result by (tnext-tcur)
-    return ret;
+    return cubicEval(c[0], c[1], c[2], c[3], t);
 }
 
 /// derive at currentTime. The derivative is with respect to currentTime
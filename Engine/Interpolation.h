@@ -49,6 +49,25 @@ double interpolate(double tcur, const double vcur, //start control point
                    KeyframeTypeEnum interp,
                    KeyframeTypeEnum interpNext) WARN_UNUSED_RETURN;
 
+/**
+ * @brief The cubic used by interpolate() between tcur and tnext, for all currentTime:
+ * interpolate(...) = evaluateCubic(c, tcur, tnext, currentTime) where tcur and tnext are
+ * adjusted before the first keyframe (interp == eKeyframeTypeNone) and after the last one (interpNext == eKeyframeTypeNone).
+ **/
+void cubicCoeffs(double* tcur, const double vcur, //start control point
+                 const double vcurDerivRight, //being the derivative dv/dt at tcur
+                 const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                 double* tnext, const double vnext, //end control point
+                 KeyframeTypeEnum interp,
+                 KeyframeTypeEnum interpNext,
+                 double c[4]);
+
+/// evaluate at currentTime the cubic computed by cubicCoeffs()
+double evaluateCubic(const double c[4],
+                     double tcur,
+                     double tnext,
+                     double currentTime) WARN_UNUSED_RETURN;
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double derive(double tcur, const double vcur, //start control point
               const double vcurDerivRight, //being the derivative dv/dt at tcur
@@ -44,12 +44,14 @@
 #include "Engine/Curve.h"
 #include "Engine/DockablePanelI.h"
 #include "Engine/Hash64.h"
+#include "Engine/KnobExpression.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobGuiI.h"
 #include "Engine/KnobSerialization.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/Node.h"
+#include "Engine/ParallelRenderArgs.h"
 #include "Engine/Project.h"
 #include "Engine/StringAnimationManager.h"
 #include "Engine/TLSHolder.h"
@@ -225,10 +227,13 @@ struct Expr
     ///The list of pair<knob, dimension> dpendencies for an expression
     std::list<std::pair<KnobIWPtr, int> > dependencies;
 
+    ///The expression compiled natively, NULL if it can only be evaluated by Python
+    KnobExpressionPtr compiled;
+
     //PyObject* code;
 
     Expr()
-        : expression(), originalExpression(), exprInvalid(), hasRet(false) /*, code(0)*/ {}
+        : expression(), originalExpression(), exprInvalid(), hasRet(false), compiled() /*, code(0)*/ {}
 };
 
 struct KnobHelperPrivate
@@ -592,11 +597,26 @@ KnobHelper::isDynamicallyCreated() const
     return _imp->dynamicallyCreated;
 }
 
+// User knobs are serialized by the node of their holder, see Node::markSerializationDirty()
+static void
+markHolderNodeSerializationDirty(KnobHolder* holder)
+{
+    EffectInstance* effect = dynamic_cast<EffectInstance*>(holder);
+    NodePtr node = effect ? effect->getNode() : NodePtr();
+
+    if (node) {
+        node->markSerializationDirty();
+    }
+}
+
 void
 KnobHelper::setAsUserKnob(bool b)
 {
     _imp->userKnob = b;
     _imp->dynamicallyCreated = b;
+    if (b) {
+        markHolderNodeSerializationDirty(_imp->holder);
+    }
 }
 
 bool
@@ -1691,6 +1711,10 @@ KnobHelper::evaluateValueChangeInternal(int dimension,
     /// the application responsiveness
     onInternalValueChanged(dimension, time, view);
 
+    if (originalReason != eValueChangedReasonTimeChanged) {
+        invalidateHolderKnobsSnapshot();
+    }
+
     bool ret = false;
     if ( ( (originalReason != eValueChangedReasonTimeChanged) || evaluateValueChangeOnTimeChange() ) && _imp->holder ) {
         _imp->holder->beginChanges();
@@ -2665,6 +2689,12 @@ KnobHelper::setExpressionInternal(int dimension,
         }
     }
 
+    // Most expressions only do arithmetic on params values: compile them so that they are evaluated without the GIL
+    KnobExpressionPtr compiled;
+    if ( exprInvalid.empty() && !hasRetVariable && !dynamic_cast<KnobStringBase*>(this) ) {
+        compiled = KnobExpression::compile(expression, shared_from_this(), dimension);
+    }
+
     //Set internal fields
 
     {
@@ -2673,11 +2703,15 @@ KnobHelper::setExpressionInternal(int dimension,
         _imp->expressions[dimension].expression = exprCpy;
         _imp->expressions[dimension].originalExpression = expression;
         _imp->expressions[dimension].exprInvalid = exprInvalid;
+        _imp->expressions[dimension].compiled = compiled;
 
         ///This may throw an exception upon failure
         //NATRON_PYTHON_NAMESPACE::compilePyScript(exprCpy, &_imp->expressions[dimension].code);
     }
 
+    // The snapshot may hold the value of this dimension, which is now driven by the expression
+    invalidateHolderKnobsSnapshot();
+
     if ( getHolder() ) {
         //Parse listeners of the expression, to keep track of dependencies to indicate them to the user.
 
@@ -2765,6 +2799,7 @@ KnobHelper::clearExpression(int dimension,
         _imp->expressions[dimension].expression.clear();
         _imp->expressions[dimension].originalExpression.clear();
         _imp->expressions[dimension].exprInvalid.clear();
+        _imp->expressions[dimension].compiled.reset();
         //Py_XDECREF(_imp->expressions[dimension].code); //< new ref
         //_imp->expressions[dimension].code = 0;
     }
@@ -2893,6 +2928,22 @@ KnobHelper::executeExpression(double time,
     return executeExpression(ss.str(), ret, error);
 }
 
+bool
+KnobHelper::executeCompiledExpression(double time,
+                                      ViewIdx view,
+                                      int dimension,
+                                      double* ret,
+                                      bool* isInt) const
+{
+    KnobExpressionPtr compiled;
+    {
+        QMutexLocker k(&_imp->expressionMutex);
+        compiled = _imp->expressions[dimension].compiled;
+    }
+
+    return compiled && compiled->evaluate(time, view, ret, isInt);
+}
+
 
 bool
 KnobHelper::executeExpression(const std::string& expr,
@@ -3950,6 +4001,7 @@ KnobHelper::cloneOneCurve(KnobI* other,
             }
         }
     }
+    invalidateHolderKnobsSnapshot();
     checkAnimationLevel(ViewIdx(0), dimension);
 }
 
@@ -4003,6 +4055,9 @@ KnobHelper::cloneOneCurveAndCheckIfChanged(KnobI* other,
             cloningCurveChanged |= guiCurve->cloneAndCheckIfChanged(*otherCurve);
         }
     }
+    if (cloningCurveChanged) {
+        invalidateHolderKnobsSnapshot();
+    }
 
     if (updateGui && cloningCurveChanged) {
         // Indicate that old keyframes are removed
@@ -4146,6 +4201,27 @@ KnobHelper::getListeners(KnobI::ListenerDimsMap & listeners) const
     listeners = _imp->listeners;
 }
 
+KnobsSnapshotPtr
+KnobHelper::getKnobsSnapshotTLS() const
+{
+    EffectInstance* effect = dynamic_cast<EffectInstance*>(_imp->holder);
+
+    if (!effect) {
+        return KnobsSnapshotPtr();
+    }
+    ParallelRenderArgsPtr args = effect->getParallelRenderArgsTLS();
+
+    return args ? args->knobsSnapshot : KnobsSnapshotPtr();
+}
+
+void
+KnobHelper::invalidateHolderKnobsSnapshot() const
+{
+    if (_imp->holder) {
+        _imp->holder->invalidateKnobsSnapshot();
+    }
+}
+
 double
 KnobHelper::getCurrentTime() const
 {
@@ -4838,6 +4914,8 @@ KnobHolder::addKnob(const KnobIPtr& k)
         }
     }
     _imp->knobs.push_back(k);
+    kk.unlock();
+    invalidateKnobsSnapshot();
 }
 
 void
@@ -4860,6 +4938,8 @@ KnobHolder::insertKnob(int index,
         std::advance(it, index);
         _imp->knobs.insert(it, k);
     }
+    kk.unlock();
+    invalidateKnobsSnapshot();
 }
 
 void
@@ -4870,6 +4950,8 @@ KnobHolder::removeKnobFromList(const KnobI* knob)
     for (KnobsVec::iterator it = _imp->knobs.begin(); it != _imp->knobs.end(); ++it) {
         if (it->get() == knob) {
             _imp->knobs.erase(it);
+            kk.unlock();
+            invalidateKnobsSnapshot();
 
             return;
         }
@@ -4945,6 +5027,10 @@ KnobHolder::deleteKnob(KnobI* knob,
             }
         }
     }
+    invalidateKnobsSnapshot();
+    if ( sharedKnob && sharedKnob->isUserKnob() ) {
+        markHolderNodeSerializationDirty(this);
+    }
 
     if (alsoDeleteGui && _imp->settingsPanel) {
         _imp->settingsPanel->deleteKnobGui(sharedKnob);
@@ -5020,6 +5106,10 @@ KnobHolder::moveKnobOneStepUp(KnobI* knob)
         }
     }
 
+    if (moveOk) {
+        markHolderNodeSerializationDirty(this);
+    }
+
     return moveOk;
 } // KnobHolder::moveKnobOneStepUp
 
@@ -5092,6 +5182,10 @@ KnobHolder::moveKnobOneStepDown(KnobI* knob)
         }
     }
 
+    if (moveOk) {
+        markHolderNodeSerializationDirty(this);
+    }
+
     return moveOk;
 } // KnobHolder::moveKnobOneStepDown
 
@@ -676,6 +676,12 @@ public:
                                              const std::string& oldName,
                                              const std::string& newName) = 0;
     virtual void clearExpressionsResults(int dimension) = 0;
+
+    /**
+     * @brief Adds to the snapshot the values of the dimensions of this knob that are neither driven by an
+     * expression nor slaved to another knob, @see KnobsSnapshot
+     **/
+    virtual void addToKnobsSnapshot(KnobsSnapshot* snapshot) = 0;
     virtual void clearExpression(int dimension, bool clearResults) = 0;
     virtual std::string getExpression(int dimension) const = 0;
 
@@ -1589,6 +1595,24 @@ protected:
     ///The return value must be Py_DECRREF
     bool executeExpression(double time, ViewIdx view, int dimension, PyObject** ret, std::string* error) const;
 
+    /**
+     * @brief Evaluates the expression of the given dimension without Python if it could be compiled by KnobExpression.
+     * isInt is set to true if Python would have returned an int or a bool.
+     * Returns false if the expression must be evaluated by Python with executeExpression().
+     **/
+    bool executeCompiledExpression(double time, ViewIdx view, int dimension, double* ret, bool* isInt) const;
+
+    /**
+     * @brief Returns the snapshot of the knobs of the holder taken for the render of the current thread, if any.
+     **/
+    KnobsSnapshotPtr getKnobsSnapshotTLS() const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Called when a value or a curve of this knob changed, so that the holder takes a new snapshot of its knobs
+     * for the next renders.
+     **/
+    void invalidateHolderKnobsSnapshot() const;
+
 public:
 
     /// The return value must be Py_DECRREF
@@ -2066,6 +2090,13 @@ public:
 
     bool getValueFromCurve(double time, ViewSpec view, int dimension, bool useGuiCurve, bool byPassMaster, bool clamp, T* ret);
 
+    /**
+     * @brief Reads the value of the dimension from the knobs snapshot of the render of the current thread.
+     * If atCurrentTime is true, the curve of the dimension is evaluated at the current time instead of the given time.
+     * Returns false if there is no snapshot or if the dimension was not captured.
+     **/
+    bool getValueFromKnobsSnapshot(double time, bool atCurrentTime, int dimension, bool clamp, T* ret);
+
 protected:
 
     virtual void resetExtraToDefaultValue(int /*dimension*/) {}
@@ -2110,11 +2141,16 @@ private:
 
     virtual void clearExpressionsResults(int dimension) OVERRIDE FINAL
     {
-        QMutexLocker k(&_valueMutex);
+        {
+            QMutexLocker k(&_valueMutex);
 
-        _exprRes[dimension].clear();
+            _exprRes[dimension].clear();
+        }
+        invalidateHolderKnobsSnapshot();
     }
 
+    virtual void addToKnobsSnapshot(KnobsSnapshot* snapshot) OVERRIDE FINAL;
+
 
 public:
     /// This static publicly-available function is useful to evaluate simple python expressions that evaluate to a double, int or string value.
@@ -2130,6 +2166,11 @@ private:
      */
     bool evaluateExpression_pod(double time, ViewIdx view, int dimension, double* value, std::string* error);
 
+    /*
+     * @brief Evaluates the expression with executeCompiledExpression(), returns false if it must be evaluated by Python
+     */
+    bool evaluateCompiledExpression(double time, ViewIdx view, int dimension, T* ret) const;
+
 
     bool getValueFromExpression(double time, ViewIdx view, int dimension, bool clamp, T* ret);
 
@@ -2727,6 +2768,11 @@ public:
     {
     }
 
+    /**
+     * @brief Called when the value of a knob changed: any snapshot of the knobs kept for the next renders is outdated.
+     **/
+    virtual void invalidateKnobsSnapshot() {}
+
 public Q_SLOTS:
 
     void onDoEndChangesOnMainThreadTriggered();
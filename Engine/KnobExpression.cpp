@@ -0,0 +1,1456 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobExpression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#include "Engine/AppManager.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Knob.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+
+// Maximum nesting of the expression tree, which is evaluated recursively
+#define KNOB_EXPRESSION_MAX_DEPTH 128
+
+// Python ints are held in doubles: an int result that a double cannot represent exactly is left to Python
+#define KNOB_EXPRESSION_MAX_INT 9007199254740992. // 2^53
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+enum ExprNodeTypeEnum
+{
+    eExprNodeTypeConstant = 0,
+    eExprNodeTypeFrame,
+    eExprNodeTypeView,
+    eExprNodeTypeUnary,
+    eExprNodeTypeBinary,
+    eExprNodeTypeCompare,
+    eExprNodeTypeAnd,
+    eExprNodeTypeOr,
+    eExprNodeTypeConditional,
+    eExprNodeTypeFunction,
+    eExprNodeTypeKnob
+};
+
+enum ExprOperatorEnum
+{
+    eExprOperatorAdd = 0,
+    eExprOperatorSub,
+    eExprOperatorMul,
+    eExprOperatorDiv,
+    eExprOperatorFloorDiv,
+    eExprOperatorMod,
+    eExprOperatorPow,
+    eExprOperatorNeg,
+    eExprOperatorPos,
+    eExprOperatorNot,
+    eExprOperatorLess,
+    eExprOperatorLessEqual,
+    eExprOperatorGreater,
+    eExprOperatorGreaterEqual,
+    eExprOperatorEqual,
+    eExprOperatorNotEqual
+};
+
+enum ExprFunctionEnum
+{
+    eExprFunctionAbs = 0,
+    eExprFunctionAcos,
+    eExprFunctionAsin,
+    eExprFunctionAtan,
+    eExprFunctionAtan2,
+    eExprFunctionCeil,
+    eExprFunctionCopysign,
+    eExprFunctionCos,
+    eExprFunctionCosh,
+    eExprFunctionDegrees,
+    eExprFunctionExp,
+    eExprFunctionFabs,
+    eExprFunctionFloat,
+    eExprFunctionFloor,
+    eExprFunctionFmod,
+    eExprFunctionHypot,
+    eExprFunctionInt,
+    eExprFunctionLog,
+    eExprFunctionLog10,
+    eExprFunctionMax,
+    eExprFunctionMin,
+    eExprFunctionPow,
+    eExprFunctionRadians,
+    eExprFunctionSin,
+    eExprFunctionSinh,
+    eExprFunctionSqrt,
+    eExprFunctionTan,
+    eExprFunctionTanh,
+    eExprFunctionTrunc
+};
+
+struct ExprFunction
+{
+    const char* name;
+    ExprFunctionEnum function;
+    int minArgs;
+    int maxArgs; //< -1 for any number
+};
+
+// The builtins and the functions of the math module that can be compiled
+const ExprFunction exprFunctions[] = {
+    { "abs", eExprFunctionAbs, 1, 1 },
+    { "acos", eExprFunctionAcos, 1, 1 },
+    { "asin", eExprFunctionAsin, 1, 1 },
+    { "atan", eExprFunctionAtan, 1, 1 },
+    { "atan2", eExprFunctionAtan2, 2, 2 },
+    { "ceil", eExprFunctionCeil, 1, 1 },
+    { "copysign", eExprFunctionCopysign, 2, 2 },
+    { "cos", eExprFunctionCos, 1, 1 },
+    { "cosh", eExprFunctionCosh, 1, 1 },
+    { "degrees", eExprFunctionDegrees, 1, 1 },
+    { "exp", eExprFunctionExp, 1, 1 },
+    { "fabs", eExprFunctionFabs, 1, 1 },
+    { "float", eExprFunctionFloat, 1, 1 },
+    { "floor", eExprFunctionFloor, 1, 1 },
+    { "fmod", eExprFunctionFmod, 2, 2 },
+    { "hypot", eExprFunctionHypot, 2, 2 },
+    { "int", eExprFunctionInt, 1, 1 },
+    { "log", eExprFunctionLog, 1, 2 },
+    { "log10", eExprFunctionLog10, 1, 1 },
+    { "max", eExprFunctionMax, 2, -1 },
+    { "min", eExprFunctionMin, 2, -1 },
+    { "pow", eExprFunctionPow, 2, 2 },
+    { "radians", eExprFunctionRadians, 1, 1 },
+    { "sin", eExprFunctionSin, 1, 1 },
+    { "sinh", eExprFunctionSinh, 1, 1 },
+    { "sqrt", eExprFunctionSqrt, 1, 1 },
+    { "tan", eExprFunctionTan, 1, 1 },
+    { "tanh", eExprFunctionTanh, 1, 1 },
+    { "trunc", eExprFunctionTrunc, 1, 1 },
+};
+
+enum ExprKnobAccessEnum
+{
+    eExprKnobAccessGetValue = 0, //< getValue([dimension])
+    eExprKnobAccessGetValueAtTime, //< getValueAtTime(time[, dimension])
+    eExprKnobAccessGet, //< get([time]), the dimension is the index in the returned tuple
+    eExprKnobAccessCurve //< curve(time[, dimension])
+};
+
+struct ExprValue
+{
+    double value;
+    bool isInt; //< true if this is a Python int or bool
+};
+
+struct ExprNode
+{
+    ExprNodeTypeEnum type;
+    int op; //< ExprOperatorEnum, ExprFunctionEnum or ExprKnobAccessEnum
+    ExprValue constant;
+    std::vector<int> args; //< indices of the operands in the nodes
+    int knobIndex;
+    int tupleIndex; //< for get(), the index of the attribute in the returned tuple
+    int depth;
+
+    ExprNode()
+        : type(eExprNodeTypeConstant)
+        , op(0)
+        , constant()
+        , args()
+        , knobIndex(-1)
+        , tupleIndex(0)
+        , depth(1)
+    {
+        constant.value = 0.;
+        constant.isInt = true;
+    }
+};
+
+enum ExprKnobTypeEnum
+{
+    eExprKnobTypeDouble = 0,
+    eExprKnobTypeInt,
+    eExprKnobTypeBool
+};
+
+struct ExprKnob
+{
+    ExprKnobTypeEnum type;
+    KnobDoubleBaseWPtr doubleKnob;
+    KnobIntBaseWPtr intKnob;
+    KnobBoolBaseWPtr boolKnob;
+
+    // True if the knob belongs to another node, which may be deactivated after the expression was compiled:
+    // Python would not find it any longer
+    bool checkActivated;
+};
+
+bool
+setResult(double value,
+          bool isInt,
+          ExprValue* ret)
+{
+    // Python raises an exception for results that are not finite: also rejects NaNs
+    if ( !( std::fabs(value) <= (isInt ? KNOB_EXPRESSION_MAX_INT : DBL_MAX) ) ) {
+        return false;
+    }
+    ret->value = value;
+    ret->isInt = isInt;
+
+    return true;
+}
+
+// Same as float_floor_div in Python's floatobject.c
+double
+pythonFloorDiv(double a,
+               double b)
+{
+    double mod = std::fmod(a, b);
+    double div = (a - mod) / b;
+
+    if (mod) {
+        if ( (b < 0) != (mod < 0) ) {
+            div -= 1.;
+        }
+    }
+    if (div) {
+        double floordiv = std::floor(div);
+        if (div - floordiv > 0.5) {
+            floordiv += 1.;
+        }
+
+        return floordiv;
+    }
+
+    return (a / b) < 0 ? -0. : 0.;
+}
+
+// Same as float_rem in Python's floatobject.c
+double
+pythonMod(double a,
+          double b)
+{
+    double mod = std::fmod(a, b);
+
+    if (mod) {
+        if ( (b < 0) != (mod < 0) ) {
+            mod += b;
+        }
+    } else {
+        mod = b < 0 ? -0. : 0.;
+    }
+
+    return mod;
+}
+
+bool
+isTruthy(const ExprValue & v)
+{
+    return v.value != 0.;
+}
+} // anon namespace
+
+struct KnobExpressionPrivate
+{
+    std::vector<ExprNode> nodes;
+    std::vector<ExprKnob> knobs;
+    int root;
+
+    KnobExpressionPrivate()
+        : nodes()
+        , knobs()
+        , root(-1)
+    {
+    }
+
+    int addNode(const ExprNode & node)
+    {
+        nodes.push_back(node);
+        ExprNode & added = nodes.back();
+        for (std::size_t i = 0; i < added.args.size(); ++i) {
+            added.depth = std::max(added.depth, nodes[added.args[i]].depth + 1);
+        }
+
+        return (int)nodes.size() - 1;
+    }
+
+    bool evaluate(int index, double time, ViewIdx view, ExprValue* ret) const;
+
+    bool evaluateOperator(const ExprNode & node, const ExprValue & a, const ExprValue & b, ExprValue* ret) const;
+
+    bool evaluateFunction(const ExprNode & node, double time, ViewIdx view, ExprValue* ret) const;
+
+    bool evaluateKnob(const ExprNode & node, double time, ViewIdx view, ExprValue* ret) const;
+};
+
+namespace {
+enum ExprTokenTypeEnum
+{
+    eExprTokenTypeNumber = 0,
+    eExprTokenTypeName,
+    eExprTokenTypeOperator,
+    eExprTokenTypeEnd
+};
+
+struct ExprToken
+{
+    ExprTokenTypeEnum type;
+    std::string text;
+    ExprValue number;
+};
+
+bool
+isNameChar(char c,
+           bool first)
+{
+    return ( (c >= 'a') && (c <= 'z') ) || ( (c >= 'A') && (c <= 'Z') ) || (c == '_') || ( !first && (c >= '0') && (c <= '9') );
+}
+
+bool
+isDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+bool
+tokenize(const std::string & expression,
+         std::vector<ExprToken>* tokens)
+{
+    // Longest operators first
+    static const char* operators[] = {
+        "**", "//", "<=", ">=", "==", "!=", "+", "-", "*", "/", "%", "<", ">", "(", ")", ",", ".", 0
+    };
+    std::size_t i = 0;
+
+    while ( i < expression.size() ) {
+        char c = expression[i];
+        if ( (c == ' ') || (c == '\t') || (c == '\r') ) {
+            ++i;
+            continue;
+        }
+
+        ExprToken token;
+        token.number.value = 0.;
+        token.number.isInt = true;
+        if ( isNameChar(c, true) ) {
+            std::size_t start = i;
+            while ( i < expression.size() && isNameChar(expression[i], false) ) {
+                ++i;
+            }
+            token.type = eExprTokenTypeName;
+            token.text = expression.substr(start, i - start);
+        } else if ( isDigit(c) || ( (c == '.') && (i + 1 < expression.size()) && isDigit(expression[i + 1]) ) ) {
+            std::size_t start = i;
+            bool isInt = true;
+            while ( i < expression.size() && isDigit(expression[i]) ) {
+                ++i;
+            }
+            if ( (i < expression.size()) && (expression[i] == '.') ) {
+                isInt = false;
+                ++i;
+                while ( i < expression.size() && isDigit(expression[i]) ) {
+                    ++i;
+                }
+            }
+            if ( (i < expression.size()) && ( (expression[i] == 'e') || (expression[i] == 'E') ) ) {
+                std::size_t exponent = i + 1;
+                if ( (exponent < expression.size()) && ( (expression[exponent] == '+') || (expression[exponent] == '-') ) ) {
+                    ++exponent;
+                }
+                if ( (exponent < expression.size()) && isDigit(expression[exponent]) ) {
+                    isInt = false;
+                    i = exponent;
+                    while ( i < expression.size() && isDigit(expression[i]) ) {
+                        ++i;
+                    }
+                }
+            }
+            // Hexadecimal, octal, complex and long literals are left to Python
+            if ( ( i < expression.size() ) && isNameChar(expression[i], false) ) {
+                return false;
+            }
+            token.type = eExprTokenTypeNumber;
+            token.text = expression.substr(start, i - start);
+            if ( isInt && (token.text.size() > 1) && (token.text[0] == '0') ) {
+                return false;
+            }
+            std::istringstream ss(token.text);
+            ss.imbue( std::locale::classic() );
+            ss >> token.number.value;
+            token.number.isInt = isInt;
+            if ( ss.fail() || !setResult(token.number.value, isInt, &token.number) ) {
+                return false;
+            }
+        } else {
+            const char** op = operators;
+            while ( *op && expression.compare(i, std::strlen(*op), *op) != 0 ) {
+                ++op;
+            }
+            if (!*op) {
+                return false;
+            }
+            token.type = eExprTokenTypeOperator;
+            token.text = *op;
+            i += token.text.size();
+        }
+        tokens->push_back(token);
+    }
+
+    ExprToken end;
+    end.type = eExprTokenTypeEnd;
+    end.number.value = 0.;
+    end.number.isInt = true;
+    tokens->push_back(end);
+
+    return true;
+} // tokenize
+
+/**
+ * @brief Recursive descent parser of the subset of the Python expressions grammar that is compiled.
+ * All functions return false if the expression is not supported.
+ **/
+class ExprParser
+{
+public:
+
+    ExprParser(const std::vector<ExprToken> & tokens,
+               int dimension,
+               const KnobExpressionResolver & resolver,
+               KnobExpressionPrivate* imp)
+        : _tokens(tokens)
+        , _pos(0)
+        , _depth(0)
+        , _dimension(dimension)
+        , _resolver(resolver)
+        , _imp(imp)
+    {
+    }
+
+    bool parse(int* root)
+    {
+        return parseExpression(root) && (_tokens[_pos].type == eExprTokenTypeEnd);
+    }
+
+private:
+
+    bool isToken(const char* text) const
+    {
+        const ExprToken & t = _tokens[_pos];
+
+        return (t.type == eExprTokenTypeOperator || t.type == eExprTokenTypeName) && (t.text == text);
+    }
+
+    bool accept(const char* text)
+    {
+        if ( isToken(text) ) {
+            ++_pos;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    bool addNode(const ExprNode & node, int* index)
+    {
+        *index = _imp->addNode(node);
+
+        return _imp->nodes[*index].depth <= KNOB_EXPRESSION_MAX_DEPTH;
+    }
+
+    bool addOperator(ExprNodeTypeEnum type, ExprOperatorEnum op, int a, int b, int* index)
+    {
+        ExprNode node;
+
+        node.type = type;
+        node.op = op;
+        node.args.push_back(a);
+        if (b != -1) {
+            node.args.push_back(b);
+        }
+
+        return addNode(node, index);
+    }
+
+    bool addConstant(double value, bool isInt, int* index)
+    {
+        ExprNode node;
+
+        node.type = eExprNodeTypeConstant;
+        node.constant.value = value;
+        node.constant.isInt = isInt;
+
+        return addNode(node, index);
+    }
+
+    // expression := or_test ['if' or_test 'else' expression]
+    bool parseExpression(int* index)
+    {
+        if (++_depth > KNOB_EXPRESSION_MAX_DEPTH) {
+            return false;
+        }
+        int value;
+        if ( !parseOr(&value) ) {
+            return false;
+        }
+        if ( accept("if") ) {
+            ExprNode node;
+            node.type = eExprNodeTypeConditional;
+            node.args.resize(3);
+            node.args[1] = value;
+            if ( !parseOr(&node.args[0]) || !accept("else") || !parseExpression(&node.args[2]) ) {
+                return false;
+            }
+            if ( !addNode(node, &value) ) {
+                return false;
+            }
+        }
+        *index = value;
+        --_depth;
+
+        return true;
+    }
+
+    // or_test := and_test ('or' and_test)*
+    bool parseOr(int* index)
+    {
+        if ( !parseAnd(index) ) {
+            return false;
+        }
+        while ( accept("or") ) {
+            int b;
+            if ( !parseAnd(&b) || !addOperator(eExprNodeTypeOr, eExprOperatorAdd, *index, b, index) ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // and_test := not_test ('and' not_test)*
+    bool parseAnd(int* index)
+    {
+        if ( !parseNot(index) ) {
+            return false;
+        }
+        while ( accept("and") ) {
+            int b;
+            if ( !parseNot(&b) || !addOperator(eExprNodeTypeAnd, eExprOperatorAdd, *index, b, index) ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // not_test := 'not' not_test | comparison
+    bool parseNot(int* index)
+    {
+        if ( accept("not") ) {
+            int a;
+            if (++_depth > KNOB_EXPRESSION_MAX_DEPTH) {
+                return false;
+            }
+            if ( !parseNot(&a) ) {
+                return false;
+            }
+            --_depth;
+
+            return addOperator(eExprNodeTypeUnary, eExprOperatorNot, a, -1, index);
+        }
+
+        return parseComparison(index);
+    }
+
+    // comparison := arith [comp_op arith], chained comparisons are left to Python
+    bool parseComparison(int* index)
+    {
+        static const char* ops[] = { "<", "<=", ">", ">=", "==", "!=" };
+        static const ExprOperatorEnum opsEnum[] = {
+            eExprOperatorLess, eExprOperatorLessEqual, eExprOperatorGreater, eExprOperatorGreaterEqual, eExprOperatorEqual, eExprOperatorNotEqual
+        };
+
+        if ( !parseArith(index) ) {
+            return false;
+        }
+        for (int i = 0; i < 6; ++i) {
+            if ( accept(ops[i]) ) {
+                int b;
+                if ( !parseArith(&b) || !addOperator(eExprNodeTypeCompare, opsEnum[i], *index, b, index) ) {
+                    return false;
+                }
+                for (int j = 0; j < 6; ++j) {
+                    if ( isToken(ops[j]) ) {
+                        return false;
+                    }
+                }
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // arith := term (('+'|'-') term)*
+    bool parseArith(int* index)
+    {
+        if ( !parseTerm(index) ) {
+            return false;
+        }
+        for (;;) {
+            ExprOperatorEnum op;
+            if ( accept("+") ) {
+                op = eExprOperatorAdd;
+            } else if ( accept("-") ) {
+                op = eExprOperatorSub;
+            } else {
+                return true;
+            }
+            int b;
+            if ( !parseTerm(&b) || !addOperator(eExprNodeTypeBinary, op, *index, b, index) ) {
+                return false;
+            }
+        }
+    }
+
+    // term := factor (('*'|'/'|'//'|'%') factor)*
+    bool parseTerm(int* index)
+    {
+        if ( !parseFactor(index) ) {
+            return false;
+        }
+        for (;;) {
+            ExprOperatorEnum op;
+            if ( accept("*") ) {
+                op = eExprOperatorMul;
+            } else if ( accept("/") ) {
+                op = eExprOperatorDiv;
+            } else if ( accept("//") ) {
+                op = eExprOperatorFloorDiv;
+            } else if ( accept("%") ) {
+                op = eExprOperatorMod;
+            } else {
+                return true;
+            }
+            int b;
+            if ( !parseFactor(&b) || !addOperator(eExprNodeTypeBinary, op, *index, b, index) ) {
+                return false;
+            }
+        }
+    }
+
+    // factor := ('+'|'-') factor | power
+    bool parseFactor(int* index)
+    {
+        ExprOperatorEnum op;
+
+        if ( accept("-") ) {
+            op = eExprOperatorNeg;
+        } else if ( accept("+") ) {
+            op = eExprOperatorPos;
+        } else {
+            return parsePower(index);
+        }
+        if (++_depth > KNOB_EXPRESSION_MAX_DEPTH) {
+            return false;
+        }
+        int a;
+        if ( !parseFactor(&a) ) {
+            return false;
+        }
+        --_depth;
+
+        return addOperator(eExprNodeTypeUnary, op, a, -1, index);
+    }
+
+    // power := atom ['**' factor]
+    bool parsePower(int* index)
+    {
+        if ( !parseAtom(index) ) {
+            return false;
+        }
+        if ( accept("**") ) {
+            int b;
+            if ( !parseFactor(&b) || !addOperator(eExprNodeTypeBinary, eExprOperatorPow, *index, b, index) ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Parses the comma separated arguments of a call, the opening parenthesis being already read
+    bool parseArguments(std::vector<int>* args)
+    {
+        if ( accept(")") ) {
+            return true;
+        }
+        for (;;) {
+            int arg;
+            if ( !parseExpression(&arg) ) {
+                return false;
+            }
+            args->push_back(arg);
+            if ( accept(")") ) {
+                return true;
+            }
+            if ( !accept(",") ) {
+                return false;
+            }
+        }
+    }
+
+    // atom := number | '(' expression ')' | name | name '(' args ')' | knob '.' method '(' args ')' ['.' attribute]
+    bool parseAtom(int* index)
+    {
+        const ExprToken & token = _tokens[_pos];
+
+        if (token.type == eExprTokenTypeNumber) {
+            ++_pos;
+
+            return addConstant(token.number.value, token.number.isInt, index);
+        }
+        if ( accept("(") ) {
+            return parseExpression(index) && accept(")");
+        }
+        if (token.type != eExprTokenTypeName) {
+            return false;
+        }
+
+        std::vector<std::string> names;
+        names.push_back(token.text);
+        ++_pos;
+        while ( isToken(".") && (_tokens[_pos + 1].type == eExprTokenTypeName) ) {
+            names.push_back(_tokens[_pos + 1].text);
+            _pos += 2;
+        }
+
+        if ( !accept("(") ) {
+            return (names.size() == 1) && parseName(names[0], index);
+        }
+
+        std::vector<int> args;
+        if ( !parseArguments(&args) ) {
+            return false;
+        }
+        std::string method = names.back();
+        names.pop_back();
+        if ( names.empty() ) {
+            if (method == "curve") {
+                // curve is thisParam.curve
+                names.push_back("thisParam");
+            } else {
+                return parseFunction(method, args, index);
+            }
+        }
+
+        return parseKnobAccess(names, method, args, index);
+    }
+
+    bool parseName(const std::string & name,
+                   int* index)
+    {
+        if (name == "True") {
+            return addConstant(1., true, index);
+        } else if (name == "False") {
+            return addConstant(0., true, index);
+        } else if ( _resolver.isNameShadowed(name) ) {
+            return false;
+        } else if (name == "frame") {
+            ExprNode node;
+            node.type = eExprNodeTypeFrame;
+
+            return addNode(node, index);
+        } else if (name == "view") {
+            ExprNode node;
+            node.type = eExprNodeTypeView;
+
+            return addNode(node, index);
+        } else if (name == "dimension") {
+            return addConstant(_dimension, true, index);
+        } else if (name == "pi") {
+            return addConstant(M_PI, false, index);
+        } else if (name == "e") {
+            return addConstant(M_E, false, index);
+        }
+
+        return false;
+    }
+
+    bool parseFunction(const std::string & name,
+                       const std::vector<int> & args,
+                       int* index)
+    {
+        for (std::size_t i = 0; i < sizeof(exprFunctions) / sizeof(exprFunctions[0]); ++i) {
+            const ExprFunction & f = exprFunctions[i];
+            if (name == f.name) {
+                if ( ( (int)args.size() < f.minArgs ) || ( (f.maxArgs != -1) && ( (int)args.size() > f.maxArgs ) ) ||
+                     _resolver.isNameShadowed(name) ) {
+                    return false;
+                }
+                ExprNode node;
+                node.type = eExprNodeTypeFunction;
+                node.op = f.function;
+                node.args = args;
+
+                return addNode(node, index);
+            }
+        }
+
+        return false;
+    }
+
+    bool parseKnobAccess(const std::vector<std::string> & names,
+                         const std::string & method,
+                         const std::vector<int> & args,
+                         int* index)
+    {
+        KnobIPtr knob = _resolver.getKnob(names);
+
+        if (!knob) {
+            return false;
+        }
+
+        // Only the params whose Python methods are known
+        ExprKnob exprKnob;
+        bool hasDimensionArg = true;
+        bool isColor = false;
+        if ( boost::dynamic_pointer_cast<KnobDouble>(knob) || boost::dynamic_pointer_cast<KnobColor>(knob) ) {
+            exprKnob.type = eExprKnobTypeDouble;
+            exprKnob.doubleKnob = boost::dynamic_pointer_cast<KnobDoubleBase>(knob);
+            isColor = (bool)boost::dynamic_pointer_cast<KnobColor>(knob);
+        } else if ( boost::dynamic_pointer_cast<KnobInt>(knob) || boost::dynamic_pointer_cast<KnobChoice>(knob) ) {
+            exprKnob.type = eExprKnobTypeInt;
+            exprKnob.intKnob = boost::dynamic_pointer_cast<KnobIntBase>(knob);
+            hasDimensionArg = !boost::dynamic_pointer_cast<KnobChoice>(knob);
+        } else if ( boost::dynamic_pointer_cast<KnobBool>(knob) ) {
+            exprKnob.type = eExprKnobTypeBool;
+            exprKnob.boolKnob = boost::dynamic_pointer_cast<KnobBoolBase>(knob);
+            hasDimensionArg = false;
+        } else {
+            return false;
+        }
+        exprKnob.checkActivated = names[0] != "thisParam" && names[0] != "thisNode" && names[0] != "thisGroup";
+
+        ExprNode node;
+        node.type = eExprNodeTypeKnob;
+        node.args = args;
+        int nDims = knob->getDimension();
+        int maxArgs;
+        if (method == "getValue") {
+            node.op = eExprKnobAccessGetValue;
+            maxArgs = hasDimensionArg ? 1 : 0;
+        } else if (method == "getValueAtTime") {
+            node.op = eExprKnobAccessGetValueAtTime;
+            if ( args.empty() ) {
+                return false;
+            }
+            maxArgs = hasDimensionArg ? 2 : 1;
+        } else if (method == "get") {
+            node.op = eExprKnobAccessGet;
+            maxArgs = 1;
+            // get() returns a tuple for the multi-dimensional params
+            if ( isColor || (nDims > 1) ) {
+                if ( !accept(".") || (_tokens[_pos].type != eExprTokenTypeName) ) {
+                    return false;
+                }
+                const char* attributes = isColor ? "rgba" : "xyz";
+                const std::string & attribute = _tokens[_pos].text;
+                ++_pos;
+                const char* found = attribute.size() == 1 ? std::strchr(attributes, attribute[0]) : 0;
+                if (!found) {
+                    return false;
+                }
+                node.tupleIndex = (int)(found - attributes);
+                if ( ( node.tupleIndex >= nDims ) || ( isColor && (nDims < 3) ) ) {
+                    return false;
+                }
+            }
+        } else if (method == "curve") {
+            node.op = eExprKnobAccessCurve;
+            if ( args.empty() ) {
+                return false;
+            }
+            maxArgs = 2;
+        } else {
+            return false;
+        }
+        if ( (int)args.size() > maxArgs ) {
+            return false;
+        }
+
+        node.knobIndex = (int)_imp->knobs.size();
+        _imp->knobs.push_back(exprKnob);
+
+        return addNode(node, index);
+    } // parseKnobAccess
+
+    const std::vector<ExprToken> & _tokens;
+    std::size_t _pos;
+    int _depth;
+    int _dimension;
+    const KnobExpressionResolver & _resolver;
+    KnobExpressionPrivate* _imp;
+};
+
+/**
+ * @brief Resolves the names in the scope of the Python function created for the expression by KnobHelper::validateExpression().
+ **/
+class NodeKnobExpressionResolver
+    : public KnobExpressionResolver
+{
+public:
+
+    NodeKnobExpressionResolver(const KnobIPtr & knob,
+                               const NodePtr & node,
+                               const NodeCollectionPtr & collection)
+        : _knob(knob)
+        , _node(node)
+        , _collection(collection)
+    {
+    }
+
+    virtual ~NodeKnobExpressionResolver()
+    {
+    }
+
+    virtual bool isNameShadowed(const std::string & name) const OVERRIDE FINAL
+    {
+        // The siblings are local variables of the expression function
+        if ( getSibling(name) ) {
+            return true;
+        }
+        if ( (name == "frame") || (name == "view") || (name == "dimension") ) {
+            return false;
+        }
+
+        // Otherwise it must not have been redefined in the main module
+        PyObject* globals = PyModule_GetDict( NATRON_PYTHON_NAMESPACE::getMainModule() );
+        PyObject* global = PyDict_GetItemString( globals, name.c_str() ); // borrowed
+        PyObject* mathModule = PyImport_ImportModule("math"); // new ref
+        if (!mathModule) {
+            PyErr_Clear();
+
+            return true;
+        }
+        PyObject* mathAttr = PyObject_GetAttrString( mathModule, name.c_str() ); // new ref
+        Py_DECREF(mathModule);
+        if (!mathAttr) {
+            // A builtin
+            PyErr_Clear();
+
+            return global != 0;
+        }
+        bool shadowed = global != mathAttr;
+        Py_DECREF(mathAttr);
+
+        return shadowed;
+    }
+
+    virtual KnobIPtr getKnob(const std::vector<std::string> & names) const OVERRIDE FINAL
+    {
+        if ( (names.size() == 1) && (names[0] == "thisParam") ) {
+            return _knob;
+        }
+        if (names.size() != 2) {
+            return KnobIPtr();
+        }
+        NodePtr node;
+        if (names[0] == "thisNode") {
+            node = _node;
+        } else if (names[0] == "thisGroup") {
+            NodeGroup* isGroup = dynamic_cast<NodeGroup*>( _collection.get() );
+            if (isGroup) {
+                node = isGroup->getNode();
+            }
+        } else {
+            node = getSibling(names[0]);
+        }
+
+        return node ? node->getKnobByName(names[1]) : KnobIPtr();
+    }
+
+private:
+
+    NodePtr getSibling(const std::string & name) const
+    {
+        NodesList siblings = _collection->getNodes();
+
+        for (NodesList::iterator it = siblings.begin(); it != siblings.end(); ++it) {
+            if ( (*it)->isActivated() && !(*it)->getParentMultiInstance() && ( (*it)->getScriptName_mt_safe() == name ) ) {
+                return *it;
+            }
+        }
+
+        return NodePtr();
+    }
+
+    KnobIPtr _knob;
+    NodePtr _node;
+    NodeCollectionPtr _collection;
+};
+} // anon namespace
+
+bool
+KnobExpressionPrivate::evaluate(int index,
+                                double time,
+                                ViewIdx view,
+                                ExprValue* ret) const
+{
+    const ExprNode & node = nodes[index];
+
+    switch (node.type) {
+    case eExprNodeTypeConstant:
+        *ret = node.constant;
+
+        return true;
+    case eExprNodeTypeFrame:
+        // The frame is passed to Python as printed by a stream: an int for integer frames
+        return setResult(time, time == std::floor(time), ret);
+    case eExprNodeTypeView:
+        return setResult(view.value(), true, ret);
+    case eExprNodeTypeUnary:
+    case eExprNodeTypeBinary:
+    case eExprNodeTypeCompare: {
+        ExprValue a, b;
+        if ( !evaluate(node.args[0], time, view, &a) ) {
+            return false;
+        }
+        if ( (node.args.size() > 1) && !evaluate(node.args[1], time, view, &b) ) {
+            return false;
+        }
+
+        return evaluateOperator(node, a, b, ret);
+    }
+    case eExprNodeTypeAnd:
+    case eExprNodeTypeOr:
+        // Python returns the operand that decided the result
+        if ( !evaluate(node.args[0], time, view, ret) ) {
+            return false;
+        }
+        if ( isTruthy(*ret) == (node.type == eExprNodeTypeOr) ) {
+            return true;
+        }
+
+        return evaluate(node.args[1], time, view, ret);
+    case eExprNodeTypeConditional: {
+        ExprValue cond;
+        if ( !evaluate(node.args[0], time, view, &cond) ) {
+            return false;
+        }
+
+        return evaluate(node.args[isTruthy(cond) ? 1 : 2], time, view, ret);
+    }
+    case eExprNodeTypeFunction:
+
+        return evaluateFunction(node, time, view, ret);
+    case eExprNodeTypeKnob:
+
+        return evaluateKnob(node, time, view, ret);
+    }
+
+    return false;
+} // KnobExpressionPrivate::evaluate
+
+bool
+KnobExpressionPrivate::evaluateOperator(const ExprNode & node,
+                                        const ExprValue & a,
+                                        const ExprValue & b,
+                                        ExprValue* ret) const
+{
+    bool isInt = a.isInt && b.isInt;
+
+    switch ( (ExprOperatorEnum)node.op ) {
+    case eExprOperatorAdd:
+
+        return setResult(a.value + b.value, isInt, ret);
+    case eExprOperatorSub:
+
+        return setResult(a.value - b.value, isInt, ret);
+    case eExprOperatorMul:
+
+        return setResult(a.value * b.value, isInt, ret);
+    case eExprOperatorDiv:
+        if (b.value == 0.) {
+            return false;
+        }
+#if PY_MAJOR_VERSION < 3
+        // Python 2 divides ints with floor division
+        if (isInt) {
+            return setResult(pythonFloorDiv(a.value, b.value), true, ret);
+        }
+#endif
+
+        return setResult(a.value / b.value, false, ret);
+    case eExprOperatorFloorDiv:
+        if (b.value == 0.) {
+            return false;
+        }
+
+        return setResult(pythonFloorDiv(a.value, b.value), isInt, ret);
+    case eExprOperatorMod:
+        if (b.value == 0.) {
+            return false;
+        }
+
+        return setResult(pythonMod(a.value, b.value), isInt, ret);
+    case eExprOperatorPow:
+        if ( (a.value == 0.) && (b.value < 0.) ) {
+            return false;
+        }
+        if ( (a.value < 0.) && ( b.value != std::floor(b.value) ) ) {
+            // A complex number
+            return false;
+        }
+        // An int raised to a negative int is a float
+
+        return setResult(std::pow(a.value, b.value), isInt && b.value >= 0., ret);
+    case eExprOperatorNeg:
+
+        return setResult(-a.value, a.isInt, ret);
+    case eExprOperatorPos:
+
+        return setResult(a.value, a.isInt, ret);
+    case eExprOperatorNot:
+
+        return setResult(isTruthy(a) ? 0. : 1., true, ret);
+    case eExprOperatorLess:
+
+        return setResult(a.value < b.value ? 1. : 0., true, ret);
+    case eExprOperatorLessEqual:
+
+        return setResult(a.value <= b.value ? 1. : 0., true, ret);
+    case eExprOperatorGreater:
+
+        return setResult(a.value > b.value ? 1. : 0., true, ret);
+    case eExprOperatorGreaterEqual:
+
+        return setResult(a.value >= b.value ? 1. : 0., true, ret);
+    case eExprOperatorEqual:
+
+        return setResult(a.value == b.value ? 1. : 0., true, ret);
+    case eExprOperatorNotEqual:
+
+        return setResult(a.value != b.value ? 1. : 0., true, ret);
+    }
+
+    return false;
+} // KnobExpressionPrivate::evaluateOperator
+
+bool
+KnobExpressionPrivate::evaluateFunction(const ExprNode & node,
+                                        double time,
+                                        ViewIdx view,
+                                        ExprValue* ret) const
+{
+    ExprValue args[2];
+    std::size_t nArgs = node.args.size();
+
+    // min and max take any number of arguments, evaluated below
+    if ( (node.op != eExprFunctionMin) && (node.op != eExprFunctionMax) ) {
+        assert(nArgs <= 2);
+        for (std::size_t i = 0; i < nArgs; ++i) {
+            if ( !evaluate(node.args[i], time, view, &args[i]) ) {
+                return false;
+            }
+        }
+    }
+    double x = args[0].value;
+    double y = args[1].value;
+
+    // Python 3 math.floor and math.ceil return ints
+#if PY_MAJOR_VERSION >= 3
+    const bool roundingIsInt = true;
+#else
+    const bool roundingIsInt = false;
+#endif
+
+    switch ( (ExprFunctionEnum)node.op ) {
+    case eExprFunctionAbs:
+
+        return setResult(std::fabs(x), args[0].isInt, ret);
+    case eExprFunctionAcos:
+
+        return setResult(std::acos(x), false, ret);
+    case eExprFunctionAsin:
+
+        return setResult(std::asin(x), false, ret);
+    case eExprFunctionAtan:
+
+        return setResult(std::atan(x), false, ret);
+    case eExprFunctionAtan2:
+
+        return setResult(std::atan2(x, y), false, ret);
+    case eExprFunctionCeil:
+
+        return setResult(std::ceil(x), roundingIsInt, ret);
+    case eExprFunctionCopysign:
+
+        return setResult( ( (y < 0.) || ( (y == 0.) && (1. / y < 0.) ) ) ? -std::fabs(x) : std::fabs(x), false, ret );
+    case eExprFunctionCos:
+
+        return setResult(std::cos(x), false, ret);
+    case eExprFunctionCosh:
+
+        return setResult(std::cosh(x), false, ret);
+    case eExprFunctionDegrees:
+
+        return setResult(x * (180. / M_PI), false, ret);
+    case eExprFunctionExp:
+
+        return setResult(std::exp(x), false, ret);
+    case eExprFunctionFabs:
+
+        return setResult(std::fabs(x), false, ret);
+    case eExprFunctionFloat:
+
+        return setResult(x, false, ret);
+    case eExprFunctionFloor:
+
+        return setResult(std::floor(x), roundingIsInt, ret);
+    case eExprFunctionFmod:
+
+        return setResult(std::fmod(x, y), false, ret);
+    case eExprFunctionHypot:
+
+        return setResult(std::sqrt(x * x + y * y), false, ret);
+    case eExprFunctionInt:
+    case eExprFunctionTrunc:
+
+        return setResult(x < 0. ? std::ceil(x) : std::floor(x), true, ret);
+    case eExprFunctionLog:
+        if (x <= 0.) {
+            return false;
+        }
+        if (nArgs == 2) {
+            return setResult(std::log(x) / std::log(y), false, ret);
+        }
+
+        return setResult(std::log(x), false, ret);
+    case eExprFunctionLog10:
+        if (x <= 0.) {
+            return false;
+        }
+
+        return setResult(std::log10(x), false, ret);
+    case eExprFunctionMax:
+    case eExprFunctionMin: {
+        // Python returns the first of the equal extrema
+        bool isMax = node.op == eExprFunctionMax;
+        for (std::size_t i = 0; i < nArgs; ++i) {
+            ExprValue v;
+            if ( !evaluate(node.args[i], time, view, &v) ) {
+                return false;
+            }
+            if ( (i == 0) || ( isMax ? (v.value > ret->value) : (v.value < ret->value) ) ) {
+                *ret = v;
+            }
+        }
+
+        return true;
+    }
+    case eExprFunctionPow:
+
+        return setResult(std::pow(x, y), false, ret);
+    case eExprFunctionRadians:
+
+        return setResult(x * (M_PI / 180.), false, ret);
+    case eExprFunctionSin:
+
+        return setResult(std::sin(x), false, ret);
+    case eExprFunctionSinh:
+
+        return setResult(std::sinh(x), false, ret);
+    case eExprFunctionSqrt:
+
+        return setResult(std::sqrt(x), false, ret);
+    case eExprFunctionTan:
+
+        return setResult(std::tan(x), false, ret);
+    case eExprFunctionTanh:
+
+        return setResult(std::tanh(x), false, ret);
+    } // switch
+
+    return false;
+} // KnobExpressionPrivate::evaluateFunction
+
+bool
+KnobExpressionPrivate::evaluateKnob(const ExprNode & node,
+                                    double time,
+                                    ViewIdx view,
+                                    ExprValue* ret) const
+{
+    ExprValue args[2];
+
+    for (std::size_t i = 0; i < node.args.size(); ++i) {
+        if ( !evaluate(node.args[i], time, view, &args[i]) ) {
+            return false;
+        }
+    }
+
+    // Arguments: the time comes first, except for getValue()
+    bool hasTime = false;
+    double argTime = 0.;
+    int dimension = node.tupleIndex;
+    const ExprValue* dimensionArg = 0;
+    switch ( (ExprKnobAccessEnum)node.op ) {
+    case eExprKnobAccessGetValue:
+        dimensionArg = node.args.empty() ? 0 : &args[0];
+        break;
+    case eExprKnobAccessGet:
+        hasTime = !node.args.empty();
+        argTime = args[0].value;
+        break;
+    case eExprKnobAccessGetValueAtTime:
+    case eExprKnobAccessCurve:
+        hasTime = true;
+        argTime = args[0].value;
+        dimensionArg = node.args.size() > 1 ? &args[1] : 0;
+        break;
+    }
+    if (dimensionArg) {
+        // Python would not convert a float to an int argument
+        if (!dimensionArg->isInt) {
+            return false;
+        }
+        dimension = (int)dimensionArg->value;
+    }
+
+    const ExprKnob & exprKnob = knobs[node.knobIndex];
+    KnobDoubleBasePtr doubleKnob;
+    KnobIntBasePtr intKnob;
+    KnobBoolBasePtr boolKnob;
+    KnobI* knob = 0;
+    switch (exprKnob.type) {
+    case eExprKnobTypeDouble:
+        doubleKnob = exprKnob.doubleKnob.lock();
+        knob = doubleKnob.get();
+        break;
+    case eExprKnobTypeInt:
+        intKnob = exprKnob.intKnob.lock();
+        knob = intKnob.get();
+        break;
+    case eExprKnobTypeBool:
+        boolKnob = exprKnob.boolKnob.lock();
+        knob = boolKnob.get();
+        break;
+    }
+    if ( !knob || (dimension < 0) || ( dimension >= knob->getDimension() ) ) {
+        return false;
+    }
+    if (exprKnob.checkActivated) {
+        EffectInstance* effect = dynamic_cast<EffectInstance*>( knob->getHolder() );
+        NodePtr effectNode = effect ? effect->getNode() : NodePtr();
+        if ( effect && ( !effectNode || !effectNode->isActivated() ) ) {
+            return false;
+        }
+    }
+
+    if (node.op == eExprKnobAccessCurve) {
+        return setResult(knob->getRawCurveValueAt(argTime, ViewSpec::current(), dimension), false, ret);
+    }
+    if (doubleKnob) {
+        return setResult(hasTime ? doubleKnob->getValueAtTime(argTime, dimension) : doubleKnob->getValue(dimension), false, ret);
+    } else if (intKnob) {
+        return setResult(hasTime ? intKnob->getValueAtTime(argTime, dimension) : intKnob->getValue(dimension), true, ret);
+    } else {
+        bool value = hasTime ? boolKnob->getValueAtTime(argTime, dimension) : boolKnob->getValue(dimension);
+
+        return setResult(value ? 1. : 0., true, ret);
+    }
+} // KnobExpressionPrivate::evaluateKnob
+
+KnobExpression::KnobExpression()
+    : _imp( new KnobExpressionPrivate() )
+{
+}
+
+KnobExpression::~KnobExpression()
+{
+}
+
+KnobExpressionPtr
+KnobExpression::compile(const std::string & expression,
+                        const KnobIPtr & knob,
+                        int dimension)
+{
+    EffectInstance* effect = dynamic_cast<EffectInstance*>( knob->getHolder() );
+    NodePtr node = effect ? effect->getNode() : NodePtr();
+    NodeCollectionPtr collection = node ? node->getGroup() : NodeCollectionPtr();
+
+    if (!collection) {
+        return KnobExpressionPtr();
+    }
+    NodeKnobExpressionResolver resolver(knob, node, collection);
+
+    return compile(expression, dimension, resolver);
+}
+
+KnobExpressionPtr
+KnobExpression::compile(const std::string & expression,
+                        int dimension,
+                        const KnobExpressionResolver & resolver)
+{
+    std::vector<ExprToken> tokens;
+
+    if ( !tokenize(expression, &tokens) ) {
+        return KnobExpressionPtr();
+    }
+
+    KnobExpressionPtr ret( new KnobExpression() );
+    ExprParser parser(tokens, dimension, resolver, ret->_imp.get());
+    if ( !parser.parse(&ret->_imp->root) ) {
+        return KnobExpressionPtr();
+    }
+
+    return ret;
+}
+
+bool
+KnobExpression::evaluate(double time,
+                         ViewIdx view,
+                         double* result,
+                         bool* isInt) const
+{
+    ExprValue value;
+
+    if ( !_imp->evaluate(_imp->root, time, view, &value) ) {
+        return false;
+    }
+    *result = value.value;
+    *isInt = value.isInt;
+
+    return true;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,118 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBEXPRESSION_H
+#define NATRON_ENGINE_KNOBEXPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Resolves the names used in an expression while it is compiled by KnobExpression.
+ **/
+class KnobExpressionResolver
+{
+public:
+
+    KnobExpressionResolver() {}
+
+    virtual ~KnobExpressionResolver() {}
+
+    /**
+     * @brief Returns true if the given name, e.g. frame, sin or abs, does not have its usual meaning
+     * in the Python scope of the expression, e.g. because a node has this script-name.
+     **/
+    virtual bool isNameShadowed(const std::string & name) const = 0;
+
+    /**
+     * @brief Returns the knob designated by the given attribute names, e.g. ["thisParam"] or ["Blur1", "size"],
+     * or NULL if there is none.
+     **/
+    virtual KnobIPtr getKnob(const std::vector<std::string> & names) const = 0;
+};
+
+struct KnobExpressionPrivate;
+
+/**
+ * @brief A knob expression compiled natively so that it can be evaluated from any thread without taking the Python GIL.
+ *
+ * Only single-line expressions made of the following are compiled, anything else must be evaluated by Python:
+ * - int and float literals, True, False, pi, e, frame, view and dimension
+ * - the arithmetic, comparison and boolean operators, parenthesis and conditional expressions (a if cond else b)
+ * - the functions of the math module that return a number and abs, min, max, int, float
+ * - param.getValue(), param.getValueAtTime(), param.get(), param.get().x and param.curve() on Int, Double, Color,
+ * Choice and Boolean params designated by thisParam, thisNode.<param>, thisGroup.<param> and <sibling>.<param>
+ * - curve(time[, dimension])
+ *
+ * The expression gives the same result as its evaluation by Python: Python int and float semantics are preserved.
+ * When Python would raise an exception (division by zero, math domain error, overflow...) the evaluation fails and the
+ * expression must be evaluated by Python to report the error.
+ **/
+class KnobExpression
+{
+    KnobExpression();
+
+public:
+
+    ~KnobExpression();
+
+    /**
+     * @brief Compiles the expression of the given dimension of the knob, resolving names in the scope of
+     * its node. Returns NULL if the expression cannot be compiled natively.
+     * This must be called with the Python GIL held.
+     **/
+    static KnobExpressionPtr compile(const std::string & expression, const KnobIPtr & knob, int dimension);
+
+    /**
+     * @brief Same as above, with the given names resolution.
+     **/
+    static KnobExpressionPtr compile(const std::string & expression, int dimension, const KnobExpressionResolver & resolver);
+
+    /**
+     * @brief Evaluates the expression at the given frame and view. isInt is set to true if the Python result
+     * would have been an int or a bool.
+     * Returns false if the expression could not be evaluated natively: it must be evaluated by Python.
+     * This is thread-safe and does not take the Python GIL.
+     **/
+    bool evaluate(double time, ViewIdx view, double* result, bool* isInt) const;
+
+private:
+
+    boost::scoped_ptr<KnobExpressionPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBEXPRESSION_H
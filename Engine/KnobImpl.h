@@ -30,6 +30,7 @@
 #include "Knob.h"
 
 #include <cfloat>
+#include <climits>
 #include <stdexcept>
 #include <string>
 #include <algorithm> // min, max
@@ -56,6 +57,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/Project.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/KnobsSnapshot.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/EngineFwd.h"
 
@@ -419,6 +421,53 @@ Knob<T>::evaluateExpression(const std::string& expr,
     return true;
 }
 
+template <typename T>
+bool
+Knob<T>::evaluateCompiledExpression(double time,
+                                    ViewIdx view,
+                                    int dimension,
+                                    T* value) const
+{
+    double ret;
+    bool isInt;
+
+    if ( !executeCompiledExpression(time, view, dimension, &ret, &isInt) ) {
+        return false;
+    }
+    *value = (T)ret;
+
+    return true;
+}
+
+template <>
+bool
+KnobIntBase::evaluateCompiledExpression(double time,
+                                        ViewIdx view,
+                                        int dimension,
+                                        int* value) const
+{
+    double ret;
+    bool isInt;
+
+    if ( !executeCompiledExpression(time, view, dimension, &ret, &isInt) || (ret < INT_MIN) || (ret > INT_MAX) ) {
+        return false;
+    }
+    *value = (int)ret;
+
+    return true;
+}
+
+template <>
+bool
+KnobStringBase::evaluateCompiledExpression(double /*time*/,
+                                           ViewIdx /*view*/,
+                                           int /*dimension*/,
+                                           std::string* /*value*/) const
+{
+    // String expressions are never compiled
+    return false;
+}
+
 template <typename T>
 bool
 Knob<T>::evaluateExpression(double time,
@@ -427,6 +476,10 @@ Knob<T>::evaluateExpression(double time,
                             T* value,
                             std::string* error)
 {
+    if ( evaluateCompiledExpression(time, view, dimension, value) ) {
+        return true;
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -449,6 +502,19 @@ Knob<T>::evaluateExpression_pod(double time,
                                 double* value,
                                 std::string* error)
 {
+    bool isInt;
+    if ( executeCompiledExpression(time, view, dimension, value, &isInt) ) {
+        if (!isInt) {
+            return true;
+        }
+        // Python ints are converted to C ints below
+        if ( (*value >= INT_MIN) && (*value <= INT_MAX) ) {
+            *value = (int)*value;
+
+            return true;
+        }
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -712,6 +778,12 @@ Knob<T>::getValue(int dimension,
     if ( ( dimension >= (int)_values.size() ) || (dimension < 0) ) {
         return T();
     }
+    if (!useGuiValues) {
+        T ret;
+        if ( getValueFromKnobsSnapshot(0., /*atCurrentTime*/ true, dimension, clamp, &ret) ) {
+            return ret;
+        }
+    }
     std::string hasExpr = getExpression(dimension);
     if ( !hasExpr.empty() ) {
         T ret;
@@ -818,6 +890,75 @@ KnobStringBase::getValueFromCurve(double time,
     return false;
 }
 
+template <typename T>
+bool
+Knob<T>::getValueFromKnobsSnapshot(double time,
+                                   bool atCurrentTime,
+                                   int dimension,
+                                   bool clamp,
+                                   T* ret)
+{
+    KnobsSnapshotPtr snapshot = getKnobsSnapshotTLS();
+
+    if (!snapshot) {
+        return false;
+    }
+    const KnobsSnapshot::DimensionValue* value = snapshot->getDimensionValue(this, dimension);
+    if (!value) {
+        return false;
+    }
+    if (value->curve && atCurrentTime) {
+        time = getCurrentTime();
+    }
+    *ret = (T)value->getValueAt(time, clamp);
+
+    return true;
+}
+
+template <>
+bool
+KnobStringBase::getValueFromKnobsSnapshot(double /*time*/,
+                                          bool /*atCurrentTime*/,
+                                          int /*dimension*/,
+                                          bool /*clamp*/,
+                                          std::string* /*ret*/)
+{
+    // String knobs are not captured, @see addToKnobsSnapshot
+    return false;
+}
+
+template <typename T>
+void
+Knob<T>::addToKnobsSnapshot(KnobsSnapshot* snapshot)
+{
+    for (int i = 0; i < (int)_values.size(); ++i) {
+        if ( !getExpression(i).empty() || getMaster(i).second ) {
+            continue;
+        }
+        KnobsSnapshot::DimensionValue value;
+        CurvePtr curve = getCurve(ViewIdx(0), i, true);
+        if (curve) {
+            value.curve = curve->makeDetachedCopy();
+            if (value.curve->getKeyFramesCount() == 0) {
+                value.curve.reset();
+            }
+        }
+        {
+            QMutexLocker l(&_valueMutex);
+            value.value = (double)_values[i];
+            value.clampedValue = (double)clampToMinMax(_values[i], i);
+        }
+        snapshot->addDimensionValue(this, i, value);
+    }
+}
+
+template <>
+void
+KnobStringBase::addToKnobsSnapshot(KnobsSnapshot* /*snapshot*/)
+{
+    // Strings cannot be held in the snapshot: they are always read from the knob
+}
+
 template<typename T>
 T
 Knob<T>::getValueAtTime(double time,
@@ -832,6 +973,12 @@ Knob<T>::getValueAtTime(double time,
     }
 
     bool useGuiValues = QThread::currentThread() == qApp->thread();
+    if (!useGuiValues) {
+        T ret;
+        if ( getValueFromKnobsSnapshot(time, /*atCurrentTime*/ false, dimension, clamp, &ret) ) {
+            return ret;
+        }
+    }
     std::string hasExpr = getExpression(dimension);
     if ( !hasExpr.empty() ) {
         T ret;
@@ -2649,14 +2796,17 @@ Knob<T>::cloneValues(KnobI* other,
     KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase* >(other);
     assert(isInt || isBool || isDouble);
 
-    QMutexLocker k(&_valueMutex);
-    if (isInt) {
-        copyValueForType<int>(isInt, dimension, otherDimension);
-    } else if (isBool) {
-        copyValueForType<bool>(isBool, dimension, otherDimension);
-    } else if (isDouble) {
-        copyValueForType<double>(isDouble, dimension, otherDimension);
+    {
+        QMutexLocker k(&_valueMutex);
+        if (isInt) {
+            copyValueForType<int>(isInt, dimension, otherDimension);
+        } else if (isBool) {
+            copyValueForType<bool>(isBool, dimension, otherDimension);
+        } else if (isDouble) {
+            copyValueForType<double>(isDouble, dimension, otherDimension);
+        }
     }
+    invalidateHolderKnobsSnapshot();
 }
 
 template<>
@@ -2687,16 +2837,22 @@ Knob<T>::cloneValuesAndCheckIfChanged(KnobI* other,
     KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase* >(other);
     assert(isInt || isBool || isDouble);
 
-    QMutexLocker k(&_valueMutex);
-    if (isInt) {
-        return copyValueForTypeAndCheckIfChanged<int>(isInt, dimension, otherDimension);
-    } else if (isBool) {
-        return copyValueForTypeAndCheckIfChanged<bool>(isBool, dimension, otherDimension);
-    } else if (isDouble) {
-        return copyValueForTypeAndCheckIfChanged<double>(isDouble, dimension, otherDimension);
+    bool hasChanged = false;
+    {
+        QMutexLocker k(&_valueMutex);
+        if (isInt) {
+            hasChanged = copyValueForTypeAndCheckIfChanged<int>(isInt, dimension, otherDimension);
+        } else if (isBool) {
+            hasChanged = copyValueForTypeAndCheckIfChanged<bool>(isBool, dimension, otherDimension);
+        } else if (isDouble) {
+            hasChanged = copyValueForTypeAndCheckIfChanged<double>(isDouble, dimension, otherDimension);
+        }
+    }
+    if (hasChanged) {
+        invalidateHolderKnobsSnapshot();
     }
 
-    return false;
+    return hasChanged;
 }
 
 template <typename T>
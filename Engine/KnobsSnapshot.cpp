@@ -0,0 +1,96 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobsSnapshot.h"
+
+#include "Engine/Curve.h"
+#include "Engine/Knob.h"
+
+NATRON_NAMESPACE_ENTER
+
+double
+KnobsSnapshot::DimensionValue::getValueAt(double time,
+                                          bool clamp) const
+{
+    if (curve) {
+        return curve->getValueAtUnlocked(time, clamp);
+    }
+
+    return clamp ? clampedValue : value;
+}
+
+KnobsSnapshot::KnobsSnapshot()
+    : _knobs()
+    , _values()
+    , _snapshotReads()
+    , _lockedReads()
+{
+}
+
+KnobsSnapshot::~KnobsSnapshot()
+{
+}
+
+void
+KnobsSnapshot::captureKnobs(const KnobsVec& knobs)
+{
+    _knobs = knobs;
+    for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+        (*it)->addToKnobsSnapshot(this);
+    }
+}
+
+void
+KnobsSnapshot::addDimensionValue(const KnobI* knob,
+                                 int dimension,
+                                 const DimensionValue& value)
+{
+    _values[std::make_pair(knob, dimension)] = value;
+}
+
+const KnobsSnapshot::DimensionValue*
+KnobsSnapshot::getDimensionValue(const KnobI* knob,
+                                 int dimension) const
+{
+    DimensionValuesMap::const_iterator found = _values.find( std::make_pair(knob, dimension) );
+
+    if ( found == _values.end() ) {
+        _lockedReads.ref();
+
+        return 0;
+    }
+    _snapshotReads.ref();
+
+    return &found->second;
+}
+
+void
+KnobsSnapshot::takeReadsCount(int* snapshotReads,
+                              int* lockedReads) const
+{
+    *snapshotReads = _snapshotReads.fetchAndStoreRelaxed(0);
+    *lockedReads = _lockedReads.fetchAndStoreRelaxed(0);
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,117 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBSSNAPSHOT_H
+#define NATRON_ENGINE_KNOBSSNAPSHOT_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <QtCore/QAtomicInt>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief An immutable copy of the values and animation curves of the int, bool and double knobs of an effect,
+ * captured when a render of the effect starts and attached to its ParallelRenderArgs.
+ * Render threads read the knobs values from the snapshot without locking the knobs, while the user may still edit them.
+ *
+ * Only the dimensions that are neither driven by an expression nor slaved to another knob are captured:
+ * the others are read from the knob itself.
+ **/
+class KnobsSnapshot
+{
+public:
+
+    struct DimensionValue
+    {
+        double value;
+        double clampedValue;
+
+        // A detached copy of the curve of the dimension, or NULL if it is not animated
+        CurvePtr curve;
+
+        DimensionValue()
+            : value(0.)
+            , clampedValue(0.)
+            , curve()
+        {
+        }
+
+        /**
+         * @brief Returns the value of the dimension at the given time, which is ignored if it is not animated.
+         **/
+        double getValueAt(double time, bool clamp) const WARN_UNUSED_RETURN;
+    };
+
+    KnobsSnapshot();
+
+    ~KnobsSnapshot();
+
+    /**
+     * @brief Captures the given knobs. This is called once, before the snapshot is shared with render threads.
+     **/
+    void captureKnobs(const KnobsVec& knobs);
+
+    /**
+     * @brief Called by the knobs from captureKnobs() to add the value of one of their dimensions.
+     **/
+    void addDimensionValue(const KnobI* knob, int dimension, const DimensionValue& value);
+
+    /**
+     * @brief Returns the value of the given dimension of the knob, or NULL if it was not captured,
+     * in which case the value must be read from the knob.
+     * This is thread-safe and lock-free.
+     **/
+    const DimensionValue* getDimensionValue(const KnobI* knob, int dimension) const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Returns the number of reads served by the snapshot and of reads that had to lock the knob
+     * since the last call, and resets them.
+     **/
+    void takeReadsCount(int* snapshotReads, int* lockedReads) const;
+
+private:
+
+    typedef std::map<std::pair<const KnobI*, int>, DimensionValue> DimensionValuesMap;
+
+    // The knobs are held so that the address of a knob deleted while the snapshot is used cannot be reused
+    KnobsVec _knobs;
+    DimensionValuesMap _values;
+    mutable QAtomicInt _snapshotReads;
+    mutable QAtomicInt _lockedReads;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBSSNAPSHOT_H
@@ -27,10 +27,25 @@
 #include <cstring> // for std::memcpy
 #include <algorithm> // min, max
 #include <cassert>
+#include <limits>
 #include <stdexcept>
 
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
+CLANG_DIAG_ON(deprecated)
+
+#include "Engine/InstructionSet.h"
 #include "Engine/RectI.h"
 
+#ifdef NATRON_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Minimum number of pixels converted by each thread in the packed float conversions
+#define NATRON_LUT_MIN_PIXELS_PER_THREAD 0x10000
+
 /*
  * The to_byte* and from_byte* functions implement and generalize the algorithm
  * described in:
@@ -128,6 +143,228 @@ index_to_float(const unsigned short i)
     return tmp.f;
 }
 
+namespace {
+// keeps the interpolation finite (NaNs are kept)
+inline float
+clampInfinity(float v)
+{
+    if ( v > std::numeric_limits<float>::max() ) {
+        return std::numeric_limits<float>::max();
+    } else if ( v < -std::numeric_limits<float>::max() ) {
+        return -std::numeric_limits<float>::max();
+    }
+
+    return v;
+}
+
+// The toFunc float table has 2^16 + 1 entries: the value at hipart i is toFunc at the float
+// whose bits are i << 16. Between two consecutive hiparts the float is linear in its 16 low bits
+// (the exponent does not change, and the next hipart is exactly the end of the interval),
+// so the function is interpolated linearly with them. The relative step is 2^-7, which suits
+// the power and log functions used to encode linear values.
+// Infinities and NaNs use the exact function.
+inline float
+interpolateHipart(const float* table,
+                  toColorSpaceFunctionV1 func,
+                  float v)
+{
+    uint32_t bits;
+
+    std::memcpy( &bits, &v, sizeof(float) );
+    if ( (bits & 0x7f800000) == 0x7f800000 ) {
+        return func(v);
+    }
+    uint32_t hi = bits >> 16;
+    float t = (float)(int)(bits & 0xffff) * (1.f / 65536.f);
+    float y0 = table[hi];
+
+    return y0 + t * (table[hi + 1] - y0);
+}
+
+void
+interpolateHipart_scalar(const float* table,
+                         toColorSpaceFunctionV1 func,
+                         const float* from,
+                         float* to,
+                         int W)
+{
+    for (int i = 0; i < W; ++i) {
+        to[i] = interpolateHipart(table, func, from[i]);
+    }
+}
+
+// The fromFunc float table samples fromFunc uniformly on [-1,2]: the exponential functions used to
+// decode log values need a uniform precision. Values out of this range use the exact function.
+#define NATRON_LUT_UNIFORM_OFFSET 1.f
+#define NATRON_LUT_UNIFORM_SCALE 32768.f
+#define NATRON_LUT_UNIFORM_COUNT 0x18000 // 3 * 32768 intervals
+
+inline float
+interpolateUniform(const float* table,
+                   fromColorSpaceFunctionV1 func,
+                   float v)
+{
+    float x = (v + NATRON_LUT_UNIFORM_OFFSET) * NATRON_LUT_UNIFORM_SCALE;
+
+    // also false for NaN
+    if ( !( (x >= 0.f) && (x < (float)NATRON_LUT_UNIFORM_COUNT) ) ) {
+        return func(v);
+    }
+    int i = (int)x;
+    float t = x - (float)i;
+    float y0 = table[i];
+
+    return y0 + t * (table[i + 1] - y0);
+}
+
+void
+interpolateUniform_scalar(const float* table,
+                          fromColorSpaceFunctionV1 func,
+                          const float* from,
+                          float* to,
+                          int W)
+{
+    for (int i = 0; i < W; ++i) {
+        to[i] = interpolateUniform(table, func, from[i]);
+    }
+}
+
+#ifdef NATRON_KERNELS_X86
+// same operations as interpolateHipart, 8 values at a time
+NATRON_TARGET_AVX2
+void
+interpolateHipart_avx2(const float* table,
+                       toColorSpaceFunctionV1 func,
+                       const float* from,
+                       float* to,
+                       int W)
+{
+    const __m256i expMask = _mm256_set1_epi32(0x7f800000);
+    const __m256i loMask = _mm256_set1_epi32(0xffff);
+    const __m256 loScale = _mm256_set1_ps(1.f / 65536.f);
+    int i = 0;
+
+    for (; i + 8 <= W; i += 8) {
+        __m256i bits = _mm256_castps_si256( _mm256_loadu_ps(from + i) );
+        if ( !_mm256_testz_si256( _mm256_cmpeq_epi32(_mm256_and_si256(bits, expMask), expMask), _mm256_set1_epi32(-1) ) ) {
+            interpolateHipart_scalar(table, func, from + i, to + i, 8);
+            continue;
+        }
+        __m256i hi = _mm256_srli_epi32(bits, 16);
+        __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps( _mm256_and_si256(bits, loMask) ), loScale);
+        __m256 y0 = _mm256_i32gather_ps(table, hi, 4);
+        __m256 y1 = _mm256_i32gather_ps(table + 1, hi, 4);
+        _mm256_storeu_ps( to + i, _mm256_add_ps( y0, _mm256_mul_ps( t, _mm256_sub_ps(y1, y0) ) ) );
+    }
+    interpolateHipart_scalar(table, func, from + i, to + i, W - i);
+}
+
+// same operations as interpolateUniform, 8 values at a time
+NATRON_TARGET_AVX2
+void
+interpolateUniform_avx2(const float* table,
+                        fromColorSpaceFunctionV1 func,
+                        const float* from,
+                        float* to,
+                        int W)
+{
+    const __m256 offset = _mm256_set1_ps(NATRON_LUT_UNIFORM_OFFSET);
+    const __m256 scale = _mm256_set1_ps(NATRON_LUT_UNIFORM_SCALE);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 count = _mm256_set1_ps( (float)NATRON_LUT_UNIFORM_COUNT );
+    int i = 0;
+
+    for (; i + 8 <= W; i += 8) {
+        __m256 x = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(from + i), offset), scale);
+        __m256 inRange = _mm256_and_ps( _mm256_cmp_ps(x, zero, _CMP_GE_OQ), _mm256_cmp_ps(x, count, _CMP_LT_OQ) );
+        if (_mm256_movemask_ps(inRange) != 0xff) {
+            interpolateUniform_scalar(table, func, from + i, to + i, 8);
+            continue;
+        }
+        __m256i index = _mm256_cvttps_epi32(x);
+        __m256 t = _mm256_sub_ps( x, _mm256_cvtepi32_ps(index) );
+        __m256 y0 = _mm256_i32gather_ps(table, index, 4);
+        __m256 y1 = _mm256_i32gather_ps(table + 1, index, 4);
+        _mm256_storeu_ps( to + i, _mm256_add_ps( y0, _mm256_mul_ps( t, _mm256_sub_ps(y1, y0) ) ) );
+    }
+    interpolateUniform_scalar(table, func, from + i, to + i, W - i);
+}
+
+#endif // NATRON_KERNELS_X86
+
+// Converts a sub-rectangle of a packed image, used with QtConcurrent::blockingMap
+class PackedFloatConversion
+{
+public:
+    typedef void result_type;
+    typedef void (Lut::*RectConversion)(float*, const float*, const RectI &, const RectI &, const RectI &,
+                                        PixelPackingEnum, PixelPackingEnum, bool, bool) const;
+
+    PackedFloatConversion(const Lut* lut,
+                          RectConversion convert,
+                          float* to,
+                          const float* from,
+                          const RectI & srcBounds,
+                          const RectI & dstBounds,
+                          PixelPackingEnum inputPacking,
+                          PixelPackingEnum outputPacking,
+                          bool invertY,
+                          bool premult)
+        : _lut(lut)
+        , _convert(convert)
+        , _to(to)
+        , _from(from)
+        , _srcBounds(srcBounds)
+        , _dstBounds(dstBounds)
+        , _inputPacking(inputPacking)
+        , _outputPacking(outputPacking)
+        , _invertY(invertY)
+        , _premult(premult)
+    {
+    }
+
+    void operator()(const RectI & rect) const
+    {
+        (_lut->*_convert)(_to, _from, rect, _srcBounds, _dstBounds, _inputPacking, _outputPacking, _invertY, _premult);
+    }
+
+private:
+    const Lut* _lut;
+    RectConversion _convert;
+    float* _to;
+    const float* _from;
+    RectI _srcBounds;
+    RectI _dstBounds;
+    PixelPackingEnum _inputPacking;
+    PixelPackingEnum _outputPacking;
+    bool _invertY;
+    bool _premult;
+};
+
+// Runs the conversion on horizontal bands of rect in the global thread pool if rect is large enough
+// and the pool is not already busy, or in the current thread otherwise.
+void
+convertPackedFloatRect(const PackedFloatConversion & conversion,
+                       const RectI & rect)
+{
+    int nThreads = std::min<U64>( QThread::idealThreadCount(), rect.area() / NATRON_LUT_MIN_PIXELS_PER_THREAD );
+
+    nThreads = std::min( nThreads, rect.height() );
+    QThreadPool* pool = QThreadPool::globalInstance();
+    if ( (nThreads <= 1) || ( pool->activeThreadCount() >= pool->maxThreadCount() ) ) {
+        conversion(rect);
+
+        return;
+    }
+    std::vector<RectI> bands(nThreads);
+    for (int i = 0; i < nThreads; ++i) {
+        bands[i] = RectI( rect.x1, rect.y1 + (int)( (U64)rect.height() * i / nThreads ),
+                          rect.x2, rect.y1 + (int)( (U64)rect.height() * (i + 1) / nThreads ) );
+    }
+    QtConcurrent::blockingMap(bands, conversion);
+}
+} // anon namespace
+
 ///initialize the singleton
 LutManager LutManager::m_instance = LutManager();
 LutManager::LutManager()
@@ -344,6 +581,28 @@ Lut::fillTables() const
     }
 }
 
+void
+Lut::fillFloatTables() const
+{
+    toFunc_hipart_to_float.resize(0x10001);
+    for (int i = 0; i < 0x10000; ++i) {
+        uint32_t bits = (uint32_t)i << 16;
+        float inp;
+        std::memcpy( &inp, &bits, sizeof(float) );
+        // infinities and NaNs are not interpolated, but their hipart may end the previous interval
+        if ( ( (bits & 0x7f800000) == 0x7f800000 ) ) {
+            inp = (bits & 0x80000000) ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max();
+        }
+        toFunc_hipart_to_float[i] = clampInfinity( _toFunc(inp) );
+    }
+    toFunc_hipart_to_float[0x10000] = toFunc_hipart_to_float[0xffff];
+
+    fromFunc_uniform_to_float.resize(NATRON_LUT_UNIFORM_COUNT + 1);
+    for (int i = 0; i <= NATRON_LUT_UNIFORM_COUNT; ++i) {
+        fromFunc_uniform_to_float[i] = clampInfinity( _fromFunc(i / NATRON_LUT_UNIFORM_SCALE - NATRON_LUT_UNIFORM_OFFSET) );
+    }
+}
+
 #ifdef DEAD_CODE
 void
 Lut::to_byte_planar(unsigned char* to,
@@ -432,6 +691,22 @@ Lut::to_float_planar(float* to,
     }
 }
 
+void
+Lut::to_float_batch(float* to,
+                    const float* from,
+                    int W) const
+{
+    validateFloatTables();
+#ifdef NATRON_KERNELS_X86
+    if (getInstructionSet() >= eInstructionSetAVX2) {
+        interpolateHipart_avx2(&toFunc_hipart_to_float[0], _toFunc, from, to, W);
+
+        return;
+    }
+#endif
+    interpolateHipart_scalar(&toFunc_hipart_to_float[0], _toFunc, from, to, W);
+}
+
 void
 Lut::to_byte_packed(unsigned char* to,
                     const float* from,
@@ -551,6 +826,23 @@ Lut::to_float_packed(float* to,
         return;
     }
 
+    validate();
+    validateFloatTables();
+
+    convertPackedFloatRect(PackedFloatConversion(this, &Lut::to_float_packed_rect, to, from, srcBounds, dstBounds, inputPacking, outputPacking, invertY, premult), rect);
+}
+
+void
+Lut::to_float_packed_rect(float* to,
+                          const float* from,
+                          const RectI & rect,
+                          const RectI & srcBounds,
+                          const RectI & dstBounds,
+                          PixelPackingEnum inputPacking,
+                          PixelPackingEnum outputPacking,
+                          bool invertY,
+                          bool premult) const
+{
     bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
     bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
     int inROffset, inGOffset, inBOffset, inAOffset;
@@ -562,7 +854,8 @@ Lut::to_float_packed(float* to,
     inPackingSize = inputHasAlpha ? 4 : 3;
     outPackingSize = outputHasAlpha ? 4 : 3;
 
-    validate();
+    // premultiplied RGB of a scan-line, converted in a single batch
+    std::vector<float> rgb( (rect.x2 - rect.x1) * 3 );
 
     for (int y = rect.y1; y < rect.y2; ++y) {
         int srcY = y;
@@ -573,17 +866,24 @@ Lut::to_float_packed(float* to,
         int dstY = dstBounds.y2 - y - 1;
         const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
         float *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1, i = 0; x < rect.x2; ++x, i += 3) {
+            int inCol = x * inPackingSize;
+            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
+            rgb[i] = src_pixels[inCol + inROffset] * a;
+            rgb[i + 1] = src_pixels[inCol + inGOffset] * a;
+            rgb[i + 2] = src_pixels[inCol + inBOffset] * a;
+        }
+        to_float_batch( &rgb[0], &rgb[0], (int)rgb.size() );
         /* go fowards from starting point to end of line: */
-        for (int x = rect.x1; x < rect.x2; ++x) {
+        for (int x = rect.x1, i = 0; x < rect.x2; ++x, i += 3) {
             int inCol = x * inPackingSize;
             int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;;
-            dst_pixels[outCol + outROffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inROffset] * a);
-            dst_pixels[outCol + outGOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inGOffset] * a);
-            dst_pixels[outCol + outBOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inBOffset] * a);
+            dst_pixels[outCol + outROffset] = rgb[i];
+            dst_pixels[outCol + outGOffset] = rgb[i + 1];
+            dst_pixels[outCol + outBOffset] = rgb[i + 2];
             if (outputHasAlpha) {
                 // alpha is linear and should not be dithered
-                dst_pixels[outCol + outAOffset] = a;
+                dst_pixels[outCol + outAOffset] = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
             }
         }
     }
@@ -641,6 +941,22 @@ Lut::from_float_planar(float* to,
     }
 }
 
+void
+Lut::from_float_batch(float* to,
+                      const float* from,
+                      int W) const
+{
+    validateFloatTables();
+#ifdef NATRON_KERNELS_X86
+    if (getInstructionSet() >= eInstructionSetAVX2) {
+        interpolateUniform_avx2(&fromFunc_uniform_to_float[0], _fromFunc, from, to, W);
+
+        return;
+    }
+#endif
+    interpolateUniform_scalar(&fromFunc_uniform_to_float[0], _fromFunc, from, to, W);
+}
+
 void
 Lut::from_byte_packed(float* to,
                       const unsigned char* from,
@@ -756,7 +1072,23 @@ Lut::from_float_packed(float* to,
         return;
     }
 
+    validate();
+    validateFloatTables();
 
+    convertPackedFloatRect(PackedFloatConversion(this, &Lut::from_float_packed_rect, to, from, srcBounds, dstBounds, inputPacking, outputPacking, invertY, premult), rect);
+} // from_float_packed
+
+void
+Lut::from_float_packed_rect(float* to,
+                            const float* from,
+                            const RectI & rect,
+                            const RectI & srcBounds,
+                            const RectI & dstBounds,
+                            PixelPackingEnum inputPacking,
+                            PixelPackingEnum outputPacking,
+                            bool invertY,
+                            bool premult) const
+{
     bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
     bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
     int inROffset, inGOffset, inBOffset, inAOffset;
@@ -768,7 +1100,8 @@ Lut::from_float_packed(float* to,
     inPackingSize = inputHasAlpha ? 4 : 3;
     outPackingSize = outputHasAlpha ? 4 : 3;
 
-    validate();
+    // unpremultiplied RGB of a scan-line, converted in a single batch
+    std::vector<float> rgb( (rect.x2 - rect.x1) * 3 );
 
     for (int y = rect.y1; y < rect.y2; ++y) {
         int srcY = y;
@@ -777,26 +1110,34 @@ Lut::from_float_packed(float* to,
         }
         const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
         float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        for (int x = rect.x1; x < rect.x2; ++x) {
+        for (int x = rect.x1, i = 0; x < rect.x2; ++x, i += 3) {
             int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;;
+            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
             float rf = 0., gf = 0., bf = 0.;
             if (a > 0.) {
                 rf = src_pixels[inCol + inROffset] / a;
                 gf = src_pixels[inCol + inGOffset] / a;
                 bf = src_pixels[inCol + inBOffset] / a;
             }
-            dst_pixels[outCol + outROffset] = fromColorSpaceFloatToLinearFloat(rf) * a;
-            dst_pixels[outCol + outGOffset] = fromColorSpaceFloatToLinearFloat(gf) * a;
-            dst_pixels[outCol + outBOffset] = fromColorSpaceFloatToLinearFloat(bf) * a;
+            rgb[i] = rf;
+            rgb[i + 1] = gf;
+            rgb[i + 2] = bf;
+        }
+        from_float_batch( &rgb[0], &rgb[0], (int)rgb.size() );
+        for (int x = rect.x1, i = 0; x < rect.x2; ++x, i += 3) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
+            dst_pixels[outCol + outROffset] = rgb[i] * a;
+            dst_pixels[outCol + outGOffset] = rgb[i + 1] * a;
+            dst_pixels[outCol + outBOffset] = rgb[i + 2] * a;
             if (outputHasAlpha) {
                 // alpha is linear
                 dst_pixels[outCol + outAOffset] = a;
             }
         }
     }
-} // from_float_packed
+}
 
 ///////////////////////
 /////////////////////////////////////////// LINEAR //////////////////////////////////////////////
@@ -35,8 +35,10 @@
 #include <cmath>
 #include <map>
 #include <string>
+#include <vector>
 
 CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
 CLANG_DIAG_ON(deprecated)
 
@@ -140,7 +142,11 @@ class Lut
     mutable unsigned short toFunc_hipart_to_uint8xx[0x10000];         /// contains  2^16 = 65536 values between 0-255
     mutable float fromFunc_uint8_to_float[256];         /// values between 0-1.f
     mutable bool init_;         ///< false if the tables are not yet initialized
-    mutable QMutex _lock;         ///< protects init_
+    /// the interpolated float tables used by the batch conversions are only allocated when they are used
+    mutable std::vector<float> fromFunc_uniform_to_float;         /// contains 3 * 2^15 + 1 values, fromFunc on [-1,2]
+    mutable std::vector<float> toFunc_hipart_to_float;         /// contains 2^16 + 1 values, toFunc at each hipart
+    mutable QAtomicInt initFloat_;         ///< 0 if the float tables are not yet initialized, read without locking
+    mutable QMutex _lock;         ///< protects init_ and the initialization of the float tables
 
     friend class LutManager;
     ///private constructor, used by LutManager
@@ -151,6 +157,9 @@ class Lut
         , _fromFunc(fromFunc)
         , _toFunc(toFunc)
         , init_(false)
+        , fromFunc_uniform_to_float()
+        , toFunc_hipart_to_float()
+        , initFloat_(0)
         , _lock()
     {
     }
@@ -160,6 +169,33 @@ class Lut
     ///Called by validate()
     void fillTables() const;
 
+    ///init the interpolated float tables
+    ///Called by validateFloatTables()
+    void fillFloatTables() const;
+
+    void validateFloatTables() const
+    {
+        // Called for each row by the batch conversions: the tables never change once filled,
+        // so only lock while they may not be.
+        if ( initFloat_.testAndSetAcquire(1, 1) ) {
+            return;
+        }
+        QMutexLocker g(&_lock);
+
+        if ( initFloat_.testAndSetAcquire(1, 1) ) {
+            return;
+        }
+        fillFloatTables();
+        initFloat_.fetchAndStoreRelease(1);
+    }
+
+    void to_float_packed_rect(float* to, const float* from, const RectI & rect,
+                              const RectI & srcRoD, const RectI & dstRoD,
+                              PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
+    void from_float_packed_rect(float* to, const float* from, const RectI & rect,
+                                const RectI & srcRoD, const RectI & dstRoD,
+                                PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
+
 public:
 
     /* @brief Converts a float ranging in [0 - 1.f] in the desired color-space to linear color-space also ranging in [0 - 1.f]
@@ -255,6 +291,18 @@ public:
     void to_float_planar(float* to, const float* from, int W, const float* alpha = NULL,
                          int inDelta = 1, int outDelta = 1) const;
 
+    /**
+     * @brief Convert W contiguous linear floats to the lut color-space, like toColorSpaceFloatFromLinearFloat()
+     * but much faster. The transfer function is tabulated at each of the 2^16 values of the 16 high bits of the
+     * float, and linearly interpolated with the 16 low bits (the relative step is 2^-7).
+     * On [0,1], the error is below 2e-5 (relative to the result if it is greater than 1) for all the built-in luts
+     * (see Lut_Test).
+     * Infinities and NaNs are converted with the exact function.
+     * The AVX2 version (selected with getInstructionSet()) gives the same results as the scalar one.
+     * The input and output buffers may be the same.
+     **/
+    void to_float_batch(float* to, const float* from, int W) const;
+
 
     /**
      * @brief These functions work exactly like the to_X_planar functions but expect 2 buffers
@@ -280,6 +328,8 @@ public:
        should be converted with the scan-line (srcRoD.y2 - y - 1) of the
        input buffer.
 
+     * The float version uses to_float_batch(), and large rectangles are converted in
+     * horizontal bands by the global thread pool.
      **/
     void to_byte_packed(unsigned char* to, const float* from, const RectI & conversionRect,
                         const RectI & srcRoD, const RectI & dstRoD,
@@ -316,6 +366,14 @@ public:
     void from_float_planar(float* to, const float* from,
                            int W, const float* alpha = NULL, int inDelta = 1, int outDelta = 1) const;
 
+    /**
+     * @brief Convert W contiguous floats in the lut color-space to linear, like fromColorSpaceFloatToLinearFloat()
+     * but much faster. The transfer function is tabulated every 2^-15 on [-1,2] and linearly interpolated, with the
+     * same error bound as to_float_batch() on [0,1]. Values out of [-1,2] are converted with the exact function.
+     * The input and output buffers may be the same.
+     **/
+    void from_float_batch(float* to, const float* from, int W) const;
+
 
     /**
      * @brief These functions work exactly like the to_X_planar functions but expect 2 buffers
@@ -341,6 +399,8 @@ public:
        should be converted with the scan-line (srcRoD.y2 - y - 1) of the
        input buffer.
 
+     * The float version uses from_float_batch(), and large rectangles are converted in
+     * horizontal bands by the global thread pool.
      **/
     void from_byte_packed(float* to, const unsigned char* from, const RectI & conversionRect,
                           const RectI & srcRoD, const RectI & dstRoD,
@@ -240,7 +240,6 @@ getPeakRSS( )
 }
 #endif // 0
 
-#if 0 // not used for now
 /**
  * Returns the current resident set size (physical memory use) measured
  * in bytes, or zero if the value cannot be determined on this OS.
@@ -297,7 +296,6 @@ getCurrentRSS( )
     return (size_t)0L;          /* Unsupported. */
 #endif
 } // getCurrentRSS
-#endif // 0
 
 
 std::size_t
@@ -0,0 +1,345 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "MipMapKernels.h"
+
+#include <cassert>
+
+#ifdef NATRON_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace MipMapKernels {
+namespace {
+///////////////////////////////////////////////////////////////////////////////
+// Scalar version: this is the reference, it does exactly what Image::halveRoI did for each pixel
+
+template <typename PIX>
+void
+halveRows_scalar(const PIX* row0,
+                 const PIX* row1,
+                 int nComps,
+                 int width,
+                 PIX* dst)
+{
+    for (int x = 0; x < width; ++x) {
+        for (int k = 0; k < nComps; ++k) {
+            ///a b
+            ///c d
+            const PIX a = row0[k];
+            const PIX b = row0[k + nComps];
+            const PIX c = row1[k];
+            const PIX d = row1[k + nComps];
+            dst[k] = PIX( (a + b + c + d) / 4 );
+        }
+        row0 += 2 * nComps;
+        row1 += 2 * nComps;
+        dst += nComps;
+    }
+}
+
+#ifdef NATRON_KERNELS_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.1 versions
+// Dividing a float by 4 or multiplying it by 0.25 gives the same result.
+// For integers, the sum is positive and the division by 4 is a shift.
+
+NATRON_TARGET_SSE41
+inline __m128
+average4_sse41(__m128 a,
+               __m128 b,
+               __m128 c,
+               __m128 d)
+{
+    return _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_add_ps(a, b), c ), d ), _mm_set1_ps(0.25f) );
+}
+
+NATRON_TARGET_SSE41
+void
+halveRows_sse41(const float* row0,
+                const float* row1,
+                int nComps,
+                int width,
+                float* dst)
+{
+    int x = 0;
+
+    if (nComps == 4) {
+        for (; x < width; ++x) {
+            __m128 a = _mm_loadu_ps(row0 + 8 * x);
+            __m128 b = _mm_loadu_ps(row0 + 8 * x + 4);
+            __m128 c = _mm_loadu_ps(row1 + 8 * x);
+            __m128 d = _mm_loadu_ps(row1 + 8 * x + 4);
+            _mm_storeu_ps( dst + 4 * x, average4_sse41(a, b, c, d) );
+        }
+    } else if (nComps == 2) {
+        // 2 pixels per iteration: p0 p1 | p2 p3 -> a = p0 p2, b = p1 p3
+        for (; x + 2 <= width; x += 2) {
+            __m128 r00 = _mm_loadu_ps(row0 + 4 * x);
+            __m128 r01 = _mm_loadu_ps(row0 + 4 * x + 4);
+            __m128 r10 = _mm_loadu_ps(row1 + 4 * x);
+            __m128 r11 = _mm_loadu_ps(row1 + 4 * x + 4);
+            __m128 a = _mm_shuffle_ps( r00, r01, _MM_SHUFFLE(1, 0, 1, 0) );
+            __m128 b = _mm_shuffle_ps( r00, r01, _MM_SHUFFLE(3, 2, 3, 2) );
+            __m128 c = _mm_shuffle_ps( r10, r11, _MM_SHUFFLE(1, 0, 1, 0) );
+            __m128 d = _mm_shuffle_ps( r10, r11, _MM_SHUFFLE(3, 2, 3, 2) );
+            _mm_storeu_ps( dst + 2 * x, average4_sse41(a, b, c, d) );
+        }
+    } else if (nComps == 1) {
+        // 4 pixels per iteration: a = even pixels, b = odd pixels
+        for (; x + 4 <= width; x += 4) {
+            __m128 r00 = _mm_loadu_ps(row0 + 2 * x);
+            __m128 r01 = _mm_loadu_ps(row0 + 2 * x + 4);
+            __m128 r10 = _mm_loadu_ps(row1 + 2 * x);
+            __m128 r11 = _mm_loadu_ps(row1 + 2 * x + 4);
+            __m128 a = _mm_shuffle_ps( r00, r01, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 b = _mm_shuffle_ps( r00, r01, _MM_SHUFFLE(3, 1, 3, 1) );
+            __m128 c = _mm_shuffle_ps( r10, r11, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 d = _mm_shuffle_ps( r10, r11, _MM_SHUFFLE(3, 1, 3, 1) );
+            _mm_storeu_ps( dst + x, average4_sse41(a, b, c, d) );
+        }
+    }
+    halveRows_scalar(row0 + 2 * x * nComps, row1 + 2 * x * nComps, nComps, width - x, dst + x * nComps);
+}
+
+// Sums of the pairs of 16-bit values of v in 32-bit lanes
+NATRON_TARGET_SSE41
+inline __m128i
+sumPairsU16_sse41(__m128i v)
+{
+    return _mm_add_epi32( _mm_and_si128( v, _mm_set1_epi32(0xFFFF) ), _mm_srli_epi32(v, 16) );
+}
+
+// Sums of the two pixels of 4 components of v in 32-bit lanes
+NATRON_TARGET_SSE41
+inline __m128i
+sumPixelsU16_sse41(__m128i v)
+{
+    return _mm_add_epi32( _mm_cvtepu16_epi32(v), _mm_cvtepu16_epi32( _mm_srli_si128(v, 8) ) );
+}
+
+NATRON_TARGET_SSE41
+void
+halveRows_sse41(const unsigned short* row0,
+                const unsigned short* row1,
+                int nComps,
+                int width,
+                unsigned short* dst)
+{
+    int x = 0;
+
+    if (nComps == 4) {
+        // 2 pixels per iteration
+        for (; x + 2 <= width; x += 2) {
+            __m128i r00 = _mm_loadu_si128( (const __m128i*)(row0 + 8 * x) );
+            __m128i r01 = _mm_loadu_si128( (const __m128i*)(row0 + 8 * x + 8) );
+            __m128i r10 = _mm_loadu_si128( (const __m128i*)(row1 + 8 * x) );
+            __m128i r11 = _mm_loadu_si128( (const __m128i*)(row1 + 8 * x + 8) );
+            __m128i s0 = _mm_add_epi32( sumPixelsU16_sse41(r00), sumPixelsU16_sse41(r10) );
+            __m128i s1 = _mm_add_epi32( sumPixelsU16_sse41(r01), sumPixelsU16_sse41(r11) );
+            _mm_storeu_si128( (__m128i*)(dst + 4 * x), _mm_packus_epi32( _mm_srli_epi32(s0, 2), _mm_srli_epi32(s1, 2) ) );
+        }
+    } else if (nComps == 1) {
+        // 8 pixels per iteration
+        for (; x + 8 <= width; x += 8) {
+            __m128i r00 = _mm_loadu_si128( (const __m128i*)(row0 + 2 * x) );
+            __m128i r01 = _mm_loadu_si128( (const __m128i*)(row0 + 2 * x + 8) );
+            __m128i r10 = _mm_loadu_si128( (const __m128i*)(row1 + 2 * x) );
+            __m128i r11 = _mm_loadu_si128( (const __m128i*)(row1 + 2 * x + 8) );
+            __m128i s0 = _mm_add_epi32( sumPairsU16_sse41(r00), sumPairsU16_sse41(r10) );
+            __m128i s1 = _mm_add_epi32( sumPairsU16_sse41(r01), sumPairsU16_sse41(r11) );
+            _mm_storeu_si128( (__m128i*)(dst + x), _mm_packus_epi32( _mm_srli_epi32(s0, 2), _mm_srli_epi32(s1, 2) ) );
+        }
+    }
+    halveRows_scalar(row0 + 2 * x * nComps, row1 + 2 * x * nComps, nComps, width - x, dst + x * nComps);
+}
+
+NATRON_TARGET_SSE41
+void
+halveRows_sse41(const unsigned char* row0,
+                const unsigned char* row1,
+                int nComps,
+                int width,
+                unsigned char* dst)
+{
+    // The sums of pairs of bytes are computed in 16-bit lanes with pmaddubsw
+    const __m128i ones = _mm_set1_epi8(1);
+    int x = 0;
+
+    if ( (nComps == 4) || (nComps == 1) ) {
+        // With 4 components, interleave the components of the pixels 2x and 2x+1 so that they are summed
+        const __m128i order = (nComps == 4) ?
+                              _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15) :
+                              _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        // 16 bytes per iteration
+        const int step = 16 / nComps;
+        for (; x + step <= width; x += step) {
+            const int i = 2 * x * nComps;
+            __m128i r00 = _mm_shuffle_epi8(_mm_loadu_si128( (const __m128i*)(row0 + i) ), order);
+            __m128i r01 = _mm_shuffle_epi8(_mm_loadu_si128( (const __m128i*)(row0 + i + 16) ), order);
+            __m128i r10 = _mm_shuffle_epi8(_mm_loadu_si128( (const __m128i*)(row1 + i) ), order);
+            __m128i r11 = _mm_shuffle_epi8(_mm_loadu_si128( (const __m128i*)(row1 + i + 16) ), order);
+            __m128i s0 = _mm_add_epi16( _mm_maddubs_epi16(r00, ones), _mm_maddubs_epi16(r10, ones) );
+            __m128i s1 = _mm_add_epi16( _mm_maddubs_epi16(r01, ones), _mm_maddubs_epi16(r11, ones) );
+            _mm_storeu_si128( (__m128i*)(dst + x * nComps), _mm_packus_epi16( _mm_srli_epi16(s0, 2), _mm_srli_epi16(s1, 2) ) );
+        }
+    }
+    halveRows_scalar(row0 + 2 * x * nComps, row1 + 2 * x * nComps, nComps, width - x, dst + x * nComps);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 version, for float only: the integer kernels are limited by the memory bandwidth with SSE4.1 already
+
+NATRON_TARGET_AVX2
+void
+halveRows_avx2(const float* row0,
+               const float* row1,
+               int nComps,
+               int width,
+               float* dst)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int x = 0;
+
+    if (nComps == 4) {
+        // 2 pixels per iteration: p0 p1 | p2 p3 -> a = p0 p2, b = p1 p3
+        for (; x + 2 <= width; x += 2) {
+            __m256 r00 = _mm256_loadu_ps(row0 + 8 * x);
+            __m256 r01 = _mm256_loadu_ps(row0 + 8 * x + 8);
+            __m256 r10 = _mm256_loadu_ps(row1 + 8 * x);
+            __m256 r11 = _mm256_loadu_ps(row1 + 8 * x + 8);
+            __m256 a = _mm256_permute2f128_ps(r00, r01, 0x20);
+            __m256 b = _mm256_permute2f128_ps(r00, r01, 0x31);
+            __m256 c = _mm256_permute2f128_ps(r10, r11, 0x20);
+            __m256 d = _mm256_permute2f128_ps(r10, r11, 0x31);
+            __m256 s = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps(a, b), c ), d );
+            _mm256_storeu_ps( dst + 4 * x, _mm256_mul_ps(s, quarter) );
+        }
+    } else if ( (nComps == 2) || (nComps == 1) ) {
+        // 8 values per iteration. The in-lane shuffles give the 64-bit blocks of the result in
+        // the order 0 2 1 3, which is restored after the sum.
+        const int step = 8 / nComps;
+        for (; x + step <= width; x += step) {
+            const int i = 2 * x * nComps;
+            __m256 r00 = _mm256_loadu_ps(row0 + i);
+            __m256 r01 = _mm256_loadu_ps(row0 + i + 8);
+            __m256 r10 = _mm256_loadu_ps(row1 + i);
+            __m256 r11 = _mm256_loadu_ps(row1 + i + 8);
+            __m256 a, b, c, d;
+            if (nComps == 2) {
+                a = _mm256_shuffle_ps( r00, r01, _MM_SHUFFLE(1, 0, 1, 0) );
+                b = _mm256_shuffle_ps( r00, r01, _MM_SHUFFLE(3, 2, 3, 2) );
+                c = _mm256_shuffle_ps( r10, r11, _MM_SHUFFLE(1, 0, 1, 0) );
+                d = _mm256_shuffle_ps( r10, r11, _MM_SHUFFLE(3, 2, 3, 2) );
+            } else {
+                a = _mm256_shuffle_ps( r00, r01, _MM_SHUFFLE(2, 0, 2, 0) );
+                b = _mm256_shuffle_ps( r00, r01, _MM_SHUFFLE(3, 1, 3, 1) );
+                c = _mm256_shuffle_ps( r10, r11, _MM_SHUFFLE(2, 0, 2, 0) );
+                d = _mm256_shuffle_ps( r10, r11, _MM_SHUFFLE(3, 1, 3, 1) );
+            }
+            __m256 s = _mm256_mul_ps(_mm256_add_ps( _mm256_add_ps( _mm256_add_ps(a, b), c ), d ), quarter);
+            s = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd(s), _MM_SHUFFLE(3, 1, 2, 0) ) );
+            _mm256_storeu_ps(dst + x * nComps, s);
+        }
+    }
+    halveRows_scalar(row0 + 2 * x * nComps, row1 + 2 * x * nComps, nComps, width - x, dst + x * nComps);
+}
+
+#endif // NATRON_KERNELS_X86
+} // anon namespace
+
+void
+halveRows(const float* row0,
+          const float* row1,
+          int nComps,
+          int width,
+          float* dst)
+{
+    assert(nComps >= 1 && nComps <= 4);
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        halveRows_avx2(row0, row1, nComps, width, dst);
+        break;
+    case eInstructionSetSSE41:
+        halveRows_sse41(row0, row1, nComps, width, dst);
+        break;
+#endif
+    default:
+        halveRows_scalar(row0, row1, nComps, width, dst);
+        break;
+    }
+}
+
+void
+halveRows(const unsigned short* row0,
+          const unsigned short* row1,
+          int nComps,
+          int width,
+          unsigned short* dst)
+{
+    assert(nComps >= 1 && nComps <= 4);
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE41:
+        halveRows_sse41(row0, row1, nComps, width, dst);
+        break;
+#endif
+    default:
+        halveRows_scalar(row0, row1, nComps, width, dst);
+        break;
+    }
+}
+
+void
+halveRows(const unsigned char* row0,
+          const unsigned char* row1,
+          int nComps,
+          int width,
+          unsigned char* dst)
+{
+    assert(nComps >= 1 && nComps <= 4);
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE41:
+        halveRows_sse41(row0, row1, nComps, width, dst);
+        break;
+#endif
+    default:
+        halveRows_scalar(row0, row1, nComps, width, dst);
+        break;
+    }
+}
+} // namespace MipMapKernels
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,59 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_MIPMAPKERNELS_H
+#define NATRON_ENGINE_MIPMAPKERNELS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+#include "Engine/InstructionSet.h"
+
+NATRON_NAMESPACE_ENTER
+
+/*
+ * Scan-line kernels used by Image::downscaleMipMap to compute a mipmap level from the previous one.
+ * Each kernel has a scalar implementation and vector implementations selected at runtime with
+ * getInstructionSet(), which give bit-exact identical results.
+ *
+ * Pixels are interleaved with nComps (1 to 4) components. 1 and 4 components (and 2 for float)
+ * are vectorized, the others use the scalar implementation.
+ */
+namespace MipMapKernels {
+/**
+ * @brief Computes width pixels of the next mipmap level from two consecutive rows of the previous
+ * level: dst[x] is the average of the pixels 2x and 2x+1 of row0 and row1, i.e. (a + b + c + d) / 4
+ * summed in that order in the type of the pixels (float) or in int with an integer division (byte, short).
+ * row0 and row1 must have 2 * width pixels.
+ **/
+void halveRows(const float* row0, const float* row1, int nComps, int width, float* dst);
+
+void halveRows(const unsigned short* row0, const unsigned short* row1, int nComps, int width, unsigned short* dst);
+
+void halveRows(const unsigned char* row0, const unsigned char* row1, int nComps, int width, unsigned char* dst);
+} // namespace MipMapKernels
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_MIPMAPKERNELS_H
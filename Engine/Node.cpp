@@ -1293,6 +1293,7 @@ Node::incrementKnobsAge()
     }
     Q_EMIT knobsAgeChanged(newAge);
 
+    markSerializationDirty();
     computeHash();
 }
 
@@ -1304,6 +1305,41 @@ Node::getKnobsAge() const
     return _imp->knobsAge;
 }
 
+void
+Node::markSerializationDirty()
+{
+    {
+        QWriteLocker l(&_imp->knobsAgeMutex);
+        ++_imp->serializationAge;
+    }
+
+    NodePtr parent = getParentMultiInstance();
+    if (!parent) {
+        NodeGroupPtr isGroup = boost::dynamic_pointer_cast<NodeGroup>( getGroup() );
+        if (isGroup) {
+            parent = isGroup->getNode();
+        }
+    }
+    if (!parent) {
+        RotoDrawableItemPtr attachedStroke = _imp->paintStroke.lock();
+        RotoContextPtr context = attachedStroke ? attachedStroke->getContext() : RotoContextPtr();
+        if (context) {
+            parent = context->getNode();
+        }
+    }
+    if ( parent && (parent.get() != this) ) {
+        parent->markSerializationDirty();
+    }
+}
+
+U64
+Node::getSerializationAge() const
+{
+    QReadLocker l(&_imp->knobsAgeMutex);
+
+    return _imp->serializationAge;
+}
+
 bool
 Node::isRenderingPreview() const
 {
@@ -2787,6 +2823,8 @@ Node::deactivate(const std::list<NodePtr> & outputsToDisconnect,
     if ( !_imp->effect || !isActivated() ) {
         return;
     }
+    markSerializationDirty();
+
     //first tell the gui to clear any persistent message linked to this node
     clearPersistentMessage(false);
 
@@ -3034,7 +3072,7 @@ Node::activate(const std::list<NodePtr> & outputsToRestore,
     if ( !_imp->effect || isActivated() ) {
         return;
     }
-
+    markSerializationDirty();
 
     ///No need to lock, guiInputs is only written to by the main-thread
     NodePtr thisShared = shared_from_this();
@@ -4877,6 +4915,7 @@ Node::onEffectKnobValueChanged(KnobI* what,
     if (!what) {
         return false;
     }
+    markSerializationDirty();
     for (std::map<int, MaskSelector >::iterator it = _imp->maskSelectors.begin(); it != _imp->maskSelectors.end(); ++it) {
         if (it->second.channel.lock().get() == what) {
             _imp->onMaskSelectorChanged(it->first, it->second);
@@ -877,6 +877,17 @@ public:
 
     U64 getKnobsAge() const;
 
+    /**
+     * @brief Marks the serialization of this node as changed so that the next incremental auto-save writes it.
+     * This also marks the group, multi-instance parent or roto node containing this node, since they serialize it.
+     **/
+    void markSerializationDirty();
+
+    /**
+     * @brief Returns a counter incremented by markSerializationDirty(). This is thread-safe.
+     **/
+    U64 getSerializationAge() const;
+
     void onAllKnobsSlaved(bool isSlave, KnobHolder* master);
 
     void onKnobSlaved(const KnobIPtr& slave, const KnobIPtr& master, int dimension, bool isSlave);
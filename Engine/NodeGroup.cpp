@@ -32,6 +32,12 @@
 #include <stdexcept>
 #include <sstream> // stringstream
 #include <limits>
+#include <map>
+#include <utility>
+#include <cctype> // isdigit
+#include <cstdlib> // atoi
+
+#include <boost/unordered_map.hpp>
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QTextStream>
@@ -63,6 +69,71 @@
 
 NATRON_NAMESPACE_ENTER
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The nodes of a collection by script-name, label or cache ID. Labels are not unique.
+typedef boost::unordered_multimap<std::string, NodePtr> NodesNameIndex;
+
+// The names under which a node is in the indexes
+struct IndexedNodeNames
+{
+    NodePtr node;
+    std::string scriptName;
+    std::string label;
+    std::string cacheID;
+};
+
+typedef std::map<const Node*, IndexedNodeNames> IndexedNodesMap;
+
+// For a prefix and the first number appended to it, all the script-names from the first number
+// up to (excluding) the hint are known to be taken.
+typedef std::map<std::pair<std::string, int>, int> NameNumberHintsMap;
+
+void
+insertInIndex(NodesNameIndex& index,
+              const std::string& name,
+              const NodePtr& node)
+{
+    if ( !name.empty() ) {
+        index.insert( std::make_pair(name, node) );
+    }
+}
+
+void
+removeFromIndex(NodesNameIndex& index,
+                const std::string& name,
+                const Node* node)
+{
+    std::pair<NodesNameIndex::iterator, NodesNameIndex::iterator> range = index.equal_range(name);
+
+    for (NodesNameIndex::iterator it = range.first; it != range.second; ++it) {
+        if (it->second.get() == node) {
+            index.erase(it);
+
+            return;
+        }
+    }
+}
+
+// Returns the first node with the given name other than caller
+NodePtr
+findInIndex(const NodesNameIndex& index,
+            const std::string& name,
+            const Node* caller)
+{
+    std::pair<NodesNameIndex::const_iterator, NodesNameIndex::const_iterator> range = index.equal_range(name);
+
+    for (NodesNameIndex::const_iterator it = range.first; it != range.second; ++it) {
+        if (it->second.get() != caller) {
+            return it->second;
+        }
+    }
+
+    return NodePtr();
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 struct NodeCollectionPrivate
 {
     AppInstanceWPtr app;
@@ -70,17 +141,113 @@ struct NodeCollectionPrivate
     mutable QMutex nodesMutex;
     NodesList nodes;
 
+    // Protected by nodesMutex. The indexes are updated when a node is added, removed or renamed.
+    NodesNameIndex nodesByScriptName;
+    NodesNameIndex nodesByLabel;
+    NodesNameIndex nodesByCacheID;
+    IndexedNodesMap indexedNodes;
+    NameNumberHintsMap nameNumberHints;
+
     NodeCollectionPrivate(const AppInstancePtr& app)
         : app(app)
         , graph(0)
         , nodesMutex()
         , nodes()
+        , nodesByScriptName()
+        , nodesByLabel()
+        , nodesByCacheID()
+        , indexedNodes()
+        , nameNumberHints()
     {
     }
 
     NodePtr findNodeInternal(const std::string& name, const std::string& recurseName) const;
+
+    void indexNode(const NodePtr& node);
+
+    void unindexNode(const Node* node);
+
+    void onScriptNameReleased(const std::string& name);
+
+    std::string generateUniqueScriptName(const std::string& prefix, int firstNumber, const Node* caller);
 };
 
+void
+NodeCollectionPrivate::indexNode(const NodePtr& node)
+{
+    IndexedNodeNames& names = indexedNodes[node.get()];
+
+    names.node = node;
+    names.scriptName = node->getScriptName_mt_safe();
+    names.label = node->getLabel_mt_safe();
+    names.cacheID = node->getCacheID();
+    insertInIndex(nodesByScriptName, names.scriptName, node);
+    insertInIndex(nodesByLabel, names.label, node);
+    insertInIndex(nodesByCacheID, names.cacheID, node);
+}
+
+void
+NodeCollectionPrivate::unindexNode(const Node* node)
+{
+    IndexedNodesMap::iterator found = indexedNodes.find(node);
+
+    if ( found == indexedNodes.end() ) {
+        return;
+    }
+    removeFromIndex(nodesByScriptName, found->second.scriptName, node);
+    removeFromIndex(nodesByLabel, found->second.label, node);
+    removeFromIndex(nodesByCacheID, found->second.cacheID, node);
+    onScriptNameReleased(found->second.scriptName);
+    indexedNodes.erase(found);
+}
+
+void
+NodeCollectionPrivate::onScriptNameReleased(const std::string& name)
+{
+    if ( nameNumberHints.empty() ) {
+        return;
+    }
+    // The name may be any prefix followed by a number (without leading zero): lower the hints of these prefixes
+    std::size_t i = name.size();
+    while ( (i > 0) && (name.size() - i < 9) && std::isdigit( (unsigned char)name[i - 1] ) ) {
+        --i;
+        if (name[i] == '0') {
+            continue;
+        }
+        const std::string prefix = name.substr(0, i);
+        const int number = std::atoi( name.c_str() + i );
+        for (NameNumberHintsMap::iterator it = nameNumberHints.lower_bound( std::make_pair( prefix, std::numeric_limits<int>::min() ) );
+             it != nameNumberHints.end() && it->first.first == prefix; ++it) {
+            if ( (number >= it->first.second) && (number < it->second) ) {
+                it->second = number;
+            }
+        }
+    }
+}
+
+std::string
+NodeCollectionPrivate::generateUniqueScriptName(const std::string& prefix,
+                                                int firstNumber,
+                                                const Node* caller)
+{
+    // Start from the hint rather than from the first number: the numbers before are taken
+    NameNumberHintsMap::iterator hint = nameNumberHints.insert( std::make_pair(std::make_pair(prefix, firstNumber), firstNumber) ).first;
+    int no = std::max(firstNumber, hint->second);
+    std::string name;
+
+    for (;; ++no) {
+        std::stringstream ss;
+        ss << prefix << no;
+        name = ss.str();
+        if ( !findInIndex(nodesByScriptName, name, caller) ) {
+            break;
+        }
+    }
+    hint->second = no;
+
+    return name;
+}
+
 NodeCollection::NodeCollection(const AppInstancePtr& app)
     : _imp( new NodeCollectionPrivate(app) )
 {
@@ -153,17 +320,51 @@ NodeCollection::addNode(const NodePtr& node)
     {
         QMutexLocker k(&_imp->nodesMutex);
         _imp->nodes.push_back(node);
+        _imp->indexNode(node);
     }
+    markGroupSerializationDirty();
 }
 
 void
 NodeCollection::removeNode(const Node* node)
+{
+    {
+        QMutexLocker k(&_imp->nodesMutex);
+        for (NodesList::iterator it =_imp->nodes.begin(); it != _imp->nodes.end();++it) {
+            if ( it->get() == node ) {
+                _imp->nodes.erase(it);
+                break;
+            }
+        }
+        _imp->unindexNode(node);
+    }
+    markGroupSerializationDirty();
+}
+
+void
+NodeCollection::refreshNodeNameIndex(const Node* node)
 {
     QMutexLocker k(&_imp->nodesMutex);
-    for (NodesList::iterator it =_imp->nodes.begin(); it != _imp->nodes.end();++it) {
-        if ( it->get() == node ) {
-            _imp->nodes.erase(it);
-            break;
+    IndexedNodesMap::iterator found = _imp->indexedNodes.find(node);
+
+    if ( found == _imp->indexedNodes.end() ) {
+        // Not in the collection (yet)
+        return;
+    }
+    NodePtr nodePtr = found->second.node;
+    _imp->unindexNode(node);
+    _imp->indexNode(nodePtr);
+}
+
+void
+NodeCollection::markGroupSerializationDirty()
+{
+    NodeGroup* isGroup = dynamic_cast<NodeGroup*>(this);
+
+    if (isGroup) {
+        NodePtr groupNode = isGroup->getNode();
+        if (groupNode) {
+            groupNode->markSerializationDirty();
         }
     }
 }
@@ -292,13 +493,7 @@ NodeCollection::isCacheIDAlreadyTaken(const std::string& name) const
 {
     QMutexLocker k(&_imp->nodesMutex);
 
-    for (NodesList::iterator it = _imp->nodes.begin(); it != _imp->nodes.end(); ++it) {
-        if ( (*it)->getCacheID() == name ) {
-            return true;
-        }
-    }
-
-    return false;
+    return bool( findInIndex(_imp->nodesByCacheID, name, 0) );
 }
 
 bool
@@ -444,6 +639,11 @@ NodeCollection::clearNodesInternal(bool blocking)
     {
         QMutexLocker l(&_imp->nodesMutex);
         _imp->nodes.clear();
+        _imp->nodesByScriptName.clear();
+        _imp->nodesByLabel.clear();
+        _imp->nodesByCacheID.clear();
+        _imp->indexedNodes.clear();
+        _imp->nameNumberHints.clear();
     }
 
     nodesToDelete.clear();
@@ -495,42 +695,40 @@ NodeCollection::checkNodeName(const Node* node,
             }
         }
     }
-    bool foundNodeWithName = false;
-    int no = 1;
+
+    QMutexLocker l(&_imp->nodesMutex);
+    if (appendDigit && !errorIfExists) {
+        *nodeName = _imp->generateUniqueScriptName(cpy, 1, node);
+
+        return;
+    }
 
     {
         std::stringstream ss;
         ss << cpy;
         if (appendDigit) {
-            ss << no;
+            ss << 1;
         }
         *nodeName = ss.str();
     }
-    do {
-        foundNodeWithName = false;
-        QMutexLocker l(&_imp->nodesMutex);
-        for (NodesList::iterator it = _imp->nodes.begin(); it != _imp->nodes.end(); ++it) {
-            if ( (it->get() != node) && ( (*it)->getScriptName_mt_safe() == *nodeName ) ) {
-                foundNodeWithName = true;
-                break;
-            }
-        }
-        if (foundNodeWithName) {
-            if (errorIfExists || !appendDigit) {
-                throw std::runtime_error( tr("A node with the script-name %1 already exists.").arg( QString::fromUtf8( nodeName->c_str() ) ).toStdString() );
+    if ( findInIndex(_imp->nodesByScriptName, *nodeName, node) ) {
+        throw std::runtime_error( tr("A node with the script-name %1 already exists.").arg( QString::fromUtf8( nodeName->c_str() ) ).toStdString() );
 
-                return;
-            }
-            ++no;
-            {
-                std::stringstream ss;
-                ss << cpy << no;
-                *nodeName = ss.str();
-            }
-        }
-    } while (foundNodeWithName);
+        return;
+    }
 } // NodeCollection::checkNodeName
 
+void
+NodeCollection::generateUniqueNodeScriptName(const std::string& prefix,
+                                             int firstNumber,
+                                             const Node* caller,
+                                             std::string* nodeName)
+{
+    QMutexLocker l(&_imp->nodesMutex);
+
+    *nodeName = _imp->generateUniqueScriptName(prefix, firstNumber, caller);
+}
+
 void
 NodeCollection::initNodeName(const std::string& pluginLabel,
                              std::string* nodeName)
@@ -757,25 +955,20 @@ NodeCollectionPrivate::findNodeInternal(const std::string& name,
                                         const std::string& recurseName) const
 {
     QMutexLocker k(&nodesMutex);
+    NodePtr node = findInIndex(nodesByScriptName, name, 0);
 
-    for (NodesList::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
-        if ( (*it)->getScriptName_mt_safe() == name ) {
-            if ( !recurseName.empty() ) {
-                NodeGroup* isGrp = (*it)->isEffectGroup();
-                if (isGrp) {
-                    return isGrp->getNodeByFullySpecifiedName(recurseName);
-                } else {
-                    NodesList children;
-                    (*it)->getChildrenMultiInstance(&children);
-                    for (NodesList::iterator it2 = children.begin(); it2 != children.end(); ++it2) {
-                        if ( (*it2)->getScriptName_mt_safe() == recurseName ) {
-                            return *it2;
-                        }
-                    }
-                }
-            } else {
-                return *it;
-            }
+    if ( !node || recurseName.empty() ) {
+        return node;
+    }
+    NodeGroup* isGrp = node->isEffectGroup();
+    if (isGrp) {
+        return isGrp->getNodeByFullySpecifiedName(recurseName);
+    }
+    NodesList children;
+    node->getChildrenMultiInstance(&children);
+    for (NodesList::iterator it = children.begin(); it != children.end(); ++it) {
+        if ( (*it)->getScriptName_mt_safe() == recurseName ) {
+            return *it;
         }
     }
 
@@ -922,13 +1115,7 @@ NodeCollection::checkIfNodeLabelExists(const std::string & n,
 {
     QMutexLocker k(&_imp->nodesMutex);
 
-    for (NodesList::const_iterator it = _imp->nodes.begin(); it != _imp->nodes.end(); ++it) {
-        if ( (it->get() != caller) && ( (*it)->getLabel_mt_safe() == n ) ) {
-            return true;
-        }
-    }
-
-    return false;
+    return bool( findInIndex(_imp->nodesByLabel, n, caller) );
 }
 
 bool
@@ -937,13 +1124,7 @@ NodeCollection::checkIfNodeNameExists(const std::string & n,
 {
     QMutexLocker k(&_imp->nodesMutex);
 
-    for (NodesList::const_iterator it = _imp->nodes.begin(); it != _imp->nodes.end(); ++it) {
-        if ( (it->get() != caller) && ( (*it)->getScriptName_mt_safe() == n ) ) {
-            return true;
-        }
-    }
-
-    return false;
+    return bool( findInIndex(_imp->nodesByScriptName, n, caller) );
 }
 
 static void
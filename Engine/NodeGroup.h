@@ -90,6 +90,12 @@ public:
      **/
     void removeNode(const Node* node);
 
+    /**
+     * @brief Must be called when the script-name, the label or the cache ID of a node of the collection changed,
+     * to update the index used to find the nodes by name. MT-safe.
+     **/
+    void refreshNodeNameIndex(const Node* node);
+
     /**
      * @brief Get the last node added with the given id
      **/
@@ -120,6 +126,13 @@ public:
      **/
     void checkNodeName(const Node* node, const std::string& baseName, bool appendDigit, bool errorIfExists, std::string* nodeName);
 
+    /**
+     * @brief Set in nodeName a script-name made of prefix followed by a number, from firstNumber, that no node of the
+     * collection other than caller has. The numbers known to be taken are skipped, so that generating the names of
+     * many nodes with the same prefix does not probe all the previous numbers. MT-safe.
+     **/
+    void generateUniqueNodeScriptName(const std::string& prefix, int firstNumber, const Node* caller, std::string* nodeName);
+
     /**
      * @brief Returns true if there is one or more nodes in the collection.
      **/
@@ -288,6 +301,11 @@ public:
 private:
     void quitAnyProcessingInternal(bool blocking);
 
+    /**
+     * @brief If this collection is a group, marks the serialization of its node as changed.
+     **/
+    void markGroupSerializationDirty();
+
     boost::scoped_ptr<NodeCollectionPrivate> _imp;
 };
 
@@ -89,6 +89,16 @@ public:
         _serializedNodes.push_back(s);
     }
 
+    /**
+     * @brief Replaces the serialization of the node with the same script-name, or adds it if there is none.
+     **/
+    void setNodeSerialization(const NodeSerializationPtr& s);
+
+    /**
+     * @brief Removes the serialization of the node with the given script-name, if any.
+     **/
+    void removeNodeSerialization(const std::string& scriptName);
+
     static bool restoreFromSerialization(const std::list<NodeSerializationPtr> & serializedNodes,
                                          const NodeCollectionPtr& group,
                                          bool createNodes,
@@ -1598,6 +1598,8 @@ Node::onInputChanged(int inputNb,
     }
     assert( QThread::currentThread() == qApp->thread() );
 
+    markSerializationDirty();
+
     bool mustCallEndInputEdition = _imp->inputModifiedRecursion == 0;
     if (mustCallEndInputEdition) {
         beginInputEdition();
@@ -51,39 +51,26 @@ Node::initNodeScriptName(const NodeSerialization* serialization, const QString&
 
         std::string baseName = fixedName.toStdString();
         std::string name = baseName;
-        int no = 1;
-        do {
-            if (no > 1) {
-                std::stringstream ss;
-                ss << baseName;
-                ss << '_';
-                ss << no;
-                name = ss.str();
-            }
-            ++no;
-        } while ( group && group->checkIfNodeNameExists(name, this) );
+        if ( group && group->checkIfNodeNameExists(name, this) ) {
+            group->generateUniqueNodeScriptName(baseName + '_', 2, this, &name);
+        }
 
         //This version of setScriptName will not error if the name is invalid or already taken
         setScriptName_no_error_check(name);
 
     } else if (serialization) {
         if ( group && !group->isCacheIDAlreadyTaken( serialization->getCacheID() ) ) {
-            QMutexLocker k(&_imp->nameMutex);
-            _imp->cacheID = serialization->getCacheID();
+            {
+                QMutexLocker k(&_imp->nameMutex);
+                _imp->cacheID = serialization->getCacheID();
+            }
+            group->refreshNodeNameIndex(this);
         }
         const std::string& baseName = serialization->getNodeScriptName();
         std::string name = baseName;
-        int no = 1;
-        do {
-            if (no > 1) {
-                std::stringstream ss;
-                ss << baseName;
-                ss << '_';
-                ss << no;
-                name = ss.str();
-            }
-            ++no;
-        } while ( group && group->checkIfNodeNameExists(name, this) );
+        if ( group && group->checkIfNodeNameExists(name, this) ) {
+            group->generateUniqueNodeScriptName(baseName + '_', 2, this, &name);
+        }
 
         //This version of setScriptName will not error if the name is invalid or already taken
         setScriptName_no_error_check(name);
@@ -190,8 +177,10 @@ Node::setLabel(const std::string& label)
         }
         _imp->label = label;
     }
+    markSerializationDirty();
     NodeCollectionPtr collection = getGroup();
     if (collection) {
+        collection->refreshNodeNameIndex(this);
         collection->notifyNodeNameChanged( shared_from_this() );
     }
     Q_EMIT labelChanged( QString::fromUtf8( label.c_str() ) );
@@ -344,6 +333,10 @@ Node::setNameInternal(const std::string& name,
             _imp->label = newName;
         }
     }
+    if (collection) {
+        collection->refreshNodeNameIndex(this);
+    }
+    markSerializationDirty();
     std::string fullySpecifiedName = getFullyQualifiedName();
 
     if (mustSetCacheID) {
@@ -357,8 +350,13 @@ Node::setNameInternal(const std::string& name,
             cacheID = ss.str();
             ++i;
         }
-        QMutexLocker l(&_imp->nameMutex);
-        _imp->cacheID = cacheID;
+        {
+            QMutexLocker l(&_imp->nameMutex);
+            _imp->cacheID = cacheID;
+        }
+        if (collection) {
+            collection->refreshNodeNameIndex(this);
+        }
     }
 
     if (collection) {
@@ -174,6 +174,7 @@ public:
         , mustQuitPreviewCond()
         , renderInstancesSharedMutex(QMutex::Recursive)
         , knobsAge(0)
+        , serializationAge(0)
         , knobsAgeMutex()
         , masterNodeMutex()
         , masterNode()
@@ -357,7 +358,8 @@ public:
     QMutex renderInstancesSharedMutex; //< see eRenderSafetyInstanceSafe in EffectInstance::renderRoI
     //only 1 clone can render at any time
     U64 knobsAge; //< the age of the knobs in this effect. It gets incremented every times the effect has its evaluate() function called.
-    mutable QReadWriteLock knobsAgeMutex; //< protects knobsAge and hash
+    U64 serializationAge; //< incremented every time anything serialized by the node changes, see markSerializationDirty()
+    mutable QReadWriteLock knobsAgeMutex; //< protects knobsAge, serializationAge and hash
     Hash64 hash; //< recomputed everytime knobsAge is changed.
     mutable QMutex masterNodeMutex; //< protects masterNode and nodeLinks
     NodeWPtr masterNode; //< this points to the master when the node is a clone
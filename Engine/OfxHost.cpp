@@ -106,6 +106,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Plugin.h"
 #include "Engine/Project.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/ThreadPool.h"
@@ -1308,6 +1309,42 @@ private:
     OfxStatus *_stat;
 };
 
+// The calls of the multi-thread suite function, executed by the TaskScheduler
+class OfxThreadTasks
+    : public ParallelTasks
+{
+public:
+    OfxThreadTasks(OfxThreadFunctionV1 func,
+                   unsigned int threadMax,
+                   QThread* spawnerThread,
+                   void *customArg)
+        : ParallelTasks()
+        , _func(func)
+        , _threadMax(threadMax)
+        , _spawnerThread(spawnerThread)
+        , _customArg(customArg)
+        , _status(threadMax, kOfxStatFailed)
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        _status[taskIndex] = threadFunctionWrapper(_func, (unsigned int)taskIndex, _threadMax, _spawnerThread, _customArg);
+    }
+
+    const std::vector<OfxStatus>& getStatus() const
+    {
+        return _status;
+    }
+
+private:
+    OfxThreadFunctionV1 *_func;
+    unsigned int _threadMax;
+    QThread* _spawnerThread;
+    void *_customArg;
+    std::vector<OfxStatus> _status;
+};
+
 NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 
@@ -1354,19 +1391,17 @@ OfxHost::multiThread(OfxThreadFunctionV1 func,
     bool useThreadPool = appPTR->getUseThreadPool();
 
     if (useThreadPool) {
-        std::vector<unsigned int> threadIndexes(nThreads);
-        for (unsigned int i = 0; i < nThreads; ++i) {
-            threadIndexes[i] = i;
+        // The scheduler executes at most one call per worker at a time, plus one in this thread.
+        /// DON'T change the number of workers, this is a global application setting, and see the documentation excerpt above
+        OfxThreadTasks tasks(func, nThreads, spawnerThread, customArg);
+        try {
+            appPTR->getTaskScheduler()->run(&tasks, (int)nThreads);
+        } catch (...) {
+            return kOfxStatFailed;
         }
 
-        /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
-        //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(threadFunctionWrapper, func, _1, nThreads, spawnerThread, customArg) );
-        future.waitForFinished();
-        ///DON'T reset back to the original value the maximum thread count
-        //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
-
-        for (QFuture<OfxStatus>::const_iterator it = future.begin(); it != future.end(); ++it) {
+        const std::vector<OfxStatus>& status = tasks.getStatus();
+        for (std::vector<OfxStatus>::const_iterator it = status.begin(); it != status.end(); ++it) {
             OfxStatus stat = *it;
             if (stat != kOfxStatOK) {
                 return stat;
@@ -1445,6 +1480,8 @@ OfxHost::multiThreadNumCPUS(unsigned int *nCPUs) const
 #ifndef NATRON_PLAYBACK_USES_THREAD_POOL
         activeThreadsCount += appPTR->getNRunningThreads();
 #endif
+        // and the workers of the task scheduler busy with tiles or other multi-thread suite calls
+        activeThreadsCount += appPTR->getTaskScheduler()->getActiveWorkersCount();
 
         // Clamp to 0
         activeThreadsCount = std::max( 0, activeThreadsCount);
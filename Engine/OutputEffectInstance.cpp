@@ -506,6 +506,56 @@ OutputEffectInstance::reportStats(int time,
         ofile << "Nb cache miss: " << nbCacheMiss << std::endl;
         ofile << "Nb cache hit requiring mipmap downscaling: " << nbCacheHitButDownscaled << std::endl;
 
+        const std::map<int, int>& cacheLockContentions = it->second.getCacheLockContentions();
+        int nbCacheLockContentions = 0;
+        for (std::map<int, int>::const_iterator it2 = cacheLockContentions.begin(); it2 != cacheLockContentions.end(); ++it2) {
+            nbCacheLockContentions += it2->second;
+        }
+        ofile << "Nb cache look-ups and creations waiting on a locked cache bucket: " << nbCacheLockContentions << std::endl;
+        if ( !cacheLockContentions.empty() ) {
+            ofile << "Cache lock contentions per bucket: ";
+            for (std::map<int, int>::const_iterator it2 = cacheLockContentions.begin(); it2 != cacheLockContentions.end(); ++it2) {
+                ofile << it2->first << ':' << it2->second << ' ';
+            }
+            ofile << std::endl;
+        }
+
+        int nbKnobsSnapshotReads, nbKnobsLockedReads;
+        it->second.getKnobsReads(&nbKnobsSnapshotReads, &nbKnobsLockedReads);
+        if ( (nbKnobsSnapshotReads > 0) || (nbKnobsLockedReads > 0) ) {
+            ofile << "Nb parameter values read from the render snapshot: " << nbKnobsSnapshotReads << std::endl;
+            ofile << "Nb parameter values read by locking the parameter: " << nbKnobsLockedReads << std::endl;
+        }
+
+        int nbInputConversions, nbInputSharedConversions;
+        U64 nbInputBytesConverted;
+        it->second.getInputImagesConversions(&nbInputConversions, &nbInputSharedConversions, &nbInputBytesConverted);
+        if (nbInputConversions > 0) {
+            ofile << "Nb input images converted to the clip preferences: " << nbInputConversions << std::endl;
+            ofile << "Nb input images conversions shared between render threads: " << nbInputSharedConversions << std::endl;
+            ofile << "Input images bytes converted: " << nbInputBytesConverted << std::endl;
+        }
+
+        int nbTileTasks, nbTileTasksRunBySpawner, nbTileTasksStolen;
+        double tileTasksWaitTime, tileTasksRunTime;
+        it->second.getTileTasksInfos(&nbTileTasks, &nbTileTasksRunBySpawner, &nbTileTasksStolen, &tileTasksWaitTime, &tileTasksRunTime);
+        if (nbTileTasks > 0) {
+            ofile << "Nb tiles rendered in parallel: " << nbTileTasks << std::endl;
+            ofile << "Nb tiles rendered by the calling thread: " << nbTileTasksRunBySpawner << std::endl;
+            ofile << "Nb tiles stolen by an idle thread: " << nbTileTasksStolen << std::endl;
+            ofile << "Average tile wait time: " << Timer::printAsTime(tileTasksWaitTime / nbTileTasks, false).toStdString() << std::endl;
+            ofile << "Average tile render time: " << Timer::printAsTime(tileTasksRunTime / nbTileTasks, false).toStdString() << std::endl;
+        }
+
+        int nbParallelRenders = it->second.getNbParallelRenders();
+        if (nbParallelRenders > 0) {
+            ofile << "Nb frames rendered in parallel: " << nbParallelRenders << std::endl;
+            const std::string& decision = it->second.getParallelRendersDecision();
+            if ( !decision.empty() ) {
+                ofile << "Last parallel renders adjustment: " << decision << std::endl;
+            }
+        }
+
         const std::set<std::string> & planes = it->second.getPlanesRendered();
         ofile << "Plane(s) rendered: ";
         for (std::set<std::string>::const_iterator it2 = planes.begin(); it2 != planes.end(); ++it2) {
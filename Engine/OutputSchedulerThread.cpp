@@ -59,8 +59,10 @@
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderThreadsController.h"
 #include "Engine/RotoContext.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Timer.h"
 #include "Engine/TimeLine.h"
 #include "Engine/TLSHolder.h"
@@ -219,6 +221,9 @@ struct OutputSchedulerThreadPrivate
     ///Render threads wait in this condition and the scheduler wake them when it needs to render some frames
     QWaitCondition framesToRenderNotEmptyCond;
 
+    ///Chooses the number of render threads when adaptive parallel renders are enabled
+    RenderThreadsController threadsController;
+
 #endif
 
     ///Work queue filled by the scheduler thread when in playback/render on disk
@@ -268,6 +273,7 @@ struct OutputSchedulerThreadPrivate
         , allRenderThreadsQuitCond()
         , framesToRender()
         , framesToRenderNotEmptyCond()
+        , threadsController()
 #endif
         , framesToRenderMutex()
         , lastFramePushedIndex(0)
@@ -1035,6 +1041,16 @@ OutputSchedulerThread::startRender()
     // Start measuring
     _imp->renderTimer.reset(new TimeLapse);
 
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    if ( appPTR->isAdaptiveParallelRendersEnabled() ) {
+        // Start from the user setting if there is one, else from half of the cores, and let the controller adjust
+        int maxThreads = std::max(1, appPTR->getHardwareIdealThreadCount());
+        int userSettingParallelThreads = appPTR->getCurrentSettings()->getNumberOfParallelRenders();
+        int initialThreads = (userSettingParallelThreads > 0) ? userSettingParallelThreads : maxThreads / 2;
+        _imp->threadsController.start(initialThreads, maxThreads);
+    }
+#endif
+
     ///We will push frame to renders starting at startingFrame.
     ///They will be in the range determined by firstFrame-lastFrame
     int startingFrame;
@@ -1209,6 +1225,9 @@ OutputSchedulerThread::stopRender()
     }
 
     _imp->renderTimer.reset();
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    _imp->threadsController.stop();
+#endif
 } // OutputSchedulerThread::stopRender
 
 GenericSchedulerThread::ThreadStateEnum
@@ -1511,14 +1530,33 @@ OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads,
     ///How many parallel renders the user wants
     int userSettingParallelThreads = appPTR->getCurrentSettings()->getNumberOfParallelRenders();
 
-    ///How many threads are running in the application
-    int runningThreads = appPTR->getNRunningThreads() + QThreadPool::globalInstance()->activeThreadCount();
+    ///How many threads are running in the application, including the task scheduler workers rendering tiles
+    int runningThreads = appPTR->getNRunningThreads() + QThreadPool::globalInstance()->activeThreadCount() +
+                         appPTR->getTaskScheduler()->getActiveWorkersCount();
 
     ///How many current threads are used by THIS renderer
     int currentParallelRenders = getNRenderThreads();
 
     *lastNThreads = currentParallelRenders;
 
+    if ( _imp->threadsController.isActive() ) {
+        ///The controller measures the CPU activity itself: just follow its decision, one thread at a time
+        optimalNThreads = _imp->threadsController.getThreadsCount();
+        if ( (currentParallelRenders < optimalNThreads) || (currentParallelRenders == 0) ) {
+            QMutexLocker l(&_imp->renderThreadsMutex);
+
+            _imp->appendRunnable( createRunnable() );
+            *newNThreads = currentParallelRenders + 1;
+        } else if (currentParallelRenders > optimalNThreads) {
+            stopRenderThreads(1);
+            *newNThreads = currentParallelRenders - 1;
+        } else {
+            *newNThreads = currentParallelRenders;
+        }
+
+        return;
+    }
+
     if (userSettingParallelThreads == 0) {
         ///User wants it to be automatically computed, do a simple heuristic: launch as many parallel renders
         ///as there are cores
@@ -1548,6 +1586,12 @@ OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads,
     }
 }
 
+void
+OutputSchedulerThread::notifyFrameRenderTime(double renderTime)
+{
+    _imp->threadsController.notifyFrameRendered(renderTime);
+}
+
 #endif // ifndef NATRON_PLAYBACK_USES_THREAD_POOL
 
 void
@@ -1563,6 +1607,11 @@ OutputSchedulerThread::notifyFrameRendered(int frame,
 
     // Report render stats if desired
     OutputEffectInstancePtr effect = _imp->outputEffect.lock();
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    if ( stats && stats->isInDepthProfilingEnabled() && _imp->threadsController.isActive() ) {
+        stats->setParallelRendersInfosForNode( effect->getNode(), getNRenderThreads(), _imp->threadsController.getLastDecision() );
+    }
+#endif
     if (stats) {
         double timeSpentForFrame;
         std::map<NodePtr, NodeRenderStats > statResults = stats->getStats(&timeSpentForFrame);
@@ -2074,7 +2123,9 @@ RenderThreadTask::run()
 #ifdef TRACE_SCHEDULER
         qDebug() << "Parallel Render Thread: Picking frame to render: " << time;
 #endif
+        TimeLapse frameTimer;
         renderFrame(time, viewsToRender, enableRenderStats);
+        _imp->scheduler->notifyFrameRenderTime( frameTimer.getTimeSinceCreation() );
 
         appPTR->getAppTLS()->cleanupTLSForThread();
 
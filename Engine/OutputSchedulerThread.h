@@ -454,6 +454,11 @@ private:
      * @param optimalNThreads[out] Will be set to the new number of threads
      **/
     void adjustNumberOfThreads(int* newNThreads, int *lastNThreads);
+
+    /**
+     * @brief Called by the render threads after each frame, with the time spent rendering it
+     **/
+    void notifyFrameRenderTime(double renderTime);
 #else
     void startTasksFromLastStartedFrame();
     void startTasks(int startingFrame);
@@ -883,6 +883,8 @@ ParallelRenderArgs::ParallelRenderArgs()
     , visitsCount(0)
     , rotoPaintNodes()
     , stats()
+    , knobsSnapshot()
+    , convertedInputImages()
     , openGLContext()
     , textureIndex(0)
     , currentThreadSafety(eRenderSafetyInstanceSafe)
@@ -905,4 +907,60 @@ ParallelRenderArgs::isCurrentFrameRenderNotAbortable() const
     return isRenderResponseToUserInteraction && ( !info || !info->canAbort() );
 }
 
+ConvertedInputImages::ConvertedInputImages()
+    : _lock()
+    , _images()
+{
+}
+
+ConvertedInputImages::~ConvertedInputImages()
+{
+}
+
+ImagePtr
+ConvertedInputImages::findConvertedImage(const ImagePtr& source,
+                                         const ImagePlaneDesc& components,
+                                         ImageBitDepthEnum depth,
+                                         ImagePremultiplicationEnum outputPremult,
+                                         int channelForAlpha,
+                                         const RectI& roi) const
+{
+    RectI clippedRoi;
+
+    if ( !roi.intersect(source->getBounds(), &clippedRoi) ) {
+        return ImagePtr();
+    }
+
+    QMutexLocker k(&_lock);
+    for (std::list<ConvertedImage>::const_iterator it = _images.begin(); it != _images.end(); ++it) {
+        if ( (it->source == source) &&
+             ( it->converted->getBitDepth() == depth) &&
+             ( it->converted->getComponents() == components) &&
+             ( it->outputPremult == outputPremult) &&
+             ( it->channelForAlpha == channelForAlpha) &&
+             it->converted->getBounds().contains(clippedRoi) ) {
+            return it->converted;
+        }
+    }
+
+    return ImagePtr();
+}
+
+void
+ConvertedInputImages::addConvertedImage(const ImagePtr& source,
+                                        const ImagePtr& converted,
+                                        ImagePremultiplicationEnum outputPremult,
+                                        int channelForAlpha)
+{
+    ConvertedImage image;
+
+    image.source = source;
+    image.converted = converted;
+    image.outputPremult = outputPremult;
+    image.channelForAlpha = channelForAlpha;
+
+    QMutexLocker k(&_lock);
+    _images.push_back(image);
+}
+
 NATRON_NAMESPACE_EXIT
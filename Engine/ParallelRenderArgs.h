@@ -31,6 +31,8 @@
 #include <map>
 #include <list>
 
+#include <QtCore/QMutex>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
@@ -68,6 +70,49 @@ typedef boost::shared_ptr<InputMatrixMap> InputMatrixMapPtr;
 
 class NodeFrameRequest;
 
+/**
+ * @brief The input images of an effect converted to the components and bit depth of its clip preferences
+ * during the render of a frame. They are shared by the render threads of the frame, so that the pixels of
+ * an input are converted only once when several tiles or several fetches of the plug-in need them.
+ **/
+class ConvertedInputImages
+{
+public:
+
+    ConvertedInputImages();
+
+    ~ConvertedInputImages();
+
+    /**
+     * @brief Returns a conversion of source to the given format containing the pixels of roi that are in the
+     * bounds of source, or NULL if there is none yet.
+     **/
+    ImagePtr findConvertedImage(const ImagePtr& source,
+                                const ImagePlaneDesc& components,
+                                ImageBitDepthEnum depth,
+                                ImagePremultiplicationEnum outputPremult,
+                                int channelForAlpha,
+                                const RectI& roi) const WARN_UNUSED_RETURN;
+
+    void addConvertedImage(const ImagePtr& source,
+                           const ImagePtr& converted,
+                           ImagePremultiplicationEnum outputPremult,
+                           int channelForAlpha);
+
+private:
+
+    struct ConvertedImage
+    {
+        ImagePtr source;
+        ImagePtr converted;
+        ImagePremultiplicationEnum outputPremult;
+        int channelForAlpha;
+    };
+
+    mutable QMutex _lock;
+    std::list<ConvertedImage> _images;
+};
+
 /**
  * @brief Thread-local arguments given to render a frame by the tree.
  * This is different than the RenderArgs because it is not local to a
@@ -117,6 +162,13 @@ public:
     ///Various stats local to the render of a frame
     RenderStatsPtr stats;
 
+    ///The values of the knobs of the node read by the render threads of this frame, NULL for analysis renders
+    ///which may change the knobs values
+    KnobsSnapshotPtr knobsSnapshot;
+
+    ///The input images converted to the clip preferences of the node for this frame, shared by its render threads
+    ConvertedInputImagesPtr convertedInputImages;
+
     ///The OpenGL context to use for the render of this frame
     OSGLContextWPtr openGLContext;
 
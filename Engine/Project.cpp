@@ -25,8 +25,10 @@
 #include "Project.h"
 
 #include <fstream>
+#include <sstream> // istringstream, ostringstream
 #include <algorithm> // min, max
 #include <ios>
+#include <iterator> // istreambuf_iterator
 #include <cstdlib> // strtoul
 #include <cerrno> // errno
 #include <cassert>
@@ -48,6 +50,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #endif
 
 
+#include <QtCore/QByteArray>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QTimer>
 #include <QtCore/QThread>
@@ -92,6 +95,22 @@ NATRON_NAMESPACE_ENTER
 using std::cout; using std::endl;
 using std::make_pair;
 
+// Binary project files start with a text line "NatronBinaryProject <version> <flags>", followed by a boost binary archive
+// of the same serialization objects as XML projects, compressed with qCompress if NATRON_BINARY_PROJECT_COMPRESSED is set.
+#define NATRON_BINARY_PROJECT_SIGNATURE "NatronBinaryProject"
+#define NATRON_BINARY_PROJECT_VERSION 1
+#define NATRON_BINARY_PROJECT_COMPRESSED 0x1
+
+// Auto-saves are journals: a text line "NatronAutoSaveJournal <version>", a snapshot frame holding the binary archive of the
+// whole project, then a record frame holding the ProjectJournalRecord of each following auto-save.
+// Each frame is a text line "<type> <size>" followed by size bytes.
+#define NATRON_AUTOSAVE_JOURNAL_SIGNATURE "NatronAutoSaveJournal"
+#define NATRON_AUTOSAVE_JOURNAL_VERSION 1
+#define NATRON_AUTOSAVE_JOURNAL_SNAPSHOT 'S'
+#define NATRON_AUTOSAVE_JOURNAL_RECORD 'R'
+// The journal is compacted into a new snapshot after this many records, or when the records get larger than the snapshot
+#define NATRON_AUTOSAVE_JOURNAL_MAX_RECORDS 50
+
 
 static std::string
 getUserName()
@@ -274,6 +293,152 @@ Project::loadProject(const QString & path,
     return true;
 } // loadProject
 
+/**
+ * @brief Returns true if the file is a binary project file, in which case flags is set to the flags of its header.
+ * Throws if the binary project was written by a more recent version of the format.
+ **/
+static bool
+isBinaryProjectFile(const QString & filePath,
+                    unsigned int* flags)
+{
+    QFile f(filePath);
+
+    if ( !f.open(QIODevice::ReadOnly) ) {
+        return false;
+    }
+    QList<QByteArray> fields = f.readLine(128).trimmed().split(' ');
+    if ( (fields.size() != 3) || (fields[0] != NATRON_BINARY_PROJECT_SIGNATURE) ) {
+        return false;
+    }
+    bool versionOk, flagsOk;
+    int version = fields[1].toInt(&versionOk);
+    *flags = fields[2].toUInt(&flagsOk);
+    if (!versionOk || !flagsOk) {
+        return false;
+    }
+    if (version > NATRON_BINARY_PROJECT_VERSION) {
+        throw std::runtime_error( Project::tr("This binary project file was saved by a more recent version of %1.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ).toStdString() );
+    }
+
+    return true;
+}
+
+static void
+writeBinaryProjectHeader(std::ostream & stream,
+                         unsigned int flags)
+{
+    stream << NATRON_BINARY_PROJECT_SIGNATURE << ' ' << NATRON_BINARY_PROJECT_VERSION << ' ' << flags << '\n';
+}
+
+/**
+ * @brief Returns true if the file is an auto-save journal.
+ * Throws if the journal was written by a more recent version of the format.
+ **/
+static bool
+isAutoSaveJournalFile(const QString & filePath)
+{
+    QFile f(filePath);
+
+    if ( !f.open(QIODevice::ReadOnly) ) {
+        return false;
+    }
+    QList<QByteArray> fields = f.readLine(128).trimmed().split(' ');
+    if ( (fields.size() != 2) || (fields[0] != NATRON_AUTOSAVE_JOURNAL_SIGNATURE) ) {
+        return false;
+    }
+    bool versionOk;
+    int version = fields[1].toInt(&versionOk);
+    if (!versionOk) {
+        return false;
+    }
+    if (version > NATRON_AUTOSAVE_JOURNAL_VERSION) {
+        throw std::runtime_error( Project::tr("This auto-save was written by a more recent version of %1.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ).toStdString() );
+    }
+
+    return true;
+}
+
+static void
+writeAutoSaveJournalFrame(std::ostream & stream,
+                          char type,
+                          const std::string & data)
+{
+    stream << type << ' ' << data.size() << '\n';
+    stream.write( data.data(), data.size() );
+}
+
+/**
+ * @brief Reads the next frame of an auto-save journal. Returns false at the end of the journal or if the frame
+ * is incomplete, which happens if the application was killed while writing it.
+ **/
+static bool
+readAutoSaveJournalFrame(std::istream & stream,
+                         char* type,
+                         std::string* data)
+{
+    std::string line;
+
+    if ( !std::getline(stream, line) ) {
+        return false;
+    }
+    std::istringstream lineStream(line);
+    std::size_t size;
+    if ( !(lineStream >> *type >> size) ) {
+        return false;
+    }
+    data->resize(size);
+    if (size == 0) {
+        return true;
+    }
+    stream.read(&(*data)[0], size);
+
+    return (std::size_t)stream.gcount() == size;
+}
+
+/**
+ * @brief Returns the serialization age of the top-level nodes of the project, which are the ones serialized by the
+ * ProjectSerialization (the nodes of groups are serialized by their group).
+ **/
+static void
+getTopLevelNodesAges(const Project & project,
+                     ProjectPrivate::NodesAgesMap* ages)
+{
+    NodesList nodes;
+
+    project.getActiveNodes(&nodes);
+    for (NodesList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        if ( !(*it)->getParentMultiInstance() && (*it)->isPartOfProject() ) {
+            (*ages)[(*it)->getScriptName_mt_safe()] = std::make_pair( NodeWPtr(*it), (*it)->getSerializationAge() );
+        }
+    }
+}
+
+template <class Archive>
+bool
+Project::loadFromArchive(Archive & archive,
+                         const QString & path,
+                         const QString & name,
+                         bool isAutoSave,
+                         bool* mustSave)
+{
+    bool ret;
+    bool bgProject;
+    {
+        FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
+
+        archive >> boost::serialization::make_nvp("Background_project", bgProject);
+        ProjectSerialization projectSerializationObj( getApp() );
+        archive >> boost::serialization::make_nvp("Project", projectSerializationObj);
+        ret = load(projectSerializationObj, name, path, mustSave);
+    } // __raii_loadingProjectInternal__
+
+    if (!bgProject) {
+        getApp()->loadProjectGui(isAutoSave, archive);
+    }
+
+    return ret;
+}
+
 bool
 Project::loadProjectInternal(const QString & path,
                              const QString & name,
@@ -290,13 +455,16 @@ Project::loadProjectInternal(const QString & path,
     }
 
     bool ret = false;
+    unsigned int binaryFlags = 0;
+    bool isBinary = isBinaryProjectFile(filePath, &binaryFlags);
+    bool isJournal = !isBinary && isAutoSaveJournalFile(filePath);
     FStreamsSupport::ifstream ifile;
-    FStreamsSupport::open( &ifile, filePath.toStdString() );
+    FStreamsSupport::open( &ifile, filePath.toStdString(), (isBinary || isJournal) ? (std::ios_base::in | std::ios_base::binary) : std::ios_base::in );
     if (!ifile) {
         throw std::runtime_error( tr("Failed to open %1").arg(filePath).toStdString() );
     }
 
-    if ( (NATRON_VERSION_MAJOR == 1) && (NATRON_VERSION_MINOR == 0) && (NATRON_VERSION_REVISION == 0) ) {
+    if ( !isBinary && !isJournal && (NATRON_VERSION_MAJOR == 1) && (NATRON_VERSION_MINOR == 0) && (NATRON_VERSION_REVISION == 0) ) {
         ///Try to determine if the project was made during Natron v1.0.0 - RC2 or RC3 to detect a bug we introduced at that time
         ///in the BezierCP class serialisation
         bool foundV = false;
@@ -320,19 +488,30 @@ Project::loadProjectInternal(const QString & path,
     LoadProjectSplashScreen_RAII __raii_splashscreen__(getApp(), name);
 
     try {
-        bool bgProject;
-        boost::archive::xml_iarchive iArchive(ifile);
-        {
-            FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
-
-            iArchive >> boost::serialization::make_nvp("Background_project", bgProject);
-            ProjectSerialization projectSerializationObj( getApp() );
-            iArchive >> boost::serialization::make_nvp("Project", projectSerializationObj);
-            ret = load(projectSerializationObj, name, path, mustSave);
-        } // __raii_loadingProjectInternal__
-
-        if (!bgProject) {
-            getApp()->loadProjectGui(isAutoSave, iArchive);
+        if (isJournal) {
+            ret = loadFromAutoSaveJournal(ifile, path, name, isAutoSave, mustSave);
+        } else if (!isBinary) {
+            boost::archive::xml_iarchive iArchive(ifile);
+            ret = loadFromArchive(iArchive, path, name, isAutoSave, mustSave);
+        } else {
+            // Skip the header line
+            std::string header;
+            std::getline(ifile, header);
+            if (binaryFlags & NATRON_BINARY_PROJECT_COMPRESSED) {
+                std::string compressed( (std::istreambuf_iterator<char>(ifile)), std::istreambuf_iterator<char>() );
+                QByteArray data = qUncompress( reinterpret_cast<const uchar*>( compressed.data() ), (int)compressed.size() );
+                if ( data.isEmpty() ) {
+                    throw std::runtime_error("Failed to uncompress the project");
+                }
+                compressed.clear();
+                std::istringstream iss(std::string( data.constData(), data.size() ), std::ios_base::in | std::ios_base::binary);
+                data.clear();
+                boost::archive::binary_iarchive iArchive(iss);
+                ret = loadFromArchive(iArchive, path, name, isAutoSave, mustSave);
+            } else {
+                boost::archive::binary_iarchive iArchive(ifile);
+                ret = loadFromArchive(iArchive, path, name, isAutoSave, mustSave);
+            }
         }
     } catch (...) {
         const ProjectBeingLoadedInfo& pInfo = getApp()->getProjectBeingLoadedInfo();
@@ -442,7 +621,7 @@ Project::saveProject_imp(const QString & path,
             removeLastAutosave();
 
             //}
-        } else {
+        } else if ( !updateProjectProperties || !appendAutoSaveJournalRecord(&ret) ) {
             if (updateProjectProperties) {
                 ///Replace the last auto-save with a more recent one
                 removeLastAutosave();
@@ -473,6 +652,24 @@ Project::saveProject_imp(const QString & path,
     return true;
 } // Project::saveProject_imp
 
+template <class Archive>
+void
+Project::saveToArchive(Archive & archive)
+{
+    bool bgProject = getApp()->isBackground();
+
+    archive << boost::serialization::make_nvp("Background_project", bgProject);
+    ProjectSerialization projectSerializationObj( getApp() );
+    save(&projectSerializationObj);
+    archive << boost::serialization::make_nvp("Project", projectSerializationObj);
+    if (!bgProject) {
+        AppInstancePtr app = getApp();
+        if (app) {
+            app->saveProjectGui(archive);
+        }
+    }
+}
+
 static bool
 fileCopy(const QString & source,
          const QString & dest)
@@ -546,9 +743,15 @@ Project::saveProjectInternal(const QString & path,
     StrUtils::ensureLastPathSeparator(tmpFilename);
     tmpFilename.append( QString::number( time.toMSecsSinceEpoch() ) );
 
+    // Auto-saves start a new journal, except the ones used to render in a background process which must be regular projects
+    bool isJournal = autoSave && !isRenderSave;
+    ProjectPrivate::NodesAgesMap journalNodes;
+    qint64 journalSnapshotSize = 0;
+    Settings::ProjectFileFormatEnum fileFormat = appPTR->getCurrentSettings()->getProjectFileFormat();
     {
         FStreamsSupport::ofstream ofile;
-        FStreamsSupport::open( &ofile, tmpFilename.toStdString() );
+        FStreamsSupport::open( &ofile, tmpFilename.toStdString(),
+                               (fileFormat == Settings::eProjectFileFormatXML && !isJournal) ? std::ios_base::out : (std::ios_base::out | std::ios_base::binary) );
         if (!ofile) {
             throw std::runtime_error( tr("Failed to open file ").toStdString() + tmpFilename.toStdString() );
         }
@@ -564,18 +767,48 @@ Project::saveProjectInternal(const QString & path,
         }
 
         try {
-            boost::archive::xml_oarchive oArchive(ofile);
-            bool bgProject = getApp()->isBackground();
-            oArchive << boost::serialization::make_nvp("Background_project", bgProject);
-            ProjectSerialization projectSerializationObj( getApp() );
-            save(&projectSerializationObj);
-            oArchive << boost::serialization::make_nvp("Project", projectSerializationObj);
-            if (!bgProject) {
-                AppInstancePtr app = getApp();
-                if (app) {
-                    app->saveProjectGui(oArchive);
+            if (isJournal) {
+                // Read the ages before serializing so that the nodes changed meanwhile are written by the next record
+                getTopLevelNodesAges(*this, &journalNodes);
+                std::ostringstream oss(std::ios_base::out | std::ios_base::binary);
+                {
+                    boost::archive::binary_oarchive oArchive(oss);
+                    saveToArchive(oArchive);
+                }
+                std::string data = oss.str();
+                ofile << NATRON_AUTOSAVE_JOURNAL_SIGNATURE << ' ' << NATRON_AUTOSAVE_JOURNAL_VERSION << '\n';
+                writeAutoSaveJournalFrame(ofile, NATRON_AUTOSAVE_JOURNAL_SNAPSHOT, data);
+                journalSnapshotSize = (qint64)data.size();
+            } else {
+                switch (fileFormat) {
+                case Settings::eProjectFileFormatXML: {
+                    boost::archive::xml_oarchive oArchive(ofile);
+                    saveToArchive(oArchive);
+                    break;
+                }
+                case Settings::eProjectFileFormatBinary: {
+                    writeBinaryProjectHeader(ofile, 0);
+                    boost::archive::binary_oarchive oArchive(ofile);
+                    saveToArchive(oArchive);
+                    break;
+                }
+                case Settings::eProjectFileFormatBinaryCompressed: {
+                    std::ostringstream oss(std::ios_base::out | std::ios_base::binary);
+                    {
+                        boost::archive::binary_oarchive oArchive(oss);
+                        saveToArchive(oArchive);
+                    }
+                    std::string data = oss.str();
+                    QByteArray compressed = qCompress( reinterpret_cast<const uchar*>( data.data() ), (int)data.size() );
+                    writeBinaryProjectHeader(ofile, NATRON_BINARY_PROJECT_COMPRESSED);
+                    ofile.write( compressed.constData(), compressed.size() );
+                    break;
+                }
                 }
             }
+            if (!ofile) {
+                throw std::runtime_error( tr("Failed to write file ").toStdString() + tmpFilename.toStdString() );
+            }
         } catch (...) {
             if (!autoSave && updateProjectProperties) {
                 ///Reset the old project path in case of failure.
@@ -600,6 +833,14 @@ Project::saveProjectInternal(const QString & path,
 
     QFile::remove(tmpFilename);
 
+    if (isJournal && updateProjectProperties) {
+        QMutexLocker k(&_imp->autoSaveJournalMutex);
+        _imp->autoSaveJournalFilePath = filePath;
+        _imp->autoSaveJournalNodes = journalNodes;
+        _imp->autoSaveJournalRecordsCount = 0;
+        _imp->autoSaveJournalSnapshotSize = journalSnapshotSize;
+    }
+
     if (!autoSave && updateProjectProperties) {
         QString lockFilePath = getLockAbsoluteFilePath();
         if ( QFile::exists(lockFilePath) ) {
@@ -631,6 +872,157 @@ Project::saveProjectInternal(const QString & path,
     return filePath;
 } // saveProjectInternal
 
+bool
+Project::appendAutoSaveJournalRecord(QString* filePath)
+{
+    // The Python callback may need the auto-save to be a complete project
+    if ( !_imp->onProjectSaveCB->getValue().empty() ) {
+        return false;
+    }
+
+    QMutexLocker k(&_imp->autoSaveJournalMutex);
+    if ( _imp->autoSaveJournalFilePath.isEmpty() || (_imp->autoSaveJournalRecordsCount >= NATRON_AUTOSAVE_JOURNAL_MAX_RECORDS) ) {
+        return false;
+    }
+    QFileInfo journalInfo(_imp->autoSaveJournalFilePath);
+    if ( !journalInfo.exists() || (journalInfo.size() > 2 * _imp->autoSaveJournalSnapshotSize) ) {
+        return false;
+    }
+
+    ProjectPrivate::NodesAgesMap nodesAges;
+    getTopLevelNodesAges(*this, &nodesAges);
+
+    NodesList changedNodes;
+    for (ProjectPrivate::NodesAgesMap::iterator it = nodesAges.begin(); it != nodesAges.end(); ++it) {
+        NodePtr node = it->second.first.lock();
+        if (!node) {
+            continue;
+        }
+        ProjectPrivate::NodesAgesMap::iterator found = _imp->autoSaveJournalNodes.find(it->first);
+        if ( ( found == _imp->autoSaveJournalNodes.end() ) || (found->second.first.lock() != node) || (found->second.second != it->second.second) ) {
+            changedNodes.push_back(node);
+        }
+    }
+    std::list<std::string> removedNodes;
+    for (ProjectPrivate::NodesAgesMap::iterator it = _imp->autoSaveJournalNodes.begin(); it != _imp->autoSaveJournalNodes.end(); ++it) {
+        if ( nodesAges.find(it->first) == nodesAges.end() ) {
+            removedNodes.push_back(it->first);
+        }
+    }
+
+    ProjectJournalRecord record;
+    record.initialize(this, changedNodes, removedNodes);
+
+    AppInstancePtr app = getApp();
+    if ( !app->isBackground() ) {
+        std::ostringstream guiStream(std::ios_base::out | std::ios_base::binary);
+        {
+            boost::archive::binary_oarchive guiArchive(guiStream);
+            app->saveProjectGui(guiArchive);
+        }
+        record.setGuiData( guiStream.str() );
+    }
+
+    std::ostringstream recordStream(std::ios_base::out | std::ios_base::binary);
+    {
+        boost::archive::binary_oarchive recordArchive(recordStream);
+        recordArchive << boost::serialization::make_nvp("Record", record);
+    }
+
+    {
+        FStreamsSupport::ofstream ofile;
+        FStreamsSupport::open( &ofile, _imp->autoSaveJournalFilePath.toStdString(), std::ios_base::out | std::ios_base::app | std::ios_base::binary );
+        if (ofile) {
+            writeAutoSaveJournalFrame(ofile, NATRON_AUTOSAVE_JOURNAL_RECORD, recordStream.str());
+            ofile.flush();
+        }
+        if (!ofile) {
+            // The records following a partially written record could not be read: write a new snapshot instead
+            qDebug() << "Failed to append to the auto-save journal" << _imp->autoSaveJournalFilePath;
+
+            return false;
+        }
+    } // ofile
+
+    _imp->autoSaveJournalNodes = nodesAges;
+    ++_imp->autoSaveJournalRecordsCount;
+    *filePath = _imp->autoSaveJournalFilePath;
+    k.unlock();
+
+    _imp->lastAutoSave = QDateTime::currentDateTime();
+    QString projectPath = QString::fromUtf8( _imp->getProjectPath().c_str() );
+    QString projectFilename = QString::fromUtf8( _imp->getProjectFilename().c_str() );
+    Q_EMIT projectNameChanged(projectPath + projectFilename, true);
+
+    return true;
+} // Project::appendAutoSaveJournalRecord
+
+bool
+Project::loadFromAutoSaveJournal(std::istream & stream,
+                                 const QString & path,
+                                 const QString & name,
+                                 bool isAutoSave,
+                                 bool* mustSave)
+{
+    // Skip the header line
+    std::string header;
+    std::getline(stream, header);
+
+    char type;
+    std::string snapshot;
+    if ( !readAutoSaveJournalFrame(stream, &type, &snapshot) || (type != NATRON_AUTOSAVE_JOURNAL_SNAPSHOT) ) {
+        throw std::runtime_error("The auto-save journal has no snapshot");
+    }
+
+    std::istringstream snapshotStream(snapshot, std::ios_base::in | std::ios_base::binary);
+    boost::archive::binary_iarchive snapshotArchive(snapshotStream);
+    bool bgProject;
+    snapshotArchive >> boost::serialization::make_nvp("Background_project", bgProject);
+    ProjectSerialization projectSerializationObj( getApp() );
+    snapshotArchive >> boost::serialization::make_nvp("Project", projectSerializationObj);
+
+    // Apply the records in order. The last one may be incomplete if the application was killed while writing it.
+    std::string guiData;
+    std::string data;
+    while ( readAutoSaveJournalFrame(stream, &type, &data) ) {
+        if (type != NATRON_AUTOSAVE_JOURNAL_RECORD) {
+            continue;
+        }
+        ProjectJournalRecord record;
+        try {
+            std::istringstream recordStream(data, std::ios_base::in | std::ios_base::binary);
+            boost::archive::binary_iarchive recordArchive(recordStream);
+            recordArchive >> boost::serialization::make_nvp("Record", record);
+        } catch (const std::exception & e) {
+            qDebug() << "Ignoring the damaged end of the auto-save journal:" << e.what();
+            break;
+        }
+        projectSerializationObj.applyJournalRecord(record);
+        if ( !record.getGuiData().empty() ) {
+            guiData = record.getGuiData();
+        }
+    }
+
+    bool ret;
+    {
+        FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
+
+        ret = load(projectSerializationObj, name, path, mustSave);
+    } // __raii_loadingProjectInternal__
+
+    if (!bgProject) {
+        if ( guiData.empty() ) {
+            getApp()->loadProjectGui(isAutoSave, snapshotArchive);
+        } else {
+            std::istringstream guiStream(guiData, std::ios_base::in | std::ios_base::binary);
+            boost::archive::binary_iarchive guiArchive(guiStream);
+            getApp()->loadProjectGui(isAutoSave, guiArchive);
+        }
+    }
+
+    return ret;
+} // Project::loadFromAutoSaveJournal
+
 void
 Project::autoSave()
 {
@@ -679,7 +1071,8 @@ Project::onAutoSaveTimerTriggered()
 
     ///check that all schedulers are not working.
     ///If so launch an auto-save, otherwise, restart the timer.
-    bool canAutoSave = !hasNodeRendering() && !getApp()->isShowingDialog();
+    ///Also wait for the previous auto-save to be done rather than piling them up.
+    bool canAutoSave = !hasNodeRendering() && !getApp()->isShowingDialog() && _imp->autoSaveFutures.empty();
 
     if (canAutoSave) {
         boost::shared_ptr<QFutureWatcher<void> > watcher = boost::make_shared<QFutureWatcher<void> >();
@@ -1789,6 +2182,7 @@ Project::removeLastAutosave()
     if ( !filepath.isEmpty() ) {
         QFile::remove(filepath);
     }
+    _imp->resetAutoSaveJournal();
 
     /*
      * Since we may have saved the project to an old project, overwritting the existing file, there might be
@@ -1956,6 +2350,7 @@ Project::doResetEnd(bool aboutToQuit)
             _imp->autoSaveTimer->stop();
             _imp->additionalFormats.clear();
         }
+        _imp->resetAutoSaveJournal();
         getApp()->removeAllKeyframesIndicators();
 
         Q_EMIT projectNameChanged(QString::fromUtf8(NATRON_PROJECT_UNTITLED), false);
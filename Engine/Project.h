@@ -27,6 +27,7 @@
 
 #include "Global/Macros.h"
 
+#include <iosfwd> // istream
 #include <map>
 #include <vector>
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
@@ -387,6 +388,30 @@ private:
 
     QString saveProjectInternal(const QString & path, const QString & name, bool autosave, bool updateProjectProperties);
 
+    /**
+     * @brief Reads the project and its gui layout from the given archive, whatever its format.
+     **/
+    template <class Archive>
+    bool loadFromArchive(Archive & archive, const QString & path, const QString & name, bool isAutoSave, bool* mustSave);
+
+    /**
+     * @brief Writes the project and its gui layout to the given archive, whatever its format.
+     **/
+    template <class Archive>
+    void saveToArchive(Archive & archive);
+
+    /**
+     * @brief Appends the changes of the project since the previous auto-save to the journal of the last auto-save,
+     * which is written again entirely (compacted) when this returns false.
+     * Only the top-level nodes whose serialization age changed are serialized.
+     **/
+    bool appendAutoSaveJournalRecord(QString* filePath);
+
+    /**
+     * @brief Rebuilds the project from the snapshot and the records of an auto-save journal.
+     **/
+    bool loadFromAutoSaveJournal(std::istream & stream, const QString & path, const QString & name, bool isAutoSave, bool* mustSave);
+
 
 
     void doResetEnd(bool aboutToQuit);
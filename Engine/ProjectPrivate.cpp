@@ -89,6 +89,11 @@ ProjectPrivate::ProjectPrivate(Project* project)
     , isSavingProjectMutex()
     , isSavingProject(false)
     , autoSaveTimer( new QTimer() )
+    , autoSaveJournalMutex()
+    , autoSaveJournalFilePath()
+    , autoSaveJournalNodes()
+    , autoSaveJournalRecordsCount(0)
+    , autoSaveJournalSnapshotSize(0)
     , projectClosing(false)
     , tlsData( new TLSHolder<Project::ProjectTLSData>() )
 
@@ -528,4 +533,15 @@ ProjectPrivate::getProjectPath() const
     return projectPath->getValue();
 }
 
+void
+ProjectPrivate::resetAutoSaveJournal()
+{
+    QMutexLocker k(&autoSaveJournalMutex);
+
+    autoSaveJournalFilePath.clear();
+    autoSaveJournalNodes.clear();
+    autoSaveJournalRecordsCount = 0;
+    autoSaveJournalSnapshotSize = 0;
+}
+
 NATRON_NAMESPACE_EXIT
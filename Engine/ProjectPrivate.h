@@ -105,6 +105,16 @@ public:
     bool isSavingProject; //< true when the project is saving
     boost::shared_ptr<QTimer> autoSaveTimer;
     std::list<boost::shared_ptr<QFutureWatcher<void> > > autoSaveFutures;
+
+    // The serialization age of the top-level nodes of the project, by script-name
+    typedef std::map<std::string, std::pair<NodeWPtr, U64> > NodesAgesMap;
+
+    // State of the incremental auto-save journal, see Project::appendAutoSaveJournalRecord
+    mutable QMutex autoSaveJournalMutex; //< protects the autoSaveJournal* members
+    QString autoSaveJournalFilePath; //< the auto-save records are appended to, empty if the next auto-save must write a snapshot
+    NodesAgesMap autoSaveJournalNodes; //< the top-level nodes as they were when last written to the journal
+    int autoSaveJournalRecordsCount;
+    qint64 autoSaveJournalSnapshotSize;
     mutable QMutex projectClosingMutex;
     bool projectClosing;
     boost::shared_ptr<TLSHolder<Project::ProjectTLSData> > tlsData;
@@ -140,6 +150,11 @@ public:
 
     void setProjectPath(const std::string& path);
     std::string getProjectPath() const;
+
+    /**
+     * @brief Makes the next auto-save write a snapshot of the whole project instead of appending to the journal.
+     **/
+    void resetAutoSaveJournal();
     static QString generateStringFromFormat(const Format & f)
     {
         QString formatStr;
@@ -34,15 +34,10 @@
 
 NATRON_NAMESPACE_ENTER
 
-void
-ProjectSerialization::initialize(const Project* project)
+static void
+serializeProjectKnobs(const Project* project,
+                      std::list<KnobSerializationPtr>* projectKnobs)
 {
-    ///All the code in this function is MT-safe
-
-    _nodes.initialize(*project);
-
-    project->getAdditionalFormats(&_additionalFormats);
-
     std::vector<KnobIPtr> knobs = project->getKnobs_mt_safe();
     for (U32 i = 0; i < knobs.size(); ++i) {
         KnobGroup* isGroup = dynamic_cast<KnobGroup*>( knobs[i].get() );
@@ -52,13 +47,62 @@ ProjectSerialization::initialize(const Project* project)
              !isGroup && !isPage && !isButton &&
              knobs[i]->hasModificationsForSerialization() ) {
             KnobSerializationPtr newKnobSer = boost::make_shared<KnobSerialization>(knobs[i]);
-            _projectKnobs.push_back(newKnobSer);
+            projectKnobs->push_back(newKnobSer);
         }
     }
+}
+
+void
+ProjectSerialization::initialize(const Project* project)
+{
+    ///All the code in this function is MT-safe
+
+    _nodes.initialize(*project);
+
+    project->getAdditionalFormats(&_additionalFormats);
+
+    serializeProjectKnobs(project, &_projectKnobs);
 
     _timelineCurrent = project->currentFrame();
 
     _creationDate = project->getProjectCreationTime();
 }
 
+void
+ProjectSerialization::applyJournalRecord(const ProjectJournalRecord& record)
+{
+    const std::list<std::string>& removedNodes = record.getRemovedNodes();
+    for (std::list<std::string>::const_iterator it = removedNodes.begin(); it != removedNodes.end(); ++it) {
+        _nodes.removeNodeSerialization(*it);
+    }
+
+    const std::list<NodeSerializationPtr>& changedNodes = record.getChangedNodes();
+    for (std::list<NodeSerializationPtr>::const_iterator it = changedNodes.begin(); it != changedNodes.end(); ++it) {
+        _nodes.setNodeSerialization(*it);
+    }
+
+    _projectKnobs = record.getProjectKnobsValues();
+    _additionalFormats = record.getAdditionalFormats();
+    _timelineCurrent = record.getCurrentTime();
+}
+
+void
+ProjectJournalRecord::initialize(const Project* project,
+                                 const NodesList& changedNodes,
+                                 const std::list<std::string>& removedNodes)
+{
+    ///All the code in this function is MT-safe
+
+    for (NodesList::const_iterator it = changedNodes.begin(); it != changedNodes.end(); ++it) {
+        _changedNodes.push_back( boost::make_shared<NodeSerialization>(*it) );
+    }
+    _removedNodes = removedNodes;
+
+    project->getAdditionalFormats(&_additionalFormats);
+
+    serializeProjectKnobs(project, &_projectKnobs);
+
+    _timelineCurrent = project->currentFrame();
+}
+
 NATRON_NAMESPACE_EXIT
@@ -33,6 +33,8 @@
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 GCC_DIAG_OFF(unused-parameter)
 // /opt/local/include/boost/serialization/smart_cast.hpp:254:25: warning: unused parameter 'u' [-Wunused-parameter]
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/serialization/list.hpp>
@@ -41,6 +43,7 @@ GCC_DIAG_OFF(unused-parameter)
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/scoped_ptr.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/version.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 GCC_DIAG_ON(unused-parameter)
@@ -91,6 +94,8 @@ public:
     }
 };
 
+class ProjectJournalRecord;
+
 class ProjectSerialization
 {
     NodeCollectionSerialization _nodes;
@@ -154,6 +159,11 @@ public:
         return _creationDate;
     }
 
+    /**
+     * @brief Applies the changes saved in a record of the auto-save journal on top of this serialization.
+     **/
+    void applyJournalRecord(const ProjectJournalRecord& record);
+
     friend class ::boost::serialization::access;
     template<class Archive>
     void save(Archive & ar,
@@ -299,8 +309,119 @@ public:
     BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
+#define PROJECT_JOURNAL_RECORD_VERSION 1
+
+/**
+ * @brief The changes of the project since the previous record of the incremental auto-save journal:
+ * the serialization of the top-level nodes that changed or were created, the script-names of the top-level
+ * nodes that were removed, and the project settings and gui layout, which are small and always saved.
+ **/
+class ProjectJournalRecord
+{
+    std::list<NodeSerializationPtr> _changedNodes;
+    std::list<std::string> _removedNodes;
+    std::list<KnobSerializationPtr> _projectKnobs;
+    std::list<Format> _additionalFormats;
+    SequenceTime _timelineCurrent;
+    std::string _guiData; //< binary archive written by AppInstance::saveProjectGui, empty in background mode
+
+public:
+
+    ProjectJournalRecord()
+        : _timelineCurrent(0)
+    {
+    }
+
+    void initialize(const Project* project,
+                    const NodesList& changedNodes,
+                    const std::list<std::string>& removedNodes);
+
+    const std::list<NodeSerializationPtr>& getChangedNodes() const
+    {
+        return _changedNodes;
+    }
+
+    const std::list<std::string>& getRemovedNodes() const
+    {
+        return _removedNodes;
+    }
+
+    const std::list<KnobSerializationPtr>& getProjectKnobsValues() const
+    {
+        return _projectKnobs;
+    }
+
+    const std::list<Format>& getAdditionalFormats() const
+    {
+        return _additionalFormats;
+    }
+
+    SequenceTime getCurrentTime() const
+    {
+        return _timelineCurrent;
+    }
+
+    const std::string& getGuiData() const
+    {
+        return _guiData;
+    }
+
+    void setGuiData(const std::string& data)
+    {
+        _guiData = data;
+    }
+
+    friend class ::boost::serialization::access;
+    template<class Archive>
+    void save(Archive & ar,
+              const unsigned int /*version*/) const
+    {
+        int nodesCount = (int)_changedNodes.size();
+        ar & ::boost::serialization::make_nvp("ChangedNodesCount", nodesCount);
+        for (std::list<NodeSerializationPtr>::const_iterator it = _changedNodes.begin(); it != _changedNodes.end(); ++it) {
+            ar & ::boost::serialization::make_nvp( "item", **it );
+        }
+        ar & ::boost::serialization::make_nvp("RemovedNodes", _removedNodes);
+        int knobsCount = (int)_projectKnobs.size();
+        ar & ::boost::serialization::make_nvp("ProjectKnobsCount", knobsCount);
+        for (std::list<KnobSerializationPtr>::const_iterator it = _projectKnobs.begin(); it != _projectKnobs.end(); ++it) {
+            ar & ::boost::serialization::make_nvp( "item", **it );
+        }
+        ar & ::boost::serialization::make_nvp("AdditionalFormats", _additionalFormats);
+        ar & ::boost::serialization::make_nvp("Timeline_current_time", _timelineCurrent);
+        ar & ::boost::serialization::make_nvp("Gui", _guiData);
+    }
+
+    template<class Archive>
+    void load(Archive & ar,
+              const unsigned int /*version*/)
+    {
+        int nodesCount;
+        ar & ::boost::serialization::make_nvp("ChangedNodesCount", nodesCount);
+        for (int i = 0; i < nodesCount; ++i) {
+            NodeSerializationPtr ns = boost::make_shared<NodeSerialization>();
+            ar & ::boost::serialization::make_nvp("item", *ns);
+            _changedNodes.push_back(ns);
+        }
+        ar & ::boost::serialization::make_nvp("RemovedNodes", _removedNodes);
+        int knobsCount;
+        ar & ::boost::serialization::make_nvp("ProjectKnobsCount", knobsCount);
+        for (int i = 0; i < knobsCount; ++i) {
+            KnobSerializationPtr ks = boost::make_shared<KnobSerialization>();
+            ar & ::boost::serialization::make_nvp("item", *ks);
+            _projectKnobs.push_back(ks);
+        }
+        ar & ::boost::serialization::make_nvp("AdditionalFormats", _additionalFormats);
+        ar & ::boost::serialization::make_nvp("Timeline_current_time", _timelineCurrent);
+        ar & ::boost::serialization::make_nvp("Gui", _guiData);
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+};
+
 NATRON_NAMESPACE_EXIT
 
 BOOST_CLASS_VERSION(NATRON_NAMESPACE::ProjectSerialization, PROJECT_SERIALIZATION_VERSION)
+BOOST_CLASS_VERSION(NATRON_NAMESPACE::ProjectJournalRecord, PROJECT_JOURNAL_RECORD_VERSION)
 
 #endif // PROJECTSERIALIZATION_H
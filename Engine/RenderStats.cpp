@@ -65,6 +65,29 @@ struct NodeRenderStatsPrivate
     int nbCacheHit;
     int nbCacheHitButDownscaledImages;
 
+    //For each cache bucket, the number of look-ups that had to wait for its lock
+    std::map<int, int> cacheLockContentions;
+
+    //Knob values read by render threads from the knobs snapshot, or from the knobs themselves
+    int nbKnobsSnapshotReads;
+    int nbKnobsLockedReads;
+
+    //Input images converted to the clip preferences of the node, and the conversions shared with another render thread
+    int nbInputImagesConversions;
+    int nbInputImagesSharedConversions;
+    U64 nbInputImagesBytesConverted;
+
+    //Tiles executed by the TaskScheduler: by the thread that started the render, or stolen by an idle worker
+    int nbTileTasks;
+    int nbTileTasksRunBySpawner;
+    int nbTileTasksStolen;
+    double tileTasksWaitTime;
+    double tileTasksRunTime;
+
+    //Number of frames rendered concurrently when adaptive parallel renders are enabled (0 otherwise), and why
+    int nbParallelRenders;
+    std::string parallelRendersDecision;
+
     //Is tile support enabled for this render
     bool tileSupportEnabled;
 
@@ -88,6 +111,19 @@ struct NodeRenderStatsPrivate
         , nbCacheMisses(0)
         , nbCacheHit(0)
         , nbCacheHitButDownscaledImages(0)
+        , cacheLockContentions()
+        , nbKnobsSnapshotReads(0)
+        , nbKnobsLockedReads(0)
+        , nbInputImagesConversions(0)
+        , nbInputImagesSharedConversions(0)
+        , nbInputImagesBytesConverted(0)
+        , nbTileTasks(0)
+        , nbTileTasksRunBySpawner(0)
+        , nbTileTasksStolen(0)
+        , tileTasksWaitTime(0)
+        , tileTasksRunTime(0)
+        , nbParallelRenders(0)
+        , parallelRendersDecision()
         , tileSupportEnabled(false)
         , renderScaleSupportEnabled(false)
         , channelsEnabled()
@@ -127,6 +163,19 @@ NodeRenderStats::operator=(const NodeRenderStats& other)
     _imp->nbCacheMisses = other._imp->nbCacheMisses;
     _imp->nbCacheHit = other._imp->nbCacheHit;
     _imp->nbCacheHitButDownscaledImages = other._imp->nbCacheHitButDownscaledImages;
+    _imp->cacheLockContentions = other._imp->cacheLockContentions;
+    _imp->nbKnobsSnapshotReads = other._imp->nbKnobsSnapshotReads;
+    _imp->nbKnobsLockedReads = other._imp->nbKnobsLockedReads;
+    _imp->nbInputImagesConversions = other._imp->nbInputImagesConversions;
+    _imp->nbInputImagesSharedConversions = other._imp->nbInputImagesSharedConversions;
+    _imp->nbInputImagesBytesConverted = other._imp->nbInputImagesBytesConverted;
+    _imp->nbTileTasks = other._imp->nbTileTasks;
+    _imp->nbTileTasksRunBySpawner = other._imp->nbTileTasksRunBySpawner;
+    _imp->nbTileTasksStolen = other._imp->nbTileTasksStolen;
+    _imp->tileTasksWaitTime = other._imp->tileTasksWaitTime;
+    _imp->tileTasksRunTime = other._imp->tileTasksRunTime;
+    _imp->nbParallelRenders = other._imp->nbParallelRenders;
+    _imp->parallelRendersDecision = other._imp->parallelRendersDecision;
     _imp->tileSupportEnabled = other._imp->tileSupportEnabled;
     _imp->renderScaleSupportEnabled = other._imp->renderScaleSupportEnabled;
     for (int i = 0; i < 4; ++i) {
@@ -253,6 +302,103 @@ NodeRenderStats::getCacheAccessInfos(int* nbCacheMisses,
     *nbCacheHitButDownscaledImages = _imp->nbCacheHitButDownscaledImages;
 }
 
+void
+NodeRenderStats::addCacheLockContention(int cacheBucketIndex)
+{
+    ++_imp->cacheLockContentions[cacheBucketIndex];
+}
+
+const std::map<int, int>&
+NodeRenderStats::getCacheLockContentions() const
+{
+    return _imp->cacheLockContentions;
+}
+
+void
+NodeRenderStats::addKnobsReads(int nbSnapshotReads,
+                               int nbLockedReads)
+{
+    _imp->nbKnobsSnapshotReads += nbSnapshotReads;
+    _imp->nbKnobsLockedReads += nbLockedReads;
+}
+
+void
+NodeRenderStats::getKnobsReads(int* nbSnapshotReads,
+                               int* nbLockedReads) const
+{
+    *nbSnapshotReads = _imp->nbKnobsSnapshotReads;
+    *nbLockedReads = _imp->nbKnobsLockedReads;
+}
+
+void
+NodeRenderStats::addInputImageConversion(U64 nbBytesConverted,
+                                         bool shared)
+{
+    ++_imp->nbInputImagesConversions;
+    if (shared) {
+        ++_imp->nbInputImagesSharedConversions;
+    }
+    _imp->nbInputImagesBytesConverted += nbBytesConverted;
+}
+
+void
+NodeRenderStats::getInputImagesConversions(int* nbConversions,
+                                           int* nbSharedConversions,
+                                           U64* nbBytesConverted) const
+{
+    *nbConversions = _imp->nbInputImagesConversions;
+    *nbSharedConversions = _imp->nbInputImagesSharedConversions;
+    *nbBytesConverted = _imp->nbInputImagesBytesConverted;
+}
+
+void
+NodeRenderStats::addTileTask(const TaskTiming& timing)
+{
+    ++_imp->nbTileTasks;
+    if (timing.runBySpawner) {
+        ++_imp->nbTileTasksRunBySpawner;
+    }
+    if (timing.stolen) {
+        ++_imp->nbTileTasksStolen;
+    }
+    _imp->tileTasksWaitTime += timing.waitTime;
+    _imp->tileTasksRunTime += timing.runTime;
+}
+
+void
+NodeRenderStats::getTileTasksInfos(int* nbTasks,
+                                   int* nbTasksRunBySpawner,
+                                   int* nbTasksStolen,
+                                   double* totalWaitTime,
+                                   double* totalRunTime) const
+{
+    *nbTasks = _imp->nbTileTasks;
+    *nbTasksRunBySpawner = _imp->nbTileTasksRunBySpawner;
+    *nbTasksStolen = _imp->nbTileTasksStolen;
+    *totalWaitTime = _imp->tileTasksWaitTime;
+    *totalRunTime = _imp->tileTasksRunTime;
+}
+
+void
+NodeRenderStats::setParallelRendersInfos(int nbParallelRenders,
+                                         const std::string& decision)
+{
+    _imp->nbParallelRenders = nbParallelRenders;
+    _imp->parallelRendersDecision = decision;
+}
+
+int
+NodeRenderStats::getNbParallelRenders() const
+{
+    return _imp->nbParallelRenders;
+}
+
+const std::string&
+NodeRenderStats::getParallelRendersDecision() const
+{
+    return _imp->parallelRendersDecision;
+}
+
 void
 NodeRenderStats::setTilesSupported(bool tilesSupported)
 {
@@ -414,6 +560,71 @@ RenderStats::addCacheInfosForNode(const NodePtr& node,
     stats.addCacheAccessInfo(isCacheMiss, hasDownscaled);
 }
 
+void
+RenderStats::addCacheLockContentionForNode(const NodePtr& node,
+                                           int cacheBucketIndex)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addCacheLockContention(cacheBucketIndex);
+}
+
+void
+RenderStats::addKnobsReadsForNode(const NodePtr& node,
+                                  int nbSnapshotReads,
+                                  int nbLockedReads)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addKnobsReads(nbSnapshotReads, nbLockedReads);
+}
+
+void
+RenderStats::addInputImageConversionForNode(const NodePtr& node,
+                                            U64 nbBytesConverted,
+                                            bool shared)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addInputImageConversion(nbBytesConverted, shared);
+}
+
+void
+RenderStats::addTileTasksInfosForNode(const NodePtr& node,
+                                      const std::vector<TaskTiming>& timings)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    for (std::size_t i = 0; i < timings.size(); ++i) {
+        stats.addTileTask(timings[i]);
+    }
+}
+
+void
+RenderStats::setParallelRendersInfosForNode(const NodePtr& node,
+                                            int nbParallelRenders,
+                                            const std::string& decision)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.setParallelRendersInfos(nbParallelRenders, decision);
+}
+
 void
 RenderStats::addRenderInfosForNode(const NodePtr& node,
                                    const NodePtr& identity,
@@ -32,6 +32,7 @@
 #include <set>
 #include <string>
 #include <bitset>
+#include <vector>
 
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
@@ -43,6 +44,7 @@
 
 #include "Engine/RectI.h"
 #include "Engine/RectD.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/EngineFwd.h"
 
 NATRON_NAMESPACE_ENTER
@@ -87,6 +89,22 @@ public:
     void addCacheAccessInfo(bool isCacheMiss, bool hasDownscaled);
     void getCacheAccessInfos(int* nbCacheMisses, int* nbCacheHits, int* nbCacheHitButDownscaledImages) const;
 
+    void addCacheLockContention(int cacheBucketIndex);
+    const std::map<int, int>& getCacheLockContentions() const;
+
+    void addKnobsReads(int nbSnapshotReads, int nbLockedReads);
+    void getKnobsReads(int* nbSnapshotReads, int* nbLockedReads) const;
+
+    void addInputImageConversion(U64 nbBytesConverted, bool shared);
+    void getInputImagesConversions(int* nbConversions, int* nbSharedConversions, U64* nbBytesConverted) const;
+
+    void addTileTask(const TaskTiming& timing);
+    void getTileTasksInfos(int* nbTasks, int* nbTasksRunBySpawner, int* nbTasksStolen, double* totalWaitTime, double* totalRunTime) const;
+
+    void setParallelRendersInfos(int nbParallelRenders, const std::string& decision);
+    int getNbParallelRenders() const;
+    const std::string& getParallelRendersDecision() const;
+
     void setTilesSupported(bool tilesSupported);
     bool isTilesSupportEnabled() const;
 
@@ -136,6 +154,43 @@ public:
                               bool isCacheMiss,
                               bool hasDownscaled);
 
+    /**
+     * @brief Records that a cache look-up or creation of an image of the node had to wait for another thread holding the lock of the given cache bucket.
+     **/
+    void addCacheLockContentionForNode(const NodePtr& node,
+                                       int cacheBucketIndex);
+
+    /**
+     * @brief Records the number of knob values read by the render threads of the node from its knobs snapshot
+     * and the number of reads that had to lock the knobs, @see KnobsSnapshot
+     **/
+    void addKnobsReadsForNode(const NodePtr& node,
+                              int nbSnapshotReads,
+                              int nbLockedReads);
+
+    /**
+     * @brief Records that an input image fetched by the node had to be converted to the components or bit depth
+     * of its clip preferences. If shared is true, the conversion done by another render thread of the frame
+     * was used and nbBytesConverted should be 0.
+     **/
+    void addInputImageConversionForNode(const NodePtr& node,
+                                        U64 nbBytesConverted,
+                                        bool shared);
+
+    /**
+     * @brief Records the timings of the tiles of the node executed by the TaskScheduler.
+     **/
+    void addTileTasksInfosForNode(const NodePtr& node,
+                                  const std::vector<TaskTiming>& timings);
+
+    /**
+     * @brief Records the number of frames rendered concurrently by the output node and the last decision
+     * of the controller adjusting it.
+     **/
+    void setParallelRendersInfosForNode(const NodePtr& node,
+                                        int nbParallelRenders,
+                                        const std::string& decision);
+
     void addRenderInfosForNode(const NodePtr& node,
                                const NodePtr& identity,
                                const std::string& plane,
@@ -0,0 +1,317 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RenderThreadsController.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <sstream> // stringstream
+
+#if defined(__NATRON_WIN32__)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <QtCore/QMutex>
+
+#include "Engine/AppManager.h"
+#include "Engine/Timer.h"
+
+// Minimum number of frames of a measure window. The window is at least twice the number of render threads.
+#define NATRON_RENDER_THREADS_MIN_WINDOW_FRAMES 4
+
+// Above this CPU utilization, adding render threads cannot help
+#define NATRON_RENDER_THREADS_CPU_SATURATED 0.9
+
+// Above this occupation of the image cache, more concurrent frames evict each other's images
+#define NATRON_RENDER_THREADS_CACHE_FULL 0.95
+
+// Relative throughput change under which two windows are considered equivalent
+#define NATRON_RENDER_THREADS_MIN_GAIN 0.05
+
+// Number of windows without change after a decision was reverted
+#define NATRON_RENDER_THREADS_HOLD_WINDOWS 4
+
+// Number of windows without change after which a thread is removed if the CPU is saturated
+#define NATRON_RENDER_THREADS_PROBE_WINDOWS 8
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+enum DecisionEnum
+{
+    eDecisionKeep = 0,
+    eDecisionAddThread,
+    eDecisionRemoveThread
+};
+
+// Returns the user + system time of the process, in seconds
+double
+getProcessCPUTime()
+{
+#if defined(__NATRON_WIN32__)
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if ( !GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) ) {
+        return 0.;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    // 100 ns units
+    return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.;
+    }
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct RenderThreadsControllerPrivate
+{
+    mutable QMutex lock; // protects all fields
+    bool active;
+    int nThreads;
+    int maxThreads;
+
+    // Current window
+    boost::scoped_ptr<TimeLapse> windowTimer;
+    double windowStartCPUTime;
+    int windowFrames;
+    double windowLatency;
+
+    // Previous windows
+    double lastThroughput; // 0 if there was no previous window
+    DecisionEnum lastDecision; // the change to evaluate, eDecisionKeep if there is none
+    int holdWindows;
+    int stableWindows;
+    std::string lastDecisionDescription;
+
+    RenderThreadsControllerPrivate()
+        : lock()
+        , active(false)
+        , nThreads(1)
+        , maxThreads(1)
+        , windowTimer()
+        , windowStartCPUTime(0.)
+        , windowFrames(0)
+        , windowLatency(0.)
+        , lastThroughput(0.)
+        , lastDecision(eDecisionKeep)
+        , holdWindows(0)
+        , stableWindows(0)
+        , lastDecisionDescription()
+    {
+    }
+
+    void startWindow()
+    {
+        windowTimer.reset(new TimeLapse);
+        windowStartCPUTime = getProcessCPUTime();
+        windowFrames = 0;
+        windowLatency = 0.;
+    }
+
+    int processWindow(const RenderThreadsController::WindowStats& stats);
+};
+
+int
+RenderThreadsControllerPrivate::processWindow(const RenderThreadsController::WindowStats& stats)
+{
+    // Private, shouldn't lock
+    assert( !lock.tryLock() );
+
+    const bool hasPreviousWindow = lastThroughput > 0.;
+    const bool cpuSaturated = stats.cpuUtilization >= NATRON_RENDER_THREADS_CPU_SATURATED;
+    const bool cacheFull = stats.cacheOccupation >= NATRON_RENDER_THREADS_CACHE_FULL;
+    DecisionEnum decision = eDecisionKeep;
+    bool isRevert = false;
+    const char* reason = "stable";
+
+    if (holdWindows > 0) {
+        --holdWindows;
+    }
+
+    if ( hasPreviousWindow && (lastDecision != eDecisionKeep) && (stats.throughput < lastThroughput * (1. - NATRON_RENDER_THREADS_MIN_GAIN)) ) {
+        // The last change lowered the throughput: revert it
+        decision = (lastDecision == eDecisionAddThread) ? eDecisionRemoveThread : eDecisionAddThread;
+        isRevert = true;
+        holdWindows = NATRON_RENDER_THREADS_HOLD_WINDOWS;
+        reason = "the last change lowered the throughput";
+    } else if ( hasPreviousWindow && (lastDecision == eDecisionAddThread) && (stats.throughput < lastThroughput * (1. + NATRON_RENDER_THREADS_MIN_GAIN)) ) {
+        // The last thread added did not help: wait before trying again
+        holdWindows = NATRON_RENDER_THREADS_HOLD_WINDOWS;
+        reason = "the last thread added did not raise the throughput";
+    } else if (holdWindows > 0) {
+        reason = "waiting after a reverted change";
+    } else if (!cpuSaturated && !cacheFull && nThreads < maxThreads) {
+        decision = eDecisionAddThread;
+        reason = "cores are idle";
+    } else if ( cpuSaturated && (stableWindows >= NATRON_RENDER_THREADS_PROBE_WINDOWS) && (nThreads > 1) ) {
+        // Check whether less concurrent frames render faster
+        decision = eDecisionRemoveThread;
+        reason = "the CPU is saturated, trying less concurrent frames";
+    } else if (cacheFull) {
+        reason = "the image cache is full";
+    } else if (cpuSaturated) {
+        reason = "the CPU is saturated";
+    }
+
+    int previousThreads = nThreads;
+    if (decision == eDecisionAddThread) {
+        nThreads = std::min(nThreads + 1, maxThreads);
+    } else if (decision == eDecisionRemoveThread) {
+        nThreads = std::max(nThreads - 1, 1);
+    }
+    if (nThreads == previousThreads) {
+        decision = eDecisionKeep;
+        ++stableWindows;
+    } else {
+        stableWindows = 0;
+    }
+    // a revert is not a change to evaluate, otherwise the controller would oscillate
+    lastDecision = isRevert ? eDecisionKeep : decision;
+    lastThroughput = stats.throughput;
+
+    std::stringstream ss;
+    ss << stats.nFrames << " frames at " << stats.throughput << " fps, "
+       << stats.meanLatency << " s per frame, CPU " << (int)(stats.cpuUtilization * 100.) << "%, image cache "
+       << (int)(stats.cacheOccupation * 100.) << "%: ";
+    if (decision == eDecisionAddThread) {
+        ss << "added a render thread";
+    } else if (decision == eDecisionRemoveThread) {
+        ss << "removed a render thread";
+    } else {
+        ss << "kept the render threads";
+    }
+    ss << " (" << reason << ')';
+    lastDecisionDescription = ss.str();
+
+    return nThreads;
+} // RenderThreadsControllerPrivate::processWindow
+
+RenderThreadsController::RenderThreadsController()
+    : _imp( new RenderThreadsControllerPrivate() )
+{
+}
+
+RenderThreadsController::~RenderThreadsController()
+{
+}
+
+void
+RenderThreadsController::start(int nThreads,
+                               int maxThreads)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->active = true;
+    _imp->maxThreads = std::max(1, maxThreads);
+    _imp->nThreads = std::max( 1, std::min(nThreads, _imp->maxThreads) );
+    _imp->lastThroughput = 0.;
+    _imp->lastDecision = eDecisionKeep;
+    _imp->holdWindows = 0;
+    _imp->stableWindows = 0;
+    _imp->lastDecisionDescription.clear();
+    _imp->startWindow();
+}
+
+void
+RenderThreadsController::stop()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->active = false;
+}
+
+bool
+RenderThreadsController::isActive() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->active;
+}
+
+int
+RenderThreadsController::getThreadsCount() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->nThreads;
+}
+
+std::string
+RenderThreadsController::getLastDecision() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->lastDecisionDescription;
+}
+
+void
+RenderThreadsController::notifyFrameRendered(double renderTime)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (!_imp->active) {
+        return;
+    }
+    ++_imp->windowFrames;
+    _imp->windowLatency += renderTime;
+    if ( _imp->windowFrames < std::max(NATRON_RENDER_THREADS_MIN_WINDOW_FRAMES, 2 * _imp->nThreads) ) {
+        return;
+    }
+
+    double wallTime = std::max( 1e-6, _imp->windowTimer->getTimeSinceCreation() );
+    int nCores = std::max( 1, appPTR->getHardwareIdealThreadCount() );
+    U64 cacheMaxSize = std::max( (U64)1, appPTR->getCachesMaximumMemorySize() );
+    WindowStats stats;
+    stats.nFrames = _imp->windowFrames;
+    stats.throughput = _imp->windowFrames / wallTime;
+    stats.meanLatency = _imp->windowLatency / _imp->windowFrames;
+    stats.cpuUtilization = std::min( 1., std::max(0., (getProcessCPUTime() - _imp->windowStartCPUTime) / (wallTime * nCores) ) );
+    stats.cacheOccupation = std::min( 1., (double)appPTR->getCachesTotalMemorySize() / cacheMaxSize );
+
+    _imp->processWindow(stats);
+    _imp->startWindow();
+}
+
+int
+RenderThreadsController::processWindow(const WindowStats& stats)
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->processWindow(stats);
+}
+
+NATRON_NAMESPACE_EXIT
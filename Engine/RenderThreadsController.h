@@ -0,0 +1,116 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Natron_Engine_RenderThreadsController_h
+#define Natron_Engine_RenderThreadsController_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Feedback controller choosing how many frames an OutputSchedulerThread renders concurrently.
+ *
+ * The render threads report the latency of each frame. Every few frames (a window), the controller
+ * measures the throughput of the window, the CPU utilization of the process and the occupation of the
+ * image cache, then moves the number of render threads by one at most (hill climbing):
+ * - a change that lowered the throughput is reverted, and the controller waits a few windows before trying again;
+ * - a thread is added while cores are idle and the image cache has room left;
+ * - when the CPU is saturated, a thread is removed from time to time to check whether less concurrent frames
+ *   (hence less cache thrashing) render faster.
+ *
+ * All functions are MT-safe.
+ **/
+struct RenderThreadsControllerPrivate;
+class RenderThreadsController
+{
+public:
+
+    /**
+     * @brief Measures of a window of frames
+     **/
+    struct WindowStats
+    {
+        int nFrames;
+        double throughput; // frames per second
+        double meanLatency; // seconds per frame, for one render thread
+        double cpuUtilization; // in [0,1]: CPU time of the process / (wall time * number of cores)
+        double cacheOccupation; // in [0,1]: memory used by the image cache / maximum memory of the image cache
+    };
+
+    RenderThreadsController();
+
+    ~RenderThreadsController();
+
+    /**
+     * @brief Activates the controller for a new render, with nThreads render threads, between 1 and maxThreads.
+     **/
+    void start(int nThreads, int maxThreads);
+
+    /**
+     * @brief Deactivates the controller at the end of a render.
+     **/
+    void stop();
+
+    bool isActive() const;
+
+    /**
+     * @brief Returns the number of render threads the scheduler should run.
+     **/
+    int getThreadsCount() const;
+
+    /**
+     * @brief Returns a description of the last decision, to be written in the render stats.
+     **/
+    std::string getLastDecision() const;
+
+    /**
+     * @brief Called by a render thread when it rendered a frame in renderTime seconds. When the window is
+     * complete, the CPU utilization and cache occupation are measured and a new decision is taken.
+     **/
+    void notifyFrameRendered(double renderTime);
+
+    /**
+     * @brief Takes a decision from the measures of a window, and returns the new number of threads.
+     * This is called by notifyFrameRendered() and may be called directly to feed the controller with
+     * other measures.
+     **/
+    int processWindow(const WindowStats& stats);
+
+private:
+
+    boost::scoped_ptr<RenderThreadsControllerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Natron_Engine_RenderThreadsController_h
@@ -25,6 +25,7 @@
 #include "RotoContext.h"
 
 #include <algorithm> // min, max
+#include <cmath>
 #include <sstream>
 #include <locale>
 #include <limits>
@@ -41,20 +42,14 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/math/special_functions/fpclassify.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
-#include <QtCore/QLineF>
 #include <QtCore/QDebug>
 
-//#define ROTO_RENDER_TRIANGLES_ONLY
-
-#include "libtess.h"
-
 #include "Engine/RotoContextPrivate.h"
 
 #include "Engine/AppInstance.h"
 #include "Engine/Bezier.h"
 #include "Engine/BezierCP.h"
 #include "Engine/CreateNodeArgs.h"
-#include "Engine/CoonsRegularization.h"
 #include "Engine/FeatherPoint.h"
 #include "Engine/Format.h"
 #include "Engine/Hash64.h"
@@ -67,6 +62,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/RotoContextSerialization.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/RotoLayer.h"
+#include "Engine/RotoShapeRasterizer.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
 #include "Engine/TimeLine.h"
@@ -2148,18 +2144,6 @@ CairoImageWrapper::~CairoImageWrapper()
     }
 }
 
-static void
-adjustToPointToScale(unsigned int mipmapLevel,
-                     double &x,
-                     double &y)
-{
-    if (mipmapLevel != 0) {
-        int pot = (1 << mipmapLevel);
-        x /= pot;
-        y /= pot;
-    }
-}
-
 template <typename PIX, int maxValue, int dstNComps, int srcNComps, bool useOpacity, bool inverted>
 static void
 convertCairoImageToNatronImageForInverted_noColor(cairo_surface_t* cairoImg,
@@ -2303,6 +2287,117 @@ convertCairoImageToNatronImage_noColor(cairo_surface_t* cairoImg,
     }
 }
 
+/*
+ * Writes the coverage computed by a RotoShapeRasterizer into the pixels of an image, with the same
+ * conversion as convertCairoImageToNatronImage_noColor() when the opacity is used.
+ */
+template <typename PIX, int maxValue, int dstNComps>
+class RotoShapeImageProcessor
+    : public ImageRectProcessor
+{
+public:
+    RotoShapeImageProcessor(const RotoShapeRasterizer & rasterizer,
+                            PIX* pixels,
+                            const RectI & bounds,
+                            const double shapeColor[3],
+                            double opacity,
+                            bool inverted)
+        : ImageRectProcessor()
+        , _rasterizer(rasterizer)
+        , _pixels(pixels)
+        , _bounds(bounds)
+        , _opacity(opacity)
+        , _inverted(inverted)
+    {
+        for (int c = 0; c < 3; ++c) {
+            _color[c] = shapeColor[c] * opacity;
+        }
+    }
+
+    virtual void process(const RectI & rect) const OVERRIDE FINAL
+    {
+        const int width = rect.width();
+        std::vector<float> coverage( (std::size_t)width * rect.height() );
+
+        _rasterizer.renderCoverage(rect, &coverage[0]);
+
+        const float* srcPix = &coverage[0];
+        for (int y = rect.y1; y < rect.y2; ++y) {
+            PIX* dstPix = _pixels + ( (std::size_t)(y - _bounds.y1) * _bounds.width() + (rect.x1 - _bounds.x1) ) * dstNComps;
+            for (int x = 0; x < width; ++x, ++srcPix, dstPix += dstNComps) {
+                const float value = ( !_inverted ? *srcPix : 1.f - *srcPix ) * maxValue;
+                switch (dstNComps) {
+                case 4:
+                    dstPix[0] = PIX(value * _color[0]);
+                    dstPix[1] = PIX(value * _color[1]);
+                    dstPix[2] = PIX(value * _color[2]);
+                    dstPix[3] = PIX(value * _opacity);
+                    break;
+                case 1:
+                    dstPix[0] = PIX(value * _opacity);
+                    break;
+                case 3:
+                    dstPix[0] = PIX(value * _color[0]);
+                    dstPix[1] = PIX(value * _color[1]);
+                    dstPix[2] = PIX(value * _color[2]);
+                    break;
+                case 2:
+                    dstPix[0] = PIX(value * _color[0]);
+                    dstPix[1] = PIX(value * _color[1]);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    const RotoShapeRasterizer & _rasterizer;
+    PIX* _pixels; // the pixel at the bottom-left corner of bounds
+    RectI _bounds;
+    double _color[3];
+    double _opacity;
+    bool _inverted;
+};
+
+template <typename PIX, int maxValue>
+static void
+renderShapeToImage(const RotoShapeRasterizer & rasterizer,
+                   Image* image,
+                   const RectI & roi,
+                   const double shapeColor[3],
+                   double opacity,
+                   bool inverted)
+{
+    Image::WriteAccess acc = image->getWriteRights();
+    const RectI bounds = image->getBounds();
+    PIX* pixels = (PIX*)acc.pixelAt(bounds.x1, bounds.y1);
+    RectI rect;
+
+    assert(pixels);
+    if ( !pixels || !roi.intersect(bounds, &rect) ) {
+        return;
+    }
+
+    switch ( image->getComponentsCount() ) {
+    case 1:
+        Image::processRectInBands( rect, RotoShapeImageProcessor<PIX, maxValue, 1>(rasterizer, pixels, bounds, shapeColor, opacity, inverted) );
+        break;
+    case 2:
+        Image::processRectInBands( rect, RotoShapeImageProcessor<PIX, maxValue, 2>(rasterizer, pixels, bounds, shapeColor, opacity, inverted) );
+        break;
+    case 3:
+        Image::processRectInBands( rect, RotoShapeImageProcessor<PIX, maxValue, 3>(rasterizer, pixels, bounds, shapeColor, opacity, inverted) );
+        break;
+    case 4:
+        Image::processRectInBands( rect, RotoShapeImageProcessor<PIX, maxValue, 4>(rasterizer, pixels, bounds, shapeColor, opacity, inverted) );
+        break;
+    default:
+        break;
+    }
+}
+
 #if 0
 template <typename PIX, int maxValue, int srcNComps, int dstNComps>
 static void
@@ -2885,6 +2980,30 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
 
     double opacity = getOpacity(time);
 
+    if ( isBezier && !isBezier->isOpenBezier() ) {
+        // Closed shapes are rasterized directly into the image
+        RotoShapeRasterizer rasterizer;
+        RotoContextPrivate::renderBezier(&rasterizer, isBezier, time, startTime, endTime, timeStep, mipmapLevel);
+
+        switch (depth) {
+        case eImageBitDepthFloat:
+            renderShapeToImage<float, 1>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthByte:
+            renderShapeToImage<unsigned char, 255>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthShort:
+            renderShapeToImage<unsigned short, 65535>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthHalf:
+        case eImageBitDepthNone:
+            assert(false);
+            break;
+        }
+
+        return image;
+    }
+
     ////Allocate the cairo temporary buffer
     CairoImageWrapper imgWrapper;
 
@@ -2906,8 +3025,9 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
     cairo_set_antialias(imgWrapper.ctx, CAIRO_ANTIALIAS_NONE);
 
 
-    assert(isStroke || isBezier);
-    if ( isStroke || !isBezier || ( isBezier && isBezier->isOpenBezier() ) ) {
+    // Strokes and open beziers
+    assert( isStroke || ( isBezier && isBezier->isOpenBezier() ) );
+    {
         std::vector<cairo_pattern_t*> dotPatterns(ROTO_PRESSURE_LEVELS);
         for (std::size_t i = 0; i < dotPatterns.size(); ++i) {
             dotPatterns[i] = (cairo_pattern_t*)0;
@@ -2920,8 +3040,6 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
                 dotPatterns[i] = 0;
             }
         }
-    } else {
-        RotoContextPrivate::renderBezier(imgWrapper.ctx, isBezier, opacity, time, startTime, endTime, timeStep, mipmapLevel);
     }
 
     bool useOpacityToConvert = (isBezier != 0);
@@ -3231,9 +3349,8 @@ RotoContext::allocateAndRenderSingleDotStroke(int brushSizePixel,
 }
 
 void
-RotoContextPrivate::renderBezier(cairo_t* cr,
+RotoContextPrivate::renderBezier(RotoShapeRasterizer* rasterizer,
                                  const Bezier* bezier,
-                                 double opacity,
                                  double time,
                                  double startTime, double endTime, double mbFrameStep,
                                  unsigned int mipmapLevel)
@@ -3243,1348 +3360,13 @@ RotoContextPrivate::renderBezier(cairo_t* cr,
         return;
     }
 
-
-
     for (double t = startTime; t <= endTime; t+=mbFrameStep) {
-
         double fallOff = bezier->getFeatherFallOff(t);
-        double featherDist = bezier->getFeatherDistance(t);
-        double shapeColor[3];
-        bezier->getColor(t, shapeColor);
-
-
-        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-
-        cairo_new_path(cr);
-
-        ////Define the feather edge pattern
-        cairo_pattern_t* mesh = cairo_pattern_create_mesh();
-        if (cairo_pattern_status(mesh) != CAIRO_STATUS_SUCCESS) {
-            cairo_pattern_destroy(mesh);
-
-            return;
-        }
-
-        ///Adjust the feather distance so it takes the mipmap level into account
-        if (mipmapLevel != 0) {
-            featherDist /= (1 << mipmapLevel);
-        }
-
-        Transform::Matrix3x3 transform;
-        bezier->getTransformAtTime(t, &transform);
-
-
-#ifdef ROTO_RENDER_TRIANGLES_ONLY
-        std::list<RotoFeatherVertex> featherMesh;
-        std::list<RotoTriangleFans> internalFans;
-        std::list<RotoTriangles> internalTriangles;
-        std::list<RotoTriangleStrips> internalStrips;
-        computeTriangles(bezier, t, mipmapLevel, featherDist, &featherMesh, &internalFans, &internalTriangles, &internalStrips);
-        renderFeather_cairo(featherMesh, shapeColor, fallOff, mesh);
-        renderInternalShape_cairo(internalTriangles, internalFans, internalStrips, shapeColor, mesh);
-        Q_UNUSED(opacity);
-#else
-        renderFeather(bezier, t, mipmapLevel, shapeColor, opacity, featherDist, fallOff, mesh);
-
-
-        // strangely, the above-mentioned cairo bug doesn't affect this function
-        BezierCPs cps = bezier->getControlPoints_mt_safe();
-        renderInternalShape(t, mipmapLevel, shapeColor, opacity, transform, cr, mesh, cps);
-        
-#endif
-        
-        
-        RotoContextPrivate::applyAndDestroyMask(cr, mesh);
+        BezierShapePtr shape = bezier->getShapeAtTime(t, mipmapLevel);
+        rasterizer->addShape(shape->polygon, shape->featherInner, shape->featherOuter, fallOff);
     }
 } // RotoContextPrivate::renderBezier
 
-void
-RotoContextPrivate::renderFeather(const Bezier* bezier,
-                                  double time,
-                                  unsigned int mipmapLevel,
-                                  double shapeColor[3],
-                                  double /*opacity*/,
-                                  double featherDist,
-                                  double fallOff,
-                                  cairo_pattern_t* mesh)
-{
-    ///Note that we do not use the opacity when rendering the bezier, it is rendered with correct floating point opacity/color when converting
-    ///to the Natron image.
-
-    double fallOffInverse = 1. / fallOff;
-    /*
-     * We descretize the feather control points to obtain a polygon so that the feather distance will be of the same thickness around all the shape.
-     * If we were to extend only the end points, the resulting bezier interpolation would create a feather with different thickness around the shape,
-     * yielding an unwanted behaviour for the end user.
-     */
-    ///here is the polygon of the feather bezier
-    ///This is used only if the feather distance is different of 0 and the feather points equal
-    ///the control points in order to still be able to apply the feather distance.
-    std::list<ParametricPoint> featherPolygon;
-    std::list<ParametricPoint> bezierPolygon;
-    RectD featherPolyBBox;
-
-    featherPolyBBox.setupInfinity();
-
-    bezier->evaluateFeatherPointsAtTime_DeCasteljau(false, time, mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                                                    50,
-#else
-                                                    1,
-#endif
-                                                    true, &featherPolygon, &featherPolyBBox);
-    bezier->evaluateAtTime_DeCasteljau(false, time, mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                                       50,
-#else
-                                       1,
-#endif
-                                       &bezierPolygon, NULL);
-
-    bool clockWise = bezier->isFeatherPolygonClockwiseOriented(false, time);
-
-    assert( !featherPolygon.empty() && !bezierPolygon.empty() );
-
-
-    std::list<Point> featherContour;
-
-    // prepare iterators
-    std::list<ParametricPoint>::iterator next = featherPolygon.begin();
-    ++next;  // can only be valid since we assert the list is not empty
-    if ( next == featherPolygon.end() ) {
-        next = featherPolygon.begin();
-    }
-    std::list<ParametricPoint>::iterator prev = featherPolygon.end();
-    --prev; // can only be valid since we assert the list is not empty
-    std::list<ParametricPoint>::iterator bezIT = bezierPolygon.begin();
-    std::list<ParametricPoint>::iterator prevBez = bezierPolygon.end();
-    --prevBez; // can only be valid since we assert the list is not empty
-
-    // prepare p1
-    double absFeatherDist = std::abs(featherDist);
-    Point p1;
-    p1.x = featherPolygon.begin()->x;
-    p1.y = featherPolygon.begin()->y;
-    double norm = sqrt( (next->x - prev->x) * (next->x - prev->x) + (next->y - prev->y) * (next->y - prev->y) );
-    assert(norm != 0);
-    double dx = (norm != 0) ? -( (next->y - prev->y) / norm ) : 0;
-    double dy = (norm != 0) ? ( (next->x - prev->x) / norm ) : 1;
-
-    if (!clockWise) {
-        p1.x -= dx * absFeatherDist;
-        p1.y -= dy * absFeatherDist;
-    } else {
-        p1.x += dx * absFeatherDist;
-        p1.y += dy * absFeatherDist;
-    }
-
-
-    double innerOpacity = 1.;
-    double outterOpacity = 0.;
-
-    Point origin = p1;
-    featherContour.push_back(p1);
-
-
-    // increment for first iteration
-    std::list<ParametricPoint>::iterator cur = featherPolygon.begin();
-    // ++cur, ++prev, ++next, ++bezIT, ++prevBez
-    // all should be valid, actually
-    assert( cur != featherPolygon.end() &&
-            prev != featherPolygon.end() &&
-            next != featherPolygon.end() &&
-            bezIT != bezierPolygon.end() &&
-            prevBez != bezierPolygon.end() );
-    if ( cur != featherPolygon.end() ) {
-        ++cur;
-    }
-    if ( prev != featherPolygon.end() ) {
-        ++prev;
-    }
-    if ( next != featherPolygon.end() ) {
-        ++next;
-    }
-    if ( bezIT != bezierPolygon.end() ) {
-        ++bezIT;
-    }
-    if ( prevBez != bezierPolygon.end() ) {
-        ++prevBez;
-    }
-
-    for (;; ++cur) { // for each point in polygon
-        if ( next == featherPolygon.end() ) {
-            next = featherPolygon.begin();
-        }
-        if ( prev == featherPolygon.end() ) {
-            prev = featherPolygon.begin();
-        }
-        if ( bezIT == bezierPolygon.end() ) {
-            bezIT = bezierPolygon.begin();
-        }
-        if ( prevBez == bezierPolygon.end() ) {
-            prevBez = bezierPolygon.begin();
-        }
-        bool mustStop = false;
-        if ( cur == featherPolygon.end() ) {
-            mustStop = true;
-            cur = featherPolygon.begin();
-        }
-
-        ///skip it
-        /*if ( (cur->x == prev->x) && (cur->y == prev->y) ) {
-            continue;
-        }*/
-
-        Point p0, p0p1, p1p0, p2, p2p3, p3p2, p3;
-        p0.x = prevBez->x;
-        p0.y = prevBez->y;
-        p3.x = bezIT->x;
-        p3.y = bezIT->y;
-
-        if (!mustStop) {
-            norm = sqrt( (next->x - prev->x) * (next->x - prev->x) + (next->y - prev->y) * (next->y - prev->y) );
-            if (norm == 0) {
-                dx = 0;
-                dy = 0;
-            } else {
-                dx = -( (next->y - prev->y) / norm );
-                dy = ( (next->x - prev->x) / norm );
-            }
-            p2.x = cur->x;
-            p2.y = cur->y;
-
-            if (!clockWise) {
-                p2.x -= dx * absFeatherDist;
-                p2.y -= dy * absFeatherDist;
-            } else {
-                p2.x += dx * absFeatherDist;
-                p2.y += dy * absFeatherDist;
-            }
-        } else {
-            p2.x = origin.x;
-            p2.y = origin.y;
-        }
-        featherContour.push_back(p2);
-
-        ///linear interpolation
-        p0p1.x = (p0.x * fallOff * 2. + fallOffInverse * p1.x) / (fallOff * 2. + fallOffInverse);
-        p0p1.y = (p0.y * fallOff * 2. + fallOffInverse * p1.y) / (fallOff * 2. + fallOffInverse);
-        p1p0.x = (p0.x * fallOff + 2. * fallOffInverse * p1.x) / (fallOff + 2. * fallOffInverse);
-        p1p0.y = (p0.y * fallOff + 2. * fallOffInverse * p1.y) / (fallOff + 2. * fallOffInverse);
-
-
-        p2p3.x = (p3.x * fallOff + 2. * fallOffInverse * p2.x) / (fallOff + 2. * fallOffInverse);
-        p2p3.y = (p3.y * fallOff + 2. * fallOffInverse * p2.y) / (fallOff + 2. * fallOffInverse);
-        p3p2.x = (p3.x * fallOff * 2. + fallOffInverse * p2.x) / (fallOff * 2. + fallOffInverse);
-        p3p2.y = (p3.y * fallOff * 2. + fallOffInverse * p2.y) / (fallOff * 2. + fallOffInverse);
-
-
-        ///move to the initial point
-        cairo_mesh_pattern_begin_patch(mesh);
-        cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-        cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-        cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-        cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-        cairo_mesh_pattern_line_to(mesh, p0.x, p0.y);
-        ///Set the 4 corners color
-        ///inner is full color
-
-        // IMPORTANT NOTE:
-        // The two sqrt below are due to a probable cairo bug.
-        // To check wether the bug is present is a given cairo version,
-        // make any shape with a very large feather and set
-        // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-        // and approximately equal to 0.5.
-        // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-        // older Cairo versions.
-        cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], innerOpacity);
-        ///outter is faded
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], outterOpacity);
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], outterOpacity);
-        ///inner is full color
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], innerOpacity);
-        assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-        cairo_mesh_pattern_end_patch(mesh);
-
-        if (mustStop) {
-            break;
-        }
-
-        //std::swap(innerOpacity, outterOpacity);
-
-        p1 = p2;
-
-        // increment for next iteration
-        // ++prev, ++next, ++bezIT, ++prevBez
-        if ( prev != featherPolygon.end() ) {
-            ++prev;
-        }
-        if ( next != featherPolygon.end() ) {
-            ++next;
-        }
-        if ( bezIT != bezierPolygon.end() ) {
-            ++bezIT;
-        }
-        if ( prevBez != bezierPolygon.end() ) {
-            ++prevBez;
-        }
-    }  // for each point in polygon
-} // RotoContextPrivate::renderFeather
-
-void
-RotoContextPrivate::renderFeather_cairo(const std::list<RotoFeatherVertex>& vertices, double shapeColor[3], double fallOff, cairo_pattern_t * mesh)
-{
-    // Roto feather is rendered as triangles
-    assert(vertices.size() >= 3 && vertices.size() % 3 == 0);
-
-    double fallOffInverse = 1. / fallOff;
-    
-    std::list<RotoFeatherVertex>::const_iterator next = vertices.begin();
-    ++next;
-    std::list<RotoFeatherVertex>::const_iterator nextNext = next;
-    ++nextNext;
-    int index = 0;
-    for (std::list<RotoFeatherVertex>::const_iterator it = vertices.begin(); it!=vertices.end(); index += 3) {
-
-
-        cairo_mesh_pattern_begin_patch(mesh);
-
-        // Only 3 of the 4 vertices are valid
-        const RotoFeatherVertex* innerVertices[2] = {0, 0};
-        const RotoFeatherVertex* outterVertices[2] = {0, 0};
-
-        {
-            int innerIndex = 0;
-            int outterIndex = 0;
-            if (it->isInner) {
-                innerVertices[innerIndex] = &(*it);
-                ++innerIndex;
-            } else {
-                outterVertices[outterIndex] = &(*it);
-                ++outterIndex;
-            }
-            if (next->isInner) {
-                assert(innerIndex <= 1);
-                if (innerIndex <= 1) {
-                    innerVertices[innerIndex] = &(*next);
-                    ++innerIndex;
-                }
-            } else {
-                assert(outterIndex <= 1);
-                if (outterIndex <= 1) {
-                    outterVertices[outterIndex] = &(*next);
-                    ++outterIndex;
-                }
-            }
-            if (nextNext->isInner) {
-                assert(innerIndex <= 1);
-                if (innerIndex <= 1) {
-                    innerVertices[innerIndex] = &(*nextNext);
-                    ++innerIndex;
-                }
-            } else {
-                assert(outterIndex <= 1);
-                if (outterIndex <= 1) {
-                    outterVertices[outterIndex] = &(*nextNext);
-                    ++outterIndex;
-                }
-            }
-            assert((outterIndex == 1 && innerIndex == 2) || (innerIndex == 1 && outterIndex == 2));
-        }
-        // make a degenerated coons patch out of the triangle so that we can assign a color to each vertex to emulate simple gouraud shaded triangles
-        Point p0, p0p1, p1, p1p0, p2, p2p3, p3p2, p3;
-        p0.x = innerVertices[0]->x;
-        p0.y = innerVertices[0]->y;
-        p1.x = outterVertices[0]->x;
-        p1.y = outterVertices[0]->y;
-        if (outterVertices[1]) {
-            p2.x = outterVertices[1]->x;
-            p2.y = outterVertices[1]->y;
-        } else {
-            // Repeat p1 if only 1 outter vertex
-            p2 = p1;
-        }
-        if (innerVertices[1]) {
-            p3.x = innerVertices[1]->x;
-            p3.y = innerVertices[1]->y;
-        } else {
-            // Repeat p0 if only 1 inner vertex
-            p3 = p0;
-        }
-
-
-        ///linear interpolation
-        p0p1.x = (p0.x * fallOff * 2. + fallOffInverse * p1.x) / (fallOff * 2. + fallOffInverse);
-        p0p1.y = (p0.y * fallOff * 2. + fallOffInverse * p1.y) / (fallOff * 2. + fallOffInverse);
-        p1p0.x = (p0.x * fallOff + 2. * fallOffInverse * p1.x) / (fallOff + 2. * fallOffInverse);
-        p1p0.y = (p0.y * fallOff + 2. * fallOffInverse * p1.y) / (fallOff + 2. * fallOffInverse);
-
-
-        p2p3.x = (p3.x * fallOff + 2. * fallOffInverse * p2.x) / (fallOff + 2. * fallOffInverse);
-        p2p3.y = (p3.y * fallOff + 2. * fallOffInverse * p2.y) / (fallOff + 2. * fallOffInverse);
-        p3p2.x = (p3.x * fallOff * 2. + fallOffInverse * p2.x) / (fallOff * 2. + fallOffInverse);
-        p3p2.y = (p3.y * fallOff * 2. + fallOffInverse * p2.y) / (fallOff * 2. + fallOffInverse);
-
-
-        // move to the initial point
-        cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-        cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-        cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-        cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-        cairo_mesh_pattern_line_to(mesh, p0.x, p0.y);
-
-        // Set the 4 corners color
-        // inner is full color
-
-        // IMPORTANT NOTE:
-        // The two sqrt below are due to a probable cairo bug.
-        // To check wether the bug is present is a given cairo version,
-        // make any shape with a very large feather and set
-        // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-        // and approximately equal to 0.5.
-        // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-        // older Cairo versions.
-        cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1.);
-        // outter is faded
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 0.);
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 0.);
-        // inner is full color
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1.);
-        assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-        cairo_mesh_pattern_end_patch(mesh);
-
-
-        assert(nextNext != vertices.end());
-        ++nextNext;
-
-        // check if we reached the end
-        if (nextNext == vertices.end()) {
-            break;
-        }
-        // advance a second time
-        ++nextNext;
-        if (nextNext == vertices.end()) {
-            break;
-        }
-        // advance a 3rd time
-        ++nextNext;
-        if (nextNext == vertices.end()) {
-            break;
-        }
-
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-    } // for (std::list<RotoFeatherVertex>::const_iterator it = vertices.begin(); it!=vertices.end(); ) 
-} // RotoContextPrivate::renderFeather_cairo
-
-
-struct tessPolygonData
-{
-    std::list<RotoTriangleFans>* internalFans;
-    std::list<RotoTriangles>* internalTriangles;
-    std::list<RotoTriangleStrips>* internalStrips;
-
-    boost::scoped_ptr<RotoTriangleFans> fanBeingEdited;
-    boost::scoped_ptr<RotoTriangles> trianglesBeingEdited;
-    boost::scoped_ptr<RotoTriangleStrips> stripsBeingEdited;
-
-    std::list<boost::shared_ptr<Point> > allocatedIntersections;
-    unsigned int error;
-};
-
-static void tess_begin_primitive_callback(unsigned int which, void *polygonData)
-{
-
-    tessPolygonData* myData = (tessPolygonData*)polygonData;
-    assert(myData);
-
-    switch (which) {
-        case LIBTESS_GL_TRIANGLE_STRIP:
-            assert(!myData->stripsBeingEdited);
-            // scoped_ptr
-            myData->stripsBeingEdited.reset(new RotoTriangleStrips);
-            break;
-        case LIBTESS_GL_TRIANGLE_FAN:
-            assert(!myData->fanBeingEdited);
-            // scoped_ptr
-            myData->fanBeingEdited.reset(new RotoTriangleFans);
-            break;
-        case LIBTESS_GL_TRIANGLES:
-            assert(!myData->trianglesBeingEdited);
-            // scoped_ptr
-            myData->trianglesBeingEdited.reset(new RotoTriangles);
-            break;
-        default:
-            assert(false);
-            break;
-    }
-}
-
-static void tess_end_primitive_callback(void *polygonData)
-{
-    tessPolygonData* myData = (tessPolygonData*)polygonData;
-    assert(myData);
-
-    assert((myData->stripsBeingEdited && !myData->fanBeingEdited && !myData->trianglesBeingEdited) ||
-           (!myData->stripsBeingEdited && myData->fanBeingEdited && !myData->trianglesBeingEdited) ||
-           (!myData->stripsBeingEdited && !myData->fanBeingEdited && myData->trianglesBeingEdited));
-
-    if (myData->stripsBeingEdited) {
-        myData->internalStrips->push_back(*myData->stripsBeingEdited);
-        myData->stripsBeingEdited.reset();
-    } else if (myData->fanBeingEdited) {
-        myData->internalFans->push_back(*myData->fanBeingEdited);
-        myData->fanBeingEdited.reset();
-    } else if (myData->trianglesBeingEdited) {
-        myData->internalTriangles->push_back(*myData->trianglesBeingEdited);
-        myData->trianglesBeingEdited.reset();
-    }
-
-}
-
-static void tess_vertex_callback(void* data /*per-vertex client data*/, void *polygonData)
-{
-    tessPolygonData* myData = (tessPolygonData*)polygonData;
-    assert(myData);
-
-    assert((myData->stripsBeingEdited && !myData->fanBeingEdited && !myData->trianglesBeingEdited) ||
-           (!myData->stripsBeingEdited && myData->fanBeingEdited && !myData->trianglesBeingEdited) ||
-           (!myData->stripsBeingEdited && !myData->fanBeingEdited && myData->trianglesBeingEdited));
-
-    Point* p = (Point*)data;
-    assert(p);
-
-    if (myData->stripsBeingEdited) {
-        myData->stripsBeingEdited->vertices.push_back(*p);
-    } else if (myData->fanBeingEdited) {
-        myData->fanBeingEdited->vertices.push_back(*p);
-    } else if (myData->trianglesBeingEdited) {
-        myData->trianglesBeingEdited->vertices.push_back(*p);
-    }
-
-}
-
-static void tess_error_callback(unsigned int error, void *polygonData)
-{
-    tessPolygonData* myData = (tessPolygonData*)polygonData;
-    assert(myData);
-    myData->error = error;
-}
-
-static void tess_intersection_combine_callback(double coords[3], void */*data*/[4] /*4 original vertices*/, double /*w*/[4] /*weights*/, void **dataOut, void *polygonData)
-{
-    tessPolygonData* myData = (tessPolygonData*)polygonData;
-    assert(myData);
-
-    boost::shared_ptr<Point> ret = boost::make_shared<Point>();
-    ret->x = coords[0];
-    ret->y = coords[1];
-    /*new->r = w[0]*d[0]->r + w[1]*d[1]->r + w[2]*d[2]->r + w[3]*d[3]->r;
-    new->g = w[0]*d[0]->g + w[1]*d[1]->g + w[2]*d[2]->g + w[3]*d[3]->g;
-    new->b = w[0]*d[0]->b + w[1]*d[1]->b + w[2]*d[2]->b + w[3]*d[3]->b;
-    new->a = w[0]*d[0]->a + w[1]*d[1]->a + w[2]*d[2]->a + w[3]*d[3]->a;*/
-    *dataOut = ret.get();
-    myData->allocatedIntersections.push_back(ret);
-}
-
-void
-RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist,
-                                     std::list<RotoFeatherVertex>* featherMesh,
-                                     std::list<RotoTriangleFans>* internalFans,
-                                     std::list<RotoTriangles>* internalTriangles,
-                                     std::list<RotoTriangleStrips>* internalStrips)
-{
-    ///Note that we do not use the opacity when rendering the bezier, it is rendered with correct floating point opacity/color when converting
-    ///to the Natron image.
-
-    bool clockWise = bezier->isFeatherPolygonClockwiseOriented(false, time);
-
-    const double absFeatherDist = std::abs(featherDist);
-
-    std::list<std::list<ParametricPoint> > featherPolygon;
-    std::list<std::list<ParametricPoint> > bezierPolygon;
-
-    RectD featherPolyBBox;
-    featherPolyBBox.setupInfinity();
-
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-    int error = -1;
-#else
-    double error = 1;
-#endif
-
-    bezier->evaluateFeatherPointsAtTime_DeCasteljau(false, time, mipmapLevel,error, true, &featherPolygon, &featherPolyBBox);
-    bezier->evaluateAtTime_DeCasteljau(false, time, mipmapLevel, error,&bezierPolygon, NULL);
-
-
-    // First compute the mesh composed of triangles of the feather
-    assert( !featherPolygon.empty() && !bezierPolygon.empty() && featherPolygon.size() == bezierPolygon.size());
-
-    std::list<std::list<ParametricPoint> >::const_iterator fIt = featherPolygon.begin();
-    for (std::list<std::list<ParametricPoint> > ::const_iterator it = bezierPolygon.begin(); it != bezierPolygon.end(); ++it, ++fIt) {
-
-        // Iterate over each bezier segment.
-        // There are the same number of bezier segments for the feather and the internal bezier. Each discretized segment is a contour (list of vertices)
-
-        std::list<ParametricPoint>::const_iterator bSegmentIt = it->begin();
-        std::list<ParametricPoint>::const_iterator fSegmentIt = fIt->begin();
-
-        assert(!it->empty() && !fIt->empty());
-
-
-        // prepare iterators to compute derivatives for feather distance
-        std::list<ParametricPoint>::const_iterator fnext = fSegmentIt;
-        ++fnext;  // can only be valid since we assert the list is not empty
-        if ( fnext == fIt->end() ) {
-            fnext = fIt->begin();
-        }
-        std::list<ParametricPoint>::const_iterator fprev = fIt->end();
-        --fprev; // can only be valid since we assert the list is not empty
-
-
-        // initialize the state with a segment between the first inner vertex and first outter vertex
-        RotoFeatherVertex lastInnerVert,lastOutterVert;
-        {
-            lastInnerVert.x = bSegmentIt->x;
-            lastInnerVert.y = bSegmentIt->y;
-            lastInnerVert.isInner = true;
-            featherMesh->push_back(lastInnerVert);
-            ++bSegmentIt;
-        }
-        if ( fSegmentIt != fIt->end() ) {
-            lastOutterVert.x = fSegmentIt->x;
-            lastOutterVert.y = fSegmentIt->y;
-
-            if (absFeatherDist) {
-                double diffx = fnext->x - fprev->x;
-                double diffy = fnext->y - fprev->y;
-                double norm = std::sqrt( diffx * diffx + diffy * diffy );
-                double dx = (norm != 0) ? -( diffy / norm ) : 0;
-                double dy = (norm != 0) ? ( diffx / norm ) : 1;
-
-                if (!clockWise) {
-                    lastOutterVert.x -= dx * absFeatherDist;
-                    lastOutterVert.y -= dy * absFeatherDist;
-                } else {
-                    lastOutterVert.x += dx * absFeatherDist;
-                    lastOutterVert.y += dy * absFeatherDist;
-                }
-            }
-
-            lastOutterVert.isInner = false;
-            featherMesh->push_back(lastOutterVert);
-            ++fSegmentIt;
-        }
-
-        if ( fprev != fIt->end() ) {
-            ++fprev;
-        }
-        if ( fnext != fIt->end() ) {
-            ++fnext;
-        }
-
-
-
-        for (;;) {
-
-            if ( fnext == fIt->end() ) {
-                fnext = fIt->begin();
-            }
-            if ( fprev == fIt->end() ) {
-                fprev = fIt->begin();
-            }
-
-            double inner_t = (double)INT_MAX;
-            double outter_t = (double)INT_MAX;
-            bool gotOne = false;
-            if (bSegmentIt != it->end()) {
-                inner_t = bSegmentIt->t;
-                gotOne = true;
-            }
-            if (fSegmentIt != fIt->end()) {
-                outter_t = fSegmentIt->t;
-                gotOne = true;
-            }
-
-            if (!gotOne) {
-                break;
-            }
-
-            // Pick the point with the minimum t
-            if (inner_t <= outter_t) {
-                if ( bSegmentIt != it->end() ) {
-                    lastInnerVert.x = bSegmentIt->x;
-                    lastInnerVert.y = bSegmentIt->y;
-                    lastInnerVert.isInner = true;
-                    featherMesh->push_back(lastInnerVert);
-                    ++bSegmentIt;
-                }
-            } else {
-                if ( fSegmentIt != fIt->end() ) {
-                    lastOutterVert.x = fSegmentIt->x;
-                    lastOutterVert.y = fSegmentIt->y;
-
-                    if (absFeatherDist) {
-                        double diffx = fnext->x - fprev->x;
-                        double diffy = fnext->y - fprev->y;
-                        double norm = std::sqrt( diffx * diffx + diffy * diffy );
-                        double dx = (norm != 0) ? -( diffy / norm ) : 0;
-                        double dy = (norm != 0) ? ( diffx / norm ) : 1;
-
-                        if (!clockWise) {
-                            lastOutterVert.x -= dx * absFeatherDist;
-                            lastOutterVert.y -= dy * absFeatherDist;
-                        } else {
-                            lastOutterVert.x += dx * absFeatherDist;
-                            lastOutterVert.y += dy * absFeatherDist;
-                        }
-                    }
-                    lastOutterVert.isInner = false;
-                    featherMesh->push_back(lastOutterVert);
-                    ++fSegmentIt;
-                }
-
-
-                if ( fprev != fIt->end() ) {
-                    ++fprev;
-                }
-                if ( fnext != fIt->end() ) {
-                    ++fnext;
-                }
-            }
-
-            // Initialize the first segment of the next triangle if we did not reach the end
-            if (fSegmentIt == fIt->end() && bSegmentIt == it->end()) {
-                break;
-            }
-            featherMesh->push_back(lastOutterVert);
-            featherMesh->push_back(lastInnerVert);
-
-
-        } // for(;;)
-
-
-    } // for all points in polygon
-
-    // Now tesselate the internal bezier using glu
-    tessPolygonData tessData;
-    tessData.internalStrips = internalStrips;
-    tessData.internalFans = internalFans;
-    tessData.internalTriangles = internalTriangles;
-    tessData.error = 0;
-    libtess_GLUtesselator* tesselator = libtess_gluNewTess();
-
-    libtess_gluTessCallback(tesselator, LIBTESS_GLU_TESS_BEGIN_DATA, (void (*)())tess_begin_primitive_callback);
-    libtess_gluTessCallback(tesselator, LIBTESS_GLU_TESS_VERTEX_DATA, (void (*)())tess_vertex_callback);
-    libtess_gluTessCallback(tesselator, LIBTESS_GLU_TESS_END_DATA, (void (*)())tess_end_primitive_callback);
-    libtess_gluTessCallback(tesselator, LIBTESS_GLU_TESS_ERROR_DATA, (void (*)())tess_error_callback);
-    libtess_gluTessCallback(tesselator, LIBTESS_GLU_TESS_COMBINE_DATA, (void (*)())tess_intersection_combine_callback);
-
-    // From README: if you know that all polygons lie in the x-y plane, call
-    // gluTessNormal(tess, 0.0, 0.0, 1.0) before rendering any polygons.
-    libtess_gluTessNormal(tesselator, 0, 0, 1);
-    libtess_gluTessBeginPolygon(tesselator, (void*)&tessData);
-    libtess_gluTessBeginContour(tesselator);
-
-    for (std::list<std::list<ParametricPoint> >::const_iterator it = bezierPolygon.begin(); it != bezierPolygon.end(); ++it) {
-        for (std::list<ParametricPoint>::const_iterator it2 = it->begin(); it2 != it->end(); ++it2) {
-            double coords[3] = {it2->x, it2->y, 1.};
-            libtess_gluTessVertex(tesselator, coords, (void*)&(*it2) /*per-vertex client data*/);
-        }
-    }
-
-
-    libtess_gluTessEndContour(tesselator);
-    libtess_gluTessEndPolygon(tesselator);
-    libtess_gluDeleteTess(tesselator);
-
-    // check for errors
-    assert(tessData.error == 0);
-
-} // RotoContextPrivate::computeFeatherTriangles
-
-void
-RotoContextPrivate::renderInternalShape_cairo(const std::list<RotoTriangles>& triangles,
-                                              const std::list<RotoTriangleFans>& fans,
-                                              const std::list<RotoTriangleStrips>& strips,
-                                              double shapeColor[3], cairo_pattern_t * mesh)
-{
-    for (std::list<RotoTriangles>::const_iterator it = triangles.begin(); it!=triangles.end(); ++it ) {
-
-        assert(it->vertices.size() >= 3 && it->vertices.size() % 3 == 0);
-
-        int c = 0;
-        const Point* coonsPatchStart = 0;
-        for (std::list<Point>::const_iterator it2 = it->vertices.begin(); it2!=it->vertices.end(); ++it2) {
-            if (c == 0) {
-                cairo_mesh_pattern_begin_patch(mesh);
-                cairo_mesh_pattern_move_to(mesh, it2->x, it2->y);
-                coonsPatchStart = &(*it2);
-            } else {
-                cairo_mesh_pattern_line_to(mesh, it2->x, it2->y);
-            }
-            if (c == 2) {
-                assert(coonsPatchStart);
-                // close coons patch by transforming the triangle into a degenerated coons patch
-                cairo_mesh_pattern_line_to(mesh, coonsPatchStart->x, coonsPatchStart->y);
-                // IMPORTANT NOTE:
-                // The two sqrt below are due to a probable cairo bug.
-                // To check wether the bug is present is a given cairo version,
-                // make any shape with a very large feather and set
-                // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-                // and approximately equal to 0.5.
-                // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-                // older Cairo versions.
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-                cairo_mesh_pattern_end_patch(mesh);
-                c = 0;
-            } else {
-                ++c;
-            }
-        }
-    }
-    for (std::list<RotoTriangleFans>::const_iterator it = fans.begin(); it!=fans.end(); ++it ) {
-
-        assert(it->vertices.size() >= 3);
-        std::list<Point>::const_iterator cur = it->vertices.begin();
-        const Point* fanStart = &(*(cur));
-        ++cur;
-        std::list<Point>::const_iterator next = cur;
-        ++next;
-        for (;next != it->vertices.end();) {
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, fanStart->x, fanStart->y);
-            cairo_mesh_pattern_line_to(mesh, cur->x, cur->y);
-            cairo_mesh_pattern_line_to(mesh, next->x, next->y);
-            cairo_mesh_pattern_line_to(mesh, fanStart->x, fanStart->y);
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check wether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
-
-            ++next;
-            ++cur;
-        }
-    }
-    for (std::list<RotoTriangleStrips>::const_iterator it = strips.begin(); it!=strips.end(); ++it ) {
-
-        assert(it->vertices.size() >= 3);
-
-        std::list<Point>::const_iterator cur = it->vertices.begin();
-        const Point* prevPrev = &(*(cur));
-        ++cur;
-        const Point* prev = &(*(cur));
-        ++cur;
-        for (; cur != it->vertices.end(); ++cur) {
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, prevPrev->x, prevPrev->y);
-            cairo_mesh_pattern_line_to(mesh, prev->x, prev->y);
-            cairo_mesh_pattern_line_to(mesh, cur->x, cur->y);
-            cairo_mesh_pattern_line_to(mesh, prevPrev->x, prevPrev->y);
-
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check wether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
-            
-            prevPrev = prev;
-            prev = &(*(cur));
-        }
-    }
-}
-
-
-void
-RotoContextPrivate::renderInternalShape(double time,
-                                        unsigned int mipmapLevel,
-                                        double /*shapeColor*/[3],
-                                        double /*opacity*/,
-                                        const Transform::Matrix3x3& transform,
-                                        cairo_t* cr,
-#ifdef ROTO_USE_MESH_PATTERN_ONLY
-                                        cairo_pattern_t* mesh,
-#else
-                                        cairo_pattern_t* /*mesh*/,
-#endif
-                                        const BezierCPs & cps)
-{
-    assert( !cps.empty() );
-#ifdef ROTO_USE_MESH_PATTERN_ONLY
-    std::list<BezierCPs> coonPatches;
-    bezulate(time, cps, &coonPatches);
-
-    for (std::list<BezierCPs>::iterator it = coonPatches.begin(); it != coonPatches.end(); ++it) {
-        std::list<BezierCPs> fixedPatch;
-        CoonsRegularization::regularize(*it, time, &fixedPatch);
-        for (std::list<BezierCPs>::iterator it2 = fixedPatch.begin(); it2 != fixedPatch.end(); ++it2) {
-            std::size_t size = it2->size();
-            assert(size <= 4 && size >= 2);
-
-            BezierCPs::iterator patchIT = it2->begin();
-            BezierCPPtr p0ptr, p1ptr, p2ptr, p3ptr;
-            p0ptr = *patchIT;
-            ++patchIT;
-            if (size == 2) {
-                p1ptr = p0ptr;
-                p2ptr = *patchIT;
-                p3ptr = p2ptr;
-            } else if (size == 3) {
-                p1ptr = *patchIT;
-                p2ptr = *patchIT;
-                ++patchIT;
-                p3ptr = *patchIT;
-            } else if (size == 4) {
-                p1ptr = *patchIT;
-                ++patchIT;
-                p2ptr = *patchIT;
-                ++patchIT;
-                p3ptr = *patchIT;
-            }
-            assert(p0ptr && p1ptr && p2ptr && p3ptr);
-
-            Point p0, p0p1, p1p0, p1, p1p2, p2p1, p2p3, p3p2, p2, p3, p3p0, p0p3;
-
-            p0ptr->getLeftBezierPointAtTime(time, &p0p3.x, &p0p3.y);
-            p0ptr->getPositionAtTime(time, &p0.x, &p0.y);
-            p0ptr->getRightBezierPointAtTime(time, &p0p1.x, &p0p1.y);
-
-            p1ptr->getLeftBezierPointAtTime(time, &p1p0.x, &p1p0.y);
-            p1ptr->getPositionAtTime(time, &p1.x, &p1.y);
-            p1ptr->getRightBezierPointAtTime(time, &p1p2.x, &p1p2.y);
-
-            p2ptr->getLeftBezierPointAtTime(time, &p2p1.x, &p2p1.y);
-            p2ptr->getPositionAtTime(time, &p2.x, &p2.y);
-            p2ptr->getRightBezierPointAtTime(time, &p2p3.x, &p2p3.y);
-
-            p3ptr->getLeftBezierPointAtTime(time, &p3p2.x, &p3p2.y);
-            p3ptr->getPositionAtTime(time, &p3.x, &p3.y);
-            p3ptr->getRightBezierPointAtTime(time, &p3p0.x, &p3p0.y);
-
-
-            adjustToPointToScale(mipmapLevel, p0.x, p0.y);
-            adjustToPointToScale(mipmapLevel, p0p1.x, p0p1.y);
-            adjustToPointToScale(mipmapLevel, p1p0.x, p1p0.y);
-            adjustToPointToScale(mipmapLevel, p1.x, p1.y);
-            adjustToPointToScale(mipmapLevel, p1p2.x, p1p2.y);
-            adjustToPointToScale(mipmapLevel, p2p1.x, p2p1.y);
-            adjustToPointToScale(mipmapLevel, p2.x, p2.y);
-            adjustToPointToScale(mipmapLevel, p2p3.x, p2p3.y);
-            adjustToPointToScale(mipmapLevel, p3p2.x, p3p2.y);
-            adjustToPointToScale(mipmapLevel, p3.x, p3.y);
-            adjustToPointToScale(mipmapLevel, p3p0.x, p3p0.y);
-            adjustToPointToScale(mipmapLevel, p0p3.x, p0p3.y);
-
-            // Add a Coons patch such as:
-
-            //         C1  Side 1   C2
-            //        +---------------+
-            //        |               |
-            //        |  P1       P2  |
-            //        |               |
-            // Side 0 |               | Side 2
-            //        |               |
-            //        |               |
-            //        |  P0       P3  |
-            //        |               |
-            //        +---------------+
-            //        C0     Side 3   C3
-
-            // In the above drawing, C0 is p0, P0 is p0p1, P1 is p1p0, C1 is p1 and so on...
-
-            ///move to C0
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-            if (size == 4) {
-                cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-                cairo_mesh_pattern_curve_to(mesh, p1p2.x, p1p2.y, p2p1.x, p2p1.y, p2.x, p2.y);
-                cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            } else if (size == 3) {
-                cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-                cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-                cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            } else {
-                assert(size == 2);
-                cairo_mesh_pattern_line_to(mesh, p1.x, p1.y);
-                cairo_mesh_pattern_curve_to(mesh, p1p2.x, p1p2.y, p2p1.x, p2p1.y, p2.x, p2.y);
-                cairo_mesh_pattern_line_to(mesh, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            }
-            ///Set the 4 corners color
-
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check wether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                      std::sqrt(opacity) );
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                     opacity);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                     opacity);
-            cairo_mesh_pattern_set_corner_color_rgba( mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                      std::sqrt(opacity) );
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
-        }
-    }
-#else // ifdef ROTO_USE_MESH_PATTERN_ONLY
-
-    cairo_set_source_rgba(cr, 1, 1, 1, 1);
-
-    BezierCPs::const_iterator point = cps.begin();
-    assert( point != cps.end() );
-    if ( point == cps.end() ) {
-        return;
-    }
-    BezierCPs::const_iterator nextPoint = point;
-    if ( nextPoint != cps.end() ) {
-        ++nextPoint;
-    }
-
-
-    Transform::Point3D initCp;
-    (*point)->getPositionAtTime(false, time, ViewIdx(0), &initCp.x, &initCp.y);
-    initCp.z = 1.;
-    initCp = Transform::matApply(transform, initCp);
-
-    adjustToPointToScale(mipmapLevel, initCp.x, initCp.y);
-
-    cairo_move_to(cr, initCp.x, initCp.y);
-
-    while ( point != cps.end() ) {
-        if ( nextPoint == cps.end() ) {
-            nextPoint = cps.begin();
-        }
-
-        Transform::Point3D right, nextLeft, next;
-        (*point)->getRightBezierPointAtTime(false, time, ViewIdx(0), &right.x, &right.y);
-        right.z = 1;
-        (*nextPoint)->getLeftBezierPointAtTime(false, time, ViewIdx(0), &nextLeft.x, &nextLeft.y);
-        nextLeft.z = 1;
-        (*nextPoint)->getPositionAtTime(false, time, ViewIdx(0), &next.x, &next.y);
-        next.z = 1;
-
-        right = Transform::matApply(transform, right);
-        nextLeft = Transform::matApply(transform, nextLeft);
-        next = Transform::matApply(transform, next);
-
-        adjustToPointToScale(mipmapLevel, right.x, right.y);
-        adjustToPointToScale(mipmapLevel, next.x, next.y);
-        adjustToPointToScale(mipmapLevel, nextLeft.x, nextLeft.y);
-        cairo_curve_to(cr, right.x, right.y, nextLeft.x, nextLeft.y, next.x, next.y);
-
-        // increment for next iteration
-        ++point;
-        if ( nextPoint != cps.end() ) {
-            ++nextPoint;
-        }
-    } // while()
-//    if (cairo_get_antialias(cr) != CAIRO_ANTIALIAS_NONE ) {
-//        cairo_fill_preserve(cr);
-//        // These line properties make for a nicer looking polygon mesh
-//        cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
-//        cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT);
-//        // Comment out the following call to cairo_set_line width
-//        // since the hard-coded width value of 1.0 is not appropriate
-//        // for fills of small areas. Instead, use the line width that
-//        // has already been set by the user via the above call of
-//        // poly_line which in turn calls set_current_context which in
-//        // turn calls cairo_set_line_width for the user-specified
-//        // width.
-//        cairo_set_line_width(cr, 1.0);
-//        cairo_stroke(cr);
-//    } else {
-    cairo_fill(cr);
-//    }
-#endif // ifdef ROTO_USE_MESH_PATTERN_ONLY
-} // RotoContextPrivate::renderInternalShape
-
-struct qpointf_compare_less
-{
-    bool operator() (const QPointF& lhs,
-                     const QPointF& rhs) const
-    {
-        if (std::abs( lhs.x() - rhs.x() ) < 1e-6) {
-            if (std::abs( lhs.y() - rhs.y() ) < 1e-6) {
-                return false;
-            } else if ( lhs.y() < rhs.y() ) {
-                return true;
-            } else {
-                return false;
-            }
-        } else if ( lhs.x() < rhs.x() ) {
-            return true;
-        } else {
-            return false;
-        }
-    }
-};
-
-static bool
-pointInPolygon(const Point & p,
-               const std::list<Point> & polygon,
-               const RectD & featherPolyBBox,
-               Bezier::FillRuleEnum rule)
-{
-    ///first check if the point lies inside the bounding box
-    if ( (p.x < featherPolyBBox.x1) || (p.x >= featherPolyBBox.x2) || (p.y < featherPolyBBox.y1) || (p.y >= featherPolyBBox.y2)
-         || polygon.empty() ) {
-        return false;
-    }
-
-    int winding_number = 0;
-    std::list<Point>::const_iterator last_pt = polygon.begin();
-    std::list<Point>::const_iterator last_start = last_pt;
-    std::list<Point>::const_iterator cur = last_pt;
-    ++cur;
-    for (; cur != polygon.end(); ++cur, ++last_pt) {
-        Bezier::point_line_intersection(*last_pt, *cur, p, &winding_number);
-    }
-
-    // implicitly close last subpath
-    if (last_pt != last_start) {
-        Bezier::point_line_intersection(*last_pt, *last_start, p, &winding_number);
-    }
-
-    return rule == Bezier::eFillRuleWinding
-           ? (winding_number != 0)
-           : ( (winding_number % 2) != 0 );
-}
-
-//From http://www.math.ualberta.ca/~bowman/publications/cad10.pdf
-void
-RotoContextPrivate::bezulate(double time,
-                             const BezierCPs& cps,
-                             std::list<BezierCPs>* patches)
-{
-    BezierCPs simpleClosedCurve = cps;
-
-    while (simpleClosedCurve.size() > 4) {
-        bool found = false;
-        for (int n = 3; n >= 2; --n) {
-            assert( (int)simpleClosedCurve.size() > n );
-
-            //next points at point i + n
-            BezierCPs::iterator next = simpleClosedCurve.begin();
-            std::advance(next, n);
-            std::list<Point> polygon;
-            RectD bbox;
-            bbox.setupInfinity();
-            for (BezierCPs::iterator it = simpleClosedCurve.begin(); it != simpleClosedCurve.end(); ++it) {
-                Point p;
-                (*it)->getPositionAtTime(false, time, ViewIdx(0), &p.x, &p.y);
-                polygon.push_back(p);
-                if (p.x < bbox.x1) {
-                    bbox.x1 = p.x;
-                }
-                if (p.x > bbox.x2) {
-                    bbox.x2 = p.x;
-                }
-                if (p.y < bbox.y1) {
-                    bbox.y1 = p.y;
-                }
-                if (p.y > bbox.y2) {
-                    bbox.y2 = p.y;
-                }
-            }
-
-
-            for (BezierCPs::iterator it = simpleClosedCurve.begin(); it != simpleClosedCurve.end(); ++it) {
-                bool nextIsPassedEnd = false;
-                if ( next == simpleClosedCurve.end() ) {
-                    next = simpleClosedCurve.begin();
-                    nextIsPassedEnd = true;
-                }
-
-                //mid-point of the line segment between points i and i + n
-                Point nextPoint, curPoint;
-                (*it)->getPositionAtTime(false, time, ViewIdx(0), &curPoint.x, &curPoint.y);
-                (*next)->getPositionAtTime(false, time, ViewIdx(0), &nextPoint.x, &nextPoint.y);
-
-                /*
-                 * Compute the number of intersections between the current line segment [it,next] and all other line segments
-                 * If the number of intersections is different of 2, ignore this segment.
-                 */
-                QLineF line( QPointF(curPoint.x, curPoint.y), QPointF(nextPoint.x, nextPoint.y) );
-                std::set<QPointF, qpointf_compare_less> intersections;
-                std::list<Point>::const_iterator last_pt = polygon.begin();
-                std::list<Point>::const_iterator cur = last_pt;
-                ++cur;
-                QPointF intersectionPoint;
-                for (; cur != polygon.end(); ++cur, ++last_pt) {
-                    QLineF polygonSegment( QPointF(last_pt->x, last_pt->y), QPointF(cur->x, cur->y) );
-                    if (line.intersect(polygonSegment, &intersectionPoint) == QLineF::BoundedIntersection) {
-                        intersections.insert(intersectionPoint);
-                    }
-                    if (intersections.size() > 2) {
-                        break;
-                    }
-                }
-
-                if (intersections.size() != 2) {
-                    continue;
-                }
-
-                /*
-                 * Check if the midpoint of the line segment [it,next] lies inside the simple closed curve (polygon), otherwise
-                 * ignore it.
-                 */
-                Point midPoint;
-                midPoint.x = (nextPoint.x + curPoint.x) / 2.;
-                midPoint.y = (nextPoint.y + curPoint.y) / 2.;
-                bool isInside = pointInPolygon(midPoint, polygon, bbox, Bezier::eFillRuleWinding);
-
-                if (isInside) {
-                    //Make the sub closed curve composed of the path from points i to i + n
-                    BezierCPs subCurve;
-                    subCurve.push_back(*it);
-                    BezierCPs::iterator pointIt = it;
-                    for (int i = 0; i < n - 1; ++i) {
-                        ++pointIt;
-                        if ( pointIt == simpleClosedCurve.end() ) {
-                            pointIt = simpleClosedCurve.begin();
-                        }
-                        subCurve.push_back(*pointIt);
-                    }
-                    subCurve.push_back(*next);
-
-                    // Ensure that all interior angles are less than 180 degrees.
-
-
-                    patches->push_back(subCurve);
-
-                    //Remove i + 1 to i + n
-                    BezierCPs::iterator eraseStart = it;
-                    ++eraseStart;
-                    bool eraseStartIsPassedEnd = false;
-                    if ( eraseStart == simpleClosedCurve.end() ) {
-                        eraseStart = simpleClosedCurve.begin();
-                        eraseStartIsPassedEnd = true;
-                    }
-                    //"it" is  invalidated after the next instructions but we leave the loop anyway
-                    assert( !simpleClosedCurve.empty() );
-                    if ( (!nextIsPassedEnd && !eraseStartIsPassedEnd) || (nextIsPassedEnd && eraseStartIsPassedEnd) ) {
-                        simpleClosedCurve.erase(eraseStart, next);
-                    } else {
-                        simpleClosedCurve.erase( eraseStart, simpleClosedCurve.end() );
-                        if ( !simpleClosedCurve.empty() ) {
-                            simpleClosedCurve.erase(simpleClosedCurve.begin(), next);
-                        }
-                    }
-                    found = true;
-                    break;
-                }
-
-                // increment for next iteration
-                if ( next != simpleClosedCurve.end() ) {
-                    ++next;
-                }
-            } // for(it)
-            if (found) {
-                break;
-            }
-        } // for(n)
-
-        if (!found) {
-            BezierCPs subdivisedCurve;
-            //Subdivise the curve at the midpoint of each segment
-            BezierCPs::iterator next = simpleClosedCurve.begin();
-            if ( next != simpleClosedCurve.end() ) {
-                ++next;
-            }
-            for (BezierCPs::iterator it = simpleClosedCurve.begin(); it != simpleClosedCurve.end(); ++it) {
-                if ( next == simpleClosedCurve.end() ) {
-                    next = simpleClosedCurve.begin();
-                }
-                Point p0, p1, p2, p3, p0p1, p1p2, p2p3, p0p1_p1p2, p1p2_p2p3, dest;
-                (*it)->getPositionAtTime(false, time, ViewIdx(0), &p0.x, &p0.y);
-                (*it)->getRightBezierPointAtTime(false, time, ViewIdx(0), &p1.x, &p1.y);
-                (*next)->getLeftBezierPointAtTime(false, time, ViewIdx(0), &p2.x, &p2.y);
-                (*next)->getPositionAtTime(false, time, ViewIdx(0), &p3.x, &p3.y);
-                Bezier::bezierFullPoint(p0, p1, p2, p3, 0.5, &p0p1, &p1p2, &p2p3, &p0p1_p1p2, &p1p2_p2p3, &dest);
-                BezierCPPtr controlPoint = boost::make_shared<BezierCP>();
-                controlPoint->setStaticPosition(false, dest.x, dest.y);
-                controlPoint->setLeftBezierStaticPosition(false, p0p1_p1p2.x, p0p1_p1p2.y);
-                controlPoint->setRightBezierStaticPosition(false, p1p2_p2p3.x, p1p2_p2p3.y);
-                subdivisedCurve.push_back(*it);
-                subdivisedCurve.push_back(controlPoint);
-
-                // increment for next iteration
-                if ( next != simpleClosedCurve.end() ) {
-                    ++next;
-                }
-            } // for()
-            simpleClosedCurve = subdivisedCurve;
-        }
-    }
-    if ( !simpleClosedCurve.empty() ) {
-        assert(simpleClosedCurve.size() >= 2);
-        patches->push_back(simpleClosedCurve);
-    }
-} // RotoContextPrivate::bezulate
-
-void
-RotoContextPrivate::applyAndDestroyMask(cairo_t* cr,
-                                        cairo_pattern_t* mesh)
-{
-    assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-    cairo_set_source(cr, mesh);
-
-    ///paint with the feather with the pattern as a mask
-    cairo_mask(cr, mesh);
-
-    cairo_pattern_destroy(mesh);
-}
-
 void
 RotoContext::changeItemScriptName(const std::string& oldFullyQualifiedName,
                                   const std::string& newFullyQUalifiedName)
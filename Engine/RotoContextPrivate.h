@@ -56,6 +56,7 @@ CLANG_DIAG_ON(uninitialized)
 #include "Global/GlobalDefines.h"
 
 #include "Engine/AppManager.h"
+#include "Engine/Bezier.h"
 #include "Engine/BezierCP.h"
 #include "Engine/Curve.h"
 #include "Engine/EffectInstance.h"
@@ -375,27 +376,6 @@ enum RotoPaintItemLifeTimeTypeEnum
 
 NATRON_NAMESPACE_ENTER
 
-struct RotoFeatherVertex
-{
-    double x,y;
-    bool isInner;
-};
-
-struct RotoTriangleStrips
-{
-    std::list<Point> vertices;
-};
-
-struct RotoTriangleFans
-{
-    std::list<Point> vertices;
-};
-
-struct RotoTriangles
-{
-    std::list<Point> vertices;
-};
-
 struct BezierPrivate
 {
     BezierCPs points; //< the control points of the curve
@@ -413,6 +393,13 @@ struct BezierPrivate
     mutable QMutex guiCopyMutex;
     bool mustCopyGui;
 
+    // The shapes returned by Bezier::getShapeAtTime(), by time and mipmap level. They were computed
+    // when the ages of the bezier and of its RotoContext were shapesItemAge and shapesContextAge.
+    mutable QMutex shapesMutex;
+    mutable std::map<std::pair<double, unsigned int>, BezierShapePtr> shapes;
+    mutable U64 shapesItemAge;
+    mutable U64 shapesContextAge;
+
     BezierPrivate(bool isOpenBezier)
         : points()
         , featherPoints()
@@ -425,6 +412,10 @@ struct BezierPrivate
         , isOpenBezier(isOpenBezier)
         , guiCopyMutex()
         , mustCopyGui(false)
+        , shapesMutex()
+        , shapes()
+        , shapesItemAge(0)
+        , shapesContextAge(0)
     {
     }
 
@@ -785,6 +776,10 @@ public:
     //Used to prevent 2 threads from writing the same image in the rotocontext
     mutable QReadWriteLock cacheAccessMutex;
 
+    // Incremented by incrementNodesAge() each time the item is modified
+    mutable QMutex ageMutex;
+    U64 age;
+
     RotoDrawableItemPrivate(bool isPaintingNode)
         : effectNode()
         , mergeNode()
@@ -833,6 +828,8 @@ public:
         , timeOffsetMode()
         , knobs()
         , cacheAccessMutex()
+        , ageMutex()
+        , age(0)
     {
         opacity = boost::make_shared<KnobDouble>((KnobHolder*)NULL, tr(kRotoOpacityParamLabel), 1, true);
         opacity->setHintToolTip( tr(kRotoOpacityHint) );
@@ -2227,17 +2224,10 @@ public:
                                double opacity,
                                double time,
                                unsigned int mipmapLevel);
-    static void renderBezier(cairo_t* cr, const Bezier* bezier, double opacity, double time, double startTime, double endTime, double mbFrameStep, unsigned int mipmapLevel);
-    static void renderFeather(const Bezier * bezier, double time, unsigned int mipmapLevel, double shapeColor[3], double opacity, double featherDist, double fallOff, cairo_pattern_t * mesh);
-    static void renderFeather_cairo(const std::list<RotoFeatherVertex>& vertices, double shapeColor[3],  double fallOff, cairo_pattern_t * mesh);
-    static void renderInternalShape_cairo(const std::list<RotoTriangles>& triangles,
-                                          const std::list<RotoTriangleFans>& fans,
-                                          const std::list<RotoTriangleStrips>& strips,
-                                          double shapeColor[3],  cairo_pattern_t * mesh);
-    static void computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel,  double featherDist, std::list<RotoFeatherVertex>* featherMesh, std::list<RotoTriangleFans>* internalFans, std::list<RotoTriangles>* internalTriangles,std::list<RotoTriangleStrips>* internalStrips);
-    static void renderInternalShape(double time, unsigned int mipmapLevel, double shapeColor[3], double opacity, const Transform::Matrix3x3 & transform, cairo_t * cr, cairo_pattern_t * mesh, const BezierCPs &cps);
-    static void bezulate(double time, const BezierCPs& cps, std::list<BezierCPs>* patches);
-    static void applyAndDestroyMask(cairo_t* cr, cairo_pattern_t* mesh);
+    /**
+     * @brief Adds the shape of the bezier at each motion blur sample between startTime and endTime to the rasterizer.
+     **/
+    static void renderBezier(RotoShapeRasterizer* rasterizer, const Bezier* bezier, double time, double startTime, double endTime, double mbFrameStep, unsigned int mipmapLevel);
 };
 
 NATRON_NAMESPACE_EXIT
@@ -657,6 +657,10 @@ RotoDrawableItem::rotoKnobChanged(const KnobIPtr& knob,
 void
 RotoDrawableItem::incrementNodesAge()
 {
+    {
+        QMutexLocker k(&_imp->ageMutex);
+        ++_imp->age;
+    }
     if ( getContext()->getNode()->getApp()->getProject()->isLoadingProject() ) {
         return;
     }
@@ -674,6 +678,14 @@ RotoDrawableItem::incrementNodesAge()
     }
 }
 
+U64
+RotoDrawableItem::getAge() const
+{
+    QMutexLocker k(&_imp->ageMutex);
+
+    return _imp->age;
+}
+
 NodePtr
 RotoDrawableItem::getEffectNode() const
 {
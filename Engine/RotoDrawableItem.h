@@ -84,6 +84,11 @@ public:
 
     void incrementNodesAge();
 
+    /**
+     * @brief Returns a counter incremented by incrementNodesAge() each time the item is modified.
+     **/
+    U64 getAge() const;
+
     void refreshNodesConnections();
 
     virtual void clone(const RotoItem*  other) OVERRIDE;
@@ -0,0 +1,363 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RotoShapeRasterizer.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+// The number of intervals of the table of the feather opacity
+#define ROTO_FEATHER_OPACITY_TABLE_SIZE 1024
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+/*
+ * The polygons are filled with the signed area accumulation method of font rasterizers: each edge adds to the cells
+ * of the pixels it crosses the signed area it covers on their left, and the running sum of the cells along a row
+ * is the coverage of its pixels. The cells have width + 2 columns: the edges on the right of the rectangle
+ * are accumulated in the last columns, which are not read.
+ */
+
+// Accumulates the edge (x0,y0)-(x1,y1), with 0 <= x <= width, in the cells of the rows it crosses
+void
+accumulateClampedEdge(double x0,
+                      double y0,
+                      double x1,
+                      double y1,
+                      int width,
+                      int height,
+                      float* cells)
+{
+    double dir = 1.;
+
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.;
+    }
+    const double dxdy = (x1 - x0) / (y1 - y0);
+    double x = x0;
+    int yStart = (int)std::floor(y0);
+    if (y0 < 0.) {
+        x = std::min( std::max(x - y0 * dxdy, 0.), (double)width );
+        yStart = 0;
+    }
+    const int yEnd = std::min( height, (int)std::ceil(y1) );
+    const int rowSize = width + 2;
+
+    for (int y = yStart; y < yEnd; ++y) {
+        float* row = cells + (std::size_t)y * rowSize;
+        const double dy = std::min(y + 1., y1) - std::max( (double)y, y0 );
+        const double xNext = std::min( std::max(x + dxdy * dy, 0.), (double)width );
+        const double d = dy * dir;
+        const double xa = std::min(x, xNext);
+        const double xb = std::max(x, xNext);
+        const double xaFloor = std::floor(xa);
+        const int xai = (int)xaFloor;
+        const double xbCeil = std::ceil(xb);
+        const int xbi = (int)xbCeil;
+
+        if (xbi <= xai + 1) {
+            // the edge is in a single pixel of the row
+            const double xmf = 0.5 * (x + xNext) - xaFloor;
+            row[xai] += (float)(d - d * xmf);
+            row[xai + 1] += (float)(d * xmf);
+        } else {
+            const double s = 1. / (xb - xa);
+            const double xaf = xa - xaFloor;
+            const double a0 = 0.5 * s * (1. - xaf) * (1. - xaf);
+            const double xbf = xb - xbCeil + 1.;
+            const double am = 0.5 * s * xbf * xbf;
+            row[xai] += (float)(d * a0);
+            if (xbi == xai + 2) {
+                row[xai + 1] += (float)( d * (1. - a0 - am) );
+            } else {
+                const double a1 = s * (1.5 - xaf);
+                row[xai + 1] += (float)( d * (a1 - a0) );
+                for (int xi = xai + 2; xi < xbi - 1; ++xi) {
+                    row[xi] += (float)(d * s);
+                }
+                const double a2 = a1 + (xbi - xai - 3) * s;
+                row[xbi - 1] += (float)( d * (1. - a2 - am) );
+            }
+            row[xbi] += (float)(d * am);
+        }
+        x = xNext;
+    }
+} // accumulateClampedEdge
+
+// Accumulates the edge (x0,y0)-(x1,y1) in the cells. The parts of the edge on the left of the rectangle are
+// moved on its left side, where they cover the whole row, and the parts on its right are moved on its right side.
+void
+accumulateEdge(double x0,
+               double y0,
+               double x1,
+               double y1,
+               int width,
+               int height,
+               float* cells)
+{
+    if ( (y0 == y1) || ( (y0 <= 0.) && (y1 <= 0.) ) || ( (y0 >= height) && (y1 >= height) ) ) {
+        return;
+    }
+    const double sides[2] = { 0., (double)width };
+    for (int i = 0; i < 2; ++i) {
+        const double side = sides[i];
+        if ( ( (x0 < side) && (x1 > side) ) || ( (x0 > side) && (x1 < side) ) ) {
+            const double ySide = y0 + (side - x0) * (y1 - y0) / (x1 - x0);
+            accumulateEdge(x0, y0, side, ySide, width, height, cells);
+            accumulateEdge(side, ySide, x1, y1, width, height, cells);
+
+            return;
+        }
+    }
+    accumulateClampedEdge(std::min( std::max(x0, 0.), (double)width ), y0,
+                          std::min( std::max(x1, 0.), (double)width ), y1,
+                          width, height, cells);
+}
+
+// The position, between 0 and 1, at the parameter u of the sides of a feather patch going from the inner edge to the outer edge.
+// These sides were cubic Bezier curves with their control points on the segment, at the positions a and b.
+inline double
+featherSidePosition(double u,
+                    double a,
+                    double b)
+{
+    const double v = 1. - u;
+
+    return 3. * u * v * v * a + 3. * u * u * v * b + u * u * u;
+}
+
+// The edge function of p relative to the edge (a,b): positive on the left of the edge
+inline double
+edgeFunction(const Point & a,
+             const Point & b,
+             double x,
+             double y)
+{
+    return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+// Pixel centers exactly on an edge belong to only one of the two triangles sharing it
+inline bool
+isInside(double w,
+         const Point & a,
+         const Point & b)
+{
+    return w > 0. || ( w == 0. && ( (b.y < a.y) || ( (b.y == a.y) && (b.x > a.x) ) ) );
+}
+} // anon namespace
+
+RotoShapeRasterizer::RotoShapeRasterizer()
+    : _shapes()
+{
+}
+
+RotoShapeRasterizer::~RotoShapeRasterizer()
+{
+}
+
+void
+RotoShapeRasterizer::addShape(const std::vector<Point> & polygon,
+                              const std::vector<Point> & featherInner,
+                              const std::vector<Point> & featherOuter,
+                              double fallOff)
+{
+    assert( featherInner.size() == featherOuter.size() );
+    _shapes.push_back( Shape() );
+    Shape & shape = _shapes.back();
+
+    shape.x1 = shape.y1 = std::numeric_limits<double>::infinity();
+    shape.x2 = shape.y2 = -std::numeric_limits<double>::infinity();
+    if (polygon.size() >= 3) {
+        shape.polygon = polygon;
+        for (std::size_t i = 0; i < polygon.size(); ++i) {
+            shape.x1 = std::min(shape.x1, polygon[i].x);
+            shape.x2 = std::max(shape.x2, polygon[i].x);
+            shape.y1 = std::min(shape.y1, polygon[i].y);
+            shape.y2 = std::max(shape.y2, polygon[i].y);
+        }
+    }
+
+    const std::size_t nFeatherPoints = std::min( featherInner.size(), featherOuter.size() );
+    if (nFeatherPoints < 2) {
+        return;
+    }
+    shape.feather.reserve(nFeatherPoints * 2);
+    for (std::size_t i = 0; i < nFeatherPoints; ++i) {
+        const std::size_t next = (i + 1) % nFeatherPoints;
+        FeatherTriangle outer, inner;
+        outer.p[0] = featherInner[i];
+        outer.p[1] = featherOuter[i];
+        outer.p[2] = featherOuter[next];
+        outer.distance[0] = 0.;
+        outer.distance[1] = outer.distance[2] = 1.;
+        inner.p[0] = featherInner[i];
+        inner.p[1] = featherOuter[next];
+        inner.p[2] = featherInner[next];
+        inner.distance[0] = inner.distance[2] = 0.;
+        inner.distance[1] = 1.;
+        shape.feather.push_back(outer);
+        shape.feather.push_back(inner);
+        shape.x1 = std::min( shape.x1, std::min(featherInner[i].x, featherOuter[i].x) );
+        shape.x2 = std::max( shape.x2, std::max(featherInner[i].x, featherOuter[i].x) );
+        shape.y1 = std::min( shape.y1, std::min(featherInner[i].y, featherOuter[i].y) );
+        shape.y2 = std::max( shape.y2, std::max(featherInner[i].y, featherOuter[i].y) );
+    }
+
+    // The control points of the sides of the Coons patches that cairo used to render the feather with
+    const double a = 1. / (2. * fallOff * fallOff + 1.);
+    const double b = 2. / (fallOff * fallOff + 2.);
+    shape.featherOpacity.resize(ROTO_FEATHER_OPACITY_TABLE_SIZE + 1);
+    for (int i = 0; i <= ROTO_FEATHER_OPACITY_TABLE_SIZE; ++i) {
+        // The position is monotonic in u since 0 <= a <= b <= 1: find the u of this distance
+        const double distance = (double)i / ROTO_FEATHER_OPACITY_TABLE_SIZE;
+        double u0 = 0., u1 = 1.;
+        for (int k = 0; k < 40; ++k) {
+            const double u = 0.5 * (u0 + u1);
+            if (featherSidePosition(u, a, b) < distance) {
+                u0 = u;
+            } else {
+                u1 = u;
+            }
+        }
+        // The patches were both the source and the mask of cairo_mask(): their opacity was applied twice
+        const double opacity = 1. - 0.5 * (u0 + u1);
+        shape.featherOpacity[i] = (float)(opacity * opacity);
+    }
+} // RotoShapeRasterizer::addShape
+
+void
+RotoShapeRasterizer::rasterizeFeatherTriangle(const FeatherTriangle & triangle,
+                                              const std::vector<float> & featherOpacity,
+                                              const RectI & rect,
+                                              float* feather)
+{
+    Point a = triangle.p[0];
+    Point b = triangle.p[1];
+    Point c = triangle.p[2];
+    double da = triangle.distance[0];
+    double db = triangle.distance[1];
+    double dc = triangle.distance[2];
+    double area = edgeFunction(a, b, c.x, c.y);
+
+    if (area == 0.) {
+        return;
+    }
+    if (area < 0.) {
+        std::swap(b, c);
+        std::swap(db, dc);
+        area = -area;
+    }
+
+    // The pixels whose center is in the bounding box of the triangle
+    const int x1 = std::max( rect.x1, (int)std::ceil(std::min( a.x, std::min(b.x, c.x) ) - 0.5) );
+    const int x2 = std::min( rect.x2, (int)std::floor(std::max( a.x, std::max(b.x, c.x) ) - 0.5) + 1 );
+    const int y1 = std::max( rect.y1, (int)std::ceil(std::min( a.y, std::min(b.y, c.y) ) - 0.5) );
+    const int y2 = std::min( rect.y2, (int)std::floor(std::max( a.y, std::max(b.y, c.y) ) - 0.5) + 1 );
+    const double invArea = 1. / area;
+    const int width = rect.width();
+
+    for (int y = y1; y < y2; ++y) {
+        const double py = y + 0.5;
+        float* row = feather + (std::size_t)(y - rect.y1) * width;
+        for (int x = x1; x < x2; ++x) {
+            const double px = x + 0.5;
+            const double wa = edgeFunction(b, c, px, py);
+            const double wb = edgeFunction(c, a, px, py);
+            const double wc = edgeFunction(a, b, px, py);
+            if ( !isInside(wa, b, c) || !isInside(wb, c, a) || !isInside(wc, a, b) ) {
+                continue;
+            }
+            const double distance = std::min( std::max( (wa * da + wb * db + wc * dc) * invArea, 0. ), 1. );
+            const double index = distance * ROTO_FEATHER_OPACITY_TABLE_SIZE;
+            const int i = std::min( (int)index, ROTO_FEATHER_OPACITY_TABLE_SIZE - 1 );
+            const float f = (float)(index - i);
+            // as in a mesh pattern, the last patch replaces the previous ones
+            row[x - rect.x1] = featherOpacity[i] + f * (featherOpacity[i + 1] - featherOpacity[i]);
+        }
+    }
+} // RotoShapeRasterizer::rasterizeFeatherTriangle
+
+void
+RotoShapeRasterizer::renderCoverage(const RectI & rect,
+                                    float* coverage) const
+{
+    const int width = rect.width();
+
+    std::fill(coverage, coverage + (std::size_t)width * rect.height(), 0.f);
+
+    std::vector<float> buffer;
+    for (std::vector<Shape>::const_iterator it = _shapes.begin(); it != _shapes.end(); ++it) {
+        if ( (it->x2 < rect.x1) || (it->x1 > rect.x2) || (it->y2 < rect.y1) || (it->y1 > rect.y2) ) {
+            continue;
+        }
+        // only the rows of the shape are rendered
+        const RectI area( rect.x1, std::max( rect.y1, (int)std::floor(it->y1) ), rect.x2, std::min( rect.y2, (int)std::ceil(it->y2) ) );
+        if ( area.isNull() ) {
+            continue;
+        }
+        const int height = area.height();
+        float* areaCoverage = coverage + (std::size_t)(area.y1 - rect.y1) * width;
+
+        // The polygon is composited over the previous shapes
+        if ( !it->polygon.empty() ) {
+            buffer.assign( (std::size_t)(width + 2) * height, 0.f );
+            const std::size_t nPoints = it->polygon.size();
+            for (std::size_t i = 0; i < nPoints; ++i) {
+                const Point & p0 = it->polygon[i];
+                const Point & p1 = it->polygon[(i + 1) % nPoints];
+                accumulateEdge(p0.x - area.x1, p0.y - area.y1, p1.x - area.x1, p1.y - area.y1, width, height, &buffer[0]);
+            }
+            for (int y = 0; y < height; ++y) {
+                const float* cells = &buffer[(std::size_t)y * (width + 2)];
+                float* dst = areaCoverage + (std::size_t)y * width;
+                float sum = 0.f;
+                for (int x = 0; x < width; ++x) {
+                    sum += cells[x];
+                    // non-zero winding rule
+                    const float c = std::min(std::abs(sum), 1.f);
+                    dst[x] = c + dst[x] * (1.f - c);
+                }
+            }
+        }
+
+        // then the feather
+        if ( !it->feather.empty() ) {
+            buffer.assign( (std::size_t)width * height, 0.f );
+            for (std::vector<FeatherTriangle>::const_iterator t = it->feather.begin(); t != it->feather.end(); ++t) {
+                rasterizeFeatherTriangle(*t, it->featherOpacity, area, &buffer[0]);
+            }
+            const std::size_t nPixels = (std::size_t)width * height;
+            for (std::size_t i = 0; i < nPixels; ++i) {
+                areaCoverage[i] = buffer[i] + areaCoverage[i] * (1.f - buffer[i]);
+            }
+        }
+    }
+} // RotoShapeRasterizer::renderCoverage
+
+NATRON_NAMESPACE_EXIT
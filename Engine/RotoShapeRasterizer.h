@@ -0,0 +1,105 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+#define NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+#include "Engine/RectI.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Rasterizes the closed shapes of the roto in floating point, without intermediate surface.
+ *
+ * Each shape is made of a polygon, filled with the non-zero winding rule and analytic anti-aliasing, and
+ * of a feather, a band of quads whose opacity goes from 1 on the polygon side to 0 on the outer side.
+ * The shapes are composited over each other in the order they were added, e.g. the motion blur samples of a Bezier.
+ *
+ * The coverage of any rectangle of pixels can be computed independently of the others, so that separate
+ * bands of an image can be rendered concurrently.
+ **/
+class RotoShapeRasterizer
+{
+public:
+
+    RotoShapeRasterizer();
+
+    ~RotoShapeRasterizer();
+
+    /**
+     * @brief Adds a shape, in pixel coordinates.
+     * The feather is made of the quads (featherInner[i], featherOuter[i], featherOuter[i+1], featherInner[i+1]),
+     * the last one joining the last points to the first ones: featherInner and featherOuter must have the same size.
+     * Its opacity goes from 1 to 0 with the given fall-off, 1 being linear, as the Coons patches used to render it with cairo.
+     **/
+    void addShape(const std::vector<Point> & polygon,
+                  const std::vector<Point> & featherInner,
+                  const std::vector<Point> & featherOuter,
+                  double fallOff);
+
+    bool isEmpty() const
+    {
+        return _shapes.empty();
+    }
+
+    /**
+     * @brief Computes the coverage of the pixels of rect, between 0 and 1.
+     * coverage must have rect.width() * rect.height() values, it is filled row by row from rect.y1.
+     * This is thread-safe.
+     **/
+    void renderCoverage(const RectI & rect, float* coverage) const;
+
+private:
+
+    struct FeatherTriangle
+    {
+        Point p[3];
+        double distance[3]; // 0 on the inner edge, 1 on the outer edge
+    };
+
+    struct Shape
+    {
+        std::vector<Point> polygon;
+        std::vector<FeatherTriangle> feather;
+        std::vector<float> featherOpacity; // the feather opacity as a function of the distance
+        double x1, y1, x2, y2; // bounding box
+    };
+
+    static void rasterizeFeatherTriangle(const FeatherTriangle & triangle,
+                                         const std::vector<float> & featherOpacity,
+                                         const RectI & rect,
+                                         float* feather);
+
+    std::vector<Shape> _shapes;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_ROTOSHAPERASTERIZER_H
@@ -192,6 +192,32 @@ Settings::initializeKnobsGeneral()
                                                  "Disabling this will no longer save un-saved project.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ) );
     _generalTab->addKnob(_autoSaveUnSavedProjects);
 
+    _projectFileFormat = AppManager::createKnob<KnobChoice>( this, tr("Project file format") );
+    _projectFileFormat->setName("projectFileFormat");
+    {
+        std::vector<ChoiceOption> entries;
+        assert(entries.size() == (int)Settings::eProjectFileFormatXML);
+        entries.push_back(ChoiceOption("xml",
+                                       tr("XML").toStdString(),
+                                       tr("Human-readable project files, which can be opened by all versions of %1.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ).toStdString()));
+        assert(entries.size() == (int)Settings::eProjectFileFormatBinary);
+        entries.push_back(ChoiceOption("binary",
+                                       tr("Binary").toStdString(),
+                                       tr("Compact project files which are much faster to save and load.").toStdString()));
+        assert(entries.size() == (int)Settings::eProjectFileFormatBinaryCompressed);
+        entries.push_back(ChoiceOption("compressed",
+                                       tr("Compressed Binary").toStdString(),
+                                       tr("Binary project files compressed with zlib, which are the smallest but slightly slower to save than binary files.").toStdString()));
+        _projectFileFormat->populateChoices(entries);
+    }
+    _projectFileFormat->setHintToolTip( tr("The format used to save projects. Auto-saves are always written in the binary format, "
+                                           "so that only the nodes changed since the previous auto-save are appended to them. "
+                                           "Projects in any format can be opened: "
+                                           "the format of a project file is detected when loading it. "
+                                           "Binary projects can only be opened on a computer with the same architecture and by "
+                                           "a version of %1 built with a compatible version of boost.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ) );
+    _generalTab->addKnob(_projectFileFormat);
+
 
     _hostName = AppManager::createKnob<KnobChoice>( this, tr("Appear to plug-ins as") );
     _hostName->setName("pluginHostName");
@@ -1436,6 +1462,7 @@ Settings::setDefaultValues()
 #endif
     _autoSaveUnSavedProjects->setDefaultValue(true);
     _autoSaveDelay->setDefaultValue(5, 0);
+    _projectFileFormat->setDefaultValue( (int)eProjectFileFormatXML );
     _hostName->setDefaultValue(0);
     _customHostName->setDefaultValue(NATRON_ORGANIZATION_DOMAIN_TOPLEVEL "." NATRON_ORGANIZATION_DOMAIN_SUB "." NATRON_APPLICATION_NAME);
 
@@ -2482,18 +2509,42 @@ Settings::getRamMaximumPercent() const
     return (double)_maxRAMPercent->getValue() / 100.;
 }
 
+void
+Settings::setRamMaximumPercent(int percent)
+{
+    _maxRAMPercent->setValue(percent);
+}
+
 U64
 Settings::getMaximumViewerDiskCacheSize() const
 {
     return (U64)( _maxViewerDiskCacheGB->getValue() ) * std::pow(1024., 3.);
 }
 
+void
+Settings::setMaximumViewerDiskCacheSizeGiB(int size)
+{
+    _maxViewerDiskCacheGB->setValue(size);
+}
+
 U64
 Settings::getMaximumDiskCacheNodeSize() const
 {
     return (U64)( _maxDiskCacheNodeGB->getValue() ) * std::pow(1024., 3.);
 }
 
+void
+Settings::setMaximumDiskCacheNodeSizeGiB(int size)
+{
+    _maxDiskCacheNodeGB->setValue(size);
+}
+
+void
+Settings::setDiskCachePath(const std::string& path)
+{
+    _diskCachePath->setValue(path);
+}
+
 ///////////////////////////////////////////////////
 
 double
@@ -2761,6 +2812,12 @@ Settings::isAutoSaveEnabledForUnsavedProjects() const
     return _autoSaveUnSavedProjects->getValue();
 }
 
+Settings::ProjectFileFormatEnum
+Settings::getProjectFileFormat() const
+{
+    return (ProjectFileFormatEnum)_projectFileFormat->getValue();
+}
+
 bool
 Settings::isSnapToNodeEnabled() const
 {
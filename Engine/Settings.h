@@ -87,6 +87,13 @@ public:
         eEnableOpenGLDisabledIfBackground,
     };
 
+    enum ProjectFileFormatEnum
+    {
+        eProjectFileFormatXML = 0,
+        eProjectFileFormatBinary,
+        eProjectFileFormatBinaryCompressed,
+    };
+
     Settings();
 
     virtual ~Settings()
@@ -106,10 +113,18 @@ public:
 
     double getRamMaximumPercent() const;
 
+    void setRamMaximumPercent(int percent);
+
     U64 getMaximumViewerDiskCacheSize() const;
 
+    void setMaximumViewerDiskCacheSizeGiB(int size);
+
     U64 getMaximumDiskCacheNodeSize() const;
 
+    void setMaximumDiskCacheNodeSizeGiB(int size);
+
+    void setDiskCachePath(const std::string& path);
+
     double getUnreachableRamPercent() const;
 
     bool getColorPickerLinear() const;
@@ -178,6 +193,8 @@ public:
 
     bool isAutoSaveEnabledForUnsavedProjects() const;
 
+    ProjectFileFormatEnum getProjectFileFormat() const;
+
     bool isSnapToNodeEnabled() const;
 
     bool isCheckForUpdatesEnabled() const;
@@ -426,6 +443,7 @@ private:
 #endif
     KnobBoolPtr _autoSaveUnSavedProjects;
     KnobIntPtr _autoSaveDelay;
+    KnobChoicePtr _projectFileFormat;
     KnobChoicePtr _hostName;
     KnobStringPtr _customHostName;
 
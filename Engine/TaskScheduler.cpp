@@ -0,0 +1,450 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <sstream> // stringstream
+#include <stdexcept>
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/exception_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/ThreadPool.h"
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The tasks of one run() call
+struct TaskSet
+{
+    ParallelTasks* tasks;
+    int nTasks;
+    std::vector<TaskTiming>* timings;
+    TimeLapse timer; // started by run()
+    QMutex mutex; // protects all fields below
+    QWaitCondition allTasksDone;
+    int nextTask;
+    int nTasksDone;
+    boost::exception_ptr error; // the exception thrown by the first failed task
+
+    TaskSet(ParallelTasks* tasks,
+            int nTasks,
+            std::vector<TaskTiming>* timings)
+        : tasks(tasks)
+        , nTasks(nTasks)
+        , timings(timings)
+        , timer()
+        , mutex()
+        , allTasksDone()
+        , nextTask(0)
+        , nTasksDone(0)
+        , error()
+    {
+    }
+
+    // Returns false if all tasks were already claimed
+    bool claimTask(int* taskIndex)
+    {
+        QMutexLocker k(&mutex);
+
+        if (nextTask >= nTasks) {
+            return false;
+        }
+        *taskIndex = nextTask++;
+
+        return true;
+    }
+
+    void executeTask(int taskIndex,
+                     bool runBySpawner,
+                     bool stolen)
+    {
+        double waitTime = timer.getTimeSinceCreation();
+        TimeLapse taskTimer;
+        boost::exception_ptr taskError;
+
+        // a task must be counted as done in any case, otherwise run() would never return.
+        // The exception is kept as is, so that run() rethrows it with its type (e.g. std::bad_alloc)
+        try {
+            tasks->runTask(taskIndex);
+        } catch (...) {
+            taskError = boost::current_exception();
+        }
+        if (timings) {
+            // each task has its own element, no need to lock
+            TaskTiming& timing = (*timings)[taskIndex];
+            timing.waitTime = waitTime;
+            timing.runTime = taskTimer.getTimeSinceCreation();
+            timing.runBySpawner = runBySpawner;
+            timing.stolen = stolen;
+        }
+
+        QMutexLocker k(&mutex);
+        if (taskError && !error) {
+            error = taskError;
+        }
+        ++nTasksDone;
+        if (nTasksDone == nTasks) {
+            allTasksDone.wakeAll();
+        }
+    }
+};
+
+typedef boost::shared_ptr<TaskSet> TaskSetPtr;
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+class TaskWorkerThread
+    : public QThread
+      , public AbortableThread
+{
+public:
+
+    TaskWorkerThread(TaskSchedulerPrivate* scheduler,
+                     int index)
+        : QThread()
+        , AbortableThread(this)
+        , _scheduler(scheduler)
+        , _index(index)
+    {
+        std::stringstream ss;
+        ss << "Task Scheduler Worker " << index;
+        setThreadName( ss.str() );
+    }
+
+    virtual ~TaskWorkerThread() {}
+
+    TaskSchedulerPrivate* getScheduler() const
+    {
+        return _scheduler;
+    }
+
+    int getIndex() const
+    {
+        return _index;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    TaskSchedulerPrivate* _scheduler;
+    int _index;
+};
+
+struct TaskWorker
+{
+    TaskWorkerThread* thread;
+    QMutex dequeMutex; // protects deque
+    // Task sets that still have tasks to claim. Several workers may hold the same set.
+    std::deque<TaskSetPtr> deque;
+
+    TaskWorker()
+        : thread(0)
+        , dequeMutex()
+        , deque()
+    {
+    }
+};
+
+struct TaskSchedulerPrivate
+{
+    // protects the growth of workers. Workers are never removed until the scheduler is destroyed.
+    mutable QReadWriteLock workersLock;
+    std::vector<TaskWorker*> workers;
+
+    // protects nEnabledWorkers, nQueuedSets, nextWorker and mustQuit
+    mutable QMutex sleepMutex;
+    QWaitCondition workAvailable;
+    int nEnabledWorkers; // workers with an index >= nEnabledWorkers stay idle
+    int nQueuedSets; // number of entries in all the deques
+    int nextWorker; // next worker receiving tasks from a thread that is not a worker
+    bool mustQuit;
+    QAtomicInt nActiveWorkers;
+
+    TaskSchedulerPrivate()
+        : workersLock()
+        , workers()
+        , sleepMutex()
+        , workAvailable()
+        , nEnabledWorkers(0)
+        , nQueuedSets(0)
+        , nextWorker(0)
+        , mustQuit(false)
+        , nActiveWorkers()
+    {
+    }
+
+    // Returns the index of the current thread if it is an enabled worker of this scheduler, -1 otherwise
+    int getCurrentWorkerIndex()
+    {
+        TaskWorkerThread* worker = dynamic_cast<TaskWorkerThread*>( QThread::currentThread() );
+
+        if ( !worker || (worker->getScheduler() != this) ) {
+            return -1;
+        }
+        QMutexLocker k(&sleepMutex);
+
+        return worker->getIndex() < nEnabledWorkers ? worker->getIndex() : -1;
+    }
+
+    TaskWorker* getWorker(int index) const
+    {
+        QReadLocker k(&workersLock);
+
+        return workers[index];
+    }
+
+    int getWorkersCapacity() const
+    {
+        QReadLocker k(&workersLock);
+
+        return (int)workers.size();
+    }
+
+    void enqueue(const TaskSetPtr& set,
+                 int nEntries);
+
+    TaskSetPtr dequeue(int workerIndex, bool* stolen);
+
+    void workerLoop(int workerIndex);
+};
+
+void
+TaskSchedulerPrivate::enqueue(const TaskSetPtr& set,
+                              int nEntries)
+{
+    int currentWorker = getCurrentWorkerIndex();
+
+    if (currentWorker != -1) {
+        // nested tasks: the current worker will take them first, the others will steal them
+        TaskWorker* worker = getWorker(currentWorker);
+        QMutexLocker k(&worker->dequeMutex);
+        for (int i = 0; i < nEntries; ++i) {
+            worker->deque.push_back(set);
+        }
+    } else {
+        for (int i = 0; i < nEntries; ++i) {
+            int workerIndex;
+            {
+                QMutexLocker k(&sleepMutex);
+                workerIndex = nextWorker;
+                nextWorker = (nextWorker + 1) % std::max(1, nEnabledWorkers);
+            }
+            TaskWorker* worker = getWorker(workerIndex);
+            QMutexLocker k(&worker->dequeMutex);
+            worker->deque.push_back(set);
+        }
+    }
+
+    QMutexLocker k(&sleepMutex);
+    nQueuedSets += nEntries;
+    workAvailable.wakeAll();
+}
+
+TaskSetPtr
+TaskSchedulerPrivate::dequeue(int workerIndex,
+                              bool* stolen)
+{
+    TaskSetPtr ret;
+
+    // the most recent set of our own deque first: it is the most likely to be in the caches
+    {
+        TaskWorker* worker = getWorker(workerIndex);
+        QMutexLocker k(&worker->dequeMutex);
+        if ( !worker->deque.empty() ) {
+            ret = worker->deque.back();
+            worker->deque.pop_back();
+            *stolen = false;
+        }
+    }
+
+    // then the oldest set of the other deques
+    if (!ret) {
+        int nWorkers = getWorkersCapacity();
+        for (int i = 1; i < nWorkers && !ret; ++i) {
+            TaskWorker* worker = getWorker( (workerIndex + i) % nWorkers );
+            QMutexLocker k(&worker->dequeMutex);
+            if ( !worker->deque.empty() ) {
+                ret = worker->deque.front();
+                worker->deque.pop_front();
+                *stolen = true;
+            }
+        }
+    }
+
+    if (ret) {
+        QMutexLocker k(&sleepMutex);
+        --nQueuedSets;
+    }
+
+    return ret;
+}
+
+void
+TaskSchedulerPrivate::workerLoop(int workerIndex)
+{
+    for (;;) {
+        {
+            QMutexLocker k(&sleepMutex);
+            while ( !mustQuit && ( (nQueuedSets <= 0) || (workerIndex >= nEnabledWorkers) ) ) {
+                workAvailable.wait(&sleepMutex);
+            }
+            if (mustQuit) {
+                return;
+            }
+        }
+
+        bool stolen = false;
+        TaskSetPtr set = dequeue(workerIndex, &stolen);
+        if (!set) {
+            // another worker was faster
+            continue;
+        }
+
+        nActiveWorkers.ref();
+        int taskIndex;
+        while ( set->claimTask(&taskIndex) ) {
+            set->executeTask(taskIndex, false, stolen);
+        }
+        nActiveWorkers.deref();
+    }
+}
+
+void
+TaskWorkerThread::run()
+{
+    _scheduler->workerLoop(_index);
+}
+
+TaskScheduler::TaskScheduler(int nWorkers)
+    : _imp( new TaskSchedulerPrivate() )
+{
+    setWorkersCount(nWorkers);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker k(&_imp->sleepMutex);
+        _imp->mustQuit = true;
+        _imp->workAvailable.wakeAll();
+    }
+    for (std::size_t i = 0; i < _imp->workers.size(); ++i) {
+        _imp->workers[i]->thread->wait();
+        delete _imp->workers[i]->thread;
+        delete _imp->workers[i];
+    }
+}
+
+void
+TaskScheduler::setWorkersCount(int nWorkers)
+{
+    nWorkers = std::max(0, nWorkers);
+    {
+        QWriteLocker k(&_imp->workersLock);
+        for (int i = (int)_imp->workers.size(); i < nWorkers; ++i) {
+            TaskWorker* worker = new TaskWorker;
+            worker->thread = new TaskWorkerThread(_imp.get(), i);
+            _imp->workers.push_back(worker);
+            worker->thread->start();
+        }
+    }
+
+    QMutexLocker k(&_imp->sleepMutex);
+    _imp->nEnabledWorkers = nWorkers;
+    _imp->nextWorker = 0;
+    _imp->workAvailable.wakeAll();
+}
+
+int
+TaskScheduler::getWorkersCount() const
+{
+    QMutexLocker k(&_imp->sleepMutex);
+
+    return _imp->nEnabledWorkers;
+}
+
+int
+TaskScheduler::getActiveWorkersCount() const
+{
+    return (int)_imp->nActiveWorkers;
+}
+
+void
+TaskScheduler::run(ParallelTasks* tasks,
+                   int nTasks,
+                   std::vector<TaskTiming>* timings)
+{
+    assert(tasks);
+    if (nTasks <= 0) {
+        return;
+    }
+    if (timings) {
+        timings->clear();
+        timings->resize(nTasks);
+    }
+
+    TaskSetPtr set = boost::make_shared<TaskSet>(tasks, nTasks, timings);
+
+    // the current thread executes tasks too
+    int nEntries = std::min( nTasks - 1, getWorkersCount() );
+    if (nEntries > 0) {
+        _imp->enqueue(set, nEntries);
+    }
+
+    int taskIndex;
+    while ( set->claimTask(&taskIndex) ) {
+        set->executeTask(taskIndex, true, false);
+    }
+
+    // wait for the tasks executed by the workers. The entries of this set left in the deques
+    // are discarded by the workers: they have nothing left to claim.
+    QMutexLocker k(&set->mutex);
+    while (set->nTasksDone < set->nTasks) {
+        set->allTasksDone.wait(&set->mutex);
+    }
+    if (set->error) {
+        boost::exception_ptr error = set->error;
+        k.unlock();
+        boost::rethrow_exception(error);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,130 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Natron_Engine_TaskScheduler_h
+#define Natron_Engine_TaskScheduler_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The tasks executed by TaskScheduler::run(): runTask() is called exactly once for each index,
+ * possibly concurrently from different threads.
+ **/
+class ParallelTasks
+{
+public:
+
+    ParallelTasks() {}
+
+    virtual ~ParallelTasks() {}
+
+    virtual void runTask(int taskIndex) = 0;
+};
+
+/**
+ * @brief Timing of a task executed by TaskScheduler::run()
+ **/
+struct TaskTiming
+{
+    double waitTime; // time in seconds between the call to run() and the start of the task
+    double runTime; // time in seconds spent in runTask()
+    bool runBySpawner; // true if the task was executed by the thread that called run() while it was waiting
+    bool stolen; // true if the task was executed by a worker that stole it from the deque of another worker
+
+    TaskTiming()
+        : waitTime(0.)
+        , runTime(0.)
+        , runBySpawner(false)
+        , stolen(false)
+    {
+    }
+};
+
+/**
+ * @brief A work-stealing scheduler with a fixed set of worker threads, shared by the tiled renders
+ * and the multi-thread suite.
+ *
+ * Each worker has its own deque of task sets: a run() called from a worker pushes its tasks at the back of the
+ * worker deque, so that nested tasks are executed first by the worker that created them, and idle workers steal
+ * task sets from the front of the other deques. run() called from any other thread distributes its tasks
+ * among the workers.
+ * The thread calling run() does not block while there are tasks of this run() left: it executes them itself.
+ * It only executes tasks of its own run() call, so that it never executes a task needing a different thread-local
+ * storage, and a run() called from a task can always complete, even if all workers are busy.
+ **/
+struct TaskSchedulerPrivate;
+class TaskScheduler
+{
+public:
+
+    /**
+     * @brief Starts nWorkers worker threads.
+     **/
+    explicit TaskScheduler(int nWorkers);
+
+    /**
+     * @brief Stops and waits for the worker threads. No run() call may be in progress.
+     **/
+    ~TaskScheduler();
+
+    /**
+     * @brief Sets the number of workers that may execute tasks, e.g. when the number of render threads changes
+     * in the preferences. Additional threads are started if needed; if there are less workers than before,
+     * the others stay idle. With 0 workers, run() executes all the tasks in the calling thread.
+     **/
+    void setWorkersCount(int nWorkers);
+
+    int getWorkersCount() const;
+
+    /**
+     * @brief Returns the number of workers currently executing a task.
+     **/
+    int getActiveWorkersCount() const;
+
+    /**
+     * @brief Executes tasks->runTask(i) for each i in [0, nTasks) and returns when all of them are done.
+     * It may be called from a task.
+     * If timings is not NULL, it is resized to nTasks and receives the timing of each task.
+     * If tasks throw, the exception of the first one is rethrown, with its type, once all the tasks are done.
+     **/
+    void run(ParallelTasks* tasks, int nTasks, std::vector<TaskTiming>* timings = 0);
+
+private:
+
+    boost::scoped_ptr<TaskSchedulerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Natron_Engine_TaskScheduler_h
@@ -0,0 +1,161 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TileBitmap.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+// Index of the lowest bit set in a non-zero word
+static inline int
+lowestBitIndex(U64 word)
+{
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+
+    return __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+
+    return (int)index;
+#else
+    int index = 0;
+    while ( !(word & 1) ) {
+        word >>= 1;
+        ++index;
+    }
+
+    return index;
+#endif
+}
+
+TileBitmap::TileBitmap()
+    : _levels()
+    , _nTiles(0)
+    , _nFreeTiles(0)
+{
+}
+
+TileBitmap::~TileBitmap()
+{
+}
+
+void
+TileBitmap::resize(std::size_t nTiles)
+{
+    _levels.clear();
+    _nTiles = nTiles;
+    _nFreeTiles = nTiles;
+
+    // Build each level from the number of bits it must hold, until a level fits in a single word
+    std::size_t nBits = nTiles;
+    do {
+        std::size_t nWords = (nBits + 63) / 64;
+        std::vector<U64> level(nWords, ~(U64)0);
+        // Bits past the end do not map to anything, they must never be seen as free
+        std::size_t remainder = nBits % 64;
+        if ( (nWords > 0) && (remainder != 0) ) {
+            level[nWords - 1] = ( (U64)1 << remainder ) - 1;
+        }
+        _levels.push_back(level);
+        nBits = nWords;
+    } while (nBits > 1);
+} // resize
+
+bool
+TileBitmap::isUsed(std::size_t index) const
+{
+    assert(index < _nTiles);
+
+    return !( _levels[0][index / 64] & ( (U64)1 << (index % 64) ) );
+}
+
+int
+TileBitmap::allocate()
+{
+    if ( (_nFreeTiles == 0) || _levels.empty() ) {
+        return -1;
+    }
+
+    // Walk down from the top level following the first non-empty word
+    std::size_t index = 0;
+    for (int l = (int)_levels.size() - 1; l >= 0; --l) {
+        U64 word = _levels[l][index];
+        assert(word != 0);
+        index = index * 64 + lowestBitIndex(word);
+    }
+    setUsed(index);
+
+    return (int)index;
+}
+
+void
+TileBitmap::setUsed(std::size_t index)
+{
+    assert( index < _nTiles && !isUsed(index) );
+    if (index >= _nTiles) {
+        throw std::out_of_range("TileBitmap::setUsed(): index out of range");
+    }
+    --_nFreeTiles;
+
+    // Clear the bit and propagate to the upper levels as long as words become empty
+    for (std::size_t l = 0; l < _levels.size(); ++l) {
+        U64& word = _levels[l][index / 64];
+        word &= ~( (U64)1 << (index % 64) );
+        if (word != 0) {
+            break;
+        }
+        index /= 64;
+    }
+}
+
+void
+TileBitmap::setFree(std::size_t index)
+{
+    assert( index < _nTiles && isUsed(index) );
+    if (index >= _nTiles) {
+        throw std::out_of_range("TileBitmap::setFree(): index out of range");
+    }
+    ++_nFreeTiles;
+
+    // Set the bit and propagate to the upper levels as long as words were empty
+    for (std::size_t l = 0; l < _levels.size(); ++l) {
+        U64& word = _levels[l][index / 64];
+        bool wasEmpty = (word == 0);
+        word |= ( (U64)1 << (index % 64) );
+        if (!wasEmpty) {
+            break;
+        }
+        index /= 64;
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,107 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_TILEBITMAP_H
+#define NATRON_ENGINE_TILEBITMAP_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Keeps track of the free tiles of a tile cache file.
+ * This is a hierarchical bitmap: each bit of the first level is a tile (set if the tile is free)
+ * and each bit of the upper levels is set if the corresponding 64-bit word of the level below has
+ * at least one bit set. Finding a free tile, allocating or freeing a given tile is then
+ * proportional to the number of levels (log64 of the number of tiles) instead of the number of tiles.
+ * Not MT-safe: the cache protects it with its tile mutex.
+ **/
+class TileBitmap
+{
+public:
+
+    TileBitmap();
+
+    ~TileBitmap();
+
+    /**
+     * @brief Set the number of tiles and mark all tiles free.
+     **/
+    void resize(std::size_t nTiles);
+
+    std::size_t size() const
+    {
+        return _nTiles;
+    }
+
+    std::size_t getNumFreeTiles() const
+    {
+        return _nFreeTiles;
+    }
+
+    bool isFull() const
+    {
+        return _nFreeTiles == 0;
+    }
+
+    bool isEmpty() const
+    {
+        return _nFreeTiles == _nTiles;
+    }
+
+    bool isUsed(std::size_t index) const;
+
+    /**
+     * @brief Finds a free tile, marks it used and returns its index, or -1 if all tiles are used.
+     **/
+    int allocate();
+
+    /**
+     * @brief Mark the given tile used. It must be free.
+     **/
+    void setUsed(std::size_t index);
+
+    /**
+     * @brief Mark the given tile free. It must be used.
+     **/
+    void setFree(std::size_t index);
+
+private:
+
+    // _levels[0] holds one bit per tile, the last level has a single word
+    std::vector<std::vector<U64> > _levels;
+    std::size_t _nTiles;
+    std::size_t _nFreeTiles;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_TILEBITMAP_H
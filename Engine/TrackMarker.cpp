@@ -305,6 +305,18 @@ TrackMarker::initializeKnobs()
     QObject::connect( handler.get(), SIGNAL(valueChanged(ViewSpec,int,int)), this, SLOT(onEnabledValueChanged(ViewSpec,int,int)) );
 } // TrackMarker::initializeKnobs
 
+void
+TrackMarker::evaluate(bool /*isSignificant*/,
+                      bool /*refreshMetadata*/)
+{
+    // Track results and edits of the marker are set on its knobs
+    TrackerContextPtr context = getContext();
+
+    if (context) {
+        context->markSerializationDirty();
+    }
+}
+
 void
 TrackMarker::clone(const TrackMarker& other)
 {
@@ -327,6 +339,7 @@ TrackMarker::clone(const TrackMarker& other)
         }
     }
 
+    context->markSerializationDirty();
     context->s_trackCloned(thisShared);
 }
 
@@ -417,6 +430,7 @@ TrackMarker::setScriptName(const std::string& name)
     }
 
     getContext()->declareItemAsPythonField(thisShared);
+    getContext()->markSerializationDirty();
 
     return true;
 }
@@ -432,9 +446,14 @@ TrackMarker::getScriptName_mt_safe() const
 void
 TrackMarker::setLabel(const std::string& label)
 {
-    QMutexLocker l(&_imp->trackMutex);
-
-    _imp->trackLabel = label;
+    {
+        QMutexLocker l(&_imp->trackMutex);
+        _imp->trackLabel = label;
+    }
+    TrackerContextPtr context = getContext();
+    if (context) {
+        context->markSerializationDirty();
+    }
 }
 
 std::string
@@ -883,6 +902,7 @@ TrackMarker::removeAllUserKeyframes()
         QMutexLocker k(&_imp->trackMutex);
         _imp->userKeyframes.clear();
     }
+    getContext()->markSerializationDirty();
     getContext()->s_allKeyframesRemovedOnTrack( shared_from_this() );
 }
 
@@ -913,6 +933,7 @@ TrackMarker::setUserKeyframe(int time)
         QMutexLocker k(&_imp->trackMutex);
         _imp->userKeyframes.insert(time);
     }
+    getContext()->markSerializationDirty();
     getContext()->s_keyframeSetOnTrack(shared_from_this(), time);
 }
 
@@ -930,6 +951,7 @@ TrackMarker::removeUserKeyframe(int time)
     }
 
     if (emitSignal) {
+        getContext()->markSerializationDirty();
         getContext()->s_keyframeRemovedOnTrack(shared_from_this(), time);
     }
 }
@@ -206,6 +206,11 @@ protected:
 
     virtual void initializeKnobs() OVERRIDE;
 
+    /**
+     * @brief Called after the knobs of the marker changed: the tracker node serializes them.
+     **/
+    virtual void evaluate(bool isSignificant, bool refreshMetadata) OVERRIDE;
+
 public Q_SLOTS:
 
     void onCenterKeyframeSet(double time, ViewSpec view, int dimension, int reason, bool added);
@@ -24,8 +24,11 @@
 
 #include "TrackerContext.h"
 
+#include <algorithm> // max
+#include <cmath> // abs
 #include <set>
 #include <sstream> // stringstream
+#include <vector>
 
 CLANG_DIAG_OFF(deprecated)
 CLANG_DIAG_OFF(uninitialized)
@@ -53,6 +56,9 @@ CLANG_DIAG_ON(uninitialized)
 
 #define NATRON_TRACKER_REPORT_PROGRESS_DELTA_MS 200
 
+// The number of frames ahead of the tracked frame rendered in the background for libmv
+#define NATRON_TRACKER_PREFETCH_FRAMES 3
+
 NATRON_NAMESPACE_ENTER
 
 
@@ -269,6 +275,7 @@ TrackerContext::createMarker()
     track->setLabel(name);
     track->resetCenter();
 
+    markSerializationDirty();
     Q_EMIT trackInserted(track, index);
 
     return track;
@@ -334,6 +341,7 @@ TrackerContext::appendMarker(const TrackMarkerPtr& marker)
         _imp->markers.push_back(marker);
     }
 
+    markSerializationDirty();
     declareItemAsPythonField(marker);
     Q_EMIT trackInserted(marker, index);
 }
@@ -353,6 +361,7 @@ TrackerContext::insertMarker(const TrackMarkerPtr& marker,
             _imp->markers.insert(it, marker);
         }
     }
+    markSerializationDirty();
     declareItemAsPythonField(marker);
     Q_EMIT trackInserted(marker, index);
 }
@@ -369,6 +378,7 @@ TrackerContext::removeMarker(const TrackMarkerPtr& marker)
             }
         }
     }
+    markSerializationDirty();
     Q_EMIT trackRemoved(marker);
 
     removeItemAsPythonField(marker);
@@ -383,6 +393,16 @@ TrackerContext::getNode() const
     return _imp->node.lock();
 }
 
+void
+TrackerContext::markSerializationDirty() const
+{
+    NodePtr node = getNode();
+
+    if (node) {
+        node->markSerializationDirty();
+    }
+}
+
 KnobChoicePtr
 TrackerContext::getCorrelationScoreTypeKnob() const
 {
@@ -1712,6 +1732,237 @@ TrackArgs::getRedrawAreasNeeded(int time,
     }
 }
 
+void
+TrackArgs::prefetchImages(int trackIndex,
+                          int time,
+                          int framesCount) const
+{
+    assert( trackIndex >= 0 && trackIndex < (int)_imp->tracks.size() );
+    const int step = _imp->step;
+    const TrackMarkerPtr& marker = _imp->tracks[trackIndex]->natronMarker;
+
+    // The positions of the marker are extrapolated from the last tracked frame
+    const int refTime = time == _imp->start ? time : time - step;
+
+    // TrackerPM markers do not use the frame accessor
+    if ( (step == 0) || dynamic_cast<TrackMarkerPM*>( marker.get() ) || !marker->isEnabled(refTime) ) {
+        return;
+    }
+    KnobDoublePtr searchBtmLeft = marker->getSearchWindowBottomLeftKnob();
+    KnobDoublePtr searchTopRight = marker->getSearchWindowTopRightKnob();
+    KnobDoublePtr centerKnob = marker->getCenterKnob();
+    KnobDoublePtr offsetKnob = marker->getOffsetKnob();
+    Point center, velocity, btmLeft, topRight;
+    center.x = centerKnob->getValueAtTime(refTime, 0) + offsetKnob->getValueAtTime(refTime, 0);
+    center.y = centerKnob->getValueAtTime(refTime, 1) + offsetKnob->getValueAtTime(refTime, 1);
+    if (refTime == _imp->start) {
+        velocity.x = velocity.y = 0.;
+    } else {
+        velocity.x = centerKnob->getValueAtTime(refTime, 0) - centerKnob->getValueAtTime(refTime - step, 0);
+        velocity.y = centerKnob->getValueAtTime(refTime, 1) - centerKnob->getValueAtTime(refTime - step, 1);
+    }
+    btmLeft.x = searchBtmLeft->getValueAtTime(refTime, 0);
+    btmLeft.y = searchBtmLeft->getValueAtTime(refTime, 1);
+    topRight.x = searchTopRight->getValueAtTime(refTime, 0);
+    topRight.y = searchTopRight->getValueAtTime(refTime, 1);
+
+    // The uncertainty on the predicted position grows with the distance to the last tracked frame
+    const double searchMargin = std::max(topRight.x - btmLeft.x, topRight.y - btmLeft.y) / 2.;
+    const double speed = std::max( std::abs(velocity.x), std::abs(velocity.y) );
+    for (int i = 1; i <= framesCount; ++i) {
+        int frame = time + i * step;
+        if ( (step > 0) ? (frame >= _imp->end) : (frame <= _imp->end) ) {
+            break;
+        }
+        int n = (frame - refTime) / step;
+        double margin = searchMargin + speed * n;
+        RectD rect;
+        rect.x1 = center.x + velocity.x * n + btmLeft.x - margin;
+        rect.y1 = center.y + velocity.y * n + btmLeft.y - margin;
+        rect.x2 = center.x + velocity.x * n + topRight.x + margin;
+        rect.y2 = center.y + velocity.y * n + topRight.y + margin;
+
+        // libmv requests the search windows in pixel coordinates at full scale
+        RectI roi;
+        rect.toPixelEnclosing(0, 1., &roi);
+        _imp->fa->prefetchImage(frame, 0, roi);
+    }
+} // TrackArgs::prefetchImages
+
+void
+TrackArgs::discardPrefetchedImages(int time) const
+{
+    if (_imp->step != 0) {
+        _imp->fa->discardPrefetchedImages(time, _imp->step);
+    }
+}
+
+void
+TrackArgs::getPrefetchStats(int* hits,
+                            int* misses) const
+{
+    _imp->fa->getPrefetchStats(hits, misses);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief The progress of the tracks of a track operation. Each track is tracked by its own task, which advances
+ * its own frame cursor without waiting for the other tracks. The scheduler thread aggregates their progress.
+ **/
+class TrackingProgress
+{
+public:
+
+    TrackingProgress(int nTracks,
+                     int start,
+                     int step,
+                     int framesCount)
+        : _lock()
+        , _tracksFinishedCond()
+        , _lastFrames(nTracks, start - step)
+        , _framesDone(nTracks, 0)
+        , _started(nTracks, false)
+        , _finished(nTracks, false)
+        , _nFinished(0)
+        , _step(step)
+        , _framesCount(framesCount)
+        , _aborted(false)
+    {
+    }
+
+    void onTrackStarted(int trackIndex)
+    {
+        QMutexLocker k(&_lock);
+
+        _started[trackIndex] = true;
+    }
+
+    void onFrameTracked(int trackIndex,
+                        int frame)
+    {
+        QMutexLocker k(&_lock);
+
+        _lastFrames[trackIndex] = frame;
+        ++_framesDone[trackIndex];
+    }
+
+    void onTrackFinished(int trackIndex)
+    {
+        QMutexLocker k(&_lock);
+
+        // The frames the track will not track count as done
+        _framesDone[trackIndex] = _framesCount;
+        _finished[trackIndex] = true;
+        ++_nFinished;
+        if ( _nFinished == (int)_finished.size() ) {
+            _tracksFinishedCond.wakeAll();
+        }
+    }
+
+    void abort()
+    {
+        QMutexLocker k(&_lock);
+
+        _aborted = true;
+    }
+
+    bool isAborted() const
+    {
+        QMutexLocker k(&_lock);
+
+        return _aborted;
+    }
+
+    /**
+     * @brief Waits until all the tracks are finished, or at most timeoutMS milliseconds.
+     * Returns true if all the tracks are finished.
+     **/
+    bool waitForTracks(unsigned long timeoutMS)
+    {
+        QMutexLocker k(&_lock);
+
+        if ( _nFinished < (int)_finished.size() ) {
+            _tracksFinishedCond.wait(&_lock, timeoutMS);
+        }
+
+        return _nFinished == (int)_finished.size();
+    }
+
+    double getProgress() const
+    {
+        QMutexLocker k(&_lock);
+
+        if ( (_framesCount == 0) || _framesDone.empty() ) {
+            return 1.;
+        }
+        double done = 0.;
+        for (std::size_t i = 0; i < _framesDone.size(); ++i) {
+            done += _framesDone[i];
+        }
+
+        return done / ( (double)_framesCount * _framesDone.size() );
+    }
+
+    /**
+     * @brief Returns in frame the frame that the slowest track which is not finished is tracking.
+     * If startedOnly is true, the tracks that did not start yet are ignored.
+     * Returns false if there is no such track.
+     **/
+    bool getSlowestFrame(bool startedOnly,
+                         int* frame) const
+    {
+        QMutexLocker k(&_lock);
+        bool found = false;
+
+        for (std::size_t i = 0; i < _lastFrames.size(); ++i) {
+            if ( _finished[i] || (startedOnly && !_started[i]) ) {
+                continue;
+            }
+            int trackFrame = _lastFrames[i] + _step;
+            if ( !found || ( (_step > 0) ? (trackFrame < *frame) : (trackFrame > *frame) ) ) {
+                *frame = trackFrame;
+                found = true;
+            }
+        }
+
+        return found;
+    }
+
+    /**
+     * @brief Returns the furthest frame tracked by the tracks.
+     **/
+    int getLastTrackedFrame() const
+    {
+        QMutexLocker k(&_lock);
+        int frame = _lastFrames.empty() ? 0 : _lastFrames[0];
+
+        for (std::size_t i = 1; i < _lastFrames.size(); ++i) {
+            if ( (_step > 0) ? (_lastFrames[i] > frame) : (_lastFrames[i] < frame) ) {
+                frame = _lastFrames[i];
+            }
+        }
+
+        return frame;
+    }
+
+private:
+
+    mutable QMutex _lock;
+    QWaitCondition _tracksFinishedCond;
+
+    // For each track, the last frame it tracked, successfully or not
+    std::vector<int> _lastFrames;
+    std::vector<int> _framesDone;
+    std::vector<bool> _started, _finished;
+    int _nFinished;
+    int _step;
+    int _framesCount;
+    bool _aborted;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 struct TrackSchedulerPrivate
 {
     TrackerParamsProvider* paramsProvider;
@@ -1735,6 +1986,13 @@ struct TrackSchedulerPrivate
      * @param time The time at which to track. The reference frame is held in the args and can be different for each track
      */
     static bool trackStepFunctor(int trackIndex, const TrackArgs& args, int time);
+
+    /*
+     * @brief The task tracking a track over the whole frame range, called concurrently for each track.
+     * It tracks the frames one after the other with trackStepFunctor until the end of the range, a frame fails or
+     * the tracking is aborted. Returns whether the last tracked frame succeeded.
+     */
+    static bool trackFunctor(int trackIndex, const TrackArgs& args, TrackingProgress* progress);
 };
 
 TrackScheduler::TrackScheduler(TrackerParamsProvider* paramsProvider,
@@ -1782,6 +2040,37 @@ TrackSchedulerPrivate::trackStepFunctor(int trackIndex,
     return ret;
 }
 
+bool
+TrackSchedulerPrivate::trackFunctor(int trackIndex,
+                                    const TrackArgs& args,
+                                    TrackingProgress* progress)
+{
+    const int end = args.getEnd();
+    const int step = args.getStep();
+    bool ret = false;
+
+    progress->onTrackStarted(trackIndex);
+    for (int time = args.getStart(); (step > 0) ? (time < end) : (time > end); time += step) {
+        if ( progress->isAborted() ) {
+            break;
+        }
+
+        // Render the next frames of the track while this one is tracked
+        args.prefetchImages(trackIndex, time, NATRON_TRACKER_PREFETCH_FRAMES);
+
+        ret = trackStepFunctor(trackIndex, args, time);
+        progress->onFrameTracked(trackIndex, time);
+
+        // This track is lost, stop it: the other tracks go on
+        if (!ret) {
+            break;
+        }
+    }
+    progress->onTrackFinished(trackIndex);
+
+    return ret;
+}
+
 NATRON_NAMESPACE_ANONYMOUS_ENTER
 
 class IsTrackingFlagSetter_RAII
@@ -1843,7 +2132,6 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
     ViewerInstance* viewer =  args->getViewer();
     int end = args->getEnd();
     int start = args->getStart();
-    int cur = start;
     int frameStep = args->getStep();
     int framesCount = 0;
     if (frameStep != 0) {
@@ -1868,105 +2156,75 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
     int lastValidFrame = frameStep > 0 ? start - 1 : start + 1;
     bool reportProgress = numTracks > 1 || framesCount > 1;
     EffectInstancePtr effect = _imp->getNode()->getEffectInstance();
-    timeval lastProgressUpdateTime;
-    gettimeofday(&lastProgressUpdateTime, 0);
 
-    bool allTrackFailed = false;
     {
         ///Use RAII style for setting the isDoingPartialUpdates flag so we're sure it gets removed
         IsTrackingFlagSetter_RAII __istrackingflag__(effect, this, frameStep, reportProgress, viewer, doPartialUpdates);
 
-        if ( (frameStep == 0) || ( (frameStep > 0) && (start >= end) ) || ( (frameStep < 0) && (start <= end) ) ) {
-            // Invalid range
-            cur = end;
-        }
-
+        const bool isValidRange = (frameStep != 0) && ( ( (frameStep > 0) && (start < end) ) || ( (frameStep < 0) && (start > end) ) );
+        if (isValidRange) {
+            TrackingProgress progress(numTracks, start, frameStep, framesCount);
 
-        while (cur != end) {
-            ///Launch parallel thread for each track using the global thread pool
+            ///Launch a task for each track using the global thread pool: each track advances on its own
             QFuture<bool> future = QtConcurrent::mapped( trackIndexes,
-                                                         boost::bind(&TrackSchedulerPrivate::trackStepFunctor,
+                                                         boost::bind(&TrackSchedulerPrivate::trackFunctor,
                                                                      _1,
                                                                      *args,
-                                                                     cur) );
-            future.waitForFinished();
-
-            allTrackFailed = true;
-            for (QFuture<bool>::const_iterator it = future.begin(); it != future.end(); ++it) {
-                if ( (*it) ) {
-                    allTrackFailed = false;
-                    break;
-                }
-            }
-
-
-
-            lastValidFrame = cur;
-
-
-
-            // We don't have any successful track, stop
-            if (allTrackFailed) {
-                break;
-            }
-
-
+                                                                     &progress) );
 
-            cur += frameStep;
+            bool allTracksFinished = false;
+            while (!allTracksFinished) {
+                allTracksFinished = progress.waitForTracks(NATRON_TRACKER_REPORT_PROGRESS_DELTA_MS);
 
-            double progress;
-            if (frameStep > 0) {
-                progress = (double)(cur - start) / framesCount;
-            } else {
-                progress = (double)(start - cur) / framesCount;
-            }
-
-            bool isUpdateViewerOnTrackingEnabled = _imp->paramsProvider->getUpdateViewer();
-            bool isCenterViewerEnabled = _imp->paramsProvider->getCenterOnTrack();
-            bool enoughTimePassedToReportProgress;
-            {
-                timeval now;
-                gettimeofday(&now, 0);
-                double dt =  now.tv_sec  - lastProgressUpdateTime.tv_sec +
-                            (now.tv_usec - lastProgressUpdateTime.tv_usec) * 1e-6f;
-                dt *= 1000; // switch to MS
-                enoughTimePassedToReportProgress = dt > NATRON_TRACKER_REPORT_PROGRESS_DELTA_MS;
-                if (enoughTimePassedToReportProgress) {
-                    lastProgressUpdateTime = now;
+                // The frames before the slowest track will not be tracked anymore
+                int slowestFrame;
+                if ( progress.getSlowestFrame(false, &slowestFrame) ) {
+                    args->discardPrefetchedImages(slowestFrame);
                 }
-            }
-
 
-            ///Ok all tracks are finished now for this frame, refresh viewer if needed
-            if (isUpdateViewerOnTrackingEnabled && viewer) {
-                //This will not refresh the viewer since when tracking, renderCurrentFrame()
-                //is not called on viewers, see Gui::onTimeChanged
-                timeline->seekFrame(cur, true, 0, eTimelineChangeReasonOtherSeek);
+                ///Refresh the viewer at the frame of the slowest running track if needed
+                bool isUpdateViewerOnTrackingEnabled = _imp->paramsProvider->getUpdateViewer();
+                bool isCenterViewerEnabled = _imp->paramsProvider->getCenterOnTrack();
+                int viewerFrame;
+                if ( !allTracksFinished && isUpdateViewerOnTrackingEnabled && viewer && progress.getSlowestFrame(true, &viewerFrame) ) {
+                    //This will not refresh the viewer since when tracking, renderCurrentFrame()
+                    //is not called on viewers, see Gui::onTimeChanged
+                    timeline->seekFrame(viewerFrame, true, 0, eTimelineChangeReasonOtherSeek);
 
-                if (enoughTimePassedToReportProgress) {
                     if (doPartialUpdates) {
                         std::list<RectD> updateRects;
-                        args->getRedrawAreasNeeded(cur, &updateRects);
+                        args->getRedrawAreasNeeded(viewerFrame, &updateRects);
                         viewer->setPartialUpdateParams(updateRects, isCenterViewerEnabled);
                     } else {
                         viewer->clearPartialUpdateParams();
                     }
                     Q_EMIT renderCurrentFrameForViewer(viewer);
                 }
-            }
 
-            if (enoughTimePassedToReportProgress && reportProgress && effect) {
-                ///Notify we progressed of 1 frame
-                Q_EMIT trackingProgress(progress);
-            }
+                if (reportProgress && effect) {
+                    Q_EMIT trackingProgress( progress.getProgress() );
+                }
 
-            // Check for abortion
-            state = resolveState();
-            if ( (state == eThreadStateAborted) || (state == eThreadStateStopped) ) {
-                break;
+                // Check for abortion
+                state = resolveState();
+                if ( (state == eThreadStateAborted) || (state == eThreadStateStopped) ) {
+                    progress.abort();
+                    break;
+                }
             }
-        } // while (cur != end) {
+
+            // Wait for the tracks, which stop after their current frame if aborted
+            future.waitForFinished();
+            lastValidFrame = progress.getLastTrackedFrame();
+        }
     } // IsTrackingFlagSetter_RAII
+#ifdef TRACE_LIB_MV
+    {
+        int prefetchHits, prefetchMisses;
+        args->getPrefetchStats(&prefetchHits, &prefetchMisses);
+        qDebug() << "TrackScheduler: frame accessor images prefetched:" << prefetchHits << "rendered on demand:" << prefetchMisses;
+    }
+#endif
     TrackerContext* isContext = dynamic_cast<TrackerContext*>(_imp->paramsProvider);
     if (isContext) {
         isContext->solveTransformParams();
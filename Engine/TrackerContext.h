@@ -144,6 +144,13 @@ public:
 
 
     NodePtr getNode() const;
+
+    /**
+     * @brief Marks the tracker node as changed so that the next incremental auto-save writes the markers,
+     * @see Node::markSerializationDirty()
+     **/
+    void markSerializationDirty() const;
+
     KnobChoicePtr getCorrelationScoreTypeKnob() const;
     KnobBoolPtr getEnabledKnob() const;
     KnobPagePtr getTrackingPageKnob() const;
@@ -480,6 +487,19 @@ public:
 
     void getRedrawAreasNeeded(int time, std::list<RectD>* canonicalRects) const;
 
+    /**
+     * @brief Prefetches the images of the framesCount frames following time that libmv will need to track the given track,
+     * around its positions extrapolated from the last tracked frame. This is called before tracking the frame time.
+     **/
+    void prefetchImages(int trackIndex, int time, int framesCount) const;
+
+    /**
+     * @brief Discards the prefetched images of the frames before time that were not used.
+     **/
+    void discardPrefetchedImages(int time) const;
+
+    void getPrefetchStats(int* hits, int* misses) const;
+
 private:
 
     boost::scoped_ptr<TrackArgsPrivate> _imp;
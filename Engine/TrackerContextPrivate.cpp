@@ -109,6 +109,7 @@ TrackerContextPrivate::TrackerContextPrivate(TrackerContext* publicInterface,
     , beginSelectionCounter(0)
     , selectionRecursion(0)
     , scheduler(_publicInterface, node)
+    , frameCache( new TrackerFrameCache() )
 {
     EffectInstancePtr effect = node->getEffectInstance();
     //needs to be blocking, otherwise the progressUpdate() call could be made before startProgress
@@ -1171,8 +1172,9 @@ TrackerContext::trackMarkers(const std::list<TrackMarkerPtr>& markers,
 
     bool autoKeyingOnEnabledParamEnabled = _imp->autoKeyEnabled.lock()->getValue();
     
-    /// The accessor and its cache is local to a track operation, it is wiped once the whole sequence track is finished.
-    TrackerFrameAccessorPtr accessor( new TrackerFrameAccessor(this, enabledChannels, formatHeight) );
+    /// The accessor is local to a track operation, but the images it converts for libmv are kept in the frame cache
+    /// of the context for the next track operations.
+    TrackerFrameAccessorPtr accessor( new TrackerFrameAccessor(this, _imp->frameCache, enabledChannels, formatHeight) );
     mv::AutoTrackPtr trackContext( new mv::AutoTrack( accessor.get() ) );
     std::vector<TrackMarkerAndOptionsPtr> trackAndOptions;
     mv::TrackRegionOptions mvOptions;
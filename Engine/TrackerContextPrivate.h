@@ -439,6 +439,7 @@ public:
     int beginSelectionCounter;
     int selectionRecursion;
     TrackScheduler scheduler;
+    TrackerFrameCachePtr frameCache;
     struct TransformData
     {
         TransformData()
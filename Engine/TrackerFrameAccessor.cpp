@@ -24,6 +24,9 @@
 
 #include "TrackerFrameAccessor.h"
 
+#include <algorithm> // find
+#include <list>
+
 #include <boost/utility.hpp>
 
 GCC_DIAG_OFF(unused-function)
@@ -35,15 +38,22 @@ GCC_DIAG_ON(unused-function)
 GCC_DIAG_ON(unused-parameter)
 
 #include <QtCore/QDebug>
+#include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
 
 #include "Engine/AbortableRenderInfo.h"
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
 #include "Engine/Project.h"
 #include "Engine/TimeLine.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Image.h"
 #include "Engine/Node.h"
+#include "Engine/TLSHolder.h"
 #include "Engine/TrackerContext.h"
+#include "Engine/TrackerKernels.h"
+
+// The maximum memory held by the images prefetched and not used yet
+#define NATRON_TRACKER_PREFETCH_MAX_MEMORY (256ULL * 1024ULL * 1024ULL)
 
 NATRON_NAMESPACE_ENTER
 
@@ -83,60 +93,86 @@ struct CacheKey_compare_less
 };
 
 
-class MvFloatImage
-    : public libmv::Array3D<float>
+struct FrameAccessorCacheEntry
 {
-public:
+    MvFloatImagePtr image;
 
-    MvFloatImage()
-        : libmv::Array3D<float>()
-    {
-    }
+    // If null, this is the full image
+    RectI bounds;
+    unsigned int referenceCount;
 
-    MvFloatImage(int height,
-                 int width)
-        : libmv::Array3D<float>(height, width)
-    {
-    }
+    // True if the image was prefetched and not returned by GetImage yet
+    bool prefetched;
+};
 
-    MvFloatImage(float* data,
-                 int height,
-                 int width)
-        : libmv::Array3D<float>(data, height, width)
-    {
-    }
+typedef std::multimap<FrameAccessorCacheKey, FrameAccessorCacheEntry, CacheKey_compare_less > FrameAccessorCache;
 
-    virtual ~MvFloatImage()
-    {
-    }
+struct PrefetchRequest
+{
+    FrameAccessorCacheKey key;
+    RectI roi;
+
+    // The memory reserved in the prefetch budget for the request
+    std::size_t bytes;
+    QFuture<void> future;
 };
 
-typedef boost::shared_ptr<MvFloatImage> MvFloatImagePtr;
+typedef boost::shared_ptr<PrefetchRequest> PrefetchRequestPtr;
 
-struct FrameAccessorCacheEntry
+static std::size_t
+getImageBytes(const RectI& bounds)
 {
-    MvFloatImagePtr image;
+    return (std::size_t)bounds.width() * bounds.height() * sizeof(float);
+}
 
-    // If null, this is the full image
+static bool
+boundsContainRoI(const RectI& bounds,
+                 const RectI& roi)
+{
+    return (roi.x1 >= bounds.x1) && (roi.x2 <= bounds.x2) &&
+           (roi.y1 >= bounds.y1) && (roi.y2 <= bounds.y2);
+}
+
+struct TrackerFrameCacheKey_compare_less
+{
+    bool operator() (const TrackerFrameCacheKey & lhs,
+                     const TrackerFrameCacheKey & rhs) const
+    {
+        if (lhs.inputHash != rhs.inputHash) {
+            return lhs.inputHash < rhs.inputHash;
+        } else if (lhs.frame != rhs.frame) {
+            return lhs.frame < rhs.frame;
+        } else if (lhs.mipMapLevel != rhs.mipMapLevel) {
+            return lhs.mipMapLevel < rhs.mipMapLevel;
+        } else {
+            return lhs.channels < rhs.channels;
+        }
+    }
+};
+
+struct TrackerFrameCacheEntry
+{
+    TrackerFrameCacheKey key;
     RectI bounds;
-    unsigned int referenceCount;
+    MvFloatImagePtr image;
 };
 
-typedef std::multimap<FrameAccessorCacheKey, FrameAccessorCacheEntry, CacheKey_compare_less > FrameAccessorCache;
+// The most recently used entries first
+typedef std::list<TrackerFrameCacheEntry> TrackerFrameCacheLRU;
+typedef std::multimap<TrackerFrameCacheKey, TrackerFrameCacheLRU::iterator, TrackerFrameCacheKey_compare_less> TrackerFrameCacheIndex;
 
 
-template <bool doR, bool doG, bool doB>
 void
-natronImageToLibMvFloatImageForChannels(const Image* source,
-                                        const RectI& roi,
-                                        MvFloatImage& mvImg)
+natronImageToLibMvFloatImage(bool enabledChannels[3],
+                             const Image* source,
+                             const RectI& roi,
+                             MvFloatImage& mvImg)
 {
     //mvImg is expected to have its bounds equal to roi
 
     Image::ReadAccess racc(source);
-    unsigned int compsCount = source->getComponentsCount();
 
-    assert(compsCount == 3);
+    assert(source->getComponentsCount() == 3);
     unsigned int srcRowElements = source->getRowElements();
 
     assert( source->getBounds().contains(roi) );
@@ -146,84 +182,237 @@ natronImageToLibMvFloatImageForChannels(const Image* source,
     assert(dst_pixels);
     //LibMV images have their origin in the top left hand corner
 
-    // It's important to rescale the resultappropriately so that e.g. if only
-    // blue is selected, it's not zeroed out.
-    float scale = (doR ? 0.2126f : 0.0f) +
-                  (doG ? 0.7152f : 0.0f) +
-                  (doB ? 0.0722f : 0.0f);
+    /// Apply luminance conversion while we copy the image
     int h = roi.height();
     int w = roi.width();
-    for ( int y = 0; y < h; ++y,
-          src_pixels += (srcRowElements - compsCount * w) ) {
-        for (int x = 0; x < w; ++x,
-             src_pixels += compsCount,
-             ++dst_pixels) {
-            /// Apply luminance conversion while we copy the image
-            /// This code is taken from DisableChannelsTransform::run in libmv/autotrack/autotrack.cc
-            *dst_pixels = ( 0.2126f * (doR ? src_pixels[0] : 0.0f) +
-                            0.7152f * (doG ? src_pixels[1] : 0.0f) +
-                            0.0722f * (doB ? src_pixels[2] : 0.0f) ) / scale;
+    for (int y = 0; y < h; ++y,
+         src_pixels += srcRowElements,
+         dst_pixels += w) {
+        TrackerKernels::rgbToLuminance(src_pixels, w, enabledChannels[0], enabledChannels[1], enabledChannels[2], dst_pixels);
+    }
+}
+} // anon namespace
+
+struct TrackerFrameCachePrivate
+{
+    mutable QMutex lock;
+    TrackerFrameCacheLRU entries;
+    TrackerFrameCacheIndex index;
+    std::size_t memory;
+    std::size_t maxMemory;
+
+    // The hash of the input of the tracker of the images in the cache
+    U64 inputHash;
+
+    TrackerFrameCachePrivate()
+        : lock()
+        , entries()
+        , index()
+        , memory(0)
+        , maxMemory(NATRON_TRACKER_FRAME_CACHE_MAX_MEMORY)
+        , inputHash(0)
+    {
+    }
+
+    /**
+     * @brief Removes the least recently used image. Must be called with lock locked.
+     **/
+    void evictLRUEntryInternal();
+
+    void clearInternal();
+};
+
+void
+TrackerFrameCachePrivate::evictLRUEntryInternal()
+{
+    assert( !entries.empty() );
+    TrackerFrameCacheLRU::iterator lru = entries.end();
+    --lru;
+    std::pair<TrackerFrameCacheIndex::iterator, TrackerFrameCacheIndex::iterator> lruRange = index.equal_range(lru->key);
+    for (TrackerFrameCacheIndex::iterator it = lruRange.first; it != lruRange.second; ++it) {
+        if (it->second == lru) {
+            index.erase(it);
+            break;
         }
     }
+    memory -= getImageBytes(lru->bounds);
+    entries.erase(lru);
 }
 
-static void
-natronImageToLibMvFloatImage(bool enabledChannels[3],
-                             const Image* source,
-                             const RectI& roi,
-                             MvFloatImage& mvImg)
+void
+TrackerFrameCachePrivate::clearInternal()
 {
-    if (enabledChannels[0]) {
-        if (enabledChannels[1]) {
-            if (enabledChannels[2]) {
-                natronImageToLibMvFloatImageForChannels<true, true, true>(source, roi, mvImg);
-            } else {
-                natronImageToLibMvFloatImageForChannels<true, true, false>(source, roi, mvImg);
-            }
-        } else {
-            if (enabledChannels[2]) {
-                natronImageToLibMvFloatImageForChannels<true, false, true>(source, roi, mvImg);
-            } else {
-                natronImageToLibMvFloatImageForChannels<true, false, false>(source, roi, mvImg);
-            }
+    index.clear();
+    entries.clear();
+    memory = 0;
+}
+
+TrackerFrameCache::TrackerFrameCache()
+    : _imp( new TrackerFrameCachePrivate() )
+{
+    if (appPTR) {
+        appPTR->registerTrackerFrameCache(this);
+    }
+}
+
+TrackerFrameCache::~TrackerFrameCache()
+{
+    if (appPTR) {
+        appPTR->unregisterTrackerFrameCache(this);
+    }
+}
+
+MvFloatImagePtr
+TrackerFrameCache::get(const TrackerFrameCacheKey& key,
+                       const RectI& roi,
+                       RectI* bounds)
+{
+    QMutexLocker k(&_imp->lock);
+    std::pair<TrackerFrameCacheIndex::iterator, TrackerFrameCacheIndex::iterator> range = _imp->index.equal_range(key);
+
+    for (TrackerFrameCacheIndex::iterator it = range.first; it != range.second; ++it) {
+        if ( boundsContainRoI(it->second->bounds, roi) ) {
+            _imp->entries.splice( _imp->entries.begin(), _imp->entries, it->second );
+            *bounds = it->second->bounds;
+
+            return it->second->image;
         }
-    } else {
-        if (enabledChannels[1]) {
-            if (enabledChannels[2]) {
-                natronImageToLibMvFloatImageForChannels<false, true, true>(source, roi, mvImg);
-            } else {
-                natronImageToLibMvFloatImageForChannels<false, true, false>(source, roi, mvImg);
-            }
-        } else {
-            if (enabledChannels[2]) {
-                natronImageToLibMvFloatImageForChannels<false, false, true>(source, roi, mvImg);
-            } else {
-                natronImageToLibMvFloatImageForChannels<false, false, false>(source, roi, mvImg);
-            }
+    }
+
+    return MvFloatImagePtr();
+}
+
+void
+TrackerFrameCache::insert(const TrackerFrameCacheKey& key,
+                          const RectI& bounds,
+                          const MvFloatImagePtr& image)
+{
+    std::size_t bytes = getImageBytes(bounds);
+
+    if ( bytes > getMaximumMemory() ) {
+        return;
+    }
+
+    // Like the other caches, make room in memory before inserting. This may evict images of this cache,
+    // so it must be called without the lock of the cache.
+    if (appPTR) {
+        appPTR->checkCacheFreeMemoryIsGoodEnough();
+    }
+
+    QMutexLocker k(&_imp->lock);
+    if (key.inputHash != _imp->inputHash) {
+        _imp->clearInternal();
+        _imp->inputHash = key.inputHash;
+    }
+
+    std::pair<TrackerFrameCacheIndex::iterator, TrackerFrameCacheIndex::iterator> range = _imp->index.equal_range(key);
+    for (TrackerFrameCacheIndex::iterator it = range.first; it != range.second; ++it) {
+        if ( boundsContainRoI(it->second->bounds, bounds) ) {
+            // Already cached (e.g. by another track)
+            return;
         }
     }
+
+    TrackerFrameCacheEntry entry;
+    entry.key = key;
+    entry.bounds = bounds;
+    entry.image = image;
+    _imp->entries.push_front(entry);
+    _imp->index.insert( std::make_pair( key, _imp->entries.begin() ) );
+    _imp->memory += bytes;
+
+    while (_imp->memory > _imp->maxMemory) {
+        _imp->evictLRUEntryInternal();
+    }
+} // TrackerFrameCache::insert
+
+bool
+TrackerFrameCache::evictLRUEntry()
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( _imp->entries.empty() ) {
+        return false;
+    }
+    _imp->evictLRUEntryInternal();
+
+    return true;
+}
+
+void
+TrackerFrameCache::clear()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->clearInternal();
+}
+
+std::size_t
+TrackerFrameCache::getMemoryUsage() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->memory;
+}
+
+void
+TrackerFrameCache::setMaximumMemory(std::size_t maxBytes)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->maxMemory = maxBytes;
+    while (_imp->memory > _imp->maxMemory) {
+        _imp->evictLRUEntryInternal();
+    }
+}
+
+std::size_t
+TrackerFrameCache::getMaximumMemory() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->maxMemory;
 }
-} // anon namespace
 
 
 struct TrackerFrameAccessorPrivate
 {
     const TrackerContext* context;
+    TrackerFrameCachePtr frameCache;
     NodePtr trackerInput;
+
+    // Protects cache and all the prefetch members
     mutable QMutex cacheMutex;
     FrameAccessorCache cache;
     bool enabledChannels[3];
     int formatHeight;
 
+    // The prefetches being rendered
+    std::list<PrefetchRequestPtr> prefetchRequests;
+
+    // The memory of the prefetched images not used yet and of the pending prefetches
+    std::size_t prefetchedBytes;
+
+    // Set when the accessor is destroyed: the pending prefetches do not render anything
+    bool prefetchAborted;
+    int prefetchHits, prefetchMisses;
+
     TrackerFrameAccessorPrivate(const TrackerContext* context,
+                                const TrackerFrameCachePtr& frameCache,
                                 bool enabledChannels[3],
                                 int formatHeight)
         : context(context)
+        , frameCache(frameCache)
         , trackerInput()
         , cacheMutex()
         , cache()
         , enabledChannels()
         , formatHeight(formatHeight)
+        , prefetchRequests()
+        , prefetchedBytes(0)
+        , prefetchAborted(false)
+        , prefetchHits(0)
+        , prefetchMisses(0)
     {
         trackerInput = context->getNode()->getInput(0);
         assert(trackerInput);
@@ -231,18 +420,128 @@ struct TrackerFrameAccessorPrivate
             this->enabledChannels[i] = enabledChannels[i];
         }
     }
+
+    /**
+     * @brief Returns a cached image of the frame enclosing roi, or cache.end(). Must be called with cacheMutex locked.
+     **/
+    FrameAccessorCache::iterator findCachedImage(const FrameAccessorCacheKey& key, const RectI& roi);
+
+    /**
+     * @brief Returns a pending prefetch of the frame enclosing roi, or NULL. Must be called with cacheMutex locked.
+     **/
+    PrefetchRequestPtr findPrefetchRequest(const FrameAccessorCacheKey& key, const RectI& roi) const;
+
+    /**
+     * @brief Returns an image enclosing roi from the frame cache of the tracker, or NULL.
+     **/
+    MvFloatImagePtr getFromFrameCache(const FrameAccessorCacheKey& key, const RectI& roi, RectI* bounds) const;
+
+    void insertInFrameCache(const FrameAccessorCacheKey& key, const RectI& bounds, const MvFloatImagePtr& image) const;
+
+    void getFrameCacheKey(const FrameAccessorCacheKey& key, TrackerFrameCacheKey* frameCacheKey) const;
+
+    /**
+     * @brief Renders the input of the tracker and converts it to a libmv image.
+     * If roi is NULL, the full image is rendered. Returns NULL on failure.
+     **/
+    MvFloatImagePtr renderImage(int frame, int downscale, const RectI* roi, RectI* bounds);
+
+    /**
+     * @brief Renders a prefetch request in a thread of the global thread pool, and inserts the image in the cache.
+     **/
+    void runPrefetchRequest(const PrefetchRequestPtr& request);
 };
 
+FrameAccessorCache::iterator
+TrackerFrameAccessorPrivate::findCachedImage(const FrameAccessorCacheKey& key,
+                                             const RectI& roi)
+{
+    std::pair<FrameAccessorCache::iterator, FrameAccessorCache::iterator> range = cache.equal_range(key);
+
+    for (FrameAccessorCache::iterator it = range.first; it != range.second; ++it) {
+        if ( boundsContainRoI(it->second.bounds, roi) ) {
+            return it;
+        }
+    }
+
+    return cache.end();
+}
+
+PrefetchRequestPtr
+TrackerFrameAccessorPrivate::findPrefetchRequest(const FrameAccessorCacheKey& key,
+                                                 const RectI& roi) const
+{
+    CacheKey_compare_less less;
+
+    for (std::list<PrefetchRequestPtr>::const_iterator it = prefetchRequests.begin(); it != prefetchRequests.end(); ++it) {
+        if ( !less( (*it)->key, key ) && !less( key, (*it)->key ) && boundsContainRoI( (*it)->roi, roi ) ) {
+            return *it;
+        }
+    }
+
+    return PrefetchRequestPtr();
+}
+
+void
+TrackerFrameAccessorPrivate::getFrameCacheKey(const FrameAccessorCacheKey& key,
+                                              TrackerFrameCacheKey* frameCacheKey) const
+{
+    frameCacheKey->inputHash = trackerInput->getHashValue();
+    frameCacheKey->frame = key.frame;
+    frameCacheKey->mipMapLevel = key.mipMapLevel;
+    frameCacheKey->channels = (enabledChannels[0] ? 1 : 0) | (enabledChannels[1] ? 2 : 0) | (enabledChannels[2] ? 4 : 0);
+}
+
+MvFloatImagePtr
+TrackerFrameAccessorPrivate::getFromFrameCache(const FrameAccessorCacheKey& key,
+                                               const RectI& roi,
+                                               RectI* bounds) const
+{
+    if (!frameCache) {
+        return MvFloatImagePtr();
+    }
+    TrackerFrameCacheKey frameCacheKey;
+    getFrameCacheKey(key, &frameCacheKey);
+
+    return frameCache->get(frameCacheKey, roi, bounds);
+}
+
+void
+TrackerFrameAccessorPrivate::insertInFrameCache(const FrameAccessorCacheKey& key,
+                                                const RectI& bounds,
+                                                const MvFloatImagePtr& image) const
+{
+    if (!frameCache) {
+        return;
+    }
+    TrackerFrameCacheKey frameCacheKey;
+    getFrameCacheKey(key, &frameCacheKey);
+    frameCache->insert(frameCacheKey, bounds, image);
+}
+
 TrackerFrameAccessor::TrackerFrameAccessor(const TrackerContext* context,
+                                           const TrackerFrameCachePtr& frameCache,
                                            bool enabledChannels[3],
                                            int formatHeight)
     : mv::FrameAccessor()
-    , _imp( new TrackerFrameAccessorPrivate(context, enabledChannels, formatHeight) )
+    , _imp( new TrackerFrameAccessorPrivate(context, frameCache, enabledChannels, formatHeight) )
 {
 }
 
 TrackerFrameAccessor::~TrackerFrameAccessor()
 {
+    // The pending prefetches reference _imp: wait for them
+    std::list<QFuture<void> > pending;
+    {
+        QMutexLocker k(&_imp->cacheMutex);
+        _imp->prefetchAborted = true;
+        for (std::list<PrefetchRequestPtr>::iterator it = _imp->prefetchRequests.begin(); it != _imp->prefetchRequests.end(); ++it) {
+            pending.push_back( (*it)->future );
+        }
+    }
+    for (std::list<QFuture<void> >::iterator it = pending.begin(); it != pending.end(); ++it) {
+        it->waitForFinished();
+    }
 }
 
 void
@@ -275,62 +574,18 @@ TrackerFrameAccessor::convertLibMVRegionToRectI(const mv::Region& region,
     //roi->y2 = invertYCoordinate(region.min(1), formatHeight);
 }
 
-/*
- * @brief This is called by LibMV to retrieve an image either for reference or as search frame.
- */
-mv::FrameAccessor::Key
-TrackerFrameAccessor::GetImage(int /*clip*/,
-                               int frame,
-                               mv::FrameAccessor::InputMode input_mode,
-                               int downscale,            // Downscale by 2^downscale.
-                               const mv::Region* region,     // Get full image if NULL.
-                               const mv::FrameAccessor::Transform* /*transform*/, // May be NULL.
-                               mv::FloatImage** destination)
+MvFloatImagePtr
+TrackerFrameAccessorPrivate::renderImage(int frame,
+                                         int downscale,
+                                         const RectI* region,
+                                         RectI* bounds)
 {
-    // Since libmv only uses MONO images for now we have only optimized for this case, remove and handle properly
-    // other case(s) when they get integrated into libmv.
-    assert(input_mode == mv::FrameAccessor::MONO);
-
-
-    FrameAccessorCacheKey key;
-    key.frame = frame;
-    key.mipMapLevel = downscale;
-    key.mode = input_mode;
-
-    /*
-       Check if a frame exists in the cache with matching key and bounds enclosing the given region
-     */
-    RectI roi;
-    if (region) {
-        convertLibMVRegionToRectI(*region, _imp->formatHeight, &roi);
-
-        QMutexLocker k(&_imp->cacheMutex);
-        std::pair<FrameAccessorCache::iterator, FrameAccessorCache::iterator> range = _imp->cache.equal_range(key);
-        for (FrameAccessorCache::iterator it = range.first; it != range.second; ++it) {
-            if ( (roi.x1 >= it->second.bounds.x1) && (roi.x2 <= it->second.bounds.x2) &&
-                 ( roi.y1 >= it->second.bounds.y1) && ( roi.y2 <= it->second.bounds.y2) ) {
-#ifdef TRACE_LIB_MV
-                qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Found cached image at frame" << frame << "with RoI x1="
-                         << region->min(0) << "y1=" << region->max(1) << "x2=" << region->max(0) << "y2=" << region->min(1);
-#endif
-                // LibMV is kinda dumb on this we must necessarily copy the data either via CopyFrom or the
-                // assignment constructor:
-                // EDIT: fixed libmv
-                *destination = it->second.image.get();
-                //destination->CopyFrom<float>(*it->second.image);
-                ++it->second.referenceCount;
-
-                return (mv::FrameAccessor::Key)it->second.image.get();
-            }
-        }
-    }
-
     EffectInstancePtr effect;
-    if (_imp->trackerInput) {
-        effect = _imp->trackerInput->getEffectInstance();
+    if (trackerInput) {
+        effect = trackerInput->getEffectInstance();
     }
     if (!effect) {
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
     // Not in accessor cache, call renderRoI
@@ -338,12 +593,15 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     scale.y = scale.x = Image::getScaleFromMipMapLevel( (unsigned int)downscale );
 
 
+    RectI roi;
     RectD precomputedRoD;
-    if (!region) {
+    if (region) {
+        roi = *region;
+    } else {
         bool isProjectFormat;
-        StatusEnum stat = effect->getRegionOfDefinition_public(_imp->trackerInput->getHashValue(), frame, scale, ViewIdx(0), &precomputedRoD, &isProjectFormat);
+        StatusEnum stat = effect->getRegionOfDefinition_public(trackerInput->getHashValue(), frame, scale, ViewIdx(0), &precomputedRoD, &isProjectFormat);
         if (stat == eStatusFailed) {
-            return (mv::FrameAccessor::Key)0;
+            return MvFloatImagePtr();
         }
         double par = effect->getAspectRatio(-1);
         precomputedRoD.toPixelEnclosing( (unsigned int)downscale, par, &roi );
@@ -352,7 +610,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     std::list<ImagePlaneDesc> components;
     components.push_back( ImagePlaneDesc::getRGBComponents() );
 
-    NodePtr node = _imp->context->getNode();
+    NodePtr node = context->getNode();
     const bool isRenderUserInteraction = true;
     const bool isSequentialRender = false;
     AbortableRenderInfoPtr abortInfo = AbortableRenderInfo::create(false, 0);
@@ -382,7 +640,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                                         components,
                                         eImageBitDepthFloat,
                                         true,
-                                        _imp->context->getNode()->getEffectInstance().get(),
+                                        context->getNode()->getEffectInstance().get(),
                                         eStorageModeRAM /*returnOpenGLTex*/,
                                         frame);
     std::map<ImagePlaneDesc, ImagePtr> planes;
@@ -393,7 +651,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                  << roi.x1 << "y1=" << roi.y1 << "x2=" << roi.x2 << "y2=" << roi.y2;
 #endif
 
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
     assert( !planes.empty() );
@@ -406,7 +664,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                  << roi.x1 << "y1=" << roi.y1 << "x2=" << roi.x2 << "y2=" << roi.y2 << ")";
 #endif
 
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
 #ifdef TRACE_LIB_MV
@@ -417,15 +675,108 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     /*
        Copy the Natron image to the LivMV float image
      */
-    FrameAccessorCacheEntry entry;
-    entry.image = boost::make_shared<MvFloatImage>( intersectedRoI.height(), intersectedRoI.width() );
-    entry.bounds = intersectedRoI;
-    entry.referenceCount = 1;
-    natronImageToLibMvFloatImage(_imp->enabledChannels,
+    MvFloatImagePtr image = boost::make_shared<MvFloatImage>( intersectedRoI.height(), intersectedRoI.width() );
+    natronImageToLibMvFloatImage(enabledChannels,
                                  sourceImage.get(),
                                  intersectedRoI,
-                                 *entry.image);
+                                 *image);
     // we ignore the transform parameter and do it in natronImageToLibMvFloatImage instead
+    *bounds = intersectedRoI;
+
+    return image;
+} // TrackerFrameAccessorPrivate::renderImage
+
+/*
+ * @brief This is called by LibMV to retrieve an image either for reference or as search frame.
+ */
+mv::FrameAccessor::Key
+TrackerFrameAccessor::GetImage(int /*clip*/,
+                               int frame,
+                               mv::FrameAccessor::InputMode input_mode,
+                               int downscale,            // Downscale by 2^downscale.
+                               const mv::Region* region,     // Get full image if NULL.
+                               const mv::FrameAccessor::Transform* /*transform*/, // May be NULL.
+                               mv::FloatImage** destination)
+{
+    // Since libmv only uses MONO images for now we have only optimized for this case, remove and handle properly
+    // other case(s) when they get integrated into libmv.
+    assert(input_mode == mv::FrameAccessor::MONO);
+
+
+    FrameAccessorCacheKey key;
+    key.frame = frame;
+    key.mipMapLevel = downscale;
+    key.mode = input_mode;
+
+    /*
+       Check if a frame exists in the cache with matching key and bounds enclosing the given region.
+       If it is being prefetched, wait for the prefetch instead of rendering it again.
+     */
+    RectI roi;
+    if (region) {
+        convertLibMVRegionToRectI(*region, _imp->formatHeight, &roi);
+
+        for (;;) {
+            QFuture<void> pendingPrefetch;
+            {
+                QMutexLocker k(&_imp->cacheMutex);
+                FrameAccessorCache::iterator found = _imp->findCachedImage(key, roi);
+                if ( found != _imp->cache.end() ) {
+#ifdef TRACE_LIB_MV
+                    qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Found cached image at frame" << frame << "with RoI x1="
+                             << region->min(0) << "y1=" << region->max(1) << "x2=" << region->max(0) << "y2=" << region->min(1);
+#endif
+                    if (found->second.prefetched) {
+                        found->second.prefetched = false;
+                        _imp->prefetchedBytes -= getImageBytes(found->second.bounds);
+                    }
+                    ++_imp->prefetchHits;
+
+                    // LibMV is kinda dumb on this we must necessarily copy the data either via CopyFrom or the
+                    // assignment constructor:
+                    // EDIT: fixed libmv
+                    *destination = found->second.image.get();
+                    //destination->CopyFrom<float>(*it->second.image);
+                    ++found->second.referenceCount;
+
+                    return (mv::FrameAccessor::Key)found->second.image.get();
+                }
+
+                PrefetchRequestPtr request = _imp->findPrefetchRequest(key, roi);
+                if (!request) {
+                    // Converted by a previous track operation
+                    FrameAccessorCacheEntry entry;
+                    entry.image = _imp->getFromFrameCache(key, roi, &entry.bounds);
+                    if (entry.image) {
+                        entry.referenceCount = 1;
+                        entry.prefetched = false;
+                        _imp->cache.insert( std::make_pair(key, entry) );
+                        ++_imp->prefetchHits;
+                        *destination = entry.image.get();
+
+                        return (mv::FrameAccessor::Key)entry.image.get();
+                    }
+                    ++_imp->prefetchMisses;
+                    break;
+                }
+                pendingPrefetch = request->future;
+            }
+            // If the prefetch did not start yet, it is run in this thread
+            pendingPrefetch.waitForFinished();
+        }
+    } else {
+        QMutexLocker k(&_imp->cacheMutex);
+        ++_imp->prefetchMisses;
+    }
+
+    FrameAccessorCacheEntry entry;
+    entry.image = _imp->renderImage(frame, downscale, region ? &roi : 0, &entry.bounds);
+    if (!entry.image) {
+        return (mv::FrameAccessor::Key)0;
+    }
+    entry.referenceCount = 1;
+    entry.prefetched = false;
+    _imp->insertInFrameCache(key, entry.bounds, entry.image);
 
     *destination = entry.image.get();
     //destination->CopyFrom<float>(*entry.image);
@@ -437,7 +788,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     }
 #ifdef TRACE_LIB_MV
     qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Rendered frame" << frame << "with RoI x1="
-             << intersectedRoI.x1 << "y1=" << intersectedRoI.y1 << "x2=" << intersectedRoI.x2 << "y2=" << intersectedRoI.y2;
+             << entry.bounds.x1 << "y1=" << entry.bounds.y1 << "x2=" << entry.bounds.x2 << "y2=" << entry.bounds.y2;
 #endif
 
     return (mv::FrameAccessor::Key)entry.image.get();
@@ -462,6 +813,108 @@ TrackerFrameAccessor::ReleaseImage(Key key)
     }
 }
 
+void
+TrackerFrameAccessor::prefetchImage(int frame,
+                                    int downscale,
+                                    const RectI& roi)
+{
+    if ( roi.isNull() ) {
+        return;
+    }
+
+    PrefetchRequestPtr request = boost::make_shared<PrefetchRequest>();
+    request->key.frame = frame;
+    request->key.mipMapLevel = downscale;
+    request->key.mode = mv::FrameAccessor::MONO;
+    request->roi = roi;
+    request->bytes = getImageBytes(roi);
+
+    QMutexLocker k(&_imp->cacheMutex);
+    if ( _imp->prefetchAborted || ( _imp->prefetchedBytes + request->bytes > NATRON_TRACKER_PREFETCH_MAX_MEMORY ) ) {
+        return;
+    }
+    if ( ( _imp->findCachedImage(request->key, roi) != _imp->cache.end() ) || _imp->findPrefetchRequest(request->key, roi) ) {
+        return;
+    }
+    RectI bounds;
+    MvFloatImagePtr cachedImage = _imp->getFromFrameCache(request->key, roi, &bounds);
+    if (cachedImage) {
+        // Converted by a previous track operation: make it available without rendering
+        FrameAccessorCacheEntry entry;
+        entry.image = cachedImage;
+        entry.bounds = bounds;
+        entry.referenceCount = 0;
+        entry.prefetched = true;
+        _imp->prefetchedBytes += getImageBytes(bounds);
+        _imp->cache.insert( std::make_pair(request->key, entry) );
+
+        return;
+    }
+    _imp->prefetchedBytes += request->bytes;
+    _imp->prefetchRequests.push_back(request);
+    // Start the prefetch with cacheMutex locked, so that GetImage never sees a request without its future
+    request->future = QtConcurrent::run(_imp.get(), &TrackerFrameAccessorPrivate::runPrefetchRequest, request);
+}
+
+void
+TrackerFrameAccessorPrivate::runPrefetchRequest(const PrefetchRequestPtr& request)
+{
+    bool aborted;
+    {
+        QMutexLocker k(&cacheMutex);
+        aborted = prefetchAborted;
+    }
+    FrameAccessorCacheEntry entry;
+    if (!aborted) {
+        entry.image = renderImage(request->key.frame, request->key.mipMapLevel, &request->roi, &entry.bounds);
+        appPTR->getAppTLS()->cleanupTLSForThread();
+        if (entry.image) {
+            insertInFrameCache(request->key, entry.bounds, entry.image);
+        }
+    }
+
+    QMutexLocker k(&cacheMutex);
+    std::list<PrefetchRequestPtr>::iterator found = std::find(prefetchRequests.begin(), prefetchRequests.end(), request);
+    assert( found != prefetchRequests.end() );
+    prefetchRequests.erase(found);
+    prefetchedBytes -= request->bytes;
+
+    if (entry.image && !prefetchAborted) {
+        entry.referenceCount = 0;
+        entry.prefetched = true;
+        prefetchedBytes += getImageBytes(entry.bounds);
+        cache.insert( std::make_pair(request->key, entry) );
+    }
+}
+
+void
+TrackerFrameAccessor::discardPrefetchedImages(int frame,
+                                              int frameStep)
+{
+    QMutexLocker k(&_imp->cacheMutex);
+
+    for (FrameAccessorCache::iterator it = _imp->cache.begin(); it != _imp->cache.end();) {
+        bool isBefore = frameStep > 0 ? it->first.frame < frame : it->first.frame > frame;
+        if (isBefore && it->second.prefetched) {
+            assert(!it->second.referenceCount);
+            _imp->prefetchedBytes -= getImageBytes(it->second.bounds);
+            _imp->cache.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void
+TrackerFrameAccessor::getPrefetchStats(int* hits,
+                                       int* misses) const
+{
+    QMutexLocker k(&_imp->cacheMutex);
+
+    *hits = _imp->prefetchHits;
+    *misses = _imp->prefetchMisses;
+}
+
 /*
  * @brief This is called by LibMV to retrieve an the mask, which is always defined in the reference frame.
  */
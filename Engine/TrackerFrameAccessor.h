@@ -27,17 +27,123 @@
 
 #include "Global/Macros.h"
 
+#include <cstddef>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #endif
 
+#include "Global/GlobalDefines.h"
+
 #include "Engine/EngineFwd.h"
 
 #include <libmv/autotrack/frame_accessor.h>
 
+// The default maximum memory held by the TrackerFrameCache of a tracker
+#define NATRON_TRACKER_FRAME_CACHE_MAX_MEMORY (512ULL * 1024ULL * 1024ULL)
+
 
 NATRON_NAMESPACE_ENTER
 
+/**
+ * @brief An image converted for libmv: a single channel image whose origin is the top left hand corner.
+ **/
+class MvFloatImage
+    : public libmv::Array3D<float>
+{
+public:
+
+    MvFloatImage()
+        : libmv::Array3D<float>()
+    {
+    }
+
+    MvFloatImage(int height,
+                 int width)
+        : libmv::Array3D<float>(height, width)
+    {
+    }
+
+    MvFloatImage(float* data,
+                 int height,
+                 int width)
+        : libmv::Array3D<float>(data, height, width)
+    {
+    }
+
+    virtual ~MvFloatImage()
+    {
+    }
+};
+
+typedef boost::shared_ptr<MvFloatImage> MvFloatImagePtr;
+
+struct TrackerFrameCacheKey
+{
+    // The hash of the input of the tracker
+    U64 inputHash;
+    int frame;
+    int mipMapLevel;
+
+    // The enabled channels, as a bitmask
+    int channels;
+};
+
+struct TrackerFrameCachePrivate;
+
+/**
+ * @brief A least recently used cache of the images converted for libmv by TrackerFrameAccessor, with a bounded size.
+ * It is owned by the TrackerContext and shared by all the track operations of the tracker, so that tracking again
+ * the same frames (e.g. backward after forward) does not render and convert them again.
+ * Images are identified by the hash of the input of the tracker, the frame, the mipmap level and the tracked channels:
+ * when the hash of the input changes, the images of the previous hash are removed.
+ * The caches register themselves to the AppManager, which clears them with the other caches and evicts their images
+ * when the memory is low, @see AppManager::checkCacheFreeMemoryIsGoodEnough()
+ **/
+class TrackerFrameCache
+    : boost::noncopyable
+{
+public:
+
+    TrackerFrameCache();
+
+    ~TrackerFrameCache();
+
+    /**
+     * @brief Returns an image of the cache enclosing roi and marks it as the most recently used, or NULL.
+     **/
+    MvFloatImagePtr get(const TrackerFrameCacheKey& key, const RectI& roi, RectI* bounds);
+
+    /**
+     * @brief Inserts an image in the cache, removing the least recently used images if the cache is full.
+     * If the hash of the input changed, the images of the previous hash are removed first.
+     * Images bigger than the maximum memory of the cache are not inserted.
+     **/
+    void insert(const TrackerFrameCacheKey& key, const RectI& bounds, const MvFloatImagePtr& image);
+
+    /**
+     * @brief Removes the least recently used image. Returns false if the cache is empty.
+     **/
+    bool evictLRUEntry();
+
+    void clear();
+
+    std::size_t getMemoryUsage() const;
+
+    /**
+     * @brief Set the maximum memory held by the images of the cache, removing the least recently used images
+     * if needed. By default this is NATRON_TRACKER_FRAME_CACHE_MAX_MEMORY.
+     **/
+    void setMaximumMemory(std::size_t maxBytes);
+    std::size_t getMaximumMemory() const;
+
+private:
+
+    boost::scoped_ptr<TrackerFrameCachePrivate> _imp;
+};
+
 struct TrackerFrameAccessorPrivate;
 class TrackerFrameAccessor
     : public mv::FrameAccessor
@@ -45,6 +151,7 @@ class TrackerFrameAccessor
 public:
 
     TrackerFrameAccessor(const TrackerContext* context,
+                         const TrackerFrameCachePtr& frameCache,
                          bool enabledChannels[3],
                          int formatHeight);
 
@@ -95,6 +202,26 @@ public:
     virtual bool GetClipDimensions(int clip, int* width, int* height) OVERRIDE FINAL;
     virtual int NumClips() OVERRIDE FINAL;
     virtual int NumFrames(int clip) OVERRIDE FINAL;
+
+    /**
+     * @brief Starts rendering in the background the given region (in pixel coordinates at the given mipmap level) of a frame,
+     * so that a later call to GetImage with a region contained in roi does not render it.
+     * This does nothing if the region is already available or being prefetched, or if the images prefetched and
+     * not used yet exceed the memory budget of the prefetcher.
+     **/
+    void prefetchImage(int frame, int downscale, const RectI& roi);
+
+    /**
+     * @brief Removes the prefetched images that were not used, of the frames before the given one
+     * in the direction of frameStep.
+     **/
+    void discardPrefetchedImages(int frame, int frameStep);
+
+    /**
+     * @brief Returns the number of images returned by GetImage which did not have to be rendered by the caller
+     * (hits) and the number of images it had to render (misses).
+     **/
+    void getPrefetchStats(int* hits, int* misses) const;
     static double invertYCoordinate(double yIn, double formatHeight);
     static void convertLibMVRegionToRectI(const mv::Region& region, int formatHeight, RectI* roi);
 
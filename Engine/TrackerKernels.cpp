@@ -0,0 +1,213 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TrackerKernels.h"
+
+#ifdef NATRON_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// Rec. 709 luminance weights, as in libmv/autotrack/autotrack.cc
+#define NATRON_TRACKER_LUMINANCE_WEIGHT_R 0.2126f
+#define NATRON_TRACKER_LUMINANCE_WEIGHT_G 0.7152f
+#define NATRON_TRACKER_LUMINANCE_WEIGHT_B 0.0722f
+
+NATRON_NAMESPACE_ENTER
+
+namespace TrackerKernels {
+namespace {
+///////////////////////////////////////////////////////////////////////////////
+// Scalar version: this is the reference, it does exactly what TrackerFrameAccessor did for each pixel
+
+void
+rgbToLuminance_scalar(const float* src,
+                      int width,
+                      bool doR,
+                      bool doG,
+                      bool doB,
+                      float scale,
+                      float* dst)
+{
+    for (int x = 0; x < width; ++x, src += 3) {
+        dst[x] = ( NATRON_TRACKER_LUMINANCE_WEIGHT_R * (doR ? src[0] : 0.0f) +
+                   NATRON_TRACKER_LUMINANCE_WEIGHT_G * (doG ? src[1] : 0.0f) +
+                   NATRON_TRACKER_LUMINANCE_WEIGHT_B * (doB ? src[2] : 0.0f) ) / scale;
+    }
+}
+
+#ifdef NATRON_KERNELS_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.1 version
+// The disabled channels are zeroed with a mask rather than multiplied by a null weight, so that
+// a NaN or an infinity in a disabled channel is ignored as in the scalar version.
+// The division is kept (instead of a multiplication by the inverse of the scale) so that the
+// result is exactly the same.
+
+// Deinterleaves 4 RGB pixels: v0 = R0 G0 B0 R1, v1 = G1 B1 R2 G2, v2 = B2 R3 G3 B3.
+// The blends gather the components of each channel in the wrong order, which the shuffles fix.
+NATRON_TARGET_SSE41
+inline void
+deinterleaveRGB_sse41(__m128 v0,
+                      __m128 v1,
+                      __m128 v2,
+                      __m128* r,
+                      __m128* g,
+                      __m128* b)
+{
+    __m128 rr = _mm_blend_ps(_mm_blend_ps(v0, v1, 0x4), v2, 0x2); // R0 R3 R2 R1
+    __m128 gg = _mm_blend_ps(_mm_blend_ps(v0, v1, 0x9), v2, 0x4); // G1 G0 G3 G2
+    __m128 bb = _mm_blend_ps(_mm_blend_ps(v0, v1, 0x2), v2, 0x9); // B2 B1 B0 B3
+
+    *r = _mm_shuffle_ps( rr, rr, _MM_SHUFFLE(1, 2, 3, 0) );
+    *g = _mm_shuffle_ps( gg, gg, _MM_SHUFFLE(2, 3, 0, 1) );
+    *b = _mm_shuffle_ps( bb, bb, _MM_SHUFFLE(3, 0, 1, 2) );
+}
+
+NATRON_TARGET_SSE41
+void
+rgbToLuminance_sse41(const float* src,
+                     int width,
+                     bool doR,
+                     bool doG,
+                     bool doB,
+                     float scale,
+                     float* dst)
+{
+    const __m128 maskR = _mm_castsi128_ps( _mm_set1_epi32(doR ? -1 : 0) );
+    const __m128 maskG = _mm_castsi128_ps( _mm_set1_epi32(doG ? -1 : 0) );
+    const __m128 maskB = _mm_castsi128_ps( _mm_set1_epi32(doB ? -1 : 0) );
+    const __m128 weightR = _mm_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_R);
+    const __m128 weightG = _mm_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_G);
+    const __m128 weightB = _mm_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_B);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    int x = 0;
+
+    // 4 pixels per iteration
+    for (; x + 4 <= width; x += 4) {
+        const float* p = src + 3 * x;
+        __m128 r, g, b;
+        deinterleaveRGB_sse41(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), &r, &g, &b);
+        __m128 sum = _mm_add_ps( _mm_add_ps( _mm_mul_ps( weightR, _mm_and_ps(r, maskR) ),
+                                             _mm_mul_ps( weightG, _mm_and_ps(g, maskG) ) ),
+                                 _mm_mul_ps( weightB, _mm_and_ps(b, maskB) ) );
+        _mm_storeu_ps( dst + x, _mm_div_ps(sum, scale4) );
+    }
+    rgbToLuminance_scalar(src + 3 * x, width - x, doR, doG, doB, scale, dst + x);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 version: the same as the SSE4.1 version on 8 pixels, the low 128-bit lanes holding the
+// pixels 0 to 3 and the high lanes the pixels 4 to 7 so that the in-lane blends and shuffles apply.
+
+NATRON_TARGET_AVX2
+inline __m256
+loadLanes_avx2(const float* low,
+               const float* high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256( _mm_loadu_ps(low) ), _mm_loadu_ps(high), 1);
+}
+
+NATRON_TARGET_AVX2
+void
+rgbToLuminance_avx2(const float* src,
+                    int width,
+                    bool doR,
+                    bool doG,
+                    bool doB,
+                    float scale,
+                    float* dst)
+{
+    const __m256 maskR = _mm256_castsi256_ps( _mm256_set1_epi32(doR ? -1 : 0) );
+    const __m256 maskG = _mm256_castsi256_ps( _mm256_set1_epi32(doG ? -1 : 0) );
+    const __m256 maskB = _mm256_castsi256_ps( _mm256_set1_epi32(doB ? -1 : 0) );
+    const __m256 weightR = _mm256_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_R);
+    const __m256 weightG = _mm256_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_G);
+    const __m256 weightB = _mm256_set1_ps(NATRON_TRACKER_LUMINANCE_WEIGHT_B);
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    int x = 0;
+
+    // 8 pixels per iteration
+    for (; x + 8 <= width; x += 8) {
+        const float* p = src + 3 * x;
+        __m256 v0 = loadLanes_avx2(p, p + 12);
+        __m256 v1 = loadLanes_avx2(p + 4, p + 16);
+        __m256 v2 = loadLanes_avx2(p + 8, p + 20);
+        __m256 rr = _mm256_blend_ps(_mm256_blend_ps(v0, v1, 0x44), v2, 0x22);
+        __m256 gg = _mm256_blend_ps(_mm256_blend_ps(v0, v1, 0x99), v2, 0x44);
+        __m256 bb = _mm256_blend_ps(_mm256_blend_ps(v0, v1, 0x22), v2, 0x99);
+        __m256 r = _mm256_shuffle_ps( rr, rr, _MM_SHUFFLE(1, 2, 3, 0) );
+        __m256 g = _mm256_shuffle_ps( gg, gg, _MM_SHUFFLE(2, 3, 0, 1) );
+        __m256 b = _mm256_shuffle_ps( bb, bb, _MM_SHUFFLE(3, 0, 1, 2) );
+        __m256 sum = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( weightR, _mm256_and_ps(r, maskR) ),
+                                                   _mm256_mul_ps( weightG, _mm256_and_ps(g, maskG) ) ),
+                                    _mm256_mul_ps( weightB, _mm256_and_ps(b, maskB) ) );
+        _mm256_storeu_ps( dst + x, _mm256_div_ps(sum, scale8) );
+    }
+    rgbToLuminance_scalar(src + 3 * x, width - x, doR, doG, doB, scale, dst + x);
+}
+
+#endif // NATRON_KERNELS_X86
+} // anon namespace
+
+float
+getLuminanceScale(bool doR,
+                  bool doG,
+                  bool doB)
+{
+    return (doR ? NATRON_TRACKER_LUMINANCE_WEIGHT_R : 0.0f) +
+           (doG ? NATRON_TRACKER_LUMINANCE_WEIGHT_G : 0.0f) +
+           (doB ? NATRON_TRACKER_LUMINANCE_WEIGHT_B : 0.0f);
+}
+
+void
+rgbToLuminance(const float* src,
+               int width,
+               bool doR,
+               bool doG,
+               bool doB,
+               float* dst)
+{
+    const float scale = getLuminanceScale(doR, doG, doB);
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        rgbToLuminance_avx2(src, width, doR, doG, doB, scale, dst);
+        break;
+    case eInstructionSetSSE41:
+        rgbToLuminance_sse41(src, width, doR, doG, doB, scale, dst);
+        break;
+#endif
+    default:
+        rgbToLuminance_scalar(src, width, doR, doG, doB, scale, dst);
+        break;
+    }
+}
+} // namespace TrackerKernels
+
+NATRON_NAMESPACE_EXIT
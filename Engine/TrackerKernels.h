@@ -0,0 +1,57 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_TRACKERKERNELS_H
+#define NATRON_ENGINE_TRACKERKERNELS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+#include "Engine/InstructionSet.h"
+
+NATRON_NAMESPACE_ENTER
+
+/*
+ * Scan-line kernels used by the TrackerFrameAccessor to convert the images rendered for the tracker
+ * to the libmv images. Each kernel has a scalar implementation and vector implementations selected
+ * at runtime with getInstructionSet(), which give bit-exact identical results.
+ */
+namespace TrackerKernels {
+/**
+ * @brief Returns the sum of the luminance weights of the enabled channels, by which rgbToLuminance divides.
+ **/
+float getLuminanceScale(bool doR, bool doG, bool doB);
+
+/**
+ * @brief Converts width RGB pixels of src to their luminance in dst, as DisableChannelsTransform::run in
+ * libmv/autotrack/autotrack.cc: the disabled channels have a weight of zero, and the result is divided
+ * by getLuminanceScale() so that e.g. if only blue is enabled, the image is not darkened.
+ * If no channel is enabled, the scale is zero and the result is not finite.
+ **/
+void rgbToLuminance(const float* src, int width, bool doR, bool doG, bool doB, float* dst);
+} // namespace TrackerKernels
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_TRACKERKERNELS_H
@@ -71,6 +71,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/Timer.h"
 #include "Engine/UpdateViewerParams.h"
 #include "Engine/ViewIdx.h"
+#include "Engine/ViewerTextureKernels.h"
 
 
 #ifndef M_LN2
@@ -2160,6 +2161,211 @@ findAutoContrastVminVmax(const ImagePtr inputImage,
     }
 } // findAutoContrastVminVmax
 
+/*
+ * Same as scaleToTexture8bits_generic for float images without input colorspace, using the vectorized
+ * scan-line kernels. Only the dithered quantization to the display colorspace remains scalar,
+ * since the error of each pixel depends on the previous one.
+ */
+static void
+scaleToTexture8bitsFloatRows(const float* src_pixels,
+                             int srcRowElements,
+                             int nComps,
+                             int rOffset,
+                             int gOffset,
+                             int bOffset,
+                             bool opaque,
+                             bool applyMatte,
+                             const RenderViewerArgs & args,
+                             ViewerInstance* viewer,
+                             int width,
+                             int height,
+                             int dstRowElements,
+                             U32* dst_pixels)
+{
+    const bool luminance = (args.channels == eDisplayChannelsY);
+    const bool applyGamma = (args.gamma != 1.);
+    std::vector<float> buffer(width * 4);
+    float* r = &buffer[0];
+    float* g = r + width;
+    float* b = g + width;
+    float* a = b + width;
+    const float* matte = 0;
+
+    if (applyMatte) {
+        // the matte image is the input image
+        const float* channels[4] = { r, g, b, a };
+        assert(args.alphaChannelIndex >= 0 && args.alphaChannelIndex < 4);
+        matte = channels[args.alphaChannelIndex];
+    }
+
+    for (int y = 0; y < height;
+         ++y,
+         src_pixels += srcRowElements,
+         dst_pixels += dstRowElements) {
+        ViewerTextureKernels::convertRowToLinear(src_pixels, nComps, rOffset, gOffset, bOffset, opaque, args.gain, args.offset,
+                                                 luminance && !applyGamma, width, r, g, b, a);
+        if (applyGamma) {
+            viewer->interpolateGammaLut(width, r);
+            viewer->interpolateGammaLut(width, g);
+            viewer->interpolateGammaLut(width, b);
+            if (luminance) {
+                ViewerTextureKernels::applyLuminance(width, r, g, b);
+            }
+        }
+
+        if (!args.colorSpace) {
+            ViewerTextureKernels::packToBGRA8(r, g, b, a, matte, width, dst_pixels);
+            continue;
+        }
+
+        // coverity[dont_call]
+        int start = (int)( rand() % width );
+        for (int backward = 0; backward < 2; ++backward) {
+            int index = backward ? start - 1 : start;
+            unsigned error_r = 0x80;
+            unsigned error_g = 0x80;
+            unsigned error_b = 0x80;
+
+            while (index < width && index >= 0) {
+                error_r = (error_r & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(r[index]);
+                error_g = (error_g & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(g[index]);
+                error_b = (error_b & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(b[index]);
+                assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
+                U8 uR = (U8)(error_r >> 8);
+                U8 uG = (U8)(error_g >> 8);
+                U8 uB = (U8)(error_b >> 8);
+                U8 uA = Color::floatToInt<256>(a[index]);
+                if (matte) {
+                    U8 matteA = args.colorSpace->toColorSpaceUint8FromLinearFloatFast(matte[index]) / 2;
+                    uR = Image::clampIfInt<U8>( (double)uR + matteA );
+                }
+
+                dst_pixels[index] = toBGRA(uR, uG, uB, uA);
+
+                if (backward) {
+                    --index;
+                } else {
+                    ++index;
+                }
+            }
+        }
+    }
+} // scaleToTexture8bitsFloatRows
+
+static inline float
+colorSpaceToLinear(unsigned char v,
+                   const Color::Lut* /*srcColorSpace*/,
+                   const float* byteLut)
+{
+    return byteLut[v];
+}
+
+static inline float
+colorSpaceToLinear(unsigned short v,
+                   const Color::Lut* srcColorSpace,
+                   const float* /*byteLut*/)
+{
+    return srcColorSpace->fromColorSpaceUint16ToLinearFloatFast(v);
+}
+
+static inline float
+colorSpaceToLinear(float v,
+                   const Color::Lut* srcColorSpace,
+                   const float* /*byteLut*/)
+{
+    return srcColorSpace->fromColorSpaceFloatToLinearFloat(v);
+}
+
+/*
+ * Converts a row of an image with an input colorspace to linear RGBA floats, reading the channels
+ * exactly like the scalar loop of scaleToTexture8bits_generic: the displayed channels go through the
+ * input colorspace and the alpha keeps its value. The row is written with 4 components in the
+ * displayed order, to be passed to scaleToTexture8bitsFloatRows with offsets 0, 1, 2 and opaque false.
+ */
+template <typename PIX>
+static void
+convertRowFromColorSpace(const PIX* src,
+                         int nComps,
+                         int rOffset,
+                         int gOffset,
+                         int bOffset,
+                         bool opaque,
+                         const Color::Lut* srcColorSpace,
+                         const float* byteLut,
+                         int width,
+                         float* dst)
+{
+    for (int x = 0; x < width; ++x, src += nComps, dst += 4) {
+        float r, g, b;
+        float a = 1.f;
+        if (nComps >= 4) {
+            r = colorSpaceToLinear(src[rOffset], srcColorSpace, byteLut);
+            g = colorSpaceToLinear(src[gOffset], srcColorSpace, byteLut);
+            b = colorSpaceToLinear(src[bOffset], srcColorSpace, byteLut);
+            if (!opaque) {
+                a = (float)src[3];
+            }
+        } else if (nComps == 3) {
+            r = (rOffset < nComps) ? colorSpaceToLinear(src[rOffset], srcColorSpace, byteLut) : 0.f;
+            g = (gOffset < nComps) ? colorSpaceToLinear(src[gOffset], srcColorSpace, byteLut) : 0.f;
+            b = (bOffset < nComps) ? colorSpaceToLinear(src[bOffset], srcColorSpace, byteLut) : 0.f;
+        } else if (nComps == 2) {
+            r = (rOffset < nComps) ? colorSpaceToLinear(src[rOffset], srcColorSpace, byteLut) : 0.f;
+            g = (gOffset < nComps) ? colorSpaceToLinear(src[gOffset], srcColorSpace, byteLut) : 0.f;
+            b = 0.f;
+        } else {
+            r = (rOffset < nComps) ? colorSpaceToLinear(src[rOffset], srcColorSpace, byteLut) : 0.f;
+            g = b = r;
+        }
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    }
+}
+
+/*
+ * Same as scaleToTexture8bitsFloatRows for images with an input colorspace, typically 8-bit and 16-bit
+ * images: each row is first converted to linear floats, then goes through the vectorized kernels.
+ * This covers the opaque, premultiplied and unpremultiplied images alike, the alpha being copied as is.
+ */
+template <typename PIX>
+static void
+scaleToTexture8bitsColorSpaceRows(const PIX* src_pixels,
+                                  int srcRowElements,
+                                  int nComps,
+                                  int rOffset,
+                                  int gOffset,
+                                  int bOffset,
+                                  bool opaque,
+                                  bool applyMatte,
+                                  const RenderViewerArgs & args,
+                                  ViewerInstance* viewer,
+                                  int width,
+                                  int height,
+                                  int dstRowElements,
+                                  U32* dst_pixels)
+{
+    assert(args.srcColorSpace);
+    // For 8-bit images, look-up the 256 values once instead of for each pixel
+    float byteLut[256];
+    if (sizeof(PIX) == sizeof(unsigned char)) {
+        for (int i = 0; i < 256; ++i) {
+            byteLut[i] = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)i );
+        }
+    }
+    std::vector<float> linearRow(width * 4);
+
+    for (int y = 0; y < height;
+         ++y,
+         src_pixels += srcRowElements,
+         dst_pixels += dstRowElements) {
+        convertRowFromColorSpace(src_pixels, nComps, rOffset, gOffset, bOffset, opaque, args.srcColorSpace, byteLut, width, &linearRow[0]);
+        scaleToTexture8bitsFloatRows(&linearRow[0], width * 4, 4, 0, 1, 2, false, applyMatte,
+                                     args, viewer, width, 1, dstRowElements, dst_pixels);
+    }
+} // scaleToTexture8bitsColorSpaceRows
+
 template <typename PIX, int maxValue, bool opaque, bool applyMatte, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture8bits_generic(const RectI& roi,
@@ -2195,6 +2401,23 @@ scaleToTexture8bits_generic(const RectI& roi,
     const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
     const PIX* src_pixels = (const PIX*)acc.pixelAt(x1, y1);
     const int srcRowElements = (int)args.inputImage->getRowElements();
+
+    if ( src_pixels && (args.gamma > 0) &&
+         ( !applyMatte || ( (args.matteImage == args.inputImage) && (args.alphaChannelIndex <= 3) ) ) &&
+         (getInstructionSet() != eInstructionSetScalar) ) {
+        if (args.srcColorSpace) {
+            scaleToTexture8bitsColorSpaceRows<PIX>( src_pixels, srcRowElements, nComps, rOffset, gOffset, bOffset, opaque, applyMatte,
+                                                    args, viewer, x2 - x1, y2 - y1, dstRowElements, dst_pixels );
+
+            return;
+        } else if (pixelSize == sizeof(float)) {
+            scaleToTexture8bitsFloatRows( (const float*)src_pixels, srcRowElements, nComps, rOffset, gOffset, bOffset, opaque, applyMatte,
+                                          args, viewer, x2 - x1, y2 - y1, dstRowElements, dst_pixels );
+
+            return;
+        }
+    }
+
     Image::ReadAccessPtr matteAcc;
     if (applyMatte) {
         matteAcc = boost::make_shared<Image::ReadAccess>( args.matteImage.get() );
@@ -2555,6 +2778,13 @@ ViewerInstance::interpolateGammaLut(float value)
     return _imp->lookupGammaLut(value);
 }
 
+void
+ViewerInstance::interpolateGammaLut(int count,
+                                    float* values)
+{
+    ViewerTextureKernels::applyGammaLut(&_imp->gammaLookup[0], GAMMA_LUT_NB_VALUES, count, values);
+}
+
 void
 ViewerInstance::markAllOnGoingRendersAsAborted(bool keepOldestRender)
 {
@@ -2614,6 +2844,22 @@ scaleToTexture32bitsGeneric(const RectI& roi,
     const float* src_pixels = (const float*)acc.pixelAt(x1, y1);
     const int srcRowElements = (const int)args.inputImage->getRowElements();
 
+    if ( (pixelSize == sizeof(float)) && src_pixels && !args.srcColorSpace &&
+         ( !applyMatte || ( (args.matteImage == args.inputImage) && (args.alphaChannelIndex <= 3) ) ) &&
+         (getInstructionSet() != eInstructionSetScalar) ) {
+        // vectorized version of the loop below
+        const int matteChannel = applyMatte ? args.alphaChannelIndex : -1;
+        for (int y = y1; y < y2;
+             ++y,
+             src_pixels += srcRowElements,
+             dst_pixels += dstRowElements) {
+            ViewerTextureKernels::convertRowToFloatTexture(src_pixels, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel,
+                                                           x2 - x1, dst_pixels);
+        }
+
+        return;
+    }
+
     for (int y = y1; y < y2;
          ++y,
          dst_pixels += dstRowElements) {
@@ -304,6 +304,11 @@ public:
 
     float interpolateGammaLut(float value);
 
+    /**
+     * @brief Same as interpolateGammaLut(float) for count values, in place.
+     **/
+    void interpolateGammaLut(int count, float* values);
+
     void markAllOnGoingRendersAsAborted(bool keepOldestRender);
 
     /**
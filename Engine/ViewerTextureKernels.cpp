@@ -0,0 +1,903 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ViewerTextureKernels.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Engine/Lut.h"
+
+#ifdef NATRON_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace ViewerTextureKernels {
+namespace {
+///////////////////////////////////////////////////////////////////////////////
+// Scalar versions: these are the reference, they do exactly what the viewer did pixel per pixel
+
+inline void
+fetchPixel(const float* pix,
+           int nComps,
+           int rOffset,
+           int gOffset,
+           int bOffset,
+           bool opaque,
+           float* r,
+           float* g,
+           float* b,
+           float* a)
+{
+    *r = (rOffset < nComps) ? pix[rOffset] : 0.f;
+    if (nComps == 1) {
+        *g = *b = *r;
+    } else {
+        *g = (gOffset < nComps) ? pix[gOffset] : 0.f;
+        *b = (nComps > 2 && bOffset < nComps) ? pix[bOffset] : 0.f;
+    }
+    *a = (nComps >= 4 && !opaque) ? pix[3] : 1.f;
+}
+
+void
+convertRowToFloatTexture_scalar(const float* src,
+                                int nComps,
+                                int rOffset,
+                                int gOffset,
+                                int bOffset,
+                                bool opaque,
+                                bool luminance,
+                                int matteChannel,
+                                int width,
+                                float* dst)
+{
+    for (int x = 0; x < width; ++x, src += nComps, dst += 4) {
+        float fr, fg, fb, fa;
+        fetchPixel(src, nComps, rOffset, gOffset, bOffset, opaque, &fr, &fg, &fb, &fa);
+
+        double r = fr;
+        double g = fg;
+        double b = fb;
+        double a = fa;
+        if (luminance) {
+            r = 0.299 * r + 0.587 * g + 0.114 * b;
+            g = r;
+            b = r;
+        }
+        if (matteChannel >= 0) {
+            const double channels[4] = { r, g, b, a };
+            r += channels[matteChannel] * 0.5;
+        }
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    }
+}
+
+void
+convertRowToLinear_scalar(const float* src,
+                          int nComps,
+                          int rOffset,
+                          int gOffset,
+                          int bOffset,
+                          bool opaque,
+                          double gain,
+                          double offset,
+                          bool luminance,
+                          int width,
+                          float* rOut,
+                          float* gOut,
+                          float* bOut,
+                          float* aOut)
+{
+    for (int x = 0; x < width; ++x, src += nComps) {
+        float fr, fg, fb;
+        fetchPixel(src, nComps, rOffset, gOffset, bOffset, opaque, &fr, &fg, &fb, &aOut[x]);
+
+        double r = fr * gain + offset;
+        double g = fg * gain + offset;
+        double b = fb * gain + offset;
+        if (luminance) {
+            r = 0.299 * r + 0.587 * g + 0.114 * b;
+            g = r;
+            b = r;
+        }
+        rOut[x] = r;
+        gOut[x] = g;
+        bOut[x] = b;
+    }
+}
+
+void
+applyGammaLut_scalar(const float* lut,
+                     int lutMaxIndex,
+                     int count,
+                     float* values)
+{
+    for (int x = 0; x < count; ++x) {
+        float value = values[x];
+        if (value < 0.) {
+            values[x] = 0.f;
+        } else if (value > 1.) {
+            values[x] = 1.f;
+        } else {
+            int i = (int)(value * lutMaxIndex);
+            assert(0 <= i && i <= lutMaxIndex);
+            float alpha = std::max( 0.f, std::min(value * lutMaxIndex - i, 1.f) );
+            float a = lut[i];
+            float b = (i < lutMaxIndex) ? lut[i + 1] : 0.f;
+            values[x] = a * (1.f - alpha) + b * alpha;
+        }
+    }
+}
+
+void
+applyLuminance_scalar(int count,
+                      float* r,
+                      float* g,
+                      float* b)
+{
+    for (int x = 0; x < count; ++x) {
+        double l = 0.299 * (double)r[x] + 0.587 * (double)g[x] + 0.114 * (double)b[x];
+        r[x] = g[x] = b[x] = l;
+    }
+}
+
+void
+packToBGRA8_scalar(const float* r,
+                   const float* g,
+                   const float* b,
+                   const float* a,
+                   const float* matte,
+                   int count,
+                   U32* dst)
+{
+    for (int x = 0; x < count; ++x) {
+        unsigned uR = (U8)Color::floatToInt<256>(r[x]);
+        unsigned uG = (U8)Color::floatToInt<256>(g[x]);
+        unsigned uB = (U8)Color::floatToInt<256>(b[x]);
+        unsigned uA = (U8)Color::floatToInt<256>(a[x]);
+        if (matte) {
+            U8 matteA = Color::floatToInt<256>(matte[x]) / 2;
+            uR = std::min(uR + matteA, 255u);
+        }
+        dst[x] = (uA << 24) | (uR << 16) | (uG << 8) | uB;
+    }
+}
+
+#ifdef NATRON_KERNELS_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.1 versions, 4 pixels at a time
+
+NATRON_TARGET_SSE41
+inline __m128
+loadChannel_sse41(const float* src,
+                  int nComps,
+                  int channel)
+{
+    if (channel >= nComps) {
+        return _mm_setzero_ps();
+    }
+
+    return _mm_set_ps(src[3 * nComps + channel], src[2 * nComps + channel], src[nComps + channel], src[channel]);
+}
+
+NATRON_TARGET_SSE41
+inline void
+fetchPixels_sse41(const float* src,
+                  int nComps,
+                  int rOffset,
+                  int gOffset,
+                  int bOffset,
+                  bool opaque,
+                  __m128* r,
+                  __m128* g,
+                  __m128* b,
+                  __m128* a)
+{
+    if (nComps == 4) {
+        __m128 c0 = _mm_loadu_ps(src);
+        __m128 c1 = _mm_loadu_ps(src + 4);
+        __m128 c2 = _mm_loadu_ps(src + 8);
+        __m128 c3 = _mm_loadu_ps(src + 12);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        const __m128 channels[4] = { c0, c1, c2, c3 };
+        *r = channels[rOffset];
+        *g = channels[gOffset];
+        *b = channels[bOffset];
+        *a = opaque ? _mm_set1_ps(1.f) : c3;
+
+        return;
+    }
+    *r = loadChannel_sse41(src, nComps, rOffset);
+    if (nComps == 1) {
+        *g = *b = *r;
+    } else {
+        *g = loadChannel_sse41(src, nComps, gOffset);
+        *b = (nComps > 2) ? loadChannel_sse41(src, nComps, bOffset) : _mm_setzero_ps();
+    }
+    *a = _mm_set1_ps(1.f);
+}
+
+NATRON_TARGET_SSE41
+inline __m128d
+luminance_sse41(__m128d r,
+                __m128d g,
+                __m128d b)
+{
+    return _mm_add_pd( _mm_add_pd( _mm_mul_pd(_mm_set1_pd(0.299), r), _mm_mul_pd(_mm_set1_pd(0.587), g) ),
+                       _mm_mul_pd(_mm_set1_pd(0.114), b) );
+}
+
+NATRON_TARGET_SSE41
+inline __m128d
+lowToDouble_sse41(__m128 v)
+{
+    return _mm_cvtps_pd(v);
+}
+
+NATRON_TARGET_SSE41
+inline __m128d
+highToDouble_sse41(__m128 v)
+{
+    return _mm_cvtps_pd( _mm_movehl_ps(v, v) );
+}
+
+NATRON_TARGET_SSE41
+inline __m128
+toFloat_sse41(__m128d low,
+              __m128d high)
+{
+    return _mm_movelh_ps( _mm_cvtpd_ps(low), _mm_cvtpd_ps(high) );
+}
+
+NATRON_TARGET_SSE41
+void
+convertRowToFloatTexture_sse41(const float* src,
+                               int nComps,
+                               int rOffset,
+                               int gOffset,
+                               int bOffset,
+                               bool opaque,
+                               bool luminance,
+                               int matteChannel,
+                               int width,
+                               float* dst)
+{
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4, src += 4 * nComps, dst += 16) {
+        __m128 r, g, b, a;
+        fetchPixels_sse41(src, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+
+        if ( luminance || (matteChannel >= 0) ) {
+            __m128d rd[2] = { lowToDouble_sse41(r), highToDouble_sse41(r) };
+            __m128d gd[2] = { lowToDouble_sse41(g), highToDouble_sse41(g) };
+            __m128d bd[2] = { lowToDouble_sse41(b), highToDouble_sse41(b) };
+            const __m128d ad[2] = { lowToDouble_sse41(a), highToDouble_sse41(a) };
+            for (int i = 0; i < 2; ++i) {
+                if (luminance) {
+                    rd[i] = gd[i] = bd[i] = luminance_sse41(rd[i], gd[i], bd[i]);
+                }
+                if (matteChannel >= 0) {
+                    const __m128d channels[4] = { rd[i], gd[i], bd[i], ad[i] };
+                    rd[i] = _mm_add_pd( rd[i], _mm_mul_pd(channels[matteChannel], _mm_set1_pd(0.5)) );
+                }
+            }
+            r = toFloat_sse41(rd[0], rd[1]);
+            g = toFloat_sse41(gd[0], gd[1]);
+            b = toFloat_sse41(bd[0], bd[1]);
+        }
+
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        _mm_storeu_ps(dst, r);
+        _mm_storeu_ps(dst + 4, g);
+        _mm_storeu_ps(dst + 8, b);
+        _mm_storeu_ps(dst + 12, a);
+    }
+    convertRowToFloatTexture_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel, width - x, dst);
+}
+
+NATRON_TARGET_SSE41
+void
+convertRowToLinear_sse41(const float* src,
+                         int nComps,
+                         int rOffset,
+                         int gOffset,
+                         int bOffset,
+                         bool opaque,
+                         double gain,
+                         double offset,
+                         bool luminance,
+                         int width,
+                         float* rOut,
+                         float* gOut,
+                         float* bOut,
+                         float* aOut)
+{
+    const __m128d gainv = _mm_set1_pd(gain);
+    const __m128d offsetv = _mm_set1_pd(offset);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4, src += 4 * nComps) {
+        __m128 r, g, b, a;
+        fetchPixels_sse41(src, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+
+        __m128d rd[2] = { lowToDouble_sse41(r), highToDouble_sse41(r) };
+        __m128d gd[2] = { lowToDouble_sse41(g), highToDouble_sse41(g) };
+        __m128d bd[2] = { lowToDouble_sse41(b), highToDouble_sse41(b) };
+        for (int i = 0; i < 2; ++i) {
+            rd[i] = _mm_add_pd(_mm_mul_pd(rd[i], gainv), offsetv);
+            gd[i] = _mm_add_pd(_mm_mul_pd(gd[i], gainv), offsetv);
+            bd[i] = _mm_add_pd(_mm_mul_pd(bd[i], gainv), offsetv);
+            if (luminance) {
+                rd[i] = gd[i] = bd[i] = luminance_sse41(rd[i], gd[i], bd[i]);
+            }
+        }
+        _mm_storeu_ps( rOut + x, toFloat_sse41(rd[0], rd[1]) );
+        _mm_storeu_ps( gOut + x, toFloat_sse41(gd[0], gd[1]) );
+        _mm_storeu_ps( bOut + x, toFloat_sse41(bd[0], bd[1]) );
+        _mm_storeu_ps(aOut + x, a);
+    }
+    convertRowToLinear_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, gain, offset, luminance, width - x,
+                              rOut + x, gOut + x, bOut + x, aOut + x);
+}
+
+NATRON_TARGET_SSE41
+void
+applyGammaLut_sse41(const float* lut,
+                    int lutMaxIndex,
+                    int count,
+                    float* values)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scale = _mm_set1_ps( (float)lutMaxIndex );
+    const __m128i maxIndex = _mm_set1_epi32(lutMaxIndex);
+    int x = 0;
+
+    for (; x + 4 <= count; x += 4) {
+        __m128 v = _mm_loadu_ps(values + x);
+        __m128 scaled = _mm_mul_ps(v, scale);
+        // clamping the index also protects from NaNs
+        __m128i i = _mm_min_epi32( _mm_max_epi32( _mm_cvttps_epi32(scaled), _mm_setzero_si128() ), maxIndex );
+        __m128 alpha = _mm_max_ps( _mm_min_ps(_mm_sub_ps( scaled, _mm_cvtepi32_ps(i) ), one), zero );
+        int indices[4];
+        _mm_storeu_si128( (__m128i*)indices, i );
+        __m128 a = _mm_set_ps(lut[indices[3]], lut[indices[2]], lut[indices[1]], lut[indices[0]]);
+        // when i == lutMaxIndex, alpha is 0 and the next value does not matter
+        __m128 b = _mm_set_ps(lut[std::min(indices[3] + 1, lutMaxIndex)], lut[std::min(indices[2] + 1, lutMaxIndex)],
+                              lut[std::min(indices[1] + 1, lutMaxIndex)], lut[std::min(indices[0] + 1, lutMaxIndex)]);
+        __m128 result = _mm_add_ps( _mm_mul_ps( a, _mm_sub_ps(one, alpha) ), _mm_mul_ps(b, alpha) );
+        result = _mm_blendv_ps( result, zero, _mm_cmplt_ps(v, zero) );
+        result = _mm_blendv_ps( result, one, _mm_cmpgt_ps(v, one) );
+        _mm_storeu_ps(values + x, result);
+    }
+    applyGammaLut_scalar(lut, lutMaxIndex, count - x, values + x);
+}
+
+NATRON_TARGET_SSE41
+void
+applyLuminance_sse41(int count,
+                     float* r,
+                     float* g,
+                     float* b)
+{
+    int x = 0;
+
+    for (; x + 4 <= count; x += 4) {
+        __m128 rv = _mm_loadu_ps(r + x);
+        __m128 gv = _mm_loadu_ps(g + x);
+        __m128 bv = _mm_loadu_ps(b + x);
+        __m128 l = toFloat_sse41( luminance_sse41( lowToDouble_sse41(rv), lowToDouble_sse41(gv), lowToDouble_sse41(bv) ),
+                                  luminance_sse41( highToDouble_sse41(rv), highToDouble_sse41(gv), highToDouble_sse41(bv) ) );
+        _mm_storeu_ps(r + x, l);
+        _mm_storeu_ps(g + x, l);
+        _mm_storeu_ps(b + x, l);
+    }
+    applyLuminance_scalar(count - x, r + x, g + x, b + x);
+}
+
+// Same as Color::floatToInt<256>
+NATRON_TARGET_SSE41
+inline __m128i
+floatToInt256_sse41(__m128 v)
+{
+    // _mm_max_ps returns its second operand if the first one is NaN
+    v = _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps(1.f) );
+
+    return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps(255.f) ), _mm_set1_ps(0.5f) ) );
+}
+
+NATRON_TARGET_SSE41
+void
+packToBGRA8_sse41(const float* r,
+                  const float* g,
+                  const float* b,
+                  const float* a,
+                  const float* matte,
+                  int count,
+                  U32* dst)
+{
+    int x = 0;
+
+    for (; x + 4 <= count; x += 4) {
+        __m128i uR = floatToInt256_sse41( _mm_loadu_ps(r + x) );
+        __m128i uG = floatToInt256_sse41( _mm_loadu_ps(g + x) );
+        __m128i uB = floatToInt256_sse41( _mm_loadu_ps(b + x) );
+        __m128i uA = floatToInt256_sse41( _mm_loadu_ps(a + x) );
+        if (matte) {
+            __m128i matteA = _mm_srli_epi32(floatToInt256_sse41( _mm_loadu_ps(matte + x) ), 1);
+            uR = _mm_min_epi32( _mm_add_epi32(uR, matteA), _mm_set1_epi32(255) );
+        }
+        __m128i pixels = _mm_or_si128( _mm_or_si128( _mm_slli_epi32(uA, 24), _mm_slli_epi32(uR, 16) ),
+                                       _mm_or_si128( _mm_slli_epi32(uG, 8), uB ) );
+        _mm_storeu_si128( (__m128i*)(dst + x), pixels );
+    }
+    packToBGRA8_scalar(r + x, g + x, b + x, a + x, matte ? matte + x : 0, count - x, dst + x);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 versions, 8 pixels at a time
+
+NATRON_TARGET_AVX2
+inline __m256
+loadChannel_avx2(const float* src,
+                 int nComps,
+                 int channel)
+{
+    if (channel >= nComps) {
+        return _mm256_setzero_ps();
+    }
+    const __m256i indices = _mm256_add_epi32( _mm256_mullo_epi32( _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(nComps) ),
+                                              _mm256_set1_epi32(channel) );
+
+    return _mm256_i32gather_ps(src, indices, 4);
+}
+
+NATRON_TARGET_AVX2
+inline void
+fetchPixels_avx2(const float* src,
+                 int nComps,
+                 int rOffset,
+                 int gOffset,
+                 int bOffset,
+                 bool opaque,
+                 __m256* r,
+                 __m256* g,
+                 __m256* b,
+                 __m256* a)
+{
+    if (nComps == 4) {
+        // p01 holds pixels 0 and 1, etc.
+        __m256 p01 = _mm256_loadu_ps(src);
+        __m256 p23 = _mm256_loadu_ps(src + 8);
+        __m256 p45 = _mm256_loadu_ps(src + 16);
+        __m256 p67 = _mm256_loadu_ps(src + 24);
+        // q0 holds pixels 0 and 4, q1 pixels 1 and 5, etc.
+        __m256 q0 = _mm256_permute2f128_ps(p01, p45, 0x20);
+        __m256 q1 = _mm256_permute2f128_ps(p01, p45, 0x31);
+        __m256 q2 = _mm256_permute2f128_ps(p23, p67, 0x20);
+        __m256 q3 = _mm256_permute2f128_ps(p23, p67, 0x31);
+        // then transpose each 128-bit lane
+        __m256 t0 = _mm256_unpacklo_ps(q0, q1);
+        __m256 t1 = _mm256_unpacklo_ps(q2, q3);
+        __m256 t2 = _mm256_unpackhi_ps(q0, q1);
+        __m256 t3 = _mm256_unpackhi_ps(q2, q3);
+        const __m256 channels[4] = {
+            _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(1, 0, 1, 0) ),
+            _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(3, 2, 3, 2) ),
+            _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(1, 0, 1, 0) ),
+            _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(3, 2, 3, 2) )
+        };
+        *r = channels[rOffset];
+        *g = channels[gOffset];
+        *b = channels[bOffset];
+        *a = opaque ? _mm256_set1_ps(1.f) : channels[3];
+
+        return;
+    }
+    *r = loadChannel_avx2(src, nComps, rOffset);
+    if (nComps == 1) {
+        *g = *b = *r;
+    } else {
+        *g = loadChannel_avx2(src, nComps, gOffset);
+        *b = (nComps > 2) ? loadChannel_avx2(src, nComps, bOffset) : _mm256_setzero_ps();
+    }
+    *a = _mm256_set1_ps(1.f);
+}
+
+NATRON_TARGET_AVX2
+inline void
+storePixels_avx2(__m256 r,
+                 __m256 g,
+                 __m256 b,
+                 __m256 a,
+                 float* dst)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r, g);
+    __m256 t1 = _mm256_unpacklo_ps(b, a);
+    __m256 t2 = _mm256_unpackhi_ps(r, g);
+    __m256 t3 = _mm256_unpackhi_ps(b, a);
+    // o0 holds pixels 0 and 4, o1 pixels 1 and 5, etc.
+    __m256 o0 = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(1, 0, 1, 0) );
+    __m256 o1 = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(3, 2, 3, 2) );
+    __m256 o2 = _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(1, 0, 1, 0) );
+    __m256 o3 = _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(3, 2, 3, 2) );
+
+    _mm256_storeu_ps( dst, _mm256_permute2f128_ps(o0, o1, 0x20) );
+    _mm256_storeu_ps( dst + 8, _mm256_permute2f128_ps(o2, o3, 0x20) );
+    _mm256_storeu_ps( dst + 16, _mm256_permute2f128_ps(o0, o1, 0x31) );
+    _mm256_storeu_ps( dst + 24, _mm256_permute2f128_ps(o2, o3, 0x31) );
+}
+
+NATRON_TARGET_AVX2
+inline __m256d
+luminance_avx2(__m256d r,
+               __m256d g,
+               __m256d b)
+{
+    return _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd(_mm256_set1_pd(0.299), r), _mm256_mul_pd(_mm256_set1_pd(0.587), g) ),
+                          _mm256_mul_pd(_mm256_set1_pd(0.114), b) );
+}
+
+NATRON_TARGET_AVX2
+inline __m256d
+lowToDouble_avx2(__m256 v)
+{
+    return _mm256_cvtps_pd( _mm256_castps256_ps128(v) );
+}
+
+NATRON_TARGET_AVX2
+inline __m256d
+highToDouble_avx2(__m256 v)
+{
+    return _mm256_cvtps_pd( _mm256_extractf128_ps(v, 1) );
+}
+
+NATRON_TARGET_AVX2
+inline __m256
+toFloat_avx2(__m256d low,
+             __m256d high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256( _mm256_cvtpd_ps(low) ), _mm256_cvtpd_ps(high), 1);
+}
+
+NATRON_TARGET_AVX2
+void
+convertRowToFloatTexture_avx2(const float* src,
+                              int nComps,
+                              int rOffset,
+                              int gOffset,
+                              int bOffset,
+                              bool opaque,
+                              bool luminance,
+                              int matteChannel,
+                              int width,
+                              float* dst)
+{
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8, src += 8 * nComps, dst += 32) {
+        __m256 r, g, b, a;
+        fetchPixels_avx2(src, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+
+        if ( luminance || (matteChannel >= 0) ) {
+            __m256d rd[2] = { lowToDouble_avx2(r), highToDouble_avx2(r) };
+            __m256d gd[2] = { lowToDouble_avx2(g), highToDouble_avx2(g) };
+            __m256d bd[2] = { lowToDouble_avx2(b), highToDouble_avx2(b) };
+            const __m256d ad[2] = { lowToDouble_avx2(a), highToDouble_avx2(a) };
+            for (int i = 0; i < 2; ++i) {
+                if (luminance) {
+                    rd[i] = gd[i] = bd[i] = luminance_avx2(rd[i], gd[i], bd[i]);
+                }
+                if (matteChannel >= 0) {
+                    const __m256d channels[4] = { rd[i], gd[i], bd[i], ad[i] };
+                    rd[i] = _mm256_add_pd( rd[i], _mm256_mul_pd(channels[matteChannel], _mm256_set1_pd(0.5)) );
+                }
+            }
+            r = toFloat_avx2(rd[0], rd[1]);
+            g = toFloat_avx2(gd[0], gd[1]);
+            b = toFloat_avx2(bd[0], bd[1]);
+        }
+
+        storePixels_avx2(r, g, b, a, dst);
+    }
+    convertRowToFloatTexture_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel, width - x, dst);
+}
+
+NATRON_TARGET_AVX2
+void
+convertRowToLinear_avx2(const float* src,
+                        int nComps,
+                        int rOffset,
+                        int gOffset,
+                        int bOffset,
+                        bool opaque,
+                        double gain,
+                        double offset,
+                        bool luminance,
+                        int width,
+                        float* rOut,
+                        float* gOut,
+                        float* bOut,
+                        float* aOut)
+{
+    const __m256d gainv = _mm256_set1_pd(gain);
+    const __m256d offsetv = _mm256_set1_pd(offset);
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8, src += 8 * nComps) {
+        __m256 r, g, b, a;
+        fetchPixels_avx2(src, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+
+        __m256d rd[2] = { lowToDouble_avx2(r), highToDouble_avx2(r) };
+        __m256d gd[2] = { lowToDouble_avx2(g), highToDouble_avx2(g) };
+        __m256d bd[2] = { lowToDouble_avx2(b), highToDouble_avx2(b) };
+        for (int i = 0; i < 2; ++i) {
+            rd[i] = _mm256_add_pd(_mm256_mul_pd(rd[i], gainv), offsetv);
+            gd[i] = _mm256_add_pd(_mm256_mul_pd(gd[i], gainv), offsetv);
+            bd[i] = _mm256_add_pd(_mm256_mul_pd(bd[i], gainv), offsetv);
+            if (luminance) {
+                rd[i] = gd[i] = bd[i] = luminance_avx2(rd[i], gd[i], bd[i]);
+            }
+        }
+        _mm256_storeu_ps( rOut + x, toFloat_avx2(rd[0], rd[1]) );
+        _mm256_storeu_ps( gOut + x, toFloat_avx2(gd[0], gd[1]) );
+        _mm256_storeu_ps( bOut + x, toFloat_avx2(bd[0], bd[1]) );
+        _mm256_storeu_ps(aOut + x, a);
+    }
+    convertRowToLinear_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, gain, offset, luminance, width - x,
+                              rOut + x, gOut + x, bOut + x, aOut + x);
+}
+
+NATRON_TARGET_AVX2
+void
+applyGammaLut_avx2(const float* lut,
+                   int lutMaxIndex,
+                   int count,
+                   float* values)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 scale = _mm256_set1_ps( (float)lutMaxIndex );
+    const __m256i maxIndex = _mm256_set1_epi32(lutMaxIndex);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8) {
+        __m256 v = _mm256_loadu_ps(values + x);
+        __m256 scaled = _mm256_mul_ps(v, scale);
+        // clamping the index also protects from NaNs
+        __m256i i = _mm256_min_epi32( _mm256_max_epi32( _mm256_cvttps_epi32(scaled), _mm256_setzero_si256() ), maxIndex );
+        __m256 alpha = _mm256_max_ps( _mm256_min_ps(_mm256_sub_ps( scaled, _mm256_cvtepi32_ps(i) ), one), zero );
+        __m256 a = _mm256_i32gather_ps(lut, i, 4);
+        // when i == lutMaxIndex, alpha is 0 and the next value does not matter
+        __m256 b = _mm256_i32gather_ps(lut, _mm256_min_epi32( _mm256_add_epi32( i, _mm256_set1_epi32(1) ), maxIndex ), 4);
+        __m256 result = _mm256_add_ps( _mm256_mul_ps( a, _mm256_sub_ps(one, alpha) ), _mm256_mul_ps(b, alpha) );
+        result = _mm256_blendv_ps( result, zero, _mm256_cmp_ps(v, zero, _CMP_LT_OQ) );
+        result = _mm256_blendv_ps( result, one, _mm256_cmp_ps(v, one, _CMP_GT_OQ) );
+        _mm256_storeu_ps(values + x, result);
+    }
+    applyGammaLut_scalar(lut, lutMaxIndex, count - x, values + x);
+}
+
+NATRON_TARGET_AVX2
+void
+applyLuminance_avx2(int count,
+                    float* r,
+                    float* g,
+                    float* b)
+{
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8) {
+        __m256 rv = _mm256_loadu_ps(r + x);
+        __m256 gv = _mm256_loadu_ps(g + x);
+        __m256 bv = _mm256_loadu_ps(b + x);
+        __m256 l = toFloat_avx2( luminance_avx2( lowToDouble_avx2(rv), lowToDouble_avx2(gv), lowToDouble_avx2(bv) ),
+                                 luminance_avx2( highToDouble_avx2(rv), highToDouble_avx2(gv), highToDouble_avx2(bv) ) );
+        _mm256_storeu_ps(r + x, l);
+        _mm256_storeu_ps(g + x, l);
+        _mm256_storeu_ps(b + x, l);
+    }
+    applyLuminance_scalar(count - x, r + x, g + x, b + x);
+}
+
+// Same as Color::floatToInt<256>
+NATRON_TARGET_AVX2
+inline __m256i
+floatToInt256_avx2(__m256 v)
+{
+    // _mm256_max_ps returns its second operand if the first one is NaN
+    v = _mm256_min_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps(1.f) );
+
+    return _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( v, _mm256_set1_ps(255.f) ), _mm256_set1_ps(0.5f) ) );
+}
+
+NATRON_TARGET_AVX2
+void
+packToBGRA8_avx2(const float* r,
+                 const float* g,
+                 const float* b,
+                 const float* a,
+                 const float* matte,
+                 int count,
+                 U32* dst)
+{
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8) {
+        __m256i uR = floatToInt256_avx2( _mm256_loadu_ps(r + x) );
+        __m256i uG = floatToInt256_avx2( _mm256_loadu_ps(g + x) );
+        __m256i uB = floatToInt256_avx2( _mm256_loadu_ps(b + x) );
+        __m256i uA = floatToInt256_avx2( _mm256_loadu_ps(a + x) );
+        if (matte) {
+            __m256i matteA = _mm256_srli_epi32(floatToInt256_avx2( _mm256_loadu_ps(matte + x) ), 1);
+            uR = _mm256_min_epi32( _mm256_add_epi32(uR, matteA), _mm256_set1_epi32(255) );
+        }
+        __m256i pixels = _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi32(uA, 24), _mm256_slli_epi32(uR, 16) ),
+                                          _mm256_or_si256( _mm256_slli_epi32(uG, 8), uB ) );
+        _mm256_storeu_si256( (__m256i*)(dst + x), pixels );
+    }
+    packToBGRA8_scalar(r + x, g + x, b + x, a + x, matte ? matte + x : 0, count - x, dst + x);
+}
+
+#endif // NATRON_KERNELS_X86
+} // anon namespace
+
+void
+convertRowToFloatTexture(const float* src,
+                         int nComps,
+                         int rOffset,
+                         int gOffset,
+                         int bOffset,
+                         bool opaque,
+                         bool luminance,
+                         int matteChannel,
+                         int width,
+                         float* dst)
+{
+    assert(nComps >= 1 && nComps <= 4 && matteChannel <= 3);
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertRowToFloatTexture_avx2(src, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel, width, dst);
+        break;
+    case eInstructionSetSSE41:
+        convertRowToFloatTexture_sse41(src, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel, width, dst);
+        break;
+#endif
+    default:
+        convertRowToFloatTexture_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, luminance, matteChannel, width, dst);
+        break;
+    }
+}
+
+void
+convertRowToLinear(const float* src,
+                   int nComps,
+                   int rOffset,
+                   int gOffset,
+                   int bOffset,
+                   bool opaque,
+                   double gain,
+                   double offset,
+                   bool luminance,
+                   int width,
+                   float* r,
+                   float* g,
+                   float* b,
+                   float* a)
+{
+    assert(nComps >= 1 && nComps <= 4);
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        convertRowToLinear_avx2(src, nComps, rOffset, gOffset, bOffset, opaque, gain, offset, luminance, width, r, g, b, a);
+        break;
+    case eInstructionSetSSE41:
+        convertRowToLinear_sse41(src, nComps, rOffset, gOffset, bOffset, opaque, gain, offset, luminance, width, r, g, b, a);
+        break;
+#endif
+    default:
+        convertRowToLinear_scalar(src, nComps, rOffset, gOffset, bOffset, opaque, gain, offset, luminance, width, r, g, b, a);
+        break;
+    }
+}
+
+void
+applyGammaLut(const float* lut,
+              int lutMaxIndex,
+              int count,
+              float* values)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        applyGammaLut_avx2(lut, lutMaxIndex, count, values);
+        break;
+    case eInstructionSetSSE41:
+        applyGammaLut_sse41(lut, lutMaxIndex, count, values);
+        break;
+#endif
+    default:
+        applyGammaLut_scalar(lut, lutMaxIndex, count, values);
+        break;
+    }
+}
+
+void
+applyLuminance(int count,
+               float* r,
+               float* g,
+               float* b)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        applyLuminance_avx2(count, r, g, b);
+        break;
+    case eInstructionSetSSE41:
+        applyLuminance_sse41(count, r, g, b);
+        break;
+#endif
+    default:
+        applyLuminance_scalar(count, r, g, b);
+        break;
+    }
+}
+
+void
+packToBGRA8(const float* r,
+            const float* g,
+            const float* b,
+            const float* a,
+            const float* matte,
+            int count,
+            U32* dst)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_KERNELS_X86
+    case eInstructionSetAVX2:
+        packToBGRA8_avx2(r, g, b, a, matte, count, dst);
+        break;
+    case eInstructionSetSSE41:
+        packToBGRA8_sse41(r, g, b, a, matte, count, dst);
+        break;
+#endif
+    default:
+        packToBGRA8_scalar(r, g, b, a, matte, count, dst);
+        break;
+    }
+}
+} // namespace ViewerTextureKernels
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,119 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_VIEWERTEXTUREKERNELS_H
+#define NATRON_ENGINE_VIEWERTEXTUREKERNELS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+#include "Engine/InstructionSet.h"
+
+NATRON_NAMESPACE_ENTER
+
+/*
+ * Scan-line kernels used by the viewer to convert float images to the 8-bit and 32-bit float
+ * textures. Each kernel has a scalar implementation and SSE4.1/AVX2 implementations selected
+ * at runtime with getInstructionSet(). All implementations give bit-exact identical results:
+ * the computations that the scalar viewer code does in double precision are done in double
+ * precision in the vector code too.
+ *
+ * Source pixels are interleaved with nComps (1 to 4) components. The displayed channels are
+ * selected with rOffset, gOffset, bOffset: an offset greater or equal to nComps reads 0.
+ * The alpha is 1 if opaque or if there are less than 4 components.
+ */
+namespace ViewerTextureKernels {
+/**
+ * @brief Fills width RGBA pixels of the 32-bit float texture.
+ * If luminance is true, r, g and b are replaced by the luminance 0.299 r + 0.587 g + 0.114 b.
+ * If matteChannel is in [0,3], half of that channel (after the luminance conversion) is added to r.
+ **/
+void convertRowToFloatTexture(const float* src,
+                              int nComps,
+                              int rOffset,
+                              int gOffset,
+                              int bOffset,
+                              bool opaque,
+                              bool luminance,
+                              int matteChannel,
+                              int width,
+                              float* dst);
+
+/**
+ * @brief Applies gain and offset to the selected channels of width pixels and writes them in
+ * separate buffers. If luminance is true, r, g and b are replaced by the luminance of the result.
+ * The alpha is not modified.
+ **/
+void convertRowToLinear(const float* src,
+                        int nComps,
+                        int rOffset,
+                        int gOffset,
+                        int bOffset,
+                        bool opaque,
+                        double gain,
+                        double offset,
+                        bool luminance,
+                        int width,
+                        float* r,
+                        float* g,
+                        float* b,
+                        float* a);
+
+/**
+ * @brief Maps count values in place through the gamma look-up table, which has lutMaxIndex + 1 entries
+ * linearly interpolated between 0 and 1.
+ **/
+void applyGammaLut(const float* lut,
+                   int lutMaxIndex,
+                   int count,
+                   float* values);
+
+/**
+ * @brief Replaces r, g and b by their luminance.
+ **/
+void applyLuminance(int count,
+                    float* r,
+                    float* g,
+                    float* b);
+
+/**
+ * @brief Quantizes r, g, b and a to 8 bits without colorspace conversion and packs them in the
+ * BGRA texture. If matte is not NULL, half of it is added to the red channel.
+ **/
+void packToBGRA8(const float* r,
+                 const float* g,
+                 const float* b,
+                 const float* a,
+                 const float* matte,
+                 int count,
+                 U32* dst);
+} // namespace ViewerTextureKernels
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_VIEWERTEXTUREKERNELS_H
@@ -239,6 +239,16 @@ CurveGui::getCurveYRange() const
     return getInternalCurve()->getCurveYRange();
 }
 
+void
+CurveGui::evaluateAll(const std::vector<double>& x,
+                      std::vector<double>* y) const
+{
+    y->resize( x.size() );
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        (*y)[i] = evaluate(false, x[i]);
+    }
+}
+
 CurvePtr
 CurveGui::getInternalCurve() const
 {
@@ -342,27 +352,40 @@ CurveGui::drawCurve(int curveIndex,
             KeyFrame x1Key;
             KeyFrameSet::const_iterator lastUpperIt = keyframes.end();
 
+            // The points which are not keyframes are evaluated at once, which locks the curve only once
+            std::vector<double> xs, ys;
+            std::vector<std::size_t> evaluatedVertices;
+
             while ( x1 < (widgetWidth - 1) ) {
-                double x, y;
+                double x;
                 if (!isX1AKey) {
                     x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                    y = evaluate(false, x);
+                    evaluatedVertices.push_back( vertices.size() );
+                    xs.push_back(x);
+                    vertices.push_back( (float)x );
+                    vertices.push_back(0.f);
                 } else {
                     x = x1Key.getTime();
-                    y = x1Key.getValue();
+                    vertices.push_back( (float)x );
+                    vertices.push_back( (float)x1Key.getValue() );
                 }
 
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
                 nextPointForSegment(x, keyframes, isPeriodic, parametricRange.first, parametricRange.second,  &lastUpperIt, &x2, &x1Key, &isX1AKey);
                 x1 = x2;
             }
             //also add the last point
             {
                 double x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                double y = evaluate(false, x);
+                evaluatedVertices.push_back( vertices.size() );
+                xs.push_back(x);
                 vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+                vertices.push_back(0.f);
+            }
+
+            evaluateAll(xs, &ys);
+            assert( ys.size() == evaluatedVertices.size() );
+            for (std::size_t i = 0; i < evaluatedVertices.size(); ++i) {
+                vertices[evaluatedVertices[i] + 1] = (float)ys[i];
             }
         } catch (...) {
         }
@@ -674,6 +697,16 @@ KnobCurveGui::evaluate(bool useExpr,
     }
 }
 
+void
+KnobCurveGui::evaluateAll(const std::vector<double>& x,
+                          std::vector<double>* y) const
+{
+    CurvePtr curve = getInternalCurve();
+
+    assert(curve);
+    curve->getValuesAt(x, false, y);
+}
+
 CurvePtr
 KnobCurveGui::getInternalCurve() const
 {
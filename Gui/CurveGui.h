@@ -27,6 +27,8 @@
 
 #include "Global/Macros.h"
 
+#include <vector>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
@@ -121,6 +123,11 @@ public:
      * The coordinates are those of the curve, not of the widget.
      **/
     virtual double evaluate(bool useExpr, double x) const = 0;
+
+    /**
+     * @brief Same as evaluate(false, x) for each of the given x, in increasing order.
+     **/
+    virtual void evaluateAll(const std::vector<double>& x, std::vector<double>* y) const;
     virtual CurvePtr  getInternalCurve() const;
 
     void drawCurve(int curveIndex, int curvesCount);
@@ -200,6 +207,7 @@ public:
     }
 
     virtual double evaluate(bool useExpr, double x) const OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual void evaluateAll(const std::vector<double>& x, std::vector<double>* y) const OVERRIDE FINAL;
     RotoContextPtr getRotoContext() const { return _roto; }
 
     KnobIPtr getInternalKnob() const;
@@ -310,6 +310,10 @@ public:
 
     void saveProjectGui(boost::archive::xml_oarchive & archive);
 
+    void loadProjectGui(bool isAutosave, boost::archive::binary_iarchive & obj) const;
+
+    void saveProjectGui(boost::archive::binary_oarchive & archive);
+
     void setColorPickersColor(double r, double g, double b, double a);
 
     void registerNewColorPicker(KnobColorPtr knob);
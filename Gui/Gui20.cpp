@@ -1460,6 +1460,20 @@ Gui::saveProjectGui(boost::archive::xml_oarchive & archive)
     _imp->_projectGui->save(archive);
 }
 
+void
+Gui::loadProjectGui(bool isAutosave, boost::archive::binary_iarchive & obj) const
+{
+    assert(_imp->_projectGui);
+    _imp->_projectGui->load(isAutosave, obj);
+}
+
+void
+Gui::saveProjectGui(boost::archive::binary_oarchive & archive)
+{
+    assert(_imp->_projectGui);
+    _imp->_projectGui->save(archive);
+}
+
 bool
 Gui::isAboutToClose() const
 {
@@ -815,6 +815,20 @@ GuiAppInstance::saveProjectGui(boost::archive::xml_oarchive & archive)
     }
 }
 
+void
+GuiAppInstance::loadProjectGui(bool isAutosave, boost::archive::binary_iarchive & archive) const
+{
+    _imp->_gui->loadProjectGui(isAutosave, archive);
+}
+
+void
+GuiAppInstance::saveProjectGui(boost::archive::binary_oarchive & archive)
+{
+    if (_imp->_gui) {
+        _imp->_gui->saveProjectGui(archive);
+    }
+}
+
 void
 GuiAppInstance::setupViewersForViews(const std::vector<std::string>& viewNames)
 {
@@ -262,9 +262,9 @@ AddFormatDialog::getFormat() const
 }
 
 // Version is handled in ProjectGuiSerialization
-template<>
+template<class Archive>
 void
-ProjectGui::save<boost::archive::xml_oarchive>(boost::archive::xml_oarchive & archive) const
+ProjectGui::save(Archive & archive) const
 {
     ProjectGuiSerialization projectGuiSerializationObj;
 
@@ -430,9 +430,9 @@ loadNodeGuiSerialization(Gui* gui,
     }
 } // loadNodeGuiSerialization
 
-template<>
+template<class Archive>
 void
-ProjectGui::load<boost::archive::xml_iarchive>(bool isAutosave,  boost::archive::xml_iarchive & archive)
+ProjectGui::load(bool isAutosave,  Archive & archive)
 {
     ProjectGuiSerialization obj;
 
@@ -589,6 +589,11 @@ ProjectGui::load<boost::archive::xml_iarchive>(bool isAutosave,  boost::archive:
     _gui->centerAllNodeGraphsWithTimer();
 } // load
 
+template void ProjectGui::save<boost::archive::xml_oarchive>(boost::archive::xml_oarchive & archive) const;
+template void ProjectGui::save<boost::archive::binary_oarchive>(boost::archive::binary_oarchive & archive) const;
+template void ProjectGui::load<boost::archive::xml_iarchive>(bool isAutosave, boost::archive::xml_iarchive & archive);
+template void ProjectGui::load<boost::archive::binary_iarchive>(bool isAutosave, boost::archive::binary_iarchive & archive);
+
 NodesGuiList
 ProjectGui::getVisibleNodes() const
 {
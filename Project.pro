@@ -31,7 +31,6 @@ SUBDIRS += \
     openMVG \
     qhttpserver \
     hoedown \
-    libtess \
     Engine \
     Renderer \
     Gui \
@@ -47,14 +46,13 @@ libmv.subdir       = libs/libmv
 openMVG.subdir     = libs/openMVG
 qhttpserver.subdir = libs/qhttpserver
 hoedown.subdir     = libs/hoedown
-libtess.subdir     = libs/libtess
 
 # what subproject depends on others
 glog.depends = gflags
 ceres.depends = glog gflags
 libmv.depends = gflags ceres
 openMVG.depends = ceres
-Engine.depends = libmv openMVG HostSupport libtess ceres
+Engine.depends = libmv openMVG HostSupport ceres
 Renderer.depends = Engine
 Gui.depends = Engine qhttpserver
 Tests.depends = Gui Engine
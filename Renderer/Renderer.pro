@@ -25,7 +25,7 @@ CONFIG += console
 CONFIG -= app_bundle
 CONFIG += moc
 CONFIG += boost boost-serialization-lib qt cairo python shiboken pyside 
-CONFIG += static-engine static-host-support static-breakpadclient static-libmv static-openmvg static-ceres static-libtess
+CONFIG += static-engine static-host-support static-breakpadclient static-libmv static-openmvg static-ceres
 
 !noexpat: CONFIG += expat
 
@@ -24,11 +24,18 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "BaseTest.h"
 
+#include <QtCore/QDir>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
 #include <QtCore/QThreadPool>
 
 // ofxhPropertySuite.h:565:37: warning: 'this' pointer cannot be null in well-defined C++ code; comparison may be assumed to always evaluate to true [-Wtautological-undefined-compare]
@@ -43,16 +50,23 @@ CLANG_DIAG_OFF(tautological-undefined-compare) // appeared in clang 3.5
 CLANG_DIAG_ON(tautological-undefined-compare)
 CLANG_DIAG_ON(unknown-pragmas)
 
+#include "Engine/AbortableRenderInfo.h"
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/Node.h"
 #include "Engine/Project.h"
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
+#include "Engine/Bezier.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Plugin.h"
+#include "Engine/RotoContext.h"
 #include "Engine/Curve.h"
 #include "Engine/CLArgs.h"
+#include "Engine/Settings.h"
+#include "Engine/Timer.h"
+#include "Engine/TrackMarker.h"
+#include "Engine/TrackerContext.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
@@ -320,3 +334,415 @@ TEST_F(BaseTest, SimpleNodeConnections) {
     disconnectNodes(generator, writer, false);
     connectNodes(generator, writer, 0, true);
 }
+
+namespace {
+// Sets back the value a choice knob had when the object was created, even if the test fails and returns early
+class RestoreChoiceOnExit
+{
+public:
+
+    explicit RestoreChoiceOnExit(const KnobChoicePtr & knob)
+        : _knob(knob)
+        , _value( knob->getValue() )
+    {
+    }
+
+    ~RestoreChoiceOnExit()
+    {
+        _knob->setValue(_value);
+    }
+
+private:
+
+    KnobChoicePtr _knob;
+    int _value;
+};
+} // anon namespace
+
+///Saves and loads a large project in each project file format, checks that it round-trips and reports the timings
+TEST_F(BaseTest, ProjectFileFormats)
+{
+    const int nNodes = 300;
+    const int nKeys = 100;
+    std::map<std::string, double> expectedValues;
+
+    for (int i = 0; i < nNodes; ++i) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        KnobDoublePtr knob = generator->getKnobByNameAndType<KnobDouble>("noiseZSlope");
+        ASSERT_TRUE(knob);
+        for (int k = 0; k < nKeys; ++k) {
+            knob->setValueAtTime(k, i + k * 0.01, ViewSpec::all(), 0);
+        }
+        expectedValues[generator->getScriptName()] = knob->getValueAtTime(nKeys / 2.5);
+    }
+
+    ProjectPtr project = getApp()->getProject();
+    KnobChoicePtr formatKnob = appPTR->getCurrentSettings()->getKnobByNameAndType<KnobChoice>("projectFileFormat");
+    ASSERT_TRUE(formatKnob);
+    // The setting is global: the following tests must use the default format
+    RestoreChoiceOnExit restoreFormat(formatKnob);
+    QString path = QDir::tempPath() + QLatin1Char('/');
+    const char* formatNames[] = { "xml", "binary", "compressed" };
+
+    for (int format = 0; format < 3; ++format) {
+        formatKnob->setValue(format);
+        QString name = QString::fromUtf8("ProjectFileFormats_Test_%1.ntp").arg( QString::fromUtf8(formatNames[format]) );
+
+        TimeLapse saveTimer;
+        project->saveProject(path, name, 0);
+        double saveTime = saveTimer.getTimeSinceCreation();
+
+        TimeLapse loadTimer;
+        EXPECT_TRUE( project->loadProject(path, name) );
+        double loadTime = loadTimer.getTimeSinceCreation();
+
+        std::cout << "ProjectFileFormats: " << formatNames[format] << ": " << QFileInfo(path + name).size() << " bytes, saved in "
+                  << saveTime << "s, loaded in " << loadTime << "s" << std::endl;
+
+        NodesList nodes = project->getNodes();
+        EXPECT_EQ( nNodes, (int)nodes.size() );
+        for (NodesList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            std::map<std::string, double>::iterator found = expectedValues.find( (*it)->getScriptName() );
+            ASSERT_TRUE( found != expectedValues.end() );
+            KnobDoublePtr knob = (*it)->getKnobByNameAndType<KnobDouble>("noiseZSlope");
+            ASSERT_TRUE(knob);
+            EXPECT_EQ( nKeys, knob->getKeyFramesCount(ViewSpec::current(), 0) );
+            EXPECT_DOUBLE_EQ( found->second, knob->getValueAtTime(nKeys / 2.5) );
+        }
+        QFile::remove(path + name);
+    }
+
+    project->reset(false, true);
+}
+
+///Auto-saves append the nodes changed since the previous auto-save to a journal, from which the whole project is recovered
+TEST_F(BaseTest, AutoSaveJournal)
+{
+    const int nNodes = 50;
+    std::vector<std::string> names;
+
+    for (int i = 0; i < nNodes; ++i) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        names.push_back( generator->getScriptName() );
+    }
+
+    ProjectPtr project = getApp()->getProject();
+    QString path = QDir::tempPath();
+    QString name = QString::fromUtf8("AutoSaveJournal_Test.ntp");
+    QString snapshotFilePath;
+    project->saveProject_imp(path, name, true, true, &snapshotFilePath);
+    ASSERT_TRUE( QFile::exists(snapshotFilePath) );
+    qint64 snapshotSize = QFileInfo(snapshotFilePath).size();
+
+    // Only the changed node is appended to the journal
+    KnobDoublePtr knob = getApp()->getNodeByFullySpecifiedName(names[0])->getKnobByNameAndType<KnobDouble>("noiseZSlope");
+    ASSERT_TRUE(knob);
+    knob->setValue(0.25);
+    QString recordFilePath;
+    project->saveProject_imp(path, name, true, true, &recordFilePath);
+    EXPECT_EQ(snapshotFilePath, recordFilePath);
+    qint64 recordSize = QFileInfo(recordFilePath).size() - snapshotSize;
+    EXPECT_GT(recordSize, 0);
+    EXPECT_LT(recordSize * 10, snapshotSize);
+    std::cout << "AutoSaveJournal: snapshot of " << nNodes << " nodes: " << snapshotSize << " bytes, record of 1 node: "
+              << recordSize << " bytes" << std::endl;
+
+    // Remove a node and rename another
+    getApp()->getNodeByFullySpecifiedName(names[1])->deactivate();
+    getApp()->getNodeByFullySpecifiedName(names[2])->setScriptName("AutoSaveJournalRenamed");
+    project->saveProject_imp(path, name, true, true, &recordFilePath);
+    EXPECT_EQ(snapshotFilePath, recordFilePath);
+
+    // Recover the project from the journal
+    QFileInfo journalInfo(recordFilePath);
+    EXPECT_TRUE( project->loadProject(journalInfo.path() + QLatin1Char('/'), journalInfo.fileName()) );
+    EXPECT_EQ( nNodes - 1, (int)project->getNodes().size() );
+    NodePtr changedNode = getApp()->getNodeByFullySpecifiedName(names[0]);
+    ASSERT_TRUE(changedNode);
+    EXPECT_EQ( 0.25, changedNode->getKnobByNameAndType<KnobDouble>("noiseZSlope")->getValue() );
+    EXPECT_FALSE( getApp()->getNodeByFullySpecifiedName(names[1]) );
+    EXPECT_FALSE( getApp()->getNodeByFullySpecifiedName(names[2]) );
+    EXPECT_TRUE( getApp()->getNodeByFullySpecifiedName("AutoSaveJournalRenamed") );
+
+    QFile::remove(recordFilePath);
+    project->reset(false, true);
+}
+
+///Track results and markers added since the previous auto-save are recovered from the journal
+TEST_F(BaseTest, AutoSaveJournalTracker)
+{
+    const int nFrames = 10;
+    NodePtr tracker = createNode( QString::fromUtf8(PLUGINID_NATRON_TRACKER) );
+    ASSERT_TRUE(tracker);
+    std::string trackerName = tracker->getScriptName();
+    TrackerContextPtr context = tracker->getTrackerContext();
+    ASSERT_TRUE(context);
+    TrackMarkerPtr trackedMarker = context->createMarker();
+    ASSERT_TRUE(trackedMarker);
+    std::string trackedMarkerName = trackedMarker->getScriptName_mt_safe();
+
+    ProjectPtr project = getApp()->getProject();
+    QString path = QDir::tempPath();
+    QString name = QString::fromUtf8("AutoSaveJournalTracker_Test.ntp");
+    QString snapshotFilePath;
+    project->saveProject_imp(path, name, true, true, &snapshotFilePath);
+    ASSERT_TRUE( QFile::exists(snapshotFilePath) );
+
+    // Set the results of a track on the existing marker, the same way the tracker does, and add a marker
+    KnobDoublePtr center = trackedMarker->getCenterKnob();
+    for (int i = 0; i < nFrames; ++i) {
+        center->setValueAtTime(i, 100. + i, ViewSpec::current(), 0);
+        center->setValueAtTime(i, 200. - i, ViewSpec::current(), 1);
+    }
+    trackedMarker->setUserKeyframe(0);
+    TrackMarkerPtr newMarker = context->createMarker();
+    ASSERT_TRUE(newMarker);
+    std::string newMarkerName = newMarker->getScriptName_mt_safe();
+
+    QString recordFilePath;
+    project->saveProject_imp(path, name, true, true, &recordFilePath);
+    EXPECT_EQ(snapshotFilePath, recordFilePath);
+
+    // Recover the project from the journal
+    QFileInfo journalInfo(recordFilePath);
+    EXPECT_TRUE( project->loadProject(journalInfo.path() + QLatin1Char('/'), journalInfo.fileName()) );
+    NodePtr recoveredTracker = getApp()->getNodeByFullySpecifiedName(trackerName);
+    ASSERT_TRUE(recoveredTracker);
+    TrackerContextPtr recoveredContext = recoveredTracker->getTrackerContext();
+    ASSERT_TRUE(recoveredContext);
+    TrackMarkerPtr recoveredMarker = recoveredContext->getMarkerByName(trackedMarkerName);
+    ASSERT_TRUE(recoveredMarker);
+    KnobDoublePtr recoveredCenter = recoveredMarker->getCenterKnob();
+    EXPECT_EQ( nFrames, recoveredCenter->getKeyFramesCount(ViewSpec::current(), 0) );
+    EXPECT_EQ( nFrames, recoveredCenter->getKeyFramesCount(ViewSpec::current(), 1) );
+    EXPECT_DOUBLE_EQ( 105., recoveredCenter->getValueAtTime(5, 0) );
+    EXPECT_DOUBLE_EQ( 195., recoveredCenter->getValueAtTime(5, 1) );
+    EXPECT_TRUE( recoveredMarker->isUserKeyframe(0) );
+    EXPECT_TRUE( recoveredContext->getMarkerByName(newMarkerName) );
+
+    QFile::remove(recordFilePath);
+    project->reset(false, true);
+}
+
+///Creates a few nodes in the project and checks that they are found by name after renames
+TEST_F(BaseTest, NodeNameIndex)
+{
+    const int nNodes = 20;
+    ProjectPtr project = getApp()->getProject();
+    std::vector<NodePtr> nodes;
+
+    for (int i = 0; i < nNodes; ++i) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        nodes.push_back(generator);
+    }
+
+    std::set<std::string> names;
+    for (int i = 0; i < nNodes; ++i) {
+        const std::string& name = nodes[i]->getScriptName();
+        EXPECT_TRUE( names.insert(name).second ) << name;
+        EXPECT_EQ( nodes[i], project->getNodeByName(name) );
+        EXPECT_TRUE( project->checkIfNodeNameExists(name, 0) );
+        EXPECT_FALSE( project->checkIfNodeNameExists(name, nodes[i].get()) );
+    }
+
+    // Renames and label changes update the index
+    std::string oldName = nodes[1]->getScriptName();
+    nodes[1]->setScriptName("NodeNameIndexRenamed");
+    EXPECT_EQ( nodes[1], project->getNodeByName("NodeNameIndexRenamed") );
+    EXPECT_FALSE( project->getNodeByName(oldName) );
+    nodes[2]->setLabel("NodeNameIndexLabel");
+    EXPECT_TRUE( project->checkIfNodeLabelExists("NodeNameIndexLabel", 0) );
+    EXPECT_FALSE( project->checkIfNodeLabelExists("NodeNameIndexLabel", nodes[2].get()) );
+
+    // The name released by the rename is given to the next node
+    NodePtr newNode = createNode(_generatorPluginID);
+    ASSERT_TRUE(newNode);
+    EXPECT_EQ( oldName, newNode->getScriptName() );
+    EXPECT_EQ( newNode, project->getNodeByName(oldName) );
+
+    project->reset(false, true);
+}
+
+///Creates many nodes in the project and reports the timings of the creations and of the look-ups by name.
+///Disabled by default, run it with --gtest_also_run_disabled_tests --gtest_filter=BaseTest.DISABLED_NodeNameIndexBenchmark
+TEST_F(BaseTest, DISABLED_NodeNameIndexBenchmark)
+{
+    const int nNodes = 10000;
+    ProjectPtr project = getApp()->getProject();
+    std::vector<NodePtr> nodes;
+
+    TimeLapse createTimer;
+    for (int i = 0; i < nNodes; ++i) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        nodes.push_back(generator);
+    }
+    double createTime = createTimer.getTimeSinceCreation();
+
+    TimeLapse lookUpTimer;
+    int nFound = 0;
+    for (int i = 0; i < nNodes; ++i) {
+        const std::string& name = nodes[i]->getScriptName();
+        if ( project->getNodeByName(name) && project->checkIfNodeNameExists(name, 0) &&
+             !project->checkIfNodeNameExists(name, nodes[i].get()) ) {
+            ++nFound;
+        }
+    }
+    double lookUpTime = lookUpTimer.getTimeSinceCreation();
+    EXPECT_EQ(nNodes, nFound);
+
+    std::cout << "NodeNameIndex: " << nNodes << " nodes created in " << createTime << " s, "
+              << 3 * nNodes << " look-ups in " << lookUpTime << " s" << std::endl;
+
+    project->reset(false, true);
+}
+
+namespace {
+double
+getShapeLeft(const BezierShape & shape)
+{
+    double left = shape.polygon.front().x;
+
+    for (std::size_t i = 1; i < shape.polygon.size(); ++i) {
+        left = std::min(left, shape.polygon[i].x);
+    }
+
+    return left;
+}
+} // anon namespace
+
+///Checks that the shapes cached by Bezier::getShapeAtTime() are computed again when the bezier is modified
+TEST_F(BaseTest, BezierShapeCache)
+{
+    NodePtr roto = createNode( QString::fromUtf8(PLUGINID_NATRON_ROTO) );
+    ASSERT_TRUE(roto);
+    RotoContextPtr context = roto->getRotoContext();
+    ASSERT_TRUE(context);
+    BezierPtr square = context->makeSquare(0, 100, 100, 0);
+    ASSERT_TRUE(square);
+
+    BezierShapePtr shape = square->getShapeAtTime(0, 0);
+    ASSERT_TRUE( shape && !shape->polygon.empty() );
+    EXPECT_EQ( shape, square->getShapeAtTime(0, 0) );
+    // Each mipmap level has its own shape
+    EXPECT_NE( shape, square->getShapeAtTime(0, 1) );
+
+    // Moving the top-left control point to the left moves the left of the polygon
+    square->movePointByIndex(0, 0, -10, 0);
+    BezierShapePtr movedShape = square->getShapeAtTime(0, 0);
+    ASSERT_TRUE( movedShape && !movedShape->polygon.empty() );
+    EXPECT_NE(shape, movedShape);
+    EXPECT_LT( getShapeLeft(*movedShape), getShapeLeft(*shape) - 5 );
+    EXPECT_EQ( movedShape, square->getShapeAtTime(0, 0) );
+
+    // Changing a knob of the bezier
+    KnobDoublePtr featherKnob = square->getFeatherKnob();
+    ASSERT_TRUE(featherKnob);
+    featherKnob->setValue(featherKnob->getValue() + 10.);
+    BezierShapePtr featheredShape = square->getShapeAtTime(0, 0);
+    EXPECT_NE(movedShape, featheredShape);
+    ASSERT_EQ( movedShape->featherOuter.size(), featheredShape->featherOuter.size() );
+    bool featherChanged = false;
+    for (std::size_t i = 0; i < featheredShape->featherOuter.size() && !featherChanged; ++i) {
+        featherChanged = (featheredShape->featherOuter[i].x != movedShape->featherOuter[i].x) ||
+                         (featheredShape->featherOuter[i].y != movedShape->featherOuter[i].y);
+    }
+    EXPECT_TRUE(featherChanged);
+}
+
+namespace {
+// Reads a knob like a render thread of its node does, that is from the snapshot of the knobs of the node
+class ReadKnobInRenderThread
+    : public QThread
+{
+public:
+
+    ReadKnobInRenderThread(const NodePtr & node,
+                           const KnobDoublePtr & knob,
+                           double time)
+        : QThread()
+        , _node(node)
+        , _knob(knob)
+        , _time(time)
+        , _value(0.)
+    {
+    }
+
+    double getValue() const
+    {
+        return _value;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        EffectInstancePtr effect = _node->getEffectInstance();
+
+        effect->setParallelRenderArgsTLS(_time, ViewIdx(0), false, false, 0, AbortableRenderInfo::create(), _node, 1,
+                                         NodeFrameRequestPtr(), OSGLContextPtr(), 0, 0, false, false, NodesList(),
+                                         eRenderSafetyFullySafe, ePluginOpenGLRenderSupportNone, false, false, RenderStatsPtr() );
+        _value = _knob->getValueAtTime(_time);
+        effect->invalidateParallelRenderArgsTLS();
+    }
+
+    NodePtr _node;
+    KnobDoublePtr _knob;
+    double _time;
+    double _value;
+};
+
+double
+readKnobInRender(const NodePtr & node,
+                 const KnobDoublePtr & knob,
+                 double time)
+{
+    ReadKnobInRenderThread thread(node, knob, time);
+
+    thread.start();
+    thread.wait();
+
+    return thread.getValue();
+}
+} // anon namespace
+
+///Checks that the renders following a clone of a knob do not read the values of the snapshot taken before
+TEST_F(BaseTest, KnobsSnapshotAfterClone)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr source = createNode(_generatorPluginID);
+    ASSERT_TRUE(generator && source);
+    KnobDoublePtr knob = boost::dynamic_pointer_cast<KnobDouble>( generator->getKnobByName("noiseZSlope") );
+    KnobDoublePtr sourceKnob = boost::dynamic_pointer_cast<KnobDouble>( source->getKnobByName("noiseZSlope") );
+    ASSERT_TRUE(knob && sourceKnob);
+    EffectInstancePtr effect = generator->getEffectInstance();
+
+    knob->setValue(0.5);
+    sourceKnob->setValue(0.25);
+    EXPECT_EQ( 0.5, readKnobInRender(generator, knob, 0) );
+    // Nothing changed: the snapshot is given to the next renders
+    KnobsSnapshotPtr snapshot = effect->getKnobsSnapshot();
+    EXPECT_EQ( snapshot, effect->getKnobsSnapshot() );
+
+    knob->clone( sourceKnob.get() );
+    EXPECT_NE( snapshot, effect->getKnobsSnapshot() );
+    EXPECT_EQ( 0.25, readKnobInRender(generator, knob, 0) );
+
+    // Cloning the curves, with an offset
+    sourceKnob->setValueAtTime(0, 1., ViewSpec::all(), 0);
+    sourceKnob->setValueAtTime(10, 2., ViewSpec::all(), 0);
+    snapshot = effect->getKnobsSnapshot();
+    knob->clone(sourceKnob.get(), 5., (const RangeD*)0);
+    EXPECT_NE( snapshot, effect->getKnobsSnapshot() );
+    EXPECT_EQ( 1., readKnobInRender(generator, knob, 5) );
+    EXPECT_EQ( 2., readKnobInRender(generator, knob, 15) );
+
+    snapshot = effect->getKnobsSnapshot();
+    sourceKnob->setValueAtTime(15, 3., ViewSpec::all(), 0);
+    EXPECT_TRUE( knob->cloneAndCheckIfChanged( sourceKnob.get() ) );
+    EXPECT_NE( snapshot, effect->getKnobsSnapshot() );
+    EXPECT_EQ( 3., readKnobInRender(generator, knob, 15) );
+}
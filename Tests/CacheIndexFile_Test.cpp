@@ -0,0 +1,268 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+
+#include <QtCore/QString>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+#include "Engine/CacheIndexFile.h"
+#include "Engine/StandardPaths.h"
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_USING
+
+#define TEST_CACHE_VERSION 5
+
+namespace {
+std::string
+getIndexFilePath()
+{
+    QString tempPath = StandardPaths::writableLocation(StandardPaths::eStandardLocationTemp);
+    QDir dir(tempPath);
+
+    dir.mkpath( QString::fromUtf8(".") );
+
+    return dir.absoluteFilePath( QString::fromUtf8("NatronUnitTest") + QString::number( qrand() ) + QString::fromUtf8(".index") ).toStdString();
+}
+
+std::string
+getEntryString(const char* prefix,
+               int i)
+{
+    std::stringstream ss;
+
+    ss << prefix << i;
+
+    return ss.str();
+}
+
+// Several entries share the same hash, as in the cache
+U64
+getEntryHash(int i)
+{
+    return ( (U64)(i / 3) * 0x9E3779B97F4A7C15ULL ) ^ 0x1234;
+}
+
+void
+addEntries(int count,
+           CacheIndexFileWriter* writer)
+{
+    for (int i = 0; i < count; ++i) {
+        std::string filePath = getEntryString("/cache/00/file", i);
+        std::string holderID = getEntryString("Node", i % 7);
+        std::string serialization = getEntryString("serialization", i);
+        writer->addRecord(getEntryHash(i), i % 5, 1000 + i, 64 * i, filePath, holderID, serialization.data(), serialization.size());
+    }
+}
+
+void
+corruptFile(const std::string & filePath,
+            qint64 offset)
+{
+    QFile file( QString::fromUtf8( filePath.c_str() ) );
+
+    ASSERT_TRUE( file.open(QIODevice::ReadWrite) );
+    ASSERT_TRUE( file.seek(offset) );
+    char c;
+    ASSERT_TRUE( file.getChar(&c) );
+    ASSERT_TRUE( file.seek(offset) );
+    ASSERT_TRUE( file.putChar(c ^ 1) );
+    file.close();
+}
+} // anon namespace
+
+TEST(CacheIndexFile,
+     WriteAndFind)
+{
+    const int count = 1000;
+    std::string filePath = getIndexFilePath();
+    std::string error;
+    {
+        CacheIndexFileWriter writer;
+        addEntries(count, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    }
+
+    std::string mappedFilePath;
+    {
+        CacheIndexFile index;
+        ASSERT_TRUE( index.open(filePath, TEST_CACHE_VERSION, &error) ) << error;
+        ASSERT_EQ( (std::size_t)count, index.getRecordsCount() );
+        mappedFilePath = index.getMappedFilePath();
+
+        // The index is renamed while it is mapped
+        EXPECT_FALSE( QFile::exists( QString::fromUtf8( filePath.c_str() ) ) );
+        EXPECT_TRUE( QFile::exists( QString::fromUtf8( mappedFilePath.c_str() ) ) );
+
+        for (int i = 0; i < count; ++i) {
+            std::size_t first, last;
+            index.findRecords(getEntryHash(i), &first, &last);
+            ASSERT_LT(first, last);
+
+            // Find the record of this entry among the records with the same hash
+            std::string expectedFilePath = getEntryString("/cache/00/file", i);
+            std::size_t found = last;
+            for (std::size_t r = first; r < last; ++r) {
+                EXPECT_EQ( getEntryHash(i), index.getRecord(r).hash );
+                if (index.getFilePath(r) == expectedFilePath) {
+                    found = r;
+                }
+            }
+            ASSERT_NE(last, found) << "entry " << i;
+
+            const CacheIndexFile::Record & record = index.getRecord(found);
+            EXPECT_EQ( (U64)(i % 5), record.treeVersion );
+            EXPECT_EQ( (U64)(1000 + i), record.dataSize );
+            EXPECT_EQ( (U64)(64 * i), record.dataOffsetInFile );
+            EXPECT_EQ( getEntryString("Node", i % 7), index.getHolderID(found) );
+            EXPECT_TRUE( index.hasHolderID( found, getEntryString("Node", i % 7) ) );
+            EXPECT_FALSE( index.hasHolderID( found, getEntryString("Node", i % 7 + 1) ) );
+            std::size_t serializationSize;
+            const char* serialization = index.getSerialization(found, &serializationSize);
+            EXPECT_EQ( getEntryString("serialization", i), std::string(serialization, serializationSize) );
+        }
+
+        std::size_t first, last;
+        index.findRecords(42, &first, &last);
+        EXPECT_EQ(first, last) << "No record with this hash";
+    }
+
+    // The mapped file is removed with the index
+    EXPECT_FALSE( QFile::exists( QString::fromUtf8( mappedFilePath.c_str() ) ) );
+}
+
+TEST(CacheIndexFile,
+     CopyRecords)
+{
+    std::string filePath = getIndexFilePath();
+    std::string error;
+    {
+        CacheIndexFileWriter writer;
+        addEntries(100, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    }
+
+    // Save again the odd records, as the cache does with the records that were never requested
+    {
+        CacheIndexFile index;
+        ASSERT_TRUE( index.open(filePath, TEST_CACHE_VERSION, &error) ) << error;
+        CacheIndexFileWriter writer;
+        for (std::size_t i = 1; i < index.getRecordsCount(); i += 2) {
+            writer.addRecord(index, i);
+        }
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    }
+
+    CacheIndexFile index;
+    ASSERT_TRUE( index.open(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    EXPECT_EQ( (std::size_t)50, index.getRecordsCount() );
+    for (std::size_t i = 0; i < index.getRecordsCount(); ++i) {
+        std::size_t first, last;
+        index.findRecords(index.getRecord(i).hash, &first, &last);
+        EXPECT_LE(first, i);
+        EXPECT_LT(i, last);
+        EXPECT_EQ( 0u, index.getFilePath(i).find("/cache/00/file") );
+    }
+}
+
+TEST(CacheIndexFile,
+     RejectInvalidFiles)
+{
+    std::string filePath = getIndexFilePath();
+    std::string error;
+
+    // Missing file
+    {
+        CacheIndexFile index;
+        EXPECT_FALSE( index.open(filePath, TEST_CACHE_VERSION, &error) );
+    }
+
+    // Other cache version
+    {
+        CacheIndexFileWriter writer;
+        addEntries(10, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+        CacheIndexFile index;
+        EXPECT_FALSE( index.open(filePath, TEST_CACHE_VERSION + 1, &error) );
+        EXPECT_FALSE( QFile::exists( QString::fromUtf8( index.getMappedFilePath().c_str() ) ) ) << "Invalid files must be removed";
+    }
+
+    // Corrupted record, payload and header
+    const qint64 offsets[] = { 48, 40 + 10 * 56 + 3, 0 };
+    for (std::size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+        CacheIndexFileWriter writer;
+        addEntries(10, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+        corruptFile(filePath, offsets[i]);
+        CacheIndexFile index;
+        EXPECT_FALSE( index.open(filePath, TEST_CACHE_VERSION, &error) ) << "offset " << offsets[i];
+        EXPECT_FALSE( QFile::exists( QString::fromUtf8( index.getMappedFilePath().c_str() ) ) );
+    }
+
+    // Truncated file
+    {
+        CacheIndexFileWriter writer;
+        addEntries(10, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+        QFile::resize(QString::fromUtf8( filePath.c_str() ), 40 + 5 * 56);
+        CacheIndexFile index;
+        EXPECT_FALSE( index.open(filePath, TEST_CACHE_VERSION, &error) );
+    }
+}
+
+// Time to open and look-up an index of 200000 entries
+TEST(CacheIndexFile,
+     Benchmark)
+{
+    const int count = 200000;
+    std::string filePath = getIndexFilePath();
+    std::string error;
+    {
+        CacheIndexFileWriter writer;
+        addEntries(count, &writer);
+        ASSERT_TRUE( writer.write(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    }
+
+    TimeLapse timer;
+    CacheIndexFile index;
+    ASSERT_TRUE( index.open(filePath, TEST_CACHE_VERSION, &error) ) << error;
+    double openTime = timer.getTimeSinceCreation();
+    std::size_t nFound = 0;
+    for (int i = 0; i < count; ++i) {
+        std::size_t first, last;
+        index.findRecords(getEntryHash(i), &first, &last);
+        nFound += (last > first) ? 1 : 0;
+    }
+    EXPECT_EQ( (std::size_t)count, nFound );
+    std::cout << "CacheIndexFile: opened " << count << " records in " << openTime << " s, "
+              << count << " look-ups in " << timer.getTimeSinceCreation() - openTime << " s" << std::endl;
+}
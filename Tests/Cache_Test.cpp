@@ -0,0 +1,407 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/make_shared.hpp>
+#endif
+
+#include "Global/QtCompat.h"
+
+#include "Engine/CacheIndexFile.h"
+#include "Engine/CacheSerialization.h"
+#include "Engine/Image.h"
+#include "Engine/ImagePlaneDesc.h"
+#include "Engine/TaskScheduler.h"
+#include "Engine/Timer.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+const int kImageSize = 16;
+const std::size_t kImageByteSize = kImageSize * kImageSize * 4 * sizeof(float);
+
+ImageKey
+makeKey(U64 nodeHash)
+{
+    return ImageKey(0, nodeHash, false, 0., ViewIdx(0), 1., false, false);
+}
+
+// Returns a key whose entries are stored in the given bucket. The search starts at *nodeHash.
+ImageKey
+makeKeyInBucket(int bucketIndex,
+                U64* nodeHash)
+{
+    for (;;) {
+        ImageKey key = makeKey( (*nodeHash)++ );
+        if (Cache<Image>::getBucketIndex( key.getHash() ) == bucketIndex) {
+            return key;
+        }
+    }
+}
+
+ImageParamsPtr
+makeImageParams(StorageModeEnum storage)
+{
+    RectI bounds(0, 0, kImageSize, kImageSize);
+    RectD rod(0., 0., kImageSize, kImageSize);
+
+    return Image::makeParams(rod, bounds, 1., 0, false, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat,
+                             eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, storage);
+}
+
+// Creates the 256 sub-folders in which the entries of a cache that is not tiled are stored
+void
+makeCacheFolders(const QString & cachePath)
+{
+    QDir cacheFolder(cachePath);
+
+    cacheFolder.mkpath( QChar::fromLatin1('.') );
+    for (U32 i = 0x00; i <= 0xF; ++i) {
+        for (U32 j = 0x00; j <= 0xF; ++j) {
+            std::ostringstream oss;
+            oss << std::hex << i;
+            oss << std::hex << j;
+            cacheFolder.mkdir( QString::fromUtf8( oss.str().c_str() ) );
+        }
+    }
+}
+
+void
+removeCacheFolders(const QString & cachePath)
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QtCompat::removeRecursively(cachePath);
+#else
+    QDir(cachePath).removeRecursively();
+#endif
+}
+
+// Counts the entries of each bucket
+std::vector<int>
+countEntriesPerBucket(const Cache<Image> & cache)
+{
+    std::vector<int> counts(NATRON_CACHE_BUCKETS_COUNT, 0);
+    std::list<ImagePtr> entries;
+
+    cache.getCopy(&entries);
+    for (std::list<ImagePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        ++counts[Cache<Image>::getBucketIndex( (*it)->getHashKey() )];
+    }
+
+    return counts;
+}
+
+// Creates nEntries entries stored on disk with the keys makeKey(0) to makeKey(nEntries - 1) and saves the index of the cache
+void
+fillAndSaveCache(Cache<Image>* cache,
+                 int nEntries)
+{
+    ImageParamsPtr params = makeImageParams(eStorageModeDisk);
+
+    for (int i = 0; i < nEntries; ++i) {
+        ImagePtr image;
+        cache->getOrCreate(makeKey(i), params, 0, &image);
+        ASSERT_TRUE(image);
+        image->allocateMemory();
+    }
+
+    std::string error;
+    ASSERT_TRUE( cache->save(cache->getRestoreFilePath(), &error) ) << error;
+}
+
+// Opens the index saved by fillAndSaveCache() in a new cache
+void
+restoreCache(Cache<Image>* cache)
+{
+    boost::shared_ptr<CacheIndexFile> index = boost::make_shared<CacheIndexFile>();
+    std::string error;
+
+    ASSERT_TRUE( index->open(cache->getRestoreFilePath(), cache->cacheVersion(), &error) ) << error;
+    cache->restore(index);
+}
+
+// Each task creates its own entries in the cache and looks them up right away
+class CreateAndGetTasks
+    : public ParallelTasks
+{
+public:
+
+    CreateAndGetTasks(const Cache<Image>* cache,
+                      int nEntriesPerTask)
+        : cache(cache)
+        , nEntriesPerTask(nEntriesPerTask)
+        , params( makeImageParams(eStorageModeRAM) )
+        , failures()
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        for (int i = 0; i < nEntriesPerTask; ++i) {
+            ImageKey key = makeKey( (U64)taskIndex * nEntriesPerTask + i );
+            ImagePtr image;
+            cache->getOrCreate(key, params, 0, &image);
+            if (!image) {
+                failures.ref();
+                continue;
+            }
+            image->allocateMemory();
+
+            std::list<ImagePtr> found;
+            if ( !cache->get(key, &found) || (found.front() != image) ) {
+                failures.ref();
+            }
+        }
+    }
+
+    const Cache<Image>* cache;
+    int nEntriesPerTask;
+    ImageParamsPtr params;
+    QAtomicInt failures;
+};
+} // anon namespace
+
+TEST(Cache,
+     ConcurrentAccessToAllBuckets)
+{
+    const int nTasks = 64;
+    const int nEntriesPerTask = 64;
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, (U64)nTasks * nEntriesPerTask * kImageByteSize * 2, 1.);
+    TaskScheduler scheduler(8);
+    CreateAndGetTasks tasks(&cache, nEntriesPerTask);
+
+    scheduler.run(&tasks, nTasks);
+    EXPECT_EQ(0, (int)tasks.failures);
+
+    // Every entry fits in the cache: none was evicted and all buckets were used
+    std::vector<int> counts = countEntriesPerBucket(cache);
+    int nEntries = 0;
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        EXPECT_GT(counts[i], 0) << "bucket " << i;
+        nEntries += counts[i];
+    }
+    EXPECT_EQ(nTasks * nEntriesPerTask, nEntries);
+    for (int i = 0; i < nTasks * nEntriesPerTask; ++i) {
+        std::list<ImagePtr> found;
+        EXPECT_TRUE( cache.get(makeKey(i), &found) ) << "entry " << i;
+    }
+
+    cache.clear();
+    cache.waitForDeleterThread();
+}
+
+TEST(Cache,
+     ConcurrentEvictionStaysWithinLimit)
+{
+    const int nTasks = 64;
+    const int nEntriesPerTask = 64;
+    const int nThreads = 8;
+    const int maxEntries = 256;
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, (U64)maxEntries * kImageByteSize, 1.);
+    TaskScheduler scheduler(nThreads);
+    CreateAndGetTasks tasks(&cache, nEntriesPerTask);
+
+    scheduler.run(&tasks, nTasks);
+    EXPECT_EQ(0, (int)tasks.failures);
+
+    // Entries created by the other threads while a thread evicts may exceed the limit by one entry per thread
+    std::vector<int> counts = countEntriesPerBucket(cache);
+    int nEntries = 0;
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        nEntries += counts[i];
+    }
+    EXPECT_LE(nEntries, maxEntries + nThreads + 1);
+
+    cache.clear();
+    cache.waitForDeleterThread();
+}
+
+// A bucket receiving all the new entries must evict the disk entries of the other buckets
+// when the disk portion of the whole cache is full, instead of only its own entries.
+TEST(Cache,
+     DiskEvictionIsGlobal)
+{
+    const int maxDiskEntries = 48;
+    const int maxEntries = 64;
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, (U64)maxEntries * kImageByteSize,
+                       (double)(maxEntries - maxDiskEntries) / maxEntries);
+    QString cachePath = cache.getCachePath();
+
+    makeCacheFolders(cachePath);
+
+    ImageParamsPtr params = makeImageParams(eStorageModeDisk);
+    U64 nodeHash = 0;
+
+    // Fill the disk portion with entries of the buckets 1 to 15
+    for (int i = 0; i < maxDiskEntries; ++i) {
+        ImageKey key = makeKeyInBucket(1 + i % (NATRON_CACHE_BUCKETS_COUNT - 1), &nodeHash);
+        ImagePtr image;
+        cache.getOrCreate(key, params, 0, &image);
+        ASSERT_TRUE(image);
+        image->allocateMemory();
+    }
+    cache.clearInMemoryPortion();
+    std::vector<int> counts = countEntriesPerBucket(cache);
+    EXPECT_EQ(0, counts[0]);
+
+    // Only create entries of bucket 0
+    for (int i = 0; i < maxEntries * 2; ++i) {
+        ImageKey key = makeKeyInBucket(0, &nodeHash);
+        ImagePtr image;
+        cache.getOrCreate(key, params, 0, &image);
+        ASSERT_TRUE(image);
+        image->allocateMemory();
+    }
+    cache.clearInMemoryPortion();
+
+    EXPECT_LE( cache.getDiskCacheSize(), (std::size_t)maxDiskEntries * kImageByteSize );
+    counts = countEntriesPerBucket(cache);
+    int nOtherEntries = 0;
+    for (int i = 1; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        nOtherEntries += counts[i];
+    }
+    EXPECT_GT(counts[0], maxDiskEntries / 2);
+    EXPECT_LT(nOtherEntries, maxDiskEntries / 2);
+
+    cache.clear();
+    cache.waitForDeleterThread();
+    removeCacheFolders(cachePath);
+}
+
+// The entries of a restored cache are only created when they are requested, but their data
+// counts in the disk portion and can be evicted before being created.
+TEST(Cache,
+     RestoreCreatesEntriesLazily)
+{
+    const int nEntries = 64;
+    const U64 maxSize = (U64)nEntries * 2 * kImageByteSize;
+    QString cachePath;
+    {
+        Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, maxSize, 0.5);
+        cachePath = cache.getCachePath();
+        makeCacheFolders(cachePath);
+        fillAndSaveCache(&cache, nEntries);
+    }
+
+    // A file in a sub-folder whose name has a letter that no record references
+    QString orphanFilePath = cachePath + QString::fromUtf8("/f0/123." NATRON_CACHE_FILE_EXT);
+    {
+        QFile orphanFile(orphanFilePath);
+        ASSERT_TRUE( orphanFile.open(QIODevice::WriteOnly) );
+    }
+
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, maxSize, 0.5);
+    restoreCache(&cache);
+    EXPECT_FALSE( QFile::exists(orphanFilePath) );
+    EXPECT_EQ( (std::size_t)nEntries * kImageByteSize, cache.getDiskCacheSize() );
+    EXPECT_TRUE( countEntriesPerBucket(cache) == std::vector<int>(NATRON_CACHE_BUCKETS_COUNT, 0) );
+
+    // Only the requested entries are created
+    for (int i = 0; i < nEntries / 2; ++i) {
+        ImageKey key = makeKey(i);
+        std::list<ImagePtr> found;
+        ASSERT_TRUE( cache.get(key, &found) ) << "entry " << i;
+        EXPECT_EQ( key.getHash(), found.front()->getHashKey() );
+    }
+    std::list<ImagePtr> entries;
+    cache.getCopy(&entries);
+    EXPECT_EQ( (std::size_t)nEntries / 2, entries.size() );
+    entries.clear();
+
+    // New entries evict both the created entries and the records that were never requested
+    ImageParamsPtr params = makeImageParams(eStorageModeDisk);
+    for (int i = nEntries; i < nEntries * 4; ++i) {
+        ImagePtr image;
+        cache.getOrCreate(makeKey(i), params, 0, &image);
+        ASSERT_TRUE(image);
+        image->allocateMemory();
+    }
+    cache.clearInMemoryPortion();
+    EXPECT_LE( cache.getDiskCacheSize(), maxSize / 2 );
+    int nRestored = 0;
+    for (int i = 0; i < nEntries; ++i) {
+        std::list<ImagePtr> found;
+        nRestored += cache.get(makeKey(i), &found) ? 1 : 0;
+    }
+    EXPECT_LT(nRestored, nEntries);
+
+    cache.clear();
+    cache.waitForDeleterThread();
+    removeCacheFolders(cachePath);
+}
+
+TEST(Cache,
+     RestoreBenchmark)
+{
+    const int nEntries = 4096;
+    const U64 maxSize = (U64)nEntries * 2 * kImageByteSize;
+    QString cachePath;
+    {
+        Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, maxSize, 0.5);
+        cachePath = cache.getCachePath();
+        makeCacheFolders(cachePath);
+        fillAndSaveCache(&cache, nEntries);
+    }
+
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, maxSize, 0.5);
+    TimeLapse timer;
+    restoreCache(&cache);
+    double restoreTime = timer.getTimeSinceCreation();
+
+    int nFound = 0;
+    for (int i = 0; i < nEntries; ++i) {
+        std::list<ImagePtr> found;
+        nFound += cache.get(makeKey(i), &found) ? 1 : 0;
+    }
+    double getTime = timer.getTimeSinceCreation();
+    EXPECT_EQ(nEntries, nFound);
+
+    // Evicts all the entries that were created
+    cache.setMaximumCacheSize(0);
+    cache.clearInMemoryPortion();
+    double evictTime = timer.getTimeSinceCreation();
+    std::list<ImagePtr> entries;
+    cache.getCopy(&entries);
+    EXPECT_TRUE( entries.empty() );
+
+    std::cout << "Cache: restored " << nEntries << " entries in " << restoreTime << " s, created them in "
+              << getTime - restoreTime << " s, evicted them in " << evictTime - getTime << " s" << std::endl;
+
+    cache.clear();
+    cache.waitForDeleterThread();
+    removeCacheFolders(cachePath);
+}
@@ -124,3 +124,35 @@ TEST(Curve, Basic)
 }
 
 
+
+TEST(Curve, GetValuesAt)
+{
+    Curve c;
+
+    c.addKeyFrame( KeyFrame(0., 10., 0., 0., eKeyframeTypeSmooth) );
+    c.addKeyFrame( KeyFrame(10., 20., 0., 0., eKeyframeTypeLinear) );
+    c.addKeyFrame( KeyFrame(15., 5., 0., 0., eKeyframeTypeConstant) );
+    c.addKeyFrame( KeyFrame(30., 0., 0., 0., eKeyframeTypeCatmullRom) );
+
+    std::vector<double> times;
+    for (double t = -10.; t <= 40.; t += 0.5) {
+        times.push_back(t);
+    }
+    std::vector<double> values;
+    c.getValuesAt(times, true, &values);
+    ASSERT_EQ( times.size(), values.size() );
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]), values[i] );
+    }
+
+    // the values do not depend on the order of the evaluations
+    for (std::size_t i = times.size(); i > 0; --i) {
+        EXPECT_EQ( values[i - 1], c.getValueAt(times[i - 1]) );
+    }
+
+    // the evaluation follows the changes of the keyframes
+    c.addKeyFrame( KeyFrame(20., 100., 0., 0., eKeyframeTypeLinear) );
+    EXPECT_EQ( 100., c.getValueAt(20.) );
+    c.removeKeyFrameWithTime(20.);
+    EXPECT_EQ( values[60], c.getValueAt(20.) );
+}
@@ -25,9 +25,16 @@
 #include "Global/Macros.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <iostream>
 #include <gtest/gtest.h>
 
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/crc.hpp>
+#endif
+
 #include "Engine/Hash64.h"
+#include "Engine/Timer.h"
 
 NATRON_NAMESPACE_USING
 
@@ -90,3 +97,90 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+typedef boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> BoostCrc64;
+
+static U64
+boostChecksum(const std::vector<U64> & values)
+{
+    BoostCrc64 crc;
+
+    if ( !values.empty() ) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>( &values.front() );
+        crc = std::for_each(data, data + values.size() * sizeof(U64), crc);
+    }
+
+    return crc();
+}
+
+// The hash values must not change: they are used as keys of the images stored in the disk cache
+TEST(Hash64,
+     SameAsBoostCrc)
+{
+    srand(2000);
+    for (int test = 0; test < 100; ++test) {
+        // coverity[dont_call]
+        int count = rand() % 300 + 1;
+        std::vector<U64> values;
+        Hash64 hash;
+        for (int i = 0; i < count; ++i) {
+            // coverity[dont_call]
+            int v = rand();
+            if (i % 2) {
+                hash.append<int>(v);
+                values.push_back( Hash64::toU64<int>(v) );
+            } else {
+                hash.append<double>(v * 0.5);
+                values.push_back( Hash64::toU64<double>(v * 0.5) );
+            }
+        }
+        hash.computeHash();
+        EXPECT_EQ( boostChecksum(values), hash.value() );
+
+        Hash64 hashValues;
+        hashValues.appendValues( &values.front(), values.size() );
+        hashValues.computeHash();
+        EXPECT_EQ( hash, hashValues ) << "appendValues() and append() must give the same hash";
+
+        // Byte sequences whose size is not a multiple of 8
+        // coverity[dont_call]
+        std::size_t nBytes = rand() % 50;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>( &values.front() );
+        BoostCrc64 crc;
+        crc.process_bytes(bytes, nBytes);
+        EXPECT_EQ( crc.checksum(), Hash64::updateCrc64(0, bytes, nBytes) );
+    }
+}
+
+TEST(Hash64,
+     Benchmark)
+{
+    const int nValues = 1 << 20;
+    const int nPasses = 10;
+    std::vector<U64> values(nValues);
+
+    for (int i = 0; i < nValues; ++i) {
+        values[i] = (U64)i * 2654435761ULL;
+    }
+
+    U64 boostResult = 0;
+    TimeLapse boostTimer;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        boostResult = boostChecksum(values);
+    }
+    double boostElapsed = boostTimer.getTimeSinceCreation();
+
+    Hash64 hash;
+    TimeLapse timer;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        hash.reset();
+        for (int i = 0; i < nValues; ++i) {
+            hash.append<U64>(values[i]);
+        }
+        hash.computeHash();
+    }
+    double elapsed = timer.getTimeSinceCreation();
+
+    EXPECT_EQ( boostResult, hash.value() );
+    std::cout << "Hash64: " << nPasses * nValues << " values hashed in " << elapsed << " s (boost::crc: "
+              << boostElapsed << " s)" << std::endl;
+}
@@ -0,0 +1,178 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Engine/ImageConvertKernels.h"
+#include "Engine/Lut.h"
+
+NATRON_NAMESPACE_USING
+using namespace NATRON_NAMESPACE::ImageConvertKernels;
+
+namespace {
+template <typename PIX>
+PIX randomValue();
+
+template <>
+unsigned char
+randomValue()
+{
+    // coverity[dont_call]
+    return (unsigned char)(rand() % 256);
+}
+
+template <>
+unsigned short
+randomValue()
+{
+    // coverity[dont_call]
+    return (unsigned short)(rand() % 65536);
+}
+
+// Values in [-0.2, 1.2] with a few special values
+template <>
+float
+randomValue()
+{
+    // coverity[dont_call]
+    int r = rand();
+
+    switch (r % 32) {
+    case 0:
+        return std::numeric_limits<float>::quiet_NaN();
+    case 1:
+        return -0.f;
+    case 2:
+        return 1.f;
+    case 3:
+        return 1e6f;
+    case 4:
+        return 127.5f / 255.f;
+    default:
+        return -0.2f + 1.4f * (float)r / (float)RAND_MAX;
+    }
+}
+
+std::vector<InstructionSetEnum>
+getVectorInstructionSets()
+{
+    std::vector<InstructionSetEnum> ret;
+    InstructionSetEnum supported = getSupportedInstructionSet();
+
+    if (supported >= eInstructionSetSSE41) {
+        ret.push_back(eInstructionSetSSE41);
+    }
+    if (supported >= eInstructionSetAVX2) {
+        ret.push_back(eInstructionSetAVX2);
+    }
+
+    return ret;
+}
+
+// The vector kernels must give exactly the same result as the scalar ones, for all the row lengths
+template <typename SRCPIX, typename DSTPIX>
+void
+checkSameAsScalar()
+{
+    const std::vector<InstructionSetEnum> instructionSets = getVectorInstructionSets();
+
+    srand(2000);
+    for (int count = 0; count < 100; ++count) {
+        std::vector<SRCPIX> src(count + 1);
+        for (std::size_t i = 0; i < src.size(); ++i) {
+            src[i] = randomValue<SRCPIX>();
+        }
+        std::vector<DSTPIX> reference(count + 1);
+        setInstructionSet(eInstructionSetScalar);
+        convertDepth(&src[0], count, &reference[0]);
+        for (std::size_t s = 0; s < instructionSets.size(); ++s) {
+            std::vector<DSTPIX> result(count + 1);
+            setInstructionSet(instructionSets[s]);
+            convertDepth(&src[0], count, &result[0]);
+            EXPECT_EQ( 0, std::memcmp( &reference[0], &result[0], count * sizeof(DSTPIX) ) )
+                << "instruction set " << instructionSets[s] << ", " << sizeof(SRCPIX) << " to " << sizeof(DSTPIX) << " bytes, count " << count;
+        }
+    }
+    setInstructionSet( getSupportedInstructionSet() );
+}
+} // anon namespace
+
+TEST(ImageConvertKernels,
+     SameAsScalar)
+{
+    checkSameAsScalar<unsigned char, unsigned short>();
+    checkSameAsScalar<unsigned char, float>();
+    checkSameAsScalar<unsigned short, unsigned char>();
+    checkSameAsScalar<unsigned short, float>();
+    checkSameAsScalar<float, unsigned char>();
+    checkSameAsScalar<float, unsigned short>();
+    checkSameAsScalar<float, float>();
+}
+
+// The conversions must be those of the Color functions used by Image::convertPixelDepth
+TEST(ImageConvertKernels,
+     SameAsPixelDepthConversion)
+{
+    std::vector<unsigned short> shorts(65536);
+    std::vector<unsigned char> chars(65536);
+    std::vector<float> floats(65536);
+
+    for (int i = 0; i < 65536; ++i) {
+        shorts[i] = (unsigned short)i;
+    }
+    convertDepth(&shorts[0], 65536, &chars[0]);
+    convertDepth(&shorts[0], 65536, &floats[0]);
+    for (int i = 0; i < 65536; ++i) {
+        EXPECT_EQ(Color::uint16ToChar( (unsigned short)i ), chars[i]) << i;
+        EXPECT_EQ(Color::intToFloat<65536>(i), floats[i]) << i;
+    }
+
+    convertDepth(&chars[0], 256, &shorts[0]);
+    for (int i = 0; i < 256; ++i) {
+        EXPECT_EQ( (unsigned short)( (chars[i] << 8) + chars[i] ), shorts[i] ) << i;
+    }
+
+    srand(2000);
+    for (int i = 0; i < 65536; ++i) {
+        floats[i] = randomValue<float>();
+    }
+    convertDepth(&floats[0], 65536, &chars[0]);
+    convertDepth(&floats[0], 65536, &shorts[0]);
+    for (int i = 0; i < 65536; ++i) {
+        if (floats[i] != floats[i]) {
+            EXPECT_EQ(0, chars[i]);
+            EXPECT_EQ(0, shorts[i]);
+        } else {
+            EXPECT_EQ(Color::floatToInt<256>(floats[i]), chars[i]) << floats[i];
+            EXPECT_EQ(Color::floatToInt<65536>(floats[i]), shorts[i]) << floats[i];
+        }
+    }
+}
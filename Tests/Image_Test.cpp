@@ -24,14 +24,57 @@
 
 #include "Global/Macros.h"
 
+#include <cstdlib>
 #include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "Engine/Image.h"
+#include "Engine/ImagePlaneDesc.h"
+#include "Engine/InstructionSet.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
 
+namespace {
+// Returns true if a pixel of roi has the given state
+bool
+containsPixel(const Bitmap& bm,
+              const RectI& roi,
+              char value)
+{
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            if (bm.getPixel(x, y) == value) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// The value of a pixel of the given mipmap level whose footprint is inside the bounds, averaged level by level
+float
+mipMapPixel(const float* pixels,
+            const RectI& bounds,
+            unsigned int level,
+            int x,
+            int y,
+            int k)
+{
+    if (level == 0) {
+        return pixels[( (y - bounds.y1) * bounds.width() + x - bounds.x1 ) * 4 + k];
+    }
+    const float a = mipMapPixel(pixels, bounds, level - 1, 2 * x, 2 * y, k);
+    const float b = mipMapPixel(pixels, bounds, level - 1, 2 * x + 1, 2 * y, k);
+    const float c = mipMapPixel(pixels, bounds, level - 1, 2 * x, 2 * y + 1, k);
+    const float d = mipMapPixel(pixels, bounds, level - 1, 2 * x + 1, 2 * y + 1, k);
+
+    return (a + b + c + d) / 4;
+}
+} // anon namespace
+
 TEST(BitmapTest,
      SimpleRect)
 {
@@ -51,8 +94,7 @@ TEST(BitmapTest,
     ASSERT_TRUE(rod == nonRenderedRectsUnion);
 
     ///assert that the "underlying" bitmap is clean
-    const char* map = bm.getBitmap();
-    ASSERT_TRUE( !std::memchr( map, 1, rod.area() ) );
+    ASSERT_TRUE( !containsPixel(bm, rod, 1) );
     ASSERT_TRUE( bm.isNonMarked(rod) );
 
     RectI halfRoD(0, 0, 100, 50);
@@ -68,14 +110,12 @@ TEST(BitmapTest,
 
 
     ///assert that the underlying bitmap is marked as expected
-    const char* start = map;
 
     ///check that there are only ones in the rendered half
-    ASSERT_TRUE( !memchr( start, 0, halfRoD.area() ) );
+    ASSERT_TRUE( !containsPixel(bm, halfRoD, 0) );
 
     ///check that there are only 0s in the non rendered half
-    start = map + halfRoD.area();
-    ASSERT_TRUE( !memchr( start, 1, halfRoD.area() ) );
+    ASSERT_TRUE( !containsPixel(bm, nonRenderedHalf, 1) );
 
     ///mark for renderer the other half of the rod
     bm.markForRendered(nonRenderedHalf);
@@ -84,7 +124,7 @@ TEST(BitmapTest,
     nonRenderedRects.clear();
     bm.minimalNonMarkedRects(rod, nonRenderedRects);
     ASSERT_TRUE( nonRenderedRects.empty() );
-    ASSERT_TRUE( !memchr( map, 0, rod.area() ) );
+    ASSERT_TRUE( !containsPixel(bm, rod, 0) );
 
     ///More complex example where A,B,C,D are not rendered check that both trimap & bitmap yield the same result
     // BBBBBBBBBBBBBB
@@ -116,6 +156,154 @@ TEST(BitmapTest,
     EXPECT_TRUE(nonRenderedRects.size() == 3);
 } // TEST
 
+// Random marks on bounds that are not aligned on the blocks, checked against one char per pixel
+TEST(BitmapTest,
+     BlocksMatchPixels)
+{
+    const RectI bounds(-37, 13, 150, 121);
+    Bitmap bm(bounds);
+    std::vector<char> pixels(bounds.area(), 0);
+
+    srand(2000);
+    for (int i = 0; i < 200; ++i) {
+        // coverity[dont_call]
+        int x1 = bounds.x1 + rand() % bounds.width();
+        // coverity[dont_call]
+        int y1 = bounds.y1 + rand() % bounds.height();
+        // coverity[dont_call]
+        RectI rect( x1, y1, std::min(bounds.x2, x1 + 1 + rand() % 70), std::min(bounds.y2, y1 + 1 + rand() % 70) );
+        // coverity[dont_call]
+        char value = (char)(rand() % 3);
+        if (value == 0) {
+            bm.clear(rect);
+        } else if (value == 1) {
+            bm.markForRendered(rect);
+        } else {
+            bm.markForRendering(rect);
+        }
+        for (int y = rect.y1; y < rect.y2; ++y) {
+            std::memset(&pixels[(y - bounds.y1) * bounds.width() + rect.x1 - bounds.x1], value, rect.width());
+        }
+
+        // the bounding box of the pixels left to render, ignoring those being rendered with the trimap
+        RectI expectedBbox;
+        RectI expectedBboxTrimap;
+        for (int y = bounds.y1; y < bounds.y2; ++y) {
+            for (int x = bounds.x1; x < bounds.x2; ++x) {
+                char pixel = pixels[(y - bounds.y1) * bounds.width() + x - bounds.x1];
+                ASSERT_EQ( pixel, bm.getPixel(x, y) );
+                if (pixel != 1) {
+                    expectedBbox.merge( RectI(x, y, x + 1, y + 1) );
+                }
+                if (pixel == 0) {
+                    expectedBboxTrimap.merge( RectI(x, y, x + 1, y + 1) );
+                }
+            }
+        }
+        if ( !expectedBbox.isNull() ) {
+            EXPECT_TRUE( bm.minimalNonMarkedBbox(bounds) == expectedBbox );
+        } else {
+            EXPECT_TRUE( bm.minimalNonMarkedBbox(bounds).isNull() );
+        }
+        bool beingRenderedElsewhere = false;
+        RectI bboxTrimap = bm.minimalNonMarkedBbox_trimap(bounds, &beingRenderedElsewhere);
+        if ( !expectedBboxTrimap.isNull() ) {
+            EXPECT_TRUE(bboxTrimap == expectedBboxTrimap);
+        } else {
+            EXPECT_TRUE( bboxTrimap.isNull() );
+        }
+        EXPECT_EQ( bm.isNonMarked(rect), value == 0 );
+
+        // the rectangles to render must be disjoint and contain all the pixels that are not rendered
+        std::list<RectI> rects;
+        bm.minimalNonMarkedRects(bounds, rects);
+        for (int y = bounds.y1; y < bounds.y2; ++y) {
+            for (int x = bounds.x1; x < bounds.x2; ++x) {
+                int nContaining = 0;
+                for (std::list<RectI>::iterator it = rects.begin(); it != rects.end(); ++it) {
+                    nContaining += (int)it->contains(x, y);
+                }
+                EXPECT_LE(nContaining, 1);
+                if (pixels[(y - bounds.y1) * bounds.width() + x - bounds.x1] != 1) {
+                    EXPECT_EQ(nContaining, 1);
+                }
+            }
+        }
+    }
+
+    // copy to a bitmap with other bounds
+    const RectI otherBounds(-60, 0, 200, 130);
+    Bitmap other(otherBounds);
+    other.markForRendered(otherBounds);
+    other.copyBitmapPortion(bounds, bm);
+    std::vector<char> row( bounds.width() );
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        other.getRow(bounds.x1, bounds.x2, y, &row[0]);
+        EXPECT_EQ( 0, std::memcmp(&row[0], &pixels[(y - bounds.y1) * bounds.width()], bounds.width() ) );
+    }
+    EXPECT_EQ( 1, other.getPixel(bounds.x1 - 1, bounds.y1) );
+    EXPECT_EQ( 1, other.getPixel(bounds.x2, bounds.y2 - 1) );
+} // TEST
+
+// The mipmap levels are computed in a single pass: check them against the average of the pixels
+// and check that the pixels are marked as rendered only if all the pixels they cover are
+TEST(ImageTest,
+     DownscaleMipMap)
+{
+    const RectI bounds(-13, 7, 250, 190);
+    const RectD rod(-13, 7, 250, 190);
+    const RectI rendered(-4, 20, 200, 190);
+    Image src(ImagePlaneDesc::getRGBAComponents(), rod, bounds, 0, 1., eImageBitDepthFloat,
+              eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, true);
+
+    src.markForRendered(rendered);
+    std::vector<float> pixels(bounds.area() * 4);
+    srand(2000);
+    for (std::size_t i = 0; i < pixels.size(); ++i) {
+        // coverity[dont_call]
+        pixels[i] = (float)rand() / RAND_MAX;
+    }
+    {
+        Image::WriteAccess acc = src.getWriteRights();
+        std::memcpy( acc.pixelAt(bounds.x1, bounds.y1), &pixels[0], pixels.size() * sizeof(float) );
+    }
+
+    const InstructionSetEnum instructionSets[] = { eInstructionSetScalar, eInstructionSetSSE41, eInstructionSetAVX2 };
+    for (std::size_t i = 0; i < sizeof(instructionSets) / sizeof(instructionSets[0]); ++i) {
+        InstructionSetEnum instructionSet = setInstructionSet(instructionSets[i]);
+        for (unsigned int level = 1; level <= 4; ++level) {
+            const RectI dstBounds = bounds.downscalePowerOfTwoSmallestEnclosing(level);
+            Image dst(ImagePlaneDesc::getRGBAComponents(), rod, dstBounds, level, 1., eImageBitDepthFloat,
+                      eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, true);
+            src.downscaleMipMap(rod, bounds, 0, level, true, &dst);
+
+            Image::ReadAccess acc = dst.getReadRights();
+            const int pot = 1 << level;
+            for (int y = dstBounds.y1; y < dstBounds.y2; ++y) {
+                for (int x = dstBounds.x1; x < dstBounds.x2; ++x) {
+                    const RectI footprint(x * pot, y * pot, (x + 1) * pot, (y + 1) * pot);
+                    const float* pix = (const float*)acc.pixelAt(x, y);
+                    if ( bounds.contains(footprint) ) {
+                        for (int k = 0; k < 4; ++k) {
+                            ASSERT_EQ( mipMapPixel(&pixels[0], bounds, level, x, y, k), pix[k] )
+                                << "level " << level << " x " << x << " y " << y << " instruction set " << instructionSet;
+                        }
+                    } else {
+                        // the edges are the average of the pixels inside the bounds
+                        for (int k = 0; k < 4; ++k) {
+                            ASSERT_TRUE(pix[k] >= 0.f && pix[k] <= 1.f);
+                        }
+                    }
+                    std::list<RectI> rest;
+                    dst.getRestToRender(RectI(x, y, x + 1, y + 1), rest);
+                    EXPECT_EQ( !rendered.contains(footprint), !rest.empty() ) << "level " << level << " x " << x << " y " << y;
+                }
+            }
+        }
+    }
+    setInstructionSet( getSupportedInstructionSet() );
+} // TEST
+
 TEST(ImageKeyTest, Equality) {
     srand(2000);
     // coverity[dont_call]
@@ -0,0 +1,383 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <QtCore/QThread>
+
+#include "Engine/AppManager.h"
+#include "Engine/Knob.h"
+#include "Engine/KnobExpression.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+/*
+ * The knobs of the tests are named Node.<knob name>, names in shadowed are not compiled.
+ */
+class TestResolver
+    : public KnobExpressionResolver
+{
+public:
+
+    std::map<std::string, KnobIPtr> knobs;
+    std::set<std::string> shadowed;
+
+    virtual bool isNameShadowed(const std::string & name) const OVERRIDE FINAL
+    {
+        return shadowed.find(name) != shadowed.end();
+    }
+
+    virtual KnobIPtr getKnob(const std::vector<std::string> & names) const OVERRIDE FINAL
+    {
+        if ( (names.size() == 2) && (names[0] == "Node") ) {
+            std::map<std::string, KnobIPtr>::const_iterator found = knobs.find(names[1]);
+            if ( found != knobs.end() ) {
+                return found->second;
+            }
+        }
+
+        return KnobIPtr();
+    }
+};
+
+// Evaluates the expression at the given frame and checks the result and its Python type
+void
+checkExpression(const std::string & expression,
+                double frame,
+                double expected,
+                bool expectedIsInt,
+                const KnobExpressionResolver & resolver = TestResolver(),
+                int dimension = 0)
+{
+    KnobExpressionPtr expr = KnobExpression::compile(expression, dimension, resolver);
+
+    ASSERT_TRUE( bool(expr) ) << expression;
+    double result;
+    bool isInt;
+    ASSERT_TRUE( expr->evaluate(frame, ViewIdx(0), &result, &isInt) ) << expression;
+    EXPECT_DOUBLE_EQ(expected, result) << expression;
+    EXPECT_EQ(expectedIsInt, isInt) << expression;
+}
+
+// Checks that the expression is left to Python
+void
+checkNotCompiled(const std::string & expression,
+                 const KnobExpressionResolver & resolver = TestResolver())
+{
+    EXPECT_FALSE( KnobExpression::compile(expression, 0, resolver) ) << expression;
+}
+
+// Checks that the expression compiles but that Python must evaluate it at the given frame
+void
+checkNotEvaluated(const std::string & expression,
+                  double frame)
+{
+    KnobExpressionPtr expr = KnobExpression::compile( expression, 0, TestResolver() );
+
+    ASSERT_TRUE( bool(expr) ) << expression;
+    double result;
+    bool isInt;
+    EXPECT_FALSE( expr->evaluate(frame, ViewIdx(0), &result, &isInt) ) << expression;
+}
+
+class EvaluateThread
+    : public QThread
+{
+public:
+
+    EvaluateThread(const KnobExpressionPtr & expr,
+                   int count)
+        : QThread()
+        , _expr(expr)
+        , _count(count)
+        , _sum(0.)
+        , _failures(0)
+    {
+    }
+
+    double getSum() const
+    {
+        return _sum;
+    }
+
+    int getFailures() const
+    {
+        return _failures;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        for (int i = 0; i < _count; ++i) {
+            double result;
+            bool isInt;
+            if ( _expr->evaluate(i % 100, ViewIdx(0), &result, &isInt) ) {
+                _sum += result;
+            } else {
+                ++_failures;
+            }
+        }
+    }
+
+    KnobExpressionPtr _expr;
+    int _count;
+    double _sum;
+    int _failures;
+};
+} // anon namespace
+
+TEST(KnobExpression,
+     Arithmetic)
+{
+    checkExpression("1 + 2 * 3", 0, 7, true);
+    checkExpression("(1 + 2) * 3", 0, 9, true);
+    checkExpression("2 ** 3 ** 2", 0, 512, true);
+    checkExpression("-2 ** 2", 0, -4, true);
+    checkExpression("2 ** -1", 0, 0.5, false);
+    checkExpression("7 // 2", 0, 3, true);
+    checkExpression("-7 // 2", 0, -4, true);
+    checkExpression("-7.5 // 2", 0, -4, false);
+    checkExpression("-7 % 3", 0, 2, true);
+    checkExpression("7.5 % -2", 0, -0.5, false);
+    checkExpression("1.5e1 + .5", 0, 15.5, false);
+#if PY_MAJOR_VERSION >= 3
+    checkExpression("7 / 2", 0, 3.5, false);
+#else
+    checkExpression("7 / 2", 0, 3, true);
+#endif
+    checkExpression("7 / 2.", 0, 3.5, false);
+    checkExpression("True + True", 0, 2, true);
+}
+
+TEST(KnobExpression,
+     LogicAndComparisons)
+{
+    checkExpression("1 if frame > 5 else 2", 10, 1, true);
+    checkExpression("1 if frame > 5 else 2", 0, 2, true);
+    checkExpression("0 or 2.5", 0, 2.5, false);
+    checkExpression("1 and 0", 0, 0, true);
+    checkExpression("not frame", 0, 1, true);
+    checkExpression("frame == 3 or frame != 4", 3, 1, true);
+    checkExpression("(frame <= 2) + (frame >= 2) + (frame < 2)", 2, 2, true);
+}
+
+TEST(KnobExpression,
+     Functions)
+{
+    checkExpression("sin(pi / 2)", 0, 1, false);
+    checkExpression("cos(0) + exp(0) + sqrt(4)", 0, 4, false);
+    checkExpression("hypot(3, 4)", 0, 5, false);
+    checkExpression("log(8, 2)", 0, 3, false);
+    checkExpression("degrees(pi)", 0, 180, false);
+    checkExpression("max(1, 2.5, 2)", 0, 2.5, false);
+    checkExpression("min(3, 1, 2)", 0, 1, true);
+    checkExpression("abs(-3)", 0, 3, true);
+    checkExpression("fabs(-3)", 0, 3, false);
+    checkExpression("int(-2.7)", 0, -2, true);
+    checkExpression("float(2)", 0, 2, false);
+#if PY_MAJOR_VERSION >= 3
+    checkExpression("floor(-2.5)", 0, -3, true);
+#else
+    checkExpression("floor(-2.5)", 0, -3, false);
+#endif
+}
+
+TEST(KnobExpression,
+     Variables)
+{
+    TestResolver resolver;
+
+    checkExpression("frame * 2", 10, 20, true);
+    checkExpression("frame * 2", 10.5, 21, false);
+    checkExpression("dimension + 1", 0, 3, true, resolver, 2);
+    checkExpression("view", 0, 0, true);
+
+    // Names redefined in the scope of the expression
+    resolver.shadowed.insert("sin");
+    resolver.shadowed.insert("frame");
+    checkNotCompiled("sin(1)", resolver);
+    checkNotCompiled("frame", resolver);
+    checkExpression("cos(0)", 0, 1, false, resolver);
+}
+
+TEST(KnobExpression,
+     NotCompiled)
+{
+    checkNotCompiled("");
+    checkNotCompiled("random()");
+    checkNotCompiled("randomInt(0, 10)");
+    checkNotCompiled("x");
+    checkNotCompiled("ret = 1");
+    checkNotCompiled("1 < frame < 3");
+    checkNotCompiled("0x10");
+    checkNotCompiled("010");
+    checkNotCompiled("1j");
+    checkNotCompiled("'a'");
+    checkNotCompiled("[1, 2][0]");
+    checkNotCompiled("1 if frame");
+    checkNotCompiled("sin()");
+    checkNotCompiled("max(1)");
+    checkNotCompiled("round(1.5)");
+    checkNotCompiled("frame # comment");
+    checkNotCompiled("Node.unknown.get()");
+    checkNotCompiled( std::string(1000, '(') + "1" + std::string(1000, ')') );
+
+    // A tree too deep to be evaluated recursively
+    std::string sum = "1";
+    for (int i = 0; i < 1000; ++i) {
+        sum += " + 1";
+    }
+    checkNotCompiled(sum);
+}
+
+// Python raises an exception: the expression must be evaluated by Python to report it
+TEST(KnobExpression,
+     PythonErrors)
+{
+    checkNotEvaluated("1 / (frame - 10)", 10);
+    checkNotEvaluated("1 // (frame - 10)", 10);
+    checkNotEvaluated("1 % (frame - 10)", 10);
+    checkNotEvaluated("sqrt(frame - 20)", 10);
+    checkNotEvaluated("log(frame - 10)", 10);
+    checkNotEvaluated("exp(frame * 100)", 10);
+    checkNotEvaluated("(-frame) ** 0.5", 10);
+    checkNotEvaluated("0 ** -frame", 10);
+    // Python ints that a double cannot hold
+    checkNotEvaluated("2 ** (frame * 6)", 10);
+
+    checkExpression("1 / (frame - 10)", 11, 1, false);
+}
+
+TEST(KnobExpression,
+     Knobs)
+{
+    KnobDoublePtr doubleKnob = AppManager::createKnob<KnobDouble>(NULL, "double", 2);
+    KnobIntPtr intKnob = AppManager::createKnob<KnobInt>(NULL, "int", 1);
+    KnobBoolPtr boolKnob = AppManager::createKnob<KnobBool>(NULL, "bool", 1);
+    KnobColorPtr colorKnob = AppManager::createKnob<KnobColor>(NULL, "color", 3);
+    KnobStringPtr stringKnob = AppManager::createKnob<KnobString>(NULL, "string", 1);
+
+    doubleKnob->setValue(1.5, ViewSpec::all(), 0);
+    doubleKnob->setValue(2.5, ViewSpec::all(), 1);
+    intKnob->setValue(7);
+    boolKnob->setValue(true);
+    colorKnob->setValue(0.25, ViewSpec::all(), 2);
+
+    TestResolver resolver;
+    resolver.knobs["double"] = doubleKnob;
+    resolver.knobs["int"] = intKnob;
+    resolver.knobs["bool"] = boolKnob;
+    resolver.knobs["color"] = colorKnob;
+    resolver.knobs["string"] = stringKnob;
+
+    checkExpression("Node.double.getValue()", 0, 1.5, false, resolver);
+    checkExpression("Node.double.getValue(1)", 0, 2.5, false, resolver);
+    checkExpression("Node.double.getValue(dimension)", 0, 2.5, false, resolver, 1);
+    checkExpression("Node.double.get().y * 2", 0, 5, false, resolver);
+    checkExpression("Node.double.getValueAtTime(frame, 1)", 10, 2.5, false, resolver);
+    checkExpression("Node.int.get() // 2", 0, 3, true, resolver);
+    checkExpression("Node.int.getValue() + Node.bool.getValue()", 0, 8, true, resolver);
+    checkExpression("Node.color.get().b", 0, 0.25, false, resolver);
+    checkExpression("Node.double.curve(frame, 1)", 5, 2.5, false, resolver);
+
+    // Not the Python signature of the param
+    checkNotCompiled("Node.double.get()", resolver);
+    checkNotCompiled("Node.double.get().z", resolver);
+    checkNotCompiled("Node.int.get().x", resolver);
+    checkNotCompiled("Node.bool.getValue(0)", resolver);
+    checkNotCompiled("Node.color.get().a", resolver);
+    checkNotCompiled("Node.double.getValueAtTime()", resolver);
+    checkNotCompiled("Node.double.setValue(1)", resolver);
+    checkNotCompiled("Node.string.getValue()", resolver);
+
+    // Invalid dimensions are left to Python
+    KnobExpressionPtr expr = KnobExpression::compile("Node.double.getValue(frame)", 0, resolver);
+    ASSERT_TRUE( bool(expr) );
+    double result;
+    bool isInt;
+    EXPECT_TRUE( expr->evaluate(1, ViewIdx(0), &result, &isInt) );
+    EXPECT_FALSE( expr->evaluate(2, ViewIdx(0), &result, &isInt) );
+    EXPECT_FALSE( expr->evaluate(0.5, ViewIdx(0), &result, &isInt) );
+
+    // A deleted knob is left to Python
+    expr = KnobExpression::compile("Node.int.getValue()", 0, resolver);
+    ASSERT_TRUE( bool(expr) );
+    resolver.knobs.clear();
+    intKnob.reset();
+    EXPECT_FALSE( expr->evaluate(0, ViewIdx(0), &result, &isInt) );
+} // TEST
+
+// Evaluations per second of a typical expression from 1 and 16 threads
+TEST(KnobExpression,
+     Benchmark)
+{
+    KnobDoublePtr doubleKnob = AppManager::createKnob<KnobDouble>(NULL, "double", 1);
+    KnobIntPtr intKnob = AppManager::createKnob<KnobInt>(NULL, "int", 1);
+
+    doubleKnob->setValue(2.);
+    intKnob->setValue(3);
+
+    TestResolver resolver;
+    resolver.knobs["double"] = doubleKnob;
+    resolver.knobs["int"] = intKnob;
+    KnobExpressionPtr expr = KnobExpression::compile("sin(frame * 0.1) * Node.double.getValue() + Node.int.get() / 2. + max(frame, 50)", 0, resolver);
+    ASSERT_TRUE( bool(expr) );
+
+    const int count = 200000;
+    const int threadCounts[] = { 1, 16 };
+    for (int t = 0; t < 2; ++t) {
+        int nThreads = threadCounts[t];
+        std::vector<EvaluateThread*> threads;
+        for (int i = 0; i < nThreads; ++i) {
+            threads.push_back( new EvaluateThread(expr, count) );
+        }
+        TimeLapse timer;
+        for (int i = 0; i < nThreads; ++i) {
+            threads[i]->start();
+        }
+        for (int i = 0; i < nThreads; ++i) {
+            threads[i]->wait();
+        }
+        double elapsed = timer.getTimeSinceCreation();
+        double sum = threads[0]->getSum();
+        for (int i = 0; i < nThreads; ++i) {
+            EXPECT_EQ( 0, threads[i]->getFailures() );
+            EXPECT_DOUBLE_EQ( sum, threads[i]->getSum() );
+            delete threads[i];
+        }
+        std::cout << "KnobExpression: " << nThreads << " thread(s), " << (nThreads * count) / elapsed << " evaluations/s" << std::endl;
+    }
+}
@@ -24,9 +24,22 @@
 
 #include "Global/Macros.h"
 
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/math/special_functions/fpclassify.hpp>
+#endif
+
 #include "Engine/Lut.h"
+#include "Engine/InstructionSet.h"
+#include "Engine/RectI.h"
+#include "Engine/Timer.h"
 
 NATRON_NAMESPACE_USING
 using namespace NATRON_NAMESPACE::Color;
@@ -51,3 +64,165 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+namespace {
+std::vector<const Lut*>
+getBuiltinLuts()
+{
+    std::vector<const Lut*> luts;
+
+    luts.push_back( LutManager::sRGBLut() );
+    luts.push_back( LutManager::Rec709Lut() );
+    luts.push_back( LutManager::CineonLut() );
+    luts.push_back( LutManager::Gamma1_8Lut() );
+    luts.push_back( LutManager::Gamma2_2Lut() );
+    luts.push_back( LutManager::PanalogLut() );
+    luts.push_back( LutManager::ViperLogLut() );
+    luts.push_back( LutManager::REDLogLut() );
+    luts.push_back( LutManager::AlexaV3LogCLut() );
+    luts.push_back( LutManager::SLog1Lut() );
+    luts.push_back( LutManager::SLog2Lut() );
+    luts.push_back( LutManager::SLog3Lut() );
+    luts.push_back( LutManager::VLogLut() );
+
+    return luts;
+}
+
+// Values in [0,1]: a regular sampling, plus random values
+std::vector<float>
+getUnitValues()
+{
+    const int nSteps = 1 << 16;
+    std::vector<float> values;
+
+    for (int i = 0; i <= nSteps; ++i) {
+        values.push_back( (float)i / nSteps );
+    }
+    srand(2000);
+    for (int i = 0; i < nSteps; ++i) {
+        // coverity[dont_call]
+        values.push_back( (float)rand() / (float)RAND_MAX );
+    }
+
+    return values;
+}
+} // anon namespace
+
+// The batch conversions are within the documented error bound on [0,1] (relative for values greater than 1)
+TEST(Lut, BatchAccuracy) {
+    const std::vector<const Lut*> luts = getBuiltinLuts();
+    const std::vector<float> values = getUnitValues();
+    std::vector<float> result( values.size() );
+
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        const Lut* lut = luts[l];
+        double toMaxError = 0., fromMaxError = 0.;
+        lut->to_float_batch( &result[0], &values[0], (int)values.size() );
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            float exact = lut->toColorSpaceFloatFromLinearFloat(values[i]);
+            // log functions are infinite at 0
+            if ( (boost::math::isfinite)(exact) ) {
+                toMaxError = std::max( toMaxError, std::abs( (double)result[i] - exact ) / std::max( 1.f, std::abs(exact) ) );
+            }
+        }
+        lut->from_float_batch( &result[0], &values[0], (int)values.size() );
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            float exact = lut->fromColorSpaceFloatToLinearFloat(values[i]);
+            fromMaxError = std::max( fromMaxError, std::abs( (double)result[i] - exact ) / std::max( 1.f, std::abs(exact) ) );
+        }
+        EXPECT_LT(toMaxError, 2e-5) << lut->getName();
+        EXPECT_LT(fromMaxError, 2e-5) << lut->getName();
+    }
+}
+
+// The AVX2 version gives exactly the same result as the scalar one, including out of [0,1]
+TEST(Lut, BatchSameAsScalar) {
+    const std::vector<const Lut*> luts = getBuiltinLuts();
+    std::vector<float> values = getUnitValues();
+
+    values.push_back(-0.5f);
+    values.push_back(1e6f);
+    values.push_back(-0.f);
+    values.push_back( std::numeric_limits<float>::infinity() );
+    values.push_back( std::numeric_limits<float>::quiet_NaN() );
+    values.push_back(3.f); // not a multiple of 8 values
+    std::vector<float> reference( values.size() ), result( values.size() );
+    InstructionSetEnum supported = getSupportedInstructionSet();
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        setInstructionSet(eInstructionSetScalar);
+        luts[l]->to_float_batch( &reference[0], &values[0], (int)values.size() );
+        setInstructionSet(supported);
+        luts[l]->to_float_batch( &result[0], &values[0], (int)values.size() );
+        EXPECT_EQ( 0, std::memcmp( &reference[0], &result[0], values.size() * sizeof(float) ) ) << luts[l]->getName();
+
+        setInstructionSet(eInstructionSetScalar);
+        luts[l]->from_float_batch( &reference[0], &values[0], (int)values.size() );
+        setInstructionSet(supported);
+        luts[l]->from_float_batch( &result[0], &values[0], (int)values.size() );
+        EXPECT_EQ( 0, std::memcmp( &reference[0], &result[0], values.size() * sizeof(float) ) ) << luts[l]->getName();
+    }
+}
+
+// A rectangle large enough to be converted by several threads gives the same result as the per-pixel conversion
+TEST(Lut, FloatPacked) {
+    const Lut* lut = LutManager::sRGBLut();
+    const int width = 1024;
+    const int height = 512;
+    const RectI bounds(0, 0, width, height);
+    std::vector<float> src(width * height * 4), dst(width * height * 4);
+
+    srand(2000);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        // coverity[dont_call]
+        src[i] = (float)rand() / (float)RAND_MAX;
+    }
+    lut->from_float_packed(&dst[0], &src[0], bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, false, true);
+    double maxError = 0.;
+    for (int i = 0; i < width * height * 4; i += 4) {
+        float a = src[i + 3];
+        for (int c = 0; c < 3; ++c) {
+            float expected = a > 0.f ? lut->fromColorSpaceFloatToLinearFloat(src[i + c] / a) * a : 0.f;
+            maxError = std::max( maxError, std::abs( (double)dst[i + c] - expected ) / std::max( 1.f, std::abs(expected) ) );
+        }
+        EXPECT_EQ(a, dst[i + 3]);
+    }
+    EXPECT_LT(maxError, 1e-4);
+}
+
+// Reports the conversion speed of each built-in lut on single-channel pixels, with the exact functions and the batch conversions
+TEST(Lut, Benchmark) {
+    const std::vector<const Lut*> luts = getBuiltinLuts();
+    const int nValues = 1 << 22;
+    std::vector<float> values(nValues), result(nValues);
+
+    srand(2000);
+    for (int i = 0; i < nValues; ++i) {
+        // coverity[dont_call]
+        values[i] = (float)rand() / (float)RAND_MAX;
+    }
+    InstructionSetEnum supported = getSupportedInstructionSet();
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        const Lut* lut = luts[l];
+        lut->to_float_batch(&result[0], &values[0], 1); // fill the tables
+
+        TimeLapse exactTimer;
+        for (int i = 0; i < nValues; ++i) {
+            result[i] = lut->toColorSpaceFloatFromLinearFloat(values[i]);
+        }
+        double exactElapsed = exactTimer.getTimeSinceCreation();
+
+        setInstructionSet(eInstructionSetScalar);
+        TimeLapse scalarTimer;
+        lut->to_float_batch(&result[0], &values[0], nValues);
+        double scalarElapsed = scalarTimer.getTimeSinceCreation();
+
+        setInstructionSet(supported);
+        TimeLapse batchTimer;
+        lut->to_float_batch(&result[0], &values[0], nValues);
+        double batchElapsed = batchTimer.getTimeSinceCreation();
+
+        std::cout << "Lut " << lut->getName() << ": exact " << nValues / exactElapsed / 1e6 << " Mpixels/s, batch scalar "
+                  << nValues / scalarElapsed / 1e6 << " Mpixels/s, batch instruction set " << supported << " "
+                  << nValues / batchElapsed / 1e6 << " Mpixels/s" << std::endl;
+    }
+}
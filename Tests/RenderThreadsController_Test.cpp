@@ -0,0 +1,106 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <gtest/gtest.h>
+
+#include "Engine/RenderThreadsController.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+RenderThreadsController::WindowStats
+makeWindow(double throughput,
+           double cpuUtilization,
+           double cacheOccupation)
+{
+    RenderThreadsController::WindowStats stats;
+
+    stats.nFrames = 8;
+    stats.throughput = throughput;
+    stats.meanLatency = 1. / throughput;
+    stats.cpuUtilization = cpuUtilization;
+    stats.cacheOccupation = cacheOccupation;
+
+    return stats;
+}
+} // anon namespace
+
+// Threads are added while cores are idle, up to the maximum
+TEST(RenderThreadsController,
+     AddsThreadsWhileCoresAreIdle)
+{
+    RenderThreadsController controller;
+
+    controller.start(1, 4);
+    EXPECT_EQ( 2, controller.processWindow( makeWindow(1., 0.3, 0.) ) );
+    EXPECT_EQ( 3, controller.processWindow( makeWindow(2., 0.5, 0.) ) );
+    EXPECT_EQ( 4, controller.processWindow( makeWindow(3., 0.7, 0.) ) );
+    EXPECT_EQ( 4, controller.processWindow( makeWindow(4., 0.8, 0.) ) );
+    EXPECT_FALSE( controller.getLastDecision().empty() );
+}
+
+// A thread that lowered the throughput is removed, and the controller waits before adding one again
+TEST(RenderThreadsController,
+     RevertsChangeLoweringThroughput)
+{
+    RenderThreadsController controller;
+
+    controller.start(2, 8);
+    EXPECT_EQ( 3, controller.processWindow( makeWindow(2., 0.5, 0.) ) );
+    EXPECT_EQ( 2, controller.processWindow( makeWindow(1.5, 0.6, 0.) ) );
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ( 2, controller.processWindow( makeWindow(2., 0.5, 0.) ) );
+    }
+    EXPECT_EQ( 3, controller.processWindow( makeWindow(2., 0.5, 0.) ) );
+}
+
+// No thread is added when the image cache is full or the CPU is saturated
+TEST(RenderThreadsController,
+     KeepsThreadsUnderPressure)
+{
+    RenderThreadsController controller;
+
+    controller.start(3, 8);
+    EXPECT_EQ( 3, controller.processWindow( makeWindow(2., 0.5, 1.) ) );
+    EXPECT_EQ( 3, controller.processWindow( makeWindow(2., 0.95, 0.) ) );
+}
+
+// When the CPU stays saturated, a thread is removed from time to time to check whether it helps
+TEST(RenderThreadsController,
+     ProbesLessThreadsWhenSaturated)
+{
+    RenderThreadsController controller;
+
+    controller.start(6, 8);
+    int nThreads = 6;
+    int i = 0;
+    for (; i < 20 && nThreads == 6; ++i) {
+        nThreads = controller.processWindow( makeWindow(2., 1., 0.) );
+    }
+    EXPECT_EQ(5, nThreads);
+    // less threads render faster: keep it
+    EXPECT_EQ( 5, controller.processWindow( makeWindow(2.5, 1., 0.) ) );
+}
@@ -0,0 +1,190 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Engine/RotoShapeRasterizer.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+Point
+makePoint(double x,
+          double y)
+{
+    Point p;
+
+    p.x = x;
+    p.y = y;
+
+    return p;
+}
+
+double
+sumCoverage(const std::vector<float> & coverage)
+{
+    double sum = 0.;
+
+    for (std::size_t i = 0; i < coverage.size(); ++i) {
+        sum += coverage[i];
+    }
+
+    return sum;
+}
+
+// A circle of radius 50 centered on (-5,60), partly on the left of x = 0
+std::vector<Point>
+makeCircle()
+{
+    std::vector<Point> polygon;
+
+    for (int i = 0; i < 2000; ++i) {
+        double a = 2. * M_PI * i / 2000;
+        polygon.push_back( makePoint(-5. + 50. * std::cos(a), 60. + 50. * std::sin(a)) );
+    }
+
+    return polygon;
+}
+
+// The square [20,60]x[20,60] and its feather, 10 pixels outward
+void
+makeFeatheredSquare(std::vector<Point>* polygon,
+                    std::vector<Point>* inner,
+                    std::vector<Point>* outer)
+{
+    for (int i = 0; i < 40; ++i) {
+        inner->push_back( makePoint(20 + i, 20) );
+    }
+    for (int i = 0; i < 40; ++i) {
+        inner->push_back( makePoint(60, 20 + i) );
+    }
+    for (int i = 0; i < 40; ++i) {
+        inner->push_back( makePoint(60 - i, 60) );
+    }
+    for (int i = 0; i < 40; ++i) {
+        inner->push_back( makePoint(20, 60 - i) );
+    }
+    *polygon = *inner;
+    for (std::size_t i = 0; i < inner->size(); ++i) {
+        const Point & p = (*inner)[i];
+        double dx = (p.x <= 20) ? -10 : ( (p.x >= 60) ? 10 : 0 );
+        double dy = (p.y <= 20) ? -10 : ( (p.y >= 60) ? 10 : 0 );
+        outer->push_back( makePoint(p.x + dx, p.y + dy) );
+    }
+}
+} // anon namespace
+
+TEST(RotoShapeRasterizer,
+     PolygonArea)
+{
+    RotoShapeRasterizer rasterizer;
+    std::vector<Point> polygon;
+
+    polygon.push_back( makePoint(10.25, 5.5) );
+    polygon.push_back( makePoint(30.75, 5.5) );
+    polygon.push_back( makePoint(30.75, 20.5) );
+    polygon.push_back( makePoint(10.25, 20.5) );
+    rasterizer.addShape( polygon, std::vector<Point>(), std::vector<Point>(), 1. );
+
+    RectI rect(0, 0, 40, 30);
+    std::vector<float> coverage(40 * 30);
+    rasterizer.renderCoverage(rect, &coverage[0]);
+    EXPECT_NEAR(20.5 * 15, sumCoverage(coverage), 1e-3);
+    EXPECT_NEAR(0.75, coverage[10 * 40 + 10], 1e-6);
+    EXPECT_NEAR(0.75, coverage[10 * 40 + 30], 1e-6);
+    EXPECT_NEAR(0.5, coverage[5 * 40 + 20], 1e-6);
+    EXPECT_NEAR(1., coverage[10 * 40 + 20], 1e-6);
+
+    // The orientation of the polygon does not matter
+    RotoShapeRasterizer reversed;
+    std::vector<Point> reversedPolygon( polygon.rbegin(), polygon.rend() );
+    reversed.addShape( reversedPolygon, std::vector<Point>(), std::vector<Point>(), 1. );
+    std::vector<float> reversedCoverage(40 * 30);
+    reversed.renderCoverage(rect, &reversedCoverage[0]);
+    for (std::size_t i = 0; i < coverage.size(); ++i) {
+        EXPECT_NEAR(coverage[i], reversedCoverage[i], 1e-5);
+    }
+}
+
+TEST(RotoShapeRasterizer,
+     Bands)
+{
+    RotoShapeRasterizer rasterizer;
+
+    rasterizer.addShape( makeCircle(), std::vector<Point>(), std::vector<Point>(), 1. );
+
+    RectI rect(-60, 0, 60, 120);
+    std::vector<float> coverage(120 * 120);
+    rasterizer.renderCoverage(rect, &coverage[0]);
+    EXPECT_NEAR(0.5 * 2000 * 50 * 50 * std::sin(2. * M_PI / 2000), sumCoverage(coverage), 0.05);
+
+    // Rendering separate bands of the right half gives the same coverage
+    RectI bottom(0, 0, 60, 50), top(0, 50, 60, 120);
+    std::vector<float> bottomCoverage(60 * 50), topCoverage(60 * 70);
+    rasterizer.renderCoverage(bottom, &bottomCoverage[0]);
+    rasterizer.renderCoverage(top, &topCoverage[0]);
+    for (int y = 0; y < 120; ++y) {
+        for (int x = 0; x < 60; ++x) {
+            float value = (y < 50) ? bottomCoverage[y * 60 + x] : topCoverage[(y - 50) * 60 + x];
+            ASSERT_NEAR(coverage[y * 120 + x + 60], value, 1e-4) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+TEST(RotoShapeRasterizer,
+     Feather)
+{
+    std::vector<Point> polygon, inner, outer;
+
+    makeFeatheredSquare(&polygon, &inner, &outer);
+
+    RotoShapeRasterizer rasterizer;
+    rasterizer.addShape(polygon, inner, outer, 1.);
+
+    RectI rect(0, 0, 80, 80);
+    std::vector<float> coverage(80 * 80);
+    rasterizer.renderCoverage(rect, &coverage[0]);
+
+    // With a linear fall-off, the opacity at the distance d of the shape is (1 - d)^2, as with cairo
+    for (int x = 0; x < 20; ++x) {
+        double d = std::min( (20 - (x + 0.5) ) / 10, 1. );
+        EXPECT_NEAR( (1. - d) * (1. - d), coverage[40 * 80 + x], 2e-3 ) << "x=" << x;
+    }
+    EXPECT_NEAR(1., coverage[40 * 80 + 30], 1e-6);
+
+    RectI bottom(0, 0, 80, 33), top(0, 33, 80, 80);
+    std::vector<float> bottomCoverage(80 * 33), topCoverage(80 * 47);
+    rasterizer.renderCoverage(bottom, &bottomCoverage[0]);
+    rasterizer.renderCoverage(top, &topCoverage[0]);
+    for (int y = 0; y < 80; ++y) {
+        for (int x = 0; x < 80; ++x) {
+            float value = (y < 33) ? bottomCoverage[y * 80 + x] : topCoverage[(y - 33) * 80 + x];
+            ASSERT_EQ(coverage[y * 80 + x], value) << "x=" << x << " y=" << y;
+        }
+    }
+}
@@ -0,0 +1,203 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <new> // bad_alloc
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <QtCore/QAtomicInt>
+
+#include "Engine/TaskScheduler.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+// Counts the executions of each task
+class CountingTasks
+    : public ParallelTasks
+{
+public:
+
+    CountingTasks(int nTasks)
+        : counts(nTasks)
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        // some work, so that the workers get a chance to take tasks
+        volatile double x = 0.;
+        for (int i = 0; i < 10000; ++i) {
+            x += i * 0.5;
+        }
+        counts[taskIndex].ref();
+    }
+
+    std::vector<QAtomicInt> counts;
+};
+
+// Each task runs nested tasks on the same scheduler
+class NestedTasks
+    : public ParallelTasks
+{
+public:
+
+    NestedTasks(TaskScheduler* scheduler,
+                int nTasks,
+                int nSubTasks)
+        : scheduler(scheduler)
+        , nSubTasks(nSubTasks)
+        , subCounts(nTasks * nSubTasks)
+    {
+    }
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        CountingTasks subTasks(nSubTasks);
+
+        scheduler->run(&subTasks, nSubTasks);
+        for (int i = 0; i < nSubTasks; ++i) {
+            subCounts[taskIndex * nSubTasks + i] = (int)subTasks.counts[i];
+        }
+    }
+
+    TaskScheduler* scheduler;
+    int nSubTasks;
+    std::vector<int> subCounts;
+};
+
+class ThrowingTasks
+    : public ParallelTasks
+{
+public:
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        if (taskIndex == 3) {
+            throw std::runtime_error("task 3");
+        }
+    }
+};
+
+class BadAllocTasks
+    : public ParallelTasks
+{
+public:
+
+    virtual void runTask(int taskIndex) OVERRIDE FINAL
+    {
+        if (taskIndex == 5) {
+            throw std::bad_alloc();
+        }
+    }
+};
+} // anon namespace
+
+TEST(TaskScheduler,
+     AllTasksRunOnce)
+{
+    TaskScheduler scheduler(4);
+    const int nTasks = 1000;
+    CountingTasks tasks(nTasks);
+    std::vector<TaskTiming> timings;
+
+    scheduler.run(&tasks, nTasks, &timings);
+    ASSERT_EQ(nTasks, (int)timings.size());
+    for (int i = 0; i < nTasks; ++i) {
+        EXPECT_EQ(1, (int)tasks.counts[i]) << "task " << i;
+        EXPECT_GE(timings[i].waitTime, 0.);
+        EXPECT_GE(timings[i].runTime, 0.);
+        EXPECT_FALSE(timings[i].runBySpawner && timings[i].stolen);
+    }
+}
+
+TEST(TaskScheduler,
+     NoWorkers)
+{
+    TaskScheduler scheduler(0);
+    const int nTasks = 50;
+    CountingTasks tasks(nTasks);
+    std::vector<TaskTiming> timings;
+
+    scheduler.run(&tasks, nTasks, &timings);
+    for (int i = 0; i < nTasks; ++i) {
+        EXPECT_EQ(1, (int)tasks.counts[i]);
+        EXPECT_TRUE(timings[i].runBySpawner);
+    }
+}
+
+// A task calling run() must not deadlock, even with more nested runs than workers
+TEST(TaskScheduler,
+     NestedRuns)
+{
+    TaskScheduler scheduler(3);
+    const int nTasks = 16;
+    const int nSubTasks = 64;
+    NestedTasks tasks(&scheduler, nTasks, nSubTasks);
+
+    scheduler.run(&tasks, nTasks);
+    for (std::size_t i = 0; i < tasks.subCounts.size(); ++i) {
+        EXPECT_EQ(1, tasks.subCounts[i]) << "sub-task " << i;
+    }
+}
+
+TEST(TaskScheduler,
+     ChangeWorkersCount)
+{
+    TaskScheduler scheduler(2);
+    const int counts[] = { 6, 1, 0, 3 };
+
+    for (int c = 0; c < 4; ++c) {
+        scheduler.setWorkersCount(counts[c]);
+        EXPECT_EQ( counts[c], scheduler.getWorkersCount() );
+        CountingTasks tasks(200);
+        scheduler.run(&tasks, 200);
+        for (int i = 0; i < 200; ++i) {
+            EXPECT_EQ(1, (int)tasks.counts[i]);
+        }
+    }
+}
+
+// An exception thrown by a task is rethrown by run() once all the tasks are done
+TEST(TaskScheduler,
+     TaskException)
+{
+    TaskScheduler scheduler(2);
+    ThrowingTasks tasks;
+
+    EXPECT_THROW(scheduler.run(&tasks, 10), std::runtime_error);
+    try {
+        scheduler.run(&tasks, 10);
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ( std::string("task 3"), e.what() );
+    }
+
+    // The type of the exception is kept, callers handle std::bad_alloc differently
+    BadAllocTasks badAllocTasks;
+    EXPECT_THROW(scheduler.run(&badAllocTasks, 10), std::bad_alloc);
+}
@@ -21,11 +21,11 @@ CONFIG += console
 CONFIG -= app_bundle
 CONFIG += moc rcc
 CONFIG += boost boost-serialization-lib opengl qt cairo python shiboken pyside 
-CONFIG += static-gui static-engine static-host-support static-breakpadclient static-libmv static-openmvg static-ceres static-libtess
+CONFIG += static-gui static-engine static-host-support static-breakpadclient static-libmv static-openmvg static-ceres
 QT += gui core opengl network
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
-CONFIG += openmvg-flags glad-flags
+CONFIG += openmvg-flags libmv-flags glad-flags
 
 !noexpat: CONFIG += expat
 
@@ -43,12 +43,23 @@ SOURCES += \
     google-test/src/gtest-all.cc \
     google-mock/src/gmock-all.cc \
     BaseTest.cpp \
+    Cache_Test.cpp \
+    CacheIndexFile_Test.cpp \
     Hash64_Test.cpp \
     Image_Test.cpp \
+    ImageConvertKernels_Test.cpp \
     Lut_Test.cpp \
+    KnobExpression_Test.cpp \
     KnobFile_Test.cpp \
     Curve_Test.cpp \
+    RenderThreadsController_Test.cpp \
+    RotoShapeRasterizer_Test.cpp \
     Tracker_Test.cpp \
+    TaskScheduler_Test.cpp \
+    TileBitmap_Test.cpp \
+    TrackerFrameCache_Test.cpp \
+    TrackerKernels_Test.cpp \
+    ViewerTextureKernels_Test.cpp \
     wmain.cpp
 
 HEADERS += \
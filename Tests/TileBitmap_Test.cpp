@@ -0,0 +1,132 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <gtest/gtest.h>
+
+#include "Engine/TileBitmap.h"
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_USING
+
+TEST(TileBitmap,
+     AllocateUntilFull)
+{
+    const int sizes[] = { 1, 63, 64, 65, 4095, 4096, 4097, 100000 };
+
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        TileBitmap bitmap;
+        bitmap.resize(sizes[s]);
+        ASSERT_TRUE( bitmap.isEmpty() );
+
+        std::set<int> allocated;
+        for (int i = 0; i < sizes[s]; ++i) {
+            int index = bitmap.allocate();
+            ASSERT_GE(index, 0);
+            ASSERT_LT(index, sizes[s]);
+            ASSERT_TRUE( allocated.insert(index).second ) << "A tile was allocated twice";
+        }
+        EXPECT_TRUE( bitmap.isFull() );
+        EXPECT_EQ( -1, bitmap.allocate() ) << "No tile left";
+
+        // Free one tile in the middle: it must be the one returned by the next allocation
+        int middle = sizes[s] / 2;
+        bitmap.setFree(middle);
+        EXPECT_FALSE( bitmap.isUsed(middle) );
+        EXPECT_EQ( middle, bitmap.allocate() );
+    }
+}
+
+TEST(TileBitmap,
+     RandomUseAndFree)
+{
+    const int nTiles = 50000;
+    TileBitmap bitmap;
+
+    bitmap.resize(nTiles);
+
+    std::vector<bool> used(nTiles, false);
+    int nUsed = 0;
+    srand(2000);
+    for (int i = 0; i < 200000; ++i) {
+        // coverity[dont_call]
+        int index = rand() % nTiles;
+        if (used[index]) {
+            bitmap.setFree(index);
+            used[index] = false;
+            --nUsed;
+        } else {
+            bitmap.setUsed(index);
+            used[index] = true;
+            ++nUsed;
+        }
+        // coverity[dont_call]
+        if (rand() % 4 == 0) {
+            int allocated = bitmap.allocate();
+            if (nUsed == nTiles) {
+                ASSERT_EQ(-1, allocated);
+            } else {
+                ASSERT_GE(allocated, 0);
+                ASSERT_FALSE(used[allocated]) << "allocate() returned a tile already in use";
+                used[allocated] = true;
+                ++nUsed;
+            }
+        }
+        ASSERT_EQ( (std::size_t)(nTiles - nUsed), bitmap.getNumFreeTiles() );
+    }
+    for (int i = 0; i < nTiles; ++i) {
+        ASSERT_EQ( used[i], bitmap.isUsed(i) );
+    }
+}
+
+// Allocates and frees millions of tiles: the time per operation must not depend on the number of tiles.
+// Disabled by default, run it with --gtest_also_run_disabled_tests --gtest_filter=TileBitmap.DISABLED_Benchmark
+TEST(TileBitmap,
+     DISABLED_Benchmark)
+{
+    const int nTiles = 1 << 22;
+    const int nPasses = 4;
+    TileBitmap bitmap;
+
+    bitmap.resize(nTiles);
+
+    TimeLapse timer;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        for (int i = 0; i < nTiles; ++i) {
+            bitmap.allocate();
+        }
+        ASSERT_TRUE( bitmap.isFull() );
+        for (int i = 0; i < nTiles; ++i) {
+            bitmap.setFree( ( (std::size_t)i * 7919 ) % nTiles );
+        }
+        ASSERT_TRUE( bitmap.isEmpty() );
+    }
+    double elapsed = timer.getTimeSinceCreation();
+    std::cout << "TileBitmap: " << 2 * nPasses * nTiles << " tile allocations/frees in " << elapsed << " s ("
+              << (elapsed * 1e9) / (2. * nPasses * nTiles) << " ns per operation)" << std::endl;
+}
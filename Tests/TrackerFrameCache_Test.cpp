@@ -0,0 +1,164 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <gtest/gtest.h>
+
+GCC_DIAG_OFF(unused-function)
+GCC_DIAG_OFF(unused-parameter)
+#include "Engine/TrackerFrameAccessor.h"
+GCC_DIAG_ON(unused-function)
+GCC_DIAG_ON(unused-parameter)
+
+#include "Engine/AppManager.h"
+#include "Engine/RectI.h"
+
+NATRON_NAMESPACE_USING
+
+static TrackerFrameCacheKey
+makeKey(int frame,
+        U64 inputHash = 1)
+{
+    TrackerFrameCacheKey key;
+
+    key.inputHash = inputHash;
+    key.frame = frame;
+    key.mipMapLevel = 0;
+    key.channels = 7;
+
+    return key;
+}
+
+static MvFloatImagePtr
+makeImage(const RectI& bounds)
+{
+    return MvFloatImagePtr( new MvFloatImage( bounds.height(), bounds.width() ) );
+}
+
+static bool
+isCached(TrackerFrameCache& cache,
+         const TrackerFrameCacheKey& key,
+         const RectI& roi)
+{
+    RectI bounds;
+
+    return (bool)cache.get(key, roi, &bounds);
+}
+
+static const RectI imageBounds(0, 0, 64, 64);
+static const std::size_t imageBytes = 64 * 64 * sizeof(float);
+
+///The least recently used images are removed first when the cache is full
+TEST(TrackerFrameCache, LRUEviction)
+{
+    TrackerFrameCache cache;
+
+    cache.setMaximumMemory(imageBytes * 3);
+    for (int i = 0; i < 3; ++i) {
+        cache.insert( makeKey(i), imageBounds, makeImage(imageBounds) );
+    }
+    EXPECT_EQ(imageBytes * 3, cache.getMemoryUsage());
+
+    // Use frame 0 so that frame 1 is the least recently used
+    RectI bounds;
+    EXPECT_TRUE( cache.get(makeKey(0), imageBounds, &bounds) );
+    EXPECT_EQ(imageBounds, bounds);
+    cache.insert( makeKey(3), imageBounds, makeImage(imageBounds) );
+    EXPECT_EQ(imageBytes * 3, cache.getMemoryUsage());
+    EXPECT_TRUE( isCached(cache, makeKey(0), imageBounds) );
+    EXPECT_FALSE( isCached(cache, makeKey(1), imageBounds) );
+    EXPECT_TRUE( isCached(cache, makeKey(2), imageBounds) );
+    EXPECT_TRUE( isCached(cache, makeKey(3), imageBounds) );
+
+    // A region of a cached image is found, a bigger region is not
+    EXPECT_TRUE( isCached(cache, makeKey(3), RectI(8, 8, 16, 16)) );
+    EXPECT_FALSE( isCached(cache, makeKey(3), RectI(0, 0, 128, 64)) );
+
+    // The images of a previous input are removed
+    cache.insert( makeKey(0, 2), imageBounds, makeImage(imageBounds) );
+    EXPECT_EQ(imageBytes, cache.getMemoryUsage());
+    EXPECT_FALSE( isCached(cache, makeKey(0), imageBounds) );
+    EXPECT_TRUE( isCached(cache, makeKey(0, 2), imageBounds) );
+
+    EXPECT_TRUE( cache.evictLRUEntry() );
+    EXPECT_EQ( (std::size_t)0, cache.getMemoryUsage() );
+    EXPECT_FALSE( cache.evictLRUEntry() );
+}
+
+///The memory of the cache never exceeds its maximum, whatever the sizes of the images
+TEST(TrackerFrameCache, MemoryBound)
+{
+    TrackerFrameCache cache;
+    const std::size_t maxMemory = imageBytes * 10;
+
+    cache.setMaximumMemory(maxMemory);
+    for (int i = 0; i < 100; ++i) {
+        RectI bounds( 0, 0, 32 + (i % 7) * 16, 32 + (i % 5) * 16 );
+        cache.insert( makeKey(i), bounds, makeImage(bounds) );
+        EXPECT_LE(cache.getMemoryUsage(), maxMemory);
+        EXPECT_TRUE( isCached(cache, makeKey(i), bounds) );
+    }
+
+    // An image bigger than the cache is not inserted
+    std::size_t memory = cache.getMemoryUsage();
+    RectI hugeBounds(0, 0, 1024, 1024);
+    cache.insert( makeKey(100), hugeBounds, makeImage(hugeBounds) );
+    EXPECT_EQ( memory, cache.getMemoryUsage() );
+    EXPECT_FALSE( isCached(cache, makeKey(100), hugeBounds) );
+
+    // Lowering the maximum removes images
+    cache.setMaximumMemory(imageBytes);
+    EXPECT_LE(cache.getMemoryUsage(), imageBytes);
+    cache.insert( makeKey(101), imageBounds, makeImage(imageBounds) );
+    EXPECT_EQ( imageBytes, cache.getMemoryUsage() );
+    EXPECT_TRUE( isCached(cache, makeKey(101), imageBounds) );
+}
+
+///The caches are registered to the AppManager, which counts their memory and clears them
+TEST(TrackerFrameCache, AppManagerClear)
+{
+    TrackerFrameCache cache;
+
+    for (int i = 0; i < 2; ++i) {
+        cache.insert( makeKey(i), imageBounds, makeImage(imageBounds) );
+    }
+    EXPECT_EQ(imageBytes * 2, cache.getMemoryUsage());
+    std::size_t memory = appPTR->getTrackerFrameCachesMemoryUsage();
+    EXPECT_GE(memory, imageBytes * 2);
+
+    {
+        TrackerFrameCache other;
+        other.insert( makeKey(0), imageBounds, makeImage(imageBounds) );
+        EXPECT_EQ(memory + imageBytes, appPTR->getTrackerFrameCachesMemoryUsage());
+    }
+    // The destroyed cache was unregistered
+    EXPECT_EQ( memory, appPTR->getTrackerFrameCachesMemoryUsage() );
+
+    appPTR->clearTrackerFrameCaches();
+    EXPECT_EQ( (std::size_t)0, cache.getMemoryUsage() );
+    EXPECT_EQ( (std::size_t)0, appPTR->getTrackerFrameCachesMemoryUsage() );
+}
@@ -0,0 +1,246 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+
+GCC_DIAG_OFF(unused-function)
+GCC_DIAG_OFF(unused-parameter)
+#include <libmv/image/image.h>
+#include <libmv/tracking/track_region.h>
+GCC_DIAG_ON(unused-function)
+GCC_DIAG_ON(unused-parameter)
+
+#include "Engine/Timer.h"
+#include "Engine/TrackerKernels.h"
+
+NATRON_NAMESPACE_USING
+using namespace NATRON_NAMESPACE::TrackerKernels;
+
+namespace {
+// Values in [-0.2, 1.2] with a few special values
+float
+randomValue()
+{
+    // coverity[dont_call]
+    int r = rand();
+
+    switch (r % 32) {
+    case 0:
+        return std::numeric_limits<float>::quiet_NaN();
+    case 1:
+        return std::numeric_limits<float>::infinity();
+    case 2:
+        return -0.f;
+    case 3:
+        return 1e6f;
+    default:
+        return -0.2f + 1.4f * (float)r / (float)RAND_MAX;
+    }
+}
+
+// NaNs may have different payloads
+bool
+isSameValue(float a,
+            float b)
+{
+    return ( (a != a) && (b != b) ) || std::memcmp( &a, &b, sizeof(float) ) == 0;
+}
+
+std::vector<InstructionSetEnum>
+getVectorInstructionSets()
+{
+    std::vector<InstructionSetEnum> ret;
+    InstructionSetEnum supported = getSupportedInstructionSet();
+
+    if (supported >= eInstructionSetSSE41) {
+        ret.push_back(eInstructionSetSSE41);
+    }
+    if (supported >= eInstructionSetAVX2) {
+        ret.push_back(eInstructionSetAVX2);
+    }
+
+    return ret;
+}
+
+// A smooth texture, sampled at non-integer positions to translate it by sub-pixel amounts
+float
+texture(double x,
+        double y,
+        double phase)
+{
+    return (float)( 0.5 + 0.2 * std::sin(0.31 * x + phase) * std::cos(0.23 * y) +
+                    0.15 * std::sin(0.11 * x - 0.17 * y + 2. * phase) +
+                    0.1 * std::cos(0.53 * x + 0.07 * y) * std::sin(0.41 * y - phase) );
+}
+} // anon namespace
+
+// The vector kernels must give exactly the same result as the scalar ones, for all the row lengths
+// and the enabled channels, and a disabled channel must be ignored even if it is not finite
+TEST(TrackerKernels,
+     SameAsScalar)
+{
+    const std::vector<InstructionSetEnum> instructionSets = getVectorInstructionSets();
+
+    srand(2000);
+    for (int channels = 1; channels < 8; ++channels) {
+        const bool doR = (channels & 1) != 0;
+        const bool doG = (channels & 2) != 0;
+        const bool doB = (channels & 4) != 0;
+        for (int width = 0; width < 100; ++width) {
+            std::vector<float> src(3 * width + 1);
+            for (std::size_t i = 0; i < src.size(); ++i) {
+                src[i] = randomValue();
+            }
+            std::vector<float> reference(width + 1);
+            setInstructionSet(eInstructionSetScalar);
+            rgbToLuminance(&src[0], width, doR, doG, doB, &reference[0]);
+            for (int x = 0; x < width; ++x) {
+                float expected = ( 0.2126f * (doR ? src[3 * x] : 0.0f) +
+                                   0.7152f * (doG ? src[3 * x + 1] : 0.0f) +
+                                   0.0722f * (doB ? src[3 * x + 2] : 0.0f) ) / getLuminanceScale(doR, doG, doB);
+                EXPECT_TRUE( isSameValue(expected, reference[x]) ) << "channels " << channels << ", pixel " << x;
+            }
+            for (std::size_t s = 0; s < instructionSets.size(); ++s) {
+                std::vector<float> result(width + 1);
+                setInstructionSet(instructionSets[s]);
+                rgbToLuminance(&src[0], width, doR, doG, doB, &result[0]);
+                for (int x = 0; x < width; ++x) {
+                    EXPECT_TRUE( isSameValue(reference[x], result[x]) )
+                        << "instruction set " << instructionSets[s] << ", channels " << channels << ", width " << width << ", pixel " << x;
+                }
+            }
+        }
+    }
+    setInstructionSet( getSupportedInstructionSet() );
+}
+
+// Tracked markers per second on a synthetic sequence translating by a sub-pixel amount at each frame.
+// As in TrackerContext, the RGB frames are converted to luminance and each marker is tracked with
+// libmv::TrackRegion on the search window of the marker.
+// Disabled by default, run it with --gtest_also_run_disabled_tests --gtest_filter=TrackerKernels.DISABLED_Benchmark
+TEST(TrackerKernels,
+     DISABLED_Benchmark)
+{
+    const int width = 640;
+    const int height = 480;
+    const int nFrames = 10;
+    const double dx = 1.25;
+    const double dy = -0.75;
+    const int nMarkersX = 6;
+    const int nMarkersY = 4;
+    const int patternHalfSize = 10;
+    const int searchHalfSize = 30;
+
+    // The sequence is generated before timing
+    std::vector<std::vector<float> > frames(nFrames);
+    for (int f = 0; f < nFrames; ++f) {
+        frames[f].resize(width * height * 3);
+        float* pix = &frames[f][0];
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x, pix += 3) {
+                const double sx = x - f * dx;
+                const double sy = y - f * dy;
+                pix[0] = texture(sx, sy, 0.);
+                pix[1] = texture(sx, sy, 1.);
+                pix[2] = texture(sx, sy, 2.);
+            }
+        }
+    }
+
+    TimeLapse timer;
+    std::vector<libmv::FloatImage> luminances(nFrames);
+    for (int f = 0; f < nFrames; ++f) {
+        luminances[f].Resize(height, width, 1);
+        for (int y = 0; y < height; ++y) {
+            rgbToLuminance(&frames[f][y * width * 3], width, true, true, true, luminances[f].Data() + y * width);
+        }
+    }
+    const double conversionTime = timer.getTimeSinceCreation();
+
+    libmv::TrackRegionOptions options;
+    options.mode = libmv::TrackRegionOptions::TRANSLATION;
+    options.minimum_correlation = 0.75;
+    options.max_iterations = 50;
+    options.use_brute_initialization = true;
+    options.use_normalized_intensities = false;
+    options.sigma = 0.9;
+
+    int nTracked = 0;
+    int nAccurate = 0;
+    const int searchSize = 2 * searchHalfSize + 1;
+    libmv::FloatImage image1(searchSize, searchSize, 1);
+    libmv::FloatImage image2(searchSize, searchSize, 1);
+    for (int m = 0; m < nMarkersX * nMarkersY; ++m) {
+        double centerX = (m % nMarkersX + 1) * width / (nMarkersX + 1);
+        double centerY = (m / nMarkersX + 1) * height / (nMarkersY + 1);
+        for (int f = 0; f + 1 < nFrames; ++f) {
+            // The search window of the marker, centered on its integer position
+            const int left = (int)std::floor(centerX) - searchHalfSize;
+            const int top = (int)std::floor(centerY) - searchHalfSize;
+            ASSERT_TRUE(left >= 0 && top >= 0 && left + searchSize <= width && top + searchSize <= height);
+            for (int y = 0; y < searchSize; ++y) {
+                for (int x = 0; x < searchSize; ++x) {
+                    image1(y, x) = luminances[f](top + y, left + x);
+                    image2(y, x) = luminances[f + 1](top + y, left + x);
+                }
+            }
+            const double cx = centerX - left;
+            const double cy = centerY - top;
+            double x1[4] = { cx - patternHalfSize, cx + patternHalfSize, cx + patternHalfSize, cx - patternHalfSize };
+            double y1[4] = { cy - patternHalfSize, cy - patternHalfSize, cy + patternHalfSize, cy + patternHalfSize };
+            double x2[4], y2[4];
+            std::memcpy( x2, x1, sizeof(x1) );
+            std::memcpy( y2, y1, sizeof(y1) );
+            libmv::TrackRegionResult result;
+            libmv::TrackRegion(image1, image2, x1, y1, options, x2, y2, &result);
+            if ( !result.is_usable() ) {
+                break;
+            }
+            ++nTracked;
+            const double newCenterX = left + (x2[0] + x2[1] + x2[2] + x2[3]) / 4.;
+            const double newCenterY = top + (y2[0] + y2[1] + y2[2] + y2[3]) / 4.;
+            if ( (std::fabs(newCenterX - centerX - dx) < 0.1) && (std::fabs(newCenterY - centerY - dy) < 0.1) ) {
+                ++nAccurate;
+            }
+            centerX = newCenterX;
+            centerY = newCenterY;
+        }
+    }
+    const double elapsed = timer.getTimeSinceCreation();
+
+    const int nExpected = nMarkersX * nMarkersY * (nFrames - 1);
+    EXPECT_EQ(nExpected, nTracked);
+    EXPECT_EQ(nTracked, nAccurate);
+    std::cout << "TrackerKernels: " << nFrames << " frames of " << width << "x" << height << " converted in " << conversionTime
+              << " s, " << nTracked << " markers tracked in " << elapsed - conversionTime << " s ("
+              << nTracked / (elapsed - conversionTime) << " markers/s)" << std::endl;
+}
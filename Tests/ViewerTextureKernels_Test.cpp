@@ -0,0 +1,455 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Engine/Lut.h"
+#include "Engine/ViewerTextureKernels.h"
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_USING
+using namespace NATRON_NAMESPACE::ViewerTextureKernels;
+
+#define GAMMA_LUT_MAX_INDEX 1023
+
+namespace {
+// Values in [-0.5, 1.5] with a few special values
+float
+randomValue()
+{
+    // coverity[dont_call]
+    int r = rand();
+
+    switch (r % 64) {
+    case 0:
+        return 0.f;
+    case 1:
+        return 1.f;
+    case 2:
+        return -0.f;
+    case 3:
+        return 1e6f;
+    default:
+        return -0.5f + 2.f * (float)r / (float)RAND_MAX;
+    }
+}
+
+void
+fillRandom(std::vector<float>* values)
+{
+    for (std::size_t i = 0; i < values->size(); ++i) {
+        (*values)[i] = randomValue();
+    }
+}
+
+void
+buildGammaLut(double gamma,
+              std::vector<float>* lut)
+{
+    lut->resize(GAMMA_LUT_MAX_INDEX + 1);
+    for (int i = 0; i <= GAMMA_LUT_MAX_INDEX; ++i) {
+        (*lut)[i] = (float)std::pow(double(i) / GAMMA_LUT_MAX_INDEX, 1. / gamma);
+    }
+}
+
+std::vector<InstructionSetEnum>
+getVectorInstructionSets()
+{
+    std::vector<InstructionSetEnum> ret;
+    InstructionSetEnum supported = getSupportedInstructionSet();
+
+    if (supported >= eInstructionSetSSE41) {
+        ret.push_back(eInstructionSetSSE41);
+    }
+    if (supported >= eInstructionSetAVX2) {
+        ret.push_back(eInstructionSetAVX2);
+    }
+
+    return ret;
+}
+
+bool
+sameBits(const std::vector<float> & a,
+         const std::vector<float> & b)
+{
+    return a.size() == b.size() && std::memcmp( &a[0], &b[0], a.size() * sizeof(float) ) == 0;
+}
+
+// Offsets used by the viewer for each displayed channel
+const int channelOffsets[][3] = {
+    { 0, 1, 2 }, { 0, 0, 0 }, { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 }
+};
+const int nChannelOffsets = sizeof(channelOffsets) / sizeof(channelOffsets[0]);
+
+// Same as ViewerInstancePrivate::lookupGammaLut
+float
+lookupGammaLut(const std::vector<float> & lut,
+               float value)
+{
+    if (value < 0.) {
+        return 0.;
+    } else if (value > 1.) {
+        return 1.;
+    } else {
+        int i = (int)(value * GAMMA_LUT_MAX_INDEX);
+        float alpha = std::max( 0.f, std::min(value * GAMMA_LUT_MAX_INDEX - i, 1.f) );
+        float a = lut[i];
+        float b = (i  < GAMMA_LUT_MAX_INDEX) ? lut[i + 1] : 0.f;
+
+        return a * (1.f - alpha) + b * alpha;
+    }
+}
+
+// Reads a pixel as the per-pixel loops of the viewer did
+void
+readViewerPixel(const float* src_pixels,
+                int index,
+                int nComps,
+                int rOffset,
+                int gOffset,
+                int bOffset,
+                bool opaque,
+                double* r,
+                double* g,
+                double* b,
+                double* a)
+{
+    if (nComps >= 4) {
+        *r = src_pixels[index * nComps + rOffset];
+        *g = src_pixels[index * nComps + gOffset];
+        *b = src_pixels[index * nComps + bOffset];
+        *a = opaque ? 1. : src_pixels[index * nComps + 3];
+    } else if (nComps == 3) {
+        *r = (rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
+        *g = (gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
+        *b = (bOffset < nComps) ? src_pixels[index * nComps + bOffset] : 0.;
+        *a = 1.;
+    } else if (nComps == 2) {
+        *r = (rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
+        *g = (gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
+        *b = 0.;
+        *a = 1.;
+    } else {
+        *r = (rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
+        *g = *b = *r;
+        *a = 1.;
+    }
+}
+
+double
+matteValue(int matteChannel,
+           double r,
+           double g,
+           double b,
+           double a)
+{
+    switch (matteChannel) {
+    case 0:
+        return r;
+    case 1:
+        return g;
+    case 2:
+        return b;
+    case 3:
+        return a;
+    default:
+        return 0.;
+    }
+}
+
+// The per-pixel loop of scaleToTexture8bits_generic before the scan-line kernels, for a float image
+// without input and display colorspaces. lut is NULL if the gamma is 1.
+void
+viewerLoopTexture8bits(const float* src_pixels,
+                       int nComps,
+                       int rOffset,
+                       int gOffset,
+                       int bOffset,
+                       bool opaque,
+                       double gain,
+                       double offset,
+                       const std::vector<float>* lut,
+                       bool luminance,
+                       int matteChannel,
+                       int width,
+                       U32* dst_pixels)
+{
+    for (int index = 0; index < width; ++index) {
+        double r, g, b, a;
+        readViewerPixel(src_pixels, index, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+        int uA = (nComps >= 4 && !opaque) ? Color::floatToInt<256>(a) : 255;
+
+        r = r * gain + offset;
+        g = g * gain + offset;
+        b = b * gain + offset;
+        if (lut) {
+            r = lookupGammaLut(*lut, r);
+            g = lookupGammaLut(*lut, g);
+            b = lookupGammaLut(*lut, b);
+        }
+        if (luminance) {
+            r = 0.299 * r + 0.587 * g + 0.114 * b;
+            g = r;
+            b = r;
+        }
+
+        U8 uR = Color::floatToInt<256>(r);
+        U8 uG = Color::floatToInt<256>(g);
+        U8 uB = Color::floatToInt<256>(b);
+        if (matteChannel >= 0) {
+            U8 matteA = Color::floatToInt<256>( matteValue(matteChannel, r, g, b, a) ) / 2;
+            uR = (U8)std::max( 0.f, std::min( (float)( (double)uR + matteA ), 255.f ) );
+        }
+        dst_pixels[index] = (uA << 24) | (uR << 16) | (uG << 8) | uB;
+    }
+}
+
+// The per-pixel loop of scaleToTexture32bitsGeneric before the scan-line kernels, for a float image
+// without input colorspace
+void
+viewerLoopFloatTexture(const float* src_pixels,
+                       int nComps,
+                       int rOffset,
+                       int gOffset,
+                       int bOffset,
+                       bool opaque,
+                       bool luminance,
+                       int matteChannel,
+                       int width,
+                       float* dst_pixels)
+{
+    for (int x = 0; x < width; ++x) {
+        double r, g, b, a;
+        readViewerPixel(src_pixels, x, nComps, rOffset, gOffset, bOffset, opaque, &r, &g, &b, &a);
+        if (luminance) {
+            r = 0.299 * r + 0.587 * g + 0.114 * b;
+            g = r;
+            b = r;
+        }
+        if (matteChannel >= 0) {
+            r += matteValue(matteChannel, r, g, b, a) * 0.5;
+        }
+        dst_pixels[x * 4] = r;
+        dst_pixels[x * 4 + 1] = g;
+        dst_pixels[x * 4 + 2] = b;
+        dst_pixels[x * 4 + 3] = a;
+    }
+}
+} // anon namespace
+
+// The vector kernels must give exactly the same result as the scalar ones, for all the variants
+TEST(ViewerTextureKernels,
+     FloatTextureSameAsScalar)
+{
+    const std::vector<InstructionSetEnum> instructionSets = getVectorInstructionSets();
+    const int width = 37; // not a multiple of the vector size
+
+    srand(2000);
+    for (int nComps = 1; nComps <= 4; ++nComps) {
+        std::vector<float> src(width * nComps);
+        fillRandom(&src);
+        for (int c = 0; c < nChannelOffsets; ++c) {
+            for (int flags = 0; flags < 4; ++flags) {
+                const bool opaque = (flags & 1) != 0;
+                const bool luminance = (flags & 2) != 0;
+                for (int matteChannel = -1; matteChannel <= 3; ++matteChannel) {
+                    std::vector<float> reference(width * 4);
+                    setInstructionSet(eInstructionSetScalar);
+                    convertRowToFloatTexture(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                             opaque, luminance, matteChannel, width, &reference[0]);
+                    for (std::size_t i = 0; i < instructionSets.size(); ++i) {
+                        std::vector<float> result(width * 4);
+                        setInstructionSet(instructionSets[i]);
+                        convertRowToFloatTexture(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                                 opaque, luminance, matteChannel, width, &result[0]);
+                        EXPECT_TRUE( sameBits(reference, result) ) << "instruction set " << instructionSets[i] << ", nComps " << nComps
+                                                                   << ", channels " << c << ", flags " << flags << ", matte " << matteChannel;
+                    }
+                }
+            }
+        }
+    }
+    setInstructionSet( getSupportedInstructionSet() );
+}
+
+TEST(ViewerTextureKernels,
+     Texture8bitsSameAsScalar)
+{
+    const std::vector<InstructionSetEnum> instructionSets = getVectorInstructionSets();
+    const int width = 37;
+    const double gains[] = { 1., 2.5, 0.1 };
+    const double offsets[] = { 0., -0.05, 0.2 };
+    std::vector<float> lut;
+
+    buildGammaLut(2.2, &lut);
+
+    srand(2000);
+    for (int nComps = 1; nComps <= 4; ++nComps) {
+        std::vector<float> src(width * nComps);
+        fillRandom(&src);
+        for (int c = 0; c < nChannelOffsets; ++c) {
+            for (int flags = 0; flags < 8; ++flags) {
+                const bool opaque = (flags & 1) != 0;
+                const bool luminance = (flags & 2) != 0;
+                const bool gamma = (flags & 4) != 0;
+                for (int k = 0; k < 3; ++k) {
+                    std::vector<float> r[3], g[3], b[3], a[3];
+                    std::vector<U32> pixels[3];
+                    for (int s = 0; s <= (int)instructionSets.size(); ++s) {
+                        r[s].resize(width);
+                        g[s].resize(width);
+                        b[s].resize(width);
+                        a[s].resize(width);
+                        pixels[s].resize(width);
+                        setInstructionSet(s == 0 ? eInstructionSetScalar : instructionSets[s - 1]);
+                        // same sequence as the viewer
+                        convertRowToLinear(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                           opaque, gains[k], offsets[k], luminance && !gamma, width, &r[s][0], &g[s][0], &b[s][0], &a[s][0]);
+                        if (gamma) {
+                            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &r[s][0]);
+                            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &g[s][0]);
+                            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &b[s][0]);
+                            if (luminance) {
+                                applyLuminance(width, &r[s][0], &g[s][0], &b[s][0]);
+                            }
+                        }
+                        packToBGRA8(&r[s][0], &g[s][0], &b[s][0], &a[s][0], (k == 1) ? &g[s][0] : 0, width, &pixels[s][0]);
+                    }
+                    for (std::size_t s = 1; s <= instructionSets.size(); ++s) {
+                        EXPECT_TRUE( sameBits(r[0], r[s]) && sameBits(g[0], g[s]) && sameBits(b[0], b[s]) && sameBits(a[0], a[s]) )
+                            << "instruction set " << instructionSets[s - 1] << ", nComps " << nComps << ", channels " << c << ", flags " << flags;
+                        EXPECT_TRUE(pixels[0] == pixels[s]) << "instruction set " << instructionSets[s - 1] << ", nComps " << nComps
+                                                             << ", channels " << c << ", flags " << flags;
+                    }
+                }
+            }
+        }
+    }
+    setInstructionSet( getSupportedInstructionSet() );
+}
+
+// The kernels, scalar ones included, must give the same textures as the per-pixel loops they replaced in the viewer
+TEST(ViewerTextureKernels,
+     SameAsViewerLoop)
+{
+    InstructionSetEnum supported = getSupportedInstructionSet();
+    const int width = 37;
+    const double gains[] = { 1., 2.5, 0.1 };
+    const double offsets[] = { 0., -0.05, 0.2 };
+    std::vector<float> lut;
+
+    buildGammaLut(2.2, &lut);
+
+    srand(2000);
+    for (int nComps = 1; nComps <= 4; ++nComps) {
+        std::vector<float> src(width * nComps);
+        fillRandom(&src);
+        for (int c = 0; c < nChannelOffsets; ++c) {
+            for (int flags = 0; flags < 8; ++flags) {
+                const bool opaque = (flags & 1) != 0;
+                const bool luminance = (flags & 2) != 0;
+                const bool gamma = (flags & 4) != 0;
+                for (int matteChannel = -1; matteChannel <= 3; ++matteChannel) {
+                    std::vector<float> floatReference(width * 4);
+                    viewerLoopFloatTexture(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                           opaque, luminance, matteChannel, width, &floatReference[0]);
+                    for (int k = 0; k < 3; ++k) {
+                        std::vector<U32> reference(width);
+                        viewerLoopTexture8bits(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                               opaque, gains[k], offsets[k], gamma ? &lut : 0, luminance, matteChannel, width, &reference[0]);
+                        for (int s = eInstructionSetScalar; s <= supported; ++s) {
+                            setInstructionSet( (InstructionSetEnum)s );
+                            // same sequence as the viewer
+                            std::vector<float> r(width), g(width), b(width), a(width);
+                            std::vector<U32> pixels(width);
+                            convertRowToLinear(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                               opaque, gains[k], offsets[k], luminance && !gamma, width, &r[0], &g[0], &b[0], &a[0]);
+                            if (gamma) {
+                                applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &r[0]);
+                                applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &g[0]);
+                                applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &b[0]);
+                                if (luminance) {
+                                    applyLuminance(width, &r[0], &g[0], &b[0]);
+                                }
+                            }
+                            const float* channels[4] = { &r[0], &g[0], &b[0], &a[0] };
+                            packToBGRA8(&r[0], &g[0], &b[0], &a[0], (matteChannel >= 0) ? channels[matteChannel] : 0, width, &pixels[0]);
+                            EXPECT_TRUE(reference == pixels) << "instruction set " << s << ", nComps " << nComps << ", channels " << c
+                                                             << ", flags " << flags << ", matte " << matteChannel << ", gain " << k;
+                        }
+                    }
+                    for (int s = eInstructionSetScalar; s <= supported; ++s) {
+                        setInstructionSet( (InstructionSetEnum)s );
+                        std::vector<float> result(width * 4);
+                        convertRowToFloatTexture(&src[0], nComps, channelOffsets[c][0], channelOffsets[c][1], channelOffsets[c][2],
+                                                 opaque, luminance, matteChannel, width, &result[0]);
+                        EXPECT_TRUE( sameBits(floatReference, result) ) << "instruction set " << s << ", nComps " << nComps
+                                                                        << ", channels " << c << ", flags " << flags << ", matte " << matteChannel;
+                    }
+                }
+            }
+        }
+    }
+    setInstructionSet(supported);
+}
+
+// Converts a 4K RGBA row buffer with each instruction set
+TEST(ViewerTextureKernels,
+     Benchmark)
+{
+    const int width = 4096;
+    const int nRows = 2160;
+    std::vector<float> src(width * 4);
+    std::vector<float> r(width), g(width), b(width), a(width);
+    std::vector<U32> pixels(width);
+    std::vector<float> lut;
+
+    buildGammaLut(2.2, &lut);
+    srand(2000);
+    fillRandom(&src);
+
+    InstructionSetEnum supported = getSupportedInstructionSet();
+    for (int s = eInstructionSetScalar; s <= supported; ++s) {
+        setInstructionSet( (InstructionSetEnum)s );
+        TimeLapse timer;
+        for (int y = 0; y < nRows; ++y) {
+            convertRowToLinear(&src[0], 4, 0, 1, 2, false, 1.5, 0., false, width, &r[0], &g[0], &b[0], &a[0]);
+            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &r[0]);
+            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &g[0]);
+            applyGammaLut(&lut[0], GAMMA_LUT_MAX_INDEX, width, &b[0]);
+            packToBGRA8(&r[0], &g[0], &b[0], &a[0], 0, width, &pixels[0]);
+        }
+        std::cout << "ViewerTextureKernels: 8-bit 4K frame with instruction set " << s << " in "
+                  << timer.getTimeSinceCreation() << " s" << std::endl;
+    }
+    setInstructionSet(supported);
+}
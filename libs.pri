@@ -140,14 +140,10 @@ INCLUDEPATH += $$PWD/libs/gflags/src
 INCLUDEPATH += $$PWD/libs/gflags/src/gflags
 }
 
-libtess-flags {
-INCLUDEPATH += $$PWD/libs/libtess
-}
-
 ################
 # Gui
 static-gui {
-CONFIG += static-engine static-qhttpserver static-hoedown static-libtess
+CONFIG += static-engine static-qhttpserver static-hoedown
 win32-msvc*{
         CONFIG(64bit) {
                 CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../Gui/x64/release/ -lGui
@@ -194,7 +190,7 @@ win32-msvc*{
 # Engine
 
 static-engine {
-CONFIG += static-libmv static-openmvg static-hoedown static-libtess
+CONFIG += static-libmv static-openmvg static-hoedown
 
 win32-msvc*{
         CONFIG(64bit) {
@@ -576,47 +572,3 @@ win32-msvc*{
         else:unix: PRE_TARGETDEPS += $$OUT_PWD/../libs/hoedown/build/libhoedown.a
 }
 } # static-hoedown
-
-
-################
-# libtess
-
-static-libtess {
-
-INCLUDEPATH += $$PWD/libs/libtess
-DEPENDPATH += $$OUT_PWD/../libs/libtess
-
-win32-msvc*{
-        CONFIG(64bit) {
-                CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/x64/release/ -ltess
-                CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/x64/debug/ -ltess
-        } else {
-                CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/win32/release/ -ltess
-                CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/win32/debug/ -ltess
-        }
-} else {
-        win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/release/ -ltess
-        else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/debug/ -ltess
-        else:*-xcode:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/build/Release/ -ltess
-        else:*-xcode:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../libs/libtess/build/Debug/ -ltess
-        else:unix: LIBS += -L$$OUT_PWD/../libs/libtess/ -ltess
-}
-
-win32-msvc*{
-        CONFIG(64bit) {
-                CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/x64/release/tess.lib
-                CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/x64/debug/tess.lib
-        } else {
-                CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/win32/release/tess.lib
-                CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/win32/debug/tess.lib
-        }
-} else {
-        win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/release/libtess.a
-        else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/debug/libtess.a
-        else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/release/libtess.lib
-        else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/debug/libtess.lib
-        else:*-xcode:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/build/Release/libtess.a
-        else:*-xcode:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/build/Debug/libtess.a
-        else:unix: PRE_TARGETDEPS += $$OUT_PWD/../libs/libtess/libtess.a
-}
-} # static-libtess
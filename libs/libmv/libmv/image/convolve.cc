@@ -20,10 +20,20 @@
 
 #include "libmv/image/convolve.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include "libmv/image/image.h"
 
+// SSE2 is always available on x86-64, so the vectorized convolution does not
+// need a runtime check. It is not used when the scalar code uses the x87 FPU,
+// which would round the sums differently.
+#if (defined(__SSE2__) && defined(__SSE2_MATH__)) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define LIBMV_CONVOLVE_SSE2
+#  include <emmintrin.h>
+#endif
+
 namespace libmv {
 
 // Compute a Gaussian kernel and derivative, such that you can take the
@@ -63,6 +73,63 @@ void ComputeGaussianKernel(double sigma, Vec *kernel, Vec *derivative) {
   *derivative /= factor;
 }
 
+// Convolve a single pixel, skipping the samples which are outside the image.
+template <int size, bool vertical>
+inline float ConvolvePixel(const double* coefficients, int x, int y,
+                           int width, int height,
+                           const float* src, int src_stride,
+                           int src_line_stride) {
+  double sum = 0;
+  for (int k = -size; k <= size; ++k) {
+    if (vertical) {
+      if (y + k >= 0 && y + k < height) {
+        sum += src[k * src_line_stride] * coefficients[k + size];
+      }
+    } else {
+      if (x + k >= 0 && x + k < width) {
+        sum += src[k * src_stride] * coefficients[k + size];
+      }
+    }
+  }
+  return static_cast<float>(sum);
+}
+
+#ifdef LIBMV_CONVOLVE_SSE2
+// Convolve 4 consecutive pixels whose samples are all inside the image and
+// contiguous in memory, sample_stride being the distance between the samples
+// of a pixel. The samples are converted to double and summed in the same
+// order as in ConvolvePixel, so that the result is exactly the same.
+template <int size>
+inline void ConvolveFourPixels(const double* coefficients,
+                               const float* src, int sample_stride,
+                               float* dst, int dst_stride) {
+  __m128d sum_low = _mm_setzero_pd();
+  __m128d sum_high = _mm_setzero_pd();
+  for (int k = -size; k <= size; ++k) {
+    __m128 samples = _mm_loadu_ps(src + k * sample_stride);
+    __m128d coefficient = _mm_set1_pd(coefficients[k + size]);
+    sum_low = _mm_add_pd(sum_low,
+                         _mm_mul_pd(_mm_cvtps_pd(samples), coefficient));
+    sum_high = _mm_add_pd(sum_high,
+                          _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(samples,
+                                                                samples)),
+                                     coefficient));
+  }
+  __m128 result = _mm_movelh_ps(_mm_cvtpd_ps(sum_low),
+                                _mm_cvtpd_ps(sum_high));
+  if (dst_stride == 1) {
+    _mm_storeu_ps(dst, result);
+  } else {
+    // Writing into a plane of a multi-channel image.
+    float values[4];
+    _mm_storeu_ps(values, result);
+    for (int i = 0; i < 4; ++i) {
+      dst[i * dst_stride] = values[i];
+    }
+  }
+}
+#endif  // LIBMV_CONVOLVE_SSE2
+
 template <int size, bool vertical>
 void FastConvolve(const Vec &kernel, int width, int height,
                   const float* src, int src_stride, int src_line_stride,
@@ -73,20 +140,40 @@ void FastConvolve(const Vec &kernel, int width, int height,
   }
   // Fast path: if the kernel has a certain size, use the constant sized loops.
   for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      double sum = 0;
-      for (int k = -size; k <= size; ++k) {
-        if (vertical) {
-          if (y + k >= 0 && y + k < height) {
-            sum += src[k * src_line_stride] * coefficients[k + size];
-          }
-        } else {
-          if (x + k >= 0 && x + k < width) {
-            sum += src[k * src_stride] * coefficients[k + size];
-          }
-        }
+    int x = 0;
+#ifdef LIBMV_CONVOLVE_SSE2
+    // The pixels of a single channel image are vectorized where all the
+    // samples of the kernel are inside the image, the others (near the
+    // borders) are computed one by one.
+    int vector_begin = 0;
+    int vector_end = 0;
+    if (src_stride == 1) {
+      if (!vertical) {
+        vector_begin = std::min(size, width);
+        vector_end = width - size;
+      } else if (y - size >= 0 && y + size < height) {
+        vector_end = width;
       }
-      dst[0] = static_cast<float>(sum);
+    }
+    for (; x < vector_begin; ++x) {
+      dst[0] = ConvolvePixel<size, vertical>(coefficients, x, y,
+                                             width, height,
+                                             src, src_stride, src_line_stride);
+      src += src_stride;
+      dst += dst_stride;
+    }
+    for (; x + 4 <= vector_end; x += 4) {
+      ConvolveFourPixels<size>(coefficients, src,
+                               vertical ? src_line_stride : src_stride,
+                               dst, dst_stride);
+      src += 4 * src_stride;
+      dst += 4 * dst_stride;
+    }
+#endif  // LIBMV_CONVOLVE_SSE2
+    for (; x < width; ++x) {
+      dst[0] = ConvolvePixel<size, vertical>(coefficients, x, y,
+                                             width, height,
+                                             src, src_stride, src_line_stride);
       src += src_stride;
       dst += dst_stride;
     }